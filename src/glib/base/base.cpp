@@ -74,6 +74,7 @@ int _daylight = 0;
 #include "xfl.cpp"
 #include "xmath.cpp"
 
+#include "lz.cpp"
 #include "blobbs.cpp"
 #include "pgblob.cpp"
 #include "lx.cpp"
@@ -156,6 +156,7 @@ typedef long long index_t;
 #include <time.h>
 #include <typeinfo>
 #include <stdexcept>
+#include <atomic>
 
 #ifdef GLib_CYGWIN
   #define timezone _timezone
@@ -203,6 +204,7 @@ typedef long long index_t;
 #include "wch.h"
 #include "xfl.h"
 
+#include "lz.h"
 #include "blobbs.h"
 #include "cache.h"
 #include "lx.h"
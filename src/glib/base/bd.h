@@ -465,12 +465,36 @@ public:
   ~TCRef(){Assert(Refs==0);}
 
   void MkRef(){Refs++;}
-  void UnRef(){Assert(Refs>0); Refs--;}
+  // returns true when the last reference was released
+  bool UnRef(){Assert(Refs>0); Refs--; return Refs==0;}
   bool NoRef() const {return Refs==0;}
   int GetRefs() const {return Refs;}
   uint64 GetMemUsed() const { return sizeof(TCRef); }
 };
 
+/////////////////////////////////////////////////
+// Atomic-Reference-Count
+//   Used instead of TCRef by objects whose smart pointers are copied and
+//   released from concurrent threads, e.g. results shared through a cache.
+class TAtomicCRef{
+private:
+  std::atomic<int> Refs;
+private:
+  TAtomicCRef& operator=(const TAtomicCRef&);
+  TAtomicCRef(const TAtomicCRef&);
+public:
+  TAtomicCRef(): Refs(0){}
+  ~TAtomicCRef(){Assert(Refs==0);}
+
+  void MkRef(){Refs.fetch_add(1, std::memory_order_relaxed);}
+  // returns true when the last reference was released
+  bool UnRef(){const int OldRefs=Refs.fetch_sub(1, std::memory_order_acq_rel);
+    Assert(OldRefs>0); return OldRefs==1;}
+  bool NoRef() const {return Refs==0;}
+  int GetRefs() const {return Refs;}
+  uint64 GetMemUsed() const { return sizeof(TAtomicCRef); }
+};
+
 /////////////////////////////////////////////////
 // Weak-Pointer forward declaration
 template <class TRec> class TWPt;
@@ -490,8 +514,7 @@ private:
   }
   void UnRef() const {
     if (Addr!=NULL){
-      Addr->CRef.UnRef();
-      if (Addr->CRef.NoRef()){delete Addr;}
+      if (Addr->CRef.UnRef()){delete Addr;}
     }
   }
 public:
@@ -218,7 +218,14 @@ TBlobState TBlobBs::GetBlobState(const PFRnd& FBlobBs){
 }
 
 void TBlobBs::AssertBlobState(const PFRnd& FBlobBs, const TBlobState& State){
-  EAssertR(TBlobState(FBlobBs->GetCh())==State, TStr::Fmt("Expected state %d, received %d", (int)State, (int)FBlobBs->GetCh()));
+  const TBlobState FState=GetBlobState(FBlobBs);
+  EAssertR(FState==State, TStr::Fmt("Expected state %d, received %d", (int)State, (int)FState));
+}
+
+TBlobState TBlobBs::AssertBlobActive(const PFRnd& FBlobBs){
+  const TBlobState State=GetBlobState(FBlobBs);
+  EAssertR((State==bsActive)||(State==bsNew), TStr::Fmt("Expected active blob, received state %d", (int)State));
+  return State;
 }
 
 void TBlobBs::AssertBfCsEqFlCs(const TCs& BfCs, const TCs& FCs){
@@ -239,7 +246,8 @@ TStr TGBlobBs::GetNrBlobBsFNm(const TStr& BlobBsFNm){
 TGBlobBs::TGBlobBs(
  const TStr& BlobBsFNm, const TFAccess& _Access, const int& _MxSegLen):
   TBlobBs(), FBlobBs(), Access(_Access), MxSegLen(_MxSegLen),
-  BlockLenV(), FFreeBlobPtV(TB4Def::B4Bits), FirstBlobPt(){
+  BlockLenV(), FFreeBlobPtV(TB4Def::B4Bits), FirstBlobPt(), StateFPos(0), OpenedP(false),
+  CheckpointP(false){
   if (MxSegLen==-1){MxSegLen=MxBlobFLen;}
   TStr NrBlobBsFNm=GetNrBlobBsFNm(BlobBsFNm);
   switch (Access){
@@ -254,7 +262,9 @@ TGBlobBs::TGBlobBs(
   if (FBlobBs->Empty()){
     FBlobBs->SetFPos(0);
     PutVersionStr(FBlobBs);
+    StateFPos=FBlobBs->GetFPos();
     PutBlobBsStateStr(FBlobBs, bbsOpened);
+    OpenedP=true;
     PutMxSegLen(FBlobBs, MxSegLen);
     GenBlockLenV(BlockLenV);
     PutBlockLenV(FBlobBs, BlockLenV);
@@ -263,36 +273,135 @@ TGBlobBs::TGBlobBs(
   } else {
     FBlobBs->SetFPos(0);
     AssertVersionStr(FBlobBs);
-    int FPos=FBlobBs->GetFPos();
+    StateFPos=FBlobBs->GetFPos();
     if (Access!=faRestore){
-      AssertBlobBsStateStr(FBlobBs, bbsClosed);}
-    if (Access!=faRdOnly){
-      FBlobBs->SetFPos(FPos);
-      PutBlobBsStateStr(FBlobBs, bbsOpened);
+      AssertBlobBsStateStr(FBlobBs, bbsClosed);
+    } else {
+      // restored file can be left in any state
+      FBlobBs->GetStr(GetStateStrLen());
     }
+    // file is marked as opened on the first change, so unchanged files stay as they are;
+    // restored files are marked as closed again when closed
+    OpenedP=(Access==faRestore);
     MxSegLen=GetMxSegLen(FBlobBs);
     GetBlockLenV(FBlobBs, BlockLenV);
     GetFFreeBlobPtV(FBlobBs, FFreeBlobPtV);
   }
   FirstBlobPt=TBlobPt(FBlobBs->GetFPos());
+  // free lists saved in the header are not valid after a crash
+  if (Access==faRestore){RestoreFFreeBlobPtV();}
   FBlobBs->Flush();
 }
 
 TGBlobBs::~TGBlobBs(){
-  if (Access!=faRdOnly){
-    FBlobBs->SetFPos(0);
-    PutVersionStr(FBlobBs);
-    PutBlobBsStateStr(FBlobBs, bbsClosed);
-    PutMxSegLen(FBlobBs, MxSegLen);
-    PutBlockLenV(FBlobBs, BlockLenV);
-    PutFFreeBlobPtV(FBlobBs, FFreeBlobPtV);
-  }
+  // closed cleanly, blobs kept for checkpoints are no longer needed
+  if (Access!=faRdOnly && CheckpointP){Flush(); EndCheckpoint();}
+  if (Access!=faRdOnly && OpenedP){PutHeader();}
   FBlobBs->Flush();
   FBlobBs=NULL;
 }
 
+void TGBlobBs::SetOpened(){
+  if (OpenedP){return;}
+  FBlobBs->SetFPos(StateFPos);
+  PutBlobBsStateStr(FBlobBs, bbsOpened);
+  FBlobBs->Flush();
+  OpenedP=true;
+}
+
+void TGBlobBs::PutHeader(){
+  FBlobBs->SetFPos(0);
+  PutVersionStr(FBlobBs);
+  PutBlobBsStateStr(FBlobBs, bbsClosed);
+  PutMxSegLen(FBlobBs, MxSegLen);
+  PutBlockLenV(FBlobBs, BlockLenV);
+  PutFFreeBlobPtV(FBlobBs, FFreeBlobPtV);
+  OpenedP=false;
+}
+
+void TGBlobBs::Flush(){
+  if (Access==faRdOnly){return;}
+  if (CheckpointP){
+    // blobs written since the last flush become part of the new checkpoint
+    for (int AddrN=0; AddrN<NewBlobAddrV.Len(); AddrN++){
+      FBlobBs->SetFPos(NewBlobAddrV[AddrN]);
+      AssertBlobTag(FBlobBs, btBegin);
+      FBlobBs->GetInt();
+      int FPos=FBlobBs->GetFPos();
+      // blob could be deleted or written again since
+      if (GetBlobState(FBlobBs)==bsNew){
+        FBlobBs->SetFPos(FPos);
+        PutBlobState(FBlobBs, bsActive);
+      }
+    }
+    NewBlobAddrV.Clr();
+    // blobs freed since the last flush are needed until the new checkpoint is saved
+    PrevFreedBlobPtV.AddV(FreedBlobPtV);
+    FreedBlobPtV.Clr();
+  }
+  if (!OpenedP){return;}
+  PutHeader();
+  FBlobBs->Flush();
+}
+
+int TGBlobBs::EndCheckpoint(){
+  const int Blobs=PrevFreedBlobPtV.Len();
+  for (int BlobN=0; BlobN<Blobs; BlobN++){
+    FreeBlob(PrevFreedBlobPtV[BlobN]);}
+  PrevFreedBlobPtV.Clr();
+  if (Blobs>0){
+    PutHeader();
+    FBlobBs->Flush();
+  }
+  return Blobs;
+}
+
+void TGBlobBs::RestoreFFreeBlobPtV(){
+  GenFFreeBlobPtV(BlockLenV, FFreeBlobPtV);
+  const int FLen=FBlobBs->GetFLen();
+  // length of blob frame without the data
+  const int FrameLen=int(2*sizeof(uint)+sizeof(char)+sizeof(int)+sizeof(TCs)+sizeof(uint));
+  int BlobAddr=int(FirstBlobPt.GetAddr());
+  while (BlobAddr<FLen){
+    FBlobBs->SetFPos(BlobAddr);
+    int MxBfL=-1;
+    if (FLen-BlobAddr>=int(2*sizeof(uint))){
+      const uint BlobTag=FBlobBs->GetUInt();
+      MxBfL=FBlobBs->GetInt();
+      if ((BlobTag!=GetBeginBlobTag())||(!BlockLenV.IsIn(MxBfL))){MxBfL=-1;}
+    }
+    // blob at the end of the file can be torn by a crash, it is completed as a free blob
+    const bool TornP=(MxBfL==-1)||(BlobAddr+FrameLen+MxBfL>FLen);
+    if (MxBfL==-1){MxBfL=BlockLenV[0];}
+    if (TornP){
+      FBlobBs->SetFPos(BlobAddr);
+      PutBlobTag(FBlobBs, btBegin);
+      FBlobBs->PutInt(MxBfL);
+    }
+    const int StateFPos=BlobAddr+int(2*sizeof(uint));
+    const TBlobState State=TornP ? bsFree : GetBlobState(FBlobBs);
+    EAssertR((State==bsActive)||(State==bsFree)||(State==bsNew),
+      TStr::Fmt("Invalid blob state %d at %d", (int)State, BlobAddr));
+    // blobs written after the last checkpoint are not used by it
+    if (State!=bsActive){
+      int _MxBfL; int FFreeBlobPtN;
+      GetAllocInfo(MxBfL, BlockLenV, _MxBfL, FFreeBlobPtN);
+      FBlobBs->SetFPos(StateFPos);
+      PutBlobState(FBlobBs, bsFree);
+      FFreeBlobPtV[FFreeBlobPtN].SaveAddr(FBlobBs);
+      FFreeBlobPtV[FFreeBlobPtN]=TBlobPt(BlobAddr);
+      if (TornP){
+        FBlobBs->PutCh(TCh::NullCh, MxBfL+sizeof(TCs));
+        PutBlobTag(FBlobBs, btEnd);
+      }
+    }
+    BlobAddr+=FrameLen+MxBfL;
+  }
+}
+
 TBlobPt TGBlobBs::PutBlob(const PSIn& SIn){
   EAssert((Access==faCreate)||(Access==faUpdate)||(Access==faRestore));
+  SetOpened();
   int BfL=SIn->Len();
   int MxBfL; int FFreeBlobPtN;
   GetAllocInfo(BfL, BlockLenV, MxBfL, FFreeBlobPtN);
@@ -306,7 +415,7 @@ TBlobPt TGBlobBs::PutBlob(const PSIn& SIn){
       FBlobBs->SetFPos(BlobPt.GetAddr());
       PutBlobTag(FBlobBs, btBegin);
       FBlobBs->PutInt(MxBfL);
-      PutBlobState(FBlobBs, bsActive);
+      PutBlobState(FBlobBs, CheckpointP ? bsNew : bsActive);
       FBlobBs->PutInt(BfL);
       FBlobBs->PutSIn(SIn, Cs);
       FBlobBs->PutCh(TCh::NullCh, MxBfL-BfL);
@@ -328,7 +437,7 @@ TBlobPt TGBlobBs::PutBlob(const PSIn& SIn){
     AssertBlobState(FBlobBs, bsFree);
     FFreeBlobPtV[FFreeBlobPtN]=TBlobPt::LoadAddr(FBlobBs); // deleted blocks are saved in "linked list" - the address of the next free block was stored in the content of previous
     FBlobBs->SetFPos(FPos);
-    PutBlobState(FBlobBs, bsActive);
+    PutBlobState(FBlobBs, CheckpointP ? bsNew : bsActive);
     FBlobBs->PutInt(BfL);
     FBlobBs->PutSIn(SIn, Cs);
     FBlobBs->PutCh(TCh::NullCh, MxBfL-BfL);
@@ -342,6 +451,7 @@ TBlobPt TGBlobBs::PutBlob(const PSIn& SIn){
 	Stats.ReleasedCount--;
 	Stats.ReleasedSize -= MxBfL;
   }
+  if (CheckpointP && !BlobPt.Empty()){NewBlobAddrV.Add(BlobPt.GetAddr());}
   FBlobBs->Flush();
   Stats.PutsNew++;
   Stats.AvgPutNewLen += (BfL - Stats.AvgPutNewLen) / Stats.PutsNew;
@@ -350,13 +460,20 @@ TBlobPt TGBlobBs::PutBlob(const PSIn& SIn){
 
 TBlobPt TGBlobBs::PutBlob(const TBlobPt& BlobPt, const PSIn& SIn, int& ReleasedSize){
   EAssert((Access==faCreate)||(Access==faUpdate)||(Access==faRestore));
+  SetOpened();
   int BfL=SIn->Len();
 
   FBlobBs->SetFPos(BlobPt.GetAddr());
   AssertBlobTag(FBlobBs, btBegin);
   int MxBfL=FBlobBs->GetInt();
-  AssertBlobState(FBlobBs, bsActive);
-  if (BfL>MxBfL){
+  const TBlobState State=AssertBlobActive(FBlobBs);
+  if (CheckpointP && (State==bsActive)){
+    // blob is part of the last checkpoint, new version is written elsewhere
+    Stats.SizeChngs++;
+    FreedBlobPtV.Add(BlobPt);
+    ReleasedSize = -1;
+    return PutBlob(SIn);
+  } else if (BfL>MxBfL){
 	Stats.SizeChngs++;
     // remember the size of the chunk that we are releasing. needed to notify the level above
     // that we have space available to fill
@@ -389,7 +506,7 @@ PSIn TGBlobBs::GetBlob(const TBlobPt& BlobPt){
   FBlobBs->SetFPos(BlobPt.GetAddr());
   AssertBlobTag(FBlobBs, btBegin);
   int MxBfL=FBlobBs->GetInt();
-  AssertBlobState(FBlobBs, bsActive);
+  AssertBlobActive(FBlobBs);
   int BfL=FBlobBs->GetInt();
   TCs BfCs; PSIn SIn=FBlobBs->GetSIn(BfL, BfCs);
   FBlobBs->MoveFPos(MxBfL-BfL);
@@ -404,11 +521,27 @@ PSIn TGBlobBs::GetBlob(const TBlobPt& BlobPt){
 /// Deletes specified BLOB
 int TGBlobBs::DelBlob(const TBlobPt& BlobPt){
   EAssert((Access==faCreate)||(Access==faUpdate)||(Access==faRestore));
+  Stats.Dels++;
+  if (CheckpointP){
+    FBlobBs->SetFPos(BlobPt.GetAddr());
+    AssertBlobTag(FBlobBs, btBegin);
+    FBlobBs->GetInt();
+    if (AssertBlobActive(FBlobBs)==bsActive){
+      // blob is part of the last checkpoint, it is freed once the checkpoint is replaced
+      FreedBlobPtV.Add(BlobPt);
+      return 0;
+    }
+  }
+  return FreeBlob(BlobPt);
+}
+
+int TGBlobBs::FreeBlob(const TBlobPt& BlobPt){
+  SetOpened();
   FBlobBs->SetFPos(BlobPt.GetAddr());                                  // find BLOB start
   AssertBlobTag(FBlobBs, btBegin);
   int MxBfL=FBlobBs->GetInt();                                         // read buffer length
   int FPos=FBlobBs->GetFPos();                                         // remember position of status flag
-  AssertBlobState(FBlobBs, bsActive);                                  // make sure BLOB is active
+  AssertBlobActive(FBlobBs);                                           // make sure BLOB is active
   int BfL=FBlobBs->GetInt();
   FBlobBs->SetFPos(FPos);
   PutBlobState(FBlobBs, bsFree);                                       // mark BLOB as free
@@ -422,7 +555,6 @@ int TGBlobBs::DelBlob(const TBlobPt& BlobPt){
   FBlobBs->Flush();                                                    // write to disk
 
   // update stats
-  Stats.Dels++;
   Stats.AllocCount--;
   Stats.AllocSize -= MxBfL;
   Stats.AllocUnusedSize -= (MxBfL - BfL);
@@ -449,7 +581,8 @@ bool TGBlobBs::FNextBlobPt(TBlobPt& TrvBlobPt, TBlobPt& BlobPt, PSIn& BlobSIn){
       int MxBfL=FBlobBs->GetInt();
       TBlobState BlobState=GetBlobState(FBlobBs);
       switch (BlobState){
-        case bsActive:{
+        case bsActive:
+        case bsNew:{
           int BfL=FBlobBs->GetInt();
           TCs BfCs; BlobSIn=FBlobBs->GetSIn(BfL, BfCs);
           FBlobBs->MoveFPos(MxBfL-BfL);
@@ -512,7 +645,7 @@ void TMBlobBs::SaveMain() const {
 TMBlobBs::TMBlobBs(
  const TStr& BlobBsFNm, const TFAccess& _Access, const int& _MxSegLen):
   TBlobBs(), Access(_Access), MxSegLen(_MxSegLen),
-  NrFPath(), NrFMid(), SegV() {
+  NrFPath(), NrFMid(), SegV(), CheckpointP(false) {
   if (MxSegLen==-1){MxSegLen=MxBlobFLen;}
   // initialize the hashtable of block sizes to first segment
   TBlobBs::GenBlockLenV(BlockLenV);
@@ -574,6 +707,33 @@ TMBlobBs::~TMBlobBs(){
   }
 }
 
+void TMBlobBs::Flush(){
+  if (Access==faRdOnly){return;}
+  SaveMain();
+  for (int SegN=0; SegN<SegV.Len(); SegN++){
+    SegV[SegN]->Flush();}
+}
+
+void TMBlobBs::EnableCheckpoints(){
+  CheckpointP=true;
+  for (int SegN=0; SegN<SegV.Len(); SegN++){
+    SegV[SegN]->EnableCheckpoints();}
+}
+
+int TMBlobBs::EndCheckpoint(){
+  int Blobs=0;
+  for (int SegN=0; SegN<SegV.Len(); SegN++){
+    const int SegBlobs=SegV[SegN]->EndCheckpoint();
+    if (SegBlobs>0){
+      // segment has free blocks again, possibly of any size
+      for (int KeyId=BlockSizeToSegH.FFirstKeyId(); BlockSizeToSegH.FNextKeyId(KeyId);){
+        BlockSizeToSegH[KeyId]=MIN(uint16(SegN), BlockSizeToSegH[KeyId].Val);}
+    }
+    Blobs+=SegBlobs;
+  }
+  return Blobs;
+}
+
 // save a new buffer in SIn to a blob
 TBlobPt TMBlobBs::PutBlob(const PSIn& SIn){
   EAssert((Access==faCreate)||(Access==faUpdate)||(Access==faRestore));
@@ -605,6 +765,7 @@ TBlobPt TMBlobBs::PutBlob(const PSIn& SIn){
   if (BlobPt.Empty()) {
     TStr SegFNm = GetSegFNm(NrFPath, NrFMid, SegV.Len());
     PBlobBs Seg = TGBlobBs::New(SegFNm, faCreate, MxSegLen);
+    if (CheckpointP) { Seg->EnableCheckpoints(); }
     DestSegN = SegV.Add(Seg);
     EAssert(DestSegN < TUSInt::Mx);
     BlobPt = SegV[DestSegN]->PutBlob(SIn);
@@ -650,7 +811,9 @@ int TMBlobBs::DelBlob(const TBlobPt& BlobPt){
   // remove the data. Obtain also the info about the blob size that was released
   int ReleasedSize = SegV[SegN]->DelBlob(BlobPt);
   // we released a certain chunk. Mark in the BlockSizeToSegH the index of the segment if lower than current
-  BlockSizeToSegH.AddDat(ReleasedSize) = MIN(SegN, (uint16) BlockSizeToSegH.GetDatOrDef(ReleasedSize, 0));
+  if (ReleasedSize > 0) {
+    BlockSizeToSegH.AddDat(ReleasedSize) = MIN(SegN, (uint16) BlockSizeToSegH.GetDatOrDef(ReleasedSize, 0));
+  }
   return ReleasedSize;
 }
 
@@ -93,7 +93,8 @@ public:
 // Blob-Base
 typedef enum {bbsUndef, bbsOpened, bbsClosed} TBlobBsState;
 typedef enum {btUndef, btBegin, btEnd} TBlobTag;
-typedef enum {bsUndef, bsActive, bsFree} TBlobState;
+// bsNew marks active blobs written after the last checkpoint, see EnableCheckpoints
+typedef enum {bsUndef, bsActive, bsFree, bsNew} TBlobState;
 
 ClassTPV(TBlobBs, PBlobBs, TBlobBsV)//{
 public:
@@ -141,6 +142,8 @@ public:
   void PutBlobState(const PFRnd& FBlobBs, const TBlobState& State);
   TBlobState GetBlobState(const PFRnd& FBlobBs);
   void AssertBlobState(const PFRnd& FBlobBs, const TBlobState& State);
+  /// assert blob is active, returns bsActive or bsNew
+  TBlobState AssertBlobActive(const PFRnd& FBlobBs);
 
   void AssertBfCsEqFlCs(const TCs& BfCs, const TCs& FCs);
 
@@ -163,6 +166,15 @@ public:
 
   virtual const TBlobBsStats& GetStats()=0;
   virtual void ResetStats() = 0;
+
+  /// write headers to disk, so files are consistent while blob base stays open
+  virtual void Flush(){}
+  /// keep blobs as they were at the last Flush until the next one is saved: changed
+  /// blobs are written to new locations and freed blobs are not reused until EndCheckpoint
+  virtual void EnableCheckpoints(){}
+  /// free blobs kept for the previous checkpoint, once the one from the last Flush is saved;
+  /// returns number of freed blobs
+  virtual int EndCheckpoint(){return 0;}
 };
 
 /////////////////////////////////////////////////
@@ -181,8 +193,28 @@ private:
   /// list of free blob pointers (their content was deleted, so blobs are free)
   TBlobPtV FFreeBlobPtV;
   TBlobPt FirstBlobPt;
+  /// position of the state in the header
+  int StateFPos;
+  /// true when file is marked as opened, set on the first change after open or flush
+  bool OpenedP;
+  /// true when blobs of the last checkpoint are kept unchanged until the next one
+  bool CheckpointP;
+  /// addresses of blobs written since the last flush, they are marked as bsNew
+  TUIntV NewBlobAddrV;
+  /// blobs of the last checkpoint which were deleted or moved since the last flush
+  TBlobPtV FreedBlobPtV;
+  /// blobs deleted or moved before the last flush, kept until its checkpoint is saved
+  TBlobPtV PrevFreedBlobPtV;
   static TStr GetNrBlobBsFNm(const TStr& BlobBsFNm);
   TBlobBsStats Stats;
+  /// mark file as opened before changing it
+  void SetOpened();
+  /// write header with current free lists, marking file as closed
+  void PutHeader();
+  /// mark blob as free and add it to the free list
+  int FreeBlob(const TBlobPt& BlobPt);
+  /// rebuild free lists after a crash, blobs written after the last checkpoint are freed
+  void RestoreFFreeBlobPtV();
 public:
   TGBlobBs(const TStr& BlobBsFNm, const TFAccess& _Access=faRdOnly,
    const int& _MxSegLen=-1);
@@ -211,6 +243,11 @@ public:
 
   const TBlobBsStats& GetStats() { return Stats; }
   void ResetStats() { Stats.Reset(); }
+
+  /// write header when file changed since opened or last flushed
+  void Flush();
+  void EnableCheckpoints(){CheckpointP=true;}
+  int EndCheckpoint();
 };
 
 /////////////////////////////////////////////////
@@ -224,6 +261,8 @@ private:
   TIntV BlockLenV;
   /// for each block size store the segment index that last had space to store the buffer of that size
   THash<TInt, TUInt16> BlockSizeToSegH;
+  /// true when blobs of the last checkpoint are kept unchanged, also in new segments
+  bool CheckpointP;
   static void GetNrFPathFMid(const TStr& BlobBsFNm, TStr& NrFPath, TStr& NrFMid);
   static TStr GetMainFNm(const TStr& NrFPath, const TStr& NrFMid);
   static TStr GetSegFNm(const TStr& NrFPath, const TStr& NrFMid, const int& SegN);
@@ -259,4 +298,9 @@ public:
 
   const TBlobBsStats& GetStats();
   void ResetStats();
+
+  /// write main file and headers of all segments
+  void Flush();
+  void EnableCheckpoints();
+  int EndCheckpoint();
 };
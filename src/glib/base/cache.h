@@ -238,6 +238,8 @@ private:
     // for callbacks from cache, to store blocks before drop from cache
     void* GetVoidThis() const { return (void*)this; }
     void StoreBlock(const int& BlockId);
+    // save number of values and block pointers to FNm
+    void SaveIndex() const;
 
     // add new block to the end
     int AddBlock();
@@ -544,6 +546,12 @@ private:
     // offset of the oldest record within the oldest block
     TInt FirstValOffset;
 
+    // compress blocks before storing them to disk
+    TBool CompressP;
+    // size of serialized blocks and of what was written to disk since opened
+    TUInt64 RawBlockBytes;
+    TUInt64 StoredBlockBytes;
+
 private:
     // asserts if we are allowed to change stuff
     void AssertReadOnly() const {
@@ -553,6 +561,8 @@ private:
     // for callbacks from cache, to store blocks before drop from cache
     void* GetVoidThis() const { return (void*)this; }
     void StoreBlock(const int& BlockId);
+    // save number of values and block pointers to FNm
+    void SaveIndex() const;
 
     // add new block to the end
     int AddBlock();
@@ -574,7 +584,7 @@ private:
     
 public:
     TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlobBs,
-        const int64& MxCacheMem, const int& _BlockSize);
+        const int64& MxCacheMem, const int& _BlockSize, const bool& _CompressP = false);
     TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlobBs,
         const TFAccess& _Access, const int64& MxCacheMem);
     ~TWndBlockCache();
@@ -605,7 +615,8 @@ public:
         int res = 0;
         TLstNd<TInt>* current = BlockCache.Last();
         while (current != NULL) {
-            if (sw.GetMSecInt() > WndInMsec) {
+            // always store at least one block, so short windows still make progress
+            if (res > 0 && sw.GetMSecInt() > WndInMsec) {
                 break; // time is up
             }
             TInt Key = current->GetVal();
@@ -620,8 +631,26 @@ public:
         }
         return res;
     }
+    /// Store all changed blocks and the block index, keeping blocks in cache
+    void Flush();
+    /// Size of the blocks changed since they were last stored
+    uint64 GetDirtyBytes() {
+        uint64 DirtyBytes = 0;
+        void* KeyDatP = BlockCache.FFirstKeyDat();
+        TInt Key; PBlockDat Dat;
+        while (BlockCache.FNextKeyDat(KeyDatP, Key, Dat)) {
+            if (Dat->IsChanged()) { DirtyBytes += (uint64)Dat->GetMemUsed(); }
+        }
+        return DirtyBytes;
+    }
     /// Get statistics about BLOB storage
     TBlobBsStats GetBlobBsStats() { return BlockBlobBs->GetStats(); }
+    /// Are blocks compressed before stored to disk
+    bool IsCompressed() const { return CompressP; }
+    /// Size of serialized blocks stored since opened
+    uint64 GetRawBlockBytes() const { return RawBlockBytes; }
+    /// Size of blocks written to disk since opened, after compression
+    uint64 GetStoredBlockBytes() const { return StoredBlockBytes; }
 };
 
 template <class TVal>
@@ -632,15 +661,18 @@ void TWndBlockCache<TVal>::StoreBlock(const int& BlockId) {
     // store value to the disk
     TMOut MOut; 
     BlockDat->Save(MOut);
+    RawBlockBytes += (uint64)MOut.Len();
+    PSIn BlockSIn = CompressP ? TLz::GetCompressedSIn(MOut.GetBfAddr(), MOut.Len()) : MOut.GetSIn();
+    StoredBlockBytes += (uint64)BlockSIn->Len();
     int _BlockId = BlockId - FirstBlockOffset;
     const TBlobPt& BlockBlobPt = BlockBlobPtV[_BlockId];
     if (BlockBlobPt.Empty()) {
         // first time
-        BlockBlobPtV[_BlockId] = BlockBlobBs->PutBlob(MOut.GetSIn());
+        BlockBlobPtV[_BlockId] = BlockBlobBs->PutBlob(BlockSIn);
     } else {
         // overwrite existing
         int ReleasedSize;
-        BlockBlobPtV[_BlockId] = BlockBlobBs->PutBlob(BlockBlobPt, MOut.GetSIn(), ReleasedSize);
+        BlockBlobPtV[_BlockId] = BlockBlobBs->PutBlob(BlockBlobPt, BlockSIn, ReleasedSize);
     }
 }
 
@@ -652,6 +684,11 @@ void TWndBlockCache<TVal>::GetBlock(const int& BlockId, PBlockDat& BlockDat) con
         int _BlockId = BlockId - FirstBlockOffset;
         const TBlobPt& BlockBlobPt = BlockBlobPtV[_BlockId];
         PSIn SIn = BlockBlobBs->GetBlob(BlockBlobPt); 
+        if (CompressP) {
+            PMem BlockMem = TMem::New();
+            TLz::LoadDecompressed(SIn, *BlockMem);
+            SIn = TMemIn::New(BlockMem);
+        }
         BlockDat = TBlockDat::Load(*SIn);
     }
     // bring to the top of cache
@@ -707,7 +744,8 @@ void TWndBlockCache<TVal>::DelBlock() {
 
 template <class TVal>
 TWndBlockCache<TVal>::TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlobBs, const int64& MxCacheMem, 
-        const int& _BlockSize): BlockSize(_BlockSize), BlockCache(MxCacheMem, 1000000, GetVoidThis()) {
+        const int& _BlockSize, const bool& _CompressP): BlockSize(_BlockSize),
+            BlockCache(MxCacheMem, 1000000, GetVoidThis()), CompressP(_CompressP) {
 
     // initialize storage parameters
     FNm = _FNm;
@@ -742,6 +780,8 @@ TWndBlockCache<TVal>::TWndBlockCache(const TStr& _FNm, const PBlobBs& _BlockBlob
     BlockBlobPtV.Load(FIn);     
     FirstBlockOffset.Load(FIn);
     FirstValOffset.Load(FIn);
+    // compression flag is missing in caches created before block compression
+    if (!FIn.Eof()) { CompressP.Load(FIn); }
 }
 
 template <class TVal>
@@ -750,12 +790,26 @@ TWndBlockCache<TVal>::~TWndBlockCache() {
         // flush all the latest changes in cache to the disk        
         BlockCache.Flush();
         // save the rest to FNm
-        TFOut FOut(FNm);
-        Vals.Save(FOut);
-        BlockSize.Save(FOut);
-        BlockBlobPtV.Save(FOut);
-        FirstBlockOffset.Save(FOut);
-        FirstValOffset.Save(FOut);
+        SaveIndex();
+    }
+}
+
+template <class TVal>
+void TWndBlockCache<TVal>::SaveIndex() const {
+    TFOut FOut(FNm);
+    Vals.Save(FOut);
+    BlockSize.Save(FOut);
+    BlockBlobPtV.Save(FOut);
+    FirstBlockOffset.Save(FOut);
+    FirstValOffset.Save(FOut);
+    CompressP.Save(FOut);
+}
+
+template <class TVal>
+void TWndBlockCache<TVal>::Flush() {
+    if ((Access == faCreate) || (Access == faUpdate)) {
+        PartialFlush(TInt::Mx);
+        SaveIndex();
     }
 }
 
@@ -16,6 +16,9 @@ extern "C" {
 #include <sys/stat.h>      // fstat
 #include <sys/types.h>     // fstat
 #endif
+#ifdef GLib_WIN
+#include <io.h>            // _commit
+#endif
 
 /////////////////////////////////////////////////
 // Check-Sum
@@ -520,6 +523,15 @@ void TFOut::Flush(){
   EAssertR(fflush(FileId)==0, "Can not flush file '"+GetSNm()+"'.");
 }
 
+void TFOut::Sync(){
+  Flush();
+#ifdef GLib_WIN
+  EAssertR(_commit(_fileno(FileId))==0, "Can not sync file '"+GetSNm()+"'.");
+#else
+  EAssertR(fsync(fileno(FileId))==0, "Can not sync file '"+GetSNm()+"'.");
+#endif
+}
+
 TStr TFOut::GetSNm() const {
   return SNm; 
 }
@@ -34,6 +34,51 @@ public:
 
     /// Memory footprint
     virtual uint64 GetMemUsed() const = 0;
+
+    /// Can child vector be stored with SaveCompressed? Handlers which do not
+    /// implement compression keep their child vectors stored as plain vectors.
+    virtual bool IsCompressible(const TVec<TItem>& ItemV) const { return false; }
+    /// Save child vector in compressed form
+    virtual void SaveCompressed(const TVec<TItem>& ItemV, TSOut& SOut) const {
+        FailR("Item handler does not support compression"); }
+    /// Load Items items saved by SaveCompressed and append them to ItemV
+    virtual void LoadCompressed(TSIn& SIn, const int& Items, TVec<TItem>& ItemV) const {
+        FailR("Item handler does not support compression"); }
+};
+
+/////////////////////////////////////////////////
+/// Variable-length encoding of numbers, used by item handlers when compressing
+/// child vectors. Numbers are stored 7 bits per byte, with the highest bit set
+/// on all bytes except the last one. Signed numbers are zig-zag encoded first,
+/// so small negative numbers also take only a few bytes.
+class TGixVarInt {
+public:
+    /// Save unsigned number
+    static void SaveUInt64(TSOut& SOut, uint64 Val) {
+        char Bf[10]; int BfL = 0;
+        while (Val >= 0x80) { Bf[BfL++] = char((Val & 0x7f) | 0x80); Val >>= 7; }
+        Bf[BfL++] = char(Val);
+        SOut.PutBf(Bf, BfL);
+    }
+    /// Load unsigned number
+    static uint64 LoadUInt64(TSIn& SIn) {
+        uint64 Val = 0;
+        for (int Shift = 0; Shift < 64; Shift += 7) {
+            const uchar Ch = (uchar)SIn.GetCh();
+            Val |= uint64(Ch & 0x7f) << Shift;
+            if ((Ch & 0x80) == 0) { return Val; }
+        }
+        EFailR("Corrupted variable-length number");
+        return Val;
+    }
+    /// Save signed number
+    static void SaveInt(TSOut& SOut, const int& Val) {
+        SaveUInt64(SOut, (uint64)(((uint)Val << 1) ^ (uint)(Val >> 31))); }
+    /// Load signed number
+    static int LoadInt(TSIn& SIn) {
+        const uint Val = (uint)LoadUInt64(SIn);
+        return (int)(Val >> 1) ^ -(int)(Val & 1);
+    }
 };
 
 /////////////////////////////////////////////////
@@ -50,6 +95,36 @@ public:
     uint64 GetMemUsed() const { return sizeof(TGixDefItemHandler<TKey, TItem>); }
 };
 
+/////////////////////////////////////////////////
+/// Galloping search in sorted vectors, used when intersecting posting lists
+/// of very different lengths. Starting at the given position, the step is
+/// doubled until it jumps over the searched item, followed by binary search
+/// within the last step. Finding the next item is logarithmic in the distance
+/// to it, so probing a long list with a short one stays cheap.
+class TGixGallop {
+public:
+    /// Position of the first item at or after StartN which is not smaller than
+    /// Item, or length of the vector when there is none. IsLt compares items.
+    template <class TItem, class TIsLt>
+    static int GetFirstNotLt(const TVec<TItem>& ItemV, const TItem& Item,
+            const int& StartN, const TIsLt& IsLt) {
+
+        if (StartN >= ItemV.Len() || !IsLt(ItemV[StartN], Item)) { return StartN; }
+        // ItemV[LoN] is always smaller than Item
+        int LoN = StartN, Step = 1;
+        while (LoN + Step < ItemV.Len() && IsLt(ItemV[LoN + Step], Item)) {
+            LoN += Step; Step *= 2;
+        }
+        // ItemV[HiN] is not smaller than Item, or HiN is past the end
+        int HiN = (LoN + Step < ItemV.Len()) ? LoN + Step : ItemV.Len();
+        while (HiN - LoN > 1) {
+            const int MidN = LoN + (HiN - LoN) / 2;
+            if (IsLt(ItemV[MidN], Item)) { LoN = MidN; } else { HiN = MidN; }
+        }
+        return HiN;
+    }
+};
+
 /////////////////////////////////////////////////
 /// Key-To-String transformer
 template <class TKey>
@@ -76,7 +151,8 @@ public:
 template <class TKey, class TItem>
 class TGixItemSet {
 private:
-    TCRef CRef;
+    // shared by concurrent readers through the item set cache
+    TAtomicCRef CRef;
     typedef TPt<TGixItemSet<TKey, TItem> > PGixItemSet;
 
 private:
@@ -192,8 +268,8 @@ public:
     /// Add new item to the item set. When NotifyCacheOnlyDelta is set to true,
     /// only item set memory footprint differences are sent to gix.
     void AddItem(const TItem& NewItem, const bool& NotifyCacheOnlyDelta = true);
-    /// Add a set of items at once
-    void AddItemV(const TVec<TItem>& NewItemV);
+    /// Add a set of items at once. NotifyCacheOnlyDelta has the same meaning as in AddItem.
+    void AddItemV(const TVec<TItem>& NewItemV, const bool& NotifyCacheOnlyDelta = true);
 
     /// Check if this itemset is empty
     bool Empty() const { return GetItems() == 0; }
@@ -205,8 +281,17 @@ public:
     void GetItemV(TVec<TItem>& _ItemV);
     /// Go over all children and working buffer and pass it to HandleItemV function
     template <typename THandler> void GetItemV(THandler& Handler);
+    /// Get items equal to one of the given sorted items. Child vectors with no such
+    /// items are skipped based on their item range and are not loaded from disk.
+    /// Expects merged item set (see Def).
+    void GetIntrsItemV(const TVec<TItem>& ProbeItemV, TVec<TItem>& _ItemV);
     /// Delete specified item from this itemset
     void DelItem(const TItem& Item);
+    /// Delete a set of items at once
+    void DelItemV(const TVec<TItem>& ItemV);
+    /// Delete all items smaller than given item. Child vectors with only smaller
+    /// items are dropped without loading them from disk.
+    void DelItemsBefore(const TItem& Item);
     /// Clear all items from this itemset
     void Clr();
 
@@ -317,6 +402,8 @@ private:
     /// Can the first child vector be of any non-empty size and not be merged with following vectors
     /// This can significantly speed-up deleting items from Gix
     TBool FirstChildBeUnfilledP;
+    /// Store child vectors compressed by the item handler, when it supports it
+    TBool CompressP;
 
     /// Internal member for holding statistics
     mutable TGixStats Stats;
@@ -335,7 +422,13 @@ private:
     /// Get handle to the merger
     const TGixItemHandler<TKey, TItem>* GetItemHandler() const { return ItemHandler; }
 
-    /// Load child vector for given blob pointer from disk
+    /// Marks child vectors stored in compressed form. Plain vectors start
+    /// with their capacity, which is never negative.
+    static const int CompressedFlag;
+    /// Serialize child vector, compressed when enabled and supported by item handler
+    void SaveChildVector(const TVec<TItem>& Data, TMOut& MOut) const;
+    /// Load child vector for given blob pointer from disk and append it to Dest.
+    /// Used also by merges to decode child vectors directly into the merge buffer.
     void GetChildVector(const TBlobPt& Pt, TVec<TItem>& Dest) const;
     /// Store child vectors to disk and get back pointer to where it was stored.
     TBlobPt StoreChildVector(const TBlobPt& ExistingKeyId, const TVec<TItem>& Data) const;
@@ -371,6 +464,11 @@ public:
     int GetSplitLenMax() const { return SplitLenMax; }
     int GetSplitLenMin() const { return SplitLenMin; }
     bool CanFirstChildBeUnfilled() const { return FirstChildBeUnfilledP; }
+    /// Should new and changed child vectors be stored compressed. Existing child
+    /// vectors are read in either form, and get re-encoded when they are next saved.
+    void SetCompress(const bool& _CompressP) { CompressP = _CompressP; }
+    /// Are child vectors stored compressed
+    bool IsCompress() const { return CompressP; }
 
     /// do we have Key in the index?
     bool IsKey(const TKey& Key) const { return KeyIdH.IsKey(Key); }
@@ -400,12 +498,24 @@ public:
     void AddItemV(const TKey& Key, const TVec<TItem>& ItemV);
     // delete one item
     void DelItem(const TKey& Key, const TItem& Item);
+    /// delete a set of items, loading the item set only once
+    void DelItemV(const TKey& Key, const TVec<TItem>& ItemV);
+    /// delete all items smaller than given item
+    void DelItemsBefore(const TKey& Key, const TItem& Item);
     /// clears items
     void Clr(const TKey& Key);
     /// flush all data from cache to disk
     void Flush() { ItemSetCache.FlushAndClr(); }
     /// flush a portion of data from cache to disk
     int PartialFlush(int WndInMsec = 500);
+    /// store all changed item sets and the key index to disk, keeping them in cache
+    void SaveAll();
+    /// keep item sets stored by the last SaveAll unchanged until the next one, see TBlobBs::EnableCheckpoints
+    void EnableCheckpoints() { if (Access != faRdOnly) { ItemSetBlobBs->EnableCheckpoints(); } }
+    /// release space of item sets replaced before the last SaveAll
+    void EndCheckpoint() { if (Access != faRdOnly) { ItemSetBlobBs->EndCheckpoint(); } }
+    /// memory used by item sets changed since they were last stored to disk
+    uint64 GetDirtyBytes();
 
     /// get first key id
     int FFirstKeyId() const { return KeyIdH.FFirstKeyId(); }
@@ -527,6 +637,11 @@ private:
     void PutAnd(const PGixExpItem& _LeftExpItem, const PGixExpItem& _RightExpItem);
     /// Convert expression item to OR
     void PutOr(const PGixExpItem& _LeftExpItem, const PGixExpItem& _RightExpItem);
+    /// Collect keys when expression is an AND of keys only
+    bool GetAndKeyV(TVec<TKey>& KeyV) const;
+    /// Evaluate AND of keys by probing larger item sets with the items of smaller
+    void EvalAndKeyV(const PGix& Gix, const TVec<TKey>& KeyV, TVec<TResItem>& ResItemV,
+        const TGixMerger<TKey, TItem, TResItem>* Merger) const;
 
     TGixExpItem(const TGixExpType& _ExpType, const PGixExpItem& _LeftExpItem,
         const PGixExpItem& _RightExpItem) : ExpType(_ExpType),
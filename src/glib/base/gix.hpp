@@ -31,6 +31,7 @@ template <class TKey, class TItem>
 void TGixItemSet<TKey, TItem>::LoadChildVector(const int& ChildN) const {
     if (!ChildInfoV[ChildN].LoadedP) {
         // load child vector from disk
+        ChildV[ChildN].Gen(ChildInfoV[ChildN].Len, 0);
         Gix->GetChildVector(ChildInfoV[ChildN].Pt, ChildV[ChildN]);
         // mark that it is freshly loaded
         ChildInfoV[ChildN].LoadedP = true;
@@ -94,10 +95,11 @@ template <class TKey, class TItem>
 void TGixItemSet<TKey, TItem>::PushWorkBufferToChildren() {
     // push work-buffer into children array
     int SplitLen = Gix->GetSplitLen();
-    while (ItemV.Len() >= SplitLen) {
+    int ItemN = 0;
+    while (ItemV.Len() - ItemN >= SplitLen) {
         // create a vector of SplitLen items
         TVec<TItem> SplitItemV;
-        ItemV.GetSubValV(0, SplitLen - 1, SplitItemV);
+        ItemV.GetSubValV(ItemN, ItemN + SplitLen - 1, SplitItemV);
         // create the child info for the vector and also push the vector to a blob
         TChildInfo ChildInfo(SplitItemV[0], SplitItemV.Last(), SplitLen, Gix->EnlistChildVector(SplitItemV));
         ChildInfo.LoadedP = false;
@@ -105,9 +107,11 @@ void TGixItemSet<TKey, TItem>::PushWorkBufferToChildren() {
         ChildInfoV.Add(ChildInfo);
         // add an empty vector to ChildV - the data for this vector will be loaded from the blob when necessary
         ChildV.Add(TVec<TItem>());
-        ItemV.Del(0, SplitLen - 1);
+        ItemN += SplitLen;
         DirtyP = true;
     }
+    // drop pushed items from the work buffer at once
+    if (ItemN > 0) { ItemV.Del(0, ItemN - 1); }
 }
 
 template <class TKey, class TItem>
@@ -360,10 +364,39 @@ void TGixItemSet<TKey, TItem>::AddItem(const TItem& NewItem, const bool& NotifyC
 }
 
 template <class TKey, class TItem>
-void TGixItemSet<TKey, TItem>::AddItemV(const TVec<TItem>& NewItemV) {
-    for (int i = 0; i < NewItemV.Len(); i++) {
-        AddItem(NewItemV[i]);
+void TGixItemSet<TKey, TItem>::AddItemV(const TVec<TItem>& NewItemV, const bool& NotifyCacheOnlyDelta) {
+    // report base size of a new itemset, same as AddItem
+    if (NotifyCacheOnlyDelta == false) {
+        Gix->AddToNewCacheSizeInc(GetMemUsed());
+    }
+    if (NewItemV.Empty()) { return; }
+    const uint64 OldSize = GetMemUsed();
+    if (MergedP) {
+        // itemset remains merged when the new items are sorted and all come after the last one
+        bool SortedP = true;
+        for (int ItemN = 1; SortedP && ItemN < NewItemV.Len(); ItemN++) {
+            SortedP = Gix->GetItemHandler()->IsLt(NewItemV[ItemN - 1], NewItemV[ItemN]);
+        }
+        if (SortedP && ItemV.Len() > 0) {
+            SortedP = Gix->GetItemHandler()->IsLt(ItemV.Last(), NewItemV[0]);
+        } else if (SortedP && ChildInfoV.Len() > 0) {
+            SortedP = Gix->GetItemHandler()->IsLt(ChildInfoV.Last().MaxItem, NewItemV[0]);
+        }
+        MergedP = SortedP;
+    }
+    // append the whole batch to the work buffer
+    ItemV.AddV(NewItemV);
+    DirtyP = true;
+    TotalCnt += NewItemV.Len();
+    // merge and split the work buffer once for the batch, instead of each time it fills up
+    if (IsFull()) {
+        Def();
+        if (IsFull()) {
+            PushWorkBufferToChildren();
+        }
+        RecalcTotalCnt();
     }
+    Gix->AddToNewCacheSizeInc(OldSize, GetMemUsed());
 }
 
 template <class TKey, class TItem>
@@ -409,6 +442,34 @@ void TGixItemSet<TKey, TItem>::GetItemV(THandler& Handler) {
     Handler(ItemV);
 }
 
+template <class TKey, class TItem>
+void TGixItemSet<TKey, TItem>::GetIntrsItemV(const TVec<TItem>& ProbeItemV, TVec<TItem>& _ItemV) {
+    const TGixItemHandler<TKey, TItem>* ItemHandler = Gix->GetItemHandler();
+    auto IsLt = [ItemHandler](const TItem& Item1, const TItem& Item2) {
+        return ItemHandler->IsLt(Item1, Item2); };
+    _ItemV.Gen(ProbeItemV.Len(), 0);
+    // children are sorted and disjoint, and followed by the work buffer
+    int ChildN = 0, ItemN = 0;
+    for (const TItem& ProbeItem : ProbeItemV) {
+        // skip child vectors which end before the item
+        while (ChildN < ChildInfoV.Len() && IsLt(ChildInfoV[ChildN].MaxItem, ProbeItem)) {
+            ChildN++; ItemN = 0;
+        }
+        const bool ChildP = (ChildN < ChildInfoV.Len());
+        // item falls before the start of the child vector, so it is not there
+        if (ChildP && IsLt(ProbeItem, ChildInfoV[ChildN].MinItem)) { continue; }
+        if (ChildP) { LoadChildVector(ChildN); }
+        const TVec<TItem>& SearchItemV = ChildP ? ChildV[ChildN] : ItemV;
+        ItemN = TGixGallop::GetFirstNotLt(SearchItemV, ProbeItem, ItemN, IsLt);
+        if (ItemN < SearchItemV.Len() && !IsLt(ProbeItem, SearchItemV[ItemN])) {
+            _ItemV.Add(SearchItemV[ItemN]);
+        } else if (!ChildP && ItemN == SearchItemV.Len()) {
+            // went past the end of the work buffer
+            break;
+        }
+    }
+}
+
 template <class TKey, class TItem>
 void TGixItemSet<TKey, TItem>::DelItem(const TItem& Item) {
     if (IsFull()) {
@@ -431,6 +492,54 @@ void TGixItemSet<TKey, TItem>::DelItem(const TItem& Item) {
     TotalCnt++;
 }
 
+template <class TKey, class TItem>
+void TGixItemSet<TKey, TItem>::DelItemV(const TVec<TItem>& ItemV) {
+    for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) {
+        DelItem(ItemV[ItemN]);
+    }
+}
+
+template <class TKey, class TItem>
+void TGixItemSet<TKey, TItem>::DelItemsBefore(const TItem& Item) {
+    // process pending changes first, so children and work buffer are sorted and disjoint
+    Def();
+    const uint64 OldSize = GetMemUsed();
+    const TGixItemHandler<TKey, TItem>* ItemHandler = Gix->GetItemHandler();
+    // drop child vectors with all items smaller than given item
+    int DelChildren = 0;
+    while (DelChildren < ChildInfoV.Len() && ItemHandler->IsLt(ChildInfoV[DelChildren].MaxItem, Item)) {
+        Gix->DeleteChildVector(ChildInfoV[DelChildren].Pt);
+        DelChildren++;
+    }
+    if (DelChildren > 0) {
+        ChildInfoV.Del(0, DelChildren - 1);
+        ChildV.Del(0, DelChildren - 1);
+        DirtyP = true;
+    }
+    // remaining smaller items are either in the first child or in the work buffer
+    const bool ChildP = (ChildInfoV.Len() > 0);
+    if (!ChildP || ItemHandler->IsLt(ChildInfoV[0].MinItem, Item)) {
+        if (ChildP) { LoadChildVector(0); }
+        TVec<TItem>& FirstItemV = ChildP ? ChildV[0] : ItemV;
+        int DelItems = 0;
+        while (DelItems < FirstItemV.Len() && ItemHandler->IsLt(FirstItemV[DelItems], Item)) {
+            DelItems++;
+        }
+        if (DelItems > 0) {
+            FirstItemV.Del(0, DelItems - 1);
+            if (ChildP) {
+                // child still has items, since its largest item is not smaller than Item
+                ChildInfoV[0].Len = FirstItemV.Len();
+                ChildInfoV[0].MinItem = FirstItemV[0];
+                ChildInfoV[0].DirtyP = true;
+            }
+            DirtyP = true;
+        }
+    }
+    RecalcTotalCnt();
+    Gix->AddToNewCacheSizeInc(OldSize, GetMemUsed());
+}
+
 template <class TKey, class TItem>
 void TGixItemSet<TKey, TItem>::Clr() {
     const int OldSize = GetMemUsed();
@@ -465,10 +574,19 @@ void TGixItemSet<TKey, TItem>::Def() {
             }
 
             // collect all data from subsequent child vectors and work-buffer
-            TVec<TItem> MergedItems;
+            int MergedLen = ItemV.Len();
             for (int i = FirstChildToMerge; i < ChildInfoV.Len(); i++) {
-                LoadChildVector(i);
-                MergedItems.AddV(ChildV[i]);
+                MergedLen += ChildInfoV[i].Len;
+            }
+            TVec<TItem> MergedItems(MergedLen, 0);
+            for (int i = FirstChildToMerge; i < ChildInfoV.Len(); i++) {
+                if (ChildInfoV[i].LoadedP) {
+                    MergedItems.AddV(ChildV[i]);
+                } else {
+                    // child vectors get overwritten with merged items below, so
+                    // decode the ones not in memory directly into the merge buffer
+                    Gix->GetChildVector(ChildInfoV[i].Pt, MergedItems);
+                }
             }
             MergedItems.AddV(ItemV);
             Gix->GetItemHandler()->Merge(MergedItems, false); // perform global merge
@@ -573,11 +691,36 @@ TBlobPt TGix<TKey, TItem>::GetKeyId(const TKey& Key) const {
     return TBlobPt();
 }
 
+template <class TKey, class TItem>
+const int TGix<TKey, TItem>::CompressedFlag = -1;
+
+template <class TKey, class TItem>
+void TGix<TKey, TItem>::SaveChildVector(const TVec<TItem>& Data, TMOut& MOut) const {
+    if (CompressP && ItemHandler->IsCompressible(Data)) {
+        TInt(CompressedFlag).Save(MOut);
+        TInt(Data.Len()).Save(MOut);
+        ItemHandler->SaveCompressed(Data, MOut);
+    } else {
+        //Data.SaveMemCpy(MOut);
+        Data.Save(MOut);
+    }
+}
+
 template <class TKey, class TItem>
 void TGix<TKey, TItem>::GetChildVector(const TBlobPt& KeyId, TVec<TItem>& Dest) const {
     if (KeyId.Empty()) { return; }
     PSIn ItemSetSIn = ItemSetBlobBs->GetBlob(KeyId);
-    Dest.Load(*ItemSetSIn);
+    // plain vector starts with capacity and length, compressed with flag and length
+    const TInt MxItems(*ItemSetSIn);
+    const TInt Items(*ItemSetSIn);
+    Dest.Reserve(Dest.Len() + Items);
+    if (MxItems == CompressedFlag) {
+        ItemHandler->LoadCompressed(*ItemSetSIn, Items, Dest);
+    } else {
+        for (int ItemN = 0; ItemN < Items; ItemN++) {
+            Dest.Add(TItem(*ItemSetSIn));
+        }
+    }
 }
 
 template <class TKey, class TItem>
@@ -586,8 +729,7 @@ TBlobPt TGix<TKey, TItem>::StoreChildVector(const TBlobPt& ExistingKeyId, const
     AssertReadOnly();
     // store the current version to the blob
     TMOut MOut;
-    //Data.SaveMemCpy(MOut);
-    Data.Save(MOut);
+    SaveChildVector(Data, MOut);
     int ReleasedSize;
     return ItemSetBlobBs->PutBlob(ExistingKeyId, MOut.GetSIn(), ReleasedSize);
 }
@@ -602,7 +744,7 @@ template <class TKey, class TItem>
 TBlobPt TGix<TKey, TItem>::EnlistChildVector(const TVec<TItem>& Data) const {
     AssertReadOnly(); // check if we are allowed to write
     TMOut MOut;
-    Data.Save(MOut);
+    SaveChildVector(Data, MOut);
     TBlobPt res = ItemSetBlobBs->PutBlob(MOut.GetSIn());
     return res;
 }
@@ -643,7 +785,7 @@ TGix<TKey, TItem>::TGix(const TStr& Nm, const TStr& FPath, const TFAccess& _Acce
     const bool _FirstChildBeUnfilledP, const int _SplitLenMin, const int _SplitLenMax) :
         Access(_Access), ItemHandler(_ItemHandler), ItemSetCache(CacheSize, 1000000, GetVoidThis()),
         SplitLen(_SplitLen), SplitLenMin(_SplitLenMin), SplitLenMax(_SplitLenMax),
-        FirstChildBeUnfilledP(_FirstChildBeUnfilledP) {
+        FirstChildBeUnfilledP(_FirstChildBeUnfilledP), CompressP(false) {
 
     // prepare filenames of the GIX datastore
     GixFNm = TStr::GetNrFPath(FPath) + Nm.GetFBase() + ".Gix";
@@ -787,6 +929,7 @@ void TGix<TKey, TItem>::AddItem(const TKey& Key, const TItem& Item) {
 template <class TKey, class TItem>
 void TGix<TKey, TItem>::AddItemV(const TKey& Key, const TVec<TItem>& ItemV) {
     AssertReadOnly(); // check if we are allowed to write
+    if (ItemV.Empty()) { return; }
     if (IsKey(Key)) {
         // get the key handle
         TBlobPt KeyId = KeyIdH.GetDat(Key);
@@ -796,9 +939,10 @@ void TGix<TKey, TItem>::AddItemV(const TKey& Key, const TVec<TItem>& ItemV) {
     } else {
         // we don't have this key, create a new itemset and add new item immidiatelly
         PGixItemSet ItemSet = TGixItemSet<TKey, TItem>::New(Key, this);
-        ItemSet->AddItemV(ItemV);
+        ItemSet->AddItemV(ItemV, false);
         TBlobPt KeyId = EnlistItemSet(ItemSet); // now store this itemset to disk
         KeyIdH.AddDat(Key, KeyId); // remember the new key and its Id
+        ItemSetCache.Put(KeyId, ItemSet); // add it to cache
     }
     // check if we have to drop anything from the cache
     RefreshMemUsed();
@@ -818,6 +962,35 @@ void TGix<TKey, TItem>::DelItem(const TKey& Key, const TItem& Item) {
     }
 }
 
+template <class TKey, class TItem>
+void TGix<TKey, TItem>::DelItemV(const TKey& Key, const TVec<TItem>& ItemV) {
+    AssertReadOnly(); // check if we are allowed to write
+    if (ItemV.Empty()) { return; }
+    if (IsKey(Key)) { // check if this key exists
+        // load the current item set
+        PGixItemSet ItemSet = GetItemSet(Key);
+        // clear the items from the ItemSet
+        ItemSet->DelItemV(ItemV);
+        if (ItemSet->Empty()) {
+            DeleteItemSet(Key);
+        }
+    }
+}
+
+template <class TKey, class TItem>
+void TGix<TKey, TItem>::DelItemsBefore(const TKey& Key, const TItem& Item) {
+    AssertReadOnly(); // check if we are allowed to write
+    if (IsKey(Key)) { // check if this key exists
+        // load the current item set
+        PGixItemSet ItemSet = GetItemSet(Key);
+        // delete the items from the ItemSet
+        ItemSet->DelItemsBefore(Item);
+        if (ItemSet->Empty()) {
+            DeleteItemSet(Key);
+        }
+    }
+}
+
 template <class TKey, class TItem>
 void TGix<TKey, TItem>::Clr(const TKey& Key) {
     AssertReadOnly(); // check if we are allowed to write
@@ -841,7 +1014,8 @@ int TGix<TKey, TItem>::PartialFlush(int WndInMsec) {
 
     KeyDatP = ItemSetCache.FLastKeyDat();
     while (ItemSetCache.FPrevKeyDat(KeyDatP, BlobPt, ItemSet)) {
-        if (sw.GetMSecInt() > WndInMsec) break;
+        // always store at least one item set, so short windows still make progress
+        if (Changes > 0 && sw.GetMSecInt() > WndInMsec) break;
         if (ItemSet->IsDirty()) {
             TBlobPt NewBlobPt = StoreItemSet(BlobPt);
             if (NewBlobPt.Empty()) { // if itemset is empty, we get NULL pointer
@@ -856,6 +1030,27 @@ int TGix<TKey, TItem>::PartialFlush(int WndInMsec) {
     return Changes;
 }
 
+template <class TKey, class TItem>
+void TGix<TKey, TItem>::SaveAll() {
+    if ((Access == faCreate) || (Access == faUpdate)) {
+        PartialFlush(TInt::Mx);
+        TFOut FOut(GixFNm); KeyIdH.Save(FOut);
+        ItemSetBlobBs->Flush();
+    }
+}
+
+template <class TKey, class TItem>
+uint64 TGix<TKey, TItem>::GetDirtyBytes() {
+    TBlobPt BlobPt;
+    PGixItemSet ItemSet;
+    uint64 DirtyBytes = 0;
+    void* KeyDatP = ItemSetCache.FFirstKeyDat();
+    while (ItemSetCache.FNextKeyDat(KeyDatP, BlobPt, ItemSet)) {
+        if (ItemSet->IsDirty()) { DirtyBytes += ItemSet->GetMemUsed(); }
+    }
+    return DirtyBytes;
+}
+
 template <class TKey, class TItem>
 int64 TGix<TKey, TItem>::GetMemUsed() const {
     int64 res = sizeof(TCRef);
@@ -1054,6 +1249,45 @@ TPt<TGixExpItem<TKey, TItem, TResItem> > TGixExpItem<TKey, TItem, TResItem>::New
     return NewOrV(ExpItemV);
 }
 
+template <class TKey, class TItem, class TResItem>
+bool TGixExpItem<TKey, TItem, TResItem>::GetAndKeyV(TVec<TKey>& KeyV) const {
+    if (ExpType == getKey) {
+        KeyV.Add(Key);
+        return true;
+    } else if (ExpType == getAnd) {
+        return LeftExpItem->GetAndKeyV(KeyV) && RightExpItem->GetAndKeyV(KeyV);
+    }
+    return false;
+}
+
+template <class TKey, class TItem, class TResItem>
+void TGixExpItem<TKey, TItem, TResItem>::EvalAndKeyV(const PGix& Gix, const TVec<TKey>& KeyV,
+        TVec<TResItem>& ResItemV, const TGixMerger<TKey, TItem, TResItem>* Merger) const {
+
+    // get item sets and order them by length
+    TVec<PGixItemSet> ItemSetV(KeyV.Len(), 0); TIntPrV ItemsSetNV(KeyV.Len(), 0);
+    for (int KeyN = 0; KeyN < KeyV.Len(); KeyN++) {
+        PGixItemSet ItemSet = Gix->GetItemSet(KeyV[KeyN]);
+        ItemSet->Def();
+        ItemsSetNV.Add(TIntPr(ItemSet->GetItems(), ItemSetV.Len()));
+        ItemSetV.Add(ItemSet);
+    }
+    ItemsSetNV.Sort();
+    // shortest item set gives the candidates
+    const PGixItemSet& FirstItemSet = ItemSetV[ItemsSetNV[0].Val2];
+    TVec<TItem> ItemV; FirstItemSet->GetItemV(ItemV);
+    { TVec<TItem> DefItemV(ItemV); Merger->Def(FirstItemSet->GetKey(), DefItemV, ResItemV); }
+    // which are looked up in the longer ones, keeping only the matching
+    for (int SetN = 1; SetN < ItemsSetNV.Len() && !ItemV.Empty(); SetN++) {
+        const PGixItemSet& ItemSet = ItemSetV[ItemsSetNV[SetN].Val2];
+        TVec<TItem> IntrsItemV; ItemSet->GetIntrsItemV(ItemV, IntrsItemV);
+        TVec<TResItem> IntrsResItemV;
+        { TVec<TItem> DefItemV(IntrsItemV); Merger->Def(ItemSet->GetKey(), DefItemV, IntrsResItemV); }
+        Merger->Intrs(ResItemV, IntrsResItemV);
+        ItemV = IntrsItemV;
+    }
+}
+
 template <class TKey, class TItem, class TResItem>
 bool TGixExpItem<TKey, TItem, TResItem>::Eval(const TPt<TGix<TKey, TItem> >& Gix,
     TVec<TResItem>& ResItemV, const TGixMerger<TKey, TItem, TResItem>* Merger) {
@@ -1081,6 +1315,12 @@ bool TGixExpItem<TKey, TItem, TResItem>::Eval(const TPt<TGix<TKey, TItem> >& Gix
         return (NotLeft || NotRight);
     } else if (ExpType == getAnd) {
         EAssert(!LeftExpItem.Empty() && !RightExpItem.Empty());
+        // conjunction of keys does not need to load complete item sets
+        TVec<TKey> AndKeyV;
+        if (GetAndKeyV(AndKeyV)) {
+            EvalAndKeyV(Gix, AndKeyV, ResItemV, Merger);
+            return false;
+        }
         TVec<TResItem> RightItemV;
         const bool NotLeft = LeftExpItem->Eval(Gix, ResItemV, Merger);
         const bool NotRight = RightExpItem->Eval(Gix, RightItemV, Merger);
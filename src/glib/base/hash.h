@@ -1056,6 +1056,7 @@ public:
     TCache& operator=(const TCache&);
     int64 GetMemUsed() const;
     int64 GetMxMemUsed() const { return MxMemUsed; }
+    int64 GetCurMemUsed() const { return CurMemUsed; }
     bool RefreshMemUsed();
 
     void Put(const TKey& Key, const TDat& Dat);
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/////////////////////////////////////////////////
+// LZ block codec
+const uchar TLz::MethodStored = 0;
+const uchar TLz::MethodLz = 1;
+const int TLz::MnMatchLen = 4;
+const int TLz::HashBits = 14;
+
+uint TLz::GetHash(const char* Bf) {
+  uint Seq; memcpy(&Seq, Bf, sizeof(uint));
+  return (Seq * 2654435761u) >> (32 - HashBits);
+}
+
+char* TLz::SaveVarUInt(char* Bf, uint Val) {
+  while (Val >= 0x80) { *Bf++ = char((Val & 0x7f) | 0x80); Val >>= 7; }
+  *Bf++ = char(Val);
+  return Bf;
+}
+
+uint TLz::LoadVarUInt(const char*& Bf, const char* EndBf) {
+  uint Val = 0; int Shift = 0;
+  forever {
+    EAssertR(Bf < EndBf && Shift < 32, "Corrupted LZ block");
+    const uchar Ch = (uchar)(*Bf++);
+    Val |= uint(Ch & 0x7f) << Shift;
+    if ((Ch & 0x80) == 0) { return Val; }
+    Shift += 7;
+  }
+}
+
+int TLz::CompressBf(const char* Bf, const int& BfL, char* OutBf) {
+  // last seen position of each 4-byte hash, shifted by one so zero means none
+  TIntV HashV(1 << HashBits);
+  // output must stay shorter than the raw block
+  const char* EndOutBf = OutBf + BfL;
+  char* OutPos = OutBf;
+  const int MxMatchPos = BfL - MnMatchLen;
+  int AnchorPos = 0, Pos = 0;
+  while (Pos <= MxMatchPos) {
+    const uint Hash = GetHash(Bf + Pos);
+    const int CandPos = HashV[Hash] - 1;
+    HashV[Hash] = Pos + 1;
+    if (CandPos >= 0 && memcmp(Bf + CandPos, Bf + Pos, MnMatchLen) == 0) {
+      int MatchLen = MnMatchLen;
+      while (Pos + MatchLen < BfL && Bf[CandPos + MatchLen] == Bf[Pos + MatchLen]) { MatchLen++; }
+      // literals and three numbers of at most 5 bytes each
+      const int LitLen = Pos - AnchorPos;
+      if (OutPos + LitLen + 15 >= EndOutBf) { return -1; }
+      OutPos = SaveVarUInt(OutPos, (uint)LitLen);
+      memcpy(OutPos, Bf + AnchorPos, LitLen); OutPos += LitLen;
+      OutPos = SaveVarUInt(OutPos, (uint)(MatchLen - MnMatchLen));
+      OutPos = SaveVarUInt(OutPos, (uint)(Pos - CandPos));
+      Pos += MatchLen; AnchorPos = Pos;
+      // remember position inside the match, so repeating runs chain together
+      if (Pos - 2 <= MxMatchPos) { HashV[GetHash(Bf + Pos - 2)] = Pos - 1; }
+    } else {
+      // skip faster over data which does not compress
+      Pos += 1 + ((Pos - AnchorPos) >> 6);
+    }
+  }
+  // trailing literals
+  const int LitLen = BfL - AnchorPos;
+  if (OutPos + LitLen + 5 >= EndOutBf) { return -1; }
+  OutPos = SaveVarUInt(OutPos, (uint)LitLen);
+  memcpy(OutPos, Bf + AnchorPos, LitLen); OutPos += LitLen;
+  return int(OutPos - OutBf);
+}
+
+void TLz::Compress(const char* Bf, const int& BfL, TMem& OutMem) {
+  EAssert(BfL >= 0);
+  // header and payload, which is never longer than the raw block
+  OutMem.Gen(BfL + 16);
+  char* OutBf = OutMem();
+  char* PayloadBf = SaveVarUInt(OutBf + 1, (uint)BfL);
+  const int HeaderL = int(PayloadBf - OutBf);
+  const int PayloadL = (BfL > 0) ? CompressBf(Bf, BfL, PayloadBf) : -1;
+  if (PayloadL == -1) {
+    OutBf[0] = (char)MethodStored;
+    if (BfL > 0) { memcpy(PayloadBf, Bf, BfL); }
+    OutMem.Trunc(HeaderL + BfL);
+  } else {
+    OutBf[0] = (char)MethodLz;
+    OutMem.Trunc(HeaderL + PayloadL);
+  }
+}
+
+void TLz::Decompress(const char* Bf, const int& BfL, TMem& OutMem) {
+  EAssertR(BfL > 0, "Empty LZ block");
+  const char* EndBf = Bf + BfL;
+  const uchar Method = (uchar)(*Bf++);
+  const uint RawL = LoadVarUInt(Bf, EndBf);
+  EAssertR(RawL <= (uint)TInt::Mx, "Corrupted LZ block");
+  OutMem.Gen((int)RawL);
+  char* OutBf = OutMem();
+  if (Method == MethodStored) {
+    EAssertR(uint(EndBf - Bf) == RawL, "Corrupted LZ block");
+    if (RawL > 0) { memcpy(OutBf, Bf, RawL); }
+    return;
+  }
+  EAssertR(Method == MethodLz, "Unknown block compression method " + TInt::GetStr(Method));
+  char* OutPos = OutBf;
+  const char* EndOutBf = OutBf + RawL;
+  forever {
+    const uint LitLen = LoadVarUInt(Bf, EndBf);
+    EAssertR(LitLen <= uint(EndBf - Bf) && LitLen <= uint(EndOutBf - OutPos), "Corrupted LZ block");
+    if (LitLen > 0) { memcpy(OutPos, Bf, LitLen); }
+    OutPos += LitLen; Bf += LitLen;
+    if (Bf == EndBf) { break; }
+    const uint MatchLen = LoadVarUInt(Bf, EndBf) + MnMatchLen;
+    const uint Offset = LoadVarUInt(Bf, EndBf);
+    EAssertR(0 < Offset && Offset <= uint(OutPos - OutBf) &&
+      MatchLen <= uint(EndOutBf - OutPos), "Corrupted LZ block");
+    const char* MatchPos = OutPos - Offset;
+    if (Offset >= MatchLen) {
+      memcpy(OutPos, MatchPos, MatchLen);
+    } else {
+      // match overlaps the bytes it is producing
+      for (uint ChN = 0; ChN < MatchLen; ChN++) { OutPos[ChN] = MatchPos[ChN]; }
+    }
+    OutPos += MatchLen;
+  }
+  EAssertR(OutPos == EndOutBf, "Corrupted LZ block");
+}
+
+PSIn TLz::GetCompressedSIn(const char* Bf, const int& BfL) {
+  PMem OutMem = TMem::New(); Compress(Bf, BfL, *OutMem);
+  return TMemIn::New(OutMem);
+}
+
+void TLz::LoadDecompressed(const PSIn& SIn, TMem& OutMem) {
+  TMem Mem; TMem::LoadMem(SIn, Mem);
+  Decompress(Mem, OutMem);
+}
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/////////////////////////////////////////////////
+/// LZ block codec.
+/// Byte-oriented LZ77 compression of serialized blocks. Blocks of similar
+/// records (e.g. log data) repeat field values, string prefixes and the high
+/// bytes of timestamps and counters, which are replaced by back-references.
+/// Encoded block starts with a method byte and variable-length encoded size
+/// of the raw block. Compressed payload is a sequence of
+/// [literal count][literals][match length - MnMatchLen][match offset], where
+/// all numbers are variable-length encoded and the last sequence has no match.
+/// Blocks which do not compress are stored as they are.
+class TLz {
+private:
+  /// Stored without compression
+  static const uchar MethodStored;
+  /// Compressed with LZ
+  static const uchar MethodLz;
+  /// Shortest match worth a back-reference
+  static const int MnMatchLen;
+  /// Number of bits used for the match-finder hash table
+  static const int HashBits;
+
+  /// Hash of 4 bytes starting at Bf
+  static uint GetHash(const char* Bf);
+  /// Write variable-length encoded number, returns position after it
+  static char* SaveVarUInt(char* Bf, uint Val);
+  /// Read variable-length encoded number, fails when running over EndBf
+  static uint LoadVarUInt(const char*& Bf, const char* EndBf);
+
+  /// Compress into preallocated buffer of at least BfL + 16 bytes,
+  /// returns compressed length or -1 when it is not smaller than BfL
+  static int CompressBf(const char* Bf, const int& BfL, char* OutBf);
+
+public:
+  /// Encode BfL bytes starting at Bf into OutMem
+  static void Compress(const char* Bf, const int& BfL, TMem& OutMem);
+  /// Encode content of Mem into OutMem
+  static void Compress(const TMemBase& Mem, TMem& OutMem) {
+    Compress(Mem.GetBf(), Mem.Len(), OutMem); }
+  /// Decode block created by Compress into OutMem
+  static void Decompress(const char* Bf, const int& BfL, TMem& OutMem);
+  /// Decode content of Mem into OutMem
+  static void Decompress(const TMemBase& Mem, TMem& OutMem) {
+    Decompress(Mem.GetBf(), Mem.Len(), OutMem); }
+
+  /// Encode BfL bytes starting at Bf and return them as input stream,
+  /// ready to be stored in blob storage
+  static PSIn GetCompressedSIn(const char* Bf, const int& BfL);
+  /// Read encoded block from input stream and decode it into OutMem
+  static void LoadDecompressed(const PSIn& SIn, TMem& OutMem);
+};
@@ -6,6 +6,10 @@
 * LICENSE file in the root directory of this source tree.
 */
 
+#if defined(GLib_UNIX)
+#include <sys/mman.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 
 /// Assignment operator
@@ -112,6 +116,8 @@ TPgBlobFile::TPgBlobFile(
     Access = _Access;
     FNm = _FNm;
     MxFileLen = _MxSegLen;
+    MapBf = NULL;
+    MapLen = 0;
 
     switch (Access) {
     case faCreate:
@@ -137,11 +143,19 @@ TPgBlobFile::TPgBlobFile(
 
 /// Destructor
 TPgBlobFile::~TPgBlobFile() {
+    UnmapFile();
     EAssertR(
         fclose(FileId) == 0,
         "Can not close file '" + TStr(FNm.CStr()) + "'.");
 }
 
+/// Write buffered pages to the file
+void TPgBlobFile::Flush() {
+    EAssertR(
+        fflush(FileId) == 0,
+        "Can not flush file '" + TStr(FNm.CStr()) + "'.");
+}
+
 /// Load page with given index from the file into buffer
 int TPgBlobFile::LoadPage(const uint32& Page, void* Bf) {
     SetFPos(Page * PG_PAGE_SIZE);
@@ -175,6 +189,43 @@ void TPgBlobFile::SetFPos(const int& FPos) {
         "Error seeking into file '" + TStr(FNm) + "'.");
 }
 
+/// Map the file into memory. Only supported for read-only access.
+bool TPgBlobFile::MapFile() {
+    if (Access != TFAccess::faRdOnly) { return false; }
+    if (MapBf != NULL) { return true; }
+#if defined(GLib_UNIX)
+    MapLen = (uint64)PgCnt * PG_PAGE_SIZE;
+    if (MapLen == 0) { return true; } // nothing to map, no page can be requested
+    void* Bf = mmap(NULL, MapLen, PROT_READ, MAP_SHARED, fileno(FileId), 0);
+    if (Bf == MAP_FAILED) {
+        MapLen = 0;
+        return false;
+    }
+    MapBf = (char*)Bf;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// Release the memory mapping
+void TPgBlobFile::UnmapFile() {
+#if defined(GLib_UNIX)
+    if (MapBf != NULL) {
+        munmap(MapBf, MapLen);
+    }
+#endif
+    MapBf = NULL;
+    MapLen = 0;
+}
+
+/// Returns pointer to the page inside the memory mapping
+char* TPgBlobFile::GetMappedPage(const uint32& Page) const {
+    EAssertR((uint64)Page * PG_PAGE_SIZE + PG_PAGE_SIZE <= MapLen,
+        "Page outside of memory-mapped file '" + FNm + "'.");
+    return MapBf + (uint64)Page * PG_PAGE_SIZE;
+}
+
 /// Reserve new space in the file. Returns -1 if file is full.
 long TPgBlobFile::CreateNewPage() {
     EAssertR(
@@ -294,11 +345,15 @@ TPgBlob::TPgBlobPageItem* TPgBlob::GetItemRec(
 
 /// Private constructor
 TPgBlob::TPgBlob(const TStr& _FNm, const TFAccess& _Access,
-    const uint64& CacheSize) {
+    const uint64& CacheSize, const bool& _MMapP) {
     EAssertR(CacheSize >= PG_PAGE_SIZE, "Invalid cache size for TPgBlob.");
 
     FNm = _FNm;
     Access = _Access;
+    MMapP = false;
+    CheckpointP = false;
+    CheckpointId = 0;
+    UndoFOut = NULL;
 
     switch (Access) {
     case faCreate:
@@ -313,6 +368,20 @@ TPgBlob::TPgBlob(const TStr& _FNm, const TFAccess& _Access,
         FailR("Unsupported TFAccess flag for TPgBlob.");
     }
 
+    // read-only storage can be served directly from memory-mapped files
+    if (Access == TFAccess::faRdOnly && _MMapP) {
+        MMapP = true;
+        for (int FileN = 0; FileN < Files.Len(); FileN++) {
+            MMapP = MMapP && Files[FileN]->MapFile();
+        }
+        // fall back to page cache if any of the files could not be mapped
+        if (!MMapP) {
+            for (int FileN = 0; FileN < Files.Len(); FileN++) {
+                Files[FileN]->UnmapFile();
+            }
+        }
+    }
+
     // init cache
     LastExtentCnt = PG_EXTENT_PCOUNT; // this means the "last" extent is full, so use new one
     MxLoadedPages = CacheSize / PG_PAGE_SIZE;
@@ -324,12 +393,16 @@ TPgBlob::~TPgBlob() {
     if (Access != TFAccess::faRdOnly) {
         for (int i = 0; i < LoadedPages.Len(); i++) {
             if (ShouldSavePage(i)) {
-                LoadedPage& a = LoadedPages[i];
-                Files[a.Pt.GetFIx()]->SavePage(a.Pt.GetPg(), GetPageBf(i));
+                StorePage(i);
             }
         }
         SaveMain();
         Files.Clr();
+        // closed cleanly, pages of the last checkpoint are no longer needed
+        if (UndoFOut != NULL) {
+            delete UndoFOut; UndoFOut = NULL;
+            TFile::Del(GetUndoFNm(FNm), false);
+        }
     }
 }
 
@@ -442,14 +515,98 @@ int TPgBlob::Evict() {
     char* PgPt = GetPageBf(Pg);
     if (ShouldSavePageP(PgPt)) {
         int Len = (((TPgHeader*)PgPt)->ItemCount > 0 ? -1 : sizeof(TPgHeader));
-        Files[a.Pt.GetFIx()]->SavePage(a.Pt.GetPg(), PgPt, Len);
+        StorePage(Pg, Len);
     } else {
     }
     return Pg;
 }
 
+/// Write loaded page to its file
+void TPgBlob::StorePage(const int& Pg, const int& Len) {
+    const TPgBlobPgPt& Pt = LoadedPages[Pg].Pt;
+    SaveUndoPage(Pt);
+    Files[Pt.GetFIx()]->SavePage(Pt.GetPg(), GetPageBf(Pg), Len);
+}
+
+/// Save page of the last checkpoint to the undo file, before it is overwritten
+void TPgBlob::SaveUndoPage(const TPgBlobPgPt& Pt) {
+    if (!CheckpointP) { return; }
+    // pages added after the checkpoint are not used by it
+    const int FIx = Pt.GetFIx();
+    if (FIx >= CheckpointPgCntV.Len() || (int64)Pt.GetPg() >= CheckpointPgCntV[FIx]) { return; }
+    if (UndoPgH.IsKey(Pt)) { return; }
+    if (UndoFOut == NULL) {
+        UndoFOut = new TFOut(GetUndoFNm(FNm));
+        TUInt64(CheckpointId).Save(*UndoFOut);
+    }
+    TMem PgMem; PgMem.Gen(PG_PAGE_SIZE);
+    Files[FIx]->LoadPage(Pt.GetPg(), PgMem.GetBf());
+    TInt(FIx).Save(*UndoFOut);
+    TUInt(Pt.GetPg()).Save(*UndoFOut);
+    UndoFOut->PutBf(PgMem.GetBf(), PG_PAGE_SIZE);
+    // old page must reach the undo file before the new one reaches the data file
+    UndoFOut->Flush();
+    UndoPgH.AddKey(Pt);
+}
+
+/// Keep pages as they were at the last Flush
+void TPgBlob::EnableCheckpoints(const uint64& _CheckpointId) {
+    if (Access == TFAccess::faRdOnly) { return; }
+    CheckpointP = true;
+    EndCheckpoint(_CheckpointId);
+}
+
+/// Drop pages kept for the previous checkpoint
+void TPgBlob::EndCheckpoint(const uint64& _CheckpointId) {
+    if (!CheckpointP) { return; }
+    if (UndoFOut != NULL) {
+        delete UndoFOut; UndoFOut = NULL;
+        TFile::Del(GetUndoFNm(FNm), false);
+    }
+    UndoPgH.Clr();
+    CheckpointId = _CheckpointId;
+    CheckpointPgCntV.Gen(Files.Len(), 0);
+    for (int FileN = 0; FileN < Files.Len(); FileN++) {
+        CheckpointPgCntV.Add(Files[FileN]->GetPgCnt());
+    }
+}
+
+/// Restore pages of the checkpoint from the undo file
+void TPgBlob::RestoreCheckpoint(const TStr& FNm, const uint64& _CheckpointId) {
+    const TStr UndoFNm = GetUndoFNm(FNm);
+    if (!TFile::Exists(UndoFNm)) { return; }
+    {
+        TFIn FIn(UndoFNm);
+        // undo file of an older checkpoint remains when crash came right after a new one was saved
+        if (FIn.Len() >= (int)sizeof(uint64) && TUInt64(FIn).Val == _CheckpointId) {
+            THash<TInt, PPgBlobFile> FileH;
+            TMem PgMem; PgMem.Gen(PG_PAGE_SIZE);
+            // last page can be torn by the crash, in which case it was not overwritten yet
+            const int PgRecLen = (int)(sizeof(int) + sizeof(uint) + PG_PAGE_SIZE);
+            while (FIn.Len() >= PgRecLen) {
+                const int FIx = TInt(FIn).Val;
+                const uint Pg = TUInt(FIn).Val;
+                FIn.GetBf(PgMem.GetBf(), PG_PAGE_SIZE);
+                if (!FileH.IsKey(FIx)) {
+                    const TStr FNmChild = FNm + ".bin" + TStr::GetNrNumFExt(FIx);
+                    FileH.AddDat(FIx, TPgBlobFile::New(FNmChild, TFAccess::faUpdate, MxBlobFLen));
+                }
+                FileH.GetDat(FIx)->SavePage(Pg, PgMem.GetBf());
+            }
+            for (int KeyId = FileH.FFirstKeyId(); FileH.FNextKeyId(KeyId); ) {
+                FileH[KeyId]->Flush();
+            }
+        }
+    }
+    TFile::Del(UndoFNm);
+}
+
 /// Load given page into memory
 char* TPgBlob::LoadPage(const TPgBlobPgPt& Pt, const bool& LoadData) {
+    // memory-mapped pages are read-only and need no housekeeping
+    if (MMapP) {
+        return Files[Pt.GetFIx()]->GetMappedPage(Pt.GetPg());
+    }
     int Pg;
     if (LoadedPagesH.IsKeyGetDat(Pt, Pg)) { // is page in cache
         MoveToStartLru(Pg);
@@ -519,6 +676,11 @@ PPgBlob TPgBlob::Open(const TStr& FNm, const uint64& CacheSize) {
     return PPgBlob(new TPgBlob(FNm, TFAccess::faUpdate, CacheSize));
 }
 
+/// Factory method for opening existing BLOB storage in read-only mode
+PPgBlob TPgBlob::OpenRdOnly(const TStr& FNm) {
+    return PPgBlob(new TPgBlob(FNm, TFAccess::faRdOnly, PG_PAGE_SIZE));
+}
+
 /// Initialize new page
 void TPgBlob::InitPageP(char* Pt) {
     TPgHeader* Pt2 = (TPgHeader*)Pt;
@@ -658,6 +820,8 @@ TMemBase TPgBlob::GetMemBase(const TPgBlobPt& Pt) {
 
 /// Loads all pages into cache - cache must be big enough
 void TPgBlob::LoadAll() {
+    // memory-mapped pages are loaded on demand by the operating system
+    if (MMapP) { return; }
     for (int i = 0; i < Fsm.Len(); i++) {
         LoadPage(Fsm.GetVal(i));
     }
@@ -677,18 +841,46 @@ void TPgBlob::Clr() {
 }
 
 /// Save part of the data, given time-window
-void TPgBlob::PartialFlush(int WndInMsec) {
+int TPgBlob::PartialFlush(int WndInMsec) {
     if (Access == TFAccess::faRdOnly)
-        return;
+        return 0;
     TTmStopWatch sw(true);
+    int Saved = 0;
     for (int i = 0; i < LoadedPages.Len(); i++) {
         if (ShouldSavePage(i)) {
-            LoadedPage& a = LoadedPages[i];
-            Files[a.Pt.GetFIx()]->SavePage(a.Pt.GetPg(), GetPageBf(i));
+            StorePage(i);
+            // page is now clean, until written to again
+            ((TPgHeader*)GetPageBf(i))->SetDirty(false);
+            Saved++;
             if (sw.GetMSec() > WndInMsec)
                 break;
         }
     }
+    return Saved;
+}
+
+/// Save all dirty pages and the main file
+void TPgBlob::Flush() {
+    if (Access == TFAccess::faRdOnly)
+        return;
+    PartialFlush(TInt::Mx);
+    SaveMain();
+    for (int i = 0; i < Files.Len(); i++) {
+        Files[i]->Flush();
+    }
+}
+
+/// Size of loaded pages changed since they were last saved
+uint64 TPgBlob::GetDirtyBytes() {
+    if (Access == TFAccess::faRdOnly)
+        return 0;
+    uint64 DirtyPages = 0;
+    for (int i = 0; i < LoadedPages.Len(); i++) {
+        if (ShouldSavePage(i)) {
+            DirtyPages++;
+        }
+    }
+    return DirtyPages * PG_PAGE_SIZE;
 }
 
 /// Marks page as dirty - data inside was written directly
@@ -709,6 +901,7 @@ PJsonVal TPgBlob::GetStats() {
 
     PJsonVal res = TJsonVal::NewObj();
     res->AddToObj("page_size", PG_PAGE_SIZE);
+    res->AddToObj("mmap", MMapP);
     res->AddToObj("loaded_pages", LoadedPages.Len());
     res->AddToObj("dirty_pages", dirty);
     res->AddToObj("loaded_extents", Extents.Len());
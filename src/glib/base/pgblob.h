@@ -230,6 +230,10 @@ private:
     TFAccess Access;
     /// Random-access file - BLOB storage
     FILE* FileId;
+    /// Read-only memory mapping of the whole file (NULL when not mapped)
+    char* MapBf;
+    /// Length of the memory mapping in bytes
+    uint64 MapLen;
     static char* EmptyPage;
 
     /// Private constructor
@@ -260,10 +264,21 @@ public:
     int SavePage(const uint32& Page, const void* Bf, int Len = -1);
     /// Reserve new space in the file. Returns -1 if file is full.
     long CreateNewPage();
+    /// Write buffered pages to the file
+    void Flush();
     /// Returns name of the file
     const TStr& GetFNm() const { return FNm; }
     /// Returns the number of pages stored in this file
     long GetPgCnt() const { return PgCnt; }
+    /// Map the file into memory. Only supported for read-only access.
+    /// Returns false when mapping is not possible and file API should be used.
+    bool MapFile();
+    /// Release the memory mapping
+    void UnmapFile();
+    /// Is the file memory-mapped
+    bool IsMapped() const { return MapBf != NULL; }
+    /// Returns pointer to the page inside the memory mapping
+    char* GetMappedPage(const uint32& Page) const;
 };
 
 ////////////////////////////////////////////////////////////
@@ -340,6 +355,9 @@ protected:
     TStr FNm;
     /// File access
     TFAccess Access;
+    /// Are pages served directly from read-only memory-mapped files.
+    /// In this mode the page cache is not used and no data is copied.
+    bool MMapP;
     /// Individual files that comprise this BLOB storage
     TVec<PPgBlobFile> Files;
     /// Pointers for loaded pages
@@ -363,6 +381,17 @@ protected:
     /// Maximal number of loaded pages
     uint64 MxLoadedPages;
 
+    /// Are pages of the last checkpoint saved to the undo file before they are overwritten
+    bool CheckpointP;
+    /// Id of the last checkpoint, stored in the undo file
+    uint64 CheckpointId;
+    /// Number of pages in each file at the last checkpoint
+    TVec<TInt64> CheckpointPgCntV;
+    /// Pages of the last checkpoint already saved to the undo file
+    THashSet<TPgBlobPgPt> UndoPgH;
+    /// Undo file, created when the first page is saved to it
+    TFOut* UndoFOut;
+
     /// Returns starting address of page in Bf
     char* GetPageBf(int Pg) {
         return
@@ -392,6 +421,10 @@ protected:
     void LoadMain();
     /// Find which child files exist
     void DetectSegments();
+    /// Get name of the undo file
+    static TStr GetUndoFNm(const TStr& FNm) { return FNm + ".undo"; }
+    /// Save page of the last checkpoint to the undo file, before it is overwritten
+    void SaveUndoPage(const TPgBlobPgPt& Pt);
 
     // Methods for handling page cache //////////////////////////////////
 
@@ -407,6 +440,8 @@ protected:
     bool CanEvictPageP(char* Pt) { return !((TPgHeader*)Pt)->IsLock(); }
     /// Load given page into memory
     char* LoadPage(const TPgBlobPgPt& Pt, const bool& LoadData = true);
+    /// Write loaded page to its file
+    void StorePage(const int& Pg, const int& Len = -1);
     /// Create new page and return pointers to it
     void CreateNewPage(TPgBlobPgPt& Pt, char** Bf);
 
@@ -431,8 +466,10 @@ public:
     /// Reference count for smart pointers
     TCRef CRef;
 
-    /// Constructor
-    TPgBlob(const TStr& _FNm, const TFAccess& _Access, const uint64& CacheSize);
+    /// Constructor. When opened with faRdOnly, files are memory-mapped
+    /// unless MMapP is set to false or mapping is not supported.
+    TPgBlob(const TStr& _FNm, const TFAccess& _Access, const uint64& CacheSize,
+        const bool& _MMapP = true);
     /// Destructor
     ~TPgBlob();
 
@@ -440,6 +477,9 @@ public:
     static PPgBlob Create(const TStr& FNm, const uint64& CacheSize = 10 * TNum<int>::Mega);
     /// Factory method for opening existing BLOB storage
     static PPgBlob Open(const TStr& FNm, const uint64& CacheSize = 10 * TNum<int>::Mega);
+    /// Factory method for opening existing BLOB storage in read-only,
+    /// memory-mapped mode
+    static PPgBlob OpenRdOnly(const TStr& FNm);
 
     /// Store new BLOB to storage
     TPgBlobPt Put(const char* Bf, const int& BfL);
@@ -451,15 +491,35 @@ public:
     TThinMIn Get(const TPgBlobPt& Pt);
     /// Delete BLOB from storage
     void Del(const TPgBlobPt& Pt);
-    /// Retrieve BLOB from storage as TMemBase
+    /// Retrieve BLOB from storage as TMemBase. Returned object does not own
+    /// the memory and is valid only until the page is evicted from cache.
+    /// In memory-mapped mode it stays valid for the lifetime of the storage.
     TMemBase GetMemBase(const TPgBlobPt& Pt);
+    /// Are pages served from memory-mapped files
+    bool IsMMap() const { return MMapP; }
     /// Loads all pages into cache- cache must be big enough
     void LoadAll();
     /// Clear all contents
     void Clr();
 
-    /// Save part of the data, given time-window
-    void PartialFlush(int WndInMsec = 500);
+    /// Save part of the data, given time-window. Returns number of saved pages.
+    int PartialFlush(int WndInMsec = 500);
+    /// Save all dirty pages and the main file, so files are consistent while open
+    void Flush();
+    /// Size of loaded pages changed since they were last saved
+    uint64 GetDirtyBytes();
+
+    /// Keep pages as they were at the last Flush: before a page is overwritten, its old
+    /// content is saved to the undo file, from which RestoreCheckpoint restores it after
+    /// a crash. Undo file is flushed to the OS before the page is written, like the rest
+    /// of the files it is not synced to disk.
+    void EnableCheckpoints(const uint64& _CheckpointId);
+    /// Drop pages kept for the previous checkpoint, once the one from the last Flush is
+    /// saved under the given id
+    void EndCheckpoint(const uint64& _CheckpointId);
+    /// Restore pages of the checkpoint with the given id from the undo file of storage
+    /// FNm. Undo files of other checkpoints are not needed and are deleted.
+    static void RestoreCheckpoint(const TStr& FNm, const uint64& _CheckpointId);
     /// Retrieve statistics for this object
     PJsonVal GetStats();
 
@@ -85,10 +85,38 @@ void TCriticalSection::Leave() {
 	pthread_mutex_unlock(&Cs);
 }
 
+TRWMutex::TRWMutex() {
+	pthread_rwlockattr_t RWLockAttr;
+	pthread_rwlockattr_init(&RWLockAttr);
+#if defined(__GLIBC__)
+	// writer would otherwise starve under a constant stream of readers
+	pthread_rwlockattr_setkind_np(&RWLockAttr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+	pthread_rwlock_init(&RWLock, &RWLockAttr);
+	pthread_rwlockattr_destroy(&RWLockAttr);
+}
+TRWMutex::~TRWMutex() {
+	pthread_rwlock_destroy(&RWLock);
+}
+void TRWMutex::EnterRead() {
+	pthread_rwlock_rdlock(&RWLock);
+}
+void TRWMutex::LeaveRead() {
+	pthread_rwlock_unlock(&RWLock);
+}
+void TRWMutex::EnterWrite() {
+	pthread_rwlock_wrlock(&RWLock);
+}
+void TRWMutex::LeaveWrite() {
+	pthread_rwlock_unlock(&RWLock);
+}
+
 ////////////////////////////////////////////
 // Conditional variable lock
 TCondVarLock::TCondVarLock():
-	Mutex(TMutexType::mtRecursive) {}
+	Mutex(TMutexType::mtRecursive) {
+	pthread_cond_init(&CondVar, NULL);
+}
 
 TCondVarLock::~TCondVarLock() {
 	// pthread_cond_destroy should be called to free a condition variable that is no longer needed
@@ -54,6 +54,23 @@ public:
 	void Leave();
 };
 
+/**
+ * Reader-writer mutex - allows many readers or a single writer, not re-entrant
+ */
+class TRWMutex {
+protected:
+	pthread_rwlock_t RWLock;
+
+public:
+	TRWMutex();
+	~TRWMutex();
+
+	void EnterRead();
+	void LeaveRead();
+	void EnterWrite();
+	void LeaveWrite();
+};
+
 ////////////////////////////////////////////
 // Thread
 ClassTP(TThread, PThread)// {
@@ -107,7 +124,8 @@ public:
 	bool IsFinished();
 
 	static int GetCoreCount();
-
+	// id of the calling thread
+	static uint64 GetCurThreadId() { return (uint64)pthread_self(); }
 };
 
 
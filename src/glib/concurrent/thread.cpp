@@ -23,6 +23,67 @@
 
 #endif
 
+////////////////////////////////////////////
+// Reader-writer lock
+const uint64 TRWLock::NoThreadId = TUInt64::Mx;
+
+// read locks held by the current thread and their nesting depths; a thread
+// holds only a few locks at a time, so a short array is searched linearly
+static const int MxThreadReadLocks = 16;
+static thread_local const TRWLock* ThreadReadLockV[MxThreadReadLocks];
+static thread_local int ThreadReadDepthV[MxThreadReadLocks];
+static thread_local int ThreadReadLocks = 0;
+
+int TRWLock::GetThreadReadLockN() const {
+	for (int ReadLockN = 0; ReadLockN < ThreadReadLocks; ReadLockN++) {
+		if (ThreadReadLockV[ReadLockN] == this) { return ReadLockN; }
+	}
+	return -1;
+}
+
+void TRWLock::EnterRead() {
+	// writer already excludes everybody else
+	if (IsWriteHeld()) { WriteDepth++; return; }
+	const int ReadLockN = GetThreadReadLockN();
+	if (ReadLockN != -1) { ThreadReadDepthV[ReadLockN]++; return; }
+	EAssertR(ThreadReadLocks < MxThreadReadLocks, "Too many read locks held by one thread");
+	RWMutex.EnterRead();
+	ThreadReadLockV[ThreadReadLocks] = this;
+	ThreadReadDepthV[ThreadReadLocks] = 1;
+	ThreadReadLocks++;
+}
+
+void TRWLock::LeaveRead() {
+	if (IsWriteHeld()) { LeaveWrite(); return; }
+	const int ReadLockN = GetThreadReadLockN();
+	EAssertR(ReadLockN != -1, "Leaving read lock which is not held");
+	if (--ThreadReadDepthV[ReadLockN] > 0) { return; }
+	// move the last held lock into the freed slot
+	ThreadReadLocks--;
+	ThreadReadLockV[ReadLockN] = ThreadReadLockV[ThreadReadLocks];
+	ThreadReadDepthV[ReadLockN] = ThreadReadDepthV[ThreadReadLocks];
+	RWMutex.LeaveRead();
+}
+
+void TRWLock::EnterWrite() {
+	if (IsWriteHeld()) { WriteDepth++; return; }
+	EAssertR(GetThreadReadLockN() == -1, "Cannot enter write lock while holding read lock");
+	RWMutex.EnterWrite();
+	WriterId.store(TThread::GetCurThreadId(), std::memory_order_release);
+	WriteDepth = 1;
+}
+
+void TRWLock::LeaveWrite() {
+	EAssertR(IsWriteHeld(), "Leaving write lock which is not held");
+	if (--WriteDepth > 0) { return; }
+	WriterId.store(NoThreadId, std::memory_order_release);
+	RWMutex.LeaveWrite();
+}
+
+bool TRWLock::IsHeld() const {
+	return IsWriteHeld() || GetThreadReadLockN() != -1;
+}
+
 TInterruptibleThread& TInterruptibleThread::operator=(const TInterruptibleThread& Other) {
     TThread::operator =(Other);
 	SleeperBlocker = Other.SleeperBlocker;
@@ -57,6 +57,62 @@ public:
 	~TLock() { CriticalSection.Leave(); }
 };
 
+////////////////////////////////////////////
+// Reader-writer lock
+//   Many threads can hold the lock for reading, or a single thread for
+//   writing. Both are re-entrant per thread, and the writing thread can
+//   also enter for reading. Entering for writing while holding the lock
+//   only for reading is not allowed, since two such threads would deadlock.
+class TRWLock {
+private:
+	// marks no thread holding the write lock
+	static const uint64 NoThreadId;
+
+	TRWMutex RWMutex;
+	// thread holding the write lock
+	std::atomic<uint64> WriterId;
+	// number of nested locks held by writing thread, only it touches this
+	int WriteDepth;
+
+	TRWLock(const TRWLock&);
+	TRWLock& operator=(const TRWLock&);
+	// position of this lock among read locks held by calling thread, -1 when not held;
+	// nesting depth of read locks is kept per thread, so reading takes no shared lock
+	int GetThreadReadLockN() const;
+
+public:
+	TRWLock(): WriterId(NoThreadId), WriteDepth(0) { }
+
+	void EnterRead();
+	void LeaveRead();
+	void EnterWrite();
+	void LeaveWrite();
+
+	// true when calling thread holds the lock for writing
+	bool IsWriteHeld() const { return WriterId.load(std::memory_order_acquire) == TThread::GetCurThreadId(); }
+	// true when calling thread holds the lock for reading or writing
+	bool IsHeld() const;
+};
+
+////////////////////////////////////////////
+// Read and write lock
+//   Enter reader-writer lock on construct and leave it on destruct
+class TReadLock {
+private:
+	TRWLock& RWLock;
+public:
+	TReadLock(TRWLock& _RWLock): RWLock(_RWLock) { RWLock.EnterRead(); }
+	~TReadLock() { RWLock.LeaveRead(); }
+};
+
+class TWriteLock {
+private:
+	TRWLock& RWLock;
+public:
+	TWriteLock(TRWLock& _RWLock): RWLock(_RWLock) { RWLock.EnterWrite(); }
+	~TWriteLock() { RWLock.LeaveWrite(); }
+};
+
 ////////////////////////////////////////////
 // Thread executor
 //   contains a pool of threads which can execute a TRunnable object
@@ -56,6 +56,24 @@ void TCriticalSection::Leave() {
 	LeaveCriticalSection(&Cs);
 }
 
+////////////////////////////////////////////
+// Reader-writer mutex
+TRWMutex::TRWMutex() {
+	InitializeSRWLock(&RWLock);
+}
+void TRWMutex::EnterRead() {
+	AcquireSRWLockShared(&RWLock);
+}
+void TRWMutex::LeaveRead() {
+	ReleaseSRWLockShared(&RWLock);
+}
+void TRWMutex::EnterWrite() {
+	AcquireSRWLockExclusive(&RWLock);
+}
+void TRWMutex::LeaveWrite() {
+	ReleaseSRWLockExclusive(&RWLock);
+}
+
 ////////////////////////////////////////////
 // Blocker 
 TBlocker::TBlocker() {
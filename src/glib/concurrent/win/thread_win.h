@@ -50,6 +50,24 @@ public:
 	void Leave();
 };
 
+////////////////////////////////////////////
+// Reader-writer mutex
+// allows many readers or a single writer, not re-entrant
+class TRWMutex {
+private:
+	SRWLOCK RWLock;
+
+public:
+	TRWMutex();
+
+	// shared access
+	void EnterRead();
+	void LeaveRead();
+	// exclusive access
+	void EnterWrite();
+	void LeaveWrite();
+};
+
 ////////////////////////////////////////////
 // Blocker 
 class TBlocker {
@@ -99,6 +117,8 @@ public:
 
 	// get number of cores in the system
 	static int GetCoreCount();
+	// id of the calling thread
+	static uint64 GetCurThreadId() { return (uint64)GetCurrentThreadId(); }
 
 	bool IsAlive() { throw TExcept::New("Not implemented!"); }
 	void Cancel() { throw TExcept::New("Not implemented!"); }
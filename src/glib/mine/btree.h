@@ -53,8 +53,8 @@ public:
 // given to TBtreeOps as the TLeafStore and TInternalStore template parameters.  In practice,
 // you don't have to actually derive your store implementation from IBtreeStore or anything of that sort.
 //
-// For examples of concrete node store implementations, see TBtreeNodeMemStore
-// and TBtreeNodeMemStore_Paranoid below.
+// For examples of concrete node store implementations, see TBtreeNodeMemStore,
+// TBtreeNodeMemStore_Paranoid and TBtreeNodePgBlobStore below.
 //
 // The store has to support the following operations:
 // - AllocNode/FreeNode
@@ -110,6 +110,7 @@ public:
 // Interface:
 // - void         Clr()
 // - TKeyLocation Add(TKey, TDat)  -- adds the key to the tree; duplicate keys are allowed, but might confuse some of the other functions
+// - void         AddSorted(TKeyV or TKdV) -- builds an empty tree bottom-up from sorted keys, packing the nodes full
 // - bool         Del(TKey)        -- if the key exists, deletes it and returns true; otherwise returns false; if multiple copies of the key exist, an arbitrary one is deleted
 // - bool         Del(TKey, TDat&) -- same as above, but also returns the corresponding dat (if the key was found)
 // - void         Dump(FILE *f)    -- generated a text dump of the tree
@@ -117,10 +118,17 @@ public:
 // - int          RangeQuery_(minKey, maxKey, includeMin, includeMax, TSink&)  -- calls sink(key, dat) for each key from the range minKey <= key <= maxKey [or < if includeMin/includeMax is false]; returns # of calls made
 // - int          RangeQuery(minKey, maxKey, TKeyV&) -- puts all keys in the range 'minKey <= key <= maxKey' into the destination vector
 // - int          RangeQuery(minKey, maxKey, TKeyDatV&) -- puts (key, dat) for all keys in the range 'minKey <= key <= maxKey' into the destination vector
+// - int          RangeQueryDesc_(minKey, maxKey, includeMin, includeMax, TSink&) -- same as RangeQuery_, but the keys come in descending order
+// - int          ScanFrom_(minKey*, includeMin, TSink&) -- calls sink(key, dat) for keys from minKey on (or from the start), until the sink returns false
+// - int          RangeQuery(minKey, maxKey, asc, limit, TKeyV&) -- puts at most 'limit' keys from the range into the destination vector, in ascending or descending order
+// - int          RangeCount(minKey, maxKey) -- returns the number of keys in the range 'minKey <= key <= maxKey', without copying them
 // - bool         IsKey(key)       -- returns true iff the given key is present in the tree
+// - bool         IsKeyInRange(minKey, maxKey) -- returns true iff some key from the range 'minKey <= key <= maxKey' is present, stops at the first one
 // - bool         IsKeyGetDat(key, TDat&) -- like IsKey(), but also returns the corresponding dat if the key is found
+// - double       GetKeyPos(key)   -- estimates the fraction of keys smaller than the given key, visiting one node per level
+// - double       GetRangeFrac(minKey, maxKey) -- estimates the fraction of keys in the range 'minKey <= key <= maxKey'
 //
-// A few sink classes for use with RangeQuery_ are also included> TKeySink, TKeyDatSink, TNullSink, TCountSink.
+// A few sink classes for use with RangeQuery_ are also included> TKeySink, TKeyDatSink, TKeyLimitSink, TNullSink, TCountSink.
 // Several of the above methods are actually just wrappers around RangeQuery_, using one of these sinks.
 
 template <
@@ -428,6 +436,72 @@ public:
 		return retVal;
 	}
 
+//----------------------------------------------------------------------------
+// Bulk loading of keys
+//----------------------------------------------------------------------------
+
+protected:
+
+	// Entries given to AddSorted are either (key, dat) pairs or just keys with default dats.
+	template <typename TNodeKd> static void SetSortedKd(TNodeKd& kd, const TNodeKd& src) { kd = src; }
+	template <typename TNodeKd> static void SetSortedKd(TNodeKd& kd, const TKey& key) { kd.Key = key; kd.Dat = TDat(); }
+	template <typename TNodeKd> static const TKey& GetSortedKey(const TNodeKd& kd) { return kd.Key; }
+	static const TKey& GetSortedKey(const TKey& key) { return key; }
+
+	// Distributes the sorted entries evenly over as few nodes as possible, so that each node
+	// has from 'capacity' to '2 * capacity - 1' entries, and links the nodes of the level together.
+	// Returns (maxKey, nodeId) pairs of the new nodes, which are the entries of the level above.
+	template <typename TStore_, typename TEntryV>
+	void AddSortedLevel(const TPt<TStore_>& store, const int capacity, const TEntryV& entryV,
+		typename TInternalNode::TKdV& parentV)
+	{
+		const int n = entryV.Len(), nNodes = (n + 2 * capacity - 2) / (2 * capacity - 1);
+		TNodeIdV nodes(nNodes, 0);
+		for (int nodeN = 0; nodeN < nNodes; nodeN++) nodes.Add(store->AllocNode());
+		parentV.Gen(nNodes, 0);
+		for (int nodeN = 0, from = 0; nodeN < nNodes; nodeN++) {
+			const int to = int((int64(n) * (nodeN + 1)) / nNodes);
+			TNodeAutoPtr<TStore_> pNode(store, nodes[nodeN], true);
+			pNode->v.Gen(to - from);
+			for (int i = from; i < to; i++) SetSortedKd(pNode->v[i - from], entryV[i]);
+			pNode->prev = (nodeN > 0) ? nodes[nodeN - 1] : TNodeId(-1);
+			pNode->next = (nodeN + 1 < nNodes) ? nodes[nodeN + 1] : TNodeId(-1);
+			parentV.Add(typename TInternalNode::TKd(GetSortedKey(entryV[to - 1]), nodes[nodeN]));
+			from = to; }
+	}
+
+	template <typename TEntryV>
+	void AddSorted_(const TEntryV& entryV)
+	{
+		IAssert(nLevels == 1);
+		PInternalNode pRoot(internalStore, root, true);
+		IAssert(pRoot->v.Empty());
+		if (entryV.Empty()) return;
+		for (int i = 1; i < entryV.Len(); i++) Assert(cmp(GetSortedKey(entryV[i - 1]), GetSortedKey(entryV[i])) <= 0);
+		// Build the leaves and then internal levels, until the entries fit into the root.
+		typename TInternalNode::TKdV levelV;
+		AddSortedLevel(leafStore, leafCapacity, entryV, levelV);
+		TNodeIdV levelFirst, levelLast;
+		levelFirst.Add(levelV[0].Dat); levelLast.Add(levelV.Last().Dat);
+		while (levelV.Len() > 2 * internalCapacity - 1) {
+			typename TInternalNode::TKdV parentV;
+			AddSortedLevel(internalStore, internalCapacity, levelV, parentV);
+			levelV.Swap(parentV);
+			levelFirst.Add(levelV[0].Dat); levelLast.Add(levelV.Last().Dat); }
+		pRoot->v = levelV;
+		// The levels were built bottom-up, while first/last go from the root down.
+		nLevels = levelFirst.Len() + 1;
+		for (int h = levelFirst.Len() - 1; h >= 0; h--) { first.Add(levelFirst[h]); last.Add(levelLast[h]); }
+	}
+
+public:
+
+	// Builds the tree bottom-up from the given keys (or (key, dat) pairs), which must be sorted.
+	// The tree must be empty.  Nodes are packed full, unlike the ones produced by calling Add
+	// for each key, which splits them in halves.
+	void AddSorted(const TKeyV& keyV) { AddSorted_(keyV); }
+	void AddSorted(const TKdV& kdV) { AddSorted_(kdV); }
+
 //----------------------------------------------------------------------------
 // Deletion of keys
 //----------------------------------------------------------------------------
@@ -708,6 +782,82 @@ public:
 		return RangeQuery_Recursion(Q, root, 0);
 	}
 
+	// Same as RangeQuery_, but the sink receives keys in descending order.  Descends to the leaf
+	// holding the largest key in the range and follows the 'prev' links from there.
+	template<typename TSink>
+	int RangeQueryDesc_(const TKey& minKey, const TKey& maxKey, bool includeMin, bool includeMax, TSink& sink) const
+	{
+		int retVal = 0;
+		Assert(nLevels >= 1);
+		if (nLevels == 1) return retVal; // we have just the root, therefore no leaves and therefore no keys either
+		TNodeId node = root;
+		for (int level = 0; level < nLevels - 1; level++) {
+			PInternalNode pNode(internalStore, node);
+			const typename TInternalNode::TKdV &v = pNode->v; int n = v.Len(), idx = 0;
+			if (n == 0) return retVal;
+			// Subtrees whose maximum is still within the range hold no keys above it.
+			for (int c; idx + 1 < n && ((c = cmp(v[idx].Key, maxKey)) < 0 || (c == 0 && includeMax)); ) idx++;
+			node = v[idx].Dat; }
+		while (node >= 0)
+		{
+			PLeafNode pNode(leafStore, node);
+			const typename TLeafNode::TKdV &v = pNode->v;
+			for (int i = v.Len() - 1; i >= 0; i--)
+			{
+				int c = cmp(v[i].Key, maxKey);
+				if (c > 0 || (c == 0 && ! includeMax))
+					continue; // This key is too large.
+				c = cmp(v[i].Key, minKey);
+				if (c < 0 || (c == 0 && ! includeMin))
+					return retVal;
+				retVal++;
+				if (! sink(v[i].Key, v[i].Dat))
+					return retVal;
+			}
+			node = pNode->prev;
+		}
+		return retVal;
+	}
+
+	// Calls sink(key, dat) for the keys from minKey on (from the smallest key when minKey is null),
+	// in ascending order, until the sink returns false.  Unlike RangeQuery_, there is no upper bound;
+	// descends to the leaf with the first such key and follows the 'next' links from there.
+	// Returns the number of calls made to 'sink'.
+	template<typename TSink>
+	int ScanFrom_(const TKey* minKey, bool includeMin, TSink& sink) const
+	{
+		int retVal = 0;
+		Assert(nLevels >= 1);
+		if (nLevels == 1) return retVal; // we have just the root, therefore no leaves and therefore no keys either
+		TNodeId node = first[nLevels - 1];
+		if (minKey) {
+			node = root;
+			for (int level = 0; level < nLevels - 1; level++) {
+				PInternalNode pNode(internalStore, node);
+				const typename TInternalNode::TKdV &v = pNode->v; int n = v.Len(), idx = 0;
+				if (n == 0) return retVal;
+				// Subtrees whose maximum is below minKey hold no keys from the range.
+				for (int c; idx + 1 < n && ((c = cmp(v[idx].Key, *minKey)) < 0 || (c == 0 && ! includeMin)); ) idx++;
+				node = v[idx].Dat; } }
+		while (node >= 0)
+		{
+			PLeafNode pNode(leafStore, node);
+			const typename TLeafNode::TKdV &v = pNode->v;
+			for (int i = 0; i < v.Len(); i++)
+			{
+				if (minKey) {
+					int c = cmp(v[i].Key, *minKey);
+					if (c < 0 || (c == 0 && ! includeMin))
+						continue; } // This key is too small.
+				retVal++;
+				if (! sink(v[i].Key, v[i].Dat))
+					return retVal;
+			}
+			node = pNode->next;
+		}
+		return retVal;
+	}
+
 public:
 
 	struct TKeySink {
@@ -720,6 +870,11 @@ public:
 		TKeyDatSink(TKdV &dest_) : dest(dest_) { }
 		bool operator()(const TKey &key, const TDat &dat) { dest.Add(TKd(key, dat)); return true; } };
 
+	struct TKeyLimitSink {
+		TKeyV &dest; int left;
+		TKeyLimitSink(TKeyV &dest_, int limit_) : dest(dest_), left(limit_) { }
+		bool operator()(const TKey &key, const TDat &dat) { dest.Add(key); return --left != 0; } };
+
 	struct TNullSink {
 		bool operator()(const TKey &key, const TDat &dat) { return true; }};
 
@@ -738,12 +893,58 @@ public:
 		if (ClrDest) dest.Clr();
 		TKeyDatSink sink(dest); return RangeQuery_(minKey, maxKey, true, true, sink); }
 
+	// Returns at most 'limit' keys from the range (all of them when limit < 0), in ascending
+	// or descending order.  Only the leaf entries that are returned get visited.
+	int RangeQuery(const TKey& minKey, const TKey& maxKey, bool asc, int limit, TKeyV& dest, bool ClrDest = true) const {
+		if (ClrDest) dest.Clr();
+		if (limit == 0) return 0;
+		TKeyLimitSink sink(dest, limit);
+		return asc ? RangeQuery_(minKey, maxKey, true, true, sink) : RangeQueryDesc_(minKey, maxKey, true, true, sink); }
+
+	int RangeCount(const TKey& minKey, const TKey& maxKey) const {
+		TNullSink sink; return RangeQuery_(minKey, maxKey, true, true, sink); }
+
 	bool IsKey(const TKey& key) const {
 		TFindSink sink; RangeQuery_(key, key, true, true, sink); return sink.found; }
 
+	bool IsKeyInRange(const TKey& minKey, const TKey& maxKey) const {
+		TFindSink sink; RangeQuery_(minKey, maxKey, true, true, sink); return sink.found; }
+
 	bool IsKeyGetDat(const TKey& key, TDat& dat) const {
 		TFindSink sink(&dat); RangeQuery_(key, key, true, true, sink); return sink.found; }
 
+//----------------------------------------------------------------------------
+// Estimating ranges
+//----------------------------------------------------------------------------
+
+public:
+
+	// Returns an estimate of the fraction of keys in the tree that are smaller than the given key.
+	// Only the nodes on the path from the root to the leaf where the key would be are visited;
+	// the estimate assumes that all the children of an internal node hold the same number of keys.
+	double GetKeyPos(const TKey& key) const
+	{
+		Assert(nLevels >= 1);
+		if (nLevels == 1) return 0.0; // no leaves, no keys
+		double pos = 0.0, width = 1.0; TNodeId node = root;
+		for (int level = 0; level < nLevels - 1; level++) {
+			PInternalNode pNode(internalStore, node);
+			const typename TInternalNode::TKdV &v = pNode->v; int n = v.Len(), idx = 0;
+			if (n == 0) return pos;
+			while (idx + 1 < n && cmp(v[idx].Key, key) < 0) idx++;
+			width /= n; pos += idx * width; node = v[idx].Dat; }
+		PLeafNode pNode(leafStore, node);
+		const typename TLeafNode::TKdV &v = pNode->v; int n = v.Len(), idx = 0;
+		while (idx < n && cmp(v[idx].Key, key) < 0) idx++;
+		if (n > 0) pos += idx * width / n;
+		return pos;
+	}
+
+	// Returns an estimate of the fraction of keys in the range 'minKey <= key <= maxKey'.
+	double GetRangeFrac(const TKey& minKey, const TKey& maxKey) const {
+		const double frac = GetKeyPos(maxKey) - GetKeyPos(minKey);
+		return (frac > 0.0) ? frac : 0.0; }
+
 //----------------------------------------------------------------------------
 // Debug funtions
 //----------------------------------------------------------------------------
@@ -1096,6 +1297,108 @@ public:
 			IAssert(nodes[node]->checkedOut == 0); }}
 };
 
+//----------------------------------------------------------------------------
+// TBtreeNodePgBlobStore
+//----------------------------------------------------------------------------
+//
+// This store keeps the nodes serialized in a paged BLOB storage (TPgBlob), which
+// maintains a bounded cache of pages and writes back only the dirty ones.  Several
+// stores can share the same TPgBlob; the store itself only keeps the mapping from
+// node ids to BLOB pointers, so its (de)serialization does not depend on the number
+// of keys in the tree.  Checked-out nodes are decoded into wrappers which live
+// until the node is checked in, when dirty nodes are written back to the BLOB.
+// The store is not thread safe, and neither is TPgBlob, so the user has to
+// serialize all access to the stores sharing the same TPgBlob.
+
+template <typename TKey_, typename TDat_, typename TNodeId_>
+class TBtreeNodePgBlobStore
+{
+public:
+	TCRef CRef;
+	typedef TKey_ TKey;
+	typedef TDat_ TDat;
+	typedef TNodeId_ TNodeId;
+	typedef TBtreeNode<TKey, TDat, TNodeId> TNode;
+	typedef TVec<TNodeId> TNodeIdV;
+
+protected:
+	class TNodeWrapper;
+	typedef TPt<TNodeWrapper> PNodeWrapper;
+	class TNodeWrapper
+	{
+	private:
+		TCRef CRef;
+		friend class TPt<TNodeWrapper>;
+	public:
+		TNode node;
+		TNodeWrapper() { }
+		explicit TNodeWrapper(TSIn& SIn) : node(SIn) { }
+	};
+
+	PPgBlob blob;
+	TVec<TPgBlobPt> nodes; // empty pointer marks a free node
+	TNodeIdV freeNodes;
+	THash<TNodeId, PNodeWrapper> checkedOut;
+
+	TPgBlobPt PutNode(const TNode& node, const TPgBlobPt& pt) {
+		TMOut MOut; node.Save(MOut);
+		IAssertR(MOut.Len() <= blob->GetMxBlobLen(), "B-tree node does not fit into a page");
+		return pt.Empty() ? blob->Put(MOut.GetBfAddr(), MOut.Len()) :
+			blob->Put(MOut.GetBfAddr(), MOut.Len(), pt); }
+
+public:
+
+	explicit TBtreeNodePgBlobStore(const PPgBlob& Blob) : blob(Blob) { }
+	TBtreeNodePgBlobStore(TSIn& SIn, const PPgBlob& Blob) : blob(Blob), nodes(SIn), freeNodes(SIn) { }
+	static TPt<TBtreeNodePgBlobStore> New(const PPgBlob& Blob) { return new TBtreeNodePgBlobStore(Blob); }
+	static TPt<TBtreeNodePgBlobStore> Load(TSIn &SIn, const PPgBlob& Blob) { return new TBtreeNodePgBlobStore(SIn, Blob); }
+	// The store cannot be owned by the tree, as it can only be loaded together with its BLOB storage.
+	static TPt<TBtreeNodePgBlobStore> Load(TSIn &SIn) { FailR("Paged B-tree node store requires BLOB storage to load"); return NULL; }
+	void Save(TSOut &SOut) const { IAssert(checkedOut.Empty()); nodes.Save(SOut); freeNodes.Save(SOut); }
+
+	TNodeId AllocNode() {
+		TNodeId node;
+		if (freeNodes.Empty()) node = nodes.Add();
+		else { node = freeNodes.Last(); freeNodes.DelLast(); Assert(node >= 0); Assert(node < nodes.Len()); Assert(nodes[node].Empty()); }
+		nodes[node] = PutNode(TNode(), TPgBlobPt());
+		return node; }
+
+	void FreeNode(const TNodeId& nodeId) {
+		Assert(nodeId >= 0); IAssert(nodeId < nodes.Len());
+		Assert(! nodes[nodeId].Empty()); Assert(! checkedOut.IsKey(nodeId));
+		blob->Del(nodes[nodeId]);
+		nodes[nodeId].Clr();
+		freeNodes.Add(nodeId); }
+
+	TNode *CheckOutNode(const TNodeId& nodeId)
+	{
+		Assert(nodeId >= 0); IAssert(nodeId < nodes.Len());
+		Assert(! nodes[nodeId].Empty()); IAssert(! checkedOut.IsKey(nodeId));
+		TThinMIn MIn = blob->Get(nodes[nodeId]);
+		PNodeWrapper w = new TNodeWrapper(MIn);
+		checkedOut.AddDat(nodeId, w);
+		return &w->node;
+	}
+
+	void CheckInNode(const TNodeId& nodeId, TNode *node, bool dirty)
+	{
+		Assert(nodeId >= 0); Assert(nodeId < nodes.Len());
+		const int keyId = checkedOut.GetKeyId(nodeId); IAssert(keyId != -1);
+		Assert(&checkedOut[keyId]->node == node);
+		// the page might not have enough room for the grown node, in which case it is moved
+		if (dirty) nodes[nodeId] = PutNode(*node, nodes[nodeId]);
+		checkedOut.DelKeyId(keyId);
+	}
+
+	void Clr() {
+		IAssert(checkedOut.Empty());
+		for (TNodeId node = 0; node < nodes.Len(); node++) {
+			if (! nodes[node].Empty()) blob->Del(nodes[node]); }
+		nodes.Clr(); freeNodes.Clr(); }
+
+	void IAssertNoCheckouts() { IAssert(checkedOut.Empty()); }
+};
+
 }
 
 #endif // ____BTREE_H_INCLUDED____
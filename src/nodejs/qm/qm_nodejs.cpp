@@ -368,8 +368,13 @@ void TNodeJsBase::Init(v8::Local<v8::Object> exports) {
     NODE_SET_PROTOTYPE_METHOD(tpl, "createJsStore", _createJsStore);
     NODE_SET_PROTOTYPE_METHOD(tpl, "addJsStoreCallback", _addJsStoreCallback);
     NODE_SET_PROTOTYPE_METHOD(tpl, "search", _search);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "searchCount", _searchCount);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "searchExists", _searchExists);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "explain", _explain);
     NODE_SET_PROTOTYPE_METHOD(tpl, "garbageCollect", _garbageCollect);
     NODE_SET_PROTOTYPE_METHOD(tpl, "partialFlush", _partialFlush);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "saveBinDump", _saveBinDump);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "restoreBinDump", _restoreBinDump);
     NODE_SET_PROTOTYPE_METHOD(tpl, "getStats", _getStats);
     NODE_SET_PROTOTYPE_METHOD(tpl, "getStreamAggr", _getStreamAggr);
     NODE_SET_PROTOTYPE_METHOD(tpl, "getStreamAggrNames", _getStreamAggrNames);
@@ -386,7 +391,7 @@ void TNodeJsBase::Init(v8::Local<v8::Object> exports) {
 
 TNodeJsBase::TNodeJsBase(const TStr& DbFPath_, const TStr& SchemaFNm, const PJsonVal& Schema,
         const bool& Create, const bool& ForceCreate, const bool& RdOnlyP, const bool& StrictNmP,
-        const uint64& IndexCacheSize, const uint64& StoreCacheSize) {
+        const uint64& IndexCacheSize, const uint64& StoreCacheSize, const bool& WalP) {
 
     Watcher = TNodeJsBaseWatcher::New();
 
@@ -419,6 +424,8 @@ TNodeJsBase::TNodeJsBase(const TStr& DbFPath_, const TStr& SchemaFNm, const PJso
             TFile::DelWc(TPath::Combine(DbFPath, "*.Cache"), false);
             TFile::DelWc(TPath::Combine(DbFPath, "*.GenericStore"), false);
             TFile::DelWc(TPath::Combine(DbFPath, "*.MemCache"), false);
+            // write-ahead log and its checkpoint manifest
+            TFile::DelWc(TPath::Combine(DbFPath, "Wal.*"), false);
         }
     }
     if (Create) {
@@ -475,7 +482,8 @@ TNodeJsBase::TNodeJsBase(const TStr& DbFPath_, const TStr& SchemaFNm, const PJso
             // resolve access type
             TFAccess FAccess = RdOnlyP ? faRdOnly : faUpdate;
             // load base
-            Base = TQm::TStorage::LoadBase(DbFPath, FAccess, IndexCacheSize, StoreCacheSize);
+            Base = TQm::TStorage::LoadBase(DbFPath, FAccess, IndexCacheSize, StoreCacheSize,
+                TStrUInt64H(), TStrUInt64H(), true, 1024, WalP);
             // once the base is open we need to setup the custom record templates for each store
             if (!TNodeJsQm::BaseFPathToId.IsKey(Base->GetFPath())) {
                 TUInt Keys = (uint)TNodeJsQm::BaseFPathToId.Len();
@@ -514,12 +522,31 @@ TNodeJsBase* TNodeJsBase::NewFromArgs(const v8::FunctionCallbackInfo<v8::Value>&
     bool ReadOnly = (Mode == "openReadOnly");
     uint64 IndexCache = (uint64)Val->GetObjInt("indexCache", 1024) * (uint64)TInt::Mega;
     uint64 StoreCache = (uint64)Val->GetObjInt("storeCache", 1024) * (uint64)TInt::Mega;
+    const bool WalP = Val->GetObjBool("wal", false);
+    EAssertR(!ReadOnly || !Val->IsObjKey("flusher"), "Base.create: Flusher not supported in mode " + Mode);
 
     // Load Stopword Files
     TStr StopWordsPath = Val->GetObjStr("stopwords", TQm::TEnv::QMinerFPath + "resources/stopwords/");
     TSwSet::LoadSwDir(StopWordsPath);
 
-    return new TNodeJsBase(DbPath, SchemaFNm, Schema, Create, ForceCreate, ReadOnly, StrictNmP, IndexCache, StoreCache);
+    TNodeJsBase* JsBase = new TNodeJsBase(DbPath, SchemaFNm, Schema, Create, ForceCreate, ReadOnly, StrictNmP, IndexCache, StoreCache, WalP);
+    // compression of inverted index is remembered by the base, so only change it when asked
+    if (Val->IsObjKey("indexCompress")) {
+        JsBase->Base->SetIndexCompress(Val->GetObjBool("indexCompress"));
+    }
+    // search results are cached only when asked
+    if (Val->IsObjKey("queryCache")) {
+        JsBase->Base->SetQueryCache((uint64)Val->GetObjInt("queryCache") * (uint64)TInt::Mega);
+    }
+    // start background flusher when requested
+    if (Val->IsObjKey("flusher")) {
+        PJsonVal FlusherVal = Val->GetObjKey("flusher");
+        const int TickMSecs = FlusherVal->GetObjInt("tick", 100);
+        const int SliceMSecs = FlusherVal->GetObjInt("slice", 10);
+        const uint64 MxDirtyBytes = (uint64)FlusherVal->GetObjInt("maxDirty", 256) * (uint64)TInt::Mega;
+        JsBase->Base->StartFlusher(TickMSecs, SliceMSecs, MxDirtyBytes);
+    }
+    return JsBase;
 }
 
 void TNodeJsBase::close(const v8::FunctionCallbackInfo<v8::Value>& Args) {
@@ -719,6 +746,45 @@ void TNodeJsBase::search(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     Args.GetReturnValue().Set(TNodeJsUtil::NewInstance<TNodeJsRecSet>(new TNodeJsRecSet(RecSet, JsBase->Watcher)));
 }
 
+void TNodeJsBase::searchCount(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    // unwrap
+    TNodeJsBase* JsBase = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsBase>(Args.Holder());
+    TWPt<TQm::TBase> Base = JsBase->Base;
+
+    PJsonVal QueryVal = TNodeJsUtil::GetArgJson(Args, 0);
+    const uint64 Recs = Base->SearchCount(QueryVal);
+    Args.GetReturnValue().Set(v8::Number::New(Isolate, (double)Recs));
+}
+
+void TNodeJsBase::searchExists(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    // unwrap
+    TNodeJsBase* JsBase = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsBase>(Args.Holder());
+    TWPt<TQm::TBase> Base = JsBase->Base;
+
+    PJsonVal QueryVal = TNodeJsUtil::GetArgJson(Args, 0);
+    const bool ExistsP = Base->SearchExists(QueryVal);
+    Args.GetReturnValue().Set(v8::Boolean::New(Isolate, ExistsP));
+}
+
+void TNodeJsBase::explain(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    // unwrap
+    TNodeJsBase* JsBase = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsBase>(Args.Holder());
+    TWPt<TQm::TBase> Base = JsBase->Base;
+
+    PJsonVal QueryVal = TNodeJsUtil::GetArgJson(Args, 0);
+    PJsonVal PlanVal = Base->Explain(QueryVal);
+    Args.GetReturnValue().Set(TNodeJsUtil::ParseJson(Isolate, PlanVal));
+}
+
 void TNodeJsBase::garbageCollect(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
@@ -747,6 +813,30 @@ void TNodeJsBase::partialFlush(const v8::FunctionCallbackInfo<v8::Value>& Args)
     Args.GetReturnValue().Set(v8::Integer::New(Isolate, res));
 }
 
+void TNodeJsBase::saveBinDump(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+    // unwrap
+    TNodeJsBase* JsBase = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsBase>(Args.Holder());
+    TWPt<TQm::TBase> Base = JsBase->Base;
+
+    const TStr DumpDir = TStr::GetNrFPath(TNodeJsUtil::GetArgStr(Args, 0));
+    Base->SaveBinDump(DumpDir);
+    Args.GetReturnValue().Set(v8::Undefined(Isolate));
+}
+
+void TNodeJsBase::restoreBinDump(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+    // unwrap
+    TNodeJsBase* JsBase = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsBase>(Args.Holder());
+    TWPt<TQm::TBase> Base = JsBase->Base;
+
+    const TStr DumpDir = TStr::GetNrFPath(TNodeJsUtil::GetArgStr(Args, 0));
+    Base->RestoreBinDump(DumpDir);
+    Args.GetReturnValue().Set(v8::Undefined(Isolate));
+}
+
 void TNodeJsBase::getStats(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
@@ -814,6 +904,7 @@ void TNodeJsStore::Init(v8::Local<v8::Object> exports) {
     NODE_SET_PROTOTYPE_METHOD(tpl, "each", _each);
     NODE_SET_PROTOTYPE_METHOD(tpl, "map", _map);
     NODE_SET_PROTOTYPE_METHOD(tpl, "push", _push);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "pushValues", _pushValues);
     NODE_SET_PROTOTYPE_METHOD(tpl, "newRecord", _newRecord);
     NODE_SET_PROTOTYPE_METHOD(tpl, "newRecordSet", _newRecordSet);
     NODE_SET_PROTOTYPE_METHOD(tpl, "sample", _sample);
@@ -1093,6 +1184,21 @@ void TNodeJsStore::push(const v8::FunctionCallbackInfo<v8::Value>& Args) {
         const PJsonVal RecVal = TNodeJsUtil::GetArgJson(Args, 0);
         const bool TriggerEvents = TNodeJsUtil::GetArgBool(Args, 1, true);
 
+        if (RecVal->IsArr()) {
+            // array of records is added as one batch
+            TVec<PJsonVal> RecValV(RecVal->GetArrVals(), 0);
+            for (int RecN = 0; RecN < RecVal->GetArrVals(); RecN++) {
+                RecValV.Add(RecVal->GetArrVal(RecN));
+            }
+            TUInt64V RecIdV; Store->AddRecs(RecValV, RecIdV, TriggerEvents);
+            v8::Local<v8::Array> RecIdArr = v8::Array::New(Isolate, RecIdV.Len());
+            for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+                RecIdArr->Set(RecN, v8::Integer::NewFromUnsigned(Isolate, (uint32_t)RecIdV[RecN]));
+            }
+            Args.GetReturnValue().Set(RecIdArr);
+            return;
+        }
+
         const uint64 RecId = Store->AddRec(RecVal, TriggerEvents);
 
         Args.GetReturnValue().Set(v8::Integer::NewFromUnsigned(Isolate, (uint32_t)RecId));
@@ -1102,6 +1208,141 @@ void TNodeJsStore::push(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     }
 }
 
+void TNodeJsStore::pushValues(const v8::FunctionCallbackInfo<v8::Value>& Args) {
+    v8::Isolate* Isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope HandleScope(Isolate);
+
+    try {
+        TNodeJsStore* JsStore = TNodeJsUtil::UnwrapCheckWatcher<TNodeJsStore>(Args.Holder());
+        TWPt<TQm::TStore> Store = JsStore->Store;
+        TWPt<TQm::TBase> Base = JsStore->Store->GetBase();
+
+        // check we can write
+        QmAssertR(!Base->IsRdOnly(), "Base opened as read-only");
+        QmAssertR(Args.Length() > 0 && Args[0]->IsArray(), "Store.pushValues: expects array of field values");
+
+        v8::Local<v8::Array> Array = v8::Local<v8::Array>::Cast(Args[0]);
+        const bool TriggerEvents = TNodeJsUtil::GetArgBool(Args, 1, true);
+        QmAssertR((int)Array->Length() <= Store->GetFields(), "Store.pushValues: more values than fields");
+
+        // values are given in field order, undefined values are treated as not given
+        TQm::TRecBuilder Rec(Store);
+        for (uint32_t FieldN = 0; FieldN < Array->Length(); FieldN++) {
+            v8::Local<v8::Value> Value = Array->Get(FieldN);
+            if (Value->IsUndefined()) { continue; }
+            SetBuilderField(Rec, (int)FieldN, Value);
+        }
+        const uint64 RecId = Store->AddRec(Rec, TriggerEvents);
+
+        Args.GetReturnValue().Set(v8::Integer::NewFromUnsigned(Isolate, (uint32_t)RecId));
+    }
+    catch (const PExcept& Except) {
+        throw TQm::TQmExcept::New("[except] " + Except->GetMsgStr());
+    }
+}
+
+void TNodeJsStore::SetBuilderField(TQm::TRecBuilder& Rec, const int& FieldId, v8::Local<v8::Value> Value) {
+    const TQm::TFieldDesc& Desc = Rec.GetStore()->GetFieldDesc(FieldId);
+    const TStr& FieldNm = Desc.GetFieldNm();
+    if (Value->IsNull()) {
+        QmAssertR(Desc.IsNullable(), "Field " + FieldNm + " not nullable");
+        Rec.SetFieldNull(FieldId);
+    }
+    else if (Desc.IsStr()) {
+        QmAssertR(Value->IsString(), "Field " + FieldNm + " not string");
+        v8::String::Utf8Value Utf8(Value);
+        Rec.SetFieldStr(FieldId, TStr(*Utf8));
+    }
+    else if (Desc.IsBool()) {
+        QmAssertR(Value->IsBoolean(), "Field " + FieldNm + " not boolean");
+        Rec.SetFieldBool(FieldId, Value->BooleanValue());
+    }
+    else if (Desc.IsTm()) {
+        QmAssertR(Value->IsObject() || Value->IsString() || Value->IsNumber(), "Field " + FieldNm + " not object or string");
+        Rec.SetFieldTmMSecs(FieldId, TNodeJsUtil::GetTmMSecs(Value));
+    }
+    else if (Desc.IsFlt() || Desc.IsSFlt()) {
+        QmAssertR(Value->IsNumber(), "Field " + FieldNm + " not numeric");
+        const double Val = Value->NumberValue();
+        if (TFlt::IsNan(Val)) {
+            throw TQm::TQmExcept::New("Cannot set record field (type float) to NaN, for field name: " + FieldNm);
+        }
+        Rec.SetFieldNum(FieldId, Val);
+    }
+    else if (Desc.IsInt() || Desc.IsInt16() || Desc.IsInt64() || Desc.IsByte() ||
+            Desc.IsUInt() || Desc.IsUInt16() || Desc.IsUInt64()) {
+        QmAssertR(Value->IsNumber(), "Field " + FieldNm + " not numeric");
+        Rec.SetFieldNum(FieldId, Value->NumberValue());
+    }
+    else if (Desc.IsIntV()) {
+        QmAssertR(Value->IsArray(), TStr::Fmt("Field %s should be set to an array!", FieldNm.CStr()));
+        v8::Local<v8::Array> Array = v8::Local<v8::Array>::Cast(Value);
+        TIntV IntV(Array->Length(), 0);
+        for (uint32_t IntN = 0; IntN < Array->Length(); IntN++) {
+            v8::Local<v8::Value> ArrayVal = Array->Get(IntN);
+            QmAssertR(ArrayVal->IsInt32(), "Field " + FieldNm + " expects array of integers");
+            IntV.Add(ArrayVal->Int32Value());
+        }
+        Rec.SetFieldIntV(FieldId, IntV);
+    }
+    else if (Desc.IsStrV()) {
+        QmAssertR(Value->IsArray(), "Field " + FieldNm + " not array");
+        v8::Local<v8::Array> Array = v8::Local<v8::Array>::Cast(Value);
+        TStrV StrV(Array->Length(), 0);
+        for (uint32_t StrN = 0; StrN < Array->Length(); StrN++) {
+            v8::Local<v8::Value> ArrayVal = Array->Get(StrN);
+            QmAssertR(ArrayVal->IsString(), "Field " + FieldNm + " expects array of strings");
+            v8::String::Utf8Value Utf8(ArrayVal);
+            StrV.Add(TStr(*Utf8));
+        }
+        Rec.SetFieldStrV(FieldId, StrV);
+    }
+    else if (Desc.IsFltPr()) {
+        QmAssertR(Value->IsArray(), "Field " + FieldNm + " not array");
+        v8::Local<v8::Array> Array = v8::Local<v8::Array>::Cast(Value);
+        QmAssert(Array->Length() >= 2);
+        QmAssert(Array->Get(0)->IsNumber());
+        QmAssert(Array->Get(1)->IsNumber());
+        Rec.SetFieldFltPr(FieldId, TFltPr(Array->Get(0)->NumberValue(), Array->Get(1)->NumberValue()));
+    }
+    else if (Desc.IsFltV()) {
+        if (Value->IsArray()) {
+            v8::Local<v8::Array> Array = v8::Local<v8::Array>::Cast(Value);
+            TFltV FltV(Array->Length(), 0);
+            for (uint32_t FltN = 0; FltN < Array->Length(); FltN++) {
+                v8::Local<v8::Value> ArrayVal = Array->Get(FltN);
+                QmAssertR(ArrayVal->IsNumber(), "Field " + FieldNm + " expects array of numbers");
+                FltV.Add(ArrayVal->NumberValue());
+            }
+            Rec.SetFieldFltV(FieldId, FltV);
+        }
+        else {
+            // otherwise it must be GLib array (or exception)
+            TNodeJsVec<TFlt, TAuxFltV>* JsFltV = ObjectWrap::Unwrap<TNodeJsVec<TFlt, TAuxFltV> >(Value->ToObject());
+            Rec.SetFieldFltV(FieldId, JsFltV->Vec);
+        }
+    }
+    else if (Desc.IsNumSpV()) {
+        // it can only be GLib sparse vector
+        TNodeJsSpVec* JsSpVec = ObjectWrap::Unwrap<TNodeJsSpVec>(Value->ToObject());
+        Rec.SetFieldNumSpV(FieldId, JsSpVec->Vec);
+    }
+    else if (Desc.IsTMem()) {
+        QmAssertR(Value->IsObject(), "Field " + FieldNm + " not object");
+        v8::Local<v8::Object> Object = v8::Local<v8::Object>::Cast(Value);
+        QmAssertR(TNodeJsUtil::IsBuffer(Object), "Field " + FieldNm + " not a buffer");
+        TMem Mem;
+        Mem.AddBf(node::Buffer::Data(Object), (int)node::Buffer::Length(Object));
+        Rec.SetFieldTMem(FieldId, Mem);
+    }
+    else if (Desc.IsJson()) {
+        Rec.SetFieldJsonVal(FieldId, TNodeJsUtil::GetObjJson(Value));
+    }
+    else {
+        throw TQm::TQmExcept::New("Unsupported type for Store.pushValues: " + Desc.GetFieldTypeStr());
+    }
+}
+
 void TNodeJsStore::newRecord(const v8::FunctionCallbackInfo<v8::Value>& Args) {
     v8::Isolate* Isolate = v8::Isolate::GetCurrent();
     v8::HandleScope HandleScope(Isolate);
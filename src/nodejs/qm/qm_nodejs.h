@@ -144,6 +144,24 @@ private:
 * @property  {string} [schemaPath=''] - The path to schema definition file.
 * @property  {Array<module:qm~SchemaDef>} [schema=[]] - Schema definition object array.
 * @property  {string} [dbPath='./db/'] - The path to db directory.
+* @property  {boolean} [wal=false] - If true and mode is `'open'`, changes are written to a write-ahead log,
+* which is replayed when the base is reopened after a crash. Log is committed in groups, by a background thread
+* at most 100 ms after a change, and on {@link module:qm.Base#partialFlush}.
+* @property  {module:qm~BaseFlusherParam} [flusher] - If set, changed data is flushed to disk by a background thread.
+* @property  {boolean} [indexCompress] - If true, posting lists of inverted indexes are stored on disk compressed.
+* Setting is remembered by the base and applies to posting lists written from then on. Defaults to the
+* setting of an opened base, or false for a new base.
+* @property  {number} [queryCache=0] - The memory limit for caching search results in MB. Cached results are
+* dropped when records are added, updated or deleted in a way that affects them. Hits and misses are reported
+* by {@link module:qm.Base#getStats}. Cache is disabled when 0.
+*/
+
+/**
+* @typedef {Object} BaseFlusherParam
+* Background flusher parameters used in {@link module:qm~BaseConstructorParam}.
+* @property {number} [tick=100] - Time between flushes (in milliseconds).
+* @property {number} [slice=10] - Time spent flushing at each tick (in milliseconds).
+* @property {number} [maxDirty=256] - Amount of changed data not yet flushed (in MB), above which adding records waits for the flusher.
 */
 
 /**
@@ -154,6 +172,7 @@ private:
 * @property {Array<module:qm~SchemaJoinDef>} [joins=[]] - The array of join descriptors, used for linking records from different stores.
 * @property {Array<module:qm~SchemaKeyDef>} [keys=[]] - The array of key descriptors. Keys define how records are indexed, which is needed for search using the query language.
 * @property {module:qm~SchemaTimeWindowDef} [timeWindow] - Time window description. Stores can have a window, which is used by garbage collector to delete records once they fall out of the time window. Window can be defined by number of records or by time.
+* @property {module:qm~SchemaHotWindowDef} [hotWindow] - Hot window description. Tiered stores keep in memory only the newest records of fields stored in memory, older blocks are moved to disk.
 * @example
 * var qm = require('qminer');
 * // create a simple movies store, where each record contains only the movie title.
@@ -331,6 +350,10 @@ private:
 * @property {number} duration - The size of the time window (in number of units).
 * @property {string} unit - Defines in which units the window size is specified. Possible options are `'second'`, `'minute'`, `'hour'`, `'day'`, `'week'` or `'month'`.
 * @property {string} [field] - Name of the datetime field, which defines the time of the record. In case it is not given, the insert time is used in its place.
+* @property {module:qm~SchemaTimeWindowSegmentDef} [segment] - Splits the records into time segments of given length. Garbage collector
+* then drops whole segments which ended before the start of the window, without reading and deindexing records one by one. Records
+* are assigned to a segment when added, and can stay in the store up to one segment length longer than the window. Only supported for
+* default stores without joins.
 * @example <caption>Define window by number of records</caption>
 * var qm = require('qminer');
 * // create base
@@ -398,6 +421,40 @@ private:
 * base.close();
 */
 
+/**
+* @typedef {Object} SchemaTimeWindowSegmentDef
+* Length of time segments of a store with a time window. Used in {@link module:qm~SchemaTimeWindowDef}.
+* @property {number} duration - The length of a segment (in number of units).
+* @property {string} [unit='second'] - Defines in which units the segment length is specified. Possible options are `'second'`, `'minute'`, `'hour'`, `'day'`, `'week'` or `'month'`.
+*/
+
+/**
+* @typedef {Object} SchemaHotWindowDef
+* Part of a store kept in memory. Fields stored in memory are kept there only for the newest records,
+* given either by number of records or by time. Blocks of older records are moved to disk when the base
+* is flushed, and are loaded back when read. Used in {@link module:qm~SchemaDef}. Only supported for default stores.
+* @property {number} [records] - Number of newest records kept in memory.
+* @property {number} [duration] - Time span of records kept in memory (in number of units), used when `records` is not given.
+* @property {string} [unit='second'] - Defines in which units the duration is specified. Possible options are `'second'`, `'minute'`, `'hour'`, `'day'`, `'week'` or `'month'`.
+* @property {string} [field] - Name of the datetime field, which defines the time of the record. Defaults to the field of the time window.
+* @example
+* var qm = require('qminer');
+* // keep one week of measurements in memory, and 90 days on disk
+* var base = new qm.Base({
+*     mode: 'createClean',
+*     schema: [{
+*         name: "Measurements",
+*         fields: [
+*             { name: "Time", type: "datetime" },
+*             { name: "Value", type: "float" }
+*         ],
+*         timeWindow: { duration: 90, unit: "day", field: "Time" },
+*         hotWindow: { duration: 7, unit: "day" }
+*     }]
+* });
+* base.close();
+*/
+
 
 class TNodeJsBaseWatcher {
 private:
@@ -442,7 +499,8 @@ public:
     TNodeJsBase(const TWPt<TQm::TBase>& Base_) : Base(Base_) { Watcher = TNodeJsBaseWatcher::New(); }
     TNodeJsBase(const TStr& DbPath, const TStr& SchemaFNm, const PJsonVal& Schema,
         const bool& Create, const bool& ForceCreate, const bool& ReadOnly,
-        const bool& UseStrictFldNames, const uint64& IndexCache, const uint64& StoreCache);
+        const bool& UseStrictFldNames, const uint64& IndexCache, const uint64& StoreCache,
+        const bool& WalP = false);
     // Object that knows if Base is valid
     PNodeJsBaseWatcher Watcher;
 private:
@@ -661,6 +719,87 @@ private:
 
     JsDeclareFunction(search);
 
+    /**
+    * Counts the records matching a query, without returning them. Simple queries, like whole stores, values
+    * of value keys and their conjunctions, and ranges of linear keys, are counted by the index without
+    * collecting the records. `$limit` and `$offset` are applied to the count, `$sort` is ignored.
+    * @param {module:qm~QueryObject} query - Query language JSON object.
+    * @returns {number} The number of records that match the search criterion.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a base with one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "People",
+    *        fields: [{ name: "Name", type: "string" }, { name: "Age", type: "int" }],
+    *        keys: [{ field: "Name", type: "value" }, { field: "Age", type: "linear" }]
+    *    }]
+    * });
+    * base.store("People").push({ Name: "Marge", Age: 36 });
+    * base.store("People").push({ Name: "Bart", Age: 10 });
+    * // count the adults (returns 1)
+    * var adults = base.searchCount({ $from: "People", Age: { $gt: 18 } });
+    * base.close();
+    */
+    //# exports.Base.prototype.searchCount = function (query) { return 0; }
+
+    JsDeclareFunction(searchCount);
+
+    /**
+    * Checks if any record matches a query. Where the index allows it, the search stops at the first matching record.
+    * @param {module:qm~QueryObject} query - Query language JSON object.
+    * @returns {boolean} True when at least one record matches the search criterion.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a base with one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "People",
+    *        fields: [{ name: "Name", type: "string" }],
+    *        keys: [{ field: "Name", type: "value" }]
+    *    }]
+    * });
+    * base.store("People").push({ Name: "Marge" });
+    * // check if there is anybody called Homer (returns false)
+    * var homer = base.searchExists({ $from: "People", Name: "Homer" });
+    * base.close();
+    */
+    //# exports.Base.prototype.searchExists = function (query) { return false; }
+
+    JsDeclareFunction(searchExists);
+
+    /**
+    * Describes how a query is executed, without executing it. Children of `and` and `or` nodes are
+    * listed in the order they are evaluated, from the most selective on. Range conditions of type
+    * `filter` are checked on the records selected by their siblings instead of using the index.
+    * @param {module:qm~QueryObject} query - Query language JSON object.
+    * @returns {Object} The query plan. Each node has a `type`, result `store` and `estRecs`, the estimated
+    * number of matching records. Leaf nodes also have the index `key` and other nodes their `items`.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a base with one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "People",
+    *        fields: [{ name: "Name", type: "string" }, { name: "Age", type: "int" }],
+    *        keys: [{ field: "Name", type: "value" }, { field: "Age", type: "linear" }]
+    *    }]
+    * });
+    * base.store("People").push({ Name: "Marge", Age: 36 });
+    * // get the plan for a conjunction of a name and an age range
+    * var plan = base.explain({ $from: "People", Name: "Marge", Age: { $gt: 18 } });
+    * base.close();
+    */
+    //# exports.Base.prototype.explain = function (query) { return {}; }
+
+    JsDeclareFunction(explain);
+
     /**
     * Calls qminer garbage collector to remove records outside time windows. For application example see {@link module:qm~SchemaTimeWindowDef}.
     * @param {number} [max_time=-1] - Maximal number of time each store can spend on cleaning backlog in milisecons. If -1 then no limit is applied.
@@ -703,6 +842,45 @@ private:
 
     JsDeclareFunction(partialFlush);
 
+    /**
+    * Saves records and index joins of all stores to binary dump files, one pair of files per store.
+    * @param {string} dir - Existing directory where the dump files are saved.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a base with one store and save its binary dump
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{ name: "People", fields: [{ name: "Name", type: "string", primary: true }] }]
+    * });
+    * base.store("People").push({ Name: "Marge" });
+    * base.saveBinDump("./");
+    * base.close();
+    */
+    //# exports.Base.prototype.saveBinDump = function (dir) { }
+
+    JsDeclareFunction(saveBinDump);
+
+    /**
+    * Restores empty stores from binary dump files, created with {@link module:qm.Base#saveBinDump}.
+    * Store schemas must match the dumped ones, except for keys, since indexes are rebuilt.
+    * Stores are restored in parallel. Records get ids starting with the first free id in their store.
+    * @param {string} dir - Directory with the dump files.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a base with the same schema as the dumped one and restore it
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{ name: "People", fields: [{ name: "Name", type: "string", primary: true }] }]
+    * });
+    * base.restoreBinDump("./");
+    * base.close();
+    */
+    //# exports.Base.prototype.restoreBinDump = function (dir) { }
+
+    JsDeclareFunction(restoreBinDump);
+
     /**
     * @typedef {object} PerformanceStat
     * The performance statistics used to describe {@link module:qm~PerformanceStatBase} and {@link module:qm~PerformanceStatStore}.
@@ -741,6 +919,20 @@ private:
     * @property {number} gix_stats.cache_dirty_loaded_perc - \\ TODO: Add the description
     * @property {number} gix_stats.mem_sed - \\ TODO: Add the description
     * @property {module:qm~PerformanceStat} gix_blob - \\ TODO: Add the description
+    * @property {object} [flusher] - Background flusher statistics, present when flusher is running.
+    * @property {number} flusher.dirtyBytes - Size of changed data not yet flushed, measured after the last flush.
+    * @property {number} flusher.maxDirtyBytes - Size of changed data above which adding records waits for the flusher.
+    * @property {number} flusher.flushes - Number of flushes.
+    * @property {number} flusher.flushedBlocks - Number of blocks written to disk by the flusher.
+    * @property {number} flusher.throttles - Number of times adding records waited for the flusher.
+    * @property {number} flusher.throttleMSecs - Total time adding records waited for the flusher (in milliseconds).
+    * @property {object} [query_cache] - Search result cache statistics, present when cache is enabled.
+    * @property {number} query_cache.results - Number of cached results.
+    * @property {number} query_cache.memUsed - Memory used by cached results.
+    * @property {number} query_cache.maxMemUsed - Memory limit of the cache.
+    * @property {number} query_cache.hits - Number of searches answered from the cache.
+    * @property {number} query_cache.misses - Number of searches which could be cached, but were not found in the cache.
+    * @property {number} query_cache.invalidations - Number of cached results dropped, since records they depend on changed.
     */
 
     /**
@@ -971,6 +1163,8 @@ public:
     static v8::Local<v8::Value> Field(const TQm::TRec& Rec, const int FieldId);
     static v8::Local<v8::Value> Field(const TWPt<TQm::TStore>& Store, const uint64& RecId, const int FieldId);
 private:
+    // Record builder field setter from JavaScript value
+    static void SetBuilderField(TQm::TRecBuilder& Rec, const int& FieldId, v8::Local<v8::Value> Value);
 
     /**
     * Returns a record from the store.
@@ -1068,9 +1262,10 @@ private:
 
     /**
     * Adds a record to the store.
-    * @param {object} rec - The added record. The record must be a object corresponding to store schema created at store creation using {@link module:qm~SchemaDef}.
+    * @param {(object | Array.<object>)} rec - The added record. The record must be a object corresponding to store schema created at store creation using {@link module:qm~SchemaDef}.
+    * When given an array of records, they are added as one batch, which groups the updates of the inverted index.
     * @param {boolean} [triggerEvents=true] - If true, all stream aggregate callbacks `onAdd` will be called after the record is inserted. If false, no stream aggregate will be updated.
-    * @returns {number} The ID of the added record.
+    * @returns {(number | Array.<number>)} The ID of the added record, or an array of IDs when an array of records was added.
     * @example
     * // import qm module
     * var qm = require('qminer');
@@ -1102,6 +1297,36 @@ private:
     //# exports.Store.prototype.push = function (rec, triggerEvents) { return 0; }
     JsDeclareFunction(push);
 
+    /**
+    * Adds a record to the store, given as an array of field values. Values are converted directly to the
+    * store's internal representation, skipping the JSON conversion done by {@link module:qm.Store#push},
+    * which makes it the faster option for bulk loading. Joins and references to existing records are not supported.
+    * @param {Array} values - Field values, in the same order as fields in {@link module:qm.Store#fields}. Values set to `undefined`
+    * are treated as missing (default value is used when available), values set to `null` set the field to null.
+    * @param {boolean} [triggerEvents=true] - If true, all stream aggregate callbacks `onAdd` will be called after the record is inserted. If false, no stream aggregate will be updated.
+    * @returns {number} The ID of the added record.
+    * @example
+    * // import qm module
+    * var qm = require('qminer');
+    * // create a new base containing one store
+    * var base = new qm.Base({
+    *    mode: "createClean",
+    *    schema: [{
+    *        name: "Superheroes",
+    *        fields: [
+    *            { name: "Name", type: "string" },
+    *            { name: "Superpowers", type: "string_v" },
+    *            { name: "YearOfBirth", type: "int", null: true }
+    *        ]
+    *    }]
+    * });
+    * // add a new superhero to the Superheroes store
+    * base.store("Superheroes").pushValues(["Superman", ["flight", "heat vision", "bulletproof"], 1938]); // returns 0
+    * base.close();
+    */
+    //# exports.Store.prototype.pushValues = function (values, triggerEvents) { return 0; }
+    JsDeclareFunction(pushValues);
+
     /**
     * Creates a new record of given store. The record is not added to the store.
     * @param {object} obj - An object describing the record.
@@ -74,8 +74,12 @@ module.exports = exports = function (pathQmBinary) {
 					var header = headers[i];
 					var value = line[i];
 
-					if (fieldTypes != null && fieldTypes[header] != null) {
-						transformed[header] = fieldTypes[header] == 'float' ? parseFloat(value) : value;
+					if (fieldTypes != null && fieldTypes[header] == 'float') {
+						transformed[header] = value.length == 0 ? value : parseFloat(value);
+						if (isNaN(transformed[header]))
+							throw new Error('Line ' + line + ': value "' + value + '" of float field ' + header + ' is not a number');
+					} else if (fieldTypes != null && fieldTypes[header] != null) {
+						transformed[header] = value;
 					} else {
 						transformed[header] = (isNaN(value) || value.length == 0) ? value : parseFloat(value);
 					}
@@ -84,6 +88,29 @@ module.exports = exports = function (pathQmBinary) {
 				return transformed;
 			}
 
+			// converts a transformed line into an array of field values for store.pushValues,
+			// in the same order as the fields were created; empty cells become null and
+			// values which do not match the field type throw
+			var fieldNames = [];
+			function getValues(data) {
+				var values = [];
+				for (var i = 0; i < fieldNames.length; i++) {
+					var value = data[fieldNames[i]];
+					if (fieldTypes[fieldNames[i]] == 'float') {
+						if (value == null || value === '') {
+							values.push(null);
+						} else if (typeof value == 'number' && !isNaN(value)) {
+							values.push(value);
+						} else {
+							throw new Error('Line ' + data.$line + ': value "' + value + '" of float field ' + fieldNames[i] + ' is not a number');
+						}
+					} else {
+						values.push(value == null ? null : String(value));
+					}
+				}
+				return values;
+			}
+
     		function initFieldTypes(data) {
     			if (fieldTypes == null) fieldTypes = {};
 
@@ -135,6 +162,7 @@ module.exports = exports = function (pathQmBinary) {
 	    			};
 
 	    			for (var fieldName in rec) {
+	    				fieldNames.push(fieldName);
 	    				storeDef.fields.push({
 							name: fieldName,
 							type: fieldTypes[fieldName],
@@ -148,14 +176,28 @@ module.exports = exports = function (pathQmBinary) {
 	    			store = base.store(storeName);
 
 	    			// insert all the record in the buffer into the store
-	    			buff.forEach(function (data) {
-	    				store.push(data);
-	    			});
+	    			buff.forEach(pushLine);
     			} catch (e) {
 					callback(e);
     			}
     		}
 
+			// rows which can not be stored are skipped and reported when loading finishes
+			var rejectedLines = 0;
+			var firstRejection = null;
+			function reject(e) {
+				if (rejectedLines++ == 0)
+					firstRejection = e.message;
+			}
+
+			function pushLine(data) {
+				try {
+					store.pushValues(getValues(data));
+				} catch (e) {
+					reject(e);
+				}
+			}
+
 			var storeCreated = false;
 			var line = 0;
 			// console.log('Saving CSV to store ' + storeName + ' ' + fname + ' ...');
@@ -176,7 +218,14 @@ module.exports = exports = function (pathQmBinary) {
 								// console.log(line + '');
                             }
                             
-							var data = transformLine(lineArr);
+							var data;
+							try {
+								data = transformLine(lineArr);
+							} catch (e) {
+								reject(e);
+								return;
+							}
+							Object.defineProperty(data, '$line', { value: line });
 
 							if (fieldTypes == null)
 								initFieldTypes(data);
@@ -187,7 +236,7 @@ module.exports = exports = function (pathQmBinary) {
 								initFieldTypes(data);
 
 							if (store != null) {
-								store.push(data);
+								pushLine(data);
 							} else
 								buff.push(data);
 						}
@@ -206,6 +255,9 @@ module.exports = exports = function (pathQmBinary) {
 				   			callback(new Error('Finished with uninitialized fields: ' +
 								JSON.stringify(fieldNames)) + ', add them to ignore list!');
 				   			return;
+				   		} else if (rejectedLines > 0) {
+				   			callback(new Error('Rejected ' + rejectedLines + ' lines with values not matching ' +
+								'the field types, first: ' + firstRejection), store);
 				   		} else {
 				   			callback(undefined, store);
 				   		}
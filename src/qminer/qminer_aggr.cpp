@@ -111,6 +111,24 @@ PJsonVal TCount::SaveJson() const {
 
 ///////////////////////////////
 // QMiner-Aggregator-Histogram
+void THistogram::Def(const TFltV& ValV, const int& Buckets) {
+    // find min and max for histogram
+    double MnVal = TFlt::Mx, MxVal = TFlt::Mn;
+    for (int ValN = 0; ValN < ValV.Len(); ValN++) {
+        MnVal = TFlt::GetMn(MnVal, ValV[ValN].Val);
+        MxVal = TFlt::GetMx(MxVal, ValV[ValN].Val);
+    }
+    // compute histogram
+    Mom = TMom::New(); Sum = 0.0;
+    Hist = THist(MnVal, MxVal, Buckets);
+    for (int ValN = 0; ValN < ValV.Len(); ValN++) {
+        const double Val = ValV[ValN].Val;
+        Mom->Add(Val); Sum += Val;
+        Hist.Add(Val, true);
+    }
+    Mom->Def();
+}
+
 THistogram::THistogram(const TWPt<TBase>& Base, const TStr& AggrNm,
         const PRecSet& RecSet, const PFtrExt& FtrExt, const int& Buckets):
             TAggr(Base, AggrNm) {
@@ -121,29 +139,24 @@ THistogram::THistogram(const TWPt<TBase>& Base, const TStr& AggrNm,
     FieldNm = FtrExt->GetNm();
     // if empty result set no need to do histogams
     if (RecSet->Empty()) { return; }
-    // find min and max for histogram
-    double MnVal = TFlt::Mx, MxVal = TFlt::Mn;
+    // extract values in one pass over the records
+    TFltV ValV;
     const int Recs = RecSet->GetRecs();
     for (int RecN = 0; RecN < Recs; RecN++) {
-        TFltV FtrValV; FtrExt->ExtractFltV(RecSet->GetRec(RecN), FtrValV);
-        for (int FtrValN = 0; FtrValN < FtrValV.Len(); FtrValN++) {
-            const double Val = FtrValV[FtrValN];
-            MnVal = TFlt::GetMn(MnVal, Val);
-            MxVal = TFlt::GetMx(MxVal, Val);
-        }
-    }
-    // compute histogram
-    Mom = TMom::New(); Sum = 0.0;
-    Hist = THist(MnVal, MxVal, Buckets);
-    for (int RecN = 0; RecN < Recs; RecN++) {
-        TFltV FtrValV; FtrExt->ExtractFltV(RecSet->GetRec(RecN), FtrValV);
-        for (int FtrValN = 0; FtrValN < FtrValV.Len(); FtrValN++) {
-            const double FtrVal = FtrValV[FtrValN].Val;
-            Mom->Add(FtrVal); Sum += FtrVal;
-            Hist.Add(FtrValV[FtrValN], true);
-        }
+        FtrExt->ExtractFltV(RecSet->GetRec(RecN), ValV);
     }
-    Mom->Def();
+    Def(ValV, Buckets);
+}
+
+THistogram::THistogram(const TWPt<TBase>& Base, const TStr& AggrNm, const PRecSet& RecSet,
+        const PFtrExt& FtrExt, const int& FieldId, const int& Buckets): TAggr(Base, AggrNm) {
+
+    JoinPathStr = FtrExt->GetJoinSeq(RecSet->GetStoreId()).GetJoinPathStr(Base);
+    FieldNm = FtrExt->GetNm();
+    if (RecSet->Empty()) { return; }
+    // read values straight from the field column
+    TFltV ValV; RecSet->GetStore()->GetFieldFltV(RecSet->GetRecIdFqV(), FieldId, ValV);
+    Def(ValV, Buckets);
 }
 
 PAggr THistogram::New(const TWPt<TBase>& Base, const TStr& AggrNm,
@@ -164,6 +177,9 @@ PAggr THistogram::New(const TWPt<TBase>& Base, const TStr& AggrNm,
     const int Buckets = TFlt::Round(JsonVal->GetObjNum("buckets", 10.0));
     // prepare feature extractor
     PFtrExt FtrExt = TFtrExts::TNumeric::New(Base, JoinSeq, FieldId);
+    // columnar stores can give us the values without going through records
+    if (!JoinSeq.IsJoin() && Store->HasColumnScan()) {
+        return new THistogram(Base, AggrNm, RecSet, FtrExt, FieldId, Buckets); }
     return New(Base, AggrNm, RecSet, FtrExt, Buckets);
 }
 
@@ -66,6 +66,11 @@ private:
 
     THistogram(const TWPt<TBase>& Base, const TStr& AggrNm,
         const PRecSet& RecSet, const PFtrExt& FtrExt, const int& Buckets);
+    // reads values of the field using column scan of the record set store
+    THistogram(const TWPt<TBase>& Base, const TStr& AggrNm, const PRecSet& RecSet,
+        const PFtrExt& FtrExt, const int& FieldId, const int& Buckets);
+    // computes aggregations from extracted values
+    void Def(const TFltV& ValV, const int& Buckets);
 public:
     static PAggr New(const TWPt<TBase>& Base, const TStr& AggrNm,
         const PRecSet& RecSet, const PFtrExt& FtrExt, const int& Buckets) {
@@ -10,6 +10,8 @@
 #include "qminer_ftr.h"
 #include "qminer_aggr.h"
 
+#include <thread.h>
+
 namespace TQm {
 
 ///////////////////////////////
@@ -393,6 +395,14 @@ bool TStoreIterVec::Next() {
     return true;
 }
 
+///////////////////////////////
+// QMiner-Store-Trigger
+void TStoreTrigger::OnDeleteRecs(const PRecSet& RecSet) {
+    for (int RecN = 0; RecN < RecSet->GetRecs(); RecN++) {
+        OnDelete(RecSet->GetRec(RecN));
+    }
+}
+
 ///////////////////////////////
 // QMiner-Store
 void TStore::LoadStore(TSIn& SIn) {
@@ -451,21 +461,35 @@ PExcept TStore::FieldError(const int& FieldId, const TStr& TypeStr) const {
     return TQmExcept::New(TStr::Fmt("Wrong field-type combination requested: [%d:%s]!", FieldId, TypeStr.CStr()));
 }
 
+void TStore::TouchStore() {
+    Index->TouchStore(StoreId);
+}
+
 void TStore::OnAdd(const uint64& RecId) {
     OnAdd(GetRec(RecId));
 }
 
 void TStore::OnAdd(const TRec& Rec) {
+    TouchStore();
     for (int TriggerN = 0; TriggerN < TriggerV.Len(); TriggerN++) {
         TriggerV[TriggerN]->OnAdd(Rec);
     }
 }
 
+void TStore::OnAdd(const TUInt64V& RecIdV) {
+    // records go through all triggers one by one, since stream aggregates
+    // can read the state of aggregates registered before them
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+        OnAdd(GetRec(RecIdV[RecN]));
+    }
+}
+
 void TStore::OnUpdate(const uint64& RecId) {
     OnUpdate(GetRec(RecId));
 }
 
 void TStore::OnUpdate(const TRec& Rec) {
+    TouchStore();
     for (int TriggerN = 0; TriggerN < TriggerV.Len(); TriggerN++) {
         TriggerV[TriggerN]->OnUpdate(Rec);
     }
@@ -476,11 +500,21 @@ void TStore::OnDelete(const uint64& RecId) {
 }
 
 void TStore::OnDelete(const TRec& Rec) {
+    TouchStore();
     for (int TriggerN = 0; TriggerN < TriggerV.Len(); TriggerN++) {
         TriggerV[TriggerN]->OnDelete(Rec);
     }
 }
 
+void TStore::OnDelete(const TUInt64V& RecIdV) {
+    TouchStore();
+    if (TriggerV.Empty() || RecIdV.Empty()) { return; }
+    PRecSet RecSet = TRecSet::New(this, RecIdV);
+    for (int TriggerN = 0; TriggerN < TriggerV.Len(); TriggerN++) {
+        TriggerV[TriggerN]->OnDeleteRecs(RecSet);
+    }
+}
+
 void TStore::StrVToIntV(const TStrV& StrV, TStrHash<TInt, TBigStrPool>& StrH, TIntV& IntV) {
     const int Len = StrV.Len(); IntV.Gen(Len, 0);
     for (int StrN = 0; StrN < Len; StrN++) {
@@ -650,8 +684,96 @@ PRecSet TStore::GetRndRecs(const uint64& SampleSize) {
     return GetAllRecs()->GetSampleRecSet((int)SampleSize);
 }
 
+void TStore::AddRecs(const TVec<PJsonVal>& RecValV, TUInt64V& RecIdV, const bool& TriggerEvents) {
+    // readers must not see the index while additions are buffered
+    TWriteScope WriteScope(Base);
+    RecIdV.Gen(RecValV.Len(), 0);
+    // ids of newly added records, for which we call triggers at the end
+    TUInt64V NewRecIdV(RecValV.Len(), 0);
+    GetIndex()->StartBatch();
+    try {
+        for (int RecN = 0; RecN < RecValV.Len(); RecN++) {
+            const uint64 Recs = GetRecs();
+            const uint64 RecId = AddRec(RecValV[RecN], false);
+            RecIdV.Add(RecId);
+            // references to existing records are not new
+            if (GetRecs() > Recs) { NewRecIdV.Add(RecId); }
+        }
+    } catch (const PExcept& Except) {
+        // index and announce records added before the failure
+        GetIndex()->EndBatch();
+        if (TriggerEvents) { OnAdd(NewRecIdV); }
+        throw;
+    }
+    GetIndex()->EndBatch();
+    if (TriggerEvents) { OnAdd(NewRecIdV); }
+}
+
+uint64 TStore::AddRec(const TRecBuilder& Rec, const bool& TriggerEvents) {
+    QmAssertR(Rec.GetStore()->GetStoreId() == GetStoreId(), "Record builder created for store " + Rec.GetStore()->GetStoreNm());
+    return AddRec(Rec.GetJson(), TriggerEvents);
+}
+
+bool TStore::IsWalReplay() const {
+    return Base->IsWal() && Base->GetWal()->IsReplay();
+}
+
+void TStore::WalUpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
+    TWalScope WalScope(Base);
+    if (WalScope.IsLog()) {
+        PJsonVal Val = TJsonVal::NewObj("$id", RecId);
+        Val->AddToObj("rec", RecVal);
+        WalScope.Log(wotUpdateRec, GetStoreId(), Val);
+    }
+}
+
+void TStore::WalSetField(const uint64& RecId, const int& FieldId) {
+    TWalScope WalScope(Base);
+    if (WalScope.IsLog()) {
+        PJsonVal FieldVal = IsFieldNull(RecId, FieldId) ? TJsonVal::NewNull() : GetFieldJson(RecId, FieldId);
+        PJsonVal Val = TJsonVal::NewObj("$id", RecId);
+        Val->AddToObj("rec", TJsonVal::NewObj(GetFieldNm(FieldId), FieldVal));
+        WalScope.Log(wotUpdateRec, GetStoreId(), Val);
+    }
+}
+
+void TStore::WalAddRec(TWalScope& WalScope, const uint64& RecId, const TRecBuilder& Rec) {
+    if (WalScope.IsLog()) {
+        PJsonVal RecVal = Rec.GetJson();
+        const int InsertedAtFieldId = Rec.GetInsertedAtFieldId();
+        if (InsertedAtFieldId != -1) {
+            RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName,
+                TTm::GetTmFromMSecs(GetFieldTmMSecs(RecId, InsertedAtFieldId)).GetStr());
+        }
+        WalScope.Log(wotAddRec, GetStoreId(), RecVal);
+    }
+}
+
+void TStore::WalDelRecs(TWalScope& WalScope, const TUInt64V& DelRecIdV, const int& DelRecs) {
+    if (WalScope.IsLog() && DelRecs > 0) {
+        PJsonVal IdsVal = TJsonVal::NewArr();
+        for (int DelRecN = 0; DelRecN < DelRecs; DelRecN++) {
+            IdsVal->AddToArr(TJsonVal::NewNum((double)DelRecIdV[DelRecN]));
+        }
+        WalScope.Log(wotDelRecs, GetStoreId(), TJsonVal::NewObj("ids", IdsVal));
+    }
+}
+
+PJsonVal TStore::GetWalJoinVal(const int& JoinId, const uint64& RecId, const uint64& JoinRecId, const int& JoinFq) {
+    PJsonVal Val = TJsonVal::NewObj("join", JoinId);
+    Val->AddToObj("$id", RecId);
+    Val->AddToObj("join$id", JoinRecId);
+    Val->AddToObj("fq", JoinFq);
+    return Val;
+}
+
 void TStore::AddJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRecId, const int& JoinFq) {
+    // joined records are updated as part of this call
+    TWalScope WalScope(Base);
+    TFlushScope FlushScope(Base->GetFlusher());
+    TWriteScope WriteScope(Base);
     const TJoinDesc& JoinDesc = GetJoinDesc(JoinId);
+    TouchStore();
     // different handling for field and index joins
     if (JoinDesc.IsIndexJoin()) {
         Index->IndexJoin(this, JoinId, RecId, JoinRecId, JoinFq);
@@ -678,6 +800,7 @@ void TStore::AddJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRe
         // get inverse join parameters
         TWPt<TStore> JoinStore = JoinDesc.GetJoinStore(Base);
         const int InverseJoinId = JoinDesc.GetInverseJoinId();
+        JoinStore->TouchStore();
         const TJoinDesc& InverseJoinDesc = JoinStore->GetJoinDesc(InverseJoinId);
         // different handling for field and index joins
         if (InverseJoinDesc.IsIndexJoin()) {
@@ -703,6 +826,7 @@ void TStore::AddJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRe
             }
         }
     }
+    WalScope.Log(wotAddJoin, GetStoreId(), GetWalJoinVal(JoinId, RecId, JoinRecId, JoinFq));
 }
 
 void TStore::AddJoin(const TStr& JoinNm, const uint64& RecId, const uint64 JoinRecId, const int& JoinFq) {
@@ -710,7 +834,12 @@ void TStore::AddJoin(const TStr& JoinNm, const uint64& RecId, const uint64 JoinR
 }
 
 void TStore::DelJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRecId, const int& JoinFq) {
+    // joined records are updated as part of this call
+    TWalScope WalScope(Base);
+    TFlushScope FlushScope(Base->GetFlusher());
+    TWriteScope WriteScope(Base);
     const TJoinDesc& JoinDesc = GetJoinDesc(JoinId);
+    TouchStore();
     // different handling for field and index joins
     if (JoinDesc.IsIndexJoin()) {
         Index->DeleteJoin(this, JoinId, RecId, JoinRecId, JoinFq);
@@ -725,6 +854,7 @@ void TStore::DelJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRe
         // get inverse join parameters
         TWPt<TStore> JoinStore = JoinDesc.GetJoinStore(Base);
         const int InverseJoinId = JoinDesc.GetInverseJoinId();
+        JoinStore->TouchStore();
         const TJoinDesc& InverseJoinDesc = JoinStore->GetJoinDesc(InverseJoinId);
         // different handling for field and index joins
         if (InverseJoinDesc.IsIndexJoin()) {
@@ -736,6 +866,7 @@ void TStore::DelJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRe
             }
         }
     }
+    WalScope.Log(wotDelJoin, GetStoreId(), GetWalJoinVal(JoinId, RecId, JoinRecId, JoinFq));
 }
 
 void TStore::DelJoin(const TStr& JoinNm, const uint64& RecId, const uint64 JoinRecId, const int& JoinFq) {
@@ -1009,6 +1140,14 @@ PJsonVal TStore::GetFieldJson(const uint64& RecId, const int& FieldId) const {
     throw FieldError(FieldId, "GetFieldJson");
 }
 
+void TStore::GetFieldsJson(const uint64& RecId, const TIntV& FieldIdV, const PJsonVal& RecVal) const {
+    for (int FieldIdN = 0; FieldIdN < FieldIdV.Len(); FieldIdN++) {
+        const int FieldId = FieldIdV[FieldIdN];
+        if (IsFieldNull(RecId, FieldId)) { continue; }
+        RecVal->AddToObj(GetFieldNm(FieldId), GetFieldJson(RecId, FieldId));
+    }
+}
+
 TStr TStore::GetFieldText(const uint64& RecId, const int& FieldId) const {
     const TFieldDesc& Desc = GetFieldDesc(FieldId);
     if (Desc.IsInt()) {
@@ -2400,18 +2539,19 @@ PJsonVal TRec::GetJson(const TWPt<TBase>& Base, const bool& FieldsP,
     }
     // if no fields and stuff, just return what we have
     if (FieldsP) {
-        // get the fields
+        // get the fields, skipping internal fields (e.g. record ids for joins)
         const int Fields = Store->GetFields();
+        TIntV FieldIdV(Fields, 0);
         for (int FieldN = 0; FieldN < Fields; FieldN++) {
-            const TFieldDesc& Desc = Store->GetFieldDesc(FieldN);
-            // skip internal fields (e.g. record ids for joins)
-            if (Desc.IsInternal()) { continue; }
-            if (ByRefP) {
-                if (Store->IsFieldNull(RecId, FieldN)) { continue; }
-                RecVal->AddToObj(Desc.GetFieldNm(), Store->GetFieldJson(RecId, FieldN));
-            } else {
-                if (IsFieldNull(FieldN)) { continue; }
-                RecVal->AddToObj(Desc.GetFieldNm(), GetFieldJson(FieldN));
+            if (!Store->GetFieldDesc(FieldN).IsInternal()) { FieldIdV.Add(FieldN); }
+        }
+        if (ByRefP) {
+            Store->GetFieldsJson(RecId, FieldIdV, RecVal);
+        } else {
+            for (int FieldIdN = 0; FieldIdN < FieldIdV.Len(); FieldIdN++) {
+                const int FieldId = FieldIdV[FieldIdN];
+                if (IsFieldNull(FieldId)) { continue; }
+                RecVal->AddToObj(Store->GetFieldNm(FieldId), GetFieldJson(FieldId));
             }
         }
     }
@@ -2442,6 +2582,194 @@ PJsonVal TRec::GetJson(const TWPt<TBase>& Base, const bool& FieldsP,
     return RecVal;
 }
 
+///////////////////////////////
+/// Record builder
+PExcept TRecBuilder::FieldError(const int& FieldId, const TStr& TypeStr) const {
+    return TQmExcept::New(TStr::Fmt("Wrong field-type combination requested: [%d:%s]!", FieldId, TypeStr.CStr()));
+}
+
+void TRecBuilder::SetField(const int& FieldId, const TFieldType& FieldType, const TStr& TypeStr) {
+    if (FieldTypeV[FieldId] != (int)FieldType) { throw FieldError(FieldId, TypeStr); }
+    FieldStateV[FieldId] = rbfsSet;
+}
+
+TRecBuilder::TRecBuilder(const TWPt<TStore>& _Store): Store(_Store), InsertedAtFieldId(-1) {
+    const int Fields = Store->GetFields();
+    FieldTypeV.Gen(Fields, 0); SlotNV.Gen(Fields, 0);
+    for (int FieldId = 0; FieldId < Fields; FieldId++) {
+        const TFieldType FieldType = Store->GetFieldDesc(FieldId).GetFieldType();
+        FieldTypeV.Add((int)FieldType);
+        // each field gets a slot in the vector holding values of its type
+        switch (FieldType) {
+            case oftByte: case oftInt: case oftInt16: case oftInt64: case oftUInt:
+            case oftUInt16: case oftUInt64: case oftBool: case oftTm:
+                SlotNV.Add(NumV.Add()); break;
+            case oftFlt: case oftSFlt: case oftFltPr: SlotNV.Add(FltV.Add()); break;
+            case oftStr: SlotNV.Add(StrV.Add()); break;
+            case oftIntV: SlotNV.Add(IntVV.Add()); break;
+            case oftStrV: SlotNV.Add(StrVV.Add()); break;
+            case oftFltV: SlotNV.Add(FltVV.Add()); break;
+            case oftNumSpV: SlotNV.Add(NumSpVV.Add()); break;
+            case oftTMem: SlotNV.Add(MemV.Add()); break;
+            case oftJson: SlotNV.Add(JsonV.Add()); break;
+            // setters reject fields of other types
+            default: SlotNV.Add(-1);
+        }
+    }
+    FieldStateV.Gen(Fields); FieldStateV.PutAll(rbfsUnset);
+    if (Store->IsFieldNm(TStoreWndDesc::SysInsertedAtFieldName)) {
+        InsertedAtFieldId = Store->GetFieldId(TStoreWndDesc::SysInsertedAtFieldName);
+    }
+}
+
+void TRecBuilder::Clr() {
+    FieldStateV.PutAll(rbfsUnset);
+}
+
+void TRecBuilder::SetFieldNull(const int& FieldId) {
+    QmAssertR(Store->GetFieldDesc(FieldId).IsNullable(), "Non-nullable field " + Store->GetFieldNm(FieldId) + " set to null");
+    FieldStateV[FieldId] = rbfsNull;
+}
+
+void TRecBuilder::SetFieldByte(const int& FieldId, const uchar& Byte) {
+    SetField(FieldId, oftByte, "Byte"); NumV[SlotNV[FieldId]] = (uint64)Byte;
+}
+
+void TRecBuilder::SetFieldInt(const int& FieldId, const int& Int) {
+    SetField(FieldId, oftInt, "Int"); NumV[SlotNV[FieldId]] = (uint64)(int64)Int;
+}
+
+void TRecBuilder::SetFieldInt16(const int& FieldId, const int16& Int16) {
+    SetField(FieldId, oftInt16, "Int16"); NumV[SlotNV[FieldId]] = (uint64)(int64)Int16;
+}
+
+void TRecBuilder::SetFieldInt64(const int& FieldId, const int64& Int64) {
+    SetField(FieldId, oftInt64, "Int64"); NumV[SlotNV[FieldId]] = (uint64)Int64;
+}
+
+void TRecBuilder::SetFieldIntV(const int& FieldId, const TIntV& IntV) {
+    SetField(FieldId, oftIntV, "IntV"); IntVV[SlotNV[FieldId]] = IntV;
+}
+
+void TRecBuilder::SetFieldUInt(const int& FieldId, const uint& UInt) {
+    SetField(FieldId, oftUInt, "UInt"); NumV[SlotNV[FieldId]] = (uint64)UInt;
+}
+
+void TRecBuilder::SetFieldUInt16(const int& FieldId, const uint16& UInt16) {
+    SetField(FieldId, oftUInt16, "UInt16"); NumV[SlotNV[FieldId]] = (uint64)UInt16;
+}
+
+void TRecBuilder::SetFieldUInt64(const int& FieldId, const uint64& UInt64) {
+    SetField(FieldId, oftUInt64, "UInt64"); NumV[SlotNV[FieldId]] = UInt64;
+}
+
+void TRecBuilder::SetFieldStr(const int& FieldId, const TStr& Str) {
+    SetField(FieldId, oftStr, "Str"); StrV[SlotNV[FieldId]] = Str;
+}
+
+void TRecBuilder::SetFieldStrV(const int& FieldId, const TStrV& _StrV) {
+    SetField(FieldId, oftStrV, "StrV"); StrVV[SlotNV[FieldId]] = _StrV;
+}
+
+void TRecBuilder::SetFieldBool(const int& FieldId, const bool& Bool) {
+    SetField(FieldId, oftBool, "Bool"); NumV[SlotNV[FieldId]] = Bool ? 1 : 0;
+}
+
+void TRecBuilder::SetFieldFlt(const int& FieldId, const double& Flt) {
+    SetField(FieldId, oftFlt, "Flt"); FltV[SlotNV[FieldId]].Val1 = Flt;
+}
+
+void TRecBuilder::SetFieldSFlt(const int& FieldId, const float& Flt) {
+    SetField(FieldId, oftSFlt, "SFlt"); FltV[SlotNV[FieldId]].Val1 = (double)Flt;
+}
+
+void TRecBuilder::SetFieldFltV(const int& FieldId, const TFltV& _FltV) {
+    SetField(FieldId, oftFltV, "FltV"); FltVV[SlotNV[FieldId]] = _FltV;
+}
+
+void TRecBuilder::SetFieldFltPr(const int& FieldId, const TFltPr& FltPr) {
+    SetField(FieldId, oftFltPr, "FltPr"); FltV[SlotNV[FieldId]] = FltPr;
+}
+
+void TRecBuilder::SetFieldTm(const int& FieldId, const TTm& Tm) {
+    SetFieldTmMSecs(FieldId, TTm::GetMSecsFromTm(Tm));
+}
+
+void TRecBuilder::SetFieldTmMSecs(const int& FieldId, const uint64& TmMSecs) {
+    SetField(FieldId, oftTm, "Tm"); NumV[SlotNV[FieldId]] = TmMSecs;
+}
+
+void TRecBuilder::SetFieldNumSpV(const int& FieldId, const TIntFltKdV& NumSpV) {
+    SetField(FieldId, oftNumSpV, "NumSpV");
+    // same as when parsing from JSon, sparse vectors are stored sorted
+    NumSpVV[SlotNV[FieldId]] = NumSpV; NumSpVV[SlotNV[FieldId]].Sort();
+}
+
+void TRecBuilder::SetFieldTMem(const int& FieldId, const TMem& Mem) {
+    SetField(FieldId, oftTMem, "TMem"); MemV[SlotNV[FieldId]] = Mem;
+}
+
+void TRecBuilder::SetFieldJsonVal(const int& FieldId, const PJsonVal& Json) {
+    SetField(FieldId, oftJson, "Json"); JsonV[SlotNV[FieldId]] = Json;
+}
+
+void TRecBuilder::SetFieldNum(const int& FieldId, const double& Num) {
+    switch (FieldTypeV[FieldId]) {
+        case oftByte: SetFieldByte(FieldId, (uchar)Num); break;
+        case oftInt: SetFieldInt(FieldId, (int)Num); break;
+        case oftInt16: SetFieldInt16(FieldId, (int16)Num); break;
+        case oftInt64: SetFieldInt64(FieldId, (int64)Num); break;
+        case oftUInt: SetFieldUInt(FieldId, (uint)Num); break;
+        case oftUInt16: SetFieldUInt16(FieldId, (uint16)Num); break;
+        case oftUInt64: SetFieldUInt64(FieldId, (uint64)Num); break;
+        case oftBool: SetFieldBool(FieldId, Num != 0.0); break;
+        case oftFlt: SetFieldFlt(FieldId, Num); break;
+        case oftSFlt: SetFieldSFlt(FieldId, (float)Num); break;
+        case oftTm: SetFieldTmMSecs(FieldId, TTm::GetWinMSecsFromUnixMSecs((int64)Num)); break;
+        default: throw FieldError(FieldId, "Num");
+    }
+}
+
+PJsonVal TRecBuilder::GetJson() const {
+    PJsonVal RecVal = TJsonVal::NewObj();
+    for (int FieldId = 0; FieldId < GetFields(); FieldId++) {
+        if (!IsFieldSet(FieldId)) { continue; }
+        const TStr& FieldNm = Store->GetFieldNm(FieldId);
+        if (IsFieldNull(FieldId)) { RecVal->AddToObj(FieldNm, TJsonVal::NewNull()); continue; }
+        switch (FieldTypeV[FieldId]) {
+            case oftByte: case oftInt: case oftInt16: case oftInt64:
+                RecVal->AddToObj(FieldNm, (double)GetFieldInt64(FieldId)); break;
+            case oftUInt: case oftUInt16: case oftUInt64:
+                RecVal->AddToObj(FieldNm, (double)GetFieldUInt64(FieldId)); break;
+            case oftBool:
+                RecVal->AddToObj(FieldNm, GetFieldBool(FieldId)); break;
+            case oftFlt: case oftSFlt:
+                RecVal->AddToObj(FieldNm, GetFieldFlt(FieldId)); break;
+            case oftFltPr:
+                RecVal->AddToObj(FieldNm, TJsonVal::NewArr(GetFieldFltPr(FieldId))); break;
+            case oftTm:
+                RecVal->AddToObj(FieldNm, (double)TTm::GetUnixMSecsFromWinMSecs(GetFieldTmMSecs(FieldId))); break;
+            case oftStr:
+                RecVal->AddToObj(FieldNm, GetFieldStr(FieldId)); break;
+            case oftIntV:
+                RecVal->AddToObj(FieldNm, TJsonVal::NewArr(GetFieldIntV(FieldId))); break;
+            case oftStrV:
+                RecVal->AddToObj(FieldNm, TJsonVal::NewArr(GetFieldStrV(FieldId))); break;
+            case oftFltV:
+                RecVal->AddToObj(FieldNm, TJsonVal::NewArr(GetFieldFltV(FieldId))); break;
+            case oftNumSpV:
+                RecVal->AddToObj(FieldNm, TJsonVal::NewArr(GetFieldNumSpV(FieldId))); break;
+            case oftTMem:
+                RecVal->AddToObj(FieldNm, TStr::Base64Encode(GetFieldTMem(FieldId))); break;
+            case oftJson:
+                RecVal->AddToObj(FieldNm, GetFieldJsonVal(FieldId)); break;
+            default:
+                throw FieldError(FieldId, "Json");
+        }
+    }
+    return RecVal;
+}
+
 ///////////////////////////////
 /// Record Comparator by Frequency
 bool TRecCmpByFq::operator()(const TUInt64IntKd& RecIdFq1, const TUInt64IntKd& RecIdFq2) const {
@@ -2671,6 +2999,9 @@ PRecFilter TRecFilterByField::New(const TWPt<TBase>& Base, const PJsonVal& Param
         return new TRecFilterByFieldSFlt(Base, FieldId, MinVal, MaxVal, FilterNullP);
     } else if (FieldDesc.IsStr() && Type == rfValue) {
         const TStr Val = ParamVal->GetObjStr("value");
+        if (FieldDesc.IsCodebook()) {
+            return new TRecFilterByFieldStrUsingCodebook(Base, FieldId, Store, Val, FilterNullP);
+        }
         return new TRecFilterByFieldStr(Base, FieldId, Val, FilterNullP);
     } else if (FieldDesc.IsStr() && Type == rfRange) {
         const TStr MinVal = ParamVal->GetObjStr("minValue");
@@ -2878,6 +3209,22 @@ bool TRecFilterByFieldStr::Filter(const TRec& Rec) const {
     return StrVal == RecVal;
 }
 
+///////////////////////////////
+/// Record Filter by String Field using Codebook.
+TRecFilterByFieldStrUsingCodebook::TRecFilterByFieldStrUsingCodebook(const TWPt<TBase>& _Base, const int& _FieldId,
+    const TWPt<TStore>& _Store, const TStr& _StrVal, const bool& _FilterNullP): TRecFilterByField(_Base, _FieldId, _FilterNullP),
+        Store(_Store), StrVal(_StrVal), StrId(_Store->GetCodebookId(_FieldId, _StrVal)) { }
+
+bool TRecFilterByFieldStrUsingCodebook::Filter(const TRec& Rec) const {
+    bool RecNull = Rec.IsFieldNull(FieldId);
+    if (RecNull) { return !FilterNullP; }
+    // records not in the store have no codebook ids
+    if (!Rec.IsByRef()) { return StrVal == Rec.GetFieldStr(FieldId); }
+    // value can enter the codebook after the filter was created
+    if (StrId == -1) { StrId = Store->GetCodebookId(FieldId, StrVal); }
+    return (StrId != -1) && (Rec.GetFieldInt(FieldId) == StrId);
+}
+
 ///////////////////////////////
 /// Record Filter by String Field Range.
 TRecFilterByFieldStrRange::TRecFilterByFieldStrRange(const TWPt<TBase>& _Base, const int& _FieldId,
@@ -3800,6 +4147,8 @@ void TRecSet::FilterByFieldInt(const int& FieldId, const int& MinVal, const int&
     // get store and field type
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsInt() || (Desc.IsStr() && Desc.IsCodebook()), "Wrong field type, integer or codebook string expected");
+    // columnar stores compare values directly in the field column
+    if (Store->HasColumnScan()) { Store->FilterByFieldFlt(FieldId, MinVal, MaxVal, RecIdFqV); return; }
     // apply the filter
     FilterBy<TRecFilterByFieldInt>(TRecFilterByFieldInt(Store->GetBase(), FieldId, MinVal, MaxVal));
 }
@@ -3840,6 +4189,8 @@ void TRecSet::FilterByFieldUInt(const int& FieldId, const uint& MinVal, const ui
     // get store and field type
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsUInt(), "Wrong field type, unsigned integer expected");
+    // columnar stores compare values directly in the field column
+    if (Store->HasColumnScan()) { Store->FilterByFieldFlt(FieldId, MinVal, MaxVal, RecIdFqV); return; }
     // apply the filter
     FilterBy<TRecFilterByFieldUInt>(TRecFilterByFieldUInt(Store->GetBase(), FieldId, MinVal, MaxVal));
 }
@@ -3864,6 +4215,8 @@ void TRecSet::FilterByFieldFlt(const int& FieldId, const double& MinVal, const d
     // get store and field type
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsFlt(), "Wrong field type, numeric expected");
+    // columnar stores compare values directly in the field column
+    if (Store->HasColumnScan()) { Store->FilterByFieldFlt(FieldId, MinVal, MaxVal, RecIdFqV); return; }
     // apply the filter
     FilterBy<TRecFilterByFieldFlt>(TRecFilterByFieldFlt(Store->GetBase(), FieldId, MinVal, MaxVal));
 }
@@ -3897,7 +4250,11 @@ void TRecSet::FilterByFieldStr(const int& FieldId, const TStr& FldVal) {
     const TFieldDesc& Desc = Store->GetFieldDesc(FieldId);
     QmAssertR(Desc.IsStr(), "Wrong field type, string expected");
     // apply the filter
-    FilterBy<TRecFilterByFieldStr>(TRecFilterByFieldStr(Store->GetBase(), FieldId, FldVal));
+    if (Desc.IsCodebook()) {
+        FilterBy<TRecFilterByFieldStrUsingCodebook>(TRecFilterByFieldStrUsingCodebook(Store->GetBase(), FieldId, Store, FldVal));
+    } else {
+        FilterBy<TRecFilterByFieldStr>(TRecFilterByFieldStr(Store->GetBase(), FieldId, FldVal));
+    }
 }
 
 void TRecSet::FilterByFieldStr(const int& FieldId, const TStr& FldVal, const TStr& FldValMax) {
@@ -4208,24 +4565,112 @@ void TIndexKey::Save(TSOut& SOut) const {
 
 ///////////////////////////////
 // QMiner-Index-Word-Vocabulary
-uint64 TIndexWordVoc::AddWordStr(const TStr& WordStr) {
+const int TIndexWordVoc::MxWcScanWords = 100000;
+
+uint64 TIndexWordVoc::AddWordStr(const TStr& WordStr, const int& WordFq) {
+    const int Words = WordH.Len();
     // get id for the (new) word
     const int WordId = WordH.AddKey(WordStr);
     // increase the count for the word, used for autocomplete
-    WordH[WordId]++;
+    WordH[WordId] += WordFq;
+    // keep sorted words up to date, when already built
+    if (WordH.Len() > Words && (!StrWordTree.Empty() || !FltWordTree.Empty())) {
+        TLock Lock(WordTreeSection);
+        if (!StrWordTree.Empty()) { StrWordTree->BTree.Add(WordStr, WordId); }
+        double WordFlt;
+        if (!FltWordTree.Empty() && WordStr.IsFlt(WordFlt)) { FltWordTree->BTree.Add(TPair<TFlt, TInt>(WordFlt, WordId)); }
+    }
     // return the id
     return (uint64)WordId;
 }
 
-void TIndexWordVoc::GetWcWordIdV(const TStr& WcStr, TUInt64V& WcWordIdV) {
-    WcWordIdV.Clr();
+void TIndexWordVoc::InitStrWordTree() {
+    if (!StrWordTree.Empty()) { return; }
+    TStrWordTree::TBtreeOps::TKdV WordStrIdV(WordH.Len(), 0);
+    int WordId = WordH.FFirstKeyId();
+    while (WordH.FNextKeyId(WordId)) {
+        WordStrIdV.Add(TKeyDat<TStr, TInt>(WordH.GetKey(WordId), WordId));
+    }
+    WordStrIdV.Sort();
+    TPt<TStrWordTree> WordTree = new TStrWordTree;
+    WordTree->BTree.AddSorted(WordStrIdV);
+    StrWordTree = WordTree;
+}
+
+void TIndexWordVoc::InitFltWordTree() {
+    if (!FltWordTree.Empty()) { return; }
+    TFltWordTree::TBtreeOps::TKeyV WordFltIdV(WordH.Len(), 0);
     int WordId = WordH.FFirstKeyId();
     while (WordH.FNextKeyId(WordId)) {
-        TStr WordStr = WordH.GetKey(WordId);
-        if (WordStr.IsWcMatch(WcStr, '*', '?')) {
-            WcWordIdV.Add((uint64)WordId);
+        // words which are not numbers have no place in numeric order
+        double WordFlt;
+        if (TStr(WordH.GetKey(WordId)).IsFlt(WordFlt)) { WordFltIdV.Add(TPair<TFlt, TInt>(WordFlt, WordId)); }
+    }
+    WordFltIdV.Sort();
+    TPt<TFltWordTree> WordTree = new TFltWordTree;
+    WordTree->BTree.AddSorted(WordFltIdV);
+    FltWordTree = WordTree;
+}
+
+/// Collects ids of words starting with given prefix and matching wildchar query
+class TWcWordSink {
+private:
+    const TStr& PrefixStr;
+    const TStr& WcStr;
+    TUInt64V& WordIdV;
+public:
+    TWcWordSink(const TStr& _PrefixStr, const TStr& _WcStr, TUInt64V& _WordIdV):
+        PrefixStr(_PrefixStr), WcStr(_WcStr), WordIdV(_WordIdV) { }
+    bool operator()(const TStr& WordStr, const TInt& WordId) {
+        // words are sorted, so the first one without the prefix ends the scan
+        if (!WordStr.StartsWith(PrefixStr)) { return false; }
+        if (WordStr.IsWcMatch(WcStr, '*', '?')) { WordIdV.Add((uint64)WordId); }
+        return true;
+    }
+};
+
+/// Collects word ids from sorted words, until reaching the end word
+template <class TKey>
+class TWordIdSink {
+private:
+    const TKey* EndKey;
+    TUInt64V& WordIdV;
+    static uint64 GetWordId(const TKey& Key, const TInt& WordId) { return (uint64)WordId; }
+    static uint64 GetWordId(const TKey& Key, const TVoid& Dat) { return (uint64)Key.Val2; }
+public:
+    TWordIdSink(const TKey* _EndKey, TUInt64V& _WordIdV): EndKey(_EndKey), WordIdV(_WordIdV) { }
+    template <class TDat>
+    bool operator()(const TKey& Key, const TDat& Dat) {
+        if (EndKey != NULL && !(Key < *EndKey)) { return false; }
+        WordIdV.Add(GetWordId(Key, Dat)); return true;
+    }
+};
+
+void TIndexWordVoc::GetWcWordIdV(const TStr& WcStr, TUInt64V& WcWordIdV) {
+    WcWordIdV.Clr();
+    // part before the first wildchar is a prefix of all matching words
+    int PrefixLen = 0;
+    while (PrefixLen < WcStr.Len() && WcStr[PrefixLen] != '*' && WcStr[PrefixLen] != '?') { PrefixLen++; }
+    if (PrefixLen == 0) {
+        // no prefix, check all the words when there are not too many of them
+        QmAssertR(WordH.Len() <= MxWcScanWords, TStr::Fmt("Wildchar query '%s' must start with "
+            "a prefix, vocabulary %s has more than %d words", WcStr.CStr(), WordVocNm.CStr(), MxWcScanWords));
+        int WordId = WordH.FFirstKeyId();
+        while (WordH.FNextKeyId(WordId)) {
+            TStr WordStr = WordH.GetKey(WordId);
+            if (WordStr.IsWcMatch(WcStr, '*', '?')) {
+                WcWordIdV.Add((uint64)WordId);
+            }
         }
+        return;
     }
+    // scan sorted words from the prefix on
+    const TStr PrefixStr = WcStr.Left(PrefixLen);
+    TLock Lock(WordTreeSection);
+    InitStrWordTree();
+    TWcWordSink Sink(PrefixStr, WcStr, WcWordIdV);
+    StrWordTree->BTree.ScanFrom_(&PrefixStr, true, Sink);
+    WcWordIdV.Sort();
 }
 
 void TIndexWordVoc::GetAllGreaterById(const uint64& StartWordId, TUInt64V& AllGreaterV) {
@@ -4240,31 +4685,28 @@ void TIndexWordVoc::GetAllGreaterById(const uint64& StartWordId, TUInt64V& AllGr
 
 void TIndexWordVoc::GetAllGreaterByStr(const uint64& StartWordId, TUInt64V& AllGreaterV) {
     AllGreaterV.Clr();
-    TStr StartWordStr = WordH.GetKey((int)StartWordId);
-    int WordId = WordH.FFirstKeyId();
-    while (WordH.FNextKeyId(WordId)) {
-        TStr WordStr = WordH.GetKey(WordId);
-        if (WordStr > StartWordStr) {
-            AllGreaterV.Add((uint64)WordId);
-        }
-    }
+    const TStr StartWordStr = WordH.GetKey((int)StartWordId);
+    TLock Lock(WordTreeSection);
+    InitStrWordTree();
+    TWordIdSink<TStr> Sink(NULL, AllGreaterV);
+    StrWordTree->BTree.ScanFrom_(&StartWordStr, false, Sink);
+    AllGreaterV.Sort();
 }
 
 void TIndexWordVoc::GetAllGreaterByFlt(const uint64& StartWordId, TUInt64V& AllGreaterV) {
     AllGreaterV.Clr();
-    TStr StartWordStr = WordH.GetKey((int)StartWordId);
-    TFlt StartWordFlt = StartWordStr.GetFlt();
-    int WordId = WordH.FFirstKeyId();
-    while (WordH.FNextKeyId(WordId)) {
-        TStr WordStr = WordH.GetKey(WordId);
-        TFlt WordFlt = WordStr.GetFlt();
-        if (WordFlt > StartWordFlt) {
-            AllGreaterV.Add((uint64)WordId);
-        }
-    }
+    // word which is not a number is not compared to the others
+    double StartWordFlt;
+    if (!TStr(WordH.GetKey((int)StartWordId)).IsFlt(StartWordFlt)) { return; }
+    // larger than any pair with the same value
+    const TPair<TFlt, TInt> StartKey(StartWordFlt, TInt::Mx);
+    TLock Lock(WordTreeSection);
+    InitFltWordTree();
+    TWordIdSink<TPair<TFlt, TInt> > Sink(NULL, AllGreaterV);
+    FltWordTree->BTree.ScanFrom_(&StartKey, false, Sink);
+    AllGreaterV.Sort();
 }
 
-
 void TIndexWordVoc::GetAllLessById(const uint64& StartWordId, TUInt64V& AllLessV) {
     int WordId = WordH.FFirstKeyId();
     while (WordH.FNextKeyId(WordId)) {
@@ -4275,27 +4717,25 @@ void TIndexWordVoc::GetAllLessById(const uint64& StartWordId, TUInt64V& AllLessV
 }
 
 void TIndexWordVoc::GetAllLessByStr(const uint64& StartWordId, TUInt64V& AllLessV) {
-    TStr StartWordStr = WordH.GetKey((int)StartWordId);
-    int WordId = WordH.FFirstKeyId();
-    while (WordH.FNextKeyId(WordId)) {
-        TStr WordStr = WordH.GetKey(WordId);
-        if (WordStr < StartWordStr) {
-            AllLessV.Add((uint64)WordId);
-        }
-    }
+    const TStr StartWordStr = WordH.GetKey((int)StartWordId);
+    TLock Lock(WordTreeSection);
+    InitStrWordTree();
+    TWordIdSink<TStr> Sink(&StartWordStr, AllLessV);
+    StrWordTree->BTree.ScanFrom_(NULL, true, Sink);
+    AllLessV.Sort();
 }
 
 void TIndexWordVoc::GetAllLessByFlt(const uint64& StartWordId, TUInt64V& AllLessV) {
-    TStr StartWordStr = WordH.GetKey((int)StartWordId);
-    TFlt StartWordFlt = StartWordStr.GetFlt();
-    int WordId = WordH.FFirstKeyId();
-    while (WordH.FNextKeyId(WordId)) {
-        TStr WordStr = WordH.GetKey(WordId);
-        TFlt WordFlt = WordStr.GetFlt();
-        if (WordFlt < StartWordFlt) {
-            AllLessV.Add((uint64)WordId);
-        }
-    }
+    // word which is not a number is not compared to the others
+    double StartWordFlt;
+    if (!TStr(WordH.GetKey((int)StartWordId)).IsFlt(StartWordFlt)) { return; }
+    // smaller than any pair with the same value
+    const TPair<TFlt, TInt> EndKey(StartWordFlt, TInt::Mn);
+    TLock Lock(WordTreeSection);
+    InitFltWordTree();
+    TWordIdSink<TPair<TFlt, TInt> > Sink(&EndKey, AllLessV);
+    FltWordTree->BTree.ScanFrom_(NULL, true, Sink);
+    AllLessV.Sort();
 }
 
 ///////////////////////////////
@@ -4457,8 +4897,8 @@ void TIndexVoc::GetWordIdV(const int& KeyId, const TStr& TextStr, TUInt64V& Word
     }
 }
 
-uint64 TIndexVoc::AddWordStr(const int& KeyId, const TStr& WordStr) {
-    return GetWordVoc(KeyId)->AddWordStr(WordStr);
+uint64 TIndexVoc::AddWordStr(const int& KeyId, const TStr& WordStr, const int& WordFq) {
+    return GetWordVoc(KeyId)->AddWordStr(WordStr, WordFq);
 }
 
 void TIndexVoc::AddWordIdV(const int& KeyId, const TStr& TextStr, TUInt64V& WordIdV) {
@@ -4474,6 +4914,11 @@ void TIndexVoc::AddWordIdV(const int& KeyId, const TStr& TextStr, TUInt64V& Word
     WordVoc->IncRecs();
 }
 
+void TIndexVoc::IncRecs(const int& KeyId, const int& NewRecs) {
+    QmAssert(IsWordVoc(KeyId));
+    GetWordVoc(KeyId)->IncRecs(NewRecs);
+}
+
 void TIndexVoc::AddWordIdV(const int& KeyId, const TStrV& WordV, TUInt64V& WordIdV) {
     QmAssert(IsWordVoc(KeyId));
     // map words to their ids
@@ -5263,6 +5708,286 @@ void TQueryItem::Optimize() {
     }
 }
 
+const int TQueryItem::FilterRatio = 16;
+
+double TQueryItem::GetRangeFrac(const TWPt<TIndex>& Index) const {
+    if (IsRangeInt()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeIntMnMx);
+    } else if (IsRangeInt16()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeInt16MnMx);
+    } else if (IsRangeInt64()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeInt64MnMx);
+    } else if (IsRangeByte()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeUChMnMx);
+    } else if (IsRangeUInt()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeUIntMnMx);
+    } else if (IsRangeUInt16()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeUInt16MnMx);
+    } else if (IsRangeUInt64() || IsRangeTm()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeUInt64MnMx);
+    } else if (IsRangeFlt()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeFltMnMx);
+    } else if (IsRangeSFlt()) {
+        return Index->GetLinearRangeFrac(KeyId, RangeSFltMnMx);
+    }
+    throw TQmExcept::New("QueryItem: not a range query");
+}
+
+bool TQueryItem::IsNegatable() const {
+    if (IsGix()) {
+        return IsNotEqual();
+    } else if (IsNot()) {
+        return true;
+    } else if (IsAnd() || IsOr()) {
+        for (const TQueryItem& Child : ItemV) {
+            if (Child.IsNegatable()) { return true; }
+        }
+    }
+    // joins invert their input, other leafs are never negated
+    return false;
+}
+
+void TQueryItem::Plan(const TWPt<TBase>& Base) {
+    const TWPt<TIndex>& Index = Base->GetIndex();
+    FilterP = false;
+    if (IsGix() || IsTextPos()) {
+        // equality and text need all the words, other comparisons any of them
+        const bool AnyP = IsGreater() || IsLess() || IsWildChar();
+        EstRecs = AnyP ? 0.0 : (double)GetStore(Base)->GetRecs();
+        for (const uint64 WordId : WordIdV) {
+            const double WordRecs = (double)Index->GetGixItems(KeyId, WordId);
+            EstRecs = AnyP ? (EstRecs + WordRecs) : TFlt::GetMn(EstRecs, WordRecs);
+        }
+        if (WordIdV.Empty()) { EstRecs = 0.0; }
+    } else if (IsGeo()) {
+        EstRecs = (double)LocLimit;
+    } else if (IsRange()) {
+        EstRecs = GetRangeFrac(Index) * (double)GetStore(Base)->GetRecs();
+    } else if (IsRec()) {
+        EstRecs = 1.0;
+    } else if (IsRecSet()) {
+        EstRecs = (double)RecSet->GetRecs();
+    } else if (IsStore()) {
+        EstRecs = (double)Base->GetStoreByStoreId(StoreId)->GetRecs();
+    } else if (IsJoin()) {
+        ItemV[0].Plan(Base);
+        // assume each record joins to at most one record
+        EstRecs = TFlt::GetMn(ItemV[0].EstRecs, (double)GetStore(Base)->GetRecs());
+        if (SampleSize >= 0) { EstRecs = TFlt::GetMn(EstRecs, (double)SampleSize); }
+    } else if (IsNot()) {
+        ItemV[0].Plan(Base);
+        EstRecs = ItemV[0].EstRecs;
+    } else if (IsAnd() || IsOr()) {
+        for (TQueryItem& Child : ItemV) { Child.Plan(Base); }
+        // order children from the most selective on; in conjunctions negated
+        // children go last, since they are applied as differences
+        TFltIntKdV EstChildV(ItemV.Len(), 0);
+        for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) {
+            const TQueryItem& Child = ItemV[ItemN];
+            const bool LastP = IsAnd() && Child.IsNegatable();
+            EstChildV.Add(TFltIntKd(LastP ? TFlt::Mx : Child.EstRecs.Val, ItemN));
+        }
+        EstChildV.Sort();
+        TQueryItemV SortItemV(ItemV.Len(), 0);
+        for (const TFltIntKd& EstChild : EstChildV) { SortItemV.Add(ItemV[EstChild.Dat]); }
+        ItemV = SortItemV;
+        // estimate result size
+        const double StoreRecs = (double)GetStore(Base)->GetRecs();
+        if (IsAnd() && !ItemV[0].IsNegatable()) {
+            // first child is the most selective positive one
+            EstRecs = ItemV[0].EstRecs;
+            // broad range conditions are checked on the records selected by the rest
+            const double MxRecs = FilterRatio * TFlt::GetMx(EstRecs, 1.0);
+            for (int ItemN = 1; ItemN < ItemV.Len(); ItemN++) {
+                TQueryItem& Child = ItemV[ItemN];
+                if (Child.IsRange() && Child.EstRecs >= MxRecs &&
+                        Base->GetIndexVoc()->GetKey(Child.KeyId).GetFields() == 1) {
+                    Child.FilterP = true;
+                }
+            }
+        } else {
+            // disjunction or conjunction of negations, both behave as union
+            EstRecs = 0.0;
+            for (const TQueryItem& Child : ItemV) { EstRecs += Child.EstRecs; }
+            EstRecs = TFlt::GetMn(EstRecs, StoreRecs);
+        }
+    }
+}
+
+PJsonVal TQueryItem::GetPlanJson(const TWPt<TBase>& Base) const {
+    PJsonVal PlanVal = TJsonVal::NewObj();
+    if (IsGix()) {
+        PlanVal->AddToObj("type", "gix");
+    } else if (IsTextPos()) {
+        PlanVal->AddToObj("type", "textPos");
+    } else if (IsGeo()) {
+        PlanVal->AddToObj("type", "geo");
+    } else if (IsRange()) {
+        PlanVal->AddToObj("type", FilterP ? "filter" : "range");
+    } else if (IsAnd()) {
+        PlanVal->AddToObj("type", "and");
+    } else if (IsOr()) {
+        PlanVal->AddToObj("type", "or");
+    } else if (IsNot()) {
+        PlanVal->AddToObj("type", "not");
+    } else if (IsJoin()) {
+        PlanVal->AddToObj("type", "join");
+        const TWPt<TStore> Store = ItemV[0].GetStore(Base);
+        PlanVal->AddToObj("join", Store->GetJoinDesc(JoinId).GetJoinNm());
+    } else if (IsRecSet()) {
+        PlanVal->AddToObj("type", "recSet");
+    } else if (IsRec()) {
+        PlanVal->AddToObj("type", "rec");
+    } else if (IsStore()) {
+        PlanVal->AddToObj("type", "store");
+    }
+    if (IsGix() || IsTextPos() || IsGeo() || IsRange()) {
+        PlanVal->AddToObj("key", Base->GetIndexVoc()->GetKey(KeyId).GetKeyNm());
+    }
+    PlanVal->AddToObj("store", GetStore(Base)->GetStoreNm());
+    PlanVal->AddToObj("estRecs", TFlt::Round(EstRecs));
+    if (IsGix() && IsNotEqual()) { PlanVal->AddToObj("negated", true); }
+    if (!ItemV.Empty()) {
+        PJsonVal ItemsVal = TJsonVal::NewArr();
+        for (const TQueryItem& Child : ItemV) { ItemsVal->AddToArr(Child.GetPlanJson(Base)); }
+        PlanVal->AddToObj("items", ItemsVal);
+    }
+    return PlanVal;
+}
+
+bool TQueryItem::IsIndexLookup() const {
+    if (IsGix() || IsTextPos() || IsGeo()) {
+        return true;
+    } else if (IsRange()) {
+        // filters read field values
+        return !FilterP;
+    } else if (IsAnd() || IsOr() || IsNot()) {
+        for (const TQueryItem& Child : ItemV) {
+            if (!Child.IsIndexLookup()) { return false; }
+        }
+        return true;
+    }
+    // joins and stores read records
+    return false;
+}
+
+bool TQueryItem::IsInRange(const TWPt<TBase>& Base, const TWPt<TStore>& Store, const uint64& RecId) const {
+    const int FieldId = Base->GetIndexVoc()->GetKey(KeyId).GetFieldId(0);
+    // records with missing values are not indexed
+    if (Store->IsFieldNull(RecId, FieldId)) { return false; }
+    if (IsRangeInt()) {
+        const int Val = Store->GetFieldInt(RecId, FieldId);
+        return RangeIntMnMx.Val1 <= Val && Val <= RangeIntMnMx.Val2;
+    } else if (IsRangeInt16()) {
+        const int16 Val = Store->GetFieldInt16(RecId, FieldId);
+        return RangeInt16MnMx.Val1 <= Val && Val <= RangeInt16MnMx.Val2;
+    } else if (IsRangeInt64()) {
+        const int64 Val = Store->GetFieldInt64(RecId, FieldId);
+        return RangeInt64MnMx.Val1 <= Val && Val <= RangeInt64MnMx.Val2;
+    } else if (IsRangeByte()) {
+        const uchar Val = Store->GetFieldByte(RecId, FieldId);
+        return RangeUChMnMx.Val1 <= Val && Val <= RangeUChMnMx.Val2;
+    } else if (IsRangeUInt()) {
+        const uint Val = Store->GetFieldUInt(RecId, FieldId);
+        return RangeUIntMnMx.Val1 <= Val && Val <= RangeUIntMnMx.Val2;
+    } else if (IsRangeUInt16()) {
+        const uint16 Val = Store->GetFieldUInt16(RecId, FieldId);
+        return RangeUInt16MnMx.Val1 <= Val && Val <= RangeUInt16MnMx.Val2;
+    } else if (IsRangeUInt64()) {
+        const uint64 Val = Store->GetFieldUInt64(RecId, FieldId);
+        return RangeUInt64MnMx.Val1 <= Val && Val <= RangeUInt64MnMx.Val2;
+    } else if (IsRangeTm()) {
+        const uint64 Val = Store->GetFieldTmMSecs(RecId, FieldId);
+        return RangeUInt64MnMx.Val1 <= Val && Val <= RangeUInt64MnMx.Val2;
+    } else if (IsRangeFlt()) {
+        const double Val = Store->GetFieldFlt(RecId, FieldId);
+        return RangeFltMnMx.Val1 <= Val && Val <= RangeFltMnMx.Val2;
+    } else if (IsRangeSFlt()) {
+        const float Val = Store->GetFieldSFlt(RecId, FieldId);
+        return RangeSFltMnMx.Val1 <= Val && Val <= RangeSFltMnMx.Val2;
+    }
+    throw TQmExcept::New("QueryItem: not a range query");
+}
+
+bool TQueryItem::GetCacheKey(const TWPt<TBase>& Base, TChA& KeyChA,
+        TIntSet& KeyIdSet, TUIntSet& StoreIdSet) const {
+
+    if (IsGix() || IsTextPos()) {
+        KeyChA += TStr::Fmt("%s(%d,%d,%d", IsGix() ? "gix" : "pos", KeyId.Val, (int)CmpType, MaxPosDiff.Val);
+        for (const uint64 WordId : WordIdV) { KeyChA += ','; KeyChA += TUInt64::GetStr(WordId); }
+        KeyChA += ')';
+        KeyIdSet.AddKey(KeyId);
+        // not-equal is answered by inverting the matches against the whole store
+        if (IsGix() && IsNotEqual()) { StoreIdSet.AddKey(GetStoreId(Base)); }
+    } else if (IsGeo()) {
+        KeyChA += TStr::Fmt("geo(%d,%.17g,%.17g,%.17g,%d)", KeyId.Val,
+            Loc.Val1.Val, Loc.Val2.Val, LocRadius.Val, LocLimit.Val);
+        KeyIdSet.AddKey(KeyId);
+    } else if (IsRange()) {
+        KeyChA += TStr::Fmt("range(%d,%d,", KeyId.Val, (int)Type);
+        if (IsRangeInt()) {
+            KeyChA += TStr::Fmt("%d,%d", RangeIntMnMx.Val1.Val, RangeIntMnMx.Val2.Val);
+        } else if (IsRangeInt16()) {
+            KeyChA += TStr::Fmt("%d,%d", (int)RangeInt16MnMx.Val1.Val, (int)RangeInt16MnMx.Val2.Val);
+        } else if (IsRangeInt64()) {
+            KeyChA += TInt64::GetStr(RangeInt64MnMx.Val1) + "," + TInt64::GetStr(RangeInt64MnMx.Val2);
+        } else if (IsRangeByte()) {
+            KeyChA += TStr::Fmt("%d,%d", (int)RangeUChMnMx.Val1.Val, (int)RangeUChMnMx.Val2.Val);
+        } else if (IsRangeUInt()) {
+            KeyChA += TStr::Fmt("%u,%u", RangeUIntMnMx.Val1.Val, RangeUIntMnMx.Val2.Val);
+        } else if (IsRangeUInt16()) {
+            KeyChA += TStr::Fmt("%d,%d", (int)RangeUInt16MnMx.Val1.Val, (int)RangeUInt16MnMx.Val2.Val);
+        } else if (IsRangeUInt64() || IsRangeTm()) {
+            KeyChA += TUInt64::GetStr(RangeUInt64MnMx.Val1) + "," + TUInt64::GetStr(RangeUInt64MnMx.Val2);
+        } else if (IsRangeFlt()) {
+            KeyChA += TStr::Fmt("%.17g,%.17g", RangeFltMnMx.Val1.Val, RangeFltMnMx.Val2.Val);
+        } else if (IsRangeSFlt()) {
+            KeyChA += TStr::Fmt("%.9g,%.9g", (double)RangeSFltMnMx.Val1.Val, (double)RangeSFltMnMx.Val2.Val);
+        }
+        KeyChA += ')';
+        KeyIdSet.AddKey(KeyId);
+    } else if (IsAnd() || IsOr()) {
+        // operands are commutative, order them by their description
+        TStrV ChildKeyV(ItemV.Len(), 0);
+        for (const TQueryItem& Child : ItemV) {
+            TChA ChildKeyChA;
+            if (!Child.GetCacheKey(Base, ChildKeyChA, KeyIdSet, StoreIdSet)) { return false; }
+            ChildKeyV.Add(ChildKeyChA);
+        }
+        ChildKeyV.Sort();
+        KeyChA += IsAnd() ? "and(" : "or(";
+        for (int ChildN = 0; ChildN < ChildKeyV.Len(); ChildN++) {
+            if (ChildN > 0) { KeyChA += ','; }
+            KeyChA += ChildKeyV[ChildN];
+        }
+        KeyChA += ')';
+    } else if (IsNot()) {
+        KeyChA += "not(";
+        if (!ItemV[0].GetCacheKey(Base, KeyChA, KeyIdSet, StoreIdSet)) { return false; }
+        KeyChA += ')';
+        StoreIdSet.AddKey(GetStoreId(Base));
+    } else if (IsJoin()) {
+        // sampled joins are random, each search should draw a new sample
+        if (SampleSize >= 0) { return false; }
+        KeyChA += TStr::Fmt("join(%d,", JoinId.Val);
+        if (!ItemV[0].GetCacheKey(Base, KeyChA, KeyIdSet, StoreIdSet)) { return false; }
+        KeyChA += ')';
+        // field joins read records of the joined store, index joins go through the index
+        const TWPt<TStore> Store = ItemV[0].GetStore(Base);
+        const TJoinDesc& JoinDesc = Store->GetJoinDesc(JoinId);
+        if (JoinDesc.IsIndexJoin()) { KeyIdSet.AddKey(JoinDesc.GetJoinKeyId()); }
+        StoreIdSet.AddKey(Store->GetStoreId());
+        StoreIdSet.AddKey(GetStoreId(Base));
+    } else if (IsStore()) {
+        KeyChA += TStr::Fmt("store(%u)", StoreId.Val);
+        StoreIdSet.AddKey(StoreId);
+    } else {
+        // given records and record sets are not described by the query
+        return false;
+    }
+    return true;
+}
+
 ///////////////////////////////
 // QMiner-Query-Aggregate
 TQueryAggr::TQueryAggr(const TWPt<TBase>& Base,
@@ -5514,6 +6239,22 @@ void TIndex::TQmGixItemPos::SetRecId(const uint64& _RecId) {
     RecId = (uint)_RecId;
 }
 
+void TIndex::TQmGixItemPos::SavePosCompact(TSOut& SOut) const {
+    // first position and length together with flags marking which other positions are set
+    TGixVarInt::SaveUInt64(SOut, (PosV.Pos1 << 4) | (PosV.Len << 2) |
+        ((PosV.Pos2 != 0) ? 2 : 0) | ((PosV.Pos3 != 0) ? 1 : 0));
+    if (PosV.Pos2 != 0) { TGixVarInt::SaveUInt64(SOut, PosV.Pos2); }
+    if (PosV.Pos3 != 0) { TGixVarInt::SaveUInt64(SOut, PosV.Pos3); }
+}
+
+void TIndex::TQmGixItemPos::LoadPosCompact(TSIn& SIn) {
+    const uint Head = (uint)TGixVarInt::LoadUInt64(SIn);
+    PosV.Pos1 = Head >> 4;
+    PosV.Len = (Head >> 2) & 3;
+    PosV.Pos2 = ((Head & 2) != 0) ? (uint)TGixVarInt::LoadUInt64(SIn) : 0;
+    PosV.Pos3 = ((Head & 1) != 0) ? (uint)TGixVarInt::LoadUInt64(SIn) : 0;
+}
+
 int TIndex::TQmGixItemPos::GetPos(const int& PosN) const {
     Assert(PosN < GetPosLen());
     switch (PosN) {
@@ -5590,6 +6331,8 @@ TIndex::TQmGixItemPos TIndex::TQmGixItemPos::Intersect(const TQmGixItemPos& Item
 }
 
 bool TIndex::DoQueryFull(const TPt<TQmGixExpItemFull>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GixFullSection);
     // clean if there is anything on the input
     RecIdFqV.Clr();
     // execute query
@@ -5601,6 +6344,8 @@ bool TIndex::DoQueryFull(const TPt<TQmGixExpItemFull>& ExpItem, TVec<TQmGixItemF
 }
 
 bool TIndex::DoQuerySmall(const TPt<TQmGixExpItemSmall>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GixSmallSection);
     // execute query
     TVec<TQmGixItemSmall> SmallRecIdFqV;
     const bool Not = ExpItem->Eval(GixSmall, SmallRecIdFqV, SumMergerSmall);
@@ -5616,6 +6361,8 @@ bool TIndex::DoQuerySmall(const TPt<TQmGixExpItemSmall>& ExpItem, TVec<TQmGixIte
 }
 
 bool TIndex::DoQueryTiny(const TPt<TQmGixExpItemTiny>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GixTinySection);
     // clean if there is anything on the input
     RecIdFqV.Clr();
     const bool Not = ExpItem->Eval(GixTiny, RecIdFqV, MergerTiny);
@@ -5626,6 +6373,8 @@ bool TIndex::DoQueryTiny(const TPt<TQmGixExpItemTiny>& ExpItem, TVec<TQmGixItemF
 }
 
 void TIndex::DoJoinQueryFull(const int& KeyId, const TUInt64V& RecIdV, TUInt64IntKdV& RecIdFqV) const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GixFullSection);
     // temporary story for joined records
     THash<TUInt64, TInt> RecIdFqH;
     // lambda that goes over child vectors and updates the hash table with counts
@@ -5643,6 +6392,8 @@ void TIndex::DoJoinQueryFull(const int& KeyId, const TUInt64V& RecIdV, TUInt64In
 }
 
 void TIndex::DoJoinQuerySmall(const int& KeyId, const TUInt64V& RecIdV, TUInt64IntKdV& RecIdFqV) const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GixSmallSection);
     // temporary story for joined records
     THash<TUInt64, TInt> RecIdFqH;
     // lambda that goes over child vectors and updates the hash table with counts
@@ -5660,6 +6411,8 @@ void TIndex::DoJoinQuerySmall(const int& KeyId, const TUInt64V& RecIdV, TUInt64I
 }
 
 void TIndex::DoJoinQueryTiny(const int& KeyId, const TUInt64V& RecIdV, TUInt64IntKdV& RecIdFqV) const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GixTinySection);
     // temporary story for joined records
     THash<TUInt64, TInt> RecIdFqH;
     // lambda that goes over child vectors and updates the hash table with counts
@@ -5685,6 +6438,8 @@ void TIndex::DoQueryPos(const int& KeyId, const TUInt64V& WordIdV,
     RecIdFqV.Clr();
     // if no words, no results!
     if (WordIdV.Empty()) { return; }
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GixPosSection);
     // get records for the first word from the index and
     // store it into the running result candidate vector
     TVec<TQmGixItemPos> CurrentItemV;
@@ -5752,30 +6507,32 @@ void TIndex::DoQueryPos(const int& KeyId, const TUInt64V& WordIdV,
     }
 }
 
+const int TIndex::GixExistsChunkLen = 1024;
 
 TIndex::TIndex(const TStr& _IndexFPath, const TFAccess& _Access, const PIndexVoc& _IndexVoc,
     const int64& CacheSizeFull, const int64& CacheSizeSmall, const uint64& CacheSizeTiny,
-    const int64& CacheSizePos, const int& SplitLen) {
+    const int64& CacheSizePos, const int64& CacheSizeLinear, const int& SplitLen) {
 
     IndexFPath = _IndexFPath;
     Access = _Access;
+    GixKeyLog = NULL;
     // initialize full invered index
-    SumItemHandlerFull = new TQmGixSumItemHandler<TQmGixItemFull>;
+    SumItemHandlerFull = new TQmGixCompressItemHandler<TQmGixItemFull, TQmGixSumItemHandler<TQmGixItemFull> >;
     GixFull = TGix<TQmGixKey, TQmGixItemFull>::New("Index.GixFull",
         IndexFPath, Access, SumItemHandlerFull, CacheSizeFull, SplitLen);
     SumMergerFull = new TQmGixSumWithFqMerger<TQmGixItemFull>;
     // initialize small inverted index
-    SumItemHandlerSmall = new TQmGixSumItemHandler<TQmGixItemSmall>;
+    SumItemHandlerSmall = new TQmGixCompressItemHandler<TQmGixItemSmall, TQmGixSumItemHandler<TQmGixItemSmall> >;
     GixSmall = TGix<TQmGixKey, TQmGixItemSmall>::New("Index.GixSmall",
         IndexFPath, Access, SumItemHandlerSmall, CacheSizeSmall, SplitLen);
     SumMergerSmall = new TQmGixSumWithFqMerger<TQmGixItemSmall>;
     // initialize tiny inverted index
-    ItemHandlerTiny = new TGixDefItemHandler<TQmGixKey, TQmGixItemTiny>;
+    ItemHandlerTiny = new TQmGixCompressItemHandler<TQmGixItemTiny, TGixDefItemHandler<TQmGixKey, TQmGixItemTiny> >;
     GixTiny = TGix<TQmGixKey, TQmGixItemTiny>::New("Index.GixTiny",
         IndexFPath, Access, ItemHandlerTiny, CacheSizeTiny, SplitLen);
     MergerTiny = new TQmGixSumWithoutFqMerger<TQmGixItemTiny, TQmGixItemFull>;
     // initialize position inverted index
-    ItemHandlerPos = new TGixDefItemHandler<TQmGixKey, TQmGixItemPos>;
+    ItemHandlerPos = new TQmGixCompressItemHandler<TQmGixItemPos, TQmGixItemHandlerPos>;
     GixPos = TGix<TQmGixKey, TQmGixItemPos>::New("Index.GixPos",
         IndexFPath, Access, ItemHandlerPos, CacheSizePos, SplitLen);
     MergerPos = new TGixDefMerger<TQmGixKey, TQmGixItemPos, TQmGixItemPos>;
@@ -5785,19 +6542,47 @@ TIndex::TIndex(const TStr& _IndexFPath, const TFAccess& _Access, const PIndexVoc
         TFIn SphereFIn(SphereFNm);
         GeoIndexH.Load(SphereFIn);
     }
-    // initialize btree index
-    TStr BTreeFNm = IndexFPath + "Index.BTree";
-    if (TFile::Exists(BTreeFNm) && Access != faCreate) {
+    // initialize btree index, nodes of all trees are kept in one paged file
+    const TStr BTreeFNm = IndexFPath + "Index.BTreePaged";
+    const TStr BTreeBlobFNm = IndexFPath + "Index.BTreePages";
+    const TStr MemBTreeFNm = IndexFPath + "Index.BTree";
+    const bool BTreeP = Access != faCreate && TFile::Exists(BTreeFNm);
+    const bool MemBTreeP = Access != faCreate && !BTreeP && TFile::Exists(MemBTreeFNm);
+    if (Access == faRdOnly) {
+        // conversion writes the paged file next to the old one, which read-only mode can not do
+        QmAssertR(!MemBTreeP, "Linear index " + MemBTreeFNm + " is saved in the format used before "
+            "paged B-tree nodes and can not be opened read-only. Open the base once in update "
+            "mode to convert it.");
+        if (BTreeP) { BTreeBlob = TPgBlob::OpenRdOnly(BTreeBlobFNm); }
+    } else if (BTreeP) {
+        BTreeBlob = TPgBlob::Open(BTreeBlobFNm, CacheSizeLinear);
+    } else {
+        BTreeBlob = TPgBlob::Create(BTreeBlobFNm, CacheSizeLinear);
+    }
+    if (BTreeP) {
         TFIn BTreeFIn(BTreeFNm);
-        BTreeIndexByteH.Load(BTreeFIn);
-        BTreeIndexIntH.Load(BTreeFIn);
-        BTreeIndexInt16H.Load(BTreeFIn);
-        BTreeIndexInt64H.Load(BTreeFIn);
-        BTreeIndexUIntH.Load(BTreeFIn);
-        BTreeIndexUInt16H.Load(BTreeFIn);
-        BTreeIndexUInt64H.Load(BTreeFIn);
-        BTreeIndexFltH.Load(BTreeFIn);
-        BTreeIndexSFltH.Load(BTreeFIn);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexByteH);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexIntH);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexInt16H);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexInt64H);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexUIntH);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexUInt16H);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexUInt64H);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexFltH);
+        LoadBTreeIndexH(BTreeFIn, BTreeIndexSFltH);
+    } else if (MemBTreeP) {
+        // index saved with in-memory nodes, copy it to the paged file
+        TEnv::Logger->OnStatus("Converting btree index to paged file");
+        TFIn MemBTreeFIn(MemBTreeFNm);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexByteH);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexIntH);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexInt16H);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexInt64H);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexUIntH);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexUInt16H);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexUInt64H);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexFltH);
+        LoadMemBTreeIndexH(MemBTreeFIn, BTreeIndexSFltH);
     }
     // initialize vocabularies
     IndexVoc = _IndexVoc;
@@ -5805,10 +6590,10 @@ TIndex::TIndex(const TStr& _IndexFPath, const TFAccess& _Access, const PIndexVoc
 
 PIndex TIndex::New(const TStr& IndexFPath, const TFAccess& Access, const PIndexVoc& IndexVoc,
     const int64& CacheSizeFull, const int64& CacheSizeSmall, const uint64& CacheSizeTiny,
-    const int64& CacheSizePos, const int& SplitLen) {
+    const int64& CacheSizePos, const int64& CacheSizeLinear, const int& SplitLen) {
 
     return new TIndex(IndexFPath, Access, IndexVoc, CacheSizeFull,
-         CacheSizeSmall, CacheSizeTiny, CacheSizePos, SplitLen);
+         CacheSizeSmall, CacheSizeTiny, CacheSizePos, CacheSizeLinear, SplitLen);
 }
 
 TIndex::~TIndex() {
@@ -5838,16 +6623,11 @@ TIndex::~TIndex() {
         }
         {
             TEnv::Logger->OnStatus("Saving and closing btree index");
-            TFOut BTreeFOut(IndexFPath + "Index.BTree");
-            BTreeIndexByteH.Save(BTreeFOut);
-            BTreeIndexIntH.Save(BTreeFOut);
-            BTreeIndexInt16H.Save(BTreeFOut);
-            BTreeIndexInt64H.Save(BTreeFOut);
-            BTreeIndexUIntH.Save(BTreeFOut);
-            BTreeIndexUInt16H.Save(BTreeFOut);
-            BTreeIndexUInt64H.Save(BTreeFOut);
-            BTreeIndexFltH.Save(BTreeFOut);
-            BTreeIndexSFltH.Save(BTreeFOut);
+            if (LinearBatchN > 0) { FlushLinearBatch(); }
+            SaveBTree();
+            // index in old format was converted when opened
+            const TStr MemBTreeFNm = IndexFPath + "Index.BTree";
+            if (TFile::Exists(MemBTreeFNm)) { TFile::Del(MemBTreeFNm); }
         }
         TEnv::Logger->OnStatus("Index closed");
     } else {
@@ -5911,6 +6691,15 @@ void TIndex::IndexGix(const int& KeyId, const uint64& WordId, const uint64& RecI
     Assert(KeyId != -1);
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // cached query results using the key are no longer valid
+    TouchKey(KeyId);
+    if (GixKeyLog != NULL) { GixKeyLog->AddKey(TKeyWord(KeyId, WordId)); }
+    // when in batch, just remember the item
+    if (BatchN > 0) {
+        BatchItemH.AddDat(TKeyWord(KeyId, WordId)).Add(TQmGixItemFull(RecId, RecFq));
+        return;
+    }
+    TFlushScope FlushScope(Flusher);
     // check which Gix to use
     const TIndexKeyGixType GixType = GetGixType(KeyId);
     // send to appropriate index
@@ -5926,31 +6715,173 @@ void TIndex::IndexGix(const int& KeyId, const uint64& WordId, const uint64& RecI
     }
 }
 
-void TIndex::DeleteValue(const int& KeyId, const TStr& WordStr, const uint64& RecId) {
-    const uint64 WordId = IndexVoc->AddWordStr(KeyId, WordStr);
-    DeleteGix(KeyId, WordId, RecId, 1);
+void TIndex::EndBatch() {
+    QmAssertR(BatchN > 0, "[TIndex::EndBatch] No batch started");
+    BatchN--;
+    if (BatchN == 0) { FlushBatch(); }
 }
 
-void TIndex::DeleteValue(const int& KeyId, const TStrV& WordStrV, const uint64& RecId) {
-    // load word-counts
-    TUInt64H WordIdH;
-    for (int WordN = 0; WordN < WordStrV.Len(); WordN++) {
-        const TStr WordStr = WordStrV[WordN]; //.GetLc();
-        WordIdH.AddDat(IndexVoc->AddWordStr(KeyId, WordStr))++;
-    }
-    // delete words from index
-    int WordKeyId = WordIdH.FFirstKeyId();
-    while (WordIdH.FNextKeyId(WordKeyId)) {
-        const uint64 WordId = WordIdH.GetKey(WordKeyId);
-        const int WordFq = WordIdH[WordKeyId];
-        DeleteGix(KeyId, WordId, RecId, WordFq);
+void TIndex::FlushBatch() {
+    TFlushScope FlushScope(Flusher);
+    // buffered deletions refer to items added before the batch
+    if (!BatchDelItemH.Empty()) { FlushBatchDel(); }
+    int KeyId = BatchItemH.FFirstKeyId();
+    while (BatchItemH.FNextKeyId(KeyId)) {
+        const TKeyWord& KeyWord = BatchItemH.GetKey(KeyId);
+        const TVec<TQmGixItemFull>& ItemV = BatchItemH[KeyId];
+        TouchKey(KeyWord.Val1);
+        // send whole posting list update to appropriate index
+        switch (GetGixType(KeyWord.Val1)) {
+        case oikgtFull:
+            GixFull->AddItemV(KeyWord, ItemV); break;
+        case oikgtSmall: {
+            TVec<TQmGixItemSmall> SmallItemV(ItemV.Len(), 0);
+            for (const TQmGixItemFull& Item : ItemV) {
+                SmallItemV.Add(TQmGixItemSmall((uint)Item.Key, (int16)Item.Dat));
+            }
+            GixSmall->AddItemV(KeyWord, SmallItemV); break;
+        }
+        case oikgtTiny: {
+            TVec<TQmGixItemTiny> TinyItemV(ItemV.Len(), 0);
+            for (const TQmGixItemFull& Item : ItemV) {
+                TinyItemV.Add(TQmGixItemTiny((uint)Item.Key));
+            }
+            GixTiny->AddItemV(KeyWord, TinyItemV); break;
+        }
+        default:
+            throw TQmExcept::New("[TIndex::FlushBatch] Unsupported gix type!");
+        }
     }
+    BatchItemH.Clr();
 }
 
-void TIndex::DeleteText(const int& KeyId, const TStr& TextStr, const uint64& RecId) {
-    // tokenize string
-    TUInt64V WordIdV; IndexVoc->AddWordIdV(KeyId, TextStr, WordIdV);
-    // aggregate by word
+void TIndex::FlushBatchDel() {
+    TFlushScope FlushScope(Flusher);
+    int KeyId = BatchDelItemH.FFirstKeyId();
+    while (BatchDelItemH.FNextKeyId(KeyId)) {
+        const TKeyWord& KeyWord = BatchDelItemH.GetKey(KeyId);
+        const TVec<TQmGixItemFull>& ItemV = BatchDelItemH[KeyId];
+        TouchKey(KeyWord.Val1);
+        const TIndexKeyGixType GixType = GetGixType(KeyWord.Val1);
+        // full deletes are removed from the posting list, partial ones are
+        // added with negative frequency and merged later
+        switch (GixType) {
+        case oikgtFull: {
+            TVec<TQmGixItemFull> DelItemV, NegItemV;
+            for (const TQmGixItemFull& Item : ItemV) {
+                if (Item.Dat == TInt::Mx) {
+                    DelItemV.Add(TQmGixItemFull(Item.Key, 0));
+                } else {
+                    NegItemV.Add(TQmGixItemFull(Item.Key, -Item.Dat));
+                }
+            }
+            GixFull->DelItemV(KeyWord, DelItemV);
+            GixFull->AddItemV(KeyWord, NegItemV);
+            break;
+        }
+        case oikgtSmall: {
+            TVec<TQmGixItemSmall> DelItemV, NegItemV;
+            for (const TQmGixItemFull& Item : ItemV) {
+                if (Item.Dat == TInt::Mx) {
+                    DelItemV.Add(TQmGixItemSmall((uint)Item.Key, 0));
+                } else {
+                    NegItemV.Add(TQmGixItemSmall((uint)Item.Key, (int16)-Item.Dat));
+                }
+            }
+            GixSmall->DelItemV(KeyWord, DelItemV);
+            GixSmall->AddItemV(KeyWord, NegItemV);
+            break;
+        }
+        case oikgtTiny: {
+            // tiny index has no frequencies, all deletes are full
+            TVec<TQmGixItemTiny> DelItemV(ItemV.Len(), 0);
+            for (const TQmGixItemFull& Item : ItemV) {
+                DelItemV.Add(TQmGixItemTiny((uint)Item.Key));
+            }
+            GixTiny->DelItemV(KeyWord, DelItemV);
+            break;
+        }
+        default:
+            throw TQmExcept::New("[TIndex::FlushBatchDel] Unsupported gix type!");
+        }
+    }
+    BatchDelItemH.Clr();
+}
+
+void TIndex::AddBatch(const TIndexBatch& Batch) {
+    // we shouldn't modify read-only index
+    QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    StartBatch();
+    try {
+        // each word is added to the vocabulary once, with the count of all its occurrences
+        int WordItemKeyId = Batch.WordItemH.FFirstKeyId();
+        while (Batch.WordItemH.FNextKeyId(WordItemKeyId)) {
+            const int KeyId = Batch.WordItemH.GetKey(WordItemKeyId).Val1;
+            const TStr& WordStr = Batch.WordItemH.GetKey(WordItemKeyId).Val2;
+            const TVec<TQmGixItemFull>& ItemV = Batch.WordItemH[WordItemKeyId];
+            int WordFq = 0;
+            for (const TQmGixItemFull& Item : ItemV) { WordFq += Item.Dat; }
+            const uint64 WordId = IndexVoc->AddWordStr(KeyId, WordStr, WordFq);
+            TouchKey(KeyId);
+            if (GixKeyLog != NULL) { GixKeyLog->AddKey(TKeyWord(KeyId, WordId)); }
+            BatchItemH.AddDat(TKeyWord(KeyId, WordId)).AddV(ItemV);
+        }
+        int TextRecsKeyId = Batch.TextRecsH.FFirstKeyId();
+        while (Batch.TextRecsH.FNextKeyId(TextRecsKeyId)) {
+            IndexVoc->IncRecs(Batch.TextRecsH.GetKey(TextRecsKeyId), Batch.TextRecsH[TextRecsKeyId]);
+        }
+        for (const TTriple<TInt, TStr, TUInt64>& TextPos : Batch.TextPosV) {
+            IndexTextPos(TextPos.Val1, TextPos.Val2, TextPos.Val3);
+        }
+    } catch (const PExcept& Except) {
+        EndBatch();
+        throw;
+    }
+    EndBatch();
+    for (const TTriple<TInt, TFltPr, TUInt64>& Geo : Batch.GeoV) {
+        IndexGeo(Geo.Val1, Geo.Val2, Geo.Val3);
+    }
+    // linear values go through the linear batch, which builds new indexes bottom-up
+    TLock BTreeLock(BTreeSection);
+    // deletions buffered before must be applied first
+    if (LinearBatchN > 0 && LinearBatchDelP) { FlushLinearBatch(); }
+    AddBTreeBatchH(Batch.LinearByteH, LinearBatchByteH);
+    AddBTreeBatchH(Batch.LinearIntH, LinearBatchIntH);
+    AddBTreeBatchH(Batch.LinearInt16H, LinearBatchInt16H);
+    AddBTreeBatchH(Batch.LinearInt64H, LinearBatchInt64H);
+    AddBTreeBatchH(Batch.LinearUIntH, LinearBatchUIntH);
+    AddBTreeBatchH(Batch.LinearUInt16H, LinearBatchUInt16H);
+    AddBTreeBatchH(Batch.LinearUInt64H, LinearBatchUInt64H);
+    AddBTreeBatchH(Batch.LinearFltH, LinearBatchFltH);
+    AddBTreeBatchH(Batch.LinearSFltH, LinearBatchSFltH);
+    if (LinearBatchN == 0) { FlushLinearBatch(); }
+}
+
+void TIndex::DeleteValue(const int& KeyId, const TStr& WordStr, const uint64& RecId) {
+    const uint64 WordId = IndexVoc->AddWordStr(KeyId, WordStr);
+    DeleteGix(KeyId, WordId, RecId, 1);
+}
+
+void TIndex::DeleteValue(const int& KeyId, const TStrV& WordStrV, const uint64& RecId) {
+    // load word-counts
+    TUInt64H WordIdH;
+    for (int WordN = 0; WordN < WordStrV.Len(); WordN++) {
+        const TStr WordStr = WordStrV[WordN]; //.GetLc();
+        WordIdH.AddDat(IndexVoc->AddWordStr(KeyId, WordStr))++;
+    }
+    // delete words from index
+    int WordKeyId = WordIdH.FFirstKeyId();
+    while (WordIdH.FNextKeyId(WordKeyId)) {
+        const uint64 WordId = WordIdH.GetKey(WordKeyId);
+        const int WordFq = WordIdH[WordKeyId];
+        DeleteGix(KeyId, WordId, RecId, WordFq);
+    }
+}
+
+void TIndex::DeleteText(const int& KeyId, const TStr& TextStr, const uint64& RecId) {
+    // tokenize string
+    TUInt64V WordIdV; IndexVoc->AddWordIdV(KeyId, TextStr, WordIdV);
+    // aggregate by word
     TUInt64H WordIdFqH;
     for (int WordIdN = 0; WordIdN < WordIdV.Len(); WordIdN++) {
         WordIdFqH.AddDat(WordIdV[WordIdN])++;
@@ -5973,6 +6904,15 @@ void TIndex::DeleteGix(const int& KeyId, const uint64& WordId, const uint64& Rec
     Assert(KeyId != -1);
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    // deletes must see all items added so far
+    if (!BatchItemH.Empty()) { FlushBatch(); }
+    // when in batch, just remember the item
+    if (BatchN > 0) {
+        BatchDelItemH.AddDat(TKeyWord(KeyId, WordId)).Add(TQmGixItemFull(RecId, RecFq));
+        return;
+    }
+    TFlushScope FlushScope(Flusher);
     // check which Gix to use
     const TIndexKeyGixType GixType = GetGixType(KeyId);
     // are we deleting all items or just few occurences?
@@ -6055,14 +6995,63 @@ void TIndex::IndexTextPos(const int& KeyId, const TStr& TextStr, const uint64& R
 void TIndex::IndexTextPos(const int& KeyId, const TUInt64V& WordIdV, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
     // compute the gix items to be added to gix
     TVec<TPair<TUInt64, TQmGixItemPos>> WordIdPosPrV;
     ComputeWordItemPos(KeyId, WordIdV, RecId, WordIdPosPrV);
     for (int N = 0; N < WordIdPosPrV.Len(); N++) {
+        if (GixKeyLog != NULL) { GixKeyLog->AddKey(TKeyWord(KeyId, WordIdPosPrV[N].Val1)); }
         GixPos->AddItem(TKeyWord(KeyId, WordIdPosPrV[N].Val1), WordIdPosPrV[N].Val2);
     }
 }
 
+template <class TQmGixItem>
+void TIndex::DeleteGixBefore(const TPt<TGix<TQmGixKey, TQmGixItem> >& Gix,
+        const TVec<TQmGixKey>& GixKeyV, const TQmGixItem& Item) {
+
+    for (const TQmGixKey& GixKey : GixKeyV) {
+        // keys can be gone already, when all their items were deleted
+        if (Gix->IsKey(GixKey)) { Gix->DelItemsBefore(GixKey, Item); }
+    }
+}
+
+void TIndex::DeleteGixBefore(const THashSet<TQmGixKey>& GixKeySet, const uint64& RecId) {
+    // we shouldn't modify read-only index
+    QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    // deletes must see all items added so far
+    if (!BatchItemH.Empty() || !BatchDelItemH.Empty()) { FlushBatch(); }
+    TFlushScope FlushScope(Flusher);
+    // split posting lists by the index they are in
+    TVec<TQmGixKey> FullKeyV, SmallKeyV, TinyKeyV, PosKeyV;
+    int GixKeySetKeyId = GixKeySet.FFirstKeyId();
+    while (GixKeySet.FNextKeyId(GixKeySetKeyId)) {
+        const TQmGixKey& GixKey = GixKeySet.GetKey(GixKeySetKeyId);
+        const int KeyId = GixKey.Val1;
+        TouchKey(KeyId);
+        if (IndexVoc->GetKey(KeyId).IsTextPos()) {
+            PosKeyV.Add(GixKey);
+        } else {
+            switch (GetGixType(KeyId)) {
+            case oikgtFull: FullKeyV.Add(GixKey); break;
+            case oikgtSmall: SmallKeyV.Add(GixKey); break;
+            case oikgtTiny: TinyKeyV.Add(GixKey); break;
+            default: throw TQmExcept::New("[TIndex::DeleteGixBefore] Unsupported gix type!");
+            }
+        }
+    }
+    // items are sorted by record id first, so the smallest possible item with RecId is the boundary
+    if (!FullKeyV.Empty()) { DeleteGixBefore(GixFull, FullKeyV, TQmGixItemFull(RecId, TInt::Mn)); }
+    if (!SmallKeyV.Empty()) { DeleteGixBefore(GixSmall, SmallKeyV, TQmGixItemSmall((uint)RecId, TSInt::Mn)); }
+    if (!TinyKeyV.Empty()) { DeleteGixBefore(GixTiny, TinyKeyV, TQmGixItemTiny((uint)RecId)); }
+    if (!PosKeyV.Empty()) { DeleteGixBefore(GixPos, PosKeyV, TQmGixItemPos(RecId)); }
+}
+
+THashSet<TIndex::TQmGixKey>* TIndex::SetGixKeyLog(THashSet<TQmGixKey>* _GixKeyLog) {
+    THashSet<TQmGixKey>* PrevGixKeyLog = GixKeyLog;
+    GixKeyLog = _GixKeyLog;
+    return PrevGixKeyLog;
+}
+
 void TIndex::DeleteTextPos(const int& KeyId, const TStr& TextStr, const uint64& RecId) {
     // tokenize string
     TUInt64V WordIdV; IndexVoc->AddWordIdV(KeyId, TextStr, WordIdV);
@@ -6073,6 +7062,7 @@ void TIndex::DeleteTextPos(const int& KeyId, const TStr& TextStr, const uint64&
 void TIndex::DeleteTextPos(const int& KeyId, const TUInt64V& WordIdV, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
     // compute the gix items to be removed from gix
     TVec<TPair<TUInt64, TQmGixItemPos>> WordIdPosPrV;
     ComputeWordItemPos(KeyId, WordIdV, RecId, WordIdPosPrV);
@@ -6084,6 +7074,7 @@ void TIndex::DeleteTextPos(const int& KeyId, const TUInt64V& WordIdV, const uint
 void TIndex::IndexGeo(const int& KeyId, const TFltPr& Loc, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
     // if new key, create sphere first
     if (!GeoIndexH.IsKey(KeyId)) { GeoIndexH.AddDat(KeyId, TGeoIndex::New()); }
     // index new location
@@ -6093,6 +7084,7 @@ void TIndex::IndexGeo(const int& KeyId, const TFltPr& Loc, const uint64& RecId)
 void TIndex::DeleteGeo(const int& KeyId, const TFltPr& Loc, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
     // delete only if index exist
     if (GeoIndexH.IsKey(KeyId)) { GeoIndexH.GetDat(KeyId)->DelKey(Loc, RecId); }
 }
@@ -6101,11 +7093,53 @@ bool TIndex::LocEquals(const int& KeyId, const TFltPr& Loc1, const TFltPr& Loc2)
     return GeoIndexH.IsKey(KeyId) ? GeoIndexH.GetDat(KeyId)->LocEquals(Loc1, Loc2) : false;
 }
 
+void TIndex::StartLinearBatch() {
+    TLock BTreeLock(BTreeSection);
+    LinearBatchN++;
+}
+
+void TIndex::EndLinearBatch() {
+    TLock BTreeLock(BTreeSection);
+    QmAssertR(LinearBatchN > 0, "[TIndex::EndLinearBatch] No linear batch started");
+    LinearBatchN--;
+    if (LinearBatchN == 0) { FlushLinearBatch(); }
+}
+
+void TIndex::FlushLinearBatch() {
+    FlushBTreeDelBatchH(LinearDelBatchByteH, BTreeIndexByteH);
+    FlushBTreeDelBatchH(LinearDelBatchIntH, BTreeIndexIntH);
+    FlushBTreeDelBatchH(LinearDelBatchInt16H, BTreeIndexInt16H);
+    FlushBTreeDelBatchH(LinearDelBatchInt64H, BTreeIndexInt64H);
+    FlushBTreeDelBatchH(LinearDelBatchUIntH, BTreeIndexUIntH);
+    FlushBTreeDelBatchH(LinearDelBatchUInt16H, BTreeIndexUInt16H);
+    FlushBTreeDelBatchH(LinearDelBatchUInt64H, BTreeIndexUInt64H);
+    FlushBTreeDelBatchH(LinearDelBatchFltH, BTreeIndexFltH);
+    FlushBTreeDelBatchH(LinearDelBatchSFltH, BTreeIndexSFltH);
+    FlushBTreeBatchH(LinearBatchByteH, BTreeIndexByteH);
+    FlushBTreeBatchH(LinearBatchIntH, BTreeIndexIntH);
+    FlushBTreeBatchH(LinearBatchInt16H, BTreeIndexInt16H);
+    FlushBTreeBatchH(LinearBatchInt64H, BTreeIndexInt64H);
+    FlushBTreeBatchH(LinearBatchUIntH, BTreeIndexUIntH);
+    FlushBTreeBatchH(LinearBatchUInt16H, BTreeIndexUInt16H);
+    FlushBTreeBatchH(LinearBatchUInt64H, BTreeIndexUInt64H);
+    FlushBTreeBatchH(LinearBatchFltH, BTreeIndexFltH);
+    FlushBTreeBatchH(LinearBatchSFltH, BTreeIndexSFltH);
+    LinearBatchDelP = false;
+}
+
 void TIndex::IndexLinear(const int& KeyId, const uchar& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchByteH.AddDat(KeyId).Add(TPair<TUCh, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexByteH.IsKey(KeyId)) { BTreeIndexByteH.AddDat(KeyId, PBTreeIndexUCh::New()); }
+    if (!BTreeIndexByteH.IsKey(KeyId)) { BTreeIndexByteH.AddDat(KeyId, TBTreeIndex<TUCh>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexByteH.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6113,8 +7147,16 @@ void TIndex::IndexLinear(const int& KeyId, const uchar& Val, const uint64& RecId
 void TIndex::IndexLinear(const int& KeyId, const int& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchIntH.AddDat(KeyId).Add(TPair<TInt, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexIntH.IsKey(KeyId)) { BTreeIndexIntH.AddDat(KeyId, PBTreeIndexInt::New()); }
+    if (!BTreeIndexIntH.IsKey(KeyId)) { BTreeIndexIntH.AddDat(KeyId, TBTreeIndex<TInt>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexIntH.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6122,8 +7164,16 @@ void TIndex::IndexLinear(const int& KeyId, const int& Val, const uint64& RecId)
 void TIndex::IndexLinear(const int& KeyId, const int16& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchInt16H.AddDat(KeyId).Add(TPair<TInt16, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexInt16H.IsKey(KeyId)) { BTreeIndexInt16H.AddDat(KeyId, PBTreeIndexInt16::New()); }
+    if (!BTreeIndexInt16H.IsKey(KeyId)) { BTreeIndexInt16H.AddDat(KeyId, TBTreeIndex<TInt16>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexInt16H.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6131,8 +7181,16 @@ void TIndex::IndexLinear(const int& KeyId, const int16& Val, const uint64& RecId
 void TIndex::IndexLinear(const int& KeyId, const int64& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchInt64H.AddDat(KeyId).Add(TPair<TInt64, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexInt64H.IsKey(KeyId)) { BTreeIndexInt64H.AddDat(KeyId, PBTreeIndexInt64::New()); }
+    if (!BTreeIndexInt64H.IsKey(KeyId)) { BTreeIndexInt64H.AddDat(KeyId, TBTreeIndex<TInt64>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexInt64H.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6140,8 +7198,16 @@ void TIndex::IndexLinear(const int& KeyId, const int64& Val, const uint64& RecId
 void TIndex::IndexLinear(const int& KeyId, const uint& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchUIntH.AddDat(KeyId).Add(TPair<TUInt, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexUIntH.IsKey(KeyId)) { BTreeIndexUIntH.AddDat(KeyId, PBTreeIndexUInt::New()); }
+    if (!BTreeIndexUIntH.IsKey(KeyId)) { BTreeIndexUIntH.AddDat(KeyId, TBTreeIndex<TUInt>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexUIntH.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6149,8 +7215,16 @@ void TIndex::IndexLinear(const int& KeyId, const uint& Val, const uint64& RecId)
 void TIndex::IndexLinear(const int& KeyId, const uint16& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchUInt16H.AddDat(KeyId).Add(TPair<TUInt16, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexUInt16H.IsKey(KeyId)) { BTreeIndexUInt16H.AddDat(KeyId, PBTreeIndexUInt16::New()); }
+    if (!BTreeIndexUInt16H.IsKey(KeyId)) { BTreeIndexUInt16H.AddDat(KeyId, TBTreeIndex<TUInt16>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexUInt16H.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6158,8 +7232,16 @@ void TIndex::IndexLinear(const int& KeyId, const uint16& Val, const uint64& RecI
 void TIndex::IndexLinear(const int& KeyId, const uint64& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchUInt64H.AddDat(KeyId).Add(TPair<TUInt64, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexUInt64H.IsKey(KeyId)) { BTreeIndexUInt64H.AddDat(KeyId, PBTreeIndexUInt64::New()); }
+    if (!BTreeIndexUInt64H.IsKey(KeyId)) { BTreeIndexUInt64H.AddDat(KeyId, TBTreeIndex<TUInt64>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexUInt64H.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6168,8 +7250,16 @@ void TIndex::IndexLinear(const int& KeyId, const uint64& Val, const uint64& RecI
 void TIndex::IndexLinear(const int& KeyId, const double& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchFltH.AddDat(KeyId).Add(TPair<TFlt, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexFltH.IsKey(KeyId)) { BTreeIndexFltH.AddDat(KeyId, PBTreeIndexFlt::New()); }
+    if (!BTreeIndexFltH.IsKey(KeyId)) { BTreeIndexFltH.AddDat(KeyId, TBTreeIndex<TFlt>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexFltH.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6177,8 +7267,16 @@ void TIndex::IndexLinear(const int& KeyId, const double& Val, const uint64& RecI
 void TIndex::IndexLinear(const int& KeyId, const float& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    // when in batch, just remember the value
+    if (LinearBatchN > 0) {
+        // deletions buffered before must be applied first
+        if (LinearBatchDelP) { FlushLinearBatch(); }
+        LinearBatchSFltH.AddDat(KeyId).Add(TPair<TSFlt, TUInt64>(Val, RecId)); return;
+    }
     // if new key, create sphere first
-    if (!BTreeIndexSFltH.IsKey(KeyId)) { BTreeIndexSFltH.AddDat(KeyId, PBTreeIndexSFlt::New()); }
+    if (!BTreeIndexSFltH.IsKey(KeyId)) { BTreeIndexSFltH.AddDat(KeyId, TBTreeIndex<TSFlt>::New(BTreeBlob, BTreeBlobSection)); }
     // index new location
     BTreeIndexSFltH.GetDat(KeyId)->AddKey(Val, RecId);
 }
@@ -6186,6 +7284,13 @@ void TIndex::IndexLinear(const int& KeyId, const float& Val, const uint64& RecId
 void TIndex::DeleteLinear(const int& KeyId, const uchar& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchByteH.AddDat(KeyId).Add(TPair<TUCh, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexByteH.IsKey(KeyId)) { BTreeIndexByteH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6193,6 +7298,13 @@ void TIndex::DeleteLinear(const int& KeyId, const uchar& Val, const uint64& RecI
 void TIndex::DeleteLinear(const int& KeyId, const int& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchIntH.AddDat(KeyId).Add(TPair<TInt, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexIntH.IsKey(KeyId)) { BTreeIndexIntH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6200,6 +7312,13 @@ void TIndex::DeleteLinear(const int& KeyId, const int& Val, const uint64& RecId)
 void TIndex::DeleteLinear(const int& KeyId, const int16& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchInt16H.AddDat(KeyId).Add(TPair<TInt16, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexInt16H.IsKey(KeyId)) { BTreeIndexInt16H.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6207,6 +7326,13 @@ void TIndex::DeleteLinear(const int& KeyId, const int16& Val, const uint64& RecI
 void TIndex::DeleteLinear(const int& KeyId, const int64& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchInt64H.AddDat(KeyId).Add(TPair<TInt64, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexInt64H.IsKey(KeyId)) { BTreeIndexInt64H.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6214,6 +7340,13 @@ void TIndex::DeleteLinear(const int& KeyId, const int64& Val, const uint64& RecI
 void TIndex::DeleteLinear(const int& KeyId, const uint& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchUIntH.AddDat(KeyId).Add(TPair<TUInt, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexUIntH.IsKey(KeyId)) { BTreeIndexUIntH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6221,6 +7354,13 @@ void TIndex::DeleteLinear(const int& KeyId, const uint& Val, const uint64& RecId
 void TIndex::DeleteLinear(const int& KeyId, const uint16& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchUInt16H.AddDat(KeyId).Add(TPair<TUInt16, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexUInt16H.IsKey(KeyId)) { BTreeIndexUInt16H.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6228,6 +7368,13 @@ void TIndex::DeleteLinear(const int& KeyId, const uint16& Val, const uint64& Rec
 void TIndex::DeleteLinear(const int& KeyId, const uint64& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchUInt64H.AddDat(KeyId).Add(TPair<TUInt64, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexUInt64H.IsKey(KeyId)) { BTreeIndexUInt64H.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6235,6 +7382,13 @@ void TIndex::DeleteLinear(const int& KeyId, const uint64& Val, const uint64& Rec
 void TIndex::DeleteLinear(const int& KeyId, const double& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchFltH.AddDat(KeyId).Add(TPair<TFlt, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexFltH.IsKey(KeyId)) { BTreeIndexFltH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6242,6 +7396,13 @@ void TIndex::DeleteLinear(const int& KeyId, const double& Val, const uint64& Rec
 void TIndex::DeleteLinear(const int& KeyId, const float& Val, const uint64& RecId) {
     // we shouldn't modify read-only index
     QmAssertR(!IsReadOnly(), "Cannot edit read-only index!");
+    TouchKey(KeyId);
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) {
+        // additions buffered before must be applied first
+        if (!LinearBatchDelP) { FlushLinearBatch(); LinearBatchDelP = true; }
+        LinearDelBatchSFltH.AddDat(KeyId).Add(TPair<TSFlt, TUInt64>(Val, RecId)); return;
+    }
     // delete only if index exist
     if (BTreeIndexSFltH.IsKey(KeyId)) { BTreeIndexSFltH.GetDat(KeyId)->DelKey(Val, RecId); }
 }
@@ -6275,10 +7436,24 @@ PRecSet TIndex::SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TU
     for (const uint64 WordId : WordIdV) {
         KeyWordV.Add(TKeyWord(KeyId, WordId));
     }
+    // empty list matches nothing, but we still need the store of the key
+    if (KeyWordV.Empty()) {
+        const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
+        return TRecSet::New(Base->GetStoreByStoreId(StoreId), TUInt64IntKdV());
+    }
+    return SearchGixAnd(Base, KeyWordV);
+}
+
+PRecSet TIndex::SearchGixAnd(const TWPt<TBase>& Base, const TKeyWordV& KeyWordV) const {
+    QmAssert(!KeyWordV.Empty());
+    const int KeyId = KeyWordV[0].Val1;
     // prepare placeholder for results
     TVec<TQmGixItemFull> RecIdFqV;
     // check which Gix to use
     const TIndexKeyGixType GixType = GetGixType(KeyId);
+    for (const TKeyWord& KeyWord : KeyWordV) {
+        QmAssert(GetGixType(KeyWord.Val1) == GixType);
+    }
     // go to appropriate gix and always first check if we have the key at all
     switch (GixType) {
     case oikgtFull:
@@ -6295,6 +7470,22 @@ PRecSet TIndex::SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TU
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdFqV);
 }
 
+void TIndex::GetSearchLockIdSet(const TQueryItem& QueryItem, TIntSet& LockIdSet) const {
+    if (QueryItem.IsAnd() || QueryItem.IsOr() || QueryItem.IsNot()) {
+        for (int ItemN = 0; ItemN < QueryItem.GetItems(); ItemN++) {
+            GetSearchLockIdSet(QueryItem.GetItem(ItemN), LockIdSet);
+        }
+    } else if (QueryItem.IsTextPos()) {
+        // position index, ids of other inverted indexes are their gix types
+        LockIdSet.AddKey(0);
+    } else if (QueryItem.IsGix()) {
+        LockIdSet.AddKey((int)GetGixType(QueryItem.GetKeyId()));
+    } else if (QueryItem.IsRange()) {
+        // each B-tree has its own lock
+        LockIdSet.AddKey((int)oikgtTiny + 1 + QueryItem.GetKeyId());
+    }
+}
+
 PRecSet TIndex::SearchGixOr(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV) const {
     // prepare Gix keys
     TKeyWordV KeyWordV(WordIdV.Len(), 0);
@@ -6386,106 +7577,224 @@ PRecSet TIndex::SearchGeoNn(const TWPt<TBase>& Base, const int& KeyId,
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TIntPr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TIntPr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
 
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexIntH.IsKey(KeyId)) {
-        BTreeIndexIntH.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TInt> > BTreeIndex = GetBTreeIndex(BTreeIndexIntH, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TInt16Pr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TInt16Pr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
 
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexInt16H.IsKey(KeyId)) {
-        BTreeIndexInt16H.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TInt16> > BTreeIndex = GetBTreeIndex(BTreeIndexInt16H, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TInt64Pr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TInt64Pr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
 
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexInt64H.IsKey(KeyId)) {
-        BTreeIndexInt64H.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TInt64> > BTreeIndex = GetBTreeIndex(BTreeIndexInt64H, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUChPr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUChPr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexByteH.IsKey(KeyId)) {
-        BTreeIndexByteH.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TUCh> > BTreeIndex = GetBTreeIndex(BTreeIndexByteH, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUIntUIntPr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUIntUIntPr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
 
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexUIntH.IsKey(KeyId)) {
-        BTreeIndexUIntH.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TUInt> > BTreeIndex = GetBTreeIndex(BTreeIndexUIntH, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUInt16Pr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUInt16Pr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
 
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexUInt16H.IsKey(KeyId)) {
-        BTreeIndexUInt16H.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TUInt16> > BTreeIndex = GetBTreeIndex(BTreeIndexUInt16H, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUInt64Pr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUInt64Pr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
 
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexUInt64H.IsKey(KeyId)) {
-        BTreeIndexUInt64H.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TUInt64> > BTreeIndex = GetBTreeIndex(BTreeIndexUInt64H, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TFltPr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TFltPr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
 
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexFltH.IsKey(KeyId)) {
-        BTreeIndexFltH.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TFlt> > BTreeIndex = GetBTreeIndex(BTreeIndexFltH, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
-PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TSFltPr& RangeMinMax) {
+PRecSet TIndex::SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TSFltPr& RangeMinMax,
+        const bool& ValSortP, const bool& SortAscP, const int& Limit) {
 
     TUInt64V RecIdV;
     const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
-    if (BTreeIndexSFltH.IsKey(KeyId)) {
-        BTreeIndexSFltH.GetDat(KeyId)->SearchRange(RangeMinMax, RecIdV);
-        RecIdV.Sort();
+    TWPt<TBTreeIndex<TSFlt> > BTreeIndex = GetBTreeIndex(BTreeIndexSFltH, KeyId);
+    if (!BTreeIndex.Empty()) {
+        if (ValSortP) {
+            BTreeIndex->SearchRange(RangeMinMax, SortAscP, Limit, RecIdV);
+        } else {
+            BTreeIndex->SearchRange(RangeMinMax, RecIdV);
+            RecIdV.Sort();
+        }
     }
     return TRecSet::New(Base->GetStoreByStoreId(StoreId), RecIdV);
 }
 
+TCriticalSection& TIndex::GetGixSection(const int& KeyId) const {
+    // text position keys have their own index
+    if (IndexVoc->GetKey(KeyId).IsTextPos()) { return GixPosSection; }
+    switch (GetGixType(KeyId)) {
+    case oikgtFull: return GixFullSection;
+    case oikgtSmall: return GixSmallSection;
+    case oikgtTiny: return GixTinySection;
+    default:
+        throw TQmExcept::New("[TIndex::GetGixSection] Unsupported gix type!");
+    }
+}
+
+int TIndex::GetGixItems(const int& KeyId, const uint64& WordId) const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GetGixSection(KeyId));
+    TKeyWord KeyWord(KeyId, WordId);
+    // text position keys have their own index
+    if (IndexVoc->GetKey(KeyId).IsTextPos()) {
+        return GixPos->GetItemSet(KeyWord)->GetItems();
+    }
+    // check which Gix to use
+    const TIndexKeyGixType GixType = GetGixType(KeyId);
+    // missing keys give empty item sets
+    switch (GixType) {
+    case oikgtFull:
+        return GixFull->GetItemSet(KeyWord)->GetItems();
+    case oikgtSmall:
+        return GixSmall->GetItemSet(KeyWord)->GetItems();
+    case oikgtTiny:
+        return GixTiny->GetItemSet(KeyWord)->GetItems();
+    default:
+        throw TQmExcept::New("[TIndex::GetGixItems] Unsupported gix type!");
+    }
+}
+
+uint64 TIndex::GetGixAndRecs(const TKeyWordV& KeyWordV, const bool& ExistsP) const {
+    if (KeyWordV.Empty()) { return 0; }
+    const int KeyId = KeyWordV[0].Val1;
+    // check which Gix to use
+    const TIndexKeyGixType GixType = GetGixType(KeyId);
+    for (const TKeyWord& KeyWord : KeyWordV) {
+        QmAssert(GetGixType(KeyWord.Val1) == GixType);
+    }
+    TFlushScope FlushScope(Flusher);
+    switch (GixType) {
+    case oikgtFull: {
+        TLock GixLock(GixFullSection);
+        return GetGixAndRecs(GixFull, KeyWordV, ExistsP);
+    }
+    case oikgtSmall: {
+        TLock GixLock(GixSmallSection);
+        return GetGixAndRecs(GixSmall, KeyWordV, ExistsP);
+    }
+    case oikgtTiny: {
+        TLock GixLock(GixTinySection);
+        return GetGixAndRecs(GixTiny, KeyWordV, ExistsP);
+    }
+    default:
+        throw TQmExcept::New("[TIndex::GetGixAndRecs] Unsupported gix type!");
+    }
+}
+
 bool TIndex::HasJoin(const int& JoinKeyId, const uint64& RecId) const
 {
+    TFlushScope FlushScope(Flusher);
+    TLock GixLock(GetGixSection(JoinKeyId));
     TKeyWord KeyWord(JoinKeyId, RecId);
     // check which Gix to use
     const TIndexKeyGixType GixType = GetGixType(JoinKeyId);
@@ -6509,6 +7818,8 @@ void TIndex::SaveTxt(const TWPt<TBase>& Base, const TStr& FNm) {
 }
 
 TBlobBsStats TIndex::GetBlobStats() const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixFullLock(GixFullSection), GixSmallLock(GixSmallSection), GixTinyLock(GixTinySection);
     TBlobBsStats Stats = GixFull->GetBlobStats();
     Stats.Add(GixSmall->GetBlobStats());
     Stats.Add(GixTiny->GetBlobStats());
@@ -6516,6 +7827,8 @@ TBlobBsStats TIndex::GetBlobStats() const {
 }
 
 TGixStats TIndex::GetGixStats(const bool& RefreshP) const {
+    TFlushScope FlushScope(Flusher);
+    TLock GixFullLock(GixFullSection), GixSmallLock(GixSmallSection), GixTinyLock(GixTinySection);
     TGixStats Stats = GixFull->GetGixStats(RefreshP);
     Stats.Add(GixSmall->GetGixStats(RefreshP));
     Stats.Add(GixTiny->GetGixStats(RefreshP));
@@ -6530,21 +7843,157 @@ int TIndex::GetSplitLen() const {
     return GixFull->GetSplitLen();
 }
 
+void TIndex::SetGixCompress(const bool& CompressP) {
+    GixFull->SetCompress(CompressP);
+    GixSmall->SetCompress(CompressP);
+    GixTiny->SetCompress(CompressP);
+    GixPos->SetCompress(CompressP);
+}
+
+void TIndex::TouchKey(const int& KeyId) {
+    TLock ModVerLock(ModVerSection);
+    while (KeyModVerV.Len() <= KeyId) { KeyModVerV.Add(0); }
+    ModVer++; KeyModVerV[KeyId] = ModVer;
+}
+
+void TIndex::TouchStore(const uint& StoreId) {
+    TLock ModVerLock(ModVerSection);
+    ModVer++; StoreModVerH.AddDat(StoreId) = ModVer;
+}
+
+uint64 TIndex::GetKeyModVer(const int& KeyId) const {
+    TLock ModVerLock(ModVerSection);
+    return KeyId < KeyModVerV.Len() ? KeyModVerV[KeyId].Val : 0;
+}
+
+uint64 TIndex::GetStoreModVer(const uint& StoreId) const {
+    TLock ModVerLock(ModVerSection);
+    return StoreModVerH.IsKey(StoreId) ? StoreModVerH.GetDat(StoreId).Val : 0;
+}
+
 void TIndex::ResetStats() {
     GixFull->ResetStats();
     GixSmall->ResetStats();
     GixTiny->ResetStats();
 }
 
+uint64 TIndex::GetDirtyBytes() {
+    uint64 DirtyBytes = GixFull->GetDirtyBytes() + GixSmall->GetDirtyBytes() + GixTiny->GetDirtyBytes();
+    if (!BTreeBlob.Empty()) {
+        TLock BTreeBlobLock(BTreeBlobSection);
+        DirtyBytes += BTreeBlob->GetDirtyBytes();
+    }
+    return DirtyBytes;
+}
+
+void TIndex::SaveBTree() {
+    // write all dirty pages before node locations pointing to them
+    { TLock BTreeBlobLock(BTreeBlobSection); BTreeBlob->PartialFlush(TInt::Mx); }
+    TFOut BTreeFOut(IndexFPath + "Index.BTreePaged");
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexByteH);
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexIntH);
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexInt16H);
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexInt64H);
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexUIntH);
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexUInt16H);
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexUInt64H);
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexFltH);
+    SaveBTreeIndexH(BTreeFOut, BTreeIndexSFltH);
+}
+
+void TIndex::Flush() {
+    QmAssertR(!IsReadOnly(), "Index opened in read-only mode");
+    // buffered changes are part of the index
+    if (!BatchItemH.Empty() || !BatchDelItemH.Empty()) { FlushBatch(); }
+    GixFull->SaveAll();
+    GixSmall->SaveAll();
+    GixTiny->SaveAll();
+    GixPos->SaveAll();
+    {
+        TFOut SphereFOut(IndexFPath + "Index.Geo");
+        GeoIndexH.Save(SphereFOut);
+    }
+    {
+        TLock BTreeLock(BTreeSection);
+        if (LinearBatchN > 0) { FlushLinearBatch(); }
+        SaveBTree();
+        TLock BTreeBlobLock(BTreeBlobSection);
+        BTreeBlob->Flush();
+    }
+}
+
 int TIndex::PartialFlush(const int& WndInMsec) {
     const int WndInMsecPerGix = WndInMsec / 3;
     int Res = 0;
     Res += GixFull->PartialFlush(WndInMsecPerGix);
     Res += GixSmall->PartialFlush(WndInMsecPerGix);
     Res += GixTiny->PartialFlush(WndInMsecPerGix);
+    if (!BTreeBlob.Empty()) {
+        TLock BTreeBlobLock(BTreeBlobSection);
+        Res += BTreeBlob->PartialFlush(WndInMsecPerGix);
+    }
     return Res;
 }
 
+void TIndex::EnableCheckpoints(const uint64& CheckpointLsn) {
+    if (IsReadOnly()) { return; }
+    GixFull->EnableCheckpoints();
+    GixSmall->EnableCheckpoints();
+    GixTiny->EnableCheckpoints();
+    GixPos->EnableCheckpoints();
+    if (!BTreeBlob.Empty()) {
+        TLock BTreeBlobLock(BTreeBlobSection);
+        BTreeBlob->EnableCheckpoints(CheckpointLsn);
+    }
+}
+
+void TIndex::EndCheckpoint(const uint64& CheckpointLsn) {
+    if (IsReadOnly()) { return; }
+    GixFull->EndCheckpoint();
+    GixSmall->EndCheckpoint();
+    GixTiny->EndCheckpoint();
+    GixPos->EndCheckpoint();
+    if (!BTreeBlob.Empty()) {
+        TLock BTreeBlobLock(BTreeBlobSection);
+        BTreeBlob->EndCheckpoint(CheckpointLsn);
+    }
+}
+
+///////////////////////////////
+// QMiner-Gix-Key-Scope
+TGixKeyScope::TGixKeyScope(const TWPt<TIndex>& _Index, const bool& ActiveP): PrevKeySet(NULL) {
+    if (ActiveP) { Index = _Index; PrevKeySet = Index->SetGixKeyLog(&KeySet); }
+}
+
+TGixKeyScope::~TGixKeyScope() {
+    if (!Index.Empty()) { Index->SetGixKeyLog(PrevKeySet); }
+}
+
+///////////////////////////////
+// QMiner-Index-Batch
+void TIndexBatch::IndexValue(const int& KeyId, const TStr& WordStr, const uint64& RecId) {
+    WordItemH.AddDat(TPair<TInt, TStr>(KeyId, WordStr)).Add(TQmGixItemFull(RecId, 1));
+}
+
+void TIndexBatch::IndexValue(const int& KeyId, const TStrV& WordStrV, const uint64& RecId) {
+    // repeated words have weight based on their count
+    TStrIntH WordFqH;
+    for (const TStr& WordStr : WordStrV) { WordFqH.AddDat(WordStr)++; }
+    int WordKeyId = WordFqH.FFirstKeyId();
+    while (WordFqH.FNextKeyId(WordKeyId)) {
+        WordItemH.AddDat(TPair<TInt, TStr>(KeyId, WordFqH.GetKey(WordKeyId))).Add(
+            TQmGixItemFull(RecId, WordFqH[WordKeyId]));
+    }
+}
+
+void TIndexBatch::IndexText(const int& KeyId, const TStr& TextStr, const uint64& RecId) {
+    QmAssert(IndexVoc->IsWordVoc(KeyId));
+    // tokenizers do not change, so they can be used without the vocabulary
+    TStrV TokV; IndexVoc->GetTokenizer(KeyId)->GetTokens(TextStr, TokV);
+    IndexValue(KeyId, TokV, RecId);
+    TextRecsH.AddDat(KeyId)++;
+}
+
 ///////////////////////////////
 // QMiner-Aggregator
 TFunRouter<TAggr::TNewF> TAggr::NewRouter;
@@ -6794,8 +8243,618 @@ void TStreamAggrTrigger::OnDelete(const TRec& Rec) {
     StreamAggr->OnDeleteRec(Rec, NULL);
 }
 
+///////////////////////////////
+// Write-ahead log
+TWalScope::TWalScope(const TWPt<TBase>& Base): Wal(NULL), LogP(false) {
+    if (!Base.Empty() && Base->IsWal()) {
+        Wal = Base->GetWal()();
+        LogP = (Wal->Depth == 0) && !Wal->IsReplay();
+        Wal->Depth++;
+    }
+}
+
+TWalScope::~TWalScope() {
+    if (Wal != NULL) { Wal->Depth--; }
+}
+
+void TWalScope::Log(const TWalOpType& OpType, const uint& StoreId, const PJsonVal& Val) {
+    if (LogP) { Wal->Log(OpType, StoreId, Val); }
+    // close the scope, so changes done by triggers called after are logged on their own
+    if (Wal != NULL) { Wal->Depth--; Wal = NULL; LogP = false; }
+}
+
+///////////////////////////////
+// Write-ahead log commit thread
+class TWalCommitter : public TThread {
+public:
+    friend class TPt<TWalCommitter>;
+
+private:
+    /// Log which we are committing
+    TWal* Wal;
+    /// Set when the thread should stop
+    std::atomic<bool> StopP;
+
+public:
+    TWalCommitter(TWal* _Wal): Wal(_Wal), StopP(false) { }
+
+    /// Commit loop of the thread
+    void Run();
+    /// Stop the thread and wait for it to finish
+    void Stop() { StopP = true; Join(); }
+};
+
+void TWalCommitter::Run() {
+    while (!StopP) {
+        TSysProc::Sleep(TInt::GetMx(TInt::GetMn(Wal->GroupCommitMSecs, 10), 1));
+        try {
+            // commit entries also when no new entries come to trigger it
+            if (Wal->IsCommitDue()) { Wal->Commit(); }
+        } catch (const PExcept& Except) {
+            ErrorLog("[TWalCommitter::Run] " + Except->GetMsgStr());
+        }
+    }
+}
+
+const int TWal::MagicNum = 0x4C415751;
+
+TWal::TWal(const TStr& _FPath, const int& _GroupCommitBytes, const int& _GroupCommitMSecs,
+        const uint64& _CheckpointBytes): FPath(_FPath), FNm(GetWalFNm(_FPath)), LogFOut(NULL),
+        BufEntries(0), GroupCommitBytes(_GroupCommitBytes), GroupCommitMSecs(_GroupCommitMSecs),
+        LastCommitMSecs(TTm::GetCurUniMSecs()), CheckpointBytes(_CheckpointBytes),
+        Depth(0), ReplayP(false), CleanP(false) {
+
+    // find the end of the last complete entry
+    const int64 FLen = (int64)TFile::GetSize(FNm); int64 ValidLen = 0;
+    uint64 StartLsn = 0;
+    {
+        TFIn FIn(FNm); int LeftLen = FIn.Len();
+        QmAssertR(LoadHeader(FIn, StartLsn), "Invalid write-ahead log header in " + FNm);
+        Lsn = StartLsn; ValidLen += LeftLen - FIn.Len(); LeftLen = FIn.Len();
+        TWalEntry Entry;
+        while (LoadEntry(FIn, Lsn, Entry)) {
+            Lsn = Entry.Lsn; ValidLen += LeftLen - FIn.Len(); LeftLen = FIn.Len();
+        }
+    }
+    // entries up to the checkpoint are already in the base files; manifest can be
+    // ahead of the log header when the crash came before the log was truncated
+    uint64 ManifestLsn = 0;
+    CheckpointLsn = (LoadManifest(FPath, ManifestLsn) && ManifestLsn > StartLsn) ? ManifestLsn : StartLsn;
+    // cut entries torn by a crash, so new entries follow the last complete one
+    if (ValidLen < FLen) {
+        TEnv::Logger->OnStatusFmt("Cutting %s bytes of torn write-ahead log entries",
+            TInt64::GetStr(FLen - ValidLen).CStr());
+        const TStr TmpFNm = FNm + ".tmp";
+        {
+            TFIn FIn(FNm); TFOut FOut(TmpFNm);
+            TMem ValidMem; int64 CopyLen = ValidLen;
+            while (CopyLen > 0) {
+                const int BfLen = (int)(CopyLen < TInt::Mega ? CopyLen : TInt::Mega);
+                ValidMem.Gen(BfLen);
+                FIn.GetBf(ValidMem.GetBf(), BfLen);
+                FOut.PutBf(ValidMem.GetBf(), BfLen);
+                CopyLen -= BfLen;
+            }
+            FOut.Sync();
+        }
+        TFile::Del(FNm);
+        TFile::Rename(TmpFNm, FNm);
+    }
+    LogBytes = (uint64)ValidLen;
+    LogFOut = new TFOut(FNm, true);
+    Committer = new TWalCommitter(this);
+    Committer->Start();
+    TEnv::Logger->OnStatusFmt("Write-ahead log opened with %s entries after checkpoint %s",
+        TUInt64::GetStr(Lsn - CheckpointLsn).CStr(), TUInt64::GetStr(CheckpointLsn).CStr());
+}
+
+TWal::~TWal() {
+    Committer->Stop();
+    if (CleanP) {
+        // base files are consistent, log is no longer needed; next log continues the numbering
+        delete LogFOut;
+        SaveManifest(FPath, Lsn);
+        TFile::Del(FNm, false);
+    } else {
+        Commit();
+        delete LogFOut;
+    }
+}
+
+bool TWal::LoadManifest(const TStr& FPath, uint64& Lsn) {
+    const TStr ManifestFNm = GetManifestFNm(FPath);
+    if (!TFile::Exists(ManifestFNm)) { return false; }
+    TFIn FIn(ManifestFNm);
+    Lsn = TUInt64(FIn).Val;
+    return true;
+}
+
+void TWal::SaveManifest(const TStr& FPath, const uint64& Lsn) {
+    // written next to the old one and renamed over it, so there is always a complete manifest
+    const TStr ManifestFNm = GetManifestFNm(FPath);
+    {
+        TFOut FOut(ManifestFNm + ".tmp");
+        TUInt64(Lsn).Save(FOut);
+        FOut.Sync();
+    }
+    if (TFile::Exists(ManifestFNm)) { TFile::Del(ManifestFNm); }
+    TFile::Rename(ManifestFNm + ".tmp", ManifestFNm);
+}
+
+void TWal::SaveHeader(TSOut& SOut, const uint64& StartLsn) {
+    SOut.Save(MagicNum);
+    TUInt64(StartLsn).Save(SOut);
+}
+
+bool TWal::LoadHeader(TSIn& SIn, uint64& StartLsn) {
+    if (SIn.Len() < (int)(sizeof(int) + sizeof(uint64))) { return false; }
+    int FileMagicNum; SIn.Load(FileMagicNum);
+    if (FileMagicNum != MagicNum) { return false; }
+    StartLsn = TUInt64(SIn).Val;
+    return true;
+}
+
+bool TWal::Recover(const TStr& FPath) {
+    const TStr WalFNm = GetWalFNm(FPath);
+    // complete manifest update or log truncation interrupted by a crash
+    const TStr ManifestFNm = GetManifestFNm(FPath);
+    if (TFile::Exists(ManifestFNm + ".tmp")) {
+        if (TFile::Exists(ManifestFNm)) { TFile::Del(ManifestFNm + ".tmp"); } else { TFile::Rename(ManifestFNm + ".tmp", ManifestFNm); }
+    }
+    if (TFile::Exists(WalFNm + ".tmp")) {
+        if (TFile::Exists(WalFNm)) { TFile::Del(WalFNm + ".tmp"); } else { TFile::Rename(WalFNm + ".tmp", WalFNm); }
+    }
+    // log exists from the moment base is opened until it is closed cleanly
+    if (TFile::Exists(WalFNm)) {
+        TEnv::Logger->OnStatus("Base was not closed cleanly, replaying write-ahead log after last checkpoint");
+        // same as when opening the log, manifest is ahead of the log header when the
+        // crash came before the log was truncated
+        uint64 CheckpointLsn = 0;
+        { TFIn WalFIn(WalFNm); LoadHeader(WalFIn, CheckpointLsn); }
+        uint64 ManifestLsn = 0;
+        if (LoadManifest(FPath, ManifestLsn) && ManifestLsn > CheckpointLsn) { CheckpointLsn = ManifestLsn; }
+        TStrV FNmV; TFFile::GetFNmV(FPath, TStrV(), false, FNmV);
+        for (const TStr& FNm : FNmV) {
+            // paged files overwritten after the checkpoint get their pages back from undo files
+            if (FNm.EndsWith(".undo")) { TPgBlob::RestoreCheckpoint(FNm.GetSubStr(0, FNm.Len() - 6), CheckpointLsn); }
+            // blob bases changed after the checkpoint are still marked as opened, opening
+            // them in restore mode marks them as closed again and drops blobs added after it
+            if (FNm.EndsWith(".mbb")) { TMBlobBs::New(FNm.GetSubStr(0, FNm.Len() - 5), faRestore); }
+        }
+        return true;
+    }
+    // base was closed cleanly, pages kept for the last checkpoint are not needed
+    TStrV FNmV; TFFile::GetFNmV(FPath, TStrV(), false, FNmV);
+    for (const TStr& FNm : FNmV) {
+        if (FNm.EndsWith(".undo")) { TFile::Del(FNm); }
+    }
+    // start empty log which continues after the last entry
+    uint64 Lsn = 0; LoadManifest(FPath, Lsn);
+    TFOut WalFOut(WalFNm);
+    SaveHeader(WalFOut, Lsn);
+    WalFOut.Sync();
+    return false;
+}
+
+bool TWal::LoadEntry(TSIn& SIn, const uint64& PrevLsn, TWalEntry& Entry) {
+    // entry header: length and checksum of the entry
+    if (SIn.Len() < 2 * (int)sizeof(int)) { return false; }
+    int EntryLen; SIn.Load(EntryLen);
+    int EntryCs; SIn.Load(EntryCs);
+    if (EntryLen <= 0 || EntryLen > SIn.Len()) { return false; }
+    // entry
+    TMem EntryMem; EntryMem.Gen(EntryLen);
+    SIn.GetBf(EntryMem.GetBf(), EntryLen);
+    if (TCs::GetCsFromBf(EntryMem.GetBf(), EntryLen).Get() != EntryCs) { return false; }
+    TMIn EntryIn(EntryMem.GetBf(), EntryLen, false);
+    Entry.Lsn.Load(EntryIn);
+    // sequence numbers must follow each other
+    if (Entry.Lsn.Val != PrevLsn + 1) { return false; }
+    Entry.OpType = (TWalOpType)TUCh(EntryIn).Val;
+    Entry.StoreId.Load(EntryIn);
+    Entry.ValStr.Load(EntryIn);
+    return true;
+}
+
+void TWal::Log(const TWalOpType& OpType, const uint& StoreId, const PJsonVal& Val) {
+    TLock Lock(WalSection);
+    // serialize entry
+    TMOut EntryOut;
+    TUInt64(Lsn + 1).Save(EntryOut);
+    TUCh((uchar)OpType).Save(EntryOut);
+    TUInt(StoreId).Save(EntryOut);
+    TJsonVal::GetStrFromVal(Val).Save(EntryOut);
+    // append it to the buffer with its length and checksum
+    const int EntryLen = EntryOut.Len();
+    BufOut.Save(EntryLen);
+    BufOut.Save(TCs::GetCsFromBf(EntryOut.GetBfAddr(), EntryLen).Get());
+    BufOut.PutBf(EntryOut.GetBfAddr(), EntryLen);
+    Lsn++; BufEntries++;
+    // commit when buffer is big or old enough
+    if (BufOut.Len() >= GroupCommitBytes || TTm::GetCurUniMSecs() >= LastCommitMSecs.Val + (uint64)GroupCommitMSecs.Val) {
+        Commit();
+    }
+}
+
+void TWal::Commit() {
+    TLock Lock(WalSection);
+    if (BufOut.Len() > 0) {
+        LogFOut->PutBf(BufOut.GetBfAddr(), BufOut.Len());
+        LogFOut->Sync();
+        Commits++; CommitBytes += (uint64)BufOut.Len(); LogBytes += (uint64)BufOut.Len();
+        BufOut.Clr(); BufEntries = 0;
+    }
+    LastCommitMSecs = TTm::GetCurUniMSecs();
+}
+
+bool TWal::IsCommitDue() const {
+    TLock Lock(WalSection);
+    return BufEntries > 0 && TTm::GetCurUniMSecs() >= LastCommitMSecs.Val + (uint64)GroupCommitMSecs.Val;
+}
+
+void TWal::Checkpoint(const uint64& _CheckpointLsn) {
+    TLock Lock(WalSection);
+    QmAssert(_CheckpointLsn <= Lsn);
+    // everything up to Lsn must be in the log before the checkpoint replaces its start
+    Commit();
+    SaveManifest(FPath, _CheckpointLsn);
+    // truncate the log, keeping only entries logged after the checkpoint
+    const TStr TmpFNm = FNm + ".tmp";
+    uint64 TailBytes = 0;
+    {
+        TFOut FOut(TmpFNm);
+        SaveHeader(FOut, _CheckpointLsn);
+        TFIn FIn(FNm); uint64 StartLsn = 0;
+        QmAssertR(LoadHeader(FIn, StartLsn), "Invalid write-ahead log header in " + FNm);
+        uint64 EntryLsn = StartLsn;
+        while (EntryLsn < Lsn) {
+            // entries are framed by length and checksum, which we copy as they are
+            const int EntryStartLen = FIn.Len();
+            TMem FrameMem; FrameMem.Gen(2 * (int)sizeof(int));
+            FIn.GetBf(FrameMem.GetBf(), FrameMem.Len());
+            TMIn FrameIn(FrameMem.GetBf(), FrameMem.Len(), false);
+            int EntryLen; FrameIn.Load(EntryLen);
+            TMem EntryMem; EntryMem.Gen(EntryLen);
+            FIn.GetBf(EntryMem.GetBf(), EntryLen);
+            TMIn EntryIn(EntryMem.GetBf(), EntryLen, false);
+            EntryLsn = TUInt64(EntryIn).Val;
+            if (EntryLsn > _CheckpointLsn) {
+                FOut.PutBf(FrameMem.GetBf(), FrameMem.Len());
+                FOut.PutBf(EntryMem.GetBf(), EntryLen);
+                TailBytes += (uint64)(EntryStartLen - FIn.Len());
+            }
+        }
+        FOut.Sync();
+    }
+    delete LogFOut; LogFOut = NULL;
+    TFile::Del(FNm);
+    TFile::Rename(TmpFNm, FNm);
+    LogFOut = new TFOut(FNm, true);
+    CheckpointLsn = _CheckpointLsn; LogBytes = TailBytes; Checkpoints++;
+}
+
+PJsonVal TWal::GetStats() const {
+    PJsonVal StatsVal = TJsonVal::NewObj();
+    StatsVal->AddToObj("lsn", Lsn.Val);
+    StatsVal->AddToObj("checkpointLsn", CheckpointLsn.Val);
+    StatsVal->AddToObj("pendingEntries", BufEntries.Val);
+    StatsVal->AddToObj("pendingBytes", BufOut.Len());
+    StatsVal->AddToObj("logBytes", LogBytes.Val);
+    StatsVal->AddToObj("commits", Commits.Val);
+    StatsVal->AddToObj("commitBytes", CommitBytes.Val);
+    StatsVal->AddToObj("checkpoints", Checkpoints.Val);
+    return StatsVal;
+}
+
+///////////////////////////////
+// Background flusher
+class TBaseFlusher : public TThread {
+public:
+    friend class TPt<TBaseFlusher>;
+
+private:
+    /// Base which we are flushing
+    TBase* Base;
+    /// Time between flushes, when dirty data is below the ceiling
+    TInt TickMSecs;
+    /// Time budget of a single flush
+    TInt SliceMSecs;
+    /// Dirty data ceiling, above which adding records is throttled
+    TUInt64 MxDirtyBytes;
+    /// Held while flushing and while base data is used by flush scopes
+    TCriticalSection FlushSection;
+    /// Nesting depth of flush scopes, only changed while holding the flush section
+    std::atomic<int> ScopeDepth;
+    /// Dirty data measured after the last flush
+    std::atomic<uint64> DirtyBytes;
+    /// Set when the last flush did not find anything to write
+    std::atomic<bool> CleanP;
+    /// Set when the thread should stop
+    std::atomic<bool> StopP;
+    /// Throttled writers wait on it until the flusher signals progress
+    TCondVarLock ThrottleLock;
+
+    /// Number of flushes
+    std::atomic<uint64> Flushes;
+    /// Number of blocks written by flushes
+    std::atomic<uint64> FlushedBlocks;
+    /// Number of times adding records was throttled
+    std::atomic<uint64> Throttles;
+    /// Time adding records spent waiting for the flusher
+    std::atomic<uint64> ThrottleMSecs;
+
+    /// Check if dirty data is above the ceiling and the flusher can still reduce it
+    bool IsThrottle() const { return DirtyBytes > MxDirtyBytes && !CleanP && !StopP; }
+    /// Wait while adding records is throttled
+    void Throttle();
+    /// Wake up throttled writers after the flusher made progress or stopped
+    void SignalThrottle();
+
+public:
+    TBaseFlusher(TBase* _Base, const int& _TickMSecs, const int& _SliceMSecs, const uint64& _MxDirtyBytes);
+
+    /// Flush loop of the thread
+    void Run();
+    /// Stop the thread and wait for it to finish
+    void Stop();
+
+    /// Enter flush scope of the ingest thread
+    void Enter(const bool& ThrottleP);
+    /// Leave flush scope of the ingest thread
+    void Leave();
+    /// Take the lock without entering a scope, used for flushing
+    void Lock();
+    /// Release the lock taken with Lock
+    void Unlock();
+
+    /// Get flusher statistics
+    PJsonVal GetStats() const;
+};
+
+/// Holds flusher lock, when there is a flusher, for flushing or measuring dirty data
+class TBaseFlusherLock {
+private:
+    TBaseFlusher* Flusher;
+public:
+    TBaseFlusherLock(const TWPt<TBaseFlusher>& _Flusher): Flusher(_Flusher()) {
+        if (Flusher != NULL) { Flusher->Lock(); } }
+    ~TBaseFlusherLock() { if (Flusher != NULL) { Flusher->Unlock(); } }
+};
+
+TBaseFlusher::TBaseFlusher(TBase* _Base, const int& _TickMSecs, const int& _SliceMSecs,
+        const uint64& _MxDirtyBytes): Base(_Base), TickMSecs(_TickMSecs), SliceMSecs(_SliceMSecs),
+        MxDirtyBytes(_MxDirtyBytes), ScopeDepth(0), DirtyBytes(0), CleanP(false), StopP(false),
+        Flushes(0), FlushedBlocks(0), Throttles(0), ThrottleMSecs(0) {
+
+    QmAssertR(TickMSecs > 0 && SliceMSecs > 0, "Flusher tick and slice must be positive");
+}
+
+void TBaseFlusher::Throttle() {
+    if (!IsThrottle()) { return; }
+    TTmStopWatch Sw(true);
+    ThrottleLock.Lock();
+    while (IsThrottle()) { ThrottleLock.WaitForSignal(); }
+    ThrottleLock.Release();
+    Throttles++; ThrottleMSecs += (uint64)Sw.GetMSecInt();
+}
+
+void TBaseFlusher::SignalThrottle() {
+    ThrottleLock.Lock();
+    ThrottleLock.Broadcast();
+    ThrottleLock.Release();
+}
+
+void TBaseFlusher::Run() {
+    const int SleepMSecs = TInt::GetMn(TickMSecs, 10);
+    while (!StopP) {
+        // flush again right away while above the ceiling and making progress
+        if (DirtyBytes <= MxDirtyBytes || CleanP) {
+            for (int MSecs = 0; MSecs < TickMSecs && !StopP; MSecs += SleepMSecs) {
+                TSysProc::Sleep(SleepMSecs);
+            }
+        }
+        if (StopP) { break; }
+        try {
+            const int Saved = Base->PartialFlushData(SliceMSecs);
+            {
+                // update under the lock, so writers can not miss the signal between check and wait
+                ThrottleLock.Lock();
+                DirtyBytes = Base->GetDirtyBytes();
+                CleanP = (Saved == 0);
+                ThrottleLock.Release();
+            }
+            SignalThrottle();
+            Flushes++; FlushedBlocks += (uint64)Saved;
+            // once all dirty data is written, checkpoint only needs to save the rest of the
+            // state; it locks stores and the index one at a time, so ingest is not held up
+            if (CleanP && Base->IsWal() && Base->GetWal()->IsCheckpointDue()) { Base->Checkpoint(); }
+        } catch (const PExcept& Except) {
+            ErrorLog("[TBaseFlusher::Run] " + Except->GetMsgStr());
+            // flush failed, do not keep writers waiting for it
+            CleanP = true; SignalThrottle();
+        }
+    }
+}
+
+void TBaseFlusher::Stop() {
+    StopP = true;
+    SignalThrottle();
+    Join();
+}
+
+void TBaseFlusher::Enter(const bool& ThrottleP) {
+    if (Base->IsConcurrent()) {
+        // base lock already keeps flusher away, throttle only when not holding it
+        if (ThrottleP && !Base->GetLock().IsHeld()) { Throttle(); }
+        return;
+    }
+    // only throttle outside of scopes, otherwise we are holding the lock the flusher needs
+    if (ThrottleP && ScopeDepth == 0) { Throttle(); }
+    FlushSection.Enter();
+    ScopeDepth++;
+}
+
+void TBaseFlusher::Leave() {
+    if (Base->IsConcurrent()) { return; }
+    ScopeDepth--;
+    FlushSection.Leave();
+}
+
+void TBaseFlusher::Lock() {
+    // in concurrent mode flushing excludes readers as well as the writer
+    if (Base->IsConcurrent()) { Base->GetLock().EnterWrite(); } else { FlushSection.Enter(); }
+}
+
+void TBaseFlusher::Unlock() {
+    if (Base->IsConcurrent()) { Base->GetLock().LeaveWrite(); } else { FlushSection.Leave(); }
+}
+
+PJsonVal TBaseFlusher::GetStats() const {
+    PJsonVal StatsVal = TJsonVal::NewObj();
+    StatsVal->AddToObj("dirtyBytes", (uint64)DirtyBytes);
+    StatsVal->AddToObj("maxDirtyBytes", MxDirtyBytes.Val);
+    StatsVal->AddToObj("flushes", (uint64)Flushes);
+    StatsVal->AddToObj("flushedBlocks", (uint64)FlushedBlocks);
+    StatsVal->AddToObj("throttles", (uint64)Throttles);
+    StatsVal->AddToObj("throttleMSecs", (uint64)ThrottleMSecs);
+    return StatsVal;
+}
+
+TFlushScope::TFlushScope(const TWPt<TBaseFlusher>& _Flusher, const bool& ThrottleP): Flusher(_Flusher()) {
+    if (Flusher != NULL) { Flusher->Enter(ThrottleP); }
+}
+
+TFlushScope::~TFlushScope() {
+    if (Flusher != NULL) { Flusher->Leave(); }
+}
+
+TReadScope::TReadScope(const TWPt<TBase>& Base): Lock(NULL) {
+    if (Base->IsConcurrent()) { Lock = &Base->GetLock(); Lock->EnterRead(); }
+}
+
+TReadScope::~TReadScope() {
+    if (Lock != NULL) { Lock->LeaveRead(); }
+}
+
+TWriteScope::TWriteScope(const TWPt<TBase>& Base): Lock(NULL) {
+    if (Base->IsConcurrent()) { Lock = &Base->GetLock(); Lock->EnterWrite(); }
+}
+
+TWriteScope::~TWriteScope() {
+    if (Lock != NULL) { Lock->LeaveWrite(); }
+}
+
+///////////////////////////////
+// QMiner-Binary-Dump
+const TStr TBinDump::MagicStr = "QMinerBinDump";
+const int TBinDump::Version = 1;
+const int TBinDump::BlockBytes = 1024 * 1024;
+
+void TBinDump::SaveHeader(TSOut& SOut) {
+    MagicStr.Save(SOut);
+    TInt(Version).Save(SOut);
+}
+
+void TBinDump::LoadHeader(TSIn& SIn, const TStr& FNm) {
+    const TStr DumpMagicStr(SIn);
+    QmAssertR(DumpMagicStr == MagicStr, "Not a binary dump: " + FNm);
+    const int DumpVersion = TInt(SIn);
+    QmAssertR(DumpVersion == Version, "Unsupported binary dump version " + TInt::GetStr(DumpVersion) + ": " + FNm);
+}
+
+void TBinDump::SaveBlock(TSOut& SOut, const int& Items, const TMOut& BlockOut) {
+    const int BlockLen = BlockOut.Len();
+    TInt(Items).Save(SOut);
+    TInt(BlockLen).Save(SOut);
+    TInt(TCs::GetCsFromBf(BlockOut.GetBfAddr(), BlockLen).Get()).Save(SOut);
+    SOut.PutBf(BlockOut.GetBfAddr(), BlockLen);
+}
+
+int TBinDump::LoadBlock(TSIn& SIn, TMem& BlockMem) {
+    const int Items = TInt(SIn);
+    if (Items == 0) { return 0; }
+    const int BlockLen = TInt(SIn);
+    const int BlockCs = TInt(SIn);
+    QmAssertR(Items > 0 && BlockLen >= 0 && BlockLen <= SIn.Len(), "Corrupted binary dump block");
+    BlockMem.Gen(BlockLen);
+    SIn.GetBf(BlockMem.GetBf(), BlockLen);
+    QmAssertR(TCs::GetCsFromBf(BlockMem.GetBf(), BlockLen).Get() == BlockCs, "Corrupted binary dump block");
+    return Items;
+}
+
+///////////////////////////////
+// Query result cache
+bool TQueryCache::TItem::IsValid(const TWPt<TIndex>& Index) const {
+    for (const TIntUInt64Pr& KeyVer : KeyVerV) {
+        if (Index->GetKeyModVer(KeyVer.Val1) != KeyVer.Val2) { return false; }
+    }
+    for (const TUIntUInt64Pr& StoreVer : StoreVerV) {
+        if (Index->GetStoreModVer(StoreVer.Val1) != StoreVer.Val2) { return false; }
+    }
+    return true;
+}
+
+uint64 TQueryCache::TItem::GetMemUsed() const {
+    return sizeof(TItem) + sizeof(TRecSet) + RecSet->GetRecIdFqV().GetMemUsed() +
+        KeyVerV.GetMemUsed() + StoreVerV.GetMemUsed();
+}
+
+bool TQueryCache::Get(const TWPt<TIndex>& Index, const TStr& QueryKey, PRecSet& RecSet) {
+    TLock CacheLock(CacheSection);
+    PItem Item;
+    if (!Cache.Get(QueryKey, Item)) { Misses++; return false; }
+    if (!Item->IsValid(Index)) {
+        // records were changed since, result will be replaced
+        Cache.Del(QueryKey); Invalidations++; Misses++;
+        return false;
+    }
+    // move to front, so recently used results are dropped last
+    Cache.Put(QueryKey, Item);
+    RecSet = Item->RecSet; Hits++;
+    return true;
+}
+
+void TQueryCache::Put(const TWPt<TIndex>& Index, const TStr& QueryKey, const TIntSet& KeyIdSet,
+        const TUIntSet& StoreIdSet, const PRecSet& RecSet) {
+
+    // base is locked for reading during search, so versions did not change since it started
+    PItem Item = new TItem;
+    Item->RecSet = RecSet;
+    int KeyIdSetKeyId = KeyIdSet.FFirstKeyId();
+    while (KeyIdSet.FNextKeyId(KeyIdSetKeyId)) {
+        const int KeyId = KeyIdSet.GetKey(KeyIdSetKeyId);
+        Item->KeyVerV.Add(TIntUInt64Pr(KeyId, Index->GetKeyModVer(KeyId)));
+    }
+    int StoreIdSetKeyId = StoreIdSet.FFirstKeyId();
+    while (StoreIdSet.FNextKeyId(StoreIdSetKeyId)) {
+        const uint StoreId = StoreIdSet.GetKey(StoreIdSetKeyId);
+        Item->StoreVerV.Add(TUIntUInt64Pr(StoreId, Index->GetStoreModVer(StoreId)));
+    }
+    TLock CacheLock(CacheSection);
+    Cache.Put(QueryKey, Item);
+}
+
+void TQueryCache::Clr() {
+    TLock CacheLock(CacheSection);
+    Cache.FlushAndClr();
+}
+
+PJsonVal TQueryCache::GetStats() {
+    TLock CacheLock(CacheSection);
+    PJsonVal StatsVal = TJsonVal::NewObj();
+    StatsVal->AddToObj("results", Cache.Len());
+    StatsVal->AddToObj("memUsed", (uint64)Cache.GetCurMemUsed());
+    StatsVal->AddToObj("maxMemUsed", (uint64)Cache.GetMxMemUsed());
+    StatsVal->AddToObj("hits", Hits.Val);
+    StatsVal->AddToObj("misses", Misses.Val);
+    StatsVal->AddToObj("invalidations", Invalidations.Val);
+    return StatsVal;
+}
+
 ///////////////////////////////
 // QMiner-Base
+const int TBase::MnParallelSearchRecs = 10000;
+
 PRecSet TBase::Invert(const PRecSet& RecSet) {
     // prepare sorted list of all records from the store
     TUInt64IntKdV AllResIdV;
@@ -6851,46 +8910,9 @@ TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem) {
                 QueryItem.GetLoc(), QueryItem.GetLocLimit());
             return TPair<TBool, PRecSet>(false, RecSet);
         }
-    } else if (QueryItem.IsRangeInt()) {
+    } else if (QueryItem.IsRange()) {
         // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeIntMinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeInt16()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeInt16MinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeInt64()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeInt64MinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeByte()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeByteMinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeUInt()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUIntMinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeUInt16()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUInt16MinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeUInt64()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUInt64MinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeTm()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUInt64MinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeFlt()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeFltMinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
-    } else if (QueryItem.IsRangeSFlt()) {
-        // must be handled by BTree linear index
-        PRecSet RecSet = Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeSFltMinMax());
-        return TPair<TBool, PRecSet>(false, RecSet);
+        return TPair<TBool, PRecSet>(false, SearchRange(QueryItem));
     } else if (QueryItem.IsJoin()) {
         // special case when it's record passed by value
         const TQueryItem& SubItem = QueryItem.GetItem(0);
@@ -6927,9 +8949,103 @@ TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem) {
         QmAssert(QueryItem.IsAnd() || QueryItem.IsOr() || QueryItem.IsNot());
         // exeucte all interal query items
         TBoolV NotV; TRecSetV RecSetV;
+        // conjunctions of inverted index lookups with the same index type are done together
+        // by the index, which does not need to load parts of long posting lists that can not
+        // match items from the short ones
+        THash<TInt, TKeyWordV> GixTypeKeyWordVH;
+        TIntV ItemGixTypeV(QueryItem.GetItems(), 0);
         for (int ItemN = 0; ItemN < QueryItem.GetItems(); ItemN++) {
-            // do subsequent search
-            TPair<TBool, PRecSet> NotRecSet = _Search(QueryItem.GetItem(ItemN));
+            const TQueryItem& SubItem = QueryItem.GetItem(ItemN);
+            if (QueryItem.IsAnd() && SubItem.IsGix() && SubItem.IsEqual() && !SubItem.GetWordIdV().Empty()) {
+                const int KeyId = SubItem.GetKeyId();
+                const int GixType = (int)IndexVoc->GetKey(KeyId).GetGixType();
+                TKeyWordV& KeyWordV = GixTypeKeyWordVH.AddDat(GixType);
+                for (const uint64 WordId : SubItem.GetWordIdV()) {
+                    KeyWordV.Add(TKeyWord(KeyId, WordId));
+                }
+                ItemGixTypeV.Add(GixType);
+            } else {
+                ItemGixTypeV.Add(-1);
+            }
+        }
+        // range conditions marked by the planner are checked on the merged result,
+        // grouped lookups are done in place of the first one from the group
+        TIntV FilterItemNV, EvalItemNV; TIntSet EvalGixTypeSet;
+        for (int ItemN = 0; ItemN < QueryItem.GetItems(); ItemN++) {
+            const TQueryItem& SubItem = QueryItem.GetItem(ItemN);
+            const int GixType = ItemGixTypeV[ItemN];
+            if (SubItem.IsFilter()) {
+                FilterItemNV.Add(ItemN);
+            } else if (GixType == -1) {
+                EvalItemNV.Add(ItemN);
+            } else if (!EvalGixTypeSet.IsKey(GixType)) {
+                EvalItemNV.Add(ItemN); EvalGixTypeSet.AddKey(GixType);
+            }
+        }
+        // independent index lookups can be done in parallel, the rest is evaluated
+        // in order, so conjunctions can stop at the first empty result
+        TVec<TPair<TBool, PRecSet> > EvalResV(EvalItemNV.Len());
+        TIntV ParallelEvalNV; double ParallelRecs = 0.0;
+        for (int EvalN = 0; EvalN < EvalItemNV.Len(); EvalN++) {
+            const TQueryItem& SubItem = QueryItem.GetItem(EvalItemNV[EvalN]);
+            if (SubItem.IsIndexLookup()) { ParallelEvalNV.Add(EvalN); ParallelRecs += SubItem.GetEstRecs(); }
+        }
+        // lookups taking the same index lock would only wait for each other, so they
+        // are done one after another in the same task
+        TVec<TIntV> TaskEvalNV; TVec<TIntSet> TaskLockIdSetV;
+        for (const int EvalN : ParallelEvalNV) {
+            TIntSet LockIdSet; Index->GetSearchLockIdSet(QueryItem.GetItem(EvalItemNV[EvalN]), LockIdSet);
+            TIntV EvalNV; EvalNV.Add(EvalN);
+            // merge with all tasks sharing a lock with the lookup
+            for (int TaskN = 0; TaskN < TaskEvalNV.Len(); TaskN++) {
+                const TIntSet& TaskLockIdSet = TaskLockIdSetV[TaskN];
+                bool SharedP = false;
+                int LockKeyId = LockIdSet.FFirstKeyId();
+                while (!SharedP && LockIdSet.FNextKeyId(LockKeyId)) {
+                    SharedP = TaskLockIdSet.IsKey(LockIdSet.GetKey(LockKeyId));
+                }
+                if (!SharedP) { continue; }
+                EvalNV.AddV(TaskEvalNV[TaskN]);
+                LockKeyId = TaskLockIdSet.FFirstKeyId();
+                while (TaskLockIdSet.FNextKeyId(LockKeyId)) { LockIdSet.AddKey(TaskLockIdSet.GetKey(LockKeyId)); }
+                TaskEvalNV.Del(TaskN); TaskLockIdSetV.Del(TaskN); TaskN--;
+            }
+            EvalNV.Sort(); TaskEvalNV.Add(EvalNV); TaskLockIdSetV.Add(LockIdSet);
+        }
+        // background flusher excludes other threads while one is reading the index
+        const bool ParallelP = TaskEvalNV.Len() > 1 && ParallelRecs >= MnParallelSearchRecs &&
+            (Flusher.Empty() || ConcurrentP);
+        auto EvalItem = [&](const int& EvalN) {
+            const int ItemN = EvalItemNV[EvalN];
+            if (ItemGixTypeV[ItemN] != -1) {
+                const TKeyWordV& KeyWordV = GixTypeKeyWordVH.GetDat(ItemGixTypeV[ItemN]);
+                EvalResV[EvalN] = TPair<TBool, PRecSet>(false, Index->SearchGixAnd(this, KeyWordV));
+            } else {
+                // do subsequent search
+                EvalResV[EvalN] = _Search(QueryItem.GetItem(ItemN));
+            }
+        };
+        if (ParallelP) {
+            TStr ErrorMsg;
+            #pragma omp parallel for schedule(dynamic)
+            for (int TaskN = 0; TaskN < TaskEvalNV.Len(); TaskN++) {
+                try {
+                    for (const int EvalN : TaskEvalNV[TaskN]) { EvalItem(EvalN); }
+                } catch (const PExcept& Except) {
+                    // exceptions can not leave the parallel region
+                    #pragma omp critical
+                    { if (ErrorMsg.Empty()) { ErrorMsg = Except->GetMsgStr(); } }
+                }
+            }
+            if (!ErrorMsg.Empty()) { throw TQmExcept::New(ErrorMsg); }
+        }
+        for (int EvalN = 0; EvalN < EvalItemNV.Len(); EvalN++) {
+            if (EvalResV[EvalN].Val2.Empty()) { EvalItem(EvalN); }
+            const TPair<TBool, PRecSet>& NotRecSet = EvalResV[EvalN];
+            // nothing left to intersect with, skip the rest of the conjunction
+            if (QueryItem.IsAnd() && !NotRecSet.Val1 && NotRecSet.Val2->Empty()) {
+                return NotRecSet;
+            }
             NotV.Add(NotRecSet.Val1); RecSetV.Add(NotRecSet.Val2);
         }
         // merge the results according to the operator
@@ -6964,6 +9080,21 @@ TPair<TBool, PRecSet> TBase::_Search(const TQueryItem& QueryItem) {
                     NotP = false;
                 }
             }
+            if (!FilterItemNV.Empty()) {
+                // planner only leaves filters next to a non-negated sibling
+                QmAssert(!NotP);
+                const TWPt<TStore> Store = RecSetV[0]->GetStore();
+                TUInt64IntKdV FltRecIdFqV(ResRecIdFqV.Len(), 0);
+                for (const TUInt64IntKd& RecIdFq : ResRecIdFqV) {
+                    bool KeepP = true;
+                    for (int FilterN = 0; KeepP && FilterN < FilterItemNV.Len(); FilterN++) {
+                        const TQueryItem& FilterItem = QueryItem.GetItem(FilterItemNV[FilterN]);
+                        KeepP = FilterItem.IsInRange(this, Store, RecIdFq.Key);
+                    }
+                    if (KeepP) { FltRecIdFqV.Add(RecIdFq); }
+                }
+                ResRecIdFqV = FltRecIdFqV;
+            }
             // prepare resulting record set
             PRecSet RecSet = TRecSet::New(RecSetV[0]->GetStore(), ResRecIdFqV, QueryItem.IsFq());
             return TPair<TBool, PRecSet>(NotP, RecSet);
@@ -7022,12 +9153,14 @@ void TBase::LoadBaseConf(const TStr& FPath) {
     }
 
     NmValidator.SetStrictNmP(BaseConfJson->GetObjBool("strictNames", true));
+    Index->SetGixCompress(BaseConfJson->GetObjBool("indexCompress", false));
 }
 
 void TBase::SaveBaseConf(const TStr& FPath) const {
     PJsonVal BaseConfJson = TJsonVal::NewObj();
 
     BaseConfJson->AddToObj("strictNames", NmValidator.IsStrictNmP());
+    BaseConfJson->AddToObj("indexCompress", Index->IsGixCompress());
 
     const TStr BaseConfStr = TJsonVal::GetStrFromVal(BaseConfJson);
     TFOut BasePropsFOut(GetConfFNm(FPath));
@@ -7049,6 +9182,7 @@ TBase::TBase(const TStr& _FPath, const int64& IndexCacheSize, const TStrUInt64H&
         IndexTypeCacheSizeH.GetDatOrDef("small", IndexCacheSize),
         IndexTypeCacheSizeH.GetDatOrDef("tiny", IndexCacheSize),
         IndexTypeCacheSizeH.GetDatOrDef("pos", IndexCacheSize),
+        IndexTypeCacheSizeH.GetDatOrDef("linear", IndexCacheSize),
         SplitLen);
     // initialize store blob base
     StoreBlobBs = TMBlobBs::New(FPath + "StoreBlob", FAccess);
@@ -7083,6 +9217,7 @@ TBase::TBase(const TStr& _FPath, const TFAccess& _FAccess, const int64& IndexCac
         IndexTypeCacheSizeH.GetDatOrDef("small", IndexCacheSize),
         IndexTypeCacheSizeH.GetDatOrDef("tiny", IndexCacheSize),
         IndexTypeCacheSizeH.GetDatOrDef("pos", IndexCacheSize),
+        IndexTypeCacheSizeH.GetDatOrDef("linear", IndexCacheSize),
         SplitLen);
     // load shared store blob base
     StoreBlobBs = TMBlobBs::New(FPath + "StoreBlob", FAccess);
@@ -7096,6 +9231,8 @@ TBase::TBase(const TStr& _FPath, const TFAccess& _FAccess, const int64& IndexCac
 }
 
 TBase::~TBase() {
+    // no flushing in the background while we save
+    StopFlusher();
     if (FAccess != faRdOnly) {
         TEnv::Logger->OnStatus("Saving index vocabulary ... ");
 
@@ -7103,6 +9240,13 @@ TBase::~TBase() {
         IndexVoc->Save(IndexVocFOut);
 
         SaveBaseConf(FPath);
+        if (!Wal.Empty() && !Wal->IsReplay()) {
+            // last checkpoint releases everything kept for the previous one, so
+            // closing stores and index does not change the files anymore
+            Checkpoint();
+            // log is truncated once the rest of the base is saved
+            Wal->SetClean();
+        }
     } else {
         TEnv::Logger->OnStatus("No saving of qminer base neccessary!");
     }
@@ -7123,8 +9267,13 @@ TWPt<TIndex> TBase::GetIndex() const {
 }
 
 void TBase::AddStore(const PStore& NewStore) {
+    TFlushScope FlushScope(Flusher);
+    TWriteScope WriteScope(this);
+    if (ConcurrentP) { NewStore->EnableConcurrency(); }
     const uint StoreId = NewStore->GetStoreId();
     QmAssertR(StoreId < TEnv::GetMxStores(), "Store ID to large: " + TUInt::GetStr(StoreId));
+    // new store keeps its checkpoint files like the rest of the base
+    if (!Wal.Empty()) { NewStore->EnableCheckpoints(Wal->GetCheckpointLsn()); }
     // remember pointer to store
     StoreV[StoreId] = NewStore;
     // fast map from store name to store
@@ -7163,6 +9312,7 @@ bool TBase::IsStreamAggr(const TStr& StreamAggrNm) const {
 }
 
 void TBase::AddStreamAggr(const PStreamAggr& StreamAggr) {
+    TWriteScope WriteScope(this);
     QmAssertR(!IsStreamAggr(StreamAggr->GetAggrNm()),
         "Aggregate with this name already exists: " + StreamAggr->GetAggrNm());
     StreamAggrH.AddDat(StreamAggr->GetAggrNm(), StreamAggr);
@@ -7186,6 +9336,7 @@ void TBase::Aggr(PRecSet& RecSet, const TQueryAggrV& QueryAggrV) {
 }
 
 int TBase::NewIndexWordVoc(const TIndexKeyType& Type, const TStr& WordVocNm) {
+    TWriteScope WriteScope(this);
     if ((Type & oiktValue) || (Type & oiktText) || (Type & oiktTextPos)) {
         // check if we have a vocabulary with such name
         int WordVocId = WordVocNm.Empty() ? -1 : IndexVoc->GetWordVoc(WordVocNm);
@@ -7204,6 +9355,7 @@ int TBase::NewFieldIndexKey(const TWPt<TStore>& Store, const TStr& KeyNm, const
         const int& WordVocId, const TIndexKeyType& Type, const TIndexKeyGixType& GixType,
         const TIndexKeySortType& SortType) {
 
+    TWriteScope WriteScope(this);
     // make sure we do not have the key already
     QmAssertR(!IndexVoc->IsKeyNm(Store->GetStoreId(), KeyNm),
         "Key " + Store->GetStoreNm() + "." + KeyNm + " already exists!");
@@ -7230,14 +9382,188 @@ uint64 TBase::AddRec(const uint& StoreId, const PJsonVal& RecVal) {
     return AddRec(GetStoreByStoreId(StoreId), RecVal);
 }
 
+PRecSet TBase::SearchRange(const TQueryItem& QueryItem, const bool& ValSortP,
+        const bool& SortAscP, const int& Limit) {
+
+    if (QueryItem.IsRangeInt()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeIntMinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeInt16()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeInt16MinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeInt64()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeInt64MinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeByte()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeByteMinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeUInt()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUIntMinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeUInt16()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUInt16MinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeUInt64()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUInt64MinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeTm()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeUInt64MinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeFlt()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeFltMinMax(), ValSortP, SortAscP, Limit);
+    } else if (QueryItem.IsRangeSFlt()) {
+        return Index->SearchLinear(this, QueryItem.GetKeyId(), QueryItem.GetRangeSFltMinMax(), ValSortP, SortAscP, Limit);
+    }
+    throw TQmExcept::New("Unsupported range query item type");
+}
+
+bool TBase::SearchSortedRange(const PQuery& Query, PRecSet& RecSet) {
+    if (!Query->IsSort()) { return false; }
+    // top-level AND or OR with a single condition is just that condition
+    const TQueryItem* Item = &Query->GetQueryItem();
+    while ((Item->IsAnd() || Item->IsOr()) && Item->GetItems() == 1) { Item = &Item->GetItem(0); }
+    const TQueryItem& QueryItem = *Item;
+    if (!QueryItem.IsRange()) { return false; }
+    // aggregates need all the records
+    const int Limit = Query->GetLimit();
+    if (Limit != -1 && !Query->GetAggrItemV().Empty()) { return false; }
+    // index must be on the sorted field alone, so index order is the sort order
+    const TIndexKey& Key = IndexVoc->GetKey(QueryItem.GetKeyId());
+    if (Key.GetFields() != 1 || Key.GetFieldId(0) != Query->GetSortFieldId()) { return false; }
+    // records before offset are also read and cut out later
+    const int ReadLimit = (Limit == -1) ? -1 : Limit + Query->GetOffset();
+    RecSet = SearchRange(QueryItem, true, Query->IsSortAsc(), ReadLimit);
+    return true;
+}
+
+PRecSet TBase::SearchQueryItem(const PQuery& Query, bool& CacheP) {
+    // check if the result of query tree is in the cache
+    TChA QueryKeyChA; TIntSet KeyIdSet; TUIntSet StoreIdSet; PRecSet RecSet;
+    CacheP = !QueryCache.Empty() &&
+        Query->GetQueryItem().GetCacheKey(this, QueryKeyChA, KeyIdSet, StoreIdSet);
+    if (!CacheP || !QueryCache->Get(Index, QueryKeyChA, RecSet)) {
+        // plan a copy of the query tree, estimates depend on the current content of the base
+        TQueryItem QueryItem = Query->GetQueryItem();
+        QueryItem.Plan(this);
+        // do the search
+        TPair<TBool, PRecSet> NotRecSet = _Search(QueryItem);
+        // take the resulting record set
+        RecSet = NotRecSet.Val2;
+        Assert(!RecSet.Empty());
+        // if result should be negated, do the invert
+        if (NotRecSet.Val1) { RecSet = Invert(RecSet); }
+        // remember the result for next time
+        if (CacheP) { QueryCache->Put(Index, QueryKeyChA, KeyIdSet, StoreIdSet, RecSet); }
+    }
+    return RecSet;
+}
+
+uint64 TBase::CountRange(const TQueryItem& QueryItem, const bool& ExistsP) {
+    if (QueryItem.IsRangeInt()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeIntMinMax(), ExistsP);
+    } else if (QueryItem.IsRangeInt16()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeInt16MinMax(), ExistsP);
+    } else if (QueryItem.IsRangeInt64()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeInt64MinMax(), ExistsP);
+    } else if (QueryItem.IsRangeByte()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeByteMinMax(), ExistsP);
+    } else if (QueryItem.IsRangeUInt()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeUIntMinMax(), ExistsP);
+    } else if (QueryItem.IsRangeUInt16()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeUInt16MinMax(), ExistsP);
+    } else if (QueryItem.IsRangeUInt64() || QueryItem.IsRangeTm()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeUInt64MinMax(), ExistsP);
+    } else if (QueryItem.IsRangeFlt()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeFltMinMax(), ExistsP);
+    } else if (QueryItem.IsRangeSFlt()) {
+        return Index->GetLinearRangeRecs(QueryItem.GetKeyId(), QueryItem.GetRangeSFltMinMax(), ExistsP);
+    }
+    throw TQmExcept::New("Unsupported range query item type");
+}
+
+bool TBase::CountIndex(const TQueryItem& QueryItem, const bool& ExistsP, uint64& Recs) {
+    // top-level AND or OR with a single condition is just that condition
+    const TQueryItem* Item = &QueryItem;
+    while ((Item->IsAnd() || Item->IsOr()) && Item->GetItems() == 1) { Item = &Item->GetItem(0); }
+    if (Item->IsStore()) {
+        Recs = GetStoreByStoreId(Item->GetStoreId())->GetRecs();
+        return true;
+    } else if (Item->IsRange()) {
+        Recs = CountRange(*Item, ExistsP);
+        return true;
+    } else if (Item->IsGix() && (Item->IsEqual() || Item->IsNotEqual())) {
+        const int KeyId = Item->GetKeyId();
+        TKeyWordV KeyWordV(Item->GetWordIdV().Len(), 0);
+        for (const uint64 WordId : Item->GetWordIdV()) { KeyWordV.Add(TKeyWord(KeyId, WordId)); }
+        // negation needs the exact count of records it excludes
+        Recs = Index->GetGixAndRecs(KeyWordV, ExistsP && Item->IsEqual());
+        if (Item->IsNotEqual()) {
+            const uint StoreId = IndexVoc->GetKey(KeyId).GetStoreId();
+            Recs = GetStoreByStoreId(StoreId)->GetRecs() - Recs;
+        }
+        return true;
+    } else if (Item->IsAnd()) {
+        // conjunction of words from the same type of inverted index is counted by the index
+        TKeyWordV KeyWordV; int GixType = -1;
+        for (int ItemN = 0; ItemN < Item->GetItems(); ItemN++) {
+            const TQueryItem& SubItem = Item->GetItem(ItemN);
+            if (!SubItem.IsGix() || !SubItem.IsEqual() || SubItem.GetWordIdV().Empty()) { return false; }
+            const int KeyId = SubItem.GetKeyId();
+            const int KeyGixType = (int)IndexVoc->GetKey(KeyId).GetGixType();
+            if (GixType != -1 && GixType != KeyGixType) { return false; }
+            GixType = KeyGixType;
+            for (const uint64 WordId : SubItem.GetWordIdV()) { KeyWordV.Add(TKeyWord(KeyId, WordId)); }
+        }
+        Recs = Index->GetGixAndRecs(KeyWordV, ExistsP);
+        return true;
+    }
+    return false;
+}
+
+uint64 TBase::SearchCount(const PQuery& Query) {
+    TReadScope ReadScope(this);
+    uint64 Recs = 0;
+    if (!CountIndex(Query->GetQueryItem(), false, Recs)) {
+        // other queries are executed, only without sorting and aggregates
+        bool CacheP = false;
+        Recs = (uint64)SearchQueryItem(Query, CacheP)->GetRecs();
+    }
+    // same as trimming the record set in search
+    const uint64 Offset = (uint64)Query->GetOffset();
+    Recs = (Recs > Offset) ? (Recs - Offset) : 0;
+    if (Query->GetLimit() != -1 && Recs > (uint64)Query->GetLimit()) { Recs = (uint64)Query->GetLimit(); }
+    return Recs;
+}
+
+uint64 TBase::SearchCount(const PJsonVal& QueryVal) {
+    // query is parsed against index vocabulary
+    TReadScope ReadScope(this);
+    return SearchCount(TQuery::New(this, QueryVal));
+}
+
+bool TBase::SearchExists(const PQuery& Query) {
+    TReadScope ReadScope(this);
+    // skipped records have to be counted
+    if (Query->GetOffset() > 0 || Query->GetLimit() == 0) { return SearchCount(Query) > 0; }
+    uint64 Recs = 0;
+    if (!CountIndex(Query->GetQueryItem(), true, Recs)) {
+        bool CacheP = false;
+        Recs = (uint64)SearchQueryItem(Query, CacheP)->GetRecs();
+    }
+    return Recs > 0;
+}
+
+bool TBase::SearchExists(const PJsonVal& QueryVal) {
+    // query is parsed against index vocabulary
+    TReadScope ReadScope(this);
+    return SearchExists(TQuery::New(this, QueryVal));
+}
+
 PRecSet TBase::Search(const PQuery& Query) {
-    // do the search
-    TPair<TBool, PRecSet> NotRecSet = _Search(Query->GetQueryItem());
-    // take the resulting record set
-    PRecSet RecSet = NotRecSet.Val2;
-    Assert(!RecSet.Empty());
-    // if result should be negated, do the invert
-    if (NotRecSet.Val1) { RecSet = Invert(RecSet); }
+    TReadScope ReadScope(this);
+    PRecSet RecSet;
+    // sorted range is read from the linear index in order, up to the limit
+    if (SearchSortedRange(Query, RecSet)) {
+        Aggr(RecSet, Query->GetAggrItemV());
+        if (Query->IsLimit()) { RecSet = Query->GetLimit(RecSet); }
+        return RecSet;
+    }
+    bool CacheP = false;
+    RecSet = SearchQueryItem(Query, CacheP);
+    // cached result is shared, work on a copy
+    if (CacheP) { RecSet = RecSet->Clone(); }
     // get the aggregates
     Aggr(RecSet, Query->GetAggrItemV());
     // sort if necessary
@@ -7249,18 +9575,43 @@ PRecSet TBase::Search(const PQuery& Query) {
 }
 
 PRecSet TBase::Search(const TQueryItem& QueryItem) {
+    // query is parsed against index vocabulary
+    TReadScope ReadScope(this);
     return Search(TQuery::New(this, QueryItem));
 }
 
 PRecSet TBase::Search(const TStr& QueryStr) {
+    // query is parsed against index vocabulary
+    TReadScope ReadScope(this);
     return Search(TQuery::New(this, QueryStr));
 }
 
 PRecSet TBase::Search(const PJsonVal& QueryVal) {
+    // query is parsed against index vocabulary
+    TReadScope ReadScope(this);
     return Search(TQuery::New(this, QueryVal));
 }
 
+void TBase::SetQueryCache(const uint64& MxMemUsed) {
+    TWriteScope WriteScope(this);
+    QueryCache = (MxMemUsed > 0) ? TQueryCache::New(MxMemUsed) : PQueryCache();
+}
+
+PJsonVal TBase::Explain(const PQuery& Query) {
+    TReadScope ReadScope(this);
+    TQueryItem QueryItem = Query->GetQueryItem();
+    QueryItem.Plan(this);
+    return QueryItem.GetPlanJson(this);
+}
+
+PJsonVal TBase::Explain(const PJsonVal& QueryVal) {
+    // query is parsed against index vocabulary
+    TReadScope ReadScope(this);
+    return Explain(TQuery::New(this, QueryVal));
+}
+
 void TBase::GarbageCollect(const int& MxTimeMSecs) {
+    TWriteScope WriteScope(this);
     int StoreKeyId = StoreH.FFirstKeyId();
     while (StoreH.FNextKeyId(StoreKeyId)) {
         StoreH[StoreKeyId]->GarbageCollect(MxTimeMSecs);
@@ -7268,6 +9619,70 @@ void TBase::GarbageCollect(const int& MxTimeMSecs) {
 }
 
 int TBase::PartialFlush(const int& WndInMsec) {
+    TWriteScope WriteScope(this);
+    // committed log makes all the changes so far durable
+    if (!Wal.Empty()) { Wal->Commit(); }
+    const int Saved = PartialFlushData(WndInMsec);
+    if (!Wal.Empty() && Wal->IsCheckpointDue()) { Checkpoint(); }
+    return Saved;
+}
+
+void TBase::Checkpoint() {
+    QmAssertR(!Wal.Empty(), "Base has no write-ahead log");
+    QmAssertR(!Wal->IsReplay(), "Checkpoint can not be taken while replaying write-ahead log");
+    // replaying an entry which is already in the saved files would apply it twice, so
+    // no changes are allowed from taking the sequence number until the log is truncated;
+    // in non-concurrent mode the flusher lock keeps away all mutations, since they hold flush scopes
+    TWriteScope WriteScope(this);
+    TBaseFlusherLock FlushLock(Flusher);
+    TEnv::Logger->OnStatus("Saving base for write-ahead log checkpoint ...");
+    Wal->Commit();
+    const uint64 CheckpointLsn = Wal->GetLsn();
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        GetStoreByStoreN(StoreN)->Flush();
+    }
+    Index->Flush();
+    StoreBlobBs->Flush();
+    {
+        TFOut IndexVocFOut(FPath + "IndexVoc.dat");
+        IndexVoc->Save(IndexVocFOut);
+    }
+    SaveBaseConf(FPath);
+    SaveStoreList();
+    Wal->Checkpoint(CheckpointLsn);
+    // files of the previous checkpoint are no longer needed for recovery
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        GetStoreByStoreN(StoreN)->EndCheckpoint(CheckpointLsn);
+    }
+    Index->EndCheckpoint(CheckpointLsn);
+    StoreBlobBs->EndCheckpoint();
+}
+
+void TBase::SetWal(const PWal& _Wal) {
+    Wal = _Wal;
+    if (FAccess == faRdOnly) { return; }
+    const uint64 CheckpointLsn = Wal->GetCheckpointLsn();
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        GetStoreByStoreN(StoreN)->EnableCheckpoints(CheckpointLsn);
+    }
+    Index->EnableCheckpoints(CheckpointLsn);
+    StoreBlobBs->EnableCheckpoints();
+}
+
+void TBase::SaveStoreList() const {
+    PJsonVal StoresVal = TJsonVal::NewArr();
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        const TWPt<TStore> Store = GetStoreByStoreN(StoreN);
+        PJsonVal StoreVal = TJsonVal::NewObj();
+        StoreVal->AddToObj("name", Store->GetStoreNm());
+        StoreVal->AddToObj("type", Store->GetStoreType());
+        StoresVal->AddToArr(StoreVal);
+    }
+    PJsonVal RootVal = TJsonVal::NewObj("stores", StoresVal);
+    RootVal->SaveStr().SaveTxt(FPath + "StoreList.json");
+}
+
+int TBase::PartialFlushData(const int& WndInMsec) {
     int DirtyStores = (GetStores() + 1);
     int Saved = 100;
     int TotalSaved = 0;
@@ -7276,8 +9691,11 @@ int TBase::PartialFlush(const int& WndInMsec) {
     TVec<TPair<TWPt<TStore>, bool>> DirtyStoreV;
     bool FlushIndex = true;
 
-    for (int i = 0; i < GetStores(); i++) {
-        DirtyStoreV.Add(TPair<TWPt<TStore>, bool>(GetStoreByStoreN(i), true));
+    {
+        TBaseFlusherLock FlushLock(Flusher);
+        for (int i = 0; i < GetStores(); i++) {
+            DirtyStoreV.Add(TPair<TWPt<TStore>, bool>(GetStoreByStoreN(i), true));
+        }
     }
 
     while (Saved > 0) {
@@ -7291,7 +9709,11 @@ int TBase::PartialFlush(const int& WndInMsec) {
         for (int i = 0; i < DirtyStoreV.Len(); i++) {
             if (!DirtyStoreV[i].Val2)
                 continue; // this store had no dirty data in previous loop
-            xsaved = DirtyStoreV[i].Val1->PartialFlush(TimeSliceMs);
+            {
+                // lock each store separately so ingest can continue in between
+                TBaseFlusherLock FlushLock(Flusher);
+                xsaved = DirtyStoreV[i].Val1->PartialFlush(TimeSliceMs);
+            }
             if (xsaved == 0) {
                 DirtyStoreV[i].Val2 = false; // ok, this store is clean now
             } else {
@@ -7301,7 +9723,10 @@ int TBase::PartialFlush(const int& WndInMsec) {
             TQm::TEnv::Debug->OnStatusFmt("Partial flush:     store %s = %d", DirtyStoreV[i].Val1->GetStoreNm().CStr(), xsaved);
         }
         if (FlushIndex) { // save index
-            xsaved = Index->PartialFlush(TimeSliceMs);
+            {
+                TBaseFlusherLock FlushLock(Flusher);
+                xsaved = Index->PartialFlush(TimeSliceMs);
+            }
             FlushIndex = (xsaved > 0);
             if (FlushIndex) {
                 DirtyStores++;
@@ -7318,6 +9743,42 @@ int TBase::PartialFlush(const int& WndInMsec) {
     return TotalSaved;
 }
 
+void TBase::EnableConcurrency() {
+    if (ConcurrentP) { return; }
+    // flusher picks its locking when taking the lock
+    QmAssertR(Flusher.Empty(), "Concurrency must be enabled before starting the flusher");
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        GetStoreByStoreN(StoreN)->EnableConcurrency();
+    }
+    ConcurrentP = true;
+}
+
+void TBase::StartFlusher(const int& TickMSecs, const int& SliceMSecs, const uint64& MxDirtyBytes) {
+    QmAssertR(!IsRdOnly(), "Flusher not supported for read-only base");
+    QmAssertR(Flusher.Empty(), "Flusher already running");
+    Flusher = new TBaseFlusher(this, TickMSecs, SliceMSecs, MxDirtyBytes);
+    Index->SetFlusher(Flusher);
+    Flusher->Start();
+}
+
+void TBase::StopFlusher() {
+    if (Flusher.Empty()) { return; }
+    Flusher->Stop();
+    Index->SetFlusher(NULL);
+    Flusher.Clr();
+}
+
+uint64 TBase::GetDirtyBytes() {
+    uint64 DirtyBytes = 0;
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        TBaseFlusherLock FlushLock(Flusher);
+        DirtyBytes += GetStoreByStoreN(StoreN)->GetDirtyBytes();
+    }
+    TBaseFlusherLock FlushLock(Flusher);
+    DirtyBytes += Index->GetDirtyBytes();
+    return DirtyBytes;
+}
+
 bool TBase::SaveJSonDump(const TStr& DumpDir) {
     TStrSet SeenJoinsH;
 
@@ -7394,6 +9855,7 @@ bool TBase::RestoreJSonDump(const TStr& DumpDir) {
     TTm CurrentTime = TTm::GetCurLocTm();
 
     THash<TStr, THash<TUInt64, TUInt64> > StoreOldToNewIdHH;
+    uint64 AddedRecs = 0;
     for (int S = 0; S < Stores; S++) {
         PStore Store = GetStoreByStoreN(S);
         const TStr StoreNm = Store->GetStoreNm();
@@ -7401,20 +9863,27 @@ bool TBase::RestoreJSonDump(const TStr& DumpDir) {
         TQm::TEnv::Logger->OnStatusFmt("Adding recs for store %s", StoreNm.CStr());
         if (TFile::Exists(DumpDir + StoreNm + ".json")) {
             PSIn InRecs = TFIn::New(DumpDir + StoreNm + ".json");
+            // records are added in batches, which group inverted index updates
+            const int BatchLen = 1000;
+            TVec<PJsonVal> JsonV(BatchLen, 0);
+            TUInt64V ExRecIdV(BatchLen, 0);
+            auto AddBatch = [&]() {
+                TUInt64V RecIdV; Store->AddRecs(JsonV, RecIdV);
+                AddedRecs += RecIdV.Len();
+                for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+                    OldToNewIdH.AddDat(ExRecIdV[RecN], RecIdV[RecN]);
+                }
+                JsonV.Clr(false); ExRecIdV.Clr(false);
+            };
             TStr Line;
             while (InRecs->GetNextLn(Line)) {
                 const PJsonVal Json = TJsonVal::GetValFromStr(Line);
-                const uint64 ExRecId = Json->IsObjKey("$id") ? (uint64)Json->GetObjNum("$id") : TUInt64::Mx;
+                ExRecIdV.Add(Json->IsObjKey("$id") ? (uint64)Json->GetObjNum("$id") : TUInt64::Mx);
                 Json->DelObjKey("$id");
-                const uint64 RecId = Store->AddRec(Json);
-                OldToNewIdH.AddDat(ExRecId, RecId);
-                // validate that the added rec id is the same as the one that was saved in json
-                // if this fails then we have a problem since the joins will point different records than in the original data
-                //AssertR(ExRecId == TUInt64::Mx || ExRecId == RecId, "The added record id does not match the one in the record json");
-                if (RecId % 1000 == 0) {
-                    TQm::TEnv::Logger->OnStatusFmt("Added record %I64u\r", RecId);
-                }
+                JsonV.Add(Json);
+                if (JsonV.Len() == BatchLen) { AddBatch(); }
             }
+            if (!JsonV.Empty()) { AddBatch(); }
         } else {
             TQm::TEnv::Logger->OnStatusFmt("WARNING: File for store %s is missing. No data was imported.", StoreNm.CStr());
         }
@@ -7503,11 +9972,196 @@ bool TBase::RestoreJSonDump(const TStr& DumpDir) {
 
     uint64 DiffSecs = TTm::GetDiffSecs(TTm::GetCurLocTm(), CurrentTime);
     int Mins = (int)(DiffSecs / 60);
+    TQm::TEnv::Logger->OnStatusFmt("Added %I64u records", AddedRecs);
     TQm::TEnv::Logger->OnStatusFmt("Time needed to make the restore: %d min, %d sec", Mins, (int)(DiffSecs - (Mins * 60)));
 
     return true;
 }
 
+void TBase::SaveBinDump(const TStr& DumpDir) {
+    // writers must not change stores and joins while they are dumped
+    TReadScope ReadScope(this);
+    // check all stores first, so we do not leave a partial dump behind
+    TStrV NoDumpStoreNmV;
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        const TWPt<TStore> Store = GetStoreByStoreN(StoreN);
+        if (!Store->IsBinDump()) { NoDumpStoreNmV.Add(Store->GetStoreNm()); }
+    }
+    QmAssertR(NoDumpStoreNmV.Empty(), "Binary dump not supported by stores: " +
+        TStr::GetStr(NoDumpStoreNmV, ", "));
+    TTmStopWatch StopWatch(true);
+    TStrSet SeenJoinsH;
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        const TWPt<TStore> Store = GetStoreByStoreN(StoreN);
+        const TStr& StoreNm = Store->GetStoreNm();
+        TQm::TEnv::Logger->OnStatusFmt("Dumping store %s", StoreNm.CStr());
+        {
+            TFOut RecOut(DumpDir + StoreNm + ".qdump");
+            TBinDump::SaveHeader(RecOut);
+            Store->SaveBinDump(RecOut);
+        }
+        // field joins are part of the records, index joins are dumped by name,
+        // skipping the ones already dumped through their inverse join
+        TFOut JoinOut(DumpDir + StoreNm + "-joins.qdump");
+        TBinDump::SaveHeader(JoinOut);
+        for (int JoinId = 0; JoinId < Store->GetJoins(); JoinId++) {
+            const TJoinDesc& JoinDesc = Store->GetJoinDesc(JoinId);
+            if (!JoinDesc.IsIndexJoin()) { continue; }
+            if (JoinDesc.IsInverseJoinId()) {
+                const TWPt<TStore> InvStore = JoinDesc.GetJoinStore(this);
+                const TJoinDesc& InvJoinDesc = InvStore->GetJoinDesc(JoinDesc.GetInverseJoinId());
+                if (SeenJoinsH.IsKey(InvStore->GetStoreNm() + "-" + InvJoinDesc.GetJoinNm())) { continue; }
+            }
+            SeenJoinsH.AddKey(StoreNm + "-" + JoinDesc.GetJoinNm());
+            JoinDesc.GetJoinNm().Save(JoinOut);
+            TMOut BlockOut; int BlockRecs = 0;
+            PStoreIter Iter = Store->GetIter();
+            while (Iter->Next()) {
+                const uint64 RecId = Iter->GetRecId();
+                TUInt64IntKdV JoinRecIdFqV;
+                Index->SearchGixJoin(JoinDesc.GetJoinKeyId(), RecId, JoinRecIdFqV);
+                if (JoinRecIdFqV.Empty()) { continue; }
+                TUInt64(RecId).Save(BlockOut);
+                JoinRecIdFqV.Save(BlockOut);
+                BlockRecs++;
+                if (BlockOut.Len() >= TBinDump::BlockBytes) {
+                    TBinDump::SaveBlock(JoinOut, BlockRecs, BlockOut);
+                    BlockOut.Clr(); BlockRecs = 0;
+                }
+            }
+            if (BlockRecs > 0) { TBinDump::SaveBlock(JoinOut, BlockRecs, BlockOut); }
+            TBinDump::SaveEnd(JoinOut);
+        }
+        // empty join name marks the end
+        TStr().Save(JoinOut);
+    }
+    TQm::TEnv::Logger->OnStatusFmt("Binary dump saved in %d msecs", StopWatch.GetMSecInt());
+}
+
+void TBase::RestoreBinDump(const TStr& DumpDir) {
+    QmAssertR(!IsWal(), "Binary dump can not be restored into base with write-ahead log");
+    TWriteScope WriteScope(this);
+    TTmStopWatch StopWatch(true);
+    // stores with dump files
+    TIntV StoreNV;
+    for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
+        const TStr& StoreNm = GetStoreByStoreN(StoreN)->GetStoreNm();
+        if (TFile::Exists(DumpDir + StoreNm + ".qdump")) {
+            StoreNV.Add(StoreN);
+        } else {
+            TQm::TEnv::Logger->OnStatusFmt("WARNING: File for store %s is missing. No data was imported.", StoreNm.CStr());
+        }
+    }
+    // first record in the dump and in the restored store, for mapping record ids
+    TVec<TUInt64Pr> FirstRecIdPrV(StoreNV.Len());
+    TCriticalSection SharedSection;
+    TStr ErrorMsg;
+    // background flusher excludes other threads while one is writing, so
+    // stores are restored one after another when it is running
+    const bool ParallelP = Flusher.Empty() && StoreNV.Len() > 1;
+    // linear indexes are built in bulk once all records are in
+    Index->StartLinearBatch();
+    #pragma omp parallel for schedule(dynamic) if(ParallelP)
+    for (int StoreNN = 0; StoreNN < StoreNV.Len(); StoreNN++) {
+        try {
+            const TWPt<TStore> Store = GetStoreByStoreN(StoreNV[StoreNN]);
+            const TStr FNm = DumpDir + Store->GetStoreNm() + ".qdump";
+            TFIn RecIn(FNm);
+            TBinDump::LoadHeader(RecIn, FNm);
+            uint64 DumpFirstRecId, FirstRecId;
+            Store->RestoreBinDump(RecIn, SharedSection, DumpFirstRecId, FirstRecId);
+            FirstRecIdPrV[StoreNN] = TUInt64Pr(DumpFirstRecId, FirstRecId);
+        } catch (const PExcept& Except) {
+            // exceptions can not leave the parallel region
+            #pragma omp critical
+            { if (ErrorMsg.Empty()) { ErrorMsg = Except->GetMsgStr(); } }
+        }
+    }
+    Index->EndLinearBatch();
+    // cached results over restored stores are out of date, also when restore failed half way
+    for (int StoreNN = 0; StoreNN < StoreNV.Len(); StoreNN++) {
+        Index->TouchStore(GetStoreByStoreN(StoreNV[StoreNN])->GetStoreId());
+    }
+    if (!ErrorMsg.Empty()) { throw TQmExcept::New(ErrorMsg); }
+    // record ids are shifted by the difference of the first ids
+    THash<TUInt, TUInt64> StoreIdToShiftH;
+    for (int StoreNN = 0; StoreNN < StoreNV.Len(); StoreNN++) {
+        const uint StoreId = GetStoreByStoreN(StoreNV[StoreNN])->GetStoreId();
+        const TUInt64Pr& FirstRecIdPr = FirstRecIdPrV[StoreNN];
+        const bool EmptyP = FirstRecIdPr.Val2 == TUInt64::Mx;
+        StoreIdToShiftH.AddDat(StoreId, EmptyP ? 0 : FirstRecIdPr.Val2 - FirstRecIdPr.Val1);
+    }
+
+    for (int StoreNN = 0; StoreNN < StoreNV.Len(); StoreNN++) {
+        const TWPt<TStore> Store = GetStoreByStoreN(StoreNV[StoreNN]);
+        const TStr& StoreNm = Store->GetStoreNm();
+        const uint64 RecShift = StoreIdToShiftH.GetDat(Store->GetStoreId());
+        // field joins point to records by id, move them along with the joined store
+        for (int JoinId = 0; JoinId < Store->GetJoins(); JoinId++) {
+            const TJoinDesc& JoinDesc = Store->GetJoinDesc(JoinId);
+            if (!JoinDesc.IsFieldJoin() || !StoreIdToShiftH.IsKey(JoinDesc.GetJoinStoreId())) { continue; }
+            const uint64 JoinRecShift = StoreIdToShiftH.GetDat(JoinDesc.GetJoinStoreId());
+            if (JoinRecShift == 0) { continue; }
+            const int JoinRecFieldId = JoinDesc.GetJoinRecFieldId();
+            PStoreIter Iter = Store->GetIter();
+            while (Iter->Next()) {
+                const uint64 RecId = Iter->GetRecId();
+                if (Store->IsFieldNull(RecId, JoinRecFieldId)) { continue; }
+                const uint64 JoinRecId = Store->GetFieldUInt64Safe(RecId, JoinRecFieldId);
+                Store->SetFieldUInt64Safe(RecId, JoinRecFieldId, JoinRecId + JoinRecShift);
+            }
+        }
+        // index joins
+        const TStr FNm = DumpDir + StoreNm + "-joins.qdump";
+        if (!TFile::Exists(FNm)) { continue; }
+        TQm::TEnv::Logger->OnStatusFmt("Adding joins for store %s", StoreNm.CStr());
+        TFIn JoinIn(FNm);
+        TBinDump::LoadHeader(JoinIn, FNm);
+        TStr JoinNm(JoinIn);
+        while (!JoinNm.Empty()) {
+            // joins missing in the new schema are skipped
+            const bool JoinP = Store->IsJoinNm(JoinNm) && Store->GetJoinDesc(JoinNm).IsIndexJoin() &&
+                StoreIdToShiftH.IsKey(Store->GetJoinDesc(JoinNm).GetJoinStoreId());
+            if (!JoinP) {
+                TQm::TEnv::Logger->OnStatusFmt("WARNING: Ignoring join %s of store %s.", JoinNm.CStr(), StoreNm.CStr());
+            }
+            const int JoinId = JoinP ? Store->GetJoinId(JoinNm) : -1;
+            const TJoinDesc JoinDesc = JoinP ? Store->GetJoinDesc(JoinId) : TJoinDesc();
+            TMem BlockMem; int BlockRecs;
+            Index->StartBatch();
+            try {
+                while ((BlockRecs = TBinDump::LoadBlock(JoinIn, BlockMem)) > 0) {
+                    if (!JoinP) { continue; }
+                    const uint64 JoinRecShift = StoreIdToShiftH.GetDat(JoinDesc.GetJoinStoreId());
+                    const TWPt<TStore> JoinStore = JoinDesc.GetJoinStore(this);
+                    const int InvJoinId = JoinDesc.GetInverseJoinId();
+                    const bool InvIndexJoinP = JoinDesc.IsInverseJoinId() &&
+                        JoinStore->GetJoinDesc(InvJoinId).IsIndexJoin();
+                    TMIn BlockIn(BlockMem.GetBf(), BlockMem.Len(), false);
+                    for (int RecN = 0; RecN < BlockRecs; RecN++) {
+                        const uint64 RecId = TUInt64(BlockIn) + RecShift;
+                        TUInt64IntKdV JoinRecIdFqV; JoinRecIdFqV.Load(BlockIn);
+                        for (const TUInt64IntKd& JoinRecIdFq : JoinRecIdFqV) {
+                            const uint64 JoinRecId = JoinRecIdFq.Key + JoinRecShift;
+                            Index->IndexJoin(Store, JoinId, RecId, JoinRecId, JoinRecIdFq.Dat);
+                            // inverse field joins are already part of the records
+                            if (InvIndexJoinP) {
+                                Index->IndexJoin(JoinStore, InvJoinId, JoinRecId, RecId, JoinRecIdFq.Dat);
+                            }
+                        }
+                    }
+                }
+            } catch (const PExcept& Except) {
+                Index->EndBatch();
+                throw;
+            }
+            Index->EndBatch();
+            JoinNm.Load(JoinIn);
+        }
+    }
+    TQm::TEnv::Logger->OnStatusFmt("Binary dump restored in %d msecs", StopWatch.GetMSecInt());
+}
+
 void TBase::PrintStores(const TStr& FNm, const bool& FullP) {
     TFOut FOut(FNm);
     for (int StoreN = 0; StoreN < GetStores(); StoreN++) {
@@ -7562,6 +10216,9 @@ PJsonVal TBase::GetStats() {
     Res->AddToObj("gix_stats", GixStatsToJson(gix_stats));
     Res->AddToObj("gix_blob", BlobBsStatsToJson(gix_blob_stats));
     Res->AddToObj("access", GetFAccess());
+    if (!Wal.Empty()) { Res->AddToObj("wal", Wal->GetStats()); }
+    if (!Flusher.Empty()) { Res->AddToObj("flusher", Flusher->GetStats()); }
+    if (!QueryCache.Empty()) { Res->AddToObj("query_cache", QueryCache->GetStats()); }
     return Res;
 }
 
@@ -11,6 +11,7 @@
 
 #include <base.h>
 #include <mine.h>
+#include <thread.h>
 
 namespace TQm {
 
@@ -20,8 +21,14 @@ class TBase; typedef TPt<TBase> PBase;
 class TStore; typedef TPt<TStore> PStore;
 class TRec;
 class TRecSet; typedef TPt<TRecSet> PRecSet;
+class TRecBuilder;
+class TWal; typedef TPt<TWal> PWal;
+class TWalCommitter; typedef TPt<TWalCommitter> PWalCommitter;
+class TBaseFlusher; typedef TPt<TBaseFlusher> PBaseFlusher;
+class TQueryCache; typedef TPt<TQueryCache> PQueryCache;
 class TIndexVoc; typedef TPt<TIndexVoc> PIndexVoc;
 class TIndex; typedef TPt<TIndex> PIndex;
+class TIndexBatch;
 class TAggr; typedef TPt<TAggr> PAggr;
 class TStreamAggr; typedef TPt<TStreamAggr> PStreamAggr;
 class TRecFilter; typedef TPt<TRecFilter> PRecFilter;
@@ -287,11 +294,17 @@ public:
     TBool InsertP;
     /// Name of the field that serves as time-window indicator
     TStr TimeFieldNm;
+    /// For time window split into segments, segment length in milliseconds (0 when not split).
+    /// Segments are supported only for stores without joins and without linear and location keys.
+    TUInt64 SegmentSize;
 
 public:
     TStoreWndDesc() : WindowType(swtNone) { }
     TStoreWndDesc(TSIn& SIn) { Load(SIn); }
 
+    /// Are records grouped into time segments which expire as a whole
+    bool IsSegmented() const { return WindowType == swtTime && SegmentSize > 0; }
+
     void Save(TSOut& SOut) const;
     void Load(TSIn& SIn);
 };
@@ -567,6 +580,118 @@ public:
     uint64 GetRecId() const { return Hash.GetKey(KeyId); }
 };
 
+///////////////////////////////
+/// Write-ahead log operation types
+typedef enum {
+    wotAddRec = 0,      ///< new record, value is record JSon
+    wotUpdateRec = 1,   ///< record update, value is {"$id": record id, "rec": fields JSon}
+    wotDelRecs = 2,     ///< deleted records, value is {"ids": [record ids]}
+    wotDelAllRecs = 3,  ///< all records deleted from the store
+    wotAddJoin = 4,     ///< new join, value is {"join": join id, "$id": record id, "join$id": join record id, "fq": frequency}
+    wotDelJoin = 5,     ///< deleted join, value same as for wotAddJoin
+    wotAddStores = 6,   ///< new stores, value is {"schema": store schema, "cacheSize": default store cache size}
+    wotDropSegments = 7 ///< dropped time segments, value is {"before": id of the first kept record}
+} TWalOpType;
+
+///////////////////////////////
+/// Write-ahead log scope.
+/// Marks a top-level mutation of the base. Only top-level mutations are written
+/// to the log, mutations they cause internally (e.g. nested join records, updates
+/// of join fields) are reproduced when the log is replayed. Nothing is logged when
+/// the base has no write-ahead log or when the log is being replayed.
+class TWalScope {
+private:
+    /// Write-ahead log of the base, NULL when none
+    TWal* Wal;
+    /// True when this is the top-level scope
+    bool LogP;
+
+public:
+    TWalScope(const TWPt<TBase>& Base);
+    ~TWalScope();
+
+    /// Should the mutation in this scope be logged
+    bool IsLog() const { return LogP; }
+    /// Log the mutation, if this is a top-level scope, and close the scope
+    void Log(const TWalOpType& OpType, const uint& StoreId, const PJsonVal& Val);
+};
+
+///////////////////////////////
+/// Flush scope.
+/// Holds the lock of the background flusher for the lifetime of the scope, so data
+/// read or changed in the scope is not written to disk at the same time. Scopes can
+/// be nested. Top-level scope of an ingest operation can be throttled, in which case
+/// it first waits for the flusher while there is too much dirty data. Does nothing
+/// when the base has no background flusher.
+class TFlushScope {
+private:
+    /// Background flusher of the base, NULL when none
+    TBaseFlusher* Flusher;
+
+public:
+    TFlushScope(const TWPt<TBaseFlusher>& _Flusher, const bool& ThrottleP = false);
+    ~TFlushScope();
+};
+
+///////////////////////////////
+/// Read scope.
+/// Holds the base lock for reading for the lifetime of the scope, when the base is
+/// in concurrent mode. Any number of threads can be in read scopes at the same time,
+/// while a write scope waits for all of them to leave. Scopes can be nested, also
+/// inside a write scope of the same thread. Does nothing when base is not concurrent.
+class TReadScope {
+private:
+    /// Lock of the base, NULL when base is not concurrent
+    TRWLock* Lock;
+
+public:
+    TReadScope(const TWPt<TBase>& Base);
+    ~TReadScope();
+};
+
+///////////////////////////////
+/// Write scope.
+/// Holds the base lock for writing for the lifetime of the scope, when the base is
+/// in concurrent mode. Taken by all operations changing stores or the index. Scopes
+/// can be nested, but not inside a read scope. Does nothing when base is not concurrent.
+class TWriteScope {
+private:
+    /// Lock of the base, NULL when base is not concurrent
+    TRWLock* Lock;
+
+public:
+    TWriteScope(const TWPt<TBase>& Base);
+    ~TWriteScope();
+};
+
+///////////////////////////////
+/// Binary dump blocks.
+/// Binary dump files start with a header and hold data in blocks. Each block is
+/// saved with the number of items, its length and a checksum, which is verified
+/// when the block is loaded. Zero items mark the end of the blocks.
+class TBinDump {
+private:
+    /// Magic string at the start of each dump file
+    static const TStr MagicStr;
+    /// Version of the dump format
+    static const int Version;
+
+public:
+    /// Size after which writers should close the current block
+    static const int BlockBytes;
+
+    /// Save file header
+    static void SaveHeader(TSOut& SOut);
+    /// Load and check file header
+    static void LoadHeader(TSIn& SIn, const TStr& FNm);
+    /// Save block holding given number of items
+    static void SaveBlock(TSOut& SOut, const int& Items, const TMOut& BlockOut);
+    /// Save end of blocks
+    static void SaveEnd(TSOut& SOut) { TInt(0).Save(SOut); }
+    /// Load next block, returns number of items in it or 0 at the end of blocks
+    static int LoadBlock(TSIn& SIn, TMem& BlockMem);
+};
+
 ///////////////////////////////
 /// Store Trigger.
 /// Interface for defining triggers called when records are added, deleted or updated.
@@ -590,6 +715,9 @@ public:
     virtual void OnUpdate(const TRec& Rec) = 0;
     /// Called before record from the store
     virtual void OnDelete(const TRec& Rec) = 0;
+    /// Called before a batch of records is deleted from the store. Default
+    /// implementation calls OnDelete for each record in the set.
+    virtual void OnDeleteRecs(const PRecSet& RecSet);
 
     /// Unique ID of the trigger
     const TStr& GetGuid() const { return Guid; }
@@ -664,12 +792,18 @@ protected:
     int AddFieldDesc(const TFieldDesc& FieldDesc);
     /// Default error when accessing wrong field-type combination
     PExcept FieldError(const int& FieldId, const TStr& TypeStr) const;
+    /// Mark store as modified, which invalidates cached query results reading its records.
+    /// Called by OnAdd, OnUpdate and OnDelete, and by AddRec when it skips the triggers.
+    void TouchStore();
 
 public:
     /// Should be called after record RecId added; executes OnAdd event in all registered triggers
     void OnAdd(const uint64& RecId);
     /// Should be called after record Rec added; executes OnAdd event in all registered triggers
     void OnAdd(const TRec& Rec);
+    /// Should be called after a batch of records added; executes OnAdd event for each
+    /// record in all registered triggers, keeping the record-by-record order
+    void OnAdd(const TUInt64V& RecIdV);
     /// Should be called after record RecId updated; executes OnUpdate event in all registered triggers
     void OnUpdate(const uint64& RecId);
     /// Should be called after record Rec updated; executes OnUpdate event in all registered triggers
@@ -678,6 +812,9 @@ public:
     void OnDelete(const uint64& RecId);
     /// Should be called before record Rec deleted; executes OnDelete event in all registered triggers
     void OnDelete(const TRec& Rec);
+    /// Should be called before a batch of records deleted; executes OnDeleteRecs event
+    /// in all registered triggers, each trigger receiving the whole batch at once
+    void OnDelete(const TUInt64V& RecIdV);
 
 protected:
     /// Helper function for handling string and vector pools
@@ -690,6 +827,19 @@ protected:
     /// Processing nested join records in JSon
     void AddJoinRec(const uint64& RecId, const PJsonVal& RecVal);
 
+    /// Check if base write-ahead log is being replayed
+    bool IsWalReplay() const;
+    /// Write record update to the base write-ahead log
+    void WalUpdateRec(const uint64& RecId, const PJsonVal& RecVal);
+    /// Write field update to the base write-ahead log, to be called at the end of field setters
+    void WalSetField(const uint64& RecId, const int& FieldId);
+    /// Write record added from record builder to the base write-ahead log, including the insert time set by the store
+    void WalAddRec(TWalScope& WalScope, const uint64& RecId, const TRecBuilder& Rec);
+    /// Write deletion of the first DelRecs records from DelRecIdV to the base write-ahead log
+    void WalDelRecs(TWalScope& WalScope, const TUInt64V& DelRecIdV, const int& DelRecs);
+    /// Parameters of join operation for the base write-ahead log
+    static PJsonVal GetWalJoinVal(const int& JoinId, const uint64& RecId, const uint64& JoinRecId, const int& JoinFq);
+
 public:
     /// Get store ID
     uint GetStoreId() const { return StoreId; }
@@ -751,6 +901,8 @@ public:
     void AddTrigger(const PStoreTrigger& Trigger);
     /// Unregister given trigger
     void DelTrigger(const PStoreTrigger& Trigger);
+    /// True when at least one trigger is registered
+    bool HasTriggers() const { return !TriggerV.Empty(); }
 
     /// True when records have names (default is false)
     virtual bool HasRecNm() const { return false; }
@@ -797,11 +949,31 @@ public:
     virtual bool HasFirstRecId() const { return false; }
     /// Is the last record id getter implemented?
     virtual bool HasLastRecId() const { return false; }
+    /// Does the store keep fields in columns and implement GetFieldFltV and FilterByFieldFlt?
+    virtual bool HasColumnScan() const { return false; }
+
+    /// Read numeric field values of given records directly from the field column.
+    /// NULL values are returned as 0.0, same as from TFieldReader::GetFlt.
+    virtual void GetFieldFltV(const TUInt64IntKdV& RecIdFqV, const int& FieldId, TFltV& FltV) const {
+        throw TQmExcept::New("Store " + GetStoreNm() + " does not support column scans"); }
+    /// Keep only records with numeric field value within [MinVal, MaxVal], comparing values
+    /// directly in the field column. Records with NULL value are removed.
+    virtual void FilterByFieldFlt(const int& FieldId, const double& MinVal, const double& MaxVal,
+        TUInt64IntKdV& RecIdFqV) const {
+            throw TQmExcept::New("Store " + GetStoreNm() + " does not support column scans"); }
 
     /// Add new record provided as JSon
     virtual uint64 AddRec(const PJsonVal& RecVal, const bool& TriggerEvents = true) = 0;
     /// Update existing record with updates in provided JSon
     virtual void UpdateRec(const uint64& RecId, const PJsonVal& RecVal) = 0;
+    /// Add a batch of records provided as JSon. Inverted index updates of the whole batch
+    /// are grouped per (KeyId, WordId) and applied together, triggers are executed after
+    /// the batch is indexed. Ids of the records are returned in RecIdV. Records are added
+    /// one at a time through AddRec, stores can override this to also store them together.
+    virtual void AddRecs(const TVec<PJsonVal>& RecValV, TUInt64V& RecIdV, const bool& TriggerEvents = true);
+    /// Add new record provided by a record builder. Default implementation goes
+    /// through JSon, stores override it to serialize the builder directly.
+    virtual uint64 AddRec(const TRecBuilder& Rec, const bool& TriggerEvents = true);
 
     /// Add join
     void AddJoin(const int& JoinId, const uint64& RecId, const uint64 JoinRecId, const int& JoinFq = 1);
@@ -997,6 +1169,9 @@ public:
 
     /// Get field value as JSon object using field id
     virtual PJsonVal GetFieldJson(const uint64& RecId, const int& FieldId) const;
+    /// Add values of several fields of a record to a JSon object, skipping null fields.
+    /// Stores which keep records serialized read the record only once for all fields.
+    virtual void GetFieldsJson(const uint64& RecId, const TIntV& FieldIdV, const PJsonVal& RecVal) const;
     /// Get field value as human-readable text using field id
     virtual TStr GetFieldText(const uint64& RecId, const int& FieldId) const;
     /// Get field value as JSon object using field name
@@ -1052,8 +1227,35 @@ public:
     /// Get codebook mappings for given string field
     virtual int GetCodebookId(const int& FieldId, const TStr& Str) const { throw TQmExcept::New("Not implemented"); }
 
+    /// Prepare the store for concurrent readers, called when base enters concurrent mode
+    virtual void EnableConcurrency() { throw TQmExcept::New("Store " + GetStoreNm() + " does not support concurrent readers"); }
+
+    /// Check if store supports binary dumps
+    virtual bool IsBinDump() const { return false; }
+    /// Save all records to binary dump, together with schema fingerprint used to check
+    /// the dump can be restored into another store
+    virtual void SaveBinDump(TSOut& SOut) const { throw TQmExcept::New("Store " + GetStoreNm() + " does not support binary dumps"); }
+    /// Restore records from binary dump into empty store, without calling triggers and
+    /// joins. Can be called in parallel for different stores, index and storage shared
+    /// between stores are only updated while holding SharedSection. Returns id of first
+    /// restored record in the dump and in the store.
+    virtual void RestoreBinDump(TSIn& SIn, TCriticalSection& SharedSection,
+            uint64& DumpFirstRecId, uint64& FirstRecId) {
+        throw TQmExcept::New("Store " + GetStoreNm() + " does not support binary dumps"); }
+
     /// Save part of the data, given time-window
     virtual int PartialFlush(int WndInMsec = 500) { throw TQmExcept::New("Not implemented"); }
+    /// Save all data and store state to disk, so store files are consistent while the
+    /// store stays open. Used for write-ahead log checkpoints.
+    virtual void Flush() { throw TQmExcept::New("Store " + GetStoreNm() + " does not support flushing"); }
+    /// Keep store files saved by the last Flush unchanged until the checkpoint after the
+    /// next one. Needed by stores which overwrite their files in place, others can ignore it.
+    virtual void EnableCheckpoints(const uint64& CheckpointLsn) { }
+    /// Release data kept for the previous checkpoint, once the last Flush is saved as
+    /// the checkpoint CheckpointLsn
+    virtual void EndCheckpoint(const uint64& CheckpointLsn) { }
+    /// Size of data changed since it was last flushed to disk
+    virtual uint64 GetDirtyBytes() { return 0; }
     /// Retrieve performance statistics for this store
     virtual PJsonVal GetStats() { return TJsonVal::NewObj(); }
     /// Run verification for whole store
@@ -1282,6 +1484,158 @@ public:
         const bool& JoinRecFieldsP = false, const bool& RecInfoP = true) const;
 };
 
+///////////////////////////////
+/// Record builder.
+/// Schema-bound row buffer for adding new records without going through JSon.
+/// Values are kept in typed slots, one vector per field type with one slot for
+/// each field of that type, and are encoded directly by the store's serializator.
+/// The builder can be reused for many records by calling Clr() between them,
+/// which keeps all the allocated buffers.
+/// Joins and references to existing records (via $id) are not supported, use
+/// the JSon interface for those.
+class TRecBuilder {
+private:
+    /// Field state
+    typedef enum { rbfsUnset = 0, rbfsNull = 1, rbfsSet = 2 } TFieldState;
+
+    /// Record store
+    TWPt<TStore> Store;
+    /// Field types, cached from the store schema
+    TIntV FieldTypeV;
+    /// Field states (unset, null or set)
+    TIntV FieldStateV;
+    /// Position of field value in the slot vector for its type
+    TIntV SlotNV;
+    /// Id of the system "inserted at" field, -1 when store does not have one
+    TInt InsertedAtFieldId;
+    /// Values of integer, boolean and time fields
+    TUInt64V NumV;
+    /// Values of floating point fields
+    TFltPrV FltV;
+    /// Values of string fields
+    TStrV StrV;
+    /// Values of vector fields
+    TVec<TIntV> IntVV;
+    TVec<TStrV> StrVV;
+    TVec<TFltV> FltVV;
+    TVec<TIntFltKdV> NumSpVV;
+    /// Values of memory buffer fields
+    TVec<TMem> MemV;
+    /// Values of JSon fields
+    TVec<PJsonVal> JsonV;
+
+    /// Get QMiner exception for requesting wrong field-type combinations
+    PExcept FieldError(const int& FieldId, const TStr& TypeStr) const;
+    /// Check field type and mark field as set
+    void SetField(const int& FieldId, const TFieldType& FieldType, const TStr& TypeStr);
+
+public:
+    /// Create an empty builder for records of the given store
+    explicit TRecBuilder(const TWPt<TStore>& _Store);
+
+    /// Get store for which the builder is creating records
+    const TWPt<TStore>& GetStore() const { return Store; }
+    /// Get number of fields
+    int GetFields() const { return FieldStateV.Len(); }
+    /// Id of the system "inserted at" field, -1 when store does not have one
+    int GetInsertedAtFieldId() const { return InsertedAtFieldId; }
+    /// Reset all fields to unset, keeps the allocated buffers
+    void Clr();
+
+    /// Checks if field value was set or set to null
+    bool IsFieldSet(const int& FieldId) const { return FieldStateV[FieldId] != rbfsUnset; }
+    /// Checks if field value is null
+    bool IsFieldNull(const int& FieldId) const { return FieldStateV[FieldId] == rbfsNull; }
+
+    /// Field value retrieval
+    uchar GetFieldByte(const int& FieldId) const { return (uchar)NumV[SlotNV[FieldId]].Val; }
+    /// Field value retrieval
+    int GetFieldInt(const int& FieldId) const { return (int)NumV[SlotNV[FieldId]].Val; }
+    /// Field value retrieval
+    int16 GetFieldInt16(const int& FieldId) const { return (int16)NumV[SlotNV[FieldId]].Val; }
+    /// Field value retrieval
+    int64 GetFieldInt64(const int& FieldId) const { return (int64)NumV[SlotNV[FieldId]].Val; }
+    /// Field value retrieval
+    const TIntV& GetFieldIntV(const int& FieldId) const { return IntVV[SlotNV[FieldId]]; }
+    /// Field value retrieval
+    uint GetFieldUInt(const int& FieldId) const { return (uint)NumV[SlotNV[FieldId]].Val; }
+    /// Field value retrieval
+    uint16 GetFieldUInt16(const int& FieldId) const { return (uint16)NumV[SlotNV[FieldId]].Val; }
+    /// Field value retrieval
+    uint64 GetFieldUInt64(const int& FieldId) const { return NumV[SlotNV[FieldId]].Val; }
+    /// Field value retrieval
+    const TStr& GetFieldStr(const int& FieldId) const { return StrV[SlotNV[FieldId]]; }
+    /// Field value retrieval
+    const TStrV& GetFieldStrV(const int& FieldId) const { return StrVV[SlotNV[FieldId]]; }
+    /// Field value retrieval
+    bool GetFieldBool(const int& FieldId) const { return NumV[SlotNV[FieldId]].Val != 0; }
+    /// Field value retrieval
+    double GetFieldFlt(const int& FieldId) const { return FltV[SlotNV[FieldId]].Val1; }
+    /// Field value retrieval
+    float GetFieldSFlt(const int& FieldId) const { return (float)FltV[SlotNV[FieldId]].Val1; }
+    /// Field value retrieval
+    const TFltPr& GetFieldFltPr(const int& FieldId) const { return FltV[SlotNV[FieldId]]; }
+    /// Field value retrieval
+    const TFltV& GetFieldFltV(const int& FieldId) const { return FltVV[SlotNV[FieldId]]; }
+    /// Field value retrieval
+    uint64 GetFieldTmMSecs(const int& FieldId) const { return NumV[SlotNV[FieldId]].Val; }
+    /// Field value retrieval
+    const TIntFltKdV& GetFieldNumSpV(const int& FieldId) const { return NumSpVV[SlotNV[FieldId]]; }
+    /// Field value retrieval
+    const TMem& GetFieldTMem(const int& FieldId) const { return MemV[SlotNV[FieldId]]; }
+    /// Field value retrieval
+    const PJsonVal& GetFieldJsonVal(const int& FieldId) const { return JsonV[SlotNV[FieldId]]; }
+
+    /// Set field value to NULL
+    void SetFieldNull(const int& FieldId);
+    /// Set field value
+    void SetFieldByte(const int& FieldId, const uchar& Byte);
+    /// Set field value
+    void SetFieldInt(const int& FieldId, const int& Int);
+    /// Set field value
+    void SetFieldInt16(const int& FieldId, const int16& Int16);
+    /// Set field value
+    void SetFieldInt64(const int& FieldId, const int64& Int64);
+    /// Set field value
+    void SetFieldIntV(const int& FieldId, const TIntV& IntV);
+    /// Set field value
+    void SetFieldUInt(const int& FieldId, const uint& UInt);
+    /// Set field value
+    void SetFieldUInt16(const int& FieldId, const uint16& UInt16);
+    /// Set field value
+    void SetFieldUInt64(const int& FieldId, const uint64& UInt64);
+    /// Set field value
+    void SetFieldStr(const int& FieldId, const TStr& Str);
+    /// Set field value
+    void SetFieldStrV(const int& FieldId, const TStrV& StrV);
+    /// Set field value
+    void SetFieldBool(const int& FieldId, const bool& Bool);
+    /// Set field value
+    void SetFieldFlt(const int& FieldId, const double& Flt);
+    /// Set field value
+    void SetFieldSFlt(const int& FieldId, const float& Flt);
+    /// Set field value
+    void SetFieldFltV(const int& FieldId, const TFltV& FltV);
+    /// Set field value
+    void SetFieldFltPr(const int& FieldId, const TFltPr& FltPr);
+    /// Set field value
+    void SetFieldTm(const int& FieldId, const TTm& Tm);
+    /// Set field value
+    void SetFieldTmMSecs(const int& FieldId, const uint64& TmMSecs);
+    /// Set field value
+    void SetFieldNumSpV(const int& FieldId, const TIntFltKdV& NumSpV);
+    /// Set field value
+    void SetFieldTMem(const int& FieldId, const TMem& Mem);
+    /// Set field value
+    void SetFieldJsonVal(const int& FieldId, const PJsonVal& Json);
+    /// Set value of any numeric, boolean or time field from a number. Time is
+    /// given as milliseconds since unix epoch, same as when provided in JSon.
+    void SetFieldNum(const int& FieldId, const double& Num);
+
+    /// Get record as JSon object, accepted by TStore::AddRec
+    PJsonVal GetJson() const;
+};
+
 ///////////////////////////////
 /// Record Comparator by Frequency. If same, sort by ID
 class TRecCmpByFq {
@@ -1807,6 +2161,25 @@ public:
     bool Filter(const TRec& Rec) const;
 };
 
+///////////////////////////////
+/// Record filter by string field using a codebook.
+/// Compares codebook ids instead of strings.
+class TRecFilterByFieldStrUsingCodebook : public TRecFilterByField {
+private:
+    /// Store with the codebook
+    TWPt<TStore> Store;
+    /// String value
+    const TStr StrVal;
+    /// Codebook id of the string value, -1 while it is not in the codebook
+    mutable TInt StrId;
+
+public:
+    /// Constructor
+    TRecFilterByFieldStrUsingCodebook(const TWPt<TBase>& _Base, const int& _FieldId, const TWPt<TStore>& _Store, const TStr& _StrVal, const bool& _FilterNullP = true);
+    /// Filter function
+    bool Filter(const TRec& Rec) const;
+};
+
 ///////////////////////////////
 /// Record filter by string field range.
 class TRecFilterByFieldStrRange : public TRecFilterByField {
@@ -2004,8 +2377,8 @@ public:
 /// Holds pointers to aggregates computed over records in the set.
 class TRecSet {
 private:
-    // smart-pointer
-    TCRef CRef;
+    // smart-pointer, results are shared by concurrent readers through the query cache
+    TAtomicCRef CRef;
     friend class TPt<TRecSet>;
 private:
     /// Store
@@ -2390,6 +2763,39 @@ private:
     /// Hash table with all the words
     TStrHash<TInt> WordH;
 
+    /// In-memory B-tree over the words of the vocabulary
+    template <class TKey, class TDat>
+    class TWordTree {
+    private:
+        // smart-pointer
+        TCRef CRef;
+        friend class TPt<TWordTree>;
+        typedef TBtree::TBtreeNodeMemStore<TKey, TInt, TInt> TInternalStore;
+        typedef TBtree::TBtreeNodeMemStore<TKey, TDat, TInt> TLeafStore;
+    public:
+        typedef TBtree::TBtreeOps<TKey, TDat, TCmp<TKey>, TInt, TInternalStore, TLeafStore> TBtreeOps;
+        TBtreeOps BTree;
+        TWordTree(): BTree(new TInternalStore, new TLeafStore, 8, 64, true, true) { }
+    };
+    /// Words sorted lexicographically, with word ids as data
+    typedef TWordTree<TStr, TInt> TStrWordTree;
+    /// Words which are numbers sorted numerically, as (value, word id) pairs
+    typedef TWordTree<TPair<TFlt, TInt>, TVoid> TFltWordTree;
+    /// Sorted words for prefix and range lookups. Built by the first such lookup and
+    /// then kept up to date as words are added, not saved with the vocabulary.
+    TPt<TStrWordTree> StrWordTree;
+    TPt<TFltWordTree> FltWordTree;
+    /// Serializes building of the sorted words by concurrent lookups
+    TCriticalSection WordTreeSection;
+    /// Wildchar queries without a prefix check every word, which is allowed
+    /// only for vocabularies with at most this many words
+    static const int MxWcScanWords;
+
+    /// Build StrWordTree from the words in the vocabulary, if not built yet
+    void InitStrWordTree();
+    /// Build FltWordTree from the words in the vocabulary, if not built yet
+    void InitFltWordTree();
+
     TIndexWordVoc() { }
     TIndexWordVoc(TSIn& SIn): WordVocNm(SIn), WordH(SIn) { }
 public:
@@ -2417,26 +2823,30 @@ public:
     void GetAllWordV(TStrV& WordStrV) const { WordH.GetKeyV(WordStrV); }
     /// Get all the words and count of their occurrences
     void GetAllWordFqV(TStrIntPrV& WordStrFqV) const { WordH.GetKeyDatPrV(WordStrFqV); }
-    /// Get vector of all words that match given wildchar query
+    /// Get vector of all words that match given wildchar query. Words starting with
+    /// the part of the query before the first wildchar are read from sorted words.
+    /// Queries starting with a wildchar fail for vocabularies over MxWcScanWords words.
     void GetWcWordIdV(const TStr& WcStr, TUInt64V& WcWordIdV);
 
     /// Get all words that have ID greater than `startWordId'
     void GetAllGreaterById(const uint64& StartWordId, TUInt64V& AllGreaterV);
     /// Get all words that have value lexicographically greater than `startWordId'
     void GetAllGreaterByStr(const uint64& StartWordId, TUInt64V& AllGreaterV);
-    /// Get all words that have value numerically greater than `startWordId'
+    /// Get all words that have value numerically greater than `startWordId'. Words which
+    /// are not numbers are skipped, and there are none when `startWordId' is not a number.
     void GetAllGreaterByFlt(const uint64& StartWordId, TUInt64V& AllGreaterV);
     /// Get all words that have ID smaller than `startWordId'
     void GetAllLessById(const uint64& StartWordId, TUInt64V& AllLessV);
     /// Get all words that have value lexicographically smaller the `startWordId'
     void GetAllLessByStr(const uint64& StartWordId, TUInt64V& AllLessV);
-    /// Get all words that have value numerically smaller the `startWordId'
+    /// Get all words that have value numerically smaller the `startWordId'. Words which
+    /// are not numbers are skipped, and there are none when `startWordId' is not a number.
     void GetAllLessByFlt(const uint64& StartWordId, TUInt64V& AllLessV);
 
     /// Increase count of records that were sent through this vocabulary (useful for document frequency counts)
-    void IncRecs() { Recs++; }
-    /// Add new word to the vocabulary (if existing, it increases its count)
-    uint64 AddWordStr(const TStr& WordStr);
+    void IncRecs(const int& NewRecs = 1) { Recs += NewRecs; }
+    /// Add new word to the vocabulary (if existing, it increases its count by WordFq)
+    uint64 AddWordStr(const TStr& WordStr, const int& WordFq = 1);
 
     /// Check if vocabulary has a name assigned (used for easier referencing in schemas)
     bool IsWordVocNm() const { return !WordVocNm.Empty(); }
@@ -2536,10 +2946,12 @@ public:
     uint64 GetWordId(const int& KeyId, const TStr& WordStr) const;
     /// Get word ids from a key for a given text (does not add new words)
     void GetWordIdV(const int& KeyId, const TStr& TextStr, TUInt64V& WordIdV) const;
-    /// For parsing strings (adds new words)
-    uint64 AddWordStr(const int& KeyId, const TStr& WordStr);
+    /// For parsing strings (adds new words, increases word count by WordFq)
+    uint64 AddWordStr(const int& KeyId, const TStr& WordStr, const int& WordFq = 1);
     /// Get word ids from a key for a given text (adds new words)
     void AddWordIdV(const int& KeyId, const TStr& TextStr, TUInt64V& WordIdV);
+    /// Increase count of records sent through the vocabulary of a key
+    void IncRecs(const int& KeyId, const int& NewRecs);
     /// Get word ids from a key for a given texts (adds new words)
     void AddWordIdV(const int& KeyId, const TStrV& WordV, TUInt64V& WordIdV);
     /// Get vector of all words from a key that match given wildchar query
@@ -2620,6 +3032,18 @@ private:
     /// Store which this query node returns
     TUInt StoreId;
 
+    /// Estimated number of records this node computes (before negation), set by planner
+    TFlt EstRecs;
+    /// Range condition evaluated as a filter over the records selected by its
+    /// siblings in a conjunction, instead of by the index (set by planner)
+    TBool FilterP;
+    /// Range condition is evaluated as a filter when it is expected to match at least
+    /// this many times more records than the most selective sibling in a conjunction
+    static const int FilterRatio;
+
+    /// Estimate fraction of indexed records matching range condition
+    double GetRangeFrac(const TWPt<TIndex>& Index) const;
+
     /// Parse Value for leaf nodes (result stored in WordIdV)
     void ParseWordStr(const TStr& WordStr, const TWPt<TIndexVoc>& IndexVoc);
 
@@ -2745,6 +3169,29 @@ public:
 
     /// Optimizes query tree by removing unneeded nodes
     void Optimize();
+    /// Estimates number of records matched by each node, orders children of AND and
+    /// OR nodes from the most selective on, and marks broad range conditions in
+    /// conjunctions to be evaluated as filters over records selected by their siblings
+    void Plan(const TWPt<TBase>& Base);
+    /// Get estimated number of records computed by this node (set by Plan)
+    double GetEstRecs() const { return EstRecs; }
+    /// Is this range condition evaluated as a filter (set by Plan)
+    bool IsFilter() const { return FilterP; }
+    /// Can the node be negated, which makes its estimate a poor guide for selectivity
+    bool IsNegatable() const;
+    /// Describe planned query tree as JSON
+    PJsonVal GetPlanJson(const TWPt<TBase>& Base) const;
+    /// Check if the node is evaluated only from indexes, without reading records,
+    /// so it can be evaluated in parallel with other such nodes
+    bool IsIndexLookup() const;
+    /// Check if record's field value satisfies the range condition (for filter nodes)
+    bool IsInRange(const TWPt<TBase>& Base, const TWPt<TStore>& Store, const uint64& RecId) const;
+    /// Describe query tree in canonical form, used as key for caching query results,
+    /// and collect index keys and stores the result depends on. Children of AND and OR
+    /// nodes are sorted, so their order does not matter. Returns false when the result
+    /// cannot be cached (query contains given records or samples joins).
+    bool GetCacheKey(const TWPt<TBase>& Base, TChA& KeyChA,
+        TIntSet& KeyIdSet, TUIntSet& StoreIdSet) const;
 
     /// Get result store id
     uint GetStoreId(const TWPt<TBase>& Base) const;
@@ -2915,8 +3362,16 @@ public:
     bool IsSort() const { return SortFieldId != -1; }
     /// Do the sort
     void Sort(const TWPt<TBase>& Base, const PRecSet& RecSet);
+    /// Field according which to sort (-1 for no sort)
+    int GetSortFieldId() const { return SortFieldId; }
+    /// Is sort ascending
+    bool IsSortAsc() const { return SortAscP; }
     /// Is there any limit restriction
     bool IsLimit() const { return (Limit != -1) || (Offset != 0); }
+    /// Maximal number of records to return (-1 for no limit)
+    int GetLimit() const { return Limit; }
+    /// Number of records to skip
+    int GetOffset() const { return Offset; }
     /// Do the range limit, when specified
     PRecSet GetLimit(const PRecSet& RecSet);
 
@@ -2979,6 +3434,45 @@ public:
     bool LocEquals(const TFltPr& Loc1, const TFltPr& Loc2) const;
 };
 
+///////////////////////////////
+// B-Tree Index Node Store
+/// Nodes of one B-tree, kept in a paged file shared by all B-tree indexes. Access
+/// to the paged file, which updates its page cache also on reads, is serialized by
+/// a lock shared by all stores in the same file. Checked-out nodes belong to this
+/// store only, so different trees can be used from different threads.
+template <class TKey, class TDat>
+class TBTreeIndexNodeStore : public TBtree::TBtreeNodePgBlobStore<TKey, TDat, TInt> {
+private:
+    typedef TBtree::TBtreeNodePgBlobStore<TKey, TDat, TInt> TPgBlobStore;
+    /// Lock shared by all stores with nodes in the same paged file
+    TCriticalSection& BlobSection;
+
+    TBTreeIndexNodeStore(const PPgBlob& Blob, TCriticalSection& _BlobSection):
+        TPgBlobStore(Blob), BlobSection(_BlobSection) { }
+    TBTreeIndexNodeStore(TSIn& SIn, const PPgBlob& Blob, TCriticalSection& _BlobSection):
+        TPgBlobStore(SIn, Blob), BlobSection(_BlobSection) { }
+
+public:
+    typedef typename TPgBlobStore::TNode TNode;
+
+    static TPt<TBTreeIndexNodeStore> New(const PPgBlob& Blob, TCriticalSection& BlobSection) {
+        return new TBTreeIndexNodeStore(Blob, BlobSection); }
+    static TPt<TBTreeIndexNodeStore> Load(TSIn& SIn, const PPgBlob& Blob, TCriticalSection& BlobSection) {
+        return new TBTreeIndexNodeStore(SIn, Blob, BlobSection); }
+    // The store cannot be owned by the tree, as it can only be loaded together with its paged file.
+    static TPt<TBTreeIndexNodeStore> Load(TSIn& SIn) {
+        FailR("B-tree index node store requires paged file to load"); return NULL; }
+    void Save(TSOut& SOut) const { TLock Lock(BlobSection); TPgBlobStore::Save(SOut); }
+
+    TInt AllocNode() { TLock Lock(BlobSection); return TPgBlobStore::AllocNode(); }
+    void FreeNode(const TInt& NodeId) { TLock Lock(BlobSection); TPgBlobStore::FreeNode(NodeId); }
+    TNode* CheckOutNode(const TInt& NodeId) {
+        TLock Lock(BlobSection); return TPgBlobStore::CheckOutNode(NodeId); }
+    void CheckInNode(const TInt& NodeId, TNode* Node, bool Dirty) {
+        TLock Lock(BlobSection); TPgBlobStore::CheckInNode(NodeId, Node, Dirty); }
+    void Clr() { TLock Lock(BlobSection); TPgBlobStore::Clr(); }
+};
+
 ///////////////////////////////
 // B-Tree Index
 template <class TVal>
@@ -2991,10 +3485,10 @@ private:
     /// We store values as (val, rec) pairs, which are sorted lexigraphically.
     /// That ensures that values are sorted primarly by value, and for same value by record id
     typedef TPair<TVal, TUInt64> TTreeVal;
-    /// Define store for internal nodes
-    typedef TBtree::TBtreeNodeMemStore<TTreeVal, TInt, TInt> TInternalStore;
-    /// Define store for external nodes
-    typedef TBtree::TBtreeNodeMemStore<TTreeVal, TVoid, TInt> TLeafStore;
+    /// Define store for internal nodes, kept in paged file shared by all indexes
+    typedef TBTreeIndexNodeStore<TTreeVal, TInt> TInternalStore;
+    /// Define store for external nodes, kept in paged file shared by all indexes
+    typedef TBTreeIndexNodeStore<TTreeVal, TVoid> TLeafStore;
     /// Define btree with given stores and value type. Each leaf node has a vector of record ids
     typedef TBtree::TBtreeOps<TTreeVal, TVoid, TCmp<TTreeVal>, TInt, TInternalStore, TLeafStore> TBtreeOps;
 
@@ -3004,26 +3498,82 @@ private:
     TPt<TLeafStore> LeafStore;
     /// BTree instance
     TBtreeOps BTree;
+    /// Serialize use of the tree, different trees can be used in parallel
+    mutable TCriticalSection TreeSection;
+
+    /// Minimal number of values per chunk when sorting in parallel
+    static const int MnSortChunkVals;
+    /// Maximal number of chunks sorted in parallel
+    static const int MxSortChunks;
+    /// Sort values by sorting chunks in parallel and merging them pairwise
+    static void SortValV(TVec<TTreeVal>& ValV);
+
+    /// In-memory stores used by indexes saved before paged stores, only for loading
+    typedef TBtree::TBtreeNodeMemStore<TTreeVal, TInt, TInt> TMemInternalStore;
+    typedef TBtree::TBtreeNodeMemStore<TTreeVal, TVoid, TInt> TMemLeafStore;
+    typedef TBtree::TBtreeOps<TTreeVal, TVoid, TCmp<TTreeVal>, TInt, TMemInternalStore, TMemLeafStore> TMemBtreeOps;
 
 public:
-    /// Create new empty index
-    TBTreeIndex(): InternalStore(new TInternalStore), LeafStore(new TLeafStore),
+    /// Index saved with in-memory stores, used only to load bases saved before paged stores
+    class TMemIndex {
+    private:
+        TCRef CRef;
+        friend class TPt<TMemIndex>;
+
+        TPt<TMemInternalStore> InternalStore;
+        TPt<TMemLeafStore> LeafStore;
+        TMemBtreeOps BTree;
+
+        TMemIndex(TSIn& SIn): InternalStore(SIn), LeafStore(SIn), BTree(SIn, InternalStore, LeafStore) { }
+
+    public:
+        static TPt<TMemIndex> Load(TSIn& SIn) { return new TMemIndex(SIn); }
+        /// Add all keys, walking the leaf level in order, to the given index
+        void CopyTo(TBTreeIndex& Index);
+    };
+
+    /// Create new empty index with nodes in the given paged file, guarded by BlobSection
+    TBTreeIndex(const PPgBlob& Blob, TCriticalSection& BlobSection):
+        InternalStore(TInternalStore::New(Blob, BlobSection)), LeafStore(TLeafStore::New(Blob, BlobSection)),
         BTree(InternalStore, LeafStore, 8, 64, false, false) { }
-    /// Create new empty index
-    static TPt<TBTreeIndex> New() { return new TBTreeIndex; }
-    /// Load existing index from stream
-    TBTreeIndex(TSIn& SIn): InternalStore(SIn), LeafStore(SIn), BTree(SIn, InternalStore, LeafStore) {  }
-    /// Load existing index from stream
-    static TPt<TBTreeIndex> Load(TSIn& SIn) { return new TBTreeIndex(SIn); }
-    /// Save index to stream
-    void Save(TSOut& SOut) { InternalStore.Save(SOut); LeafStore.Save(SOut); BTree.Save(SOut); }
+    /// Create new empty index with nodes in the given paged file, guarded by BlobSection
+    static TPt<TBTreeIndex> New(const PPgBlob& Blob, TCriticalSection& BlobSection) {
+        return new TBTreeIndex(Blob, BlobSection); }
+    /// Load existing index from stream, nodes are in the given paged file
+    TBTreeIndex(TSIn& SIn, const PPgBlob& Blob, TCriticalSection& BlobSection):
+        InternalStore(TInternalStore::Load(SIn, Blob, BlobSection)),
+        LeafStore(TLeafStore::Load(SIn, Blob, BlobSection)), BTree(SIn, InternalStore, LeafStore) {  }
+    /// Load existing index from stream, nodes are in the given paged file
+    static TPt<TBTreeIndex> Load(TSIn& SIn, const PPgBlob& Blob, TCriticalSection& BlobSection) {
+        return new TBTreeIndex(SIn, Blob, BlobSection); }
+    /// Create new index in the given paged file with keys of index saved with in-memory stores
+    static TPt<TBTreeIndex> New(const TPt<TMemIndex>& MemIndex, const PPgBlob& Blob,
+        TCriticalSection& BlobSection);
+    /// Save index to stream. Only node locations are saved, nodes stay in the paged file
+    void Save(TSOut& SOut) { TLock Lock(TreeSection);
+        InternalStore->Save(SOut); LeafStore->Save(SOut); BTree.Save(SOut); }
 
     /// Add new record
     void AddKey(const TVal& Val, const uint64& RecId);
+    /// Add records given as (value, record id) pairs, which get sorted in place.
+    /// Empty index is built bottom-up with packed nodes, otherwise records are
+    /// added one by one in sorted order.
+    void AddKeyV(TVec<TPair<TVal, TUInt64> >& ValRecIdV);
     /// Delete record
     void DelKey(const TVal& Val, const uint64& RecId);
+    /// Delete records given as (value, record id) pairs, which get sorted in place
+    void DelKeyV(TVec<TPair<TVal, TUInt64> >& ValRecIdV);
     /// Range query
     void SearchRange(const TPair<TVal, TVal>& RangeMinMax, TUInt64V& RecIdV) const;
+    /// Range query returning records in ascending or descending order of values,
+    /// stops after Limit records (when not -1)
+    void SearchRange(const TPair<TVal, TVal>& RangeMinMax, const bool& SortAscP,
+        const int& Limit, TUInt64V& RecIdV) const;
+    /// Count records with value in the given range, without collecting them. When ExistsP
+    /// is set, stops at the first record and returns 0 or 1.
+    uint64 GetRangeRecs(const TPair<TVal, TVal>& RangeMinMax, const bool& ExistsP = false) const;
+    /// Estimate fraction of indexed records with value in the given range
+    double GetRangeFrac(const TPair<TVal, TVal>& RangeMinMax) const;
 };
 
 ///////////////////////////////
@@ -3179,6 +3729,10 @@ private:
         int GetPosLen() const { return PosV.Len; }
         /// Get position converted to int for easier handling outside
         int GetPos(const int& PosN) const;
+        /// Save positions in compact form, used by compressed child vectors
+        void SavePosCompact(TSOut& SOut) const;
+        /// Load positions saved by SavePosCompact
+        void LoadPosCompact(TSIn& SIn);
 
         /// Add new position to the item and return true if the item became full
         /// the positions are always added in increasing order - every added position should be higher than the last
@@ -3203,6 +3757,42 @@ private:
 
     /// ItemHandler for combining position records
     typedef TGixDefItemHandler<TQmGixKey, TQmGixItemPos> TQmGixItemHandlerPos;
+
+    /// Record id of an item, used when compressing child vectors
+    static uint64 GetGixItemRecId(const TQmGixItemFull& Item) { return Item.Key; }
+    static uint64 GetGixItemRecId(const TQmGixItemSmall& Item) { return Item.Key; }
+    static uint64 GetGixItemRecId(const TQmGixItemTiny& Item) { return Item; }
+    static uint64 GetGixItemRecId(const TQmGixItemPos& Item) { return Item.GetRecId(); }
+    /// Save the rest of the item (frequency or positions) to compressed child vector
+    static void SaveGixItemDat(const TQmGixItemFull& Item, TSOut& SOut) { TGixVarInt::SaveInt(SOut, Item.Dat); }
+    static void SaveGixItemDat(const TQmGixItemSmall& Item, TSOut& SOut) { TGixVarInt::SaveInt(SOut, Item.Dat); }
+    static void SaveGixItemDat(const TQmGixItemTiny& Item, TSOut& SOut) { }
+    static void SaveGixItemDat(const TQmGixItemPos& Item, TSOut& SOut) { Item.SavePosCompact(SOut); }
+    /// Load item with the given record id from compressed child vector
+    static void LoadGixItem(TSIn& SIn, const uint64& RecId, TQmGixItemFull& Item) {
+        Item.Key = RecId; Item.Dat = TGixVarInt::LoadInt(SIn); }
+    static void LoadGixItem(TSIn& SIn, const uint64& RecId, TQmGixItemSmall& Item) {
+        Item.Key = (uint)RecId; Item.Dat = (int16)TGixVarInt::LoadInt(SIn); }
+    static void LoadGixItem(TSIn& SIn, const uint64& RecId, TQmGixItemTiny& Item) { Item = (uint)RecId; }
+    static void LoadGixItem(TSIn& SIn, const uint64& RecId, TQmGixItemPos& Item) {
+        Item = TQmGixItemPos(RecId); Item.LoadPosCompact(SIn); }
+
+    /// ItemHandler which can compress child vectors sorted by record id: record ids
+    /// are delta encoded and, together with frequencies or positions, stored as
+    /// variable-length numbers. Other operations are done by TQmGixItemHandler.
+    template <class TQmGixItem, class TQmGixItemHandler>
+    class TQmGixCompressItemHandler : public TQmGixItemHandler {
+    public:
+        /// Only vectors with non-decreasing record ids can be delta encoded
+        bool IsCompressible(const TVec<TQmGixItem>& ItemV) const;
+        /// Save record id deltas and the rest of the items
+        void SaveCompressed(const TVec<TQmGixItem>& ItemV, TSOut& SOut) const;
+        /// Decode items and append them to ItemV
+        void LoadCompressed(TSIn& SIn, const int& Items, TVec<TQmGixItem>& ItemV) const;
+
+        /// Memory footprint
+        uint64 GetMemUsed() const { return sizeof(TQmGixCompressItemHandler<TQmGixItem, TQmGixItemHandler>); }
+    };
     /// Merger for combining position records
     typedef TGixDefMerger<TQmGixKey, TQmGixItemPos, TQmGixItemPos> TQmGixMergerPos;
     /// Expression for executing gix position queries
@@ -3257,6 +3847,8 @@ private:
     THash<TInt, PBTreeIndexFlt> BTreeIndexFltH;
     /// BTree index for floats (one for each key)
     THash<TInt, PBTreeIndexSFlt> BTreeIndexSFltH;
+    /// Paged file with nodes of all BTree indexes
+    PPgBlob BTreeBlob;
 
     /// Index Vocabulary
     PIndexVoc IndexVoc;
@@ -3279,8 +3871,71 @@ private:
     /// Inverted Index Default Merger Position
     const TGixMerger<TQmGixKey, TQmGixItemPos, TQmGixItemPos>* MergerPos;
 
+    /// Background flusher of the base, when running
+    TWPt<TBaseFlusher> Flusher;
+    /// Serialize reads from each inverted index, which update their caches.
+    /// Lookups in different inverted indexes can run in parallel.
+    mutable TCriticalSection GixFullSection;
+    mutable TCriticalSection GixSmallSection;
+    mutable TCriticalSection GixTinySection;
+    mutable TCriticalSection GixPosSection;
+    /// Serialize changes of BTree indexes and access to linear batch buffers. Searches
+    /// hold it only to look up the tree, each tree is then guarded by its own lock.
+    mutable TCriticalSection BTreeSection;
+    /// Serialize access to BTreeBlob, which updates its page cache also on reads
+    mutable TCriticalSection BTreeBlobSection;
+
+    /// Number of open batches; while positive, inverted index additions and deletions are buffered
+    TInt BatchN;
+    /// Inverted index additions buffered during a batch, grouped by (KeyId, WordId)
+    THash<TQmGixKey, TVec<TQmGixItemFull> > BatchItemH;
+    /// Inverted index deletions buffered during a batch, grouped by (KeyId, WordId).
+    /// Frequency TInt::Mx marks deletion of all occurrences of the record.
+    THash<TQmGixKey, TVec<TQmGixItemFull> > BatchDelItemH;
+    /// Inverted index keys touched by additions are collected here when not NULL, see TGixKeyScope
+    THashSet<TQmGixKey>* GixKeyLog;
+
+    /// Number of open linear batches; while positive, BTree index additions and deletions are buffered
+    TInt LinearBatchN;
+    /// True when buffered changes are deletions; additions and deletions are not buffered together
+    TBool LinearBatchDelP;
+    /// BTree index additions buffered during a linear batch, grouped by KeyId
+    THash<TInt, TVec<TPair<TUCh, TUInt64> > > LinearBatchByteH;
+    THash<TInt, TVec<TPair<TInt, TUInt64> > > LinearBatchIntH;
+    THash<TInt, TVec<TPair<TInt16, TUInt64> > > LinearBatchInt16H;
+    THash<TInt, TVec<TPair<TInt64, TUInt64> > > LinearBatchInt64H;
+    THash<TInt, TVec<TPair<TUInt, TUInt64> > > LinearBatchUIntH;
+    THash<TInt, TVec<TPair<TUInt16, TUInt64> > > LinearBatchUInt16H;
+    THash<TInt, TVec<TPair<TUInt64, TUInt64> > > LinearBatchUInt64H;
+    THash<TInt, TVec<TPair<TFlt, TUInt64> > > LinearBatchFltH;
+    THash<TInt, TVec<TPair<TSFlt, TUInt64> > > LinearBatchSFltH;
+    /// BTree index deletions buffered during a linear batch, grouped by KeyId
+    THash<TInt, TVec<TPair<TUCh, TUInt64> > > LinearDelBatchByteH;
+    THash<TInt, TVec<TPair<TInt, TUInt64> > > LinearDelBatchIntH;
+    THash<TInt, TVec<TPair<TInt16, TUInt64> > > LinearDelBatchInt16H;
+    THash<TInt, TVec<TPair<TInt64, TUInt64> > > LinearDelBatchInt64H;
+    THash<TInt, TVec<TPair<TUInt, TUInt64> > > LinearDelBatchUIntH;
+    THash<TInt, TVec<TPair<TUInt16, TUInt64> > > LinearDelBatchUInt16H;
+    THash<TInt, TVec<TPair<TUInt64, TUInt64> > > LinearDelBatchUInt64H;
+    THash<TInt, TVec<TPair<TFlt, TUInt64> > > LinearDelBatchFltH;
+    THash<TInt, TVec<TPair<TSFlt, TUInt64> > > LinearDelBatchSFltH;
+
+    /// Counter of index and store modifications, used to version cached query results
+    TUInt64 ModVer;
+    /// Version of the last modification of each index key, indexed by KeyId
+    TUInt64V KeyModVerV;
+    /// Version of the last modification of each store, indexed by StoreId
+    THash<TUInt, TUInt64> StoreModVerH;
+    /// Guards modification versions, keys can be touched from parallel index updates
+    mutable TCriticalSection ModVerSection;
+
+    /// Mark index key as modified
+    void TouchKey(const int& KeyId);
+
     /// Determines which Gix should be used for given KeyId
     TIndexKeyGixType GetGixType(const int& KeyId) const { return IndexVoc->GetKey(KeyId).GetGixType(); }
+    /// Section guarding the inverted index used by given KeyId
+    TCriticalSection& GetGixSection(const int& KeyId) const;
     /// Executes GIX query expression against the full index
     bool DoQueryFull(const TPt<TQmGixExpItemFull>& ExpItem, TVec<TQmGixItemFull>& RecIdFqV) const;
     /// Executes GIX query expression against the small index
@@ -3298,18 +3953,70 @@ private:
     /// Execute Position query. Result is vector of record ids and frequency of phrase occurences.
     void DoQueryPos(const int& KeyId, const TUInt64V& WordIdV, const int& MaxDiff, TUInt64IntKdV& RecIdFqV) const;
 
+    /// Get B-Tree index of the key for searching (NULL when key has no index), after
+    /// applying the linear batch. The tree is used without holding BTreeSection.
+    template <class TVal>
+    TWPt<TBTreeIndex<TVal> > GetBTreeIndex(const THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH,
+        const int& KeyId);
+    /// Estimates fraction of records in given range of a B-Tree index (zero when key has no index)
+    template <class TVal>
+    double GetBTreeRangeFrac(const THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH,
+        const int& KeyId, const TPair<TVal, TVal>& RangeMinMax) const;
+    /// Counts records in given range of a B-Tree index (zero when key has no index),
+    /// including the ones still waiting in the linear batch
+    template <class TVal>
+    uint64 GetBTreeRangeRecs(const THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH,
+        const int& KeyId, const TPair<TVal, TVal>& RangeMinMax, const bool& ExistsP);
+    /// Counts records present in the item sets of all the given keys. Items from the
+    /// shortest set are looked up in the longer ones, without converting them to records.
+    template <class TQmGixItem>
+    uint64 GetGixAndRecs(const TPt<TGix<TQmGixKey, TQmGixItem> >& Gix,
+        const TKeyWordV& KeyWordV, const bool& ExistsP) const;
+    /// Number of candidate items intersected at once when only checking for existence
+    static const int GixExistsChunkLen;
+    /// Load B-Tree indexes with nodes in BTreeBlob
+    template <class TVal>
+    void LoadBTreeIndexH(TSIn& SIn, THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH);
+    /// Load B-Tree indexes saved with in-memory nodes and copy them to BTreeBlob
+    template <class TVal>
+    void LoadMemBTreeIndexH(TSIn& SIn, THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH);
+    /// Add buffered values to B-Tree indexes, creating indexes for new keys
+    template <class TVal>
+    void FlushBTreeBatchH(THash<TInt, TVec<TPair<TVal, TUInt64> > >& BatchH,
+        THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH);
+    /// Delete buffered values from B-Tree indexes, sorted so deletions walk the leaves in order
+    template <class TVal>
+    void FlushBTreeDelBatchH(THash<TInt, TVec<TPair<TVal, TUInt64> > >& BatchH,
+        THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH);
+    /// Apply buffered BTree index additions or deletions, caller must hold BTreeSection
+    void FlushLinearBatch();
+    /// Append values collected in TIndexBatch to the buffered BTree index additions
+    template <class TVal>
+    void AddBTreeBatchH(const THash<TInt, TVec<TPair<TVal, TUInt64> > >& NewBatchH,
+        THash<TInt, TVec<TPair<TVal, TUInt64> > >& BatchH);
+    /// Save B-Tree indexes, nodes are kept in BTreeBlob
+    template <class TVal>
+    static void SaveBTreeIndexH(TSOut& SOut, const THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH);
+    /// Save dirty BTree pages and locations of all BTree indexes
+    void SaveBTree();
+
+    /// Deletes all items smaller than given item from the posting lists of given keys
+    template <class TQmGixItem>
+    void DeleteGixBefore(const TPt<TGix<TQmGixKey, TQmGixItem> >& Gix,
+        const TVec<TQmGixKey>& GixKeyV, const TQmGixItem& Item);
+
     /// method that computes the GixItemPos items for the provided list of words
     void ComputeWordItemPos(const int& KeyId, const TUInt64V& WordIdV, const uint64& RecId, TVec<TPair<TUInt64, TQmGixItemPos>>& WordIdPosPrV);
 
     /// Constructor
     TIndex(const TStr& _IndexFPath, const TFAccess& _Access, const PIndexVoc& IndexVoc,
         const int64& CacheSizeFull, const int64& CacheSizeSmall, const uint64& CacheSizeTiny,
-        const int64& CacheSizePos, const int& SplitLen);
+        const int64& CacheSizePos, const int64& CacheSizeLinear, const int& SplitLen);
 public:
     /// Create (Access==faCreate) or open existing index
     static PIndex New(const TStr& IndexFPath, const TFAccess& Access, const PIndexVoc& IndexVoc,
         const int64& CacheSizeFull, const int64& CacheSizeSmall, const uint64& CacheSizeTiny,
-        const int64& CacheSizePos, const int& SplitLen);
+        const int64& CacheSizePos, const int64& CacheSizeLinear, const int& SplitLen);
     /// Checks if there is an existing index at the given path
     static bool Exists(const TStr& IndexFPath) {
         return TFile::Exists(IndexFPath + "Index.GixFull.Gix") ||
@@ -3340,6 +4047,26 @@ public:
     /// Add to inverted index (RecId, RecFq) under key (KeyId, WordId).
     void IndexGix(const int& KeyId, const uint64& WordId, const uint64& RecId, const int& RecFq);
 
+    /// Start buffering inverted index additions and deletions until the matching EndBatch call.
+    /// Posting lists are read as they were before the batch until it ends.
+    void StartBatch() { BatchN++; }
+    /// End batch; when the outermost batch ends, buffered changes are flushed
+    void EndBatch();
+    /// Apply buffered inverted index changes with one call per (KeyId, WordId).
+    /// Deletions go first, since a deletion arriving after buffered additions flushes them.
+    void FlushBatch();
+    /// Apply buffered inverted index deletions
+    void FlushBatchDel();
+    /// Add changes collected in the batch. Words are mapped to ids once per batch and
+    /// posting lists and linear indexes are extended with whole vectors.
+    void AddBatch(const TIndexBatch& Batch);
+    /// Start buffering BTree index additions and deletions until the matching
+    /// EndLinearBatch call. Buffered values are sorted and applied in bulk, which
+    /// builds empty indexes bottom-up. Searches apply the buffered values first.
+    void StartLinearBatch();
+    /// End linear batch; when the outermost batch ends, buffered values are added
+    void EndLinearBatch();
+
     /// Delete index for RecId under (Key, Word). WordStr is sent through index vocabulary.
     void DeleteValue(const int& KeyId, const TStr& WordStr, const uint64& RecId);
     /// Delete index for RecId under (Key, Word). WordStrV is sent through index vocabulary.
@@ -3352,6 +4079,12 @@ public:
         const uint64& RecId, const uint64& JoinRecId, const int& JoinFq = TInt::Mx);
     // Delete record from inverted index
     void DeleteGix(const int& KeyId, const uint64& WordId, const uint64& RecId, const int& RecFq);
+    /// Delete all records with ID smaller than given one from the given posting lists.
+    /// Whole blocks of posting lists are dropped without reading them.
+    void DeleteGixBefore(const THashSet<TQmGixKey>& GixKeySet, const uint64& RecId);
+    /// Start collecting inverted index keys touched by additions into the given set,
+    /// NULL stops it. Returns the previous set.
+    THashSet<TQmGixKey>* SetGixKeyLog(THashSet<TQmGixKey>* _GixKeyLog);
 
     /// Index RecId using given keys and words. Words are extracted by tokenizing the given string.
     void IndexTextPos(const int& KeyId, const TStr& TextStr, const uint64& RecId);
@@ -3415,6 +4148,12 @@ public:
     PRecSet SearchGix(const TWPt<TBase>& Base, const int& KeyId, const uint64& WordId) const;
     /// Search inverted index for records matching all words from same key
     PRecSet SearchGixAnd(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV) const;
+    /// Search inverted index for records matching all key-word pairs. Keys must
+    /// index the same store and use the same inverted index type.
+    PRecSet SearchGixAnd(const TWPt<TBase>& Base, const TKeyWordV& KeyWordV) const;
+    /// Collect ids of the index locks taken when searching the query item. Searches
+    /// that take none of the same locks do not wait for each other.
+    void GetSearchLockIdSet(const TQueryItem& QueryItem, TIntSet& LockIdSet) const;
     /// Search inverted index for records matching at least one word from the same key
     PRecSet SearchGixOr(const TWPt<TBase>& Base, const int& KeyId, const TUInt64V& WordIdV) const;
 
@@ -3434,24 +4173,80 @@ public:
     PRecSet SearchGeoNn(const TWPt<TBase>& Base, const int& KeyId,
         const TFltPr& Loc, const int& Limit) const;
 
+    /// Do B-Tree linear search. Records are sorted by id, or by value when ValSortP
+    /// is set, in which case only the first Limit records (when not -1) are read.
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUChPr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
     /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUChPr& RangeMinMax);
-    /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TIntPr& RangeMinMax);
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TIntPr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
     /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TInt16Pr& RangeMinMax);
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TInt16Pr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
     /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TInt64Pr& RangeMinMax);
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TInt64Pr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
     /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUIntUIntPr& RangeMinMax);
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUIntUIntPr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
     /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUInt16Pr& RangeMinMax);
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUInt16Pr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
     /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUInt64Pr& RangeMinMax);
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TUInt64Pr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
     /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TFltPr& RangeMinMax);
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TFltPr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
     /// Do B-Tree linear search
-    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TSFltPr& RangeMinMax);
+    PRecSet SearchLinear(const TWPt<TBase>& Base, const int& KeyId, const TSFltPr& RangeMinMax, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
+
+    /// Number of records indexed under given word of an inverted index key. Read from
+    /// the item set without merging, so pending deletes are still counted.
+    int GetGixItems(const int& KeyId, const uint64& WordId) const;
+    /// Number of records matching all given (key, word) pairs of the same inverted index type,
+    /// without building the record set. Item sets are merged first, so records are counted
+    /// once and pending deletes are not counted. When ExistsP is set, returns 0 or 1 and
+    /// stops at the first match.
+    uint64 GetGixAndRecs(const TKeyWordV& KeyWordV, const bool& ExistsP = false) const;
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TUChPr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexByteH, KeyId, RangeMinMax); }
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TIntPr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexIntH, KeyId, RangeMinMax); }
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TInt16Pr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexInt16H, KeyId, RangeMinMax); }
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TInt64Pr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexInt64H, KeyId, RangeMinMax); }
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TUIntUIntPr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexUIntH, KeyId, RangeMinMax); }
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TUInt16Pr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexUInt16H, KeyId, RangeMinMax); }
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TUInt64Pr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexUInt64H, KeyId, RangeMinMax); }
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TFltPr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexFltH, KeyId, RangeMinMax); }
+    /// Estimated fraction of indexed records with value in given range of a B-Tree key
+    double GetLinearRangeFrac(const int& KeyId, const TSFltPr& RangeMinMax) const { return GetBTreeRangeFrac(BTreeIndexSFltH, KeyId, RangeMinMax); }
+    /// Number of records with value in given range of a B-Tree key, without building the
+    /// record set. When ExistsP is set, returns 0 or 1 and stops at the first record.
+    uint64 GetLinearRangeRecs(const int& KeyId, const TUChPr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexByteH, KeyId, RangeMinMax, ExistsP); }
+    /// Number of records with value in given range of a B-Tree key
+    uint64 GetLinearRangeRecs(const int& KeyId, const TIntPr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexIntH, KeyId, RangeMinMax, ExistsP); }
+    /// Number of records with value in given range of a B-Tree key
+    uint64 GetLinearRangeRecs(const int& KeyId, const TInt16Pr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexInt16H, KeyId, RangeMinMax, ExistsP); }
+    /// Number of records with value in given range of a B-Tree key
+    uint64 GetLinearRangeRecs(const int& KeyId, const TInt64Pr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexInt64H, KeyId, RangeMinMax, ExistsP); }
+    /// Number of records with value in given range of a B-Tree key
+    uint64 GetLinearRangeRecs(const int& KeyId, const TUIntUIntPr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexUIntH, KeyId, RangeMinMax, ExistsP); }
+    /// Number of records with value in given range of a B-Tree key
+    uint64 GetLinearRangeRecs(const int& KeyId, const TUInt16Pr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexUInt16H, KeyId, RangeMinMax, ExistsP); }
+    /// Number of records with value in given range of a B-Tree key
+    uint64 GetLinearRangeRecs(const int& KeyId, const TUInt64Pr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexUInt64H, KeyId, RangeMinMax, ExistsP); }
+    /// Number of records with value in given range of a B-Tree key
+    uint64 GetLinearRangeRecs(const int& KeyId, const TFltPr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexFltH, KeyId, RangeMinMax, ExistsP); }
+    /// Number of records with value in given range of a B-Tree key
+    uint64 GetLinearRangeRecs(const int& KeyId, const TSFltPr& RangeMinMax, const bool& ExistsP = false) { return GetBTreeRangeRecs(BTreeIndexSFltH, KeyId, RangeMinMax, ExistsP); }
 
     /// Are there any existing joins from RecId using JoinKeyId
     bool HasJoin(const int& JoinKeyId, const uint64& RecId) const;
@@ -3465,11 +4260,126 @@ public:
     TGixStats GetGixStats(const bool& RefreshP = true) const;
     /// Get split length of inner Gix
     int GetSplitLen() const;
+    /// Store child vectors of inverted indexes compressed. Applies to
+    /// child vectors saved from now on, existing ones are read in either form.
+    void SetGixCompress(const bool& CompressP);
+    /// Are child vectors of inverted indexes stored compressed
+    bool IsGixCompress() const { return GixFull->IsCompress(); }
     /// reset blob stats
     void ResetStats();
 
+    /// Mark store as modified (records added, updated or deleted)
+    void TouchStore(const uint& StoreId);
+    /// Version of the last modification of index key, zero when never modified
+    uint64 GetKeyModVer(const int& KeyId) const;
+    /// Version of the last modification of store, zero when never modified
+    uint64 GetStoreModVer(const uint& StoreId) const;
+
     /// perform partial flush of index contents
     int PartialFlush(const int& WndInMsec = 500);
+    /// save all index contents, so index files are consistent while index stays open
+    void Flush();
+    /// keep index files saved by the last Flush unchanged until the checkpoint after the
+    /// next one, so base can be recovered from the last checkpoint after a crash
+    void EnableCheckpoints(const uint64& CheckpointLsn);
+    /// release index contents kept for the previous checkpoint, once the last Flush is
+    /// saved as the checkpoint CheckpointLsn
+    void EndCheckpoint(const uint64& CheckpointLsn);
+    /// size of index contents changed since they were last flushed to disk
+    uint64 GetDirtyBytes();
+    /// set background flusher which needs to be locked out while index is used
+    void SetFlusher(const TWPt<TBaseFlusher>& _Flusher) { Flusher = _Flusher; }
+};
+
+///////////////////////////////
+/// Inverted index key scope.
+/// Collects inverted index keys touched by additions for the lifetime of the scope,
+/// so the caller knows which posting lists hold the indexed records. Inactive scope
+/// does nothing. Nested scopes collect only the keys touched while they are innermost.
+class TGixKeyScope {
+private:
+    /// Index, NULL when scope is not active
+    TWPt<TIndex> Index;
+    /// Keys collected by outer scope, restored when leaving the scope
+    THashSet<TKeyWord>* PrevKeySet;
+    /// Keys touched in this scope
+    THashSet<TKeyWord> KeySet;
+
+public:
+    TGixKeyScope(const TWPt<TIndex>& _Index, const bool& ActiveP);
+    ~TGixKeyScope();
+
+    /// Keys touched so far
+    const THashSet<TKeyWord>& GetKeySet() const { return KeySet; }
+};
+
+///////////////////////////////
+/// Index Batch.
+/// Collects index additions for a group of records without touching the index.
+/// Words are kept as strings, so collecting does not need the shared vocabulary and
+/// batches of different stores can be built in parallel. TIndex::AddBatch applies them.
+class TIndexBatch {
+private:
+    /// Same as TIndex::TQmGixItemFull
+    typedef TKeyDat<TUInt64, TInt> TQmGixItemFull; // [RecId, Freq]
+
+    /// Vocabulary, used only for the tokenizers of the keys
+    TWPt<TIndexVoc> IndexVoc;
+    /// Inverted index additions, grouped by (KeyId, WordStr)
+    THash<TPair<TInt, TStr>, TVec<TQmGixItemFull> > WordItemH;
+    /// Number of texts indexed under each key, counted by its word vocabulary
+    THash<TInt, TInt> TextRecsH;
+    /// Position index additions as (KeyId, TextStr, RecId), positions need word ids
+    TVec<TTriple<TInt, TStr, TUInt64> > TextPosV;
+    /// Location index additions as (KeyId, Loc, RecId)
+    TVec<TTriple<TInt, TFltPr, TUInt64> > GeoV;
+    /// BTree index additions, grouped by KeyId
+    THash<TInt, TVec<TPair<TUCh, TUInt64> > > LinearByteH;
+    THash<TInt, TVec<TPair<TInt, TUInt64> > > LinearIntH;
+    THash<TInt, TVec<TPair<TInt16, TUInt64> > > LinearInt16H;
+    THash<TInt, TVec<TPair<TInt64, TUInt64> > > LinearInt64H;
+    THash<TInt, TVec<TPair<TUInt, TUInt64> > > LinearUIntH;
+    THash<TInt, TVec<TPair<TUInt16, TUInt64> > > LinearUInt16H;
+    THash<TInt, TVec<TPair<TUInt64, TUInt64> > > LinearUInt64H;
+    THash<TInt, TVec<TPair<TFlt, TUInt64> > > LinearFltH;
+    THash<TInt, TVec<TPair<TSFlt, TUInt64> > > LinearSFltH;
+
+    friend class TIndex;
+
+public:
+    TIndexBatch(const TWPt<TIndexVoc>& _IndexVoc): IndexVoc(_IndexVoc) { }
+
+    /// Add RecId under (Key, Word), same as TIndex::IndexValue
+    void IndexValue(const int& KeyId, const TStr& WordStr, const uint64& RecId);
+    /// Add RecId under (Key, Word) for each word, same as TIndex::IndexValue
+    void IndexValue(const int& KeyId, const TStrV& WordStrV, const uint64& RecId);
+    /// Add RecId under tokens of the text, same as TIndex::IndexText
+    void IndexText(const int& KeyId, const TStr& TextStr, const uint64& RecId);
+    /// Add RecId with positions of the tokens of the text, same as TIndex::IndexTextPos
+    void IndexTextPos(const int& KeyId, const TStr& TextStr, const uint64& RecId) {
+        TextPosV.Add(TTriple<TInt, TStr, TUInt64>(KeyId, TextStr, RecId)); }
+    /// Add RecId to location index under (Key, Loc)
+    void IndexGeo(const int& KeyId, const TFltPr& Loc, const uint64& RecId) {
+        GeoV.Add(TTriple<TInt, TFltPr, TUInt64>(KeyId, Loc, RecId)); }
+    /// Add RecId to linear index under (Key, Val)
+    void IndexLinear(const int& KeyId, const uchar& Val, const uint64& RecId) {
+        LinearByteH.AddDat(KeyId).Add(TPair<TUCh, TUInt64>(Val, RecId)); }
+    void IndexLinear(const int& KeyId, const int& Val, const uint64& RecId) {
+        LinearIntH.AddDat(KeyId).Add(TPair<TInt, TUInt64>(Val, RecId)); }
+    void IndexLinear(const int& KeyId, const int16& Val, const uint64& RecId) {
+        LinearInt16H.AddDat(KeyId).Add(TPair<TInt16, TUInt64>(Val, RecId)); }
+    void IndexLinear(const int& KeyId, const int64& Val, const uint64& RecId) {
+        LinearInt64H.AddDat(KeyId).Add(TPair<TInt64, TUInt64>(Val, RecId)); }
+    void IndexLinear(const int& KeyId, const uint& Val, const uint64& RecId) {
+        LinearUIntH.AddDat(KeyId).Add(TPair<TUInt, TUInt64>(Val, RecId)); }
+    void IndexLinear(const int& KeyId, const uint16& Val, const uint64& RecId) {
+        LinearUInt16H.AddDat(KeyId).Add(TPair<TUInt16, TUInt64>(Val, RecId)); }
+    void IndexLinear(const int& KeyId, const uint64& Val, const uint64& RecId) {
+        LinearUInt64H.AddDat(KeyId).Add(TPair<TUInt64, TUInt64>(Val, RecId)); }
+    void IndexLinear(const int& KeyId, const double& Val, const uint64& RecId) {
+        LinearFltH.AddDat(KeyId).Add(TPair<TFlt, TUInt64>(Val, RecId)); }
+    void IndexLinear(const int& KeyId, const float& Val, const uint64& RecId) {
+        LinearSFltH.AddDat(KeyId).Add(TPair<TSFlt, TUInt64>(Val, RecId)); }
 };
 
 ///////////////////////////////
@@ -3802,6 +4712,234 @@ public:
     void OnDelete(const TRec& Rec);
 };
 
+///////////////////////////////
+/// Write-ahead log entry
+class TWalEntry {
+public:
+    /// Log sequence number
+    TUInt64 Lsn;
+    /// Operation type
+    TWalOpType OpType;
+    /// Store on which the operation was executed
+    TUInt StoreId;
+    /// Operation parameters in JSon
+    TStr ValStr;
+};
+
+///////////////////////////////
+/// Write-ahead log.
+/// Append-only log of base mutations, stored next to the base files. Entries are
+/// buffered and written to disk in groups (group commit), once enough bytes are
+/// buffered, enough time passed since the last commit, or on explicit Commit(). Time
+/// since the last commit is checked by a background thread of the log, so entries are
+/// committed in time also when no new entries follow them.
+/// Commits are synced to disk, so committed entries survive also a power failure.
+/// Each entry is framed with its length and checksum, so a tail torn by a crash
+/// is detected and cut when the log is opened.
+///
+/// Base files are consistent only after a clean close or a checkpoint. A checkpoint
+/// writes all dirty data and store state to the base files and saves the sequence number
+/// of the last entry they include to a small manifest (Wal.checkpoint). The log is then
+/// truncated to the entries after it. Base is recovered by replaying the log entries
+/// after the checkpoint on the base files as they were at the checkpoint. Data flushed
+/// between checkpoints therefore does not change them: blob bases write changed blobs to
+/// new locations and reuse freed blobs only after the next checkpoint, paged files save
+/// the checkpoint version of overwritten pages to undo files. Background flusher keeps dirty data small,
+/// so a checkpoint mostly saves store and index state and does not hold up ingest.
+class TWal {
+private:
+    /// Smart pointer reference counter
+    TCRef CRef;
+    /// We are friends with smart pointer so it can access referenc coutner
+    friend class TPt<TWal>;
+    /// Scope maintains nesting depth
+    friend class TWalScope;
+    /// Commit thread reads group commit time limit
+    friend class TWalCommitter;
+
+    /// Magic number at the start of the log file
+    static const int MagicNum;
+
+    /// Base folder
+    TStr FPath;
+    /// Log file name
+    TStr FNm;
+    /// Log file, opened in append mode
+    TFOut* LogFOut;
+    /// Entries waiting to be committed
+    TMOut BufOut;
+    /// Sequence number of the last entry
+    TUInt64 Lsn;
+    /// Sequence number of the last entry included in the checkpoint
+    TUInt64 CheckpointLsn;
+    /// Entries not yet committed
+    TInt BufEntries;
+    /// Size of the log since the last checkpoint
+    TUInt64 LogBytes;
+    /// Protects the buffer and the log file, which are committed also by the commit thread
+    mutable TCriticalSection WalSection;
+    /// Thread committing entries which waited for commit long enough
+    PWalCommitter Committer;
+
+    /// Maximal size of buffered entries before commit
+    TInt GroupCommitBytes;
+    /// Maximal time since the last commit before commit
+    TInt GroupCommitMSecs;
+    /// Time of the last commit
+    TUInt64 LastCommitMSecs;
+    /// Size of the log after which checkpoint is due
+    TUInt64 CheckpointBytes;
+
+    /// Nesting depth of mutations
+    TInt Depth;
+    /// True when replaying the log, in which case nothing is logged
+    TBool ReplayP;
+    /// True when base was closed cleanly and log can be truncated
+    TBool CleanP;
+
+    /// Number of commits
+    TUInt64 Commits;
+    /// Number of committed bytes
+    TUInt64 CommitBytes;
+    /// Number of checkpoints
+    TUInt64 Checkpoints;
+
+    TWal(const TStr& _FPath, const int& _GroupCommitBytes, const int& _GroupCommitMSecs,
+        const uint64& _CheckpointBytes);
+
+    /// Get log file name for base located on a given path
+    static TStr GetWalFNm(const TStr& FPath) { return FPath + "Wal.log"; }
+    /// Get name of the checkpoint manifest for base located on a given path
+    static TStr GetManifestFNm(const TStr& FPath) { return FPath + "Wal.checkpoint"; }
+    /// Load sequence number of the last checkpoint. Returns false when there is none.
+    static bool LoadManifest(const TStr& FPath, uint64& Lsn);
+    /// Save sequence number of the last entry included in the base files
+    static void SaveManifest(const TStr& FPath, const uint64& Lsn);
+    /// Save log file header, entries following it start after StartLsn
+    static void SaveHeader(TSOut& SOut, const uint64& StartLsn);
+
+public:
+    /// Open write-ahead log of a base located in FPath. Torn entries at the end of the log are cut.
+    static PWal New(const TStr& FPath, const int& GroupCommitBytes = 64 * TInt::Kilo,
+        const int& GroupCommitMSecs = 100, const uint64& CheckpointBytes = 64 * (uint64)TInt::Mega) {
+            return new TWal(FPath, GroupCommitBytes, GroupCommitMSecs, CheckpointBytes); }
+    /// Stops the commit thread and commits pending entries. Truncates the log when base
+    /// was closed cleanly.
+    ~TWal();
+
+    /// Prepare base located in FPath for opening with write-ahead log. When log is missing,
+    /// base was closed cleanly and a new empty log is created. Otherwise base was not closed
+    /// cleanly and the entries after the last checkpoint need to be replayed on its files.
+    /// Returns true when the log needs to be replayed.
+    static bool Recover(const TStr& FPath);
+    /// Load log file header, returns false when it is missing or invalid
+    static bool LoadHeader(TSIn& SIn, uint64& StartLsn);
+    /// Read next entry from the log, returns false at the end or when entry is torn or corrupted
+    static bool LoadEntry(TSIn& SIn, const uint64& PrevLsn, TWalEntry& Entry);
+
+    /// Set group commit thresholds
+    void SetGroupCommit(const int& _GroupCommitBytes, const int& _GroupCommitMSecs) {
+        GroupCommitBytes = _GroupCommitBytes; GroupCommitMSecs = _GroupCommitMSecs; }
+    /// Set size of the log after which checkpoint is due
+    void SetCheckpointBytes(const uint64& _CheckpointBytes) { CheckpointBytes = _CheckpointBytes; }
+
+    /// Append new entry, commits when group commit threshold is reached
+    void Log(const TWalOpType& OpType, const uint& StoreId, const PJsonVal& Val);
+    /// Write all buffered entries to disk
+    void Commit();
+    /// Check if buffered entries waited for commit long enough
+    bool IsCommitDue() const;
+    /// Check if the log grew enough since the last checkpoint
+    bool IsCheckpointDue() const { return !ReplayP && LogBytes >= CheckpointBytes; }
+    /// Record that base files include all entries up to CheckpointLsn and truncate the log
+    /// to the entries after it. Base files must be saved before the call.
+    void Checkpoint(const uint64& _CheckpointLsn);
+
+    /// Get log file name
+    const TStr& GetFNm() const { return FNm; }
+    /// Get sequence number of the last entry
+    uint64 GetLsn() const { return Lsn; }
+    /// Get sequence number of the last entry included in the checkpoint
+    uint64 GetCheckpointLsn() const { return CheckpointLsn; }
+    /// Check if we are replaying the log
+    bool IsReplay() const { return ReplayP; }
+    /// Mark start or end of log replay
+    void SetReplay(const bool& _ReplayP) { ReplayP = _ReplayP; }
+    /// Mark base as closed cleanly, log is truncated when closed
+    void SetClean() { CleanP = true; }
+
+    /// Get statistics in JSon form
+    PJsonVal GetStats() const;
+};
+
+///////////////////////////////
+/// Query result cache.
+/// Keeps results of searches, keyed by the canonical description of the query tree
+/// (see TQueryItem::GetCacheKey). Results are taken before aggregation, sorting and
+/// limits, which are applied to a copy on each search. Each result remembers versions
+/// of the index keys and stores it was computed from, and is dropped on lookup when any
+/// of them was modified since. Cache is bounded by memory, least recently used results
+/// are dropped first.
+class TQueryCache {
+private:
+    /// Smart pointer reference counter
+    TCRef CRef;
+    /// We are friends with smart pointer so it can access referenc coutner
+    friend class TPt<TQueryCache>;
+
+    /// Cached result with versions of index keys and stores it depends on
+    class TItem {
+    private:
+        TCRef CRef;
+        friend class TPt<TItem>;
+    public:
+        /// Query result
+        PRecSet RecSet;
+        /// Versions of index keys at the time of search
+        TIntUInt64PrV KeyVerV;
+        /// Versions of stores at the time of search
+        TVec<TUIntUInt64Pr> StoreVerV;
+
+        /// Check if none of the dependencies was modified since the search
+        bool IsValid(const TWPt<TIndex>& Index) const;
+        /// Memory footprint
+        uint64 GetMemUsed() const;
+        /// Called by cache when dropped, nothing to do
+        void OnDelFromCache(const TStr& QueryKey, void* RefToBs) { }
+    };
+    typedef TPt<TItem> PItem;
+
+    /// Results by query key
+    TCache<TStr, PItem> Cache;
+    /// Serializes access to cache, concurrent searches share it
+    TCriticalSection CacheSection;
+
+    /// Number of searches answered from the cache
+    TUInt64 Hits;
+    /// Number of cacheable searches not found in the cache
+    TUInt64 Misses;
+    /// Number of results dropped since their index keys or stores were modified
+    TUInt64 Invalidations;
+
+    TQueryCache(const uint64& MxMemUsed): Cache((int64)MxMemUsed, 1024, NULL) { }
+
+public:
+    /// Create new cache using up to MxMemUsed bytes
+    static PQueryCache New(const uint64& MxMemUsed) { return new TQueryCache(MxMemUsed); }
+
+    /// Get result of the query with given key, false when not cached or outdated
+    bool Get(const TWPt<TIndex>& Index, const TStr& QueryKey, PRecSet& RecSet);
+    /// Remember result of the query with given key, together with current versions
+    /// of index keys and stores it depends on. Result must not be modified later.
+    void Put(const TWPt<TIndex>& Index, const TStr& QueryKey, const TIntSet& KeyIdSet,
+        const TUIntSet& StoreIdSet, const PRecSet& RecSet);
+    /// Remove all results
+    void Clr();
+
+    /// Get statistics in JSon form
+    PJsonVal GetStats();
+};
+
 ///////////////////////////////
 // QMiner-Base
 class TBase {
@@ -3811,6 +4949,16 @@ private:
     /// We are friends with smart pointer so it can access referenc coutner
     friend class TPt<TBase>;
 
+    /// Write-ahead log, when enabled. Declared first so it is destroyed after
+    /// all other base structures are saved.
+    PWal Wal;
+    /// Background flusher, when running
+    PBaseFlusher Flusher;
+    /// Flusher calls partial flush without committing the write-ahead log
+    friend class TBaseFlusher;
+    /// Cache of search results, when enabled
+    PQueryCache QueryCache;
+
     /// True after the base is initialized
     TBool InitP;
 
@@ -3838,11 +4986,41 @@ private:
     /// Name validates used for validating field, join and key names
     TNmValidator NmValidator;
 
+    /// True when readers can run concurrently with the writer
+    TBool ConcurrentP;
+    /// Held for reading by searches and other readers, and for writing by
+    /// operations changing the base, when in concurrent mode
+    TRWLock Lock;
+    /// Serializes concurrent readers of disk-stored fields, which go through
+    /// block caches and shared blob storage
+    TCriticalSection StoreCacheSection;
+
 private:
     /// Invert given record set (replace with all the records from the store that are not in it)
     PRecSet Invert(const PRecSet& RecSet);
     /// Execute search query. Returns results and a flag indicating if the results should be inverted.
     TPair<TBool, PRecSet> _Search(const TQueryItem& QueryItem);
+    /// Execute range query item against the linear index. Records are sorted by id, or
+    /// by value when ValSortP is set, in which case only the first Limit records are read.
+    PRecSet SearchRange(const TQueryItem& QueryItem, const bool& ValSortP = false,
+        const bool& SortAscP = true, const int& Limit = -1);
+    /// Execute query whose results can be read from a linear index already in the requested
+    /// order: a single range sorted by the field of its key. Returns false for other queries.
+    bool SearchSortedRange(const PQuery& Query, PRecSet& RecSet);
+    /// Execute query tree, reading and filling the query cache when enabled. CacheP is set
+    /// when the result comes from the cache, in which case it must be cloned before changing it.
+    PRecSet SearchQueryItem(const PQuery& Query, bool& CacheP);
+    /// Count records of range query item in the linear index. When ExistsP is set, returns 0 or 1.
+    uint64 CountRange(const TQueryItem& QueryItem, const bool& ExistsP);
+    /// Count records matching query item directly from the index: whole stores, ranges,
+    /// inverted index words and their conjunctions. Returns false for other queries.
+    /// When ExistsP is set, the count can stop at the first record.
+    bool CountIndex(const TQueryItem& QueryItem, const bool& ExistsP, uint64& Recs);
+    /// Independent index lookups under the same operator are evaluated in parallel
+    /// when they are expected to return at least this many records in total
+    static const int MnParallelSearchRecs;
+    /// Flush dirty data of stores and index for up to WndInMSec
+    int PartialFlushData(const int& WndInMSec);
 
     /// Get config name for base located on a given path
     static TStr GetConfFNm(const TStr& FPath) { return FPath + "Base.json"; }
@@ -3911,6 +5089,14 @@ public:
     /// Get store blob base
     const PBlobBs& GetStoreBlobBs() { return StoreBlobBs; }
 
+    /// Attach write-ahead log, all further mutations of the base are logged. Files saved by
+    /// the last checkpoint are kept unchanged from now on until the next checkpoint.
+    void SetWal(const PWal& _Wal);
+    /// Check if base has write-ahead log
+    bool IsWal() const { return !Wal.Empty(); }
+    /// Get write-ahead log
+    TWPt<TWal> GetWal() const { return TWPt<TWal>(Wal); }
+
     /// Check if base has stream aggregate with the given name
     bool IsStreamAggr(const TStr& StreamAggrNm) const;
     /// Register new stream aggregate to the base
@@ -3948,12 +5134,73 @@ public:
     PRecSet Search(const TStr& QueryStr);
     /// Searching records (default search interface)
     PRecSet Search(const PJsonVal& QueryVal);
+    /// Number of records matching the query, with its limit and offset applied. Sort and
+    /// aggregates are ignored. Queries the index can answer directly are counted without
+    /// building record sets.
+    uint64 SearchCount(const PQuery& Query);
+    /// Number of records matching the query
+    uint64 SearchCount(const PJsonVal& QueryVal);
+    /// Check if any record matches the query, stopping at the first one where possible
+    bool SearchExists(const PQuery& Query);
+    /// Check if any record matches the query
+    bool SearchExists(const PJsonVal& QueryVal);
+    /// Describe the plan chosen for executing the query
+    PJsonVal Explain(const PQuery& Query);
+    /// Describe the plan chosen for executing the query
+    PJsonVal Explain(const PJsonVal& QueryVal);
+    /// Cache results of searches using up to MxMemUsed bytes, zero disables the cache.
+    /// Cached results are dropped when records are added, updated or deleted in a way
+    /// that touches the index keys or stores they were computed from.
+    void SetQueryCache(const uint64& MxMemUsed);
+    /// Check if search results are cached
+    bool IsQueryCache() const { return !QueryCache.Empty(); }
 
     /// Execute garbage collection on all stores.
     /// Each store is given MxTimeMSecs for the collection.
     void GarbageCollect(const int& MxTimeMSecs = -1);
-    /// Perform partial flush of data
+    /// Perform partial flush of data. Commits write-ahead log when enabled, and takes
+    /// a checkpoint when the log grew enough since the last one.
     int PartialFlush(const int& WndInMSec = 500);
+    /// Write dirty data and state of all stores and the index, so base files are consistent,
+    /// and take write-ahead log checkpoint, after which the log is truncated. Changes are held
+    /// up until all the files are saved, since log entries can not be applied twice.
+    void Checkpoint();
+    /// Save list of stores, so they can be loaded when the base is opened again
+    void SaveStoreList() const;
+
+    /// Start background thread which flushes dirty data to disk. Every TickMSecs it
+    /// flushes for up to SliceMSecs, holding up base operations only for the duration
+    /// of flushing a single store or the index. Adding records blocks while the dirty
+    /// data exceeds MxDirtyBytes, until the flusher writes it out.
+    void StartFlusher(const int& TickMSecs = 100, const int& SliceMSecs = 10,
+        const uint64& MxDirtyBytes = 256 * (uint64)TInt::Mega);
+    /// Stop background flusher thread
+    void StopFlusher();
+    /// Check if background flusher is running
+    bool IsFlusher() const { return !Flusher.Empty(); }
+    /// Get background flusher
+    TWPt<TBaseFlusher> GetFlusher() const { return TWPt<TBaseFlusher>(Flusher); }
+    /// Size of data in stores and index changed since it was last flushed to disk
+    uint64 GetDirtyBytes();
+
+    /// Switch to concurrent mode, where many threads can read while one thread writes.
+    /// Searches lock the base on their own. Other reads from reader threads, like
+    /// record set operations and store field reads, must be done inside a TReadScope.
+    /// All writes must come from a single writer thread. Memory-stored fields are read
+    /// in parallel, while reads of disk-stored fields and inverted index lookups are
+    /// serialized. Must be called before starting background flusher.
+    void EnableConcurrency();
+    /// Check if base is in concurrent mode
+    bool IsConcurrent() const { return ConcurrentP; }
+    /// Get the base lock used by read and write scopes
+    TRWLock& GetLock() { return Lock; }
+    /// Get lock serializing reads of disk-stored fields in concurrent mode
+    TCriticalSection& GetStoreCacheSection() { return StoreCacheSection; }
+
+    /// Store child vectors of inverted indexes compressed. Setting is kept in base config.
+    void SetIndexCompress(const bool& CompressP) { Index->SetGixCompress(CompressP); }
+    /// Are child vectors of inverted indexes stored compressed
+    bool IsIndexCompress() const { return Index->IsGixCompress(); }
 
     /// asserts if a field name is valid
     void AssertValidNm(const TStr& FldNm) const { NmValidator.AssertValidNm(FldNm); }
@@ -3964,6 +5211,13 @@ public:
     bool SaveJSonDump(const TStr& DumpDir);
     /// Restore complete base from json
     bool RestoreJSonDump(const TStr& DumpDir);
+    /// Dump records and index joins of all stores to binary files. Fails before
+    /// writing anything when some of the stores do not support binary dumps.
+    void SaveBinDump(const TStr& DumpDir);
+    /// Restore empty stores from binary dump. Stores are loaded in parallel and
+    /// indexes are rebuilt using batches, record ids can be shifted when the first
+    /// free id of a store differs from the dump.
+    void RestoreBinDump(const TStr& DumpDir);
 
     /// Write store statistics to file
     void PrintStores(const TStr& FNm, const bool& FullP = false);
@@ -41,22 +41,120 @@ TVec<PRecSet> TRecSet::SplitBy(const TSplitter& Splitter) const {
 
 ///////////////////////////////
 // B-Tree Index
+template <class TVal>
+void TBTreeIndex<TVal>::TMemIndex::CopyTo(TBTreeIndex& Index) {
+    // empty tree has only the root
+    if (BTree.nLevels < 2) { return; }
+    TVec<TTreeVal> ValV;
+    TInt LeafId = BTree.first[BTree.nLevels - 1];
+    while (LeafId != -1) {
+        typename TMemLeafStore::TNode* Leaf = LeafStore->CheckOutNode(LeafId);
+        for (int KeyN = 0; KeyN < Leaf->v.Len(); KeyN++) {
+            ValV.Add(Leaf->v[KeyN].Key);
+        }
+        const TInt NextLeafId = Leaf->next;
+        LeafStore->CheckInNode(LeafId, Leaf, false);
+        LeafId = NextLeafId;
+    }
+    // leaves are already in sorted order
+    Index.BTree.AddSorted(ValV);
+}
+
+template <class TVal>
+TPt<TBTreeIndex<TVal> > TBTreeIndex<TVal>::New(const TPt<TMemIndex>& MemIndex, const PPgBlob& Blob,
+        TCriticalSection& BlobSection) {
+
+    TPt<TBTreeIndex> Index = New(Blob, BlobSection);
+    MemIndex->CopyTo(*Index);
+    return Index;
+}
+
 template <class TVal>
 void TBTreeIndex<TVal>::AddKey(const TVal& Val, const uint64& RecId) {
+    TLock Lock(TreeSection);
     BTree.Add(TTreeVal(Val, RecId));
 }
 
+template <class TVal>
+const int TBTreeIndex<TVal>::MnSortChunkVals = 1024 * 1024;
+
+template <class TVal>
+const int TBTreeIndex<TVal>::MxSortChunks = 16;
+
+template <class TVal>
+void TBTreeIndex<TVal>::SortValV(TVec<TTreeVal>& ValV) {
+    const int Vals = ValV.Len();
+    const int Chunks = TInt::GetMn(MxSortChunks, Vals / MnSortChunkVals);
+    if (Chunks <= 1) { ValV.Sort(); return; }
+    // chunk boundaries, chunk N spans [ChunkStartV[N], ChunkStartV[N+1])
+    TIntV ChunkStartV(Chunks + 1, 0);
+    for (int ChunkN = 0; ChunkN <= Chunks; ChunkN++) {
+        ChunkStartV.Add((int)(((int64)Vals * ChunkN) / Chunks));
+    }
+    #pragma omp parallel for schedule(dynamic)
+    for (int ChunkN = 0; ChunkN < Chunks; ChunkN++) {
+        TRnd Rnd; ValV.QSort(ChunkStartV[ChunkN], ChunkStartV[ChunkN + 1] - 1, true, Rnd);
+    }
+    // merge neighbouring runs of sorted chunks, doubling their width in each pass
+    TVec<TTreeVal> TmpV(Vals);
+    TVec<TTreeVal>* SrcV = &ValV; TVec<TTreeVal>* DstV = &TmpV;
+    for (int Width = 1; Width < Chunks; Width *= 2) {
+        const int Merges = (Chunks + 2 * Width - 1) / (2 * Width);
+        #pragma omp parallel for schedule(dynamic)
+        for (int MergeN = 0; MergeN < Merges; MergeN++) {
+            const int FirstChunkN = 2 * Width * MergeN;
+            const int MidValN = ChunkStartV[TInt::GetMn(FirstChunkN + Width, Chunks)];
+            const int EndValN = ChunkStartV[TInt::GetMn(FirstChunkN + 2 * Width, Chunks)];
+            int ValN1 = ChunkStartV[FirstChunkN], ValN2 = MidValN, DstValN = ValN1;
+            while (ValN1 < MidValN && ValN2 < EndValN) {
+                (*DstV)[DstValN++] = ((*SrcV)[ValN2] < (*SrcV)[ValN1]) ? (*SrcV)[ValN2++] : (*SrcV)[ValN1++];
+            }
+            while (ValN1 < MidValN) { (*DstV)[DstValN++] = (*SrcV)[ValN1++]; }
+            while (ValN2 < EndValN) { (*DstV)[DstValN++] = (*SrcV)[ValN2++]; }
+        }
+        TVec<TTreeVal>* TmpSrcV = SrcV; SrcV = DstV; DstV = TmpSrcV;
+    }
+    if (SrcV != &ValV) { ValV.Swap(TmpV); }
+}
+
+template <class TVal>
+void TBTreeIndex<TVal>::AddKeyV(TVec<TPair<TVal, TUInt64> >& ValRecIdV) {
+    SortValV(ValRecIdV);
+    TLock Lock(TreeSection);
+    if (BTree.nLevels == 1) {
+        // empty tree, build it bottom-up
+        BTree.AddSorted(ValRecIdV);
+    } else {
+        // sorted order keeps consecutive additions in the same leaves
+        for (int ValN = 0; ValN < ValRecIdV.Len(); ValN++) {
+            BTree.Add(ValRecIdV[ValN]);
+        }
+    }
+}
+
 template <class TVal>
 void TBTreeIndex<TVal>::DelKey(const TVal& Val, const uint64& RecId) {
+    TLock Lock(TreeSection);
     BTree.Del(TTreeVal(Val, RecId));
 }
 
+template <class TVal>
+void TBTreeIndex<TVal>::DelKeyV(TVec<TPair<TVal, TUInt64> >& ValRecIdV) {
+    SortValV(ValRecIdV);
+    TLock Lock(TreeSection);
+    // sorted order keeps consecutive deletions in the same leaves
+    for (int ValN = 0; ValN < ValRecIdV.Len(); ValN++) {
+        BTree.Del(ValRecIdV[ValN]);
+    }
+}
+
 template <class TVal>
 void TBTreeIndex<TVal>::SearchRange(const TPair<TVal, TVal>& RangeMinMax, TUInt64V& RecIdV) const {
 
     TVec<TTreeVal> ResValRecIdV;
     // execute query
-    BTree.RangeQuery(TTreeVal(RangeMinMax.Val1, 0), TTreeVal(RangeMinMax.Val2, TUInt64::Mx), ResValRecIdV);
+    { TLock Lock(TreeSection);
+      BTree.RangeQuery(TTreeVal(RangeMinMax.Val1, 0), TTreeVal(RangeMinMax.Val2, TUInt64::Mx), ResValRecIdV); }
     // parse out record ids
     RecIdV.Gen(ResValRecIdV.Len(), 0);
     for (int ResN = 0; ResN < ResValRecIdV.Len(); ResN++) {
@@ -64,6 +162,173 @@ void TBTreeIndex<TVal>::SearchRange(const TPair<TVal, TVal>& RangeMinMax, TUInt6
     }
 }
 
+template <class TVal>
+void TBTreeIndex<TVal>::SearchRange(const TPair<TVal, TVal>& RangeMinMax, const bool& SortAscP,
+        const int& Limit, TUInt64V& RecIdV) const {
+
+    TVec<TTreeVal> ResValRecIdV;
+    // execute query, reading leaf entries only until we have enough
+    { TLock Lock(TreeSection);
+      BTree.RangeQuery(TTreeVal(RangeMinMax.Val1, 0), TTreeVal(RangeMinMax.Val2, TUInt64::Mx),
+          SortAscP, Limit, ResValRecIdV); }
+    // parse out record ids, keeping the order of values
+    RecIdV.Gen(ResValRecIdV.Len(), 0);
+    for (int ResN = 0; ResN < ResValRecIdV.Len(); ResN++) {
+        RecIdV.Add(ResValRecIdV[ResN].Val2);
+    }
+}
+
+template <class TVal>
+uint64 TBTreeIndex<TVal>::GetRangeRecs(const TPair<TVal, TVal>& RangeMinMax, const bool& ExistsP) const {
+    const TTreeVal MinVal(RangeMinMax.Val1, 0), MaxVal(RangeMinMax.Val2, TUInt64::Mx);
+    TLock Lock(TreeSection);
+    // leaf entries are only visited, not copied
+    if (ExistsP) { return BTree.IsKeyInRange(MinVal, MaxVal) ? 1 : 0; }
+    return (uint64)BTree.RangeCount(MinVal, MaxVal);
+}
+
+template <class TVal>
+double TBTreeIndex<TVal>::GetRangeFrac(const TPair<TVal, TVal>& RangeMinMax) const {
+    TLock Lock(TreeSection);
+    return BTree.GetRangeFrac(TTreeVal(RangeMinMax.Val1, 0), TTreeVal(RangeMinMax.Val2, TUInt64::Mx));
+}
+
+///////////////////////////////
+/// QMiner Index
+template <class TVal>
+double TIndex::GetBTreeRangeFrac(const THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH,
+        const int& KeyId, const TPair<TVal, TVal>& RangeMinMax) const {
+
+    TWPt<TBTreeIndex<TVal> > BTreeIndex;
+    {
+        TLock BTreeLock(BTreeSection);
+        if (!BTreeIndexH.IsKey(KeyId)) { return 0.0; }
+        BTreeIndex = BTreeIndexH.GetDat(KeyId);
+    }
+    return BTreeIndex->GetRangeFrac(RangeMinMax);
+}
+
+template <class TVal>
+TWPt<TBTreeIndex<TVal> > TIndex::GetBTreeIndex(const THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH,
+        const int& KeyId) {
+
+    TLock BTreeLock(BTreeSection);
+    if (LinearBatchN > 0) { FlushLinearBatch(); }
+    if (!BTreeIndexH.IsKey(KeyId)) { return TWPt<TBTreeIndex<TVal> >(); }
+    return BTreeIndexH.GetDat(KeyId);
+}
+
+template <class TVal>
+uint64 TIndex::GetBTreeRangeRecs(const THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH,
+        const int& KeyId, const TPair<TVal, TVal>& RangeMinMax, const bool& ExistsP) {
+
+    TWPt<TBTreeIndex<TVal> > BTreeIndex = GetBTreeIndex(BTreeIndexH, KeyId);
+    return BTreeIndex.Empty() ? 0 : BTreeIndex->GetRangeRecs(RangeMinMax, ExistsP);
+}
+
+template <class TQmGixItem>
+uint64 TIndex::GetGixAndRecs(const TPt<TGix<TQmGixKey, TQmGixItem> >& Gix,
+        const TKeyWordV& KeyWordV, const bool& ExistsP) const {
+
+    typedef TPt<TGixItemSet<TQmGixKey, TQmGixItem> > PQmGixItemSet;
+    // merged item sets hold each record once, order them by length
+    TVec<PQmGixItemSet> ItemSetV(KeyWordV.Len(), 0); TIntPrV ItemsSetNV(KeyWordV.Len(), 0);
+    for (const TKeyWord& KeyWord : KeyWordV) {
+        PQmGixItemSet ItemSet = Gix->GetItemSet(KeyWord);
+        if (ItemSet->Empty()) { return 0; }
+        ItemSet->Def();
+        if (ItemSet->Empty()) { return 0; }
+        ItemsSetNV.Add(TIntPr(ItemSet->GetItems(), ItemSetV.Len()));
+        ItemSetV.Add(ItemSet);
+    }
+    // single key is answered by the length of its item set
+    if (ItemSetV.Len() == 1) { return ExistsP ? 1 : (uint64)ItemsSetNV[0].Val1; }
+    ItemsSetNV.Sort();
+    // shortest item set gives the candidates, which are looked up in the longer ones;
+    // existence is checked on chunks of candidates, stopping at the first match
+    TVec<TQmGixItem> CandItemV; ItemSetV[ItemsSetNV[0].Val2]->GetItemV(CandItemV);
+    const int ChunkLen = ExistsP ? GixExistsChunkLen : CandItemV.Len();
+    uint64 Recs = 0;
+    for (int ChunkStartN = 0; ChunkStartN < CandItemV.Len(); ChunkStartN += ChunkLen) {
+        const int ChunkEndN = TInt::GetMn(ChunkStartN + ChunkLen, CandItemV.Len());
+        TVec<TQmGixItem> ItemV; CandItemV.GetSubValV(ChunkStartN, ChunkEndN - 1, ItemV);
+        for (int SetN = 1; SetN < ItemsSetNV.Len() && !ItemV.Empty(); SetN++) {
+            TVec<TQmGixItem> IntrsItemV;
+            ItemSetV[ItemsSetNV[SetN].Val2]->GetIntrsItemV(ItemV, IntrsItemV);
+            ItemV.MoveFrom(IntrsItemV);
+        }
+        Recs += ItemV.Len();
+        if (ExistsP && Recs > 0) { return 1; }
+    }
+    return Recs;
+}
+
+template <class TVal>
+void TIndex::LoadBTreeIndexH(TSIn& SIn, THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH) {
+    const int Keys = TInt(SIn);
+    for (int KeyN = 0; KeyN < Keys; KeyN++) {
+        const TInt KeyId(SIn);
+        BTreeIndexH.AddDat(KeyId, TBTreeIndex<TVal>::Load(SIn, BTreeBlob, BTreeBlobSection));
+    }
+}
+
+template <class TVal>
+void TIndex::LoadMemBTreeIndexH(TSIn& SIn, THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH) {
+    THash<TInt, TPt<typename TBTreeIndex<TVal>::TMemIndex> > MemIndexH(SIn);
+    int KeyId = MemIndexH.FFirstKeyId();
+    while (MemIndexH.FNextKeyId(KeyId)) {
+        BTreeIndexH.AddDat(MemIndexH.GetKey(KeyId),
+            TBTreeIndex<TVal>::New(MemIndexH[KeyId], BTreeBlob, BTreeBlobSection));
+    }
+}
+
+template <class TVal>
+void TIndex::FlushBTreeBatchH(THash<TInt, TVec<TPair<TVal, TUInt64> > >& BatchH,
+        THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH) {
+
+    int BatchKeyId = BatchH.FFirstKeyId();
+    while (BatchH.FNextKeyId(BatchKeyId)) {
+        const int KeyId = BatchH.GetKey(BatchKeyId);
+        if (!BTreeIndexH.IsKey(KeyId)) { BTreeIndexH.AddDat(KeyId, TBTreeIndex<TVal>::New(BTreeBlob, BTreeBlobSection)); }
+        BTreeIndexH.GetDat(KeyId)->AddKeyV(BatchH[BatchKeyId]);
+    }
+    BatchH.Clr();
+}
+
+template <class TVal>
+void TIndex::FlushBTreeDelBatchH(THash<TInt, TVec<TPair<TVal, TUInt64> > >& BatchH,
+        THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH) {
+
+    int BatchKeyId = BatchH.FFirstKeyId();
+    while (BatchH.FNextKeyId(BatchKeyId)) {
+        const int KeyId = BatchH.GetKey(BatchKeyId);
+        if (BTreeIndexH.IsKey(KeyId)) { BTreeIndexH.GetDat(KeyId)->DelKeyV(BatchH[BatchKeyId]); }
+    }
+    BatchH.Clr();
+}
+
+template <class TVal>
+void TIndex::AddBTreeBatchH(const THash<TInt, TVec<TPair<TVal, TUInt64> > >& NewBatchH,
+        THash<TInt, TVec<TPair<TVal, TUInt64> > >& BatchH) {
+
+    int NewBatchKeyId = NewBatchH.FFirstKeyId();
+    while (NewBatchH.FNextKeyId(NewBatchKeyId)) {
+        const int KeyId = NewBatchH.GetKey(NewBatchKeyId);
+        TouchKey(KeyId);
+        BatchH.AddDat(KeyId).AddV(NewBatchH[NewBatchKeyId]);
+    }
+}
+
+template <class TVal>
+void TIndex::SaveBTreeIndexH(TSOut& SOut, const THash<TInt, TPt<TBTreeIndex<TVal> > >& BTreeIndexH) {
+    TInt(BTreeIndexH.Len()).Save(SOut);
+    int KeyId = BTreeIndexH.FFirstKeyId();
+    while (BTreeIndexH.FNextKeyId(KeyId)) {
+        BTreeIndexH.GetKey(KeyId).Save(SOut);
+        BTreeIndexH[KeyId]->Save(SOut);
+    }
+}
+
 ///////////////////////////////
 /// QMiner Index Frequency Summation Item Handler
 template <class TQmGixItem>
@@ -99,6 +364,43 @@ void TIndex::TQmGixSumItemHandler<TQmGixItem>::Merge(TVec<TQmGixItem>& ItemV, co
     }
 }
 
+///////////////////////////////
+/// QMiner Index Compressing Item Handler
+template <class TQmGixItem, class TQmGixItemHandler>
+bool TIndex::TQmGixCompressItemHandler<TQmGixItem, TQmGixItemHandler>::IsCompressible(
+        const TVec<TQmGixItem>& ItemV) const {
+
+    for (int ItemN = 1; ItemN < ItemV.Len(); ItemN++) {
+        if (GetGixItemRecId(ItemV[ItemN]) < GetGixItemRecId(ItemV[ItemN - 1])) { return false; }
+    }
+    return true;
+}
+
+template <class TQmGixItem, class TQmGixItemHandler>
+void TIndex::TQmGixCompressItemHandler<TQmGixItem, TQmGixItemHandler>::SaveCompressed(
+        const TVec<TQmGixItem>& ItemV, TSOut& SOut) const {
+
+    uint64 PrevRecId = 0;
+    for (const TQmGixItem& Item : ItemV) {
+        const uint64 RecId = GetGixItemRecId(Item);
+        TGixVarInt::SaveUInt64(SOut, RecId - PrevRecId);
+        SaveGixItemDat(Item, SOut);
+        PrevRecId = RecId;
+    }
+}
+
+template <class TQmGixItem, class TQmGixItemHandler>
+void TIndex::TQmGixCompressItemHandler<TQmGixItem, TQmGixItemHandler>::LoadCompressed(
+        TSIn& SIn, const int& Items, TVec<TQmGixItem>& ItemV) const {
+
+    uint64 RecId = 0; TQmGixItem Item;
+    for (int ItemN = 0; ItemN < Items; ItemN++) {
+        RecId += TGixVarInt::LoadUInt64(SIn);
+        LoadGixItem(SIn, RecId, Item);
+        ItemV.Add(Item);
+    }
+}
+
 ///////////////////////////////
 /// QMiner Index Frequency Summation Merger
 template <class TQmGixItem, class TQmGixResItem>
@@ -126,6 +428,23 @@ template <class TQmGixItem, class TQmGixResItem>
 void TIndex::TQmGixSumMerger<TQmGixItem, TQmGixResItem>::Intrs(
         TVec<TQmGixResItem>& MainV, const TVec<TQmGixResItem>& JoinV) const {
 
+    // when one side is much shorter, gallop through the longer one
+    const TVec<TQmGixResItem>& ShortV = (MainV.Len() < JoinV.Len()) ? MainV : JoinV;
+    const TVec<TQmGixResItem>& LongV = (MainV.Len() < JoinV.Len()) ? JoinV : MainV;
+    if (ShortV.Len() * 16 < LongV.Len()) {
+        auto IsLt = [](const TQmGixResItem& Val1, const TQmGixResItem& Val2) { return Val1 < Val2; };
+        TVec<TQmGixResItem> ResV(ShortV.Len(), 0); int LongN = 0;
+        for (const TQmGixResItem& Val : ShortV) {
+            LongN = TGixGallop::GetFirstNotLt(LongV, Val, LongN, IsLt);
+            if (LongN == LongV.Len()) { break; }
+            if (!(Val < LongV[LongN])) {
+                ResV.Add(TQmGixResItem(Val.Key, Val.Dat + LongV[LongN].Dat)); LongN++;
+            }
+        }
+        MainV = ResV;
+        return;
+    }
+
     TVec<TQmGixResItem> ResV; int ValN1 = 0; int ValN2 = 0;
     while ((ValN1 < MainV.Len()) && (ValN2 < JoinV.Len())) {
         const TQmGixResItem& Val1 = MainV.GetVal(ValN1);
@@ -334,6 +334,8 @@ TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) :
         }
         // parse block size
         BlockSizeMem = MAX(1, options->GetObjInt("block_size_mem", BlockSizeMem));
+        // compression of blocks saved to disk
+        BlockCompressP = options->GetObjBool("block_compression", BlockCompressP);
     }
     // get id (optional)
     if (StoreVal->IsObjKey("id")) {
@@ -422,6 +424,16 @@ TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) :
         // set time duration in milliseconds
         const uint64 FactorMSecs = Maps.TimeWindowUnitMap.GetDat(UnitStr);
         WndDesc.WindowSize = WindowSize * FactorMSecs;
+        // get segment length, when records expire in whole time segments
+        if (TimeWindow->IsObjKey("segment")) {
+            PJsonVal Segment = TimeWindow->GetObjKey("segment");
+            QmAssertR(Segment->IsObj() && Segment->IsObjKey("duration"), "Bad timeWindow segment parameter.");
+            TStr SegmentUnitStr = Segment->GetObjStr("unit", "second");
+            QmAssertR(Maps.TimeWindowUnitMap.IsKey(SegmentUnitStr),
+                "Unsupported timeWindow segment length unit type: " + SegmentUnitStr);
+            WndDesc.SegmentSize = Segment->GetObjUInt64("duration") * Maps.TimeWindowUnitMap.GetDat(SegmentUnitStr);
+            QmAssertR(WndDesc.SegmentSize > 0, "Segment length must be positive.");
+        }
         // get field giving the tact for time
         if (TimeWindow->IsObjKey("field")) {
             WndDesc.TimeFieldNm = TimeWindow->GetObjStr("field");
@@ -441,6 +453,28 @@ TStoreSchema::TStoreSchema(const TWPt<TBase>& Base, const PJsonVal& StoreVal) :
             WndDesc.InsertP = true;
         }
     }
+
+    // parse hot window of tiered storage
+    if (StoreVal->IsObjKey("hotWindow")) {
+        PJsonVal HotWindow = StoreVal->GetObjKey("hotWindow");
+        QmAssertR(HotWindow->IsObj(), "Bad hotWindow parameter.");
+        if (HotWindow->IsObjKey("records")) {
+            // window defined by number of newest records
+            HotWndDesc.Recs = HotWindow->GetObjUInt64("records");
+            QmAssertR(HotWndDesc.Recs > 0, "Hot window must keep at least one record.");
+        } else {
+            // window defined by time span
+            QmAssertR(HotWindow->IsObjKey("duration"), "Missing hotWindow records or duration parameter.");
+            TStr UnitStr = HotWindow->GetObjStr("unit", "second");
+            QmAssertR(Maps.TimeWindowUnitMap.IsKey(UnitStr),
+                "Unsupported hotWindow length unit type: " + UnitStr);
+            HotWndDesc.Duration = HotWindow->GetObjUInt64("duration") * Maps.TimeWindowUnitMap.GetDat(UnitStr);
+            QmAssertR(HotWndDesc.Duration > 0, "Hot window duration must be positive.");
+            // use time field of the store window, unless given
+            HotWndDesc.TimeFieldNm = HotWindow->GetObjStr("field", WndDesc.TimeFieldNm);
+            QmAssertR(!HotWndDesc.TimeFieldNm.Empty(), "Missing hotWindow time field.");
+        }
+    }
 }
 
 void TStoreSchema::ParseSchema(const TWPt<TBase>& Base, const PJsonVal& SchemaVal, TStoreSchemaV& SchemaV) {
@@ -510,6 +544,34 @@ void TStoreSchema::ValidateSchema(const TWPt<TBase>& Base, TStoreSchemaV& Schema
                 " should be used as the source for window is store " + StoreName +
                 ", but it is nullable.");
         }
+        // check that time segments are used only where supported
+        if (Schema.WndDesc.IsSegmented()) {
+            QmAssertR(Schema.StoreType != "paged" && Schema.StoreType != "columnar",
+                "Time segments are not supported for " + Schema.StoreType + " store " + StoreName);
+            QmAssertR(Schema.JoinDescExV.Empty(),
+                "Time segments are not supported for store " + StoreName + " with joins");
+            // dropped segments are removed from inverted index posting lists without
+            // reading the records, which is not possible for linear and location keys
+            for (const TIndexKeyEx& IndexKeyEx : Schema.IndexKeyExV) {
+                QmAssertR(!IndexKeyEx.IsLinear() && !IndexKeyEx.IsLocation(), "Time segments are not supported "
+                    "for store " + StoreName + " with " + IndexKeyEx.GetKeyType() + " key " + IndexKeyEx.KeyIndexName);
+            }
+        }
+        // check that hot window is used only where supported
+        if (Schema.HotWndDesc.IsTiered()) {
+            QmAssertR(Schema.StoreType != "paged" && Schema.StoreType != "columnar",
+                "Hot window is not supported for " + Schema.StoreType + " store " + StoreName);
+        }
+        if (Schema.HotWndDesc.IsTime()) {
+            const TStr& HotFieldName = Schema.HotWndDesc.TimeFieldNm;
+            QmAssertR(Schema.FieldH.IsKey(HotFieldName), "Field " + HotFieldName +
+                " should be used as the source for hot window in store " + StoreName +
+                ", but it doesn't exist.");
+            const TFieldDesc& FieldDesc = Schema.FieldH.GetDat(HotFieldName);
+            QmAssertR(FieldDesc.IsTm() && !FieldDesc.IsNullable(), "Field " + HotFieldName +
+                " should be used as the source for hot window in store " + StoreName +
+                ", but it is not a non-nullable datetime field.");
+        }
         // joins
         TStrH JoinNameH;
         for (int JoinN = 0; JoinN < Schema.JoinDescExV.Len(); JoinN++){
@@ -542,10 +604,25 @@ void TStoreSchema::ValidateSchema(const TWPt<TBase>& Base, TStoreSchemaV& Schema
     }
 }
 
+///////////////////////////////
+// Hot window description
+void THotWndDesc::Save(TSOut& SOut) const {
+    Recs.Save(SOut);
+    Duration.Save(SOut);
+    TimeFieldNm.Save(SOut);
+}
+
+void THotWndDesc::Load(TSIn& SIn) {
+    Recs.Load(SIn);
+    Duration.Load(SIn);
+    TimeFieldNm.Load(SIn);
+}
+
 ///////////////////////////////
 // In-memory storage
-TInMemStorage::TInMemStorage(const TStr& _FNm, const PBlobBs& _BlobStorage, const int& _BlockSize):
-    FNm(_FNm), Access(faCreate), BlobStorage(_BlobStorage), BlockSize(_BlockSize) { }
+TInMemStorage::TInMemStorage(const TStr& _FNm, const PBlobBs& _BlobStorage, const int& _BlockSize,
+    const bool& _CompressP): FNm(_FNm), Access(faCreate), BlobStorage(_BlobStorage),
+        BlockSize(_BlockSize), CompressP(_CompressP) { }
 
 TInMemStorage::TInMemStorage(const TStr& _FNm, const PBlobBs& _BlobStorage, const TFAccess& _FAccess,
         const bool& LazyP): FNm(_FNm), Access(_FAccess), BlobStorage(_BlobStorage) {
@@ -559,6 +636,8 @@ TInMemStorage::TInMemStorage(const TStr& _FNm, const PBlobBs& _BlobStorage, cons
     FirstValOffset.Load(FIn);
     FirstValOffsetMem.Load(FIn);
     BlockSize.Load(FIn);
+    // compression flag is missing in storages created before block compression
+    if (!FIn.Eof()) { CompressP.Load(FIn); }
 
     for (int64 i = 0; i < cnt; i++) {
         ValV.Add(); // empty (non-loaded) data
@@ -570,28 +649,41 @@ TInMemStorage::TInMemStorage(const TStr& _FNm, const PBlobBs& _BlobStorage, cons
 }
 
 TInMemStorage::~TInMemStorage() {
-    if (Access != faRdOnly) {
-        // store dirty vectors
-        for (int i = 0; i < ValV.Len(); i++) {
-            SaveRec(i);
-        }
-        // save vector
-        TFOut FOut(FNm);
-        BlobPtV.Save(FOut);
-        // save rest
-        TInt64(ValV.Len()).Save(FOut);
-        FirstValOffset.Save(FOut);
-        FirstValOffsetMem.Save(FOut);
-        BlockSize.Save(FOut);
+    Flush();
+}
+
+void TInMemStorage::Flush() {
+    if (Access == faRdOnly) { return; }
+    // store dirty vectors
+    for (int i = 0; i < ValV.Len(); i++) {
+        SaveRec(i);
     }
+    // save vector
+    TFOut FOut(FNm);
+    BlobPtV.Save(FOut);
+    // save rest
+    TInt64(ValV.Len()).Save(FOut);
+    FirstValOffset.Save(FOut);
+    FirstValOffsetMem.Save(FOut);
+    BlockSize.Save(FOut);
+    CompressP.Save(FOut);
 }
 
 /// Utility method for loading specific record
 void TInMemStorage::LoadRec(int64 RecN) const {
     if (DirtyV[RecN] != isdfNotLoaded) { return; }
     const int64 ii = RecN / BlockSize;
+    // remember demoted blocks loaded back, so the next demotion drops them again
+    if (FirstValOffsetMem + (uint64)RecN < HotValId) {
+        ColdBlockV.Add(FirstValOffsetMem + (uint64)(ii * BlockSize));
+        ColdLoads++;
+    }
     TMem mem;
-    TMem::LoadMem(BlobStorage->GetBlob(BlobPtV[ii]), mem);
+    if (CompressP) {
+        TLz::LoadDecompressed(BlobStorage->GetBlob(BlobPtV[ii]), mem);
+    } else {
+        TMem::LoadMem(BlobStorage->GetBlob(BlobPtV[ii]), mem);
+    }
     PSIn in = mem.GetSIn();
     for (int64 j = ii*BlockSize; j < DirtyV.Len() && j < (ii + 1)*BlockSize; j++) {
         if (DirtyV[j] == isdfNotLoaded) {
@@ -616,16 +708,20 @@ int TInMemStorage::SaveRec(int RecN) {
             TMOut mem;
             for (int j = ii*BlockSize; j < DirtyV.Len() && j < (ii + 1)*BlockSize; j++) {
                 ValV[j].Save(mem);
+                if (DirtyV[j] == isdfNew || DirtyV[j] == isdfDirty) { DirtyBytes.Val -= ValV[j].Len(); }
                 DirtyV[j] = isdfClean;
             }
             while (BlobPtV.Len() <= ii) {
                 BlobPtV.Add();
             }
+            RawBlockBytes += (uint64)mem.Len();
+            PSIn BlockSIn = CompressP ? TLz::GetCompressedSIn(mem.GetBfAddr(), mem.Len()) : mem.GetSIn();
+            StoredBlockBytes += (uint64)BlockSIn->Len();
             if (BlobPtV[ii].Empty()) {
-                BlobPtV[ii] = BlobStorage->PutBlob(mem.GetSIn());
+                BlobPtV[ii] = BlobStorage->PutBlob(BlockSIn);
             } else {
                 int ReleasedSize;
-                BlobPtV[ii] = BlobStorage->PutBlob(BlobPtV[ii], mem.GetSIn(), ReleasedSize);
+                BlobPtV[ii] = BlobStorage->PutBlob(BlobPtV[ii], BlockSIn, ReleasedSize);
             }
         }
         break;
@@ -651,9 +747,16 @@ void TInMemStorage::GetVal(const uint64& ValId, TMem& Val) const {
     Val = ValV[i];
 }
 
+const TMem& TInMemStorage::GetValRef(const uint64& ValId) const {
+    uint64 i = ValId - FirstValOffsetMem;
+    LoadRec(i);
+    return ValV[i];
+}
+
 uint64 TInMemStorage::AddVal(const TMem& Val) {
     uint64 res = ValV.Add(Val);
     DirtyV.Add(isdfNew);
+    DirtyBytes.Val += Val.Len();
     if (ValV.Len() % BlockSize == 1) {
         BlobPtV.Add();
     }
@@ -662,8 +765,13 @@ uint64 TInMemStorage::AddVal(const TMem& Val) {
 
 void TInMemStorage::SetVal(const uint64& ValId, const TMem& Val) {
     AssertReadOnly();
-    ValV[ValId - FirstValOffsetMem] = Val;
+    // block must be loaded, since it is saved as a whole
+    LoadRec(ValId - FirstValOffsetMem);
+    TMem& OldVal = ValV[ValId - FirstValOffsetMem];
     uchar& flag = DirtyV[ValId - FirstValOffsetMem];
+    if (flag == isdfNew || flag == isdfDirty) { DirtyBytes.Val -= OldVal.Len(); }
+    DirtyBytes.Val += Val.Len();
+    OldVal = Val;
     if (flag == isdfNew) { } // new remains new
     else { flag = isdfDirty; } // set as dirty
 }
@@ -672,7 +780,9 @@ void TInMemStorage::DelVals(int Vals) {
     if (Vals > 0) {
         int ValsTrue = 0;
         for (ValsTrue = 0; ValsTrue < Vals && ValsTrue + (int64)FirstValOffset.Val<ValV.Len(); ValsTrue++) {
-            ValV[ValsTrue + FirstValOffset].Clr();
+            const int64 ValN = ValsTrue + FirstValOffset;
+            if (DirtyV[ValN] == isdfNew || DirtyV[ValN] == isdfDirty) { DirtyBytes.Val -= ValV[ValN].Len(); }
+            ValV[ValN].Clr();
         }
         int blocks_to_delete = ((int)FirstValOffset + ValsTrue) / BlockSize;
         int vals_to_delete = blocks_to_delete * BlockSize;
@@ -708,7 +818,8 @@ int TInMemStorage::PartialFlush(int WndInMsec) {
     TTmStopWatch sw(true);
     int res = 0;
     for (int i = 0; i< ValV.Len(); i++) {
-        if (sw.GetMSecInt() > WndInMsec)
+        // always save at least one value, so short windows still make progress
+        if (res > 0 && sw.GetMSecInt() > WndInMsec)
             break;
         res += SaveRec(i);
     }
@@ -721,6 +832,317 @@ void TInMemStorage::LoadAll() {
     }
 }
 
+void TInMemStorage::LoadFrom(const uint64& ValId) {
+    const int64 FirstBlockN = (ValId > FirstValOffsetMem) ? (int64)((ValId - FirstValOffsetMem) / BlockSize) : 0;
+    HotValId = FirstValOffsetMem + (uint64)(FirstBlockN * BlockSize);
+    for (int64 ValN = FirstBlockN * BlockSize; ValN < ValV.Len(); ValN++) {
+        LoadRec(ValN);
+    }
+}
+
+bool TInMemStorage::DemoteBlock(const int64& BlockN) {
+    const int64 FirstValN = BlockN * BlockSize;
+    const int64 EndValN = MIN(FirstValN + BlockSize, ValV.Len());
+    // block is saved as a whole when any of its values is dirty
+    for (int64 ValN = FirstValN; ValN < EndValN; ValN++) {
+        SaveRec((int)ValN);
+    }
+    bool DemotedP = false;
+    for (int64 ValN = FirstValN; ValN < EndValN; ValN++) {
+        if (DirtyV[ValN] == isdfClean) {
+            ValV[ValN].Clr();
+            DirtyV[ValN] = isdfNotLoaded;
+            DemotedP = true;
+        }
+    }
+    return DemotedP;
+}
+
+int TInMemStorage::Demote(const uint64& ValId) {
+    AssertReadOnly();
+    if (ValV.Empty()) { return 0; }
+    // last block can still receive new values, so it always stays in memory
+    const int64 LastBlockN = (ValV.Len() - 1) / BlockSize;
+    const int64 EndBlockN = (ValId > FirstValOffsetMem) ?
+        MIN((int64)((ValId - FirstValOffsetMem) / BlockSize), LastBlockN) : 0;
+    const int64 HotBlockN = (HotValId > FirstValOffsetMem) ?
+        (int64)((HotValId - FirstValOffsetMem) / BlockSize) : 0;
+    int Blocks = 0;
+    // blocks which left the hot window since the last demotion
+    for (int64 BlockN = HotBlockN; BlockN < EndBlockN; BlockN++) {
+        if (DemoteBlock(BlockN)) { Blocks++; }
+    }
+    // demoted blocks loaded back by reads
+    for (int BlockN = 0; BlockN < ColdBlockV.Len(); BlockN++) {
+        const uint64 BlockValId = ColdBlockV[BlockN];
+        if (BlockValId < FirstValOffsetMem) { continue; }
+        const int64 ColdBlockN = (int64)((BlockValId - FirstValOffsetMem) / BlockSize);
+        if (ColdBlockN < HotBlockN && DemoteBlock(ColdBlockN)) { Blocks++; }
+    }
+    ColdBlockV.Clr();
+    HotValId = MAX(HotValId.Val, FirstValOffsetMem + (uint64)(EndBlockN * BlockSize));
+    DemotedBlocks += (uint64)Blocks;
+    return Blocks;
+}
+
+///////////////////////////////
+// Record buffer cache
+TRecMemCache::TRecMemCache(const int& Slots): RecIdV(Slots), RecMemV(Slots) {
+    QmAssert(Slots > 0);
+    RecIdV.PutAll(TUInt64::Mx);
+}
+
+const TMem* TRecMemCache::Get(const uint64& RecId) {
+    const int SlotN = GetSlotN(RecId);
+    if (RecIdV[SlotN] == RecId) { Hits++; return &RecMemV[SlotN]; }
+    Misses++; return NULL;
+}
+
+TMem& TRecMemCache::Add(const uint64& RecId) {
+    const int SlotN = GetSlotN(RecId);
+    RecIdV[SlotN] = RecId;
+    return RecMemV[SlotN];
+}
+
+void TRecMemCache::Del(const uint64& RecId) {
+    const int SlotN = GetSlotN(RecId);
+    if (RecIdV[SlotN] == RecId) {
+        RecIdV[SlotN] = TUInt64::Mx;
+        RecMemV[SlotN].Clr();
+    }
+}
+
+void TRecMemCache::Clr() {
+    RecIdV.PutAll(TUInt64::Mx);
+    for (int SlotN = 0; SlotN < RecMemV.Len(); SlotN++) { RecMemV[SlotN].Clr(); }
+}
+
+///////////////////////////////
+// Primary key index
+const uint64 TPrimaryIndex::EmptyRecId = TUInt64::Mx;
+const int64 TPrimaryIndex::MnSlots = 16;
+const int TPrimaryIndex::HashTagBits = 16;
+
+uint64 TPrimaryIndex::GetHash(uint64 Key) {
+    // finalizer of splitmix64
+    Key = (Key ^ (Key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    Key = (Key ^ (Key >> 27)) * 0x94d049bb133111ebULL;
+    return Key ^ (Key >> 31);
+}
+
+uint TPrimaryIndex::GetStrHash(const char* Bf, const int& BfL) {
+    // FNV-1a
+    uint Hash = 2166136261u;
+    for (int ChN = 0; ChN < BfL; ChN++) {
+        Hash = (Hash ^ (uchar)Bf[ChN]) * 16777619u;
+    }
+    return Hash;
+}
+
+uint TPrimaryIndex::GetPoolHash(const int64& Offset) const {
+    uint Hash; memcpy(&Hash, PoolV.BegI() + Offset, sizeof(uint));
+    return Hash;
+}
+
+int64 TPrimaryIndex::GetHomeSlotN(const int64& SlotN) const {
+    const uint64 Key = SlotV[2*SlotN];
+    const uint64 Hash = StrP ? GetHash(GetPoolHash((int64)(Key >> HashTagBits))) : GetHash(Key);
+    return (int64)(Hash & (uint64)(GetSlots() - 1));
+}
+
+int64 TPrimaryIndex::FindSlotN(const uint64& Key) const {
+    Assert(!StrP);
+    if (SlotV.Empty()) { return -1; }
+    const uint64 Mask = (uint64)(GetSlots() - 1);
+    for (uint64 SlotN = GetHash(Key) & Mask; !IsSlotEmpty(SlotN); SlotN = (SlotN + 1) & Mask) {
+        if (SlotV[2*SlotN] == Key) { return (int64)SlotN; }
+    }
+    return -1;
+}
+
+int64 TPrimaryIndex::FindStrSlotN(const TStr& Str) const {
+    Assert(StrP);
+    if (SlotV.Empty()) { return -1; }
+    const int StrLen = Str.Len();
+    const uint StrHash = GetStrHash(Str.CStr(), StrLen);
+    const uint64 Tag = StrHash & ((1 << HashTagBits) - 1);
+    const uint64 Mask = (uint64)(GetSlots() - 1);
+    for (uint64 SlotN = GetHash(StrHash) & Mask; !IsSlotEmpty(SlotN); SlotN = (SlotN + 1) & Mask) {
+        const uint64 Key = SlotV[2*SlotN];
+        if ((Key & ((1 << HashTagBits) - 1)) != Tag) { continue; }
+        // compare full hash, length and characters
+        const char* EntryBf = PoolV.BegI() + (int64)(Key >> HashTagBits);
+        int EntryLen; memcpy(&EntryLen, EntryBf + sizeof(uint), sizeof(int));
+        if (GetPoolHash((int64)(Key >> HashTagBits)) == StrHash && EntryLen == StrLen &&
+                memcmp(EntryBf + sizeof(uint) + sizeof(int), Str.CStr(), StrLen) == 0) {
+            return (int64)SlotN;
+        }
+    }
+    return -1;
+}
+
+void TPrimaryIndex::PutSlot(const uint64& Key, const uint64& RecId, const uint64& Hash) {
+    const uint64 Mask = (uint64)(GetSlots() - 1);
+    uint64 SlotN = Hash & Mask;
+    while (!IsSlotEmpty(SlotN)) { SlotN = (SlotN + 1) & Mask; }
+    SlotV[2*SlotN] = Key; SlotV[2*SlotN + 1] = RecId;
+    Keys++;
+}
+
+void TPrimaryIndex::DelSlot(int64 SlotN) {
+    if (StrP) {
+        // leave string in the pool, it is dropped on the next rebuild
+        const int64 Offset = (int64)(SlotV[2*SlotN] >> HashTagBits);
+        int EntryLen; memcpy(&EntryLen, PoolV.BegI() + Offset + sizeof(uint), sizeof(int));
+        PoolGarbage += (int64)(sizeof(uint) + sizeof(int)) + EntryLen;
+    }
+    // shift back following keys which would no longer be found past the emptied slot
+    const int64 Mask = GetSlots() - 1;
+    int64 NextSlotN = SlotN;
+    forever {
+        NextSlotN = (NextSlotN + 1) & Mask;
+        if (IsSlotEmpty(NextSlotN)) { break; }
+        const int64 HomeSlotN = GetHomeSlotN(NextSlotN);
+        // key can stay when its home is cyclically in (SlotN, NextSlotN]
+        const bool StayP = (SlotN <= NextSlotN) ?
+            (SlotN < HomeSlotN && HomeSlotN <= NextSlotN) :
+            (SlotN < HomeSlotN || HomeSlotN <= NextSlotN);
+        if (StayP) { continue; }
+        SlotV[2*SlotN] = SlotV[2*NextSlotN];
+        SlotV[2*SlotN + 1] = SlotV[2*NextSlotN + 1];
+        SlotN = NextSlotN;
+    }
+    SlotV[2*SlotN] = 0; SlotV[2*SlotN + 1] = EmptyRecId;
+    Keys--;
+    // drop deleted strings once they take more than half of the pool
+    if (StrP && PoolGarbage > 1024 && 2 * PoolGarbage > PoolV.Len()) {
+        Rebuild(GetSlots(), 0);
+    }
+}
+
+void TPrimaryIndex::Reserve() {
+    // keep load below 70%
+    if (10 * (Keys + 1) > 7 * GetSlots()) {
+        Rebuild(TMath::Mx<int64>(MnSlots, 2 * GetSlots()), 0);
+    }
+}
+
+void TPrimaryIndex::Rebuild(const int64& Slots, const uint64& MnRecId) {
+    Assert(Slots > 0 && (Slots & (Slots - 1)) == 0);
+    TVec<TUInt64, int64> OldSlotV; OldSlotV.Swap(SlotV);
+    TVec<char, int64> OldPoolV; OldPoolV.Swap(PoolV);
+    SlotV.Gen(2 * Slots);
+    for (int64 SlotN = 0; SlotN < Slots; SlotN++) { SlotV[2*SlotN + 1] = EmptyRecId; }
+    if (StrP) { PoolV.Gen(OldPoolV.Len() - PoolGarbage, 0); }
+    Keys = 0; PoolGarbage = 0;
+    for (int64 SlotN = 0; SlotN < OldSlotV.Len() / 2; SlotN++) {
+        const uint64 RecId = OldSlotV[2*SlotN + 1];
+        if (RecId == EmptyRecId || RecId < MnRecId) { continue; }
+        const uint64 Key = OldSlotV[2*SlotN];
+        if (StrP) {
+            // copy string to the new pool
+            const int64 OldOffset = (int64)(Key >> HashTagBits);
+            const char* EntryBf = OldPoolV.BegI() + OldOffset;
+            uint Hash; memcpy(&Hash, EntryBf, sizeof(uint));
+            int EntryLen; memcpy(&EntryLen, EntryBf + sizeof(uint), sizeof(int));
+            const int64 EntrySize = (int64)(sizeof(uint) + sizeof(int)) + EntryLen;
+            const int64 Offset = PoolV.Len();
+            PoolV.Reserve(PoolV.Reserved(), Offset + EntrySize);
+            memcpy(PoolV.BegI() + Offset, EntryBf, EntrySize);
+            PutSlot(((uint64)Offset << HashTagBits) | (Key & ((1 << HashTagBits) - 1)), RecId, GetHash(Hash));
+        } else {
+            PutSlot(Key, RecId, GetHash(Key));
+        }
+    }
+}
+
+void TPrimaryIndex::Load(TSIn& SIn) {
+    StrP.Load(SIn); Keys.Load(SIn); PoolGarbage.Load(SIn);
+    TInt64 SlotVals; SlotVals.Load(SIn);
+    SlotV.Gen(SlotVals);
+    if (SlotVals > 0) { SIn.LoadBf(SlotV.BegI(), SlotVals * sizeof(TUInt64)); }
+    TInt64 PoolLen; PoolLen.Load(SIn);
+    PoolV.Gen(PoolLen);
+    if (PoolLen > 0) { SIn.LoadBf(PoolV.BegI(), PoolLen); }
+}
+
+void TPrimaryIndex::Save(TSOut& SOut) const {
+    StrP.Save(SOut); Keys.Save(SOut); PoolGarbage.Save(SOut);
+    TInt64(SlotV.Len()).Save(SOut);
+    if (!SlotV.Empty()) { SOut.SaveBf(SlotV.BegI(), SlotV.Len() * sizeof(TUInt64)); }
+    TInt64(PoolV.Len()).Save(SOut);
+    if (!PoolV.Empty()) { SOut.SaveBf(PoolV.BegI(), PoolV.Len()); }
+}
+
+uint64 TPrimaryIndex::GetFltKey(const double& Flt) {
+    // negative zero is equal to zero, so it must give the same key
+    const double Val = (Flt == 0.0) ? 0.0 : Flt;
+    uint64 Key; memcpy(&Key, &Val, sizeof(uint64));
+    return Key;
+}
+
+uint64 TPrimaryIndex::GetRecId(const uint64& Key) const {
+    const int64 SlotN = FindSlotN(Key);
+    return (SlotN != -1) ? SlotV[2*SlotN + 1].Val : TUInt64::Mx;
+}
+
+void TPrimaryIndex::AddKey(const uint64& Key, const uint64& RecId) {
+    Assert(RecId != EmptyRecId);
+    const int64 SlotN = FindSlotN(Key);
+    if (SlotN != -1) { SlotV[2*SlotN + 1] = RecId; return; }
+    Reserve();
+    PutSlot(Key, RecId, GetHash(Key));
+}
+
+void TPrimaryIndex::DelKey(const uint64& Key) {
+    const int64 SlotN = FindSlotN(Key);
+    if (SlotN != -1) { DelSlot(SlotN); }
+}
+
+uint64 TPrimaryIndex::GetStrRecId(const TStr& Str) const {
+    const int64 SlotN = FindStrSlotN(Str);
+    return (SlotN != -1) ? SlotV[2*SlotN + 1].Val : TUInt64::Mx;
+}
+
+void TPrimaryIndex::AddStrKey(const TStr& Str, const uint64& RecId) {
+    Assert(RecId != EmptyRecId);
+    const int64 SlotN = FindStrSlotN(Str);
+    if (SlotN != -1) { SlotV[2*SlotN + 1] = RecId; return; }
+    Reserve();
+    // append string to the pool
+    const int StrLen = Str.Len();
+    const uint Hash = GetStrHash(Str.CStr(), StrLen);
+    const int64 Offset = PoolV.Len();
+    const int64 EntrySize = (int64)(sizeof(uint) + sizeof(int)) + StrLen;
+    if (Offset + EntrySize > PoolV.Reserved()) {
+        PoolV.Reserve(TMath::Mx<int64>(2 * PoolV.Reserved(), Offset + EntrySize));
+    }
+    PoolV.Reserve(PoolV.Reserved(), Offset + EntrySize);
+    char* EntryBf = PoolV.BegI() + Offset;
+    memcpy(EntryBf, &Hash, sizeof(uint));
+    memcpy(EntryBf + sizeof(uint), &StrLen, sizeof(int));
+    memcpy(EntryBf + sizeof(uint) + sizeof(int), Str.CStr(), StrLen);
+    PutSlot(((uint64)Offset << HashTagBits) | (Hash & ((1 << HashTagBits) - 1)), RecId, GetHash(Hash));
+}
+
+void TPrimaryIndex::DelStrKey(const TStr& Str) {
+    const int64 SlotN = FindStrSlotN(Str);
+    if (SlotN != -1) { DelSlot(SlotN); }
+}
+
+void TPrimaryIndex::DelRecIdsBefore(const uint64& RecId) {
+    if (Keys > 0) { Rebuild(GetSlots(), RecId); }
+}
+
+void TPrimaryIndex::Clr() {
+    SlotV.Clr(); PoolV.Clr();
+    Keys = 0; PoolGarbage = 0;
+}
+
+uint64 TPrimaryIndex::GetMemUsed() const {
+    return sizeof(TPrimaryIndex) + (uint64)SlotV.Reserved() * sizeof(TUInt64) + (uint64)PoolV.Reserved();
+}
+
 ///////////////////////////////
 // Field serialization parameters
 void TRecSerializator::TFieldSerialDesc::Save(TSOut& SOut) const {
@@ -751,6 +1173,8 @@ void TRecSerializator::TFieldSerialDesc::Load(TSIn& SIn) {
 const char TRecSerializator::ToastNo = 'n';
 /// Flag if field is TOAST-ed
 const char TRecSerializator::ToastYes = 'y';
+/// Marks string vector stored as codebook ids
+const int TRecSerializator::CodebookStrVMarker = -1;
 
 ///////////////////////////////
 // Serialization and de-serialization of records to TMem
@@ -1305,7 +1729,17 @@ void TRecSerializator::SetFieldStrV(TMem& RecMem, TMOut& SOut,
     SetLocationVar(RecMem, FieldSerialDesc, VarContentOffset);
     // update value
     if (UseToast) { SOut.PutCh(ToastNo); }
-    StrV.Save(SOut);
+    if (FieldSerialDesc.CodebookP) {
+        // store codebook ids, prefixed by marker
+        TIntV StrIdV(StrV.Len(), 0);
+        for (int StrN = 0; StrN < StrV.Len(); StrN++) {
+            StrIdV.Add(CodebookH.AddKey(StrV[StrN]));
+        }
+        SOut.Save(CodebookStrVMarker);
+        TInt::SaveFrugalIntV(SOut, StrIdV);
+    } else {
+        StrV.Save(SOut);
+    }
     // Perform TOAST-ing if needed
     CheckToast(SOut, VarContentOffset);
 }
@@ -1574,6 +2008,30 @@ void TRecSerializator::Save(TSOut& SOut) {
     MxToastLen.Save(SOut);
 }
 
+void TRecSerializator::SaveLayout(TSOut& SOut) const {
+    TInt(TargetStorage).Save(SOut);
+    FixedPartOffset.Save(SOut);
+    VarIndexPartOffset.Save(SOut);
+    VarContentPartOffset.Save(SOut);
+    FieldSerialDescV.Save(SOut);
+    FieldIdToSerialDescIdH.Save(SOut);
+    UseToast.Save(SOut);
+    MxToastLen.Save(SOut);
+}
+
+void TRecSerializator::LoadCodebook(TSIn& SIn) {
+    TStrHash<TInt, TBigStrPool> DumpCodebookH; DumpCodebookH.Load(SIn);
+    // existing strings must keep their ids, since values can already refer to them
+    QmAssertR(CodebookH.Len() <= DumpCodebookH.Len(), "Codebook does not match binary dump");
+    for (int StrId = 0; StrId < CodebookH.Len(); StrId++) {
+        QmAssertR(TStr(CodebookH.GetKey(StrId)) == DumpCodebookH.GetKey(StrId), "Codebook does not match binary dump");
+    }
+    // new strings get consecutive ids, same as in the dump
+    for (int StrId = CodebookH.Len(); StrId < DumpCodebookH.Len(); StrId++) {
+        QmAssertR(CodebookH.AddKey(DumpCodebookH.GetKey(StrId)) == StrId, "Codebook does not match binary dump");
+    }
+}
+
 void TRecSerializator::Serialize(const PJsonVal& RecVal, TMem& RecMem, const TWPt<TStore>& Store) {
     // Reserve fixed space - null map, fixed fields and var-field indexes
     TMem FixedMem(VarContentPartOffset);
@@ -1634,6 +2092,100 @@ void TRecSerializator::Serialize(const PJsonVal& RecVal, TMem& RecMem, const TWP
     Merge(FixedMem, VarSOut, RecMem);
 }
 
+void TRecSerializator::SetFixedRecVal(TMemBase& RecMem, const TFieldSerialDesc& FieldSerialDesc,
+        const TFieldDesc& FieldDesc, const TRecBuilder& Rec) {
+
+    const int FieldId = FieldSerialDesc.FieldId;
+    // call type-appropriate setter
+    switch (FieldDesc.GetFieldType()) {
+        case oftByte: SetFieldByte(RecMem, FieldSerialDesc, Rec.GetFieldByte(FieldId)); break;
+        case oftInt: SetFieldInt(RecMem, FieldSerialDesc, Rec.GetFieldInt(FieldId)); break;
+        case oftInt16: SetFieldInt16(RecMem, FieldSerialDesc, Rec.GetFieldInt16(FieldId)); break;
+        case oftInt64: SetFieldInt64(RecMem, FieldSerialDesc, Rec.GetFieldInt64(FieldId)); break;
+        case oftUInt: SetFieldUInt(RecMem, FieldSerialDesc, Rec.GetFieldUInt(FieldId)); break;
+        case oftUInt16: SetFieldUInt16(RecMem, FieldSerialDesc, Rec.GetFieldUInt16(FieldId)); break;
+        case oftUInt64: SetFieldUInt64(RecMem, FieldSerialDesc, Rec.GetFieldUInt64(FieldId)); break;
+        // this string should be encoded using a codebook
+        case oftStr: SetFieldStr(RecMem, FieldSerialDesc, Rec.GetFieldStr(FieldId)); break;
+        case oftBool: SetFieldBool(RecMem, FieldSerialDesc, Rec.GetFieldBool(FieldId)); break;
+        case oftFlt: SetFieldFlt(RecMem, FieldSerialDesc, Rec.GetFieldFlt(FieldId)); break;
+        case oftSFlt: SetFieldSFlt(RecMem, FieldSerialDesc, Rec.GetFieldSFlt(FieldId)); break;
+        case oftFltPr: SetFieldFltPr(RecMem, FieldSerialDesc, Rec.GetFieldFltPr(FieldId)); break;
+        case oftTm: SetFieldTmMSecs(RecMem, FieldSerialDesc, Rec.GetFieldTmMSecs(FieldId)); break;
+        default:
+            throw TQmExcept::New("Unsupported data type for DB storage (fixed part): " + FieldDesc.GetFieldTypeStr());
+    }
+}
+
+void TRecSerializator::SetVarRecVal(TMem& RecMem, TMOut& SOut, const TFieldSerialDesc& FieldSerialDesc,
+        const TFieldDesc& FieldDesc, const TRecBuilder& Rec) {
+
+    const int FieldId = FieldSerialDesc.FieldId;
+    // call type-appropriate setter
+    switch (FieldDesc.GetFieldType()) {
+        case oftIntV: SetFieldIntV(RecMem, SOut, FieldSerialDesc, Rec.GetFieldIntV(FieldId)); break;
+        case oftStr: SetFieldStr(RecMem, SOut, FieldSerialDesc, Rec.GetFieldStr(FieldId)); break;
+        case oftStrV: SetFieldStrV(RecMem, SOut, FieldSerialDesc, Rec.GetFieldStrV(FieldId)); break;
+        case oftFltV: SetFieldFltV(RecMem, SOut, FieldSerialDesc, Rec.GetFieldFltV(FieldId)); break;
+        case oftNumSpV: SetFieldNumSpV(RecMem, SOut, FieldSerialDesc, Rec.GetFieldNumSpV(FieldId)); break;
+        case oftTMem: SetFieldTMem(RecMem, SOut, FieldSerialDesc, Rec.GetFieldTMem(FieldId)); break;
+        case oftJson: SetFieldJsonVal(RecMem, SOut, FieldSerialDesc, Rec.GetFieldJsonVal(FieldId)); break;
+        default:
+            throw TQmExcept::New("Unsupported data type for DB storage (variable part) - " + FieldDesc.GetFieldTypeStr());
+    }
+}
+
+void TRecSerializator::Serialize(const TRecBuilder& Rec, TMem& RecMem, const TWPt<TStore>& Store) {
+    // Reserve fixed space - null map, fixed fields and var-field indexes
+    TMem FixedMem(VarContentPartOffset);
+    // Overwrite fixed part with zeros to start with
+    FixedMem.GenZeros(VarContentPartOffset);
+    // Prepare output stream for storing variable width values
+    TMOut VarSOut;
+
+    // iterate over fields and serialize them, same semantics as for JSon
+    for (int FieldSerialDescId = 0; FieldSerialDescId < FieldSerialDescV.Len(); FieldSerialDescId++) {
+        const TFieldSerialDesc& FieldSerialDesc = FieldSerialDescV[FieldSerialDescId];
+        const int FieldId = FieldSerialDesc.FieldId;
+        const TFieldDesc& FieldDesc = Store->GetFieldDesc(FieldId);
+        if (!Rec.IsFieldSet(FieldId)) {
+            if (FieldId == Rec.GetInsertedAtFieldId()) {
+                // system field, always set to current time
+                SetFieldTmMSecs(FixedMem, FieldSerialDesc, TTm::GetCurUniMSecs());
+            } else if (!FieldSerialDesc.DefaultVal.Empty()) {
+                // use the provided default value
+                if (FieldSerialDesc.FixedPartP) {
+                    SetFixedJsonVal(FixedMem, FieldSerialDesc, FieldDesc, FieldSerialDesc.DefaultVal);
+                } else {
+                    SetVarJsonVal(FixedMem, VarSOut, FieldSerialDesc, FieldDesc, FieldSerialDesc.DefaultVal);
+                }
+            } else if (FieldDesc.IsNullable()) {
+                // value not provided and object is nullable, so we set it to NULL
+                SetFieldNull(FixedMem, FieldSerialDesc, true);
+                if (!FieldSerialDesc.FixedPartP) {
+                    SetLocationVar(FixedMem, FieldSerialDesc, VarSOut.Len());
+                }
+            } else {
+                // report missing field value since no other option available
+                throw TQmExcept::New("Record is missing field - expecting " + FieldDesc.GetFieldNm() + ", store " + Store->GetStoreNm());
+            }
+        } else if (Rec.IsFieldNull(FieldId)) {
+            // builder already checked the field is nullable
+            SetFieldNull(FixedMem, FieldSerialDesc, true);
+            if (!FieldSerialDesc.FixedPartP) {
+                SetLocationVar(FixedMem, FieldSerialDesc, VarSOut.Len());
+            }
+        } else if (FieldSerialDesc.FixedPartP) {
+            SetFixedRecVal(FixedMem, FieldSerialDesc, FieldDesc, Rec);
+        } else {
+            SetVarRecVal(FixedMem, VarSOut, FieldSerialDesc, FieldDesc, Rec);
+        }
+    }
+
+    // merge fixed and variable parts for final result
+    Merge(FixedMem, VarSOut, RecMem);
+}
+
 void TRecSerializator::SerializeUpdateInPlace(const PJsonVal& RecVal,
     TThinMIn MIn, const TWPt<TStore>& Store, TIntSet& ChangedFieldIdSet) {
 
@@ -1798,16 +2350,31 @@ TStr TRecSerializator::GetFieldStr(TThinMIn& min, const int& FieldId) const {
 }
 
 void TRecSerializator::GetFieldStrV(TThinMIn& min, const int& FieldId, TStrV& StrV) const {
-    min.MoveTo(GetOffsetVar(min, GetFieldSerialDesc(FieldId)));
+    const TFieldSerialDesc& FieldSerialDesc = GetFieldSerialDesc(FieldId);
+    min.MoveTo(GetOffsetVar(min, FieldSerialDesc));
     if (UseToast && min.GetCh() == ToastYes) {
         TPgBlobPt Pt;
         min.GetBf(&Pt, sizeof(TPgBlobPt));
         TMem Mem;
         Toaster->UnToastVal(Pt, Mem);
         TThinMIn min2(Mem);
-        StrV.Load(min2);
+        LoadStrV(min2, FieldSerialDesc, StrV);
     } else {
-        StrV.Load(min);
+        LoadStrV(min, FieldSerialDesc, StrV);
+    }
+}
+
+void TRecSerializator::LoadStrV(TThinMIn& min, const TFieldSerialDesc& FieldSerialDesc, TStrV& StrV) const {
+    if (!FieldSerialDesc.CodebookP) { StrV.Load(min); return; }
+    // codebook flag was ignored for string vectors in older stores,
+    // so the value can still be a plain string vector
+    TThinMIn PeekMIn(min);
+    if (TInt(PeekMIn).Val != CodebookStrVMarker) { StrV.Load(min); return; }
+    min = PeekMIn;
+    TIntV StrIdV; TInt::LoadFrugalIntV(min, StrIdV);
+    StrV.Gen(StrIdV.Len(), 0);
+    for (int StrIdN = 0; StrIdN < StrIdV.Len(); StrIdN++) {
+        StrV.Add(CodebookH.GetKey(StrIdV[StrIdN]));
     }
 }
 
@@ -2383,7 +2950,7 @@ void TRecSerializator::SetFieldJsonVal(const TMemBase& InRecMem,
 int TRecSerializator::GetCodebookId(const int& FieldId, const TStr& Str) const {
     const TFieldSerialDesc& FieldSerialDesc = GetFieldSerialDesc(FieldId);
     // make sure we are in the codebook park
-    QmAssertR(FieldSerialDesc.FixedPartP, TStr::Fmt("[TRecSerializator::GetCodebookId]: Field %d not in codebook", FieldId));
+    QmAssertR(FieldSerialDesc.CodebookP, TStr::Fmt("[TRecSerializator::GetCodebookId]: Field %d not in codebook", FieldId));
     // return string from codebook
     return CodebookH.GetKeyId(Str);
 }
@@ -2425,74 +2992,75 @@ TStr TRecIndexer::TFieldIndexKey::GetKeyType() const {
                        "linear";
 }
 
-void TRecIndexer::IndexKey(const TFieldIndexKey& Key, const TMemBase& RecMem,
+template <class TTarget>
+void TRecIndexer::IndexKey(TTarget& Target, const TFieldIndexKey& Key, const TMemBase& RecMem,
         const uint64& RecId, TRecSerializator& Serializator) {
 
     // check the type of field and value to select indexing procedure
     if (Key.FieldType == oftStr && Key.IsValue()){
         // inverted index over non-tokenized strings
         TStr Str = Serializator.GetFieldStr(RecMem, Key.FieldId);
-        Index->IndexValue(Key.KeyId, Str, RecId);
+        Target.IndexValue(Key.KeyId, Str, RecId);
     } else if (Key.FieldType == oftStr && Key.IsText()) {
         // inverted index over tokenized strings
         TStr Str = Serializator.GetFieldStr(RecMem, Key.FieldId);
-        Index->IndexText(Key.KeyId, Str, RecId);
+        Target.IndexText(Key.KeyId, Str, RecId);
     } else if (Key.FieldType == oftStr && Key.IsTextPos()) {
         // inverted index over tokenized strings with position information
         TStr Str = Serializator.GetFieldStr(RecMem, Key.FieldId);
-        Index->IndexTextPos(Key.KeyId, Str, RecId);
+        Target.IndexTextPos(Key.KeyId, Str, RecId);
     } else if (Key.FieldType == oftStrV && Key.IsValue()) {
         // inverted index over string array
         TStrV StrV; Serializator.GetFieldStrV(RecMem, Key.FieldId, StrV);
-        Index->IndexValue(Key.KeyId, StrV, RecId);
+        Target.IndexValue(Key.KeyId, StrV, RecId);
     } else if (Key.FieldType == oftTm && Key.IsValue()) {
         // time indexed as timestamp string
         const uint64 TmMSecs = Serializator.GetFieldTmMSecs(RecMem, Key.FieldId);
-        Index->IndexValue(Key.KeyId, TUInt64::GetStr(TmMSecs), RecId);
+        Target.IndexValue(Key.KeyId, TUInt64::GetStr(TmMSecs), RecId);
     } else if (Key.FieldType == oftFltPr && Key.IsLocation()) {
         // index geo-location using geo-index
         TFltPr FltPr = Serializator.GetFieldFltPr(RecMem, Key.FieldId);
-        Index->IndexGeo(Key.KeyId, FltPr, RecId);
+        Target.IndexGeo(Key.KeyId, FltPr, RecId);
     } else if (Key.FieldType == oftByte && Key.IsLinear()) {
         // index integer value using btree
         const uchar Byte = Serializator.GetFieldByte(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, Byte, RecId);
+        Target.IndexLinear(Key.KeyId, Byte, RecId);
     } else if (Key.FieldType == oftInt && Key.IsLinear()) {
         // index integer value using btree
         const int Int = Serializator.GetFieldInt(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, Int, RecId);
+        Target.IndexLinear(Key.KeyId, Int, RecId);
     } else if (Key.FieldType == oftInt16 && Key.IsLinear()) {
         // index integer value using btree
         const int16 Int = Serializator.GetFieldInt16(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, Int, RecId);
+        Target.IndexLinear(Key.KeyId, Int, RecId);
     } else if (Key.FieldType == oftInt64 && Key.IsLinear()) {
         // index integer value using btree
         const int64 Int = Serializator.GetFieldInt64(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, Int, RecId);
+        Target.IndexLinear(Key.KeyId, Int, RecId);
     } else if (Key.FieldType == oftUInt && Key.IsLinear()) {
         // index uint64 value using btree
         const uint UInt = Serializator.GetFieldUInt(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, UInt, RecId);
+        Target.IndexLinear(Key.KeyId, UInt, RecId);
     } else if (Key.FieldType == oftUInt16 && Key.IsLinear()) {
         // index uint64 value using btree
         const uint16 UInt16 = Serializator.GetFieldUInt16(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, UInt16, RecId);
+        Target.IndexLinear(Key.KeyId, UInt16, RecId);
     } else if (Key.FieldType == oftUInt64 && Key.IsLinear()) {
         // index uint64 value using btree
         const uint64 UInt64 = Serializator.GetFieldUInt64(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, UInt64, RecId);
+        Target.IndexLinear(Key.KeyId, UInt64, RecId);
     } else if (Key.FieldType == oftTm && Key.IsLinear()) {
         // index datetime value using btree
         const uint64 TmMSecs = Serializator.GetFieldTmMSecs(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, TmMSecs, RecId);
+        Target.IndexLinear(Key.KeyId, TmMSecs, RecId);
     } else if (Key.FieldType == oftFlt && Key.IsLinear()) {
         // index float value using btree
         const double Flt = Serializator.GetFieldFlt(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, Flt, RecId);
+        Target.IndexLinear(Key.KeyId, Flt, RecId);
     } else if (Key.FieldType == oftSFlt && Key.IsLinear()) {
         // index float value using btree
         const float SFlt = Serializator.GetFieldSFlt(RecMem, Key.FieldId);
-        Index->IndexLinear(Key.KeyId, SFlt, RecId);
+        Target.IndexLinear(Key.KeyId, SFlt, RecId);
     } else {
         ErrorLog(TStr::Fmt("[TFieldIndexer::IndexKey] Unsupported field and index type combination: %s[%s]: %s",
             Key.FieldNm.CStr(), Key.FieldTypeStr.CStr(), Key.GetKeyType().CStr()));
@@ -2703,7 +3271,7 @@ void TRecIndexer::ProcessKey(const TFieldIndexKey& Key, const TMemBase& OldRecMe
     const bool NewNullP = Serializator.IsFieldNull(NewRecMem, Key.FieldId);
     if (OldNullP && !NewNullP) {
         // if no value before, just index
-        IndexKey(Key, NewRecMem, RecId, Serializator);
+        IndexKey(*Index, Key, NewRecMem, RecId, Serializator);
     } else if (!OldNullP && NewNullP) {
         // no new value, just deindex
         DeindexKey(Key, OldRecMem, RecId, Serializator);
@@ -2747,7 +3315,7 @@ void TRecIndexer::IndexRec(const TMemBase& RecMem, const uint64& RecId, TRecSeri
         // check if field is not NULL (e.g. there is something to index)
         if (Serializator.IsFieldNull(RecMem, Key.FieldId)) { continue; }
         // index the key
-        IndexKey(Key, RecMem, RecId, Serializator);
+        IndexKey(*Index, Key, RecMem, RecId, Serializator);
     }
 }
 
@@ -2764,6 +3332,49 @@ void TRecIndexer::DeindexRec(const TMemBase& RecMem, const uint64& RecId, TRecSe
     }
 }
 
+void TRecIndexer::IndexRecV(const TVec<TMem>& RecMemV, const TUInt64V& RecIdV, TRecSerializator& Serializator) {
+    Assert(RecMemV.Len() == RecIdV.Len());
+    // keys are indexed one at a time for the whole batch, same as in DeindexRecV
+    for (int FieldIndexKeyN = 0; FieldIndexKeyN < FieldIndexKeyV.Len(); FieldIndexKeyN++) {
+        const TFieldIndexKey& Key = FieldIndexKeyV[FieldIndexKeyN];
+        if (!Serializator.IsFieldId(Key.FieldId)) { continue; }
+        for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+            if (Serializator.IsFieldNull(RecMemV[RecN], Key.FieldId)) { continue; }
+            IndexKey(*Index, Key, RecMemV[RecN], RecIdV[RecN], Serializator);
+        }
+    }
+}
+
+void TRecIndexer::IndexRecV(const TVec<TMem>& RecMemV, const TUInt64V& RecIdV,
+        TRecSerializator& Serializator, TIndexBatch& IndexBatch) {
+
+    Assert(RecMemV.Len() == RecIdV.Len());
+    for (int FieldIndexKeyN = 0; FieldIndexKeyN < FieldIndexKeyV.Len(); FieldIndexKeyN++) {
+        const TFieldIndexKey& Key = FieldIndexKeyV[FieldIndexKeyN];
+        if (!Serializator.IsFieldId(Key.FieldId)) { continue; }
+        for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+            if (Serializator.IsFieldNull(RecMemV[RecN], Key.FieldId)) { continue; }
+            IndexKey(IndexBatch, Key, RecMemV[RecN], RecIdV[RecN], Serializator);
+        }
+    }
+}
+
+void TRecIndexer::DeindexRecV(const TVec<TMem>& RecMemV, const TUInt64V& RecIdV, TRecSerializator& Serializator) {
+    Assert(RecMemV.Len() == RecIdV.Len());
+    // keys are deindexed one at a time for the whole batch, so each linear index and
+    // posting list buffer is visited in one go
+    for (int FieldIndexKeyN = 0; FieldIndexKeyN < FieldIndexKeyV.Len(); FieldIndexKeyN++) {
+        const TFieldIndexKey& Key = FieldIndexKeyV[FieldIndexKeyN];
+        // check if field is handled by the serializator
+        if (!Serializator.IsFieldId(Key.FieldId)) { continue; }
+        for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+            // check if field is not NULL (e.g. there is something to deindex)
+            if (Serializator.IsFieldNull(RecMemV[RecN], Key.FieldId)) { continue; }
+            DeindexKey(Key, RecMemV[RecN], RecIdV[RecN], Serializator);
+        }
+    }
+}
+
 void TRecIndexer::UpdateRec(const TMemBase& OldRecMem, const TMemBase& NewRecMem,
         const uint64& RecId, const int& ChangedFieldId, TRecSerializator& Serializator) {
 
@@ -2812,8 +3423,15 @@ void TRecIndexer::IndexRecField(const TMemBase& RecMem, const uint64& RecId, con
         const int FieldIndexKeyN = FieldIdToKeyN.GetDat(FieldId);
         const TFieldIndexKey& Key = FieldIndexKeyV[FieldIndexKeyN];
         // deindex the content
-        IndexKey(Key, RecMem, RecId, Serializator);
+        IndexKey(*Index, Key, RecMem, RecId, Serializator);
+    }
+}
+
+bool TRecIndexer::HasNonGixKey() const {
+    for (int FieldIndexKeyN = 0; FieldIndexKeyN < FieldIndexKeyV.Len(); FieldIndexKeyN++) {
+        if (!FieldIndexKeyV[FieldIndexKeyN].IsGix()) { return true; }
     }
+    return false;
 }
 
 bool TRecIndexer::IsFieldIndexKey(const int& FieldId) const {
@@ -2868,8 +3486,17 @@ void TStoreImpl::InitFieldLocV() {
 }
 
 void TStoreImpl::GetRecMem(const TStoreLoc& RecLoc, const uint64& RecId, TMem& Rec) const {
-    if (RecLoc == slDisk) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    if (RecLoc == slDisk && GetBase()->IsConcurrent()) {
+        // block cache is shared by concurrent readers
+        TLock CacheLock(GetBase()->GetStoreCacheSection());
         DataCache.GetVal(RecId, Rec);
+    } else if (RecLoc == slDisk) {
+        DataCache.GetVal(RecId, Rec);
+    } else if (RecLoc == slMemory && GetBase()->IsConcurrent() && !DataMem.IsHot(RecId)) {
+        // demoted blocks are loaded back by concurrent readers
+        TLock CacheLock(GetBase()->GetStoreCacheSection());
+        DataMem.GetVal(RecId, Rec);
     } else if (RecLoc == slMemory)  {
         DataMem.GetVal(RecId, Rec);
     } else {
@@ -2881,9 +3508,49 @@ void TStoreImpl::GetRecMem(const uint64& RecId, const int& FieldId, TMem& Rec) c
     GetRecMem(FieldLocV[FieldId], RecId, Rec);
 }
 
+const TMem& TStoreImpl::GetRecMemRef(const TStoreLoc& RecLoc, const uint64& RecId, TMem& RecMemBf) const {
+    // caller holds flush scope, so flusher cannot demote the block under the reference
+    // concurrent readers must hold the base read lock
+    Assert(!GetBase()->IsConcurrent() || GetBase()->GetLock().IsHeld());
+    if (RecLoc == slDisk && GetBase()->IsConcurrent()) {
+        // record cache hands out references to shared slots, so concurrent
+        // readers copy into their own buffer
+        TLock CacheLock(GetBase()->GetStoreCacheSection());
+        DataCache.GetVal(RecId, RecMemBf);
+        return RecMemBf;
+    } else if (RecLoc == slDisk) {
+        // copy out of the block cache only on the first read
+        const TMem* CacheRecMem = RecMemCache.Get(RecId);
+        if (CacheRecMem != NULL) { return *CacheRecMem; }
+        TMem& RecMem = RecMemCache.Add(RecId);
+        try {
+            DataCache.GetVal(RecId, RecMem);
+        } catch (...) {
+            RecMemCache.Del(RecId); throw;
+        }
+        return RecMem;
+    } else if (RecLoc == slMemory && GetBase()->IsConcurrent() && !DataMem.IsHot(RecId)) {
+        // demoted blocks are loaded back and dropped again, so concurrent
+        // readers copy them into their own buffer
+        TLock CacheLock(GetBase()->GetStoreCacheSection());
+        DataMem.GetVal(RecId, RecMemBf);
+        return RecMemBf;
+    } else if (RecLoc == slMemory)  {
+        return DataMem.GetValRef(RecId);
+    } else {
+        throw TQmExcept::New("Unknown storage location");
+    }
+}
+
+const TMem& TStoreImpl::GetRecMemRef(const uint64& RecId, const int& FieldId, TMem& RecMemBf) const {
+    return GetRecMemRef(FieldLocV[FieldId], RecId, RecMemBf);
+}
+
 void TStoreImpl::PutRecMem(const TStoreLoc& RecLoc, const uint64& RecId, const TMem& Rec) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     if (RecLoc == slDisk) {
         DataCache.SetVal(RecId, Rec);
+        RecMemCache.Del(RecId);
     } else if (RecLoc == slMemory)  {
         DataMem.SetVal(RecId, Rec);
     } else {
@@ -2921,79 +3588,110 @@ const TRecSerializator* TStoreImpl::GetFieldSerializator(const int &FieldId) con
 
 void TStoreImpl::SetPrimaryField(const uint64& RecId) {
     if (PrimaryFieldType == oftStr) {
-        PrimaryStrIdH.AddDat(GetFieldStr(RecId, PrimaryFieldId)) = RecId;
+        PrimaryIndex.AddStrKey(GetFieldStr(RecId, PrimaryFieldId), RecId);
     } else if (PrimaryFieldType == oftInt) {
-        PrimaryIntIdH.AddDat(GetFieldInt(RecId, PrimaryFieldId)) = RecId;
+        PrimaryIndex.AddKey(TPrimaryIndex::GetIntKey(GetFieldInt(RecId, PrimaryFieldId)), RecId);
     } else if (PrimaryFieldType == oftUInt64) {
-        PrimaryUInt64IdH.AddDat(GetFieldUInt64(RecId, PrimaryFieldId)) = RecId;
+        PrimaryIndex.AddKey(GetFieldUInt64(RecId, PrimaryFieldId), RecId);
     } else if (PrimaryFieldType == oftFlt) {
-        PrimaryFltIdH.AddDat(GetFieldFlt(RecId, PrimaryFieldId)) = RecId;
+        PrimaryIndex.AddKey(TPrimaryIndex::GetFltKey(GetFieldFlt(RecId, PrimaryFieldId)), RecId);
     } else if (PrimaryFieldType == oftTm) {
-        PrimaryTmMSecsIdH.AddDat(GetFieldTmMSecs(RecId, PrimaryFieldId)) = RecId;
+        PrimaryIndex.AddKey(GetFieldTmMSecs(RecId, PrimaryFieldId), RecId);
     } else {
         EAssertR(false, "Unsupported primary-field type");
     }
 }
 
 void TStoreImpl::SetPrimaryFieldStr(const uint64& RecId, const TStr& Str) {
-    PrimaryStrIdH.AddDat(Str) = RecId;
+    PrimaryIndex.AddStrKey(Str, RecId);
 }
 
 void TStoreImpl::SetPrimaryFieldInt(const uint64& RecId, const int& Int) {
-    PrimaryIntIdH.AddDat(Int) = RecId;
+    PrimaryIndex.AddKey(TPrimaryIndex::GetIntKey(Int), RecId);
 }
 
 void TStoreImpl::SetPrimaryFieldUInt64(const uint64& RecId, const uint64& UInt64) {
-    PrimaryUInt64IdH.AddDat(UInt64) = RecId;
+    PrimaryIndex.AddKey(UInt64, RecId);
 }
 
 void TStoreImpl::SetPrimaryFieldFlt(const uint64& RecId, const double& Flt) {
-    PrimaryFltIdH.AddDat(Flt) = RecId;
+    PrimaryIndex.AddKey(TPrimaryIndex::GetFltKey(Flt), RecId);
 }
 
 void TStoreImpl::SetPrimaryFieldMSecs(const uint64& RecId, const uint64& MSecs) {
-    PrimaryTmMSecsIdH.AddDat(MSecs) = RecId;
+    PrimaryIndex.AddKey(MSecs, RecId);
 }
 
 void TStoreImpl::DelPrimaryField(const uint64& RecId) {
     if (PrimaryFieldType == oftStr) {
-        PrimaryStrIdH.DelIfKey(GetFieldStr(RecId, PrimaryFieldId));
+        PrimaryIndex.DelStrKey(GetFieldStr(RecId, PrimaryFieldId));
     } else if (PrimaryFieldType == oftInt) {
-        PrimaryIntIdH.DelIfKey(GetFieldInt(RecId, PrimaryFieldId));
+        PrimaryIndex.DelKey(TPrimaryIndex::GetIntKey(GetFieldInt(RecId, PrimaryFieldId)));
     } else if (PrimaryFieldType == oftUInt64) {
-        PrimaryUInt64IdH.DelIfKey(GetFieldUInt64(RecId, PrimaryFieldId));
+        PrimaryIndex.DelKey(GetFieldUInt64(RecId, PrimaryFieldId));
     } else if (PrimaryFieldType == oftFlt) {
-        PrimaryFltIdH.DelIfKey(GetFieldFlt(RecId, PrimaryFieldId));
+        PrimaryIndex.DelKey(TPrimaryIndex::GetFltKey(GetFieldFlt(RecId, PrimaryFieldId)));
     } else if (PrimaryFieldType == oftTm) {
-        PrimaryTmMSecsIdH.DelIfKey(GetFieldTmMSecs(RecId, PrimaryFieldId));
+        PrimaryIndex.DelKey(GetFieldTmMSecs(RecId, PrimaryFieldId));
     } else {
         EAssertR(false, "Unsupported primary-field type");
     }
 }
 
 void TStoreImpl::DelPrimaryFieldStr(const uint64& RecId, const TStr& Str) {
-    Assert(PrimaryStrIdH.GetDat(Str) == RecId);
-    PrimaryStrIdH.DelIfKey(Str);
+    Assert(PrimaryIndex.GetStrRecId(Str) == RecId);
+    PrimaryIndex.DelStrKey(Str);
 }
 
 void TStoreImpl::DelPrimaryFieldInt(const uint64& RecId, const int& Int) {
-    Assert(PrimaryIntIdH.GetDat(Int) == RecId);
-    PrimaryIntIdH.DelIfKey(Int);
+    Assert(PrimaryIndex.GetRecId(TPrimaryIndex::GetIntKey(Int)) == RecId);
+    PrimaryIndex.DelKey(TPrimaryIndex::GetIntKey(Int));
 }
 
 void TStoreImpl::DelPrimaryFieldUInt64(const uint64& RecId, const uint64& UInt64) {
-    Assert(PrimaryUInt64IdH.GetDat(UInt64) == RecId);
-    PrimaryUInt64IdH.DelIfKey(UInt64);
+    Assert(PrimaryIndex.GetRecId(UInt64) == RecId);
+    PrimaryIndex.DelKey(UInt64);
 }
 
 void TStoreImpl::DelPrimaryFieldFlt(const uint64& RecId, const double& Flt) {
-    Assert(PrimaryFltIdH.GetDat(Flt) == RecId);
-    PrimaryFltIdH.DelIfKey(Flt);
+    Assert(PrimaryIndex.GetRecId(TPrimaryIndex::GetFltKey(Flt)) == RecId);
+    PrimaryIndex.DelKey(TPrimaryIndex::GetFltKey(Flt));
 }
 
 void TStoreImpl::DelPrimaryFieldMSecs(const uint64& RecId, const uint64& MSecs) {
-    Assert(PrimaryTmMSecsIdH.GetDat(MSecs) == RecId);
-    PrimaryTmMSecsIdH.DelIfKey(MSecs);
+    Assert(PrimaryIndex.GetRecId(MSecs) == RecId);
+    PrimaryIndex.DelKey(MSecs);
+}
+
+void TStoreImpl::LoadPrimaryFieldH(TSIn& SIn) {
+    if (PrimaryFieldType == oftInt) {
+        THash<TInt, TUInt64> PrimaryIntIdH(SIn);
+        PrimaryIndex = TPrimaryIndex(false);
+        for (int KeyId = PrimaryIntIdH.FFirstKeyId(); PrimaryIntIdH.FNextKeyId(KeyId); ) {
+            SetPrimaryFieldInt(PrimaryIntIdH[KeyId], PrimaryIntIdH.GetKey(KeyId));
+        }
+    } else if (PrimaryFieldType == oftUInt64 || PrimaryFieldType == oftTm) {
+        THash<TUInt64, TUInt64> PrimaryUInt64IdH(SIn);
+        PrimaryIndex = TPrimaryIndex(false);
+        for (int KeyId = PrimaryUInt64IdH.FFirstKeyId(); PrimaryUInt64IdH.FNextKeyId(KeyId); ) {
+            SetPrimaryFieldUInt64(PrimaryUInt64IdH[KeyId], PrimaryUInt64IdH.GetKey(KeyId));
+        }
+    } else if (PrimaryFieldType == oftFlt) {
+        THash<TFlt, TUInt64> PrimaryFltIdH(SIn);
+        PrimaryIndex = TPrimaryIndex(false);
+        for (int KeyId = PrimaryFltIdH.FFirstKeyId(); PrimaryFltIdH.FNextKeyId(KeyId); ) {
+            SetPrimaryFieldFlt(PrimaryFltIdH[KeyId], PrimaryFltIdH.GetKey(KeyId));
+        }
+    } else if (PrimaryFieldType == oftStr || PrimaryFieldType == oftUndef) {
+        // stores without primary field also keep an empty string hash table
+        THash<TStr, TUInt64> PrimaryStrIdH(SIn);
+        PrimaryIndex = TPrimaryIndex(true);
+        for (int KeyId = PrimaryStrIdH.FFirstKeyId(); PrimaryStrIdH.FNextKeyId(KeyId); ) {
+            SetPrimaryFieldStr(PrimaryStrIdH[KeyId], PrimaryStrIdH.GetKey(KeyId));
+        }
+    } else {
+        throw TQmExcept::New("Unsupported primary field type!");
+    }
 }
 
 void TStoreImpl::InitFromSchema(const TStoreSchema& StoreSchema) {
@@ -3012,6 +3710,7 @@ void TStoreImpl::InitFromSchema(const TStoreSchema& StoreSchema) {
             RecNmFieldP = FieldDesc.IsStr();
             PrimaryFieldId = GetFieldId(FieldDesc.GetFieldNm());
             PrimaryFieldType = FieldDesc.GetFieldType();
+            PrimaryIndex = TPrimaryIndex(FieldDesc.IsStr());
         }
     }
     // create index keys
@@ -3037,6 +3736,9 @@ void TStoreImpl::InitFromSchema(const TStoreSchema& StoreSchema) {
     RecIndexer = TRecIndexer(GetIndex(), this);
     // remember window parameters
     WndDesc = StoreSchema.WndDesc;
+    // remember hot window parameters
+    HotWndDesc = StoreSchema.HotWndDesc;
+    if (HotWndDesc.IsTime()) { HotTimeFieldId = GetFieldId(HotWndDesc.TimeFieldNm); }
 }
 
 void TStoreImpl::InitDataFlags() {
@@ -3051,12 +3753,75 @@ void TStoreImpl::InitDataFlags() {
     EAssert(DataCacheP || DataMemP);
 }
 
+void TStoreImpl::AddRecToSegment(const uint64& RecId) {
+    const uint64 TmMSecs = GetFieldTmMSecs(RecId, GetFieldId(WndDesc.TimeFieldNm));
+    const uint64 SegmentStartMSecs = TmMSecs - TmMSecs % WndDesc.SegmentSize;
+    // records arriving out of order stay in the last segment
+    if (SegmentV.Empty() || SegmentV.Last().Val1 < SegmentStartMSecs) {
+        SegmentV.Add(TUInt64Pr(SegmentStartMSecs, RecId));
+        SegmentKeySetV.Add();
+    }
+}
+
+void TStoreImpl::AddSegmentKeys(const uint64& MnRecId, const uint64& MxRecId,
+        const THashSet<TKeyWord>& KeySet) {
+
+    if (KeySet.Empty()) { return; }
+    // segments are ordered by their first record, recent ones are most likely
+    for (int SegmentN = SegmentV.Len() - 1; SegmentN >= 0; SegmentN--) {
+        if (SegmentV[SegmentN].Val2 <= MxRecId) {
+            THashSet<TKeyWord>& SegmentKeySet = SegmentKeySetV[SegmentN];
+            int KeyId = KeySet.FFirstKeyId();
+            while (KeySet.FNextKeyId(KeyId)) { SegmentKeySet.AddKey(KeySet.GetKey(KeyId)); }
+        }
+        if (SegmentV[SegmentN].Val2 <= MnRecId) { break; }
+    }
+}
+
+void TStoreImpl::UpdateRecIndex(const TMemBase& OldRecMem, const TMemBase& NewRecMem,
+        const uint64& RecId, const int& ChangedFieldId, TRecSerializator& Serializator) {
+
+    TGixKeyScope GixKeyScope(GetIndex(), WndDesc.IsSegmented());
+    RecIndexer.UpdateRec(OldRecMem, NewRecMem, RecId, ChangedFieldId, Serializator);
+    AddSegmentKeys(RecId, RecId, GixKeyScope.GetKeySet());
+}
+
+void TStoreImpl::UpdateRecIndex(const TMemBase& OldRecMem, const TMemBase& NewRecMem,
+        const uint64& RecId, TIntSet& ChangedFieldIdSet, TRecSerializator& Serializator) {
+
+    TGixKeyScope GixKeyScope(GetIndex(), WndDesc.IsSegmented());
+    RecIndexer.UpdateRec(OldRecMem, NewRecMem, RecId, ChangedFieldIdSet, Serializator);
+    AddSegmentKeys(RecId, RecId, GixKeyScope.GetKeySet());
+}
+
+void TStoreImpl::DelEmptySegments() {
+    if (SegmentV.Empty()) { return; }
+    if (Empty()) { SegmentV.Clr(); SegmentKeySetV.Clr(); return; }
+    // segment has no more records when the next one starts at or before the first record
+    const uint64 FirstRecId = GetFirstRecId();
+    int DelSegments = 0;
+    while (DelSegments + 1 < SegmentV.Len() && SegmentV[DelSegments + 1].Val2 <= FirstRecId) {
+        DelSegments++;
+    }
+    if (DelSegments > 0) {
+        SegmentV.Del(0, DelSegments - 1);
+        SegmentKeySetV.Del(0, DelSegments - 1);
+    }
+}
+
+const int TStoreImpl::GenericStoreMagic = 0x53475154;
+const int TStoreImpl::GenericStoreVersion = 2;
+const int TStoreImpl::RecMemCacheSlots = 64;
+const int TStoreImpl::DelBatchLen = 10000;
+const int TStoreImpl::DelTimedBatchLen = 100;
+
 TStoreImpl::TStoreImpl(const TWPt<TBase>& Base, const uint& StoreId,
     const TStr& StoreName, const TStoreSchema& StoreSchema, const TStr& _StoreFNm,
     const int64& _MxCacheSize, const int& BlockSize):
         TStore(Base, StoreId, StoreName), StoreFNm(_StoreFNm), FAccess(Base->GetFAccess()),
-        DataCache(_StoreFNm + ".Cache", Base->GetStoreBlobBs(), _MxCacheSize, 1024),
-        DataMem(_StoreFNm + ".MemCache", Base->GetStoreBlobBs(), BlockSize) {
+        DataCache(_StoreFNm + ".Cache", Base->GetStoreBlobBs(), _MxCacheSize, 1024, StoreSchema.BlockCompressP),
+        DataMem(_StoreFNm + ".MemCache", Base->GetStoreBlobBs(), BlockSize, StoreSchema.BlockCompressP),
+        RecMemCache(RecMemCacheSlots), HotTimeFieldId(-1) {
 
     SetStoreType("TStoreImpl");
     InitFromSchema(StoreSchema);
@@ -3068,33 +3833,29 @@ TStoreImpl::TStoreImpl(const TWPt<TBase>& Base, const TStr& _StoreFNm,
     const int64& _MxCacheSize, const bool& _Lazy): TStore(Base, _StoreFNm + ".BaseStore"),
         StoreFNm(_StoreFNm), FAccess(Base->GetFAccess()), PrimaryFieldType(oftUndef),
         DataCache(_StoreFNm + ".Cache", Base->GetStoreBlobBs(), Base->GetFAccess(), _MxCacheSize),
-        DataMem(_StoreFNm + ".MemCache", Base->GetStoreBlobBs(), Base->GetFAccess(), _Lazy) {
+        DataMem(_StoreFNm + ".MemCache", Base->GetStoreBlobBs(), Base->GetFAccess(), true),
+        RecMemCache(RecMemCacheSlots), HotTimeFieldId(-1) {
 
     SetStoreType("TStoreImpl");
     // load members
     TFIn FIn(StoreFNm + ".GenericStore");
+    // files without header start with the primary field flag, a single byte 0 or 1
+    int Version = 0;
+    if (FIn.PeekCh() != 0 && FIn.PeekCh() != 1) {
+        const int Magic = TInt(FIn);
+        QmAssertR(Magic == GenericStoreMagic, "Store file corrupted: " + StoreFNm + ".GenericStore");
+        Version = TInt(FIn);
+        QmAssertR(Version <= GenericStoreVersion, "Unsupported store file version " +
+            TInt::GetStr(Version) + ": " + StoreFNm + ".GenericStore");
+    }
     RecNmFieldP.Load(FIn);
     PrimaryFieldId.Load(FIn);
     // deduce primary field type
     if (PrimaryFieldId != -1) {
         PrimaryFieldType = GetFieldDesc(PrimaryFieldId).GetFieldType();
-        if (PrimaryFieldType == oftStr) {
-            PrimaryStrIdH.Load(FIn);
-        } else if (PrimaryFieldType == oftInt) {
-            PrimaryIntIdH.Load(FIn);
-        } else if (PrimaryFieldType == oftUInt64) {
-            PrimaryUInt64IdH.Load(FIn);
-        } else if (PrimaryFieldType == oftFlt) {
-            PrimaryFltIdH.Load(FIn);
-        } else if (PrimaryFieldType == oftTm) {
-            PrimaryTmMSecsIdH.Load(FIn);
-        } else {
-            throw TQmExcept::New("Unsupported primary field type!");
-        }
-    } else {
-        // backwards compatibility
-        PrimaryStrIdH.Load(FIn);
     }
+    // versions before 2 kept primary field map in a hash table
+    if (Version < 2) { LoadPrimaryFieldH(FIn); }
     // load time window
     WndDesc.Load(FIn);
     // load data
@@ -3102,6 +3863,23 @@ TStoreImpl::TStoreImpl(const TWPt<TBase>& Base, const TStr& _StoreFNm,
     SerializatorMem = new TRecSerializator(this);
     SerializatorCache->Load(FIn);
     SerializatorMem->Load(FIn);
+    // version 1 added time segments, primary field index and hot window,
+    // older stores keep primary field index in the hash table loaded above
+    if (Version >= 1) {
+        WndDesc.SegmentSize.Load(FIn);
+        SegmentV.Load(FIn);
+        SegmentKeySetV.Load(FIn);
+        PrimaryIndex.Load(FIn);
+        HotWndDesc.Load(FIn);
+        HotRecId.Load(FIn);
+    }
+    if (HotWndDesc.IsTime()) { HotTimeFieldId = GetFieldId(HotWndDesc.TimeFieldNm); }
+    // load in-memory blocks, demoted blocks of tiered stores are loaded when read
+    if (HotWndDesc.IsTiered()) {
+        DataMem.LoadFrom(HotRecId);
+    } else if (!_Lazy) {
+        DataMem.LoadAll();
+    }
 
     // initialize field to storage location map
     InitFieldLocV();
@@ -3116,30 +3894,7 @@ TStoreImpl::~TStoreImpl() {
     // save if necessary
     if (FAccess != faRdOnly) {
         TEnv::Logger->OnStatus(TStr::Fmt("Saving store '%s'...", GetStoreNm().CStr()));
-        // save base store
-        TFOut BaseFOut(StoreFNm + ".BaseStore");
-        SaveStore(BaseFOut);
-        // save store parameters
-        TFOut FOut(StoreFNm + ".GenericStore");
-        // save parameters about primary field
-        RecNmFieldP.Save(FOut);
-        PrimaryFieldId.Save(FOut);
-        if (PrimaryFieldType == oftInt) {
-            PrimaryIntIdH.Save(FOut);
-        } else if (PrimaryFieldType == oftUInt64) {
-            PrimaryUInt64IdH.Save(FOut);
-        } else if (PrimaryFieldType == oftFlt) {
-            PrimaryFltIdH.Save(FOut);
-        } else if (PrimaryFieldType == oftTm) {
-            PrimaryTmMSecsIdH.Save(FOut);
-        } else {
-            PrimaryStrIdH.Save(FOut);
-        }
-        // save time window
-        WndDesc.Save(FOut);
-        // save data
-        SerializatorCache->Save(FOut);
-        SerializatorMem->Save(FOut);
+        SaveStoreState();
     } else {
         TEnv::Logger->OnStatus("No saving of generic store " + GetStoreNm() + " neccessary!");
     }
@@ -3147,6 +3902,33 @@ TStoreImpl::~TStoreImpl() {
     delete SerializatorMem;
 }
 
+void TStoreImpl::SaveStoreState() const {
+    // save base store
+    TFOut BaseFOut(StoreFNm + ".BaseStore");
+    SaveStore(BaseFOut);
+    // save store parameters
+    TFOut FOut(StoreFNm + ".GenericStore");
+    TInt(GenericStoreMagic).Save(FOut);
+    TInt(GenericStoreVersion).Save(FOut);
+    // save parameters about primary field
+    RecNmFieldP.Save(FOut);
+    PrimaryFieldId.Save(FOut);
+    // save time window
+    WndDesc.Save(FOut);
+    // save data
+    SerializatorCache->Save(FOut);
+    SerializatorMem->Save(FOut);
+    // save time segments
+    WndDesc.SegmentSize.Save(FOut);
+    SegmentV.Save(FOut);
+    SegmentKeySetV.Save(FOut);
+    // save primary field index
+    PrimaryIndex.Save(FOut);
+    // save hot window
+    HotWndDesc.Save(FOut);
+    HotRecId.Save(FOut);
+}
+
 bool TStoreImpl::IsRecId(const uint64& RecId) const {
     return DataMemP ? DataMem.IsValId(RecId) : DataCache.IsValId(RecId);
 }
@@ -3156,7 +3938,7 @@ uint64 TStoreImpl::GetRecs() const {
 }
 
 bool TStoreImpl::IsRecNm(const TStr& RecNm) const {
-    return RecNmFieldP && PrimaryStrIdH.IsKey(RecNm);
+    return RecNmFieldP && PrimaryIndex.IsStrKey(RecNm);
 }
 
 TStr TStoreImpl::GetRecNm(const uint64& RecId) const {
@@ -3167,7 +3949,7 @@ TStr TStoreImpl::GetRecNm(const uint64& RecId) const {
 }
 
 uint64 TStoreImpl::GetRecId(const TStr& RecNm) const {
-    return (PrimaryStrIdH.IsKey(RecNm) ? PrimaryStrIdH.GetDat(RecNm).Val : TUInt64::Mx);
+    return RecNmFieldP ? PrimaryIndex.GetStrRecId(RecNm) : TUInt64::Mx;
 }
 
 PStoreIter TStoreImpl::GetIter() const {
@@ -3194,61 +3976,48 @@ PStoreIter TStoreImpl::BackwardIter() const {
         TStoreIterVec::New(DataCache.GetLastValId(), DataCache.GetFirstValId(), false);
 }
 
+uint64 TStoreImpl::GetExistingRecId(const PJsonVal& RecVal) const {
+    // parse out record id, if referred directly
+    const uint64 RecId = TStore::GetRecId(RecVal);
+    if (IsRecId(RecId)) { return RecId; }
+    // check if we have a primary field
+    if (!IsPrimaryField()) { return TUInt64::Mx; }
+    // primary field cannot be nullable, so we must have it
+    const TStr& PrimaryField = GetFieldNm(PrimaryFieldId);
+    QmAssertR(RecVal->IsObjKey(PrimaryField), "Missing primary field in the record: " + PrimaryField);
+    // parse based on the field type
+    if (PrimaryFieldType == oftStr) {
+        TStr FieldVal = RecVal->GetObjStr(PrimaryField);
+        return PrimaryIndex.GetStrRecId(FieldVal);
+    } else if (PrimaryFieldType == oftInt) {
+        const int FieldVal = RecVal->GetObjInt(PrimaryField);
+        return PrimaryIndex.GetRecId(TPrimaryIndex::GetIntKey(FieldVal));
+    } else if (PrimaryFieldType == oftUInt64) {
+        const uint64 FieldVal = RecVal->GetObjUInt64(PrimaryField);
+        return PrimaryIndex.GetRecId(FieldVal);
+    } else if (PrimaryFieldType == oftFlt) {
+        const double FieldVal = RecVal->GetObjNum(PrimaryField);
+        return PrimaryIndex.GetRecId(TPrimaryIndex::GetFltKey(FieldVal));
+    } else if (PrimaryFieldType == oftTm) {
+        const uint64 FieldVal = RecVal->GetObjTmMSecs(PrimaryField);
+        return PrimaryIndex.GetRecId(FieldVal);
+    }
+    EAssertR(false, "Unsupported primary-field type");
+    return TUInt64::Mx;
+}
+
 uint64 TStoreImpl::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
+    // wait for background flusher when there is too much dirty data
+    TFlushScope FlushScope(GetBase()->GetFlusher(), true);
+    TWriteScope WriteScope(GetBase());
     // check if we are given reference to existing record
     try {
-        // parse out record id, if referred directly
-        {
-            const uint64 RecId = TStore::GetRecId(RecVal);
-            if (IsRecId(RecId)) {
-                // check if we have anything more than record identifier, which would require calling UpdateRec
-                if (RecVal->GetObjKeys() > 1) { UpdateRec(RecId, RecVal); }
-                // return named record
-                return RecId;
-            }
-        }
-        // check if we have a primary field
-        if (IsPrimaryField()) {
-            uint64 PrimaryRecId = TUInt64::Mx;
-            // primary field cannot be nullable, so we must have it
-            const TStr& PrimaryField = GetFieldNm(PrimaryFieldId);
-            QmAssertR(RecVal->IsObjKey(PrimaryField), "Missing primary field in the record: " + PrimaryField);
-            // parse based on the field type
-            if (PrimaryFieldType == oftStr) {
-                TStr FieldVal = RecVal->GetObjStr(PrimaryField);
-                if (PrimaryStrIdH.IsKey(FieldVal)) {
-                    PrimaryRecId = PrimaryStrIdH.GetDat(FieldVal);
-                }
-            } else if (PrimaryFieldType == oftInt) {
-                const int FieldVal = RecVal->GetObjInt(PrimaryField);
-                if (PrimaryIntIdH.IsKey(FieldVal)) {
-                    PrimaryRecId = PrimaryIntIdH.GetDat(FieldVal);
-                }
-            } else if (PrimaryFieldType == oftUInt64) {
-                const uint64 FieldVal = RecVal->GetObjUInt64(PrimaryField);
-                if (PrimaryUInt64IdH.IsKey(FieldVal)) {
-                    PrimaryRecId = PrimaryUInt64IdH.GetDat(FieldVal);
-                }
-            } else if (PrimaryFieldType == oftFlt) {
-                const double FieldVal = RecVal->GetObjNum(PrimaryField);
-                if (PrimaryFltIdH.IsKey(FieldVal)) {
-                    PrimaryRecId = PrimaryFltIdH.GetDat(FieldVal);
-                }
-            } else if (PrimaryFieldType == oftTm) {
-                const uint64 FieldVal = RecVal->GetObjTmMSecs(PrimaryField);
-                if (PrimaryTmMSecsIdH.IsKey(FieldVal)) {
-                    PrimaryRecId = PrimaryTmMSecsIdH.GetDat(FieldVal);
-                }
-            } else {
-                EAssertR(false, "Unsupported primary-field type");
-            }
-            // check if we found primary field with existing value
-            if (PrimaryRecId != TUInt64::Mx) {
-                // check if we have anything more than primary field, which would require redirect to UpdateRec
-                if (RecVal->GetObjKeys() > 1) { UpdateRec(PrimaryRecId, RecVal); }
-                // return id of named record
-                return PrimaryRecId;
-            }
+        const uint64 ExistingRecId = GetExistingRecId(RecVal);
+        if (ExistingRecId != TUInt64::Mx) {
+            // check if we have anything more than record identifier, which would require calling UpdateRec
+            if (RecVal->GetObjKeys() > 1) { UpdateRec(ExistingRecId, RecVal); }
+            // return id of existing record
+            return ExistingRecId;
         }
     } catch (const PExcept& Except) {
         // error parsing, report error and return nothing
@@ -3257,9 +4026,15 @@ uint64 TStoreImpl::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
         return TUInt64::Mx;
     }
 
-    // always add system field that means "inserted_at"
-    RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    // nested join records are added as part of this call
+    TWalScope WalScope(GetBase());
+    // always add system field that means "inserted_at", replayed records already have it
+    if (!IsWalReplay() || !RecVal->IsObjKey(TStoreWndDesc::SysInsertedAtFieldName)) {
+        RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    }
 
+    // remember posting lists touched by the record for its time segment
+    TGixKeyScope GixKeyScope(GetIndex(), WndDesc.IsSegmented());
     // for storing record id
     uint64 RecId = TUInt64::Mx;
     uint64 CacheRecId = TUInt64::Mx;
@@ -3289,12 +4064,191 @@ uint64 TStoreImpl::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
 
     // remember value-recordId map when primary field available
     if (IsPrimaryField()) { SetPrimaryField(RecId); }
+    // remember time segment of the record
+    if (WndDesc.IsSegmented()) {
+        AddRecToSegment(RecId);
+        AddSegmentKeys(RecId, RecId, GixKeyScope.GetKeySet());
+    }
 
     // insert nested join records
     AddJoinRec(RecId, RecVal);
-    // call add triggers
+    // log the record, changes done by triggers are logged on their own
+    WalScope.Log(wotAddRec, GetStoreId(), RecVal);
+    // call add triggers, which also mark the store as modified
+    if (TriggerEvents) {
+        OnAdd(RecId);
+    } else {
+        TouchStore();
+    }
+
+    // return record Id of the new record
+    return RecId;
+}
+
+void TStoreImpl::IndexNewRecs(TVec<TMem>& CacheRecMemV, TVec<TMem>& MemRecMemV, TUInt64V& RecIdV) {
+    if (RecIdV.Empty()) { return; }
+    {
+        // remember posting lists touched by the records for their time segments
+        TGixKeyScope GixKeyScope(GetIndex(), WndDesc.IsSegmented());
+        if (DataCacheP) { RecIndexer.IndexRecV(CacheRecMemV, RecIdV, *SerializatorCache); }
+        if (DataMemP) { RecIndexer.IndexRecV(MemRecMemV, RecIdV, *SerializatorMem); }
+        // keys are known only for all the records, so they go to all segments they span
+        if (WndDesc.IsSegmented()) { AddSegmentKeys(RecIdV[0], RecIdV.Last(), GixKeyScope.GetKeySet()); }
+    }
+    CacheRecMemV.Clr(); MemRecMemV.Clr(); RecIdV.Clr();
+}
+
+void TStoreImpl::AddRecs(const TVec<PJsonVal>& RecValV, TUInt64V& RecIdV, const bool& TriggerEvents) {
+    // nested join records can refer back to records not indexed yet
+    if (GetJoins() > 0) { TStore::AddRecs(RecValV, RecIdV, TriggerEvents); return; }
+    // wait for background flusher when there is too much dirty data
+    TFlushScope FlushScope(GetBase()->GetFlusher(), true);
+    TWriteScope WriteScope(GetBase());
+    RecIdV.Gen(RecValV.Len(), 0);
+    // ids of newly added records, for which we call triggers at the end
+    TUInt64V NewRecIdV(RecValV.Len(), 0);
+    // new records are stored one by one and indexed together, one key at a time
+    TVec<TMem> CacheRecMemV, MemRecMemV; TUInt64V IndexRecIdV;
+    GetIndex()->StartBatch();
+    GetIndex()->StartLinearBatch();
+    try {
+        for (int RecN = 0; RecN < RecValV.Len(); RecN++) {
+            const PJsonVal& RecVal = RecValV[RecN];
+            // references to existing records are updates, which must see records added before
+            uint64 RecId = TUInt64::Mx;
+            try {
+                RecId = GetExistingRecId(RecVal);
+            } catch (const PExcept& Except) {
+                ErrorLog("[TStoreImpl::AddRecs] Error parsing out reference to existing record:");
+                ErrorLog(Except->GetMsgStr());
+                RecIdV.Add(TUInt64::Mx); continue;
+            }
+            if (RecId != TUInt64::Mx) {
+                if (RecVal->GetObjKeys() > 1) {
+                    IndexNewRecs(CacheRecMemV, MemRecMemV, IndexRecIdV);
+                    UpdateRec(RecId, RecVal);
+                }
+                RecIdV.Add(RecId); continue;
+            }
+            TWalScope WalScope(GetBase());
+            // always add system field that means "inserted_at", replayed records already have it
+            if (!IsWalReplay() || !RecVal->IsObjKey(TStoreWndDesc::SysInsertedAtFieldName)) {
+                RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+            }
+            if (DataCacheP) {
+                TMem& CacheRecMem = CacheRecMemV[CacheRecMemV.Add()];
+                SerializatorCache->Serialize(RecVal, CacheRecMem, this);
+                RecId = DataCache.AddVal(CacheRecMem);
+            }
+            if (DataMemP) {
+                TMem& MemRecMem = MemRecMemV[MemRecMemV.Add()];
+                SerializatorMem->Serialize(RecVal, MemRecMem, this);
+                const uint64 MemRecId = DataMem.AddVal(MemRecMem);
+                EAssert(!DataCacheP || RecId == MemRecId);
+                RecId = MemRecId;
+            }
+            IndexRecIdV.Add(RecId);
+            // later records in the batch can refer to this one by primary field
+            if (IsPrimaryField()) { SetPrimaryField(RecId); }
+            if (WndDesc.IsSegmented()) { AddRecToSegment(RecId); }
+            WalScope.Log(wotAddRec, GetStoreId(), RecVal);
+            RecIdV.Add(RecId); NewRecIdV.Add(RecId);
+        }
+        IndexNewRecs(CacheRecMemV, MemRecMemV, IndexRecIdV);
+    } catch (const PExcept& Except) {
+        // index and announce records added before the failure
+        IndexNewRecs(CacheRecMemV, MemRecMemV, IndexRecIdV);
+        GetIndex()->EndLinearBatch();
+        GetIndex()->EndBatch();
+        if (TriggerEvents) { OnAdd(NewRecIdV); } else { TouchStore(); }
+        throw;
+    }
+    GetIndex()->EndLinearBatch();
+    GetIndex()->EndBatch();
+    // call add triggers, which also mark the store as modified
+    if (TriggerEvents) { OnAdd(NewRecIdV); } else { TouchStore(); }
+}
+
+uint64 TStoreImpl::AddRec(const TRecBuilder& Rec, const bool& TriggerEvents) {
+    // wait for background flusher when there is too much dirty data
+    TFlushScope FlushScope(GetBase()->GetFlusher(), true);
+    TWriteScope WriteScope(GetBase());
+    QmAssertR(Rec.GetStore()->GetStoreId() == GetStoreId(), "Record builder created for store " + Rec.GetStore()->GetStoreNm());
+    // check if we have a primary field with existing value
+    if (IsPrimaryField()) {
+        QmAssertR(Rec.IsFieldSet(PrimaryFieldId) && !Rec.IsFieldNull(PrimaryFieldId),
+            "Missing primary field in the record: " + GetFieldNm(PrimaryFieldId));
+        uint64 PrimaryRecId = TUInt64::Mx;
+        if (PrimaryFieldType == oftStr) {
+            const TStr& FieldVal = Rec.GetFieldStr(PrimaryFieldId);
+            PrimaryRecId = PrimaryIndex.GetStrRecId(FieldVal);
+        } else if (PrimaryFieldType == oftInt) {
+            const int FieldVal = Rec.GetFieldInt(PrimaryFieldId);
+            PrimaryRecId = PrimaryIndex.GetRecId(TPrimaryIndex::GetIntKey(FieldVal));
+        } else if (PrimaryFieldType == oftUInt64) {
+            const uint64 FieldVal = Rec.GetFieldUInt64(PrimaryFieldId);
+            PrimaryRecId = PrimaryIndex.GetRecId(FieldVal);
+        } else if (PrimaryFieldType == oftFlt) {
+            const double FieldVal = Rec.GetFieldFlt(PrimaryFieldId);
+            PrimaryRecId = PrimaryIndex.GetRecId(TPrimaryIndex::GetFltKey(FieldVal));
+        } else if (PrimaryFieldType == oftTm) {
+            const uint64 FieldVal = Rec.GetFieldTmMSecs(PrimaryFieldId);
+            PrimaryRecId = PrimaryIndex.GetRecId(FieldVal);
+        } else {
+            EAssertR(false, "Unsupported primary-field type");
+        }
+        if (PrimaryRecId != TUInt64::Mx) {
+            // existing record, updates are rare enough to go through JSon
+            PJsonVal RecVal = Rec.GetJson();
+            if (RecVal->GetObjKeys() > 1) { UpdateRec(PrimaryRecId, RecVal); }
+            return PrimaryRecId;
+        }
+    }
+
+    TWalScope WalScope(GetBase());
+    // remember posting lists touched by the record for its time segment
+    TGixKeyScope GixKeyScope(GetIndex(), WndDesc.IsSegmented());
+    // for storing record id
+    uint64 RecId = TUInt64::Mx;
+    uint64 CacheRecId = TUInt64::Mx;
+    uint64 MemRecId = TUInt64::Mx;
+    // store to disk storage
+    if (DataCacheP) {
+        TMem CacheRecMem;
+        SerializatorCache->Serialize(Rec, CacheRecMem, this);
+        CacheRecId = DataCache.AddVal(CacheRecMem);
+        RecId = CacheRecId;
+        // index new record
+        RecIndexer.IndexRec(CacheRecMem, RecId, *SerializatorCache);
+    }
+    // store to in-memory storage
+    if (DataMemP) {
+        TMem MemRecMem;
+        SerializatorMem->Serialize(Rec, MemRecMem, this);
+        MemRecId = DataMem.AddVal(MemRecMem);
+        RecId = MemRecId;
+        // index new record
+        RecIndexer.IndexRec(MemRecMem, RecId, *SerializatorMem);
+    }
+    // make sure we are consistent with respect to Ids!
+    if (DataCacheP && DataMemP) {
+        EAssert(CacheRecId == MemRecId);
+    }
+
+    // remember value-recordId map when primary field available
+    if (IsPrimaryField()) { SetPrimaryField(RecId); }
+    // remember time segment of the record
+    if (WndDesc.IsSegmented()) {
+        AddRecToSegment(RecId);
+        AddSegmentKeys(RecId, RecId, GixKeyScope.GetKeySet());
+    }
+    // log the record, including the insert time set by the serializator
+    WalAddRec(WalScope, RecId, Rec);
+    // call add triggers, which also mark the store as modified
     if (TriggerEvents) {
         OnAdd(RecId);
+    } else {
+        TouchStore();
     }
 
     // return record Id of the new record
@@ -3302,6 +4256,8 @@ uint64 TStoreImpl::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
 }
 
 void TStoreImpl::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TWriteScope WriteScope(GetBase());
     // figure out which storage fields are affected
     bool CacheP = false, MemP = false, PrimaryP = false;
     for (int FieldId = 0; FieldId < GetFields(); FieldId++) {
@@ -3324,8 +4280,9 @@ void TStoreImpl::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
             CacheNewRecMem, this, CacheChangedFieldIdSet);
         // update the stored serializations with new values
         DataCache.SetVal(RecId, CacheNewRecMem);
+        RecMemCache.Del(RecId);
         // update indexes pointing to the record
-        RecIndexer.UpdateRec(CacheOldRecMem, CacheNewRecMem, RecId, CacheChangedFieldIdSet, *SerializatorCache);
+        UpdateRecIndex(CacheOldRecMem, CacheNewRecMem, RecId, CacheChangedFieldIdSet, *SerializatorCache);
     }
     // update in-memory serialization when necessary
     if (MemP) {
@@ -3337,15 +4294,18 @@ void TStoreImpl::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
         // update the stored serializations with new values
         DataMem.SetVal(RecId, MemNewRecMem);
         // update indexes pointing to the record
-        RecIndexer.UpdateRec(MemOldRecMem, MemNewRecMem, RecId, MemChangedFieldIdSet, *SerializatorMem);
+        UpdateRecIndex(MemOldRecMem, MemNewRecMem, RecId, MemChangedFieldIdSet, *SerializatorMem);
     }
     // check if primary key changed and update the mapping
     if (PrimaryP) { SetPrimaryField(RecId); }
+    // log the update, changes done by triggers are logged on their own
+    WalUpdateRec(RecId, RecVal);
     // call update triggers
     OnUpdate(RecId);
 }
 
 void TStoreImpl::GarbageCollect(const int& MxTimeMSecs) {
+    TWriteScope WriteScope(GetBase());
     // if no window, nothing to do here
     if (WndDesc.WindowType == swtNone) { return; }
     // if no records, nothing to do here
@@ -3370,6 +4330,19 @@ void TStoreImpl::GarbageCollect(const int& MxTimeMSecs) {
         TEnv::Logger->OnStatusFmt("  window: %s - %s",
             TTm::GetTmFromMSecs(WindowStartMSecs).GetWebLogDateTimeStr(true, "T", false).CStr(),
             TTm::GetTmFromMSecs(CurMSecs).GetWebLogDateTimeStr(true, "T", false).CStr());
+        // with time segments we drop all segments that ended before the time window
+        if (WndDesc.IsSegmented()) {
+            int DelSegments = 0;
+            while (DelSegments < SegmentV.Len() &&
+                SegmentV[DelSegments].Val1 + WndDesc.SegmentSize <= WindowStartMSecs) {
+                DelSegments++;
+            }
+            TEnv::Logger->OnStatusFmt("  dropping %d segments", DelSegments);
+            if (DelSegments > 0) {
+                DropSegments(DelSegments < SegmentV.Len() ? SegmentV[DelSegments].Val2.Val : LastRecId + 1);
+            }
+            return;
+        }
         // iterate from the start until we hit the time window
         PStoreIter Iter = GetIter();
         while (Iter->Next()) {
@@ -3400,32 +4373,40 @@ void TStoreImpl::GarbageCollect(const int& MxTimeMSecs) {
     TStoreImpl::DeleteRecs(DelRecIdV, MxTimeMSecs, false);
 }
 
-/// Deletes all records
-void TStoreImpl::DeleteAllRecs() {
-    // if no records, nothing to do here
-    if (Empty()) { return; }
-    TEnv::Logger->OnStatusFmt("Deleting all (%d) records in %s", GetRecs(), GetStoreNm().CStr());
-
-    // NOTE: if you change the logic bellow, be sure to also change the DeleteRecs() method
-
-    // delete records from index
-    for (uint64 DelRecId = GetFirstRecId(); DelRecId <= GetLastRecId(); DelRecId++) {
-        // executed triggers before deletion
-        OnDelete(DelRecId);
-        // delete record from name-id map
-        if (IsPrimaryField()) { DelPrimaryField(DelRecId); }
-        // delete record from indexes
+void TStoreImpl::DeindexRecBatch(const TUInt64V& RecIdV) {
+    // executed triggers before deletion
+    OnDelete(RecIdV);
+    // delete records from name-id map
+    if (IsPrimaryField()) {
+        for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+            DelPrimaryField(RecIdV[RecN]);
+        }
+    }
+    // delete records from indexes, grouping inverted index changes by posting list
+    GetIndex()->StartBatch();
+    try {
         if (DataCacheP) {
-            TMem CacheRecMem;
-            DataCache.GetVal(DelRecId, CacheRecMem);
-            RecIndexer.DeindexRec(CacheRecMem, DelRecId, *SerializatorCache);
+            TVec<TMem> CacheRecMemV(RecIdV.Len());
+            for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+                DataCache.GetVal(RecIdV[RecN], CacheRecMemV[RecN]);
+            }
+            RecIndexer.DeindexRecV(CacheRecMemV, RecIdV, *SerializatorCache);
         }
         if (DataMemP) {
-            TMem MemRecMem;
-            DataMem.GetVal(DelRecId, MemRecMem);
-            RecIndexer.DeindexRec(MemRecMem, DelRecId, *SerializatorMem);
+            TVec<TMem> MemRecMemV(RecIdV.Len());
+            for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+                DataMem.GetVal(RecIdV[RecN], MemRecMemV[RecN]);
+            }
+            RecIndexer.DeindexRecV(MemRecMemV, RecIdV, *SerializatorMem);
         }
-        // delete record from joins
+    } catch (const PExcept& Except) {
+        GetIndex()->EndBatch();
+        throw;
+    }
+    GetIndex()->EndBatch();
+    // delete records from joins
+    for (int RecN = 0; RecN < RecIdV.Len(); RecN++) {
+        const uint64 DelRecId = RecIdV[RecN];
         TRec Rec(this, DelRecId);
         for (int JoinN = 0; JoinN < GetJoins(); JoinN++) {
             TJoinDesc JoinDesc = GetJoinDesc(JoinN);
@@ -3439,18 +4420,40 @@ void TStoreImpl::DeleteAllRecs() {
             }
         }
     }
+}
+
+/// Deletes all records
+void TStoreImpl::DeleteAllRecs() {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TWriteScope WriteScope(GetBase());
+    // if no records, nothing to do here
+    if (Empty()) { return; }
+    TEnv::Logger->OnStatusFmt("Deleting all (%d) records in %s", GetRecs(), GetStoreNm().CStr());
+    // joins are removed as part of this call
+    TWalScope WalScope(GetBase());
+
+    // delete records from index in batches
+    TUInt64V DelRecIdV(DelBatchLen, 0);
+    for (uint64 DelRecId = GetFirstRecId(); DelRecId <= GetLastRecId(); DelRecId++) {
+        DelRecIdV.Add(DelRecId);
+        if (DelRecIdV.Len() == DelBatchLen || DelRecId == GetLastRecId()) {
+            DeindexRecBatch(DelRecIdV);
+            DelRecIdV.Clr(false);
+        }
+    }
     // delete records from disk
-    PrimaryStrIdH.Clr();
-    PrimaryIntIdH.Clr();
-    PrimaryUInt64IdH.Clr();
-    PrimaryFltIdH.Clr();
-    PrimaryTmMSecsIdH.Clr();
+    PrimaryIndex.Clr();
     DataCache.DelVals(TInt::Mx);
     DataMem.DelVals(TInt::Mx);
+    RecMemCache.Clr();
+    // forget time segments, which have no more records
+    DelEmptySegments();
     PartialFlush(TInt::Mx);
+    WalScope.Log(wotDelAllRecs, GetStoreId(), TJsonVal::NewObj());
 }
 
 void TStoreImpl::DeleteFirstRecs(const int& DelRecs)  {
+    TWriteScope WriteScope(GetBase());
     // if no records, nothing to do here
     if (Empty()) { return; }
     // report on activity
@@ -3472,6 +4475,10 @@ void TStoreImpl::DeleteFirstRecs(const int& DelRecs)  {
 }
 
 void TStoreImpl::DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs, const bool& AssertOK) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TWriteScope WriteScope(GetBase());
+    // joins are removed as part of this call
+    TWalScope WalScope(GetBase());
     if (AssertOK) {
         // assert that DelRecIdV is valid, without gaps and that deleting will not create gaps
         PStoreIter Iter = GetIter();
@@ -3486,63 +4493,52 @@ void TStoreImpl::DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs, c
         }
     }
 
-    // NOTE: if you change the logic bellow, be sure to also change the DeleteAllRecs() method
-
-    // delete records from index
+    // delete records from index in batches
     TTmStopWatch StopWatch(true);
     int DeletedRecs = 0;
-    for (int DelRecN = 0; DelRecN < DelRecIdV.Len(); DelRecN++) {
-        // report progress
-        if (DelRecN > 0 && DelRecN % 1000 == 0) {
-            TEnv::Logger->OnStatusFmt("    %d\r", DelRecN);
-        }
+    while (DeletedRecs < DelRecIdV.Len()) {
         // check if we still have time
         if ((MxTimeMSecs != -1) && (StopWatch.GetMSecInt() > MxTimeMSecs)) {
-            TEnv::Logger->OnStatusFmt("Reached time limit of %d msecs in TStoreImpl::DeleteRecs");
+            TEnv::Logger->OnStatusFmt("Reached time limit of %d msecs in TStoreImpl::DeleteRecs", MxTimeMSecs);
             break;
         }
-        // what are we deleting now
-        const uint64 DelRecId = DelRecIdV[DelRecN];
-        // executed triggers before deletion
-        OnDelete(DelRecId);
-        // delete record from name-id map
-        if (IsPrimaryField()) {
-            DelPrimaryField(DelRecId);
-        }
-        // delete record from indexes
-        if (DataCacheP) {
-            TMem CacheRecMem;
-            DataCache.GetVal(DelRecId, CacheRecMem);
-            RecIndexer.DeindexRec(CacheRecMem, DelRecId, *SerializatorCache);
-        }
-        if (DataMemP) {
-            TMem MemRecMem;
-            DataMem.GetVal(DelRecId, MemRecMem);
-            RecIndexer.DeindexRec(MemRecMem, DelRecId, *SerializatorMem);
+        // report progress
+        if (DeletedRecs > 0) {
+            TEnv::Logger->OnStatusFmt("    %d\r", DeletedRecs);
         }
-        // delete record from joins
-        TRec Rec(this, DelRecId);
-        for (int JoinN = 0; JoinN < GetJoins(); JoinN++) {
-            TJoinDesc JoinDesc = GetJoinDesc(JoinN);
-            // execute the join
-            PRecSet JoinRecSet = Rec.DoJoin(GetBase(), JoinDesc.GetJoinId());
-            for (int JoinRecN = 0; JoinRecN < JoinRecSet->GetRecs(); JoinRecN++) {
-                // remove joins with all matched records, one by one
-                const uint64 JoinRecId = JoinRecSet->GetRecId(JoinRecN);
-                DelJoin(JoinDesc.GetJoinId(), DelRecId, JoinRecId);
+        // with a time limit, batches are sized by the time left and the deletion rate
+        // measured so far, so the limit is not overrun by more than a few records
+        int BatchLen = DelBatchLen;
+        if (MxTimeMSecs != -1) {
+            const int ElapsedMSecs = StopWatch.GetMSecInt();
+            if (DeletedRecs == 0 || ElapsedMSecs == 0) {
+                BatchLen = TMath::Mn(BatchLen, DelTimedBatchLen);
+            } else {
+                const double RecsPerMSec = (double)DeletedRecs / (double)ElapsedMSecs;
+                const double LeftRecs = RecsPerMSec * (double)(MxTimeMSecs - ElapsedMSecs);
+                BatchLen = (int)TMath::Mx(1.0, TMath::Mn((double)BatchLen, LeftRecs));
             }
         }
+        // what are we deleting now
+        BatchLen = TMath::Mn(BatchLen, DelRecIdV.Len() - DeletedRecs);
+        TUInt64V BatchRecIdV; DelRecIdV.GetSubValV(DeletedRecs, DeletedRecs + BatchLen - 1, BatchRecIdV);
+        DeindexRecBatch(BatchRecIdV);
         // count what we deleted
-        DeletedRecs++;
+        DeletedRecs += BatchLen;
     }
     // delete records from disk
     if (DataCacheP) {
         DataCache.DelVals(DeletedRecs);
+        RecMemCache.Clr();
     }
     // delete records from in-memory store
     if (DataMemP) {
         DataMem.DelVals(DeletedRecs);
     }
+    // forget time segments left without records
+    DelEmptySegments();
+    // log records which were deleted
+    WalDelRecs(WalScope, DelRecIdV, DeletedRecs);
 
     // report success :-)
     if (DelRecIdV.Len() > 1000) {
@@ -3550,138 +4546,212 @@ void TStoreImpl::DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs, c
     }
 }
 
+void TStoreImpl::DropSegments(const uint64& FirstKeptRecId) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TWriteScope WriteScope(GetBase());
+    TWalScope WalScope(GetBase());
+    // nothing to do when there are no records before the given one
+    if (Empty() || FirstKeptRecId <= GetFirstRecId()) { return; }
+    QmAssertR(GetJoins() == 0, "TStoreImpl::DropSegments: not supported for stores with joins");
+    QmAssertR(!RecIndexer.HasNonGixKey(), "TStoreImpl::DropSegments: not supported for stores with linear or location keys");
+    const uint64 FirstRecId = GetFirstRecId();
+    const uint64 EndRecId = TMath::Mn(FirstKeptRecId, GetLastRecId() + 1);
+    TEnv::Logger->OnStatusFmt("  dropping records %s - %s", TUInt64::GetStr(FirstRecId).CStr(),
+        TUInt64::GetStr(EndRecId - 1).CStr());
+
+    // executed triggers before deletion; without triggers the records are not read
+    if (HasTriggers()) {
+        for (uint64 DelRecId = FirstRecId; DelRecId < EndRecId; DelRecId++) {
+            OnDelete(DelRecId);
+        }
+    } else {
+        TouchStore();
+    }
+    // delete records from name-id map, without reading them
+    if (IsPrimaryField()) {
+        PrimaryIndex.DelRecIdsBefore(EndRecId);
+    }
+    // cut dropped records from the front of the posting lists touched by their time segments
+    QmAssert(SegmentKeySetV.Len() == SegmentV.Len());
+    THashSet<TKeyWord> GixKeySet;
+    for (int SegmentN = 0; SegmentN < SegmentV.Len() && SegmentV[SegmentN].Val2 < EndRecId; SegmentN++) {
+        const THashSet<TKeyWord>& SegmentKeySet = SegmentKeySetV[SegmentN];
+        int KeyId = SegmentKeySet.FFirstKeyId();
+        while (SegmentKeySet.FNextKeyId(KeyId)) { GixKeySet.AddKey(SegmentKeySet.GetKey(KeyId)); }
+    }
+    if (!GixKeySet.Empty()) { GetIndex()->DeleteGixBefore(GixKeySet, EndRecId); }
+    // delete records from disk and in-memory store
+    const int DelRecs = (int)(EndRecId - FirstRecId);
+    if (DataCacheP) { DataCache.DelVals(DelRecs); RecMemCache.Clr(); }
+    if (DataMemP) { DataMem.DelVals(DelRecs); }
+    // forget dropped time segments
+    DelEmptySegments();
+    WalScope.Log(wotDropSegments, GetStoreId(), TJsonVal::NewObj("before", EndRecId));
+}
+
 bool TStoreImpl::IsFieldNull(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->IsFieldNull(RecMem, FieldId);
 }
 
 uchar TStoreImpl::GetFieldByte(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldByte(RecMem, FieldId);
 }
 
 int TStoreImpl::GetFieldInt(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldInt(RecMem, FieldId);
 }
 
 int16 TStoreImpl::GetFieldInt16(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldInt16(RecMem, FieldId);
 }
 
 int64 TStoreImpl::GetFieldInt64(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldInt64(RecMem, FieldId);
 }
 
 TStr TStoreImpl::GetFieldStr(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldStr(RecMem, FieldId);
 }
 
 bool TStoreImpl::GetFieldBool(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldBool(RecMem, FieldId);
 }
 
 double TStoreImpl::GetFieldFlt(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldFlt(RecMem, FieldId);
 }
 
 float TStoreImpl::GetFieldSFlt(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldSFlt(RecMem, FieldId);
 }
 
 TFltPr TStoreImpl::GetFieldFltPr(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldFltPr(RecMem, FieldId);
 }
 
 uint TStoreImpl::GetFieldUInt(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldUInt(RecMem, FieldId);
 }
 
 uint16 TStoreImpl::GetFieldUInt16(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldUInt16(RecMem, FieldId);
 }
 
 uint64 TStoreImpl::GetFieldUInt64(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldUInt64(RecMem, FieldId);
 }
 
 void TStoreImpl::GetFieldStrV(const uint64& RecId, const int& FieldId, TStrV& StrV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     GetFieldSerializator(FieldId)->GetFieldStrV(RecMem, FieldId, StrV);
 }
 
 void TStoreImpl::GetFieldIntV(const uint64& RecId, const int& FieldId, TIntV& IntV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     GetFieldSerializator(FieldId)->GetFieldIntV(RecMem, FieldId, IntV);
 }
 
 void TStoreImpl::GetFieldFltV(const uint64& RecId, const int& FieldId, TFltV& FltV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     GetFieldSerializator(FieldId)->GetFieldFltV(RecMem, FieldId, FltV);
 }
 
 void TStoreImpl::GetFieldTm(const uint64& RecId, const int& FieldId, TTm& Tm) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     GetFieldSerializator(FieldId)->GetFieldTm(RecMem, FieldId, Tm);
 }
 
 uint64 TStoreImpl::GetFieldTmMSecs(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldTmMSecs(RecMem, FieldId);
 }
 
 void TStoreImpl::GetFieldNumSpV(const uint64& RecId, const int& FieldId, TIntFltKdV& SpV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     GetFieldSerializator(FieldId)->GetFieldNumSpV(RecMem, FieldId, SpV);
 }
 
 void TStoreImpl::GetFieldBowSpV(const uint64& RecId, const int& FieldId, PBowSpV& SpV) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     GetFieldSerializator(FieldId)->GetFieldBowSpV(RecMem, FieldId, SpV);
 }
 
 void TStoreImpl::GetFieldTMem(const uint64& RecId, const int& FieldId, TMem& Mem) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     GetFieldSerializator(FieldId)->GetFieldTMem(RecMem, FieldId, Mem);
 }
 
 PJsonVal TStoreImpl::GetFieldJsonVal(const uint64& RecId, const int& FieldId) const {
-    TMem RecMem; GetRecMem(RecId, FieldId, RecMem);
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TMem RecMemBf; const TMem& RecMem = GetRecMemRef(RecId, FieldId, RecMemBf);
     return GetFieldSerializator(FieldId)->GetFieldJsonVal(RecMem, FieldId);
 }
 
 void TStoreImpl::SetFieldNull(const uint64& RecId, const int& FieldId) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem; FieldSerializator->SetFieldNull(InRecMem, OutRecMem, FieldId);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldByte(const uint64& RecId, const int& FieldId, const uchar& Byte) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldByte(InRecMem, OutRecMem, FieldId, Byte);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldInt(const uint64& RecId, const int& FieldId, const int& Int) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
-        if (PrimaryIntIdH.IsKey(Int) && PrimaryIntIdH.GetDat(Int) != RecId) {
+        const uint64 PrimaryRecId = PrimaryIndex.GetRecId(TPrimaryIndex::GetIntKey(Int));
+        if (PrimaryRecId != TUInt64::Mx && PrimaryRecId != RecId) {
             throw TQmExcept::New("[TStoreImpl::SetFieldInt] Primary key '" + TInt::GetStr(Int) +
                 "' being set to field '" + GetFieldNm(FieldId) + "' already taken.");
         }
@@ -3694,61 +4764,80 @@ void TStoreImpl::SetFieldInt(const uint64& RecId, const int& FieldId, const int&
     }
     TMem OutRecMem;
     FieldSerializator->SetFieldInt(InRecMem, OutRecMem, FieldId, Int);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldInt(RecId, Int); }
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldInt16(const uint64& RecId, const int& FieldId, const int16& Int16) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldInt16(InRecMem, OutRecMem, FieldId, Int16);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldInt64(const uint64& RecId, const int& FieldId, const int64& Int64) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldInt64(InRecMem, OutRecMem, FieldId, Int64);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldIntV(const uint64& RecId, const int& FieldId, const TIntV& IntV) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldIntV(InRecMem, OutRecMem, FieldId, IntV);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldUInt(const uint64& RecId, const int& FieldId, const uint& UInt) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldUInt(InRecMem, OutRecMem, FieldId, UInt);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldUInt16(const uint64& RecId, const int& FieldId, const uint16& UInt16) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldUInt16(InRecMem, OutRecMem, FieldId, UInt16);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldUInt64(const uint64& RecId, const int& FieldId, const uint64& UInt64) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
-        if (PrimaryUInt64IdH.IsKey(UInt64) && PrimaryUInt64IdH.GetDat(UInt64) != RecId) {
+        const uint64 PrimaryRecId = PrimaryIndex.GetRecId(UInt64);
+        if (PrimaryRecId != TUInt64::Mx && PrimaryRecId != RecId) {
             throw TQmExcept::New("[TStoreImpl::SetFieldUInt64] Primary key '" + TUInt64::GetStr(UInt64) +
                 "' being set to field '" + GetFieldNm(FieldId) + "' already taken.");
         }
@@ -3761,16 +4850,20 @@ void TStoreImpl::SetFieldUInt64(const uint64& RecId, const int& FieldId, const u
     }
     TMem OutRecMem;
     FieldSerializator->SetFieldUInt64(InRecMem, OutRecMem, FieldId, UInt64);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldUInt64(RecId, UInt64); }
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldStr(const uint64& RecId, const int& FieldId, const TStr& Str) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
-        if (PrimaryStrIdH.IsKey(Str) && PrimaryStrIdH.GetDat(Str) != RecId) {
+        const uint64 PrimaryRecId = PrimaryIndex.GetStrRecId(Str);
+        if (PrimaryRecId != TUInt64::Mx && PrimaryRecId != RecId) {
             throw TQmExcept::New("[TStoreImpl::SetFieldStr] Primary key '" + Str +
                 "' being set to field '" + GetFieldNm(FieldId) + "' already taken.");
         }
@@ -3783,34 +4876,44 @@ void TStoreImpl::SetFieldStr(const uint64& RecId, const int& FieldId, const TStr
     }
     TMem OutRecMem;
     FieldSerializator->SetFieldStr(InRecMem, OutRecMem, FieldId, Str);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldStr(RecId, Str); }
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldStrV(const uint64& RecId, const int& FieldId, const TStrV& StrV) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldStrV(InRecMem, OutRecMem, FieldId, StrV);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldBool(const uint64& RecId, const int& FieldId, const bool& Bool) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldBool(InRecMem, OutRecMem, FieldId, Bool);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldFlt(const uint64& RecId, const int& FieldId, const double& Flt) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
-        if (PrimaryFltIdH.IsKey(Flt) && PrimaryFltIdH.GetDat(Flt) != RecId) {
+        const uint64 PrimaryRecId = PrimaryIndex.GetRecId(TPrimaryIndex::GetFltKey(Flt));
+        if (PrimaryRecId != TUInt64::Mx && PrimaryRecId != RecId) {
             throw TQmExcept::New("[TStoreImpl::SetFieldFlt] Primary key '" + TFlt::GetStr(Flt) +
                 "' being set to field '" + GetFieldNm(FieldId) + "' already taken.");
         }
@@ -3823,51 +4926,67 @@ void TStoreImpl::SetFieldFlt(const uint64& RecId, const int& FieldId, const doub
     }
     TMem OutRecMem;
     FieldSerializator->SetFieldFlt(InRecMem, OutRecMem, FieldId, Flt);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldFlt(RecId, Flt); }
+    WalSetField(RecId, FieldId);
 }
 void TStoreImpl::SetFieldSFlt(const uint64& RecId, const int& FieldId, const float& SFlt) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldSFlt(InRecMem, OutRecMem, FieldId, SFlt);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldFltPr(const uint64& RecId, const int& FieldId, const TFltPr& FltPr) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldFltPr(InRecMem, OutRecMem, FieldId, FltPr);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldFltV(const uint64& RecId, const int& FieldId, const TFltV& FltV) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldFltV(InRecMem, OutRecMem, FieldId, FltV);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldTm(const uint64& RecId, const int& FieldId, const TTm& Tm) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldTm(InRecMem, OutRecMem, FieldId, Tm);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, const uint64& TmMSecs) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
-        if (PrimaryTmMSecsIdH.IsKey(TmMSecs) && PrimaryTmMSecsIdH.GetDat(TmMSecs) != RecId) {
+        const uint64 PrimaryRecId = PrimaryIndex.GetRecId(TmMSecs);
+        if (PrimaryRecId != TUInt64::Mx && PrimaryRecId != RecId) {
             throw TQmExcept::New("[TStoreImpl::SetFieldTmMSecs] Primary key '" + TUInt64::GetStr(TmMSecs) +
                 "' being set to field '" + GetFieldNm(FieldId) + "' already taken.");
         }
@@ -3880,45 +4999,58 @@ void TStoreImpl::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, const
     }
     TMem OutRecMem;
     FieldSerializator->SetFieldTmMSecs(InRecMem, OutRecMem, FieldId, TmMSecs);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldMSecs(RecId, TmMSecs); }
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldNumSpV(const uint64& RecId, const int& FieldId, const TIntFltKdV& SpV) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldNumSpV(InRecMem, OutRecMem, FieldId, SpV);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldBowSpV(const uint64& RecId, const int& FieldId, const PBowSpV& SpV) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldBowSpV(InRecMem, OutRecMem, FieldId, SpV);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldTMem(const uint64& RecId, const int& FieldId, const TMem& Mem) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldTMem(InRecMem, OutRecMem, FieldId, Mem);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 void TStoreImpl::SetFieldJsonVal(const uint64& RecId, const int& FieldId, const PJsonVal& Json) {
+    TWriteScope WriteScope(GetBase());
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMem InRecMem; GetRecMem(RecId, FieldId, InRecMem);
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     TMem OutRecMem;
     FieldSerializator->SetFieldJsonVal(InRecMem, OutRecMem, FieldId, Json);
-    RecIndexer.UpdateRec(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
+    UpdateRecIndex(InRecMem, OutRecMem, RecId, FieldId, *FieldSerializator);
     PutRecMem(RecId, FieldId, OutRecMem);
+    WalSetField(RecId, FieldId);
 }
 
 PJsonVal TStoreImpl::GetStoreJson(const TWPt<TBase>& Base) const {
@@ -3933,6 +5065,9 @@ PJsonVal TStoreImpl::GetStoreJson(const TWPt<TBase>& Base) const {
         if (WndDesc.WindowType == TStoreWndType::swtTime) {
             WindowJson->AddToObj("timeField", WndDesc.TimeFieldNm);
         }
+        if (WndDesc.IsSegmented()) {
+            WindowJson->AddToObj("segment", WndDesc.SegmentSize.Val);
+        }
 
         Result->AddToObj("window", WindowJson);
     }
@@ -3945,19 +5080,190 @@ int TStoreImpl::GetCodebookId(const int& FieldId, const TStr& Str) const {
     return FieldSerializator->GetCodebookId(FieldId, Str);
 }
 
+void TStoreImpl::EnableConcurrency() {
+    // lazily loaded blocks would otherwise be loaded by readers, demoted
+    // blocks of tiered stores are read under the store cache lock
+    if (HotWndDesc.IsTiered()) {
+        DataMem.LoadFrom(DataMem.GetHotValId());
+    } else {
+        DataMem.LoadAll();
+    }
+}
+
+void TStoreImpl::SaveBinDumpSchema(TSOut& SOut) const {
+    TInt(GetFields()).Save(SOut);
+    for (int FieldId = 0; FieldId < GetFields(); FieldId++) {
+        const TFieldDesc& FieldDesc = GetFieldDesc(FieldId);
+        FieldDesc.GetFieldNm().Save(SOut);
+        TInt(FieldDesc.GetFieldType()).Save(SOut);
+    }
+    DataCacheP.Save(SOut);
+    if (DataCacheP) { SerializatorCache->SaveLayout(SOut); }
+    DataMemP.Save(SOut);
+    if (DataMemP) { SerializatorMem->SaveLayout(SOut); }
+}
+
+void TStoreImpl::SaveBinDump(TSOut& SOut) const {
+    GetStoreNm().Save(SOut);
+    TMOut SchemaOut; SaveBinDumpSchema(SchemaOut);
+    TMem(SchemaOut.GetBfAddr(), SchemaOut.Len()).Save(SOut);
+    if (DataCacheP) { SerializatorCache->SaveCodebook(SOut); }
+    if (DataMemP) { SerializatorMem->SaveCodebook(SOut); }
+    TUInt64(Empty() ? 0 : GetFirstRecId()).Save(SOut);
+    // serialized records, in the same order as they are added to the storage
+    TMOut BlockOut; int BlockRecs = 0;
+    PStoreIter Iter = GetIter();
+    while (Iter->Next()) {
+        const uint64 RecId = Iter->GetRecId();
+        TMem RecMem;
+        if (DataCacheP) { GetRecMem(slDisk, RecId, RecMem); RecMem.Save(BlockOut); }
+        if (DataMemP) { GetRecMem(slMemory, RecId, RecMem); RecMem.Save(BlockOut); }
+        BlockRecs++;
+        if (BlockOut.Len() >= TBinDump::BlockBytes) {
+            TBinDump::SaveBlock(SOut, BlockRecs, BlockOut);
+            BlockOut.Clr(); BlockRecs = 0;
+        }
+    }
+    if (BlockRecs > 0) { TBinDump::SaveBlock(SOut, BlockRecs, BlockOut); }
+    TBinDump::SaveEnd(SOut);
+}
+
+void TStoreImpl::RestoreBinDump(TSIn& SIn, TCriticalSection& SharedSection,
+        uint64& DumpFirstRecId, uint64& FirstRecId) {
+
+    QmAssertR(Empty(), "Binary dump can only be restored into empty store " + GetStoreNm());
+    const TStr DumpStoreNm(SIn);
+    // records are copied as they are, so their layout must be the same
+    const TMem DumpSchemaMem(SIn);
+    TMOut SchemaOut; SaveBinDumpSchema(SchemaOut);
+    QmAssertR(DumpSchemaMem.Len() == SchemaOut.Len() &&
+        memcmp(DumpSchemaMem.GetBf(), SchemaOut.GetBfAddr(), SchemaOut.Len()) == 0,
+        "Schema of store " + GetStoreNm() + " does not match binary dump of store " + DumpStoreNm);
+    if (DataCacheP) { SerializatorCache->LoadCodebook(SIn); }
+    if (DataMemP) { SerializatorMem->LoadCodebook(SIn); }
+    DumpFirstRecId = TUInt64(SIn); FirstRecId = TUInt64::Mx;
+    TMem BlockMem; int BlockRecs;
+    while ((BlockRecs = TBinDump::LoadBlock(SIn, BlockMem)) > 0) {
+        TFlushScope FlushScope(GetBase()->GetFlusher());
+        TMIn BlockIn(BlockMem.GetBf(), BlockMem.Len(), false);
+        TVec<TMem> CacheRecMemV(BlockRecs), MemRecMemV(BlockRecs);
+        TUInt64V RecIdV(BlockRecs); THashSet<TKeyWord> BlockKeySet;
+        for (int RecN = 0; RecN < BlockRecs; RecN++) {
+            if (DataCacheP) { CacheRecMemV[RecN].Load(BlockIn); }
+            if (DataMemP) { MemRecMemV[RecN].Load(BlockIn); }
+        }
+        // in-memory storage belongs only to this store
+        if (DataMemP) {
+            for (int RecN = 0; RecN < BlockRecs; RecN++) {
+                RecIdV[RecN] = DataMem.AddVal(MemRecMemV[RecN]);
+            }
+        }
+        // disk storage is shared with other stores, which are restored in parallel
+        if (DataCacheP) {
+            TLock Lock(SharedSection);
+            for (int RecN = 0; RecN < BlockRecs; RecN++) {
+                const uint64 CacheRecId = DataCache.AddVal(CacheRecMemV[RecN]);
+                EAssert(!DataMemP || CacheRecId == RecIdV[RecN]);
+                RecIdV[RecN] = CacheRecId;
+            }
+        }
+        // index changes of the whole block are collected without the lock and
+        // added to the shared index at once, so posting lists get extended in bulk
+        TIndexBatch IndexBatch(GetIndex()->GetIndexVoc());
+        if (DataCacheP) { RecIndexer.IndexRecV(CacheRecMemV, RecIdV, *SerializatorCache, IndexBatch); }
+        if (DataMemP) { RecIndexer.IndexRecV(MemRecMemV, RecIdV, *SerializatorMem, IndexBatch); }
+        {
+            TLock Lock(SharedSection);
+            TGixKeyScope GixKeyScope(GetIndex(), WndDesc.IsSegmented());
+            GetIndex()->AddBatch(IndexBatch);
+            BlockKeySet = GixKeyScope.GetKeySet();
+        }
+        for (int RecN = 0; RecN < BlockRecs; RecN++) {
+            if (IsPrimaryField()) { SetPrimaryField(RecIdV[RecN]); }
+            if (WndDesc.IsSegmented()) { AddRecToSegment(RecIdV[RecN]); }
+        }
+        // keys are known only for the whole block, so they go to all segments it spans
+        if (WndDesc.IsSegmented()) { AddSegmentKeys(RecIdV[0], RecIdV.Last(), BlockKeySet); }
+        if (FirstRecId == TUInt64::Mx) { FirstRecId = RecIdV[0]; }
+    }
+}
+
+void TStoreImpl::DemoteColdBlocks() {
+    // called under write scope, so concurrent readers are not loading blocks back
+    if (!HotWndDesc.IsTiered() || !DataMemP || Empty()) { return; }
+    const uint64 LastRecId = GetLastRecId();
+    HotRecId = MAX(HotRecId.Val, GetFirstRecId());
+    if (HotWndDesc.IsTime()) {
+        // records arrive ordered by time, same as assumed by the time window
+        const uint64 LastMSecs = GetFieldTmMSecs(LastRecId, HotTimeFieldId);
+        const uint64 StartMSecs = (LastMSecs > HotWndDesc.Duration) ? LastMSecs - HotWndDesc.Duration : 0;
+        while (HotRecId < LastRecId && GetFieldTmMSecs(HotRecId, HotTimeFieldId) < StartMSecs) {
+            HotRecId++;
+        }
+    } else if (LastRecId + 1 > HotWndDesc.Recs) {
+        HotRecId = MAX(HotRecId.Val, LastRecId + 1 - HotWndDesc.Recs);
+    }
+    DataMem.Demote(HotRecId);
+}
+
 int TStoreImpl::PartialFlush(int WndInMsec) {
+    TWriteScope WriteScope(GetBase());
     int slice = WndInMsec / 2;
     TTmStopWatch sw(true);
     int res = DataMem.PartialFlush(slice);
     int res2 = DataCache.PartialFlush(slice);
+    // move aged blocks of tiered store out of memory
+    DemoteColdBlocks();
     return res + res2;
 }
 
+void TStoreImpl::Flush() {
+    TWriteScope WriteScope(GetBase());
+    QmAssertR(FAccess != faRdOnly, "Store " + GetStoreNm() + " opened in read-only mode");
+    DataCache.Flush();
+    DataMem.Flush();
+    SaveStoreState();
+}
+
+uint64 TStoreImpl::GetDirtyBytes() {
+    return DataMem.GetDirtyBytes() + DataCache.GetDirtyBytes();
+}
+
 PJsonVal TStoreImpl::GetStats() {
     PJsonVal res = TJsonVal::NewObj();
     res->AddToObj("name", GetStoreNm());
     res->AddToObj("blob_storage_memory", BlobBsStatsToJson(DataMem.GetBlobBsStats()));
     res->AddToObj("blob_storage_cache", BlobBsStatsToJson(DataCache.GetBlobBsStats()));
+    if (DataMem.IsCompressed() || DataCache.IsCompressed()) {
+        // block sizes before and after compression, since the store was opened
+        PJsonVal CompressVal = TJsonVal::NewObj();
+        CompressVal->AddToObj("memory_raw", DataMem.GetRawBlockBytes());
+        CompressVal->AddToObj("memory_stored", DataMem.GetStoredBlockBytes());
+        CompressVal->AddToObj("cache_raw", DataCache.GetRawBlockBytes());
+        CompressVal->AddToObj("cache_stored", DataCache.GetStoredBlockBytes());
+        res->AddToObj("block_compression", CompressVal);
+    }
+    if (DataCacheP) {
+        // reads of disk records served from the record buffer cache
+        PJsonVal RecCacheVal = TJsonVal::NewObj();
+        RecCacheVal->AddToObj("hits", RecMemCache.GetHits());
+        RecCacheVal->AddToObj("misses", RecMemCache.GetMisses());
+        res->AddToObj("record_cache", RecCacheVal);
+    }
+    if (IsPrimaryField()) {
+        PJsonVal PrimaryVal = TJsonVal::NewObj();
+        PrimaryVal->AddToObj("keys", PrimaryIndex.Len());
+        PrimaryVal->AddToObj("bytes", PrimaryIndex.GetMemUsed());
+        res->AddToObj("primary_index", PrimaryVal);
+    }
+    if (HotWndDesc.IsTiered()) {
+        PJsonVal HotVal = TJsonVal::NewObj();
+        HotVal->AddToObj("first_record", HotRecId.Val);
+        HotVal->AddToObj("demoted_blocks", DataMem.GetDemotedBlocks());
+        HotVal->AddToObj("cold_loads", DataMem.GetColdLoads());
+        res->AddToObj("hot_window", HotVal);
+    }
+    if (WndDesc.IsSegmented()) { res->AddToObj("segments", SegmentV.Len()); }
     return res;
 }
 
@@ -3974,7 +5280,10 @@ void TStoreImpl::RunVerificationForRecord(const uint64& RecId) {
 ///////////////////////////////
 /// TStorePbBlob
 
-uint64 TStorePbBlob::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {// check if we are given reference to existing record
+uint64 TStorePbBlob::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
+    // wait for background flusher when there is too much dirty data
+    TFlushScope FlushScope(GetBase()->GetFlusher(), true);
+    // check if we are given reference to existing record
     try {
         // parse out record id, if referred directly
         {
@@ -4038,8 +5347,12 @@ uint64 TStorePbBlob::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
         return TUInt64::Mx;
     }
 
-    // always add system field that means "inserted_at"
-    RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    // nested join records are added as part of this call
+    TWalScope WalScope(GetBase());
+    // always add system field that means "inserted_at", replayed records already have it
+    if (!IsWalReplay() || !RecVal->IsObjKey(TStoreWndDesc::SysInsertedAtFieldName)) {
+        RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    }
 
     // for storing record id
     TPgBlobPt CacheRecId;
@@ -4074,18 +5387,91 @@ uint64 TStorePbBlob::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
 
     // insert nested join records
     AddJoinRec(RecId, RecVal);
-    // call add triggers
+    // log the record, changes done by triggers are logged on their own
+    WalScope.Log(wotAddRec, GetStoreId(), RecVal);
+    // call add triggers, which also mark the store as modified
     if (TriggerEvents) {
         OnAdd(RecId);
+    } else {
+        TouchStore();
     }
 
     // return record Id of the new record
     return RecId;
 }
 
-/// Update existing record
-void TStorePbBlob::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
-    // figure out which storage fields are affected
+uint64 TStorePbBlob::AddRec(const TRecBuilder& Rec, const bool& TriggerEvents) {
+    // wait for background flusher when there is too much dirty data
+    TFlushScope FlushScope(GetBase()->GetFlusher(), true);
+    QmAssertR(Rec.GetStore()->GetStoreId() == GetStoreId(), "Record builder created for store " + Rec.GetStore()->GetStoreNm());
+    // check if we have a primary field with existing value
+    if (IsPrimaryField()) {
+        QmAssertR(Rec.IsFieldSet(PrimaryFieldId) && !Rec.IsFieldNull(PrimaryFieldId),
+            "Missing primary field in the record: " + GetFieldNm(PrimaryFieldId));
+        uint64 PrimaryRecId = TUInt64::Mx;
+        if (PrimaryFieldType == oftStr) {
+            const TStr& FieldVal = Rec.GetFieldStr(PrimaryFieldId);
+            if (PrimaryStrIdH.IsKey(FieldVal)) { PrimaryRecId = PrimaryStrIdH.GetDat(FieldVal); }
+        } else if (PrimaryFieldType == oftInt) {
+            const int FieldVal = Rec.GetFieldInt(PrimaryFieldId);
+            if (PrimaryIntIdH.IsKey(FieldVal)) { PrimaryRecId = PrimaryIntIdH.GetDat(FieldVal); }
+        } else if (PrimaryFieldType == oftUInt64) {
+            const uint64 FieldVal = Rec.GetFieldUInt64(PrimaryFieldId);
+            if (PrimaryUInt64IdH.IsKey(FieldVal)) { PrimaryRecId = PrimaryUInt64IdH.GetDat(FieldVal); }
+        } else if (PrimaryFieldType == oftFlt) {
+            const double FieldVal = Rec.GetFieldFlt(PrimaryFieldId);
+            if (PrimaryFltIdH.IsKey(FieldVal)) { PrimaryRecId = PrimaryFltIdH.GetDat(FieldVal); }
+        } else if (PrimaryFieldType == oftTm) {
+            const uint64 FieldVal = Rec.GetFieldTmMSecs(PrimaryFieldId);
+            if (PrimaryTmMSecsIdH.IsKey(FieldVal)) { PrimaryRecId = PrimaryTmMSecsIdH.GetDat(FieldVal); }
+        } else {
+            EAssertR(false, "Unsupported primary-field type");
+        }
+        if (PrimaryRecId != TUInt64::Mx) {
+            // existing record, updates are rare enough to go through JSon
+            PJsonVal RecVal = Rec.GetJson();
+            if (RecVal->GetObjKeys() > 1) { UpdateRec(PrimaryRecId, RecVal); }
+            return PrimaryRecId;
+        }
+    }
+
+    TWalScope WalScope(GetBase());
+    uint64 RecId = RecIdCounter++;
+    // store to disk storage
+    if (DataBlobP) {
+        TMem CacheRecMem;
+        SerializatorCache->Serialize(Rec, CacheRecMem, this);
+        RecIdBlobPtH.AddDat(RecId) = DataBlob->Put(CacheRecMem.GetBf(), CacheRecMem.Len());
+        // index new record
+        RecIndexer.IndexRec(CacheRecMem, RecId, *SerializatorCache);
+    }
+    // store to in-memory storage
+    if (DataMemP) {
+        TMem MemRecMem;
+        SerializatorMem->Serialize(Rec, MemRecMem, this);
+        RecIdBlobPtHMem.AddDat(RecId) = DataMem->Put(MemRecMem.GetBf(), MemRecMem.Len());
+        RecIndexer.IndexRec(MemRecMem, RecId, *SerializatorMem);
+    }
+
+    // remember value-recordId map when primary field available
+    if (IsPrimaryField()) { SetPrimaryField(RecId); }
+    // log the record, including the insert time set by the serializator
+    WalAddRec(WalScope, RecId, Rec);
+    // call add triggers, which also mark the store as modified
+    if (TriggerEvents) {
+        OnAdd(RecId);
+    } else {
+        TouchStore();
+    }
+
+    // return record Id of the new record
+    return RecId;
+}
+
+/// Update existing record
+void TStorePbBlob::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    // figure out which storage fields are affected
     bool CacheP = false, MemP = false, PrimaryP = false;
     bool CacheVarP = false, MemVarP = false, KeyP = false;
     for (int FieldId = 0; FieldId < GetFields(); FieldId++) {
@@ -4187,6 +5573,8 @@ void TStorePbBlob::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
     }
     // check if primary key changed and update the mapping
     if (PrimaryP) { SetPrimaryField(RecId); }
+    // log the update, changes done by triggers are logged on their own
+    WalUpdateRec(RecId, RecVal);
     // call update triggers
     OnUpdate(RecId);
 }
@@ -4195,6 +5583,7 @@ void TStorePbBlob::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
 
 /// Load page with with given record and return pointer to it
 TThinMIn TStorePbBlob::GetPgBf(const uint64& RecId, const bool& UseMem) const {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     if (UseMem) {
         const TPgBlobPt& PgPt = RecIdBlobPtHMem.GetDat(RecId);
         TThinMIn min = DataMem->Get(PgPt);
@@ -4382,6 +5771,7 @@ PJsonVal TStorePbBlob::GetFieldJsonVal(const uint64& RecId, const int& FieldId)
 //////////////////////
 
 TThinMIn TStorePbBlob::GetEditableField(const uint64& RecId, const int& FieldId) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     if (FieldLocV[FieldId] == TStoreLoc::slDisk) {
         TPgBlobPt& PgPt = RecIdBlobPtH.GetDat(RecId);
         DataBlob->SetDirty(PgPt);
@@ -4396,6 +5786,7 @@ TThinMIn TStorePbBlob::GetEditableField(const uint64& RecId, const int& FieldId)
 
 void TStorePbBlob::GetRecData(const uint64& RecId, const int& FieldId, TMemBase& Mem, THash<TUInt64, TPgBlobPt>* &RecIdBlobPtr, PPgBlob& Blob, TPgBlobPt* &PgPt)
 {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TMemBase MemInternal;
     if (FieldLocV[FieldId] == TStoreLoc::slDisk) {
         Blob = DataBlob;
@@ -4420,6 +5811,7 @@ void TStorePbBlob::GetRecData(const uint64& RecId, const int& FieldId, TMemBase&
 
 /// Set the value of given field to NULL
 void TStorePbBlob::SetFieldNull(const uint64& RecId, const int& FieldId) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4430,9 +5822,11 @@ void TStorePbBlob::SetFieldNull(const uint64& RecId, const int& FieldId) {
     }
 
     FieldSerializator->SetFieldNull(min.GetBfAddrChar(), min.Len(), FieldId, true);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldByte(const uint64& RecId, const int& FieldId, const uchar& Byte) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4448,9 +5842,11 @@ void TStorePbBlob::SetFieldByte(const uint64& RecId, const int& FieldId, const u
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
 
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldInt(const uint64& RecId, const int& FieldId, const int& Int) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4474,9 +5870,11 @@ void TStorePbBlob::SetFieldInt(const uint64& RecId, const int& FieldId, const in
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldInt(RecId, Int); }
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldInt16(const uint64& RecId, const int& FieldId, const int16& Int16) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4491,9 +5889,11 @@ void TStorePbBlob::SetFieldInt16(const uint64& RecId, const int& FieldId, const
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldInt64(const uint64& RecId, const int& FieldId, const int64& Int64) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4508,9 +5908,11 @@ void TStorePbBlob::SetFieldInt64(const uint64& RecId, const int& FieldId, const
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldIntV(const uint64& RecId, const int& FieldId, const TIntV& IntV) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4527,9 +5929,11 @@ void TStorePbBlob::SetFieldIntV(const uint64& RecId, const int& FieldId, const T
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldUInt(const uint64& RecId, const int& FieldId, const uint& UInt) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4544,9 +5948,11 @@ void TStorePbBlob::SetFieldUInt(const uint64& RecId, const int& FieldId, const u
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldUInt16(const uint64& RecId, const int& FieldId, const uint16& UInt16) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4561,9 +5967,11 @@ void TStorePbBlob::SetFieldUInt16(const uint64& RecId, const int& FieldId, const
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldUInt64(const uint64& RecId, const int& FieldId, const uint64& UInt64) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4588,10 +5996,12 @@ void TStorePbBlob::SetFieldUInt64(const uint64& RecId, const int& FieldId, const
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldUInt64(RecId, UInt64); }
+    WalSetField(RecId, FieldId);
 }
 
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldStr(const uint64& RecId, const int& FieldId, const TStr& Str) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4620,9 +6030,11 @@ void TStorePbBlob::SetFieldStr(const uint64& RecId, const int& FieldId, const TS
         SetPrimaryFieldStr(RecId, Str);
     }
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldStrV(const uint64& RecId, const int& FieldId, const TStrV& StrV) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4639,9 +6051,11 @@ void TStorePbBlob::SetFieldStrV(const uint64& RecId, const int& FieldId, const T
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldBool(const uint64& RecId, const int& FieldId, const bool& Bool) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4656,9 +6070,11 @@ void TStorePbBlob::SetFieldBool(const uint64& RecId, const int& FieldId, const b
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldFlt(const uint64& RecId, const int& FieldId, const double& Flt) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4683,9 +6099,11 @@ void TStorePbBlob::SetFieldFlt(const uint64& RecId, const int& FieldId, const do
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldFlt(RecId, Flt); }
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldSFlt(const uint64& RecId, const int& FieldId, const float& SFlt) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4700,9 +6118,11 @@ void TStorePbBlob::SetFieldSFlt(const uint64& RecId, const int& FieldId, const f
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldFltPr(const uint64& RecId, const int& FieldId, const TFltPr& FltPr) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4717,9 +6137,11 @@ void TStorePbBlob::SetFieldFltPr(const uint64& RecId, const int& FieldId, const
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldFltV(const uint64& RecId, const int& FieldId, const TFltV& FltV) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4736,9 +6158,11 @@ void TStorePbBlob::SetFieldFltV(const uint64& RecId, const int& FieldId, const T
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldTm(const uint64& RecId, const int& FieldId, const TTm& Tm) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // get the memory containig the field for the record
     TThinMIn min = GetEditableField(RecId, FieldId);
 
@@ -4753,9 +6177,11 @@ void TStorePbBlob::SetFieldTm(const uint64& RecId, const int& FieldId, const TTm
 
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, const uint64& TmMSecs) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // special case if field is primary field
     if (FieldId == PrimaryFieldId) {
         // it is, make sure new value does not exist yet
@@ -4780,9 +6206,11 @@ void TStorePbBlob::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, cons
     // index the new value in the updated memory buffer
     RecIndexer.IndexRecField(min.GetMemBase(), RecId, FieldId, *FieldSerializator);
     if (FieldId == PrimaryFieldId) { SetPrimaryFieldMSecs(RecId, TmMSecs); }
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldNumSpV(const uint64& RecId, const int& FieldId, const TIntFltKdV& SpV) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4799,9 +6227,11 @@ void TStorePbBlob::SetFieldNumSpV(const uint64& RecId, const int& FieldId, const
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldBowSpV(const uint64& RecId, const int& FieldId, const PBowSpV& SpV) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4818,9 +6248,11 @@ void TStorePbBlob::SetFieldBowSpV(const uint64& RecId, const int& FieldId, const
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldTMem(const uint64& RecId, const int& FieldId, const TMem& Mem) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4837,9 +6269,11 @@ void TStorePbBlob::SetFieldTMem(const uint64& RecId, const int& FieldId, const T
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalSetField(RecId, FieldId);
 }
 /// Set field value using field id (default implementation throws exception)
 void TStorePbBlob::SetFieldJsonVal(const uint64& RecId, const int& FieldId, const PJsonVal& Json) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TRecSerializator* FieldSerializator = GetFieldSerializator(FieldId);
     THash<TUInt64, TPgBlobPt>* RecIdBlobPtr = NULL;
     PPgBlob Blob; TPgBlobPt* PgPt = NULL;
@@ -4856,6 +6290,7 @@ void TStorePbBlob::SetFieldJsonVal(const uint64& RecId, const int& FieldId, cons
     // index new data
     RecIndexer.IndexRecField(mem_out, RecId, FieldId, *FieldSerializator);
     RecIdBlobPtr->GetDat(RecId) = Blob->Put(mem_out.GetBf(), mem_out.Len(), *PgPt);
+    WalSetField(RecId, FieldId);
 }
 
 /// Check if given ID is valid
@@ -4980,8 +6415,33 @@ int TStorePbBlob::GetCodebookId(const int& FieldId, const TStr& Str) const {
 
 /// Save part of the data, given time-window
 int TStorePbBlob::PartialFlush(int WndInMsec) {
-    DataBlob->PartialFlush(WndInMsec);
-    return 0;
+    const int Slice = WndInMsec / 2;
+    return DataBlob->PartialFlush(Slice) + DataMem->PartialFlush(Slice);
+}
+
+/// Save all pages and store state
+void TStorePbBlob::Flush() {
+    QmAssertR(FAccess != faRdOnly, "Store " + GetStoreNm() + " opened in read-only mode");
+    DataBlob->Flush();
+    DataMem->Flush();
+    SaveStoreState();
+}
+
+/// Keep paged files saved by the last Flush unchanged until the next checkpoint
+void TStorePbBlob::EnableCheckpoints(const uint64& CheckpointLsn) {
+    DataBlob->EnableCheckpoints(CheckpointLsn);
+    DataMem->EnableCheckpoints(CheckpointLsn);
+}
+
+/// Release pages kept for the previous checkpoint
+void TStorePbBlob::EndCheckpoint(const uint64& CheckpointLsn) {
+    DataBlob->EndCheckpoint(CheckpointLsn);
+    DataMem->EndCheckpoint(CheckpointLsn);
+}
+
+/// Size of pages changed since they were last saved
+uint64 TStorePbBlob::GetDirtyBytes() {
+    return DataBlob->GetDirtyBytes() + DataMem->GetDirtyBytes();
 }
 
 /// Retrieve performance statistics for this store
@@ -5077,9 +6537,12 @@ void TStorePbBlob::Defrag() {
 
 /// Deletes all records
 void TStorePbBlob::DeleteAllRecs() {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     // if no records, nothing to do here
     if (Empty()) { return; }
     TEnv::Logger->OnStatusFmt("Deleting all (%d) records in %s", GetRecs(), GetStoreNm().CStr());
+    // joins are removed as part of this call
+    TWalScope WalScope(GetBase());
 
     // delete records from index
     //for (uint64 DelRecId = GetFirstRecId(); DelRecId <= GetLastRecId(); DelRecId++) {
@@ -5133,6 +6596,7 @@ void TStorePbBlob::DeleteAllRecs() {
     DataBlob->Clr();
     DataMem->Clr();
     PartialFlush(TInt::Mx);
+    WalScope.Log(wotDelAllRecs, GetStoreId(), TJsonVal::NewObj());
 }
 
 
@@ -5154,6 +6618,9 @@ void TStorePbBlob::DeleteFirstRecs(const int& Recs) {
 }
 
 void TStorePbBlob::DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs, const bool& AssertOK) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    // joins are removed as part of this call
+    TWalScope WalScope(GetBase());
     if (AssertOK) {
         // assert that DelRecIdV is valid
         THash<TUInt64, TPgBlobPt>* Ht = (DataMemP ? &RecIdBlobPtHMem : &RecIdBlobPtH);
@@ -5164,6 +6631,7 @@ void TStorePbBlob::DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs,
     }
     // delete records
     TTmStopWatch StopWatch(true);
+    int DeletedRecs = 0;
     for (int DelRecN = 0; DelRecN < DelRecIdV.Len(); DelRecN++) {
         // report progress
         if (DelRecN > 0 && DelRecN % 1000 == 0) { TEnv::Logger->OnStatusFmt("    %d\r", DelRecN); }
@@ -5207,7 +6675,11 @@ void TStorePbBlob::DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs,
             DataMem->Del(Pt);
             RecIdBlobPtHMem.DelKey(DelRecId);
         }
+        // count what we deleted
+        DeletedRecs++;
     }
+    // log records which were deleted
+    WalDelRecs(WalScope, DelRecIdV, DeletedRecs);
 
     // report success :-)
     if (DelRecIdV.Len() > 1000) {
@@ -5361,39 +6833,43 @@ TStorePbBlob::~TStorePbBlob() {
     // save if necessary
     if (FAccess != faRdOnly) {
         TEnv::Logger->OnStatus(TStr::Fmt("Saving store '%s'...", GetStoreNm().CStr()));
-        // save base store
-        TFOut BaseFOut(StoreFNm + ".BaseStore");
-        SaveStore(BaseFOut);
-        // save store parameters
-        TFOut FOut(StoreFNm + "PgBlobStore");
-        // save parameters about primary field
-        RecNmFieldP.Save(FOut);
-        PrimaryFieldId.Save(FOut);
-        if (PrimaryFieldType == oftInt) {
-            PrimaryIntIdH.Save(FOut);
-        } else if (PrimaryFieldType == oftUInt64) {
-            PrimaryUInt64IdH.Save(FOut);
-        } else if (PrimaryFieldType == oftFlt) {
-            PrimaryFltIdH.Save(FOut);
-        } else if (PrimaryFieldType == oftTm) {
-            PrimaryTmMSecsIdH.Save(FOut);
-        } else {
-            PrimaryStrIdH.Save(FOut);
-        }
-        // save time window
-        WndDesc.Save(FOut);
-        // save data
-        SerializatorCache->Save(FOut);
-        SerializatorMem->Save(FOut);
-
-        RecIdBlobPtH.Save(FOut);
-        RecIdBlobPtHMem.Save(FOut);
-        RecIdCounter.Save(FOut);
+        SaveStoreState();
     } else {
         TEnv::Logger->OnStatus("No saving of generic store " + GetStoreNm() + " neccessary!");
     }
 }
 
+void TStorePbBlob::SaveStoreState() const {
+    // save base store
+    TFOut BaseFOut(StoreFNm + ".BaseStore");
+    SaveStore(BaseFOut);
+    // save store parameters
+    TFOut FOut(StoreFNm + "PgBlobStore");
+    // save parameters about primary field
+    RecNmFieldP.Save(FOut);
+    PrimaryFieldId.Save(FOut);
+    if (PrimaryFieldType == oftInt) {
+        PrimaryIntIdH.Save(FOut);
+    } else if (PrimaryFieldType == oftUInt64) {
+        PrimaryUInt64IdH.Save(FOut);
+    } else if (PrimaryFieldType == oftFlt) {
+        PrimaryFltIdH.Save(FOut);
+    } else if (PrimaryFieldType == oftTm) {
+        PrimaryTmMSecsIdH.Save(FOut);
+    } else {
+        PrimaryStrIdH.Save(FOut);
+    }
+    // save time window
+    WndDesc.Save(FOut);
+    // save data
+    SerializatorCache->Save(FOut);
+    SerializatorMem->Save(FOut);
+
+    RecIdBlobPtH.Save(FOut);
+    RecIdBlobPtHMem.Save(FOut);
+    RecIdCounter.Save(FOut);
+}
+
 /// Store value into internal storage using TOAST method
 TPgBlobPt TStorePbBlob::ToastVal(const TMemBase& Mem) {
     TVec<TPgBlobPt> Pts;
@@ -5412,6 +6888,7 @@ TPgBlobPt TStorePbBlob::ToastVal(const TMemBase& Mem) {
 
 /// Retrieve value that is saved using TOAST method from storage
 void TStorePbBlob::UnToastVal(const TPgBlobPt& Pt, TMem& Mem) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
     TVec<TPgBlobPt> Pts;
     TThinMIn MIn = DataBlob->Get(Pt);
     Pts.Load(MIn);
@@ -5615,11 +7092,784 @@ void TStoreNotImpl::SetFieldJsonVal(const uint64& RecId, const int& FieldId, con
 void TStoreNotImpl::RunVerification() { }
 void TStoreNotImpl::RunVerificationForRecord(const uint64& RecId) { }
 
+///////////////////////////////
+/// Columnar store
+TStoreColumnar::TColumn::TColumn(const int& _FieldId, const TFieldType& _FieldType,
+        const bool& _NullableP, const PJsonVal& _DefaultVal): FieldId(_FieldId),
+        FieldType(_FieldType), ValLen(GetValLen(_FieldType)), NullableP(_NullableP),
+        DefaultVal(_DefaultVal) {
+
+    EAssert(ValLen > 0);
+}
+
+TStoreColumnar::TColumn::TColumn(TSIn& SIn): FieldId(SIn), FieldType(SIn),
+        ValLen(SIn), NullableP(SIn) {
+
+    // default value is stored as JSon string
+    TBool DefaultValP(SIn);
+    if (DefaultValP) { DefaultVal = TJsonVal::GetValFromStr(TStr(SIn)); }
+    // values are stored as raw buffer
+    int64 ValBfLen; SIn.Load(ValBfLen);
+    ValV.Gen(ValBfLen); SIn.LoadBf(ValV.BegI(), ValBfLen);
+    NullV.Load(SIn);
+}
+
+void TStoreColumnar::TColumn::Save(TSOut& SOut) const {
+    FieldId.Save(SOut);
+    FieldType.Save(SOut);
+    ValLen.Save(SOut);
+    NullableP.Save(SOut);
+    TBool(!DefaultVal.Empty()).Save(SOut);
+    if (!DefaultVal.Empty()) { TJsonVal::GetStrFromVal(DefaultVal).Save(SOut); }
+    SOut.Save(ValV.Len());
+    SOut.SaveBf(ValV.BegI(), ValV.Len());
+    NullV.Save(SOut);
+}
+
+int TStoreColumnar::TColumn::GetValLen(const TFieldType& FieldType) {
+    switch (FieldType) {
+        case oftByte: return sizeof(uchar);
+        case oftBool: return sizeof(uchar);
+        case oftInt16: return sizeof(int16);
+        case oftUInt16: return sizeof(uint16);
+        case oftInt: return sizeof(int);
+        case oftUInt: return sizeof(uint);
+        case oftSFlt: return sizeof(float);
+        case oftInt64: return sizeof(int64);
+        case oftUInt64: return sizeof(uint64);
+        case oftFlt: return sizeof(double);
+        case oftTm: return sizeof(uint64);
+        default: return -1;
+    }
+}
+
+double TStoreColumnar::TColumn::GetFlt(const int64& ValN) const {
+    switch (FieldType) {
+        case oftByte: return (double)GetVal<uchar>(ValN);
+        case oftInt: return (double)GetVal<int>(ValN);
+        case oftInt16: return (double)GetVal<int16>(ValN);
+        case oftInt64: return (double)GetVal<int64>(ValN);
+        case oftUInt: return (double)GetVal<uint>(ValN);
+        case oftUInt16: return (double)GetVal<uint16>(ValN);
+        case oftUInt64: return (double)GetVal<uint64>(ValN);
+        case oftBool: return GetVal<uchar>(ValN) != 0 ? 1.0 : 0.0;
+        case oftFlt: return GetVal<double>(ValN);
+        case oftSFlt: return (double)GetVal<float>(ValN);
+        default: throw TQmExcept::New("[TStoreColumnar] Field type not numeric");
+    }
+}
+
+void TStoreColumnar::TColumn::SetNull(const int64& ValN, const bool& NullP) {
+    EAssert(NullableP);
+    const uint64 Mask = uint64(1) << (ValN % 64);
+    if (NullP) { NullV[ValN / 64].Val |= Mask; } else { NullV[ValN / 64].Val &= ~Mask; }
+}
+
+void TStoreColumnar::TColumn::AddVal(const bool& NullP) {
+    const int64 ValN = Len();
+    // append zero value
+    for (int ByteN = 0; ByteN < ValLen; ByteN++) { ValV.Add(0); }
+    // extend the bitmap when needed and set the flag
+    if (NullableP) {
+        if (ValN / 64 >= NullV.Len()) { NullV.Add(0); }
+        SetNull(ValN, NullP);
+    } else {
+        QmAssert(!NullP);
+    }
+}
+
+void TStoreColumnar::TColumn::DelVals(const int64& Vals) {
+    if (Vals <= 0) { return; }
+    const int64 NewVals = Len() - Vals;
+    // shift values to the start of the vector
+    memmove(ValV.BegI(), GetValPt(Vals), NewVals * ValLen);
+    // shift NULL flags
+    if (NullableP) {
+        for (int64 ValN = 0; ValN < NewVals; ValN++) {
+            SetNull(ValN, IsNull(ValN + Vals));
+        }
+    }
+    Trunc(NewVals);
+}
+
+void TStoreColumnar::TColumn::Trunc(const int64& Vals) {
+    ValV.Trunc(Vals * ValLen);
+    if (NullableP) { NullV.Trunc((Vals + 63) / 64); }
+}
+
+int64 TStoreColumnar::GetValN(const uint64& RecId) const {
+    QmAssertR(IsRecId(RecId), "[TStoreColumnar] Invalid record id: " + TUInt64::GetStr(RecId));
+    return (int64)(RecId - FirstValRecId);
+}
+
+const TStoreColumnar::TColumn& TStoreColumnar::GetColumn(const int& FieldId,
+        const TFieldType& FieldType, const TStr& TypeStr) const {
+
+    const TColumn& Column = ColumnV[FieldId];
+    if (Column.FieldType != FieldType) { throw FieldError(FieldId, TypeStr); }
+    return Column;
+}
+
+TStoreColumnar::TColumn& TStoreColumnar::GetColumn(const int& FieldId,
+        const TFieldType& FieldType, const TStr& TypeStr) {
+
+    TColumn& Column = ColumnV[FieldId];
+    if (Column.FieldType != FieldType) { throw FieldError(FieldId, TypeStr); }
+    return Column;
+}
+
+void TStoreColumnar::SetJsonVal(TColumn& Column, const int64& ValN, const PJsonVal& JsonVal) {
+    const TStr& FieldNm = GetFieldNm(Column.FieldId);
+    if (Column.FieldType == oftBool) {
+        QmAssertR(JsonVal->IsBool(), "Provided JSon data field " + FieldNm + " is not boolean.");
+        Column.SetVal<uchar>(ValN, JsonVal->GetBool() ? 1 : 0);
+    } else if (Column.FieldType == oftTm) {
+        QmAssertR(JsonVal->IsStr() || JsonVal->IsNum(), "Provided JSon data field " + FieldNm +
+            " is not a number or a string that represents DateTime.");
+        if (JsonVal->IsStr()) {
+            TTm Tm = TTm::GetTmFromWebLogDateTimeStr(JsonVal->GetStr(), '-', ':', '.', 'T');
+            Column.SetVal<uint64>(ValN, TTm::GetMSecsFromTm(Tm));
+        } else {
+            Column.SetVal<uint64>(ValN, TTm::GetWinMSecsFromUnixMSecs(JsonVal->GetInt64()));
+        }
+    } else {
+        QmAssertR(JsonVal->IsNum(), "Provided JSon data field " + FieldNm + " is not numeric.");
+        switch (Column.FieldType) {
+            case oftByte: Column.SetVal<uchar>(ValN, (uchar)JsonVal->GetUInt64()); break;
+            case oftInt: Column.SetVal<int>(ValN, JsonVal->GetInt()); break;
+            case oftInt16: Column.SetVal<int16>(ValN, (int16)JsonVal->GetInt()); break;
+            case oftInt64: Column.SetVal<int64>(ValN, (int64)JsonVal->GetNum()); break;
+            case oftUInt: Column.SetVal<uint>(ValN, (uint)JsonVal->GetUInt64()); break;
+            case oftUInt16: Column.SetVal<uint16>(ValN, (uint16)JsonVal->GetUInt64()); break;
+            case oftUInt64: Column.SetVal<uint64>(ValN, JsonVal->GetUInt64()); break;
+            case oftFlt: Column.SetVal<double>(ValN, JsonVal->GetNum()); break;
+            case oftSFlt: Column.SetVal<float>(ValN, (float)JsonVal->GetNum()); break;
+            default: throw TQmExcept::New("[TStoreColumnar] Unsupported field type for field " + FieldNm);
+        }
+    }
+}
+
+void TStoreColumnar::SetRecVal(TColumn& Column, const int64& ValN, const TRecBuilder& Rec) {
+    const int FieldId = Column.FieldId;
+    switch (Column.FieldType) {
+        case oftByte: Column.SetVal<uchar>(ValN, Rec.GetFieldByte(FieldId)); break;
+        case oftBool: Column.SetVal<uchar>(ValN, Rec.GetFieldBool(FieldId) ? 1 : 0); break;
+        case oftInt: Column.SetVal<int>(ValN, Rec.GetFieldInt(FieldId)); break;
+        case oftInt16: Column.SetVal<int16>(ValN, Rec.GetFieldInt16(FieldId)); break;
+        case oftInt64: Column.SetVal<int64>(ValN, Rec.GetFieldInt64(FieldId)); break;
+        case oftUInt: Column.SetVal<uint>(ValN, Rec.GetFieldUInt(FieldId)); break;
+        case oftUInt16: Column.SetVal<uint16>(ValN, Rec.GetFieldUInt16(FieldId)); break;
+        case oftUInt64: Column.SetVal<uint64>(ValN, Rec.GetFieldUInt64(FieldId)); break;
+        case oftFlt: Column.SetVal<double>(ValN, Rec.GetFieldFlt(FieldId)); break;
+        case oftSFlt: Column.SetVal<float>(ValN, Rec.GetFieldSFlt(FieldId)); break;
+        case oftTm: Column.SetVal<uint64>(ValN, Rec.GetFieldTmMSecs(FieldId)); break;
+        default: throw TQmExcept::New("[TStoreColumnar] Unsupported field type for field " + GetFieldNm(FieldId));
+    }
+}
+
+template <class TVal>
+void TStoreColumnar::IndexLinear(const int& KeyId, const TVal& Val,
+        const uint64& RecId, const bool& DeleteP) {
+
+    if (DeleteP) {
+        GetIndex()->DeleteLinear(KeyId, Val, RecId);
+    } else {
+        GetIndex()->IndexLinear(KeyId, Val, RecId);
+    }
+}
+
+void TStoreColumnar::IndexVal(const TColumn& Column, const int64& ValN,
+        const uint64& RecId, const bool& DeleteP) {
+
+    // NULL values are not indexed
+    if (Column.KeyIdV.Empty() || Column.IsNull(ValN)) { return; }
+    for (int KeyN = 0; KeyN < Column.KeyIdV.Len(); KeyN++) {
+        const int KeyId = Column.KeyIdV[KeyN];
+        switch (Column.FieldType) {
+            case oftByte: IndexLinear(KeyId, Column.GetVal<uchar>(ValN), RecId, DeleteP); break;
+            case oftInt: IndexLinear(KeyId, Column.GetVal<int>(ValN), RecId, DeleteP); break;
+            case oftInt16: IndexLinear(KeyId, Column.GetVal<int16>(ValN), RecId, DeleteP); break;
+            case oftInt64: IndexLinear(KeyId, Column.GetVal<int64>(ValN), RecId, DeleteP); break;
+            case oftUInt: IndexLinear(KeyId, Column.GetVal<uint>(ValN), RecId, DeleteP); break;
+            case oftUInt16: IndexLinear(KeyId, Column.GetVal<uint16>(ValN), RecId, DeleteP); break;
+            case oftUInt64: IndexLinear(KeyId, Column.GetVal<uint64>(ValN), RecId, DeleteP); break;
+            case oftTm: IndexLinear(KeyId, Column.GetVal<uint64>(ValN), RecId, DeleteP); break;
+            case oftFlt: IndexLinear(KeyId, Column.GetVal<double>(ValN), RecId, DeleteP); break;
+            case oftSFlt: IndexLinear(KeyId, Column.GetVal<float>(ValN), RecId, DeleteP); break;
+            default: throw TQmExcept::New("[TStoreColumnar] Unsupported linear index on field " +
+                GetFieldNm(Column.FieldId));
+        }
+    }
+}
+
+template <class TVal>
+TVal TStoreColumnar::GetFieldVal(const uint64& RecId, const int& FieldId,
+        const TFieldType& FieldType, const TStr& TypeStr) const {
+
+    const TColumn& Column = GetColumn(FieldId, FieldType, TypeStr);
+    const int64 ValN = GetValN(RecId);
+    // value of a field set to NULL is left in the column
+    return Column.IsNull(ValN) ? TVal() : Column.GetVal<TVal>(ValN);
+}
+
+template <class TVal>
+void TStoreColumnar::SetFieldVal(const uint64& RecId, const int& FieldId,
+        const TFieldType& FieldType, const TStr& TypeStr, const TVal& Val) {
+
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TColumn& Column = GetColumn(FieldId, FieldType, TypeStr);
+    const int64 ValN = GetValN(RecId);
+    IndexVal(Column, ValN, RecId, true);
+    Column.SetVal<TVal>(ValN, Val);
+    if (Column.NullableP) { Column.SetNull(ValN, false); }
+    IndexVal(Column, ValN, RecId, false);
+    DirtyBytes += (uint64)Column.ValLen;
+    WalSetField(RecId, FieldId);
+}
+
+void TStoreColumnar::InitKeys() {
+    TWPt<TIndexVoc> IndexVoc = GetIndex()->GetIndexVoc();
+    for (int FieldId = 0; FieldId < ColumnV.Len(); FieldId++) {
+        const TFieldDesc& FieldDesc = GetFieldDesc(FieldId);
+        TColumn& Column = ColumnV[FieldId];
+        Column.KeyIdV.Clr();
+        for (int KeyN = 0; KeyN < FieldDesc.GetKeys(); KeyN++) {
+            const int KeyId = FieldDesc.GetKeyId(KeyN);
+            QmAssertR(IndexVoc->GetKey(KeyId).IsLinear(),
+                "TStoreColumnar supports only linear index keys: " + FieldDesc.GetFieldNm());
+            Column.KeyIdV.Add(KeyId);
+        }
+    }
+}
+
+uint64 TStoreColumnar::GetRecLen() const {
+    uint64 RecLen = 0;
+    for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+        RecLen += (uint64)ColumnV[ColumnN].ValLen;
+    }
+    return RecLen;
+}
+
+void TStoreColumnar::DelFirstRecs(const uint64& DelRecs, const int& MxTimeMSecs) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    // joins are removed as part of this call
+    TWalScope WalScope(GetBase());
+    TTmStopWatch StopWatch(true);
+    const uint64 StartRecId = FirstRecId;
+    const uint64 EndRecId = FirstRecId + TMath::Mn(DelRecs, GetRecs());
+    while (FirstRecId < EndRecId) {
+        // check if we still have time
+        if ((MxTimeMSecs != -1) && (StopWatch.GetMSecInt() > MxTimeMSecs)) {
+            TEnv::Logger->OnStatusFmt("Reached time limit of %d msecs in TStoreColumnar::DeleteRecs", MxTimeMSecs);
+            break;
+        }
+        const uint64 DelRecId = FirstRecId;
+        // executed triggers before deletion
+        OnDelete(DelRecId);
+        // delete record from indexes
+        const int64 ValN = GetValN(DelRecId);
+        for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+            IndexVal(ColumnV[ColumnN], ValN, DelRecId, true);
+        }
+        // delete record from joins
+        TRec Rec(this, DelRecId);
+        for (int JoinN = 0; JoinN < GetJoins(); JoinN++) {
+            TJoinDesc JoinDesc = GetJoinDesc(JoinN);
+            // execute the join
+            PRecSet JoinRecSet = Rec.DoJoin(GetBase(), JoinDesc.GetJoinId());
+            for (int JoinRecN = 0; JoinRecN < JoinRecSet->GetRecs(); JoinRecN++) {
+                // remove joins with all matched records, one by one
+                const uint64 JoinRecId = JoinRecSet->GetRecId(JoinRecN);
+                DelJoin(JoinDesc.GetJoinId(), DelRecId, JoinRecId);
+            }
+        }
+        FirstRecId++;
+    }
+    DirtyBytes += (FirstRecId - StartRecId) * GetRecLen();
+    // log records which were deleted
+    if (WalScope.IsLog()) {
+        TUInt64V DelRecIdV((int)(FirstRecId - StartRecId), 0);
+        for (uint64 DelRecId = StartRecId; DelRecId < FirstRecId; DelRecId++) { DelRecIdV.Add(DelRecId); }
+        WalDelRecs(WalScope, DelRecIdV, DelRecIdV.Len());
+    }
+    // compact columns once deleted values take more space than the live ones,
+    // so each value is moved only a constant number of times on average
+    const uint64 DeadVals = FirstRecId - FirstValRecId;
+    if (DeadVals > 0 && DeadVals >= GetRecs()) {
+        for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+            ColumnV[ColumnN].DelVals((int64)DeadVals);
+        }
+        FirstValRecId = FirstRecId;
+    }
+}
+
+TStoreColumnar::TStoreColumnar(const TWPt<TBase>& Base, const uint& StoreId,
+    const TStr& StoreName, const TStoreSchema& StoreSchema, const TStr& _StoreFNm):
+        TStoreNotImpl(Base, StoreId, StoreName), StoreFNm(_StoreFNm),
+        FAccess(Base->GetFAccess()) {
+
+    SetStoreType("TStoreColumnar");
+    // create fields, each with its own column
+    for (int FieldN = 0; FieldN < StoreSchema.FieldH.Len(); FieldN++) {
+        const TFieldDesc& FieldDesc = StoreSchema.FieldH[FieldN];
+        const TFieldDescEx& FieldDescEx = StoreSchema.FieldExH.GetDat(FieldDesc.GetFieldNm());
+        QmAssertR(TColumn::GetValLen(FieldDesc.GetFieldType()) != -1, "TStoreColumnar does not support field type " +
+            FieldDesc.GetFieldTypeStr() + " of field " + FieldDesc.GetFieldNm());
+        QmAssertR(!FieldDesc.IsPrimary(), "TStoreColumnar does not support primary fields");
+        QmAssertR(FieldDescEx.FieldStoreLoc == slMemory, "TStoreColumnar does not support disk location");
+        const int FieldId = AddFieldDesc(FieldDesc);
+        ColumnV.Add(TColumn(FieldId, FieldDesc.GetFieldType(),
+            FieldDesc.IsNullable(), FieldDescEx.DefaultVal));
+    }
+    // create index keys
+    for (int IndexKeyExN = 0; IndexKeyExN < StoreSchema.IndexKeyExV.Len(); IndexKeyExN++) {
+        const TIndexKeyEx& IndexKeyEx = StoreSchema.IndexKeyExV[IndexKeyExN];
+        QmAssertR(IndexKeyEx.IsLinear(), "TStoreColumnar supports only linear index keys");
+        const int FieldId = GetFieldId(IndexKeyEx.FieldName);
+        QmAssertR(ColumnV[FieldId].FieldType != oftBool, "TStoreColumnar does not support index on boolean fields");
+        const int WordVocId = GetBase()->NewIndexWordVoc(IndexKeyEx.KeyType, IndexKeyEx.WordVocName);
+        GetBase()->NewFieldIndexKey(this, IndexKeyEx.KeyIndexName,
+            FieldId, WordVocId, IndexKeyEx.KeyType, IndexKeyEx.GixType, IndexKeyEx.SortType);
+    }
+    InitKeys();
+    // remember window parameters
+    WndDesc = StoreSchema.WndDesc;
+}
+
+TStoreColumnar::TStoreColumnar(const TWPt<TBase>& Base, const TStr& _StoreFNm):
+        TStoreNotImpl(Base, _StoreFNm + ".BaseStore"), StoreFNm(_StoreFNm),
+        FAccess(Base->GetFAccess()) {
+
+    SetStoreType("TStoreColumnar");
+    // load columns
+    TFIn FIn(StoreFNm + ".Columnar");
+    WndDesc.Load(FIn);
+    FirstValRecId.Load(FIn);
+    FirstRecId.Load(FIn);
+    NextRecId.Load(FIn);
+    ColumnV.Load(FIn);
+    InitKeys();
+}
+
+TStoreColumnar::~TStoreColumnar() {
+    // save if necessary
+    if (FAccess != faRdOnly) {
+        TEnv::Logger->OnStatus(TStr::Fmt("Saving store '%s'...", GetStoreNm().CStr()));
+        Flush();
+    } else {
+        TEnv::Logger->OnStatus("No saving of columnar store " + GetStoreNm() + " neccessary!");
+    }
+}
+
+void TStoreColumnar::Flush() {
+    QmAssertR(FAccess != faRdOnly, "Store " + GetStoreNm() + " opened in read-only mode");
+    // save base store
+    TFOut BaseFOut(StoreFNm + ".BaseStore");
+    SaveStore(BaseFOut);
+    // save columns
+    TFOut FOut(StoreFNm + ".Columnar");
+    WndDesc.Save(FOut);
+    FirstValRecId.Save(FOut);
+    FirstRecId.Save(FOut);
+    NextRecId.Save(FOut);
+    ColumnV.Save(FOut);
+    DirtyBytes = 0;
+}
+
+int TStoreColumnar::PartialFlush(int WndInMsec) {
+    TWriteScope WriteScope(GetBase());
+    if (FAccess == faRdOnly || DirtyBytes == 0) { return 0; }
+    Flush();
+    return 1;
+}
+
+PStoreIter TStoreColumnar::GetIter() const {
+    if (Empty()) { return TStoreIterVec::New(); }
+    return TStoreIterVec::New(GetFirstRecId(), GetLastRecId(), true);
+}
+
+PStoreIter TStoreColumnar::BackwardIter() const {
+    if (Empty()) { return TStoreIterVec::New(); }
+    return TStoreIterVec::New(GetLastRecId(), GetFirstRecId(), false);
+}
+
+uint64 TStoreColumnar::AddRec(const PJsonVal& RecVal, const bool& TriggerEvents) {
+    // wait for background flusher when there is too much dirty data
+    TFlushScope FlushScope(GetBase()->GetFlusher(), true);
+    // check if we are given reference to existing record
+    try {
+        const uint64 RecId = TStore::GetRecId(RecVal);
+        if (IsRecId(RecId)) {
+            // check if we have anything more than record identifier, which would require calling UpdateRec
+            if (RecVal->GetObjKeys() > 1) { UpdateRec(RecId, RecVal); }
+            return RecId;
+        }
+    } catch (const PExcept& Except) {
+        // error parsing, report error and return nothing
+        ErrorLog("[TStoreColumnar::AddRec] Error parsing out reference to existing record:");
+        ErrorLog(Except->GetMsgStr());
+        return TUInt64::Mx;
+    }
+
+    // nested join records are added as part of this call
+    TWalScope WalScope(GetBase());
+    // add system field that means "inserted_at" when window depends on it,
+    // replayed records already have it
+    if (WndDesc.InsertP && (!IsWalReplay() || !RecVal->IsObjKey(TStoreWndDesc::SysInsertedAtFieldName))) {
+        RecVal->AddToObj(TStoreWndDesc::SysInsertedAtFieldName, TTm::GetCurUniTm().GetStr());
+    }
+
+    // append values to columns, rolling back all of them if any fails to parse
+    const int64 ValN = (int64)(NextRecId - FirstValRecId);
+    try {
+        for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+            TColumn& Column = ColumnV[ColumnN];
+            const TStr& FieldNm = GetFieldNm(Column.FieldId);
+            PJsonVal FieldVal = RecVal->IsObjKey(FieldNm) ?
+                RecVal->GetObjKey(FieldNm) : Column.DefaultVal;
+            if (FieldVal.Empty()) {
+                QmAssertR(Column.NullableP, "JSon data is missing field - expecting " +
+                    FieldNm + ", store " + GetStoreNm());
+                Column.AddVal(true);
+            } else if (FieldVal->IsNull()) {
+                QmAssertR(Column.NullableP, "Non-nullable field " + FieldNm + " set to null");
+                Column.AddVal(true);
+            } else {
+                Column.AddVal(false);
+                SetJsonVal(Column, ValN, FieldVal);
+            }
+        }
+    } catch (const PExcept& Except) {
+        for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+            ColumnV[ColumnN].Trunc(ValN);
+        }
+        throw;
+    }
+    const uint64 RecId = NextRecId++;
+    DirtyBytes += GetRecLen();
+
+    // index new record
+    for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+        IndexVal(ColumnV[ColumnN], ValN, RecId, false);
+    }
+    // insert nested join records
+    AddJoinRec(RecId, RecVal);
+    // log the record, changes done by triggers are logged on their own
+    WalScope.Log(wotAddRec, GetStoreId(), RecVal);
+    // call add triggers, which also mark the store as modified
+    if (TriggerEvents) { OnAdd(RecId); } else { TouchStore(); }
+
+    // return record Id of the new record
+    return RecId;
+}
+
+uint64 TStoreColumnar::AddRec(const TRecBuilder& Rec, const bool& TriggerEvents) {
+    // wait for background flusher when there is too much dirty data
+    TFlushScope FlushScope(GetBase()->GetFlusher(), true);
+    QmAssertR(Rec.GetStore()->GetStoreId() == GetStoreId(), "Record builder created for store " + Rec.GetStore()->GetStoreNm());
+    TWalScope WalScope(GetBase());
+    // append values to columns, rolling back all of them if any is missing
+    const int64 ValN = (int64)(NextRecId - FirstValRecId);
+    try {
+        for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+            TColumn& Column = ColumnV[ColumnN];
+            const int FieldId = Column.FieldId;
+            if (Rec.IsFieldNull(FieldId)) {
+                // builder already checked the field is nullable
+                Column.AddVal(true);
+            } else if (Rec.IsFieldSet(FieldId)) {
+                Column.AddVal(false);
+                SetRecVal(Column, ValN, Rec);
+            } else if (FieldId == Rec.GetInsertedAtFieldId()) {
+                // system field, always set to current time
+                Column.AddVal(false);
+                Column.SetVal<uint64>(ValN, TTm::GetCurUniMSecs());
+            } else if (!Column.DefaultVal.Empty()) {
+                Column.AddVal(false);
+                SetJsonVal(Column, ValN, Column.DefaultVal);
+            } else {
+                QmAssertR(Column.NullableP, "Record is missing field - expecting " +
+                    GetFieldNm(FieldId) + ", store " + GetStoreNm());
+                Column.AddVal(true);
+            }
+        }
+    } catch (const PExcept& Except) {
+        for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+            ColumnV[ColumnN].Trunc(ValN);
+        }
+        throw;
+    }
+    const uint64 RecId = NextRecId++;
+    DirtyBytes += GetRecLen();
+
+    // index new record
+    for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+        IndexVal(ColumnV[ColumnN], ValN, RecId, false);
+    }
+    // log the record, including the insert time set above
+    WalAddRec(WalScope, RecId, Rec);
+    // call add triggers, which also mark the store as modified
+    if (TriggerEvents) { OnAdd(RecId); } else { TouchStore(); }
+
+    // return record Id of the new record
+    return RecId;
+}
+
+void TStoreColumnar::UpdateRec(const uint64& RecId, const PJsonVal& RecVal) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    const int64 ValN = GetValN(RecId);
+    for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+        TColumn& Column = ColumnV[ColumnN];
+        const TStr& FieldNm = GetFieldNm(Column.FieldId);
+        if (!RecVal->IsObjKey(FieldNm)) { continue; }
+        PJsonVal FieldVal = RecVal->GetObjKey(FieldNm);
+        // update the value and the indexes pointing to it
+        IndexVal(Column, ValN, RecId, true);
+        if (FieldVal->IsNull()) {
+            QmAssertR(Column.NullableP, "Non-nullable field " + FieldNm + " set to null");
+            Column.SetNull(ValN, true);
+        } else {
+            SetJsonVal(Column, ValN, FieldVal);
+            if (Column.NullableP) { Column.SetNull(ValN, false); }
+        }
+        IndexVal(Column, ValN, RecId, false);
+        DirtyBytes += (uint64)Column.ValLen;
+    }
+    // log the update, changes done by triggers are logged on their own
+    WalUpdateRec(RecId, RecVal);
+    // call update triggers
+    OnUpdate(RecId);
+}
+
+void TStoreColumnar::GarbageCollect(const int& MxTimeMSecs) {
+    // if no window or no records, nothing to do here
+    if (WndDesc.WindowType == swtNone || Empty()) { return; }
+    // count records that fell out of the window
+    uint64 DelRecs = 0;
+    if (WndDesc.WindowType == swtTime) {
+        // scan the time column from the start until we hit the time window
+        const int TimeFieldId = GetFieldId(WndDesc.TimeFieldNm);
+        const uint64 CurMSecs = WndDesc.InsertP ? TTm::GetCurUniMSecs() :
+            GetFieldTmMSecs(GetLastRecId(), TimeFieldId);
+        const uint64 WindowStartMSecs = CurMSecs - WndDesc.WindowSize;
+        const TColumn& Column = ColumnV[TimeFieldId];
+        int64 ValN = GetValN(FirstRecId);
+        while (DelRecs < GetRecs() && Column.GetVal<uint64>(ValN) < WindowStartMSecs) {
+            DelRecs++; ValN++;
+        }
+    } else if (GetRecs() > WndDesc.WindowSize) {
+        DelRecs = GetRecs() - WndDesc.WindowSize;
+    }
+    if (DelRecs > 0) {
+        TEnv::Logger->OnStatusFmt("Garbage Collection in %s: purging %s records",
+            GetStoreNm().CStr(), TUInt64::GetStr(DelRecs).CStr());
+        DelFirstRecs(DelRecs, MxTimeMSecs);
+    }
+}
+
+void TStoreColumnar::DeleteAllRecs() {
+    // if no records, nothing to do here
+    if (Empty()) { return; }
+    TEnv::Logger->OnStatusFmt("Deleting all (%s) records in %s",
+        TUInt64::GetStr(GetRecs()).CStr(), GetStoreNm().CStr());
+    DelFirstRecs(GetRecs(), -1);
+}
+
+void TStoreColumnar::DeleteFirstRecs(const int& DelRecs) {
+    // if no records, nothing to do here
+    if (Empty() || DelRecs <= 0) { return; }
+    TEnv::Logger->OnStatusFmt("Deleting %d records in %s", DelRecs, GetStoreNm().CStr());
+    DelFirstRecs((uint64)DelRecs, -1);
+}
+
+void TStoreColumnar::DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs, const bool& AssertOK) {
+    // columns can only be shortened from the start, so we always check the sequence
+    QmAssertR((uint64)DelRecIdV.Len() <= GetRecs(), "TStoreColumnar::DeleteRecs: "
+        "incorrect record id sequence. The length is greater than the total number of records.");
+    for (int DelRecN = 0; DelRecN < DelRecIdV.Len(); DelRecN++) {
+        QmAssertR(DelRecIdV[DelRecN] == FirstRecId + DelRecN, "TStoreColumnar::DeleteRecs: "
+            "incorrect record id sequence. The sequence should start at the first store "
+            "records, should contain only record ids and should not contain gaps");
+    }
+    DelFirstRecs(DelRecIdV.Len(), MxTimeMSecs);
+}
+
+void TStoreColumnar::GetFieldFltV(const TUInt64IntKdV& RecIdFqV,
+        const int& FieldId, TFltV& FltV) const {
+
+    const TColumn& Column = ColumnV[FieldId];
+    QmAssertR(Column.FieldType != oftTm, "Field " + GetFieldNm(FieldId) + " is not numeric");
+    FltV.Gen(RecIdFqV.Len(), 0);
+    for (int RecN = 0; RecN < RecIdFqV.Len(); RecN++) {
+        const int64 ValN = GetValN(RecIdFqV[RecN].Key);
+        FltV.Add(Column.IsNull(ValN) ? 0.0 : Column.GetFlt(ValN));
+    }
+}
+
+void TStoreColumnar::FilterByFieldFlt(const int& FieldId, const double& MinVal,
+        const double& MaxVal, TUInt64IntKdV& RecIdFqV) const {
+
+    const TColumn& Column = ColumnV[FieldId];
+    QmAssertR(Column.FieldType != oftTm, "Field " + GetFieldNm(FieldId) + " is not numeric");
+    // compact passing records to the front of the vector
+    int NewRecs = 0;
+    for (int RecN = 0; RecN < RecIdFqV.Len(); RecN++) {
+        const int64 ValN = GetValN(RecIdFqV[RecN].Key);
+        if (Column.IsNull(ValN)) { continue; }
+        const double Val = Column.GetFlt(ValN);
+        if (MinVal <= Val && Val <= MaxVal) { RecIdFqV[NewRecs++] = RecIdFqV[RecN]; }
+    }
+    RecIdFqV.Trunc(NewRecs);
+}
+
+bool TStoreColumnar::IsFieldNull(const uint64& RecId, const int& FieldId) const {
+    return ColumnV[FieldId].IsNull(GetValN(RecId));
+}
+
+uchar TStoreColumnar::GetFieldByte(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<uchar>(RecId, FieldId, oftByte, "Byte");
+}
+
+int TStoreColumnar::GetFieldInt(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<int>(RecId, FieldId, oftInt, "Int");
+}
+
+int16 TStoreColumnar::GetFieldInt16(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<int16>(RecId, FieldId, oftInt16, "Int16");
+}
+
+int64 TStoreColumnar::GetFieldInt64(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<int64>(RecId, FieldId, oftInt64, "Int64");
+}
+
+uint TStoreColumnar::GetFieldUInt(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<uint>(RecId, FieldId, oftUInt, "UInt");
+}
+
+uint16 TStoreColumnar::GetFieldUInt16(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<uint16>(RecId, FieldId, oftUInt16, "UInt16");
+}
+
+uint64 TStoreColumnar::GetFieldUInt64(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<uint64>(RecId, FieldId, oftUInt64, "UInt64");
+}
+
+bool TStoreColumnar::GetFieldBool(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<uchar>(RecId, FieldId, oftBool, "Bool") != 0;
+}
+
+double TStoreColumnar::GetFieldFlt(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<double>(RecId, FieldId, oftFlt, "Flt");
+}
+
+float TStoreColumnar::GetFieldSFlt(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<float>(RecId, FieldId, oftSFlt, "SFlt");
+}
+
+void TStoreColumnar::GetFieldTm(const uint64& RecId, const int& FieldId, TTm& Tm) const {
+    Tm = TTm::GetTmFromMSecs(GetFieldTmMSecs(RecId, FieldId));
+}
+
+uint64 TStoreColumnar::GetFieldTmMSecs(const uint64& RecId, const int& FieldId) const {
+    return GetFieldVal<uint64>(RecId, FieldId, oftTm, "Tm");
+}
+
+void TStoreColumnar::SetFieldNull(const uint64& RecId, const int& FieldId) {
+    TFlushScope FlushScope(GetBase()->GetFlusher());
+    TColumn& Column = ColumnV[FieldId];
+    QmAssertR(Column.NullableP, "Non-nullable field " + GetFieldNm(FieldId) + " set to null");
+    const int64 ValN = GetValN(RecId);
+    IndexVal(Column, ValN, RecId, true);
+    Column.SetNull(ValN, true);
+    DirtyBytes += (uint64)Column.ValLen;
+    WalSetField(RecId, FieldId);
+}
+
+void TStoreColumnar::SetFieldByte(const uint64& RecId, const int& FieldId, const uchar& Byte) {
+    SetFieldVal(RecId, FieldId, oftByte, "Byte", Byte);
+}
+
+void TStoreColumnar::SetFieldInt(const uint64& RecId, const int& FieldId, const int& Int) {
+    SetFieldVal(RecId, FieldId, oftInt, "Int", Int);
+}
+
+void TStoreColumnar::SetFieldInt16(const uint64& RecId, const int& FieldId, const int16& Int16) {
+    SetFieldVal(RecId, FieldId, oftInt16, "Int16", Int16);
+}
+
+void TStoreColumnar::SetFieldInt64(const uint64& RecId, const int& FieldId, const int64& Int64) {
+    SetFieldVal(RecId, FieldId, oftInt64, "Int64", Int64);
+}
+
+void TStoreColumnar::SetFieldUInt(const uint64& RecId, const int& FieldId, const uint& UInt) {
+    SetFieldVal(RecId, FieldId, oftUInt, "UInt", UInt);
+}
+
+void TStoreColumnar::SetFieldUInt16(const uint64& RecId, const int& FieldId, const uint16& UInt16) {
+    SetFieldVal(RecId, FieldId, oftUInt16, "UInt16", UInt16);
+}
+
+void TStoreColumnar::SetFieldUInt64(const uint64& RecId, const int& FieldId, const uint64& UInt64) {
+    SetFieldVal(RecId, FieldId, oftUInt64, "UInt64", UInt64);
+}
+
+void TStoreColumnar::SetFieldBool(const uint64& RecId, const int& FieldId, const bool& Bool) {
+    SetFieldVal(RecId, FieldId, oftBool, "Bool", (uchar)(Bool ? 1 : 0));
+}
+
+void TStoreColumnar::SetFieldFlt(const uint64& RecId, const int& FieldId, const double& Flt) {
+    SetFieldVal(RecId, FieldId, oftFlt, "Flt", Flt);
+}
+
+void TStoreColumnar::SetFieldSFlt(const uint64& RecId, const int& FieldId, const float& SFlt) {
+    SetFieldVal(RecId, FieldId, oftSFlt, "SFlt", SFlt);
+}
+
+void TStoreColumnar::SetFieldTm(const uint64& RecId, const int& FieldId, const TTm& Tm) {
+    SetFieldTmMSecs(RecId, FieldId, TTm::GetMSecsFromTm(Tm));
+}
+
+void TStoreColumnar::SetFieldTmMSecs(const uint64& RecId, const int& FieldId, const uint64& TmMSecs) {
+    SetFieldVal(RecId, FieldId, oftTm, "Tm", TmMSecs);
+}
+
+PJsonVal TStoreColumnar::GetStoreJson(const TWPt<TBase>& Base) const {
+    PJsonVal Result = TStore::GetStoreJson(Base);
+    if (WndDesc.WindowType != TStoreWndType::swtNone) {
+        PJsonVal WindowJson = TJsonVal::NewObj();
+        WindowJson->AddToObj("type", WndDesc.WindowType == TStoreWndType::swtLength ? "length" : "time");
+        WindowJson->AddToObj("size", (int) WndDesc.WindowSize);
+        if (WndDesc.WindowType == TStoreWndType::swtTime) {
+            WindowJson->AddToObj("timeField", WndDesc.TimeFieldNm);
+        }
+        Result->AddToObj("window", WindowJson);
+    }
+    return Result;
+}
+
+PJsonVal TStoreColumnar::GetStats() {
+    PJsonVal Res = TJsonVal::NewObj();
+    Res->AddToObj("name", GetStoreNm());
+    Res->AddToObj("records", (double)GetRecs());
+    PJsonVal ColumnsVal = TJsonVal::NewObj();
+    uint64 MemUsed = 0;
+    for (int ColumnN = 0; ColumnN < ColumnV.Len(); ColumnN++) {
+        const TColumn& Column = ColumnV[ColumnN];
+        ColumnsVal->AddToObj(GetFieldNm(Column.FieldId), (double)Column.GetMemUsed());
+        MemUsed += Column.GetMemUsed();
+    }
+    Res->AddToObj("columns", ColumnsVal);
+    Res->AddToObj("memory", (double)MemUsed);
+    return Res;
+}
+
 ///////////////////////////////
 /// Create new stores in an existing base from a schema definition
 TVec<TWPt<TStore> > CreateStoresFromSchema(const TWPt<TBase>& Base, const PJsonVal& SchemaVal,
     const uint64& DefStoreCacheSize, const TStrUInt64H& StoreNmCacheSizeH, bool UsePaged) {
 
+    // new stores and their log entry are not split by a checkpoint
+    TFlushScope FlushScope(Base->GetFlusher());
     // parse and validate the schema
     InfoLog("Parsing schema");
     TStoreSchemaV SchemaV; TStoreSchema::ParseSchema(Base, SchemaVal, SchemaV);
@@ -5652,6 +7902,9 @@ TVec<TWPt<TStore> > CreateStoresFromSchema(const TWPt<TBase>& Base, const PJsonV
         if (UsePaged && StoreSchema.StoreType == "paged") {
             Store = new TStorePbBlob(Base, StoreId, StoreNm,
                 StoreSchema, Base->GetFPath() + StoreNm, StoreCacheSize, StoreSchema.BlockSizeMem);
+        } else if (StoreSchema.StoreType == "columnar") {
+            Store = new TStoreColumnar(Base, StoreId, StoreNm,
+                StoreSchema, Base->GetFPath() + StoreNm);
         } else {
             Store = new TStoreImpl(Base, StoreId, StoreNm,
                 StoreSchema, Base->GetFPath() + StoreNm, StoreCacheSize,
@@ -5719,6 +7972,15 @@ TVec<TWPt<TStore> > CreateStoresFromSchema(const TWPt<TBase>& Base, const PJsonV
         }
     }
 
+    // stores created after the last checkpoint are recreated when replaying the log
+    TWalScope WalScope(Base);
+    if (WalScope.IsLog()) {
+        PJsonVal Val = TJsonVal::NewObj("schema", SchemaVal);
+        Val->AddToObj("cacheSize", DefStoreCacheSize);
+        Val->AddToObj("paged", UsePaged);
+        WalScope.Log(wotAddStores, TUInt::Mx, Val);
+    }
+
     // done
     return NewStoreV;
 }
@@ -5742,12 +8004,76 @@ TWPt<TBase> NewBase(const TStr& FPath, const PJsonVal& SchemaVal, const uint64&
 }
 
 
+///////////////////////////////
+/// Apply write-ahead log entries to a base restored from the last checkpoint
+void ReplayWal(const TWPt<TBase>& Base) {
+    TWPt<TWal> Wal = Base->GetWal();
+    const uint64 CheckpointLsn = Wal->GetCheckpointLsn();
+    InfoLog("Replaying " + TUInt64::GetStr(Wal->GetLsn() - CheckpointLsn) + " write-ahead log entries");
+    Wal->SetReplay(true);
+    TFIn WalFIn(Wal->GetFNm());
+    uint64 Lsn = 0; TWalEntry Entry;
+    QmAssertR(TWal::LoadHeader(WalFIn, Lsn), "Invalid write-ahead log header in " + Wal->GetFNm());
+    while (TWal::LoadEntry(WalFIn, Lsn, Entry)) {
+        Lsn = Entry.Lsn;
+        // entries before the checkpoint are already applied, when log truncation was interrupted
+        if (Lsn <= CheckpointLsn) { continue; }
+        try {
+            PJsonVal Val = TJsonVal::GetValFromStr(Entry.ValStr);
+            if (Entry.OpType == wotAddStores) {
+                CreateStoresFromSchema(Base, Val->GetObjKey("schema"),
+                    (uint64)Val->GetObjNum("cacheSize"), TStrUInt64H(), Val->GetObjBool("paged"));
+                continue;
+            }
+            QmAssertR(Entry.StoreId < TEnv::GetMxStores() && Base->IsStoreId(Entry.StoreId),
+                "Unknown store ID " + TUInt::GetStr(Entry.StoreId));
+            TWPt<TStore> Store = Base->GetStoreByStoreId(Entry.StoreId);
+            if (Entry.OpType == wotAddRec) {
+                Store->AddRec(Val, false);
+            } else if (Entry.OpType == wotUpdateRec) {
+                Store->UpdateRec((uint64)Val->GetObjNum("$id"), Val->GetObjKey("rec"));
+            } else if (Entry.OpType == wotDelRecs) {
+                PJsonVal IdsVal = Val->GetObjKey("ids");
+                TUInt64V DelRecIdV(IdsVal->GetArrVals(), 0);
+                for (int IdN = 0; IdN < IdsVal->GetArrVals(); IdN++) {
+                    DelRecIdV.Add((uint64)IdsVal->GetArrVal(IdN)->GetNum());
+                }
+                Store->DeleteRecs(DelRecIdV, -1, false);
+            } else if (Entry.OpType == wotDelAllRecs) {
+                Store->DeleteAllRecs();
+            } else if (Entry.OpType == wotDropSegments) {
+                TStoreImpl* StoreImpl = dynamic_cast<TStoreImpl*>(Store());
+                QmAssertR(StoreImpl != NULL, "Time segments not supported by store " + Store->GetStoreNm());
+                StoreImpl->DropSegments((uint64)Val->GetObjNum("before"));
+            } else if (Entry.OpType == wotAddJoin) {
+                Store->AddJoin(Val->GetObjInt("join"), (uint64)Val->GetObjNum("$id"),
+                    (uint64)Val->GetObjNum("join$id"), Val->GetObjInt("fq"));
+            } else if (Entry.OpType == wotDelJoin) {
+                Store->DelJoin(Val->GetObjInt("join"), (uint64)Val->GetObjNum("$id"),
+                    (uint64)Val->GetObjNum("join$id"), Val->GetObjInt("fq"));
+            } else {
+                throw TQmExcept::New("Unknown write-ahead log operation " + TInt::GetStr((int)Entry.OpType));
+            }
+        } catch (const PExcept& Except) {
+            // only successful operations are logged, so base does not match the log anymore
+            throw TQmExcept::New("Error replaying write-ahead log entry " +
+                TUInt64::GetStr(Entry.Lsn) + ": " + Except->GetMsgStr());
+        }
+    }
+    Wal->SetReplay(false);
+}
+
 ///////////////////////////////
 /// Load base created from a schema definition
 TWPt<TBase> LoadBase(const TStr& FPath, const TFAccess& FAccess, const uint64& IndexCacheSize,
     const uint64& DefStoreCacheSize,
     const TStrUInt64H& StoreNmCacheSizeH, const TStrUInt64H& IndexTypeCacheSizeH,
-    const bool& InitP, const int& SplitLen) {
+    const bool& InitP, const int& SplitLen, const bool& WalP) {
+
+    // write-ahead log is only needed when base can change
+    const bool UseWalP = WalP && (FAccess == faUpdate);
+    // restore base from the last checkpoint when it was not closed cleanly
+    const bool ReplayP = UseWalP && TWal::Recover(FPath);
 
     InfoLog("Loading base created from schema definition");
     TWPt<TBase> Base = TBase::Load(FPath, FAccess, IndexCacheSize, IndexTypeCacheSizeH, SplitLen);
@@ -5768,12 +8094,19 @@ TWPt<TBase> LoadBase(const TStr& FPath, const TFAccess& FAccess, const uint64& I
         PStore Store;
         if (StoreType == "TStorePbBlob") {
             Store = new TStorePbBlob(Base, FPath + StoreNm, FAccess, StoreCacheSize);
+        } else if (StoreType == "TStoreColumnar") {
+            Store = new TStoreColumnar(Base, FPath + StoreNm);
         } else {
             Store = new TStoreImpl(Base, FPath + StoreNm, StoreCacheSize);
         }
         Base->AddStore(Store);
     }
     InfoLog("Stores loaded");
+    // open write-ahead log and bring base up to date with it
+    if (UseWalP) {
+        Base->SetWal(TWal::New(FPath));
+        if (ReplayP) { ReplayWal(Base); }
+    }
     // finish base initialization if so required (default is true)
     if (InitP) { Base->Init(); }
     // done
@@ -5789,16 +8122,7 @@ void SaveBase(const TWPt<TBase>& Base) {
         // Saving list of stores so we know what to load next time
         // Stores are saved automatically in destructor
         InfoLog("Saving list of stores ... ");
-        PJsonVal StoresVal = TJsonVal::NewArr();
-        for (int StoreN = 0; StoreN < Base->GetStores(); StoreN++) {
-            PStore Store = Base->GetStoreByStoreN(StoreN);
-            PJsonVal StoreVal = TJsonVal::NewObj();
-            StoreVal->AddToObj("name", Store->GetStoreNm());
-            StoreVal->AddToObj("type", Store->GetStoreType());
-            StoresVal->AddToArr(StoreVal);
-        }
-        PJsonVal RootVal = TJsonVal::NewObj("stores", StoresVal);
-        RootVal->SaveStr().SaveTxt(Base->GetFPath() + "StoreList.json");
+        Base->SaveStoreList();
     }
 }
 
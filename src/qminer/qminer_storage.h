@@ -114,6 +114,32 @@ public:
     TJoinDescEx() : JoinType(osjtUndef), FieldStoreLoc(slMemory){}
 };
 
+///////////////////////////////
+/// Hot window description.
+/// Tiered stores keep only the newest records of in-memory fields in memory,
+/// either given number of records or records within given time span. Older
+/// blocks are demoted to blob storage and loaded back when read.
+class THotWndDesc {
+public:
+    /// Number of newest records kept in memory (0 when window is defined by time)
+    TUInt64 Recs;
+    /// Time span of records kept in memory in milliseconds (0 when defined by records)
+    TUInt64 Duration;
+    /// Name of the field with record time, for windows defined by time
+    TStr TimeFieldNm;
+
+public:
+    THotWndDesc() { }
+
+    /// Is storage split into hot and cold part
+    bool IsTiered() const { return Recs > 0 || Duration > 0; }
+    /// Is window defined by time
+    bool IsTime() const { return Duration > 0; }
+
+    void Save(TSOut& SOut) const;
+    void Load(TSIn& SIn);
+};
+
 ///////////////////////////////
 /// Store schema definition.
 /// Contains parsed version of store definition, which can be used to
@@ -142,6 +168,8 @@ public:
     TBool HasStoreIdP;
     /// Window settings
     TStoreWndDesc WndDesc;
+    /// Part of in-memory storage kept in memory
+    THotWndDesc HotWndDesc;
     /// Field descriptions
     THash<TStr, TFieldDesc> FieldH;
     /// Extended field descriptions
@@ -152,6 +180,8 @@ public:
     TVec<TJoinDescEx> JoinDescExV;
     /// Size of blocks for memory storage
     TInt BlockSizeMem;
+    /// Compress blocks of memory and cache storage before saving them to disk
+    TBool BlockCompressP;
     /// What is the default storage location for fields and field-joins
     TStoreLoc DefaultFieldStoreLoc;
 private:
@@ -204,7 +234,9 @@ private:
     /// If BlobkSize is 100 and 150 records have been deleted,
     /// this value would be 100.
     TUInt64 FirstValOffsetMem;
-    /// Storage vector
+    /// Storage vector. Reads load blocks which are not in memory yet, so values and
+    /// dirty flags change also in const methods. Concurrent readers do such reads only
+    /// under the store cache lock of the base.
     mutable TVec<TMem, int64> ValV;
     /// Blob-pointers - locations where TMem objects are stored inside Blob storage
     TVec<TBlobPt, int64> BlobPtV;
@@ -214,16 +246,36 @@ private:
     PBlobBs BlobStorage;
     /// How many records are packed together into block;
     TInt BlockSize;
+    /// Size of new and dirty records, not yet saved to blob storage
+    TUInt64 DirtyBytes;
+    /// Compress blocks before saving them to blob storage
+    TBool CompressP;
+    /// Size of serialized blocks saved since opened
+    TUInt64 RawBlockBytes;
+    /// Size of blocks written to blob storage since opened, after compression
+    TUInt64 StoredBlockBytes;
+    /// First value of the oldest block kept in memory, older blocks are demoted
+    TUInt64 HotValId;
+    /// Demoted blocks loaded back by reads, given by their first value. Changed by
+    /// const reads, under the store cache lock when the base is concurrent.
+    mutable TUInt64V ColdBlockV;
+    /// Number of blocks demoted since opened
+    TUInt64 DemotedBlocks;
+    /// Number of demoted blocks loaded back since opened
+    mutable TUInt64 ColdLoads;
 
     /// Utility method for loading specific record
     inline void LoadRec(int64 RecN) const;
+    /// Save block if dirty and drop its values from memory, returns false
+    /// when the block was not in memory
+    bool DemoteBlock(const int64& BlockN);
 
     /// Utility method for storing specific record
     int SaveRec(int RecN);
 
 public:
     TInMemStorage(const TStr& _FNm, const PBlobBs& _BlobStorage,
-        const int& _BlockSize = 1000);
+        const int& _BlockSize = 1000, const bool& _CompressP = false);
     TInMemStorage(const TStr& _FNm, const PBlobBs& _BlobStorage,
         const TFAccess& _FAccess, const bool& LazyP = false);
     ~TInMemStorage();
@@ -234,6 +286,9 @@ public:
 
     bool IsValId(const uint64& ValId) const;
     void GetVal(const uint64& ValId, TMem& Val) const;
+    /// Get reference to stored value without copying it. Valid until the storage
+    /// is next modified.
+    const TMem& GetValRef(const uint64& ValId) const;
     uint64 AddVal(const TMem& Val);
     void SetVal(const uint64& ValId, const TMem& Val);
     void DelVals(int Vals);
@@ -243,9 +298,33 @@ public:
     uint64 GetLastValId() const;
 
     int PartialFlush(int WndInMsec = 500);
+    /// Save all dirty records and the block index, keeping records in memory
+    void Flush();
+    /// Size of records changed since they were last saved
+    uint64 GetDirtyBytes() const { return DirtyBytes; }
     void LoadAll();
+    /// Load blocks starting with the one holding ValId, older blocks stay demoted
+    void LoadFrom(const uint64& ValId);
+
+    /// Save and drop from memory all blocks which end before ValId,
+    /// returns number of demoted blocks
+    int Demote(const uint64& ValId);
+    /// Is value in a block which is kept in memory
+    bool IsHot(const uint64& ValId) const { return ValId >= HotValId; }
+    /// First value of the oldest block kept in memory
+    uint64 GetHotValId() const { return HotValId; }
+    /// Number of blocks demoted since opened
+    uint64 GetDemotedBlocks() const { return DemotedBlocks; }
+    /// Number of demoted blocks loaded back since opened
+    uint64 GetColdLoads() const { return ColdLoads; }
 
     TBlobBsStats GetBlobBsStats() { return BlobStorage->GetStats(); }
+    /// Are blocks compressed before saved to blob storage
+    bool IsCompressed() const { return CompressP; }
+    /// Size of serialized blocks saved since opened
+    uint64 GetRawBlockBytes() const { return RawBlockBytes; }
+    /// Size of blocks written to blob storage since opened, after compression
+    uint64 GetStoredBlockBytes() const { return StoredBlockBytes; }
 
 #ifdef XTEST
 private:
@@ -254,6 +333,138 @@ private:
 #endif
 };
 
+///////////////////////////////
+/// Record buffer cache.
+/// Keeps serializations of recently read records, so reading several fields of
+/// the same record copies it out of storage only once. Cache is direct-mapped on
+/// record ID, which keeps lookups cheap and memory bounded by the number of slots.
+class TRecMemCache {
+private:
+    /// ID of the record held in each slot (TUInt64::Mx when empty)
+    TUInt64V RecIdV;
+    /// Serialization of the record held in each slot
+    TVec<TMem> RecMemV;
+    /// Number of reads served from the cache
+    TUInt64 Hits;
+    /// Number of reads which had to go to storage
+    TUInt64 Misses;
+
+    /// Slot for a given record
+    int GetSlotN(const uint64& RecId) const { return (int)(RecId % (uint64)RecIdV.Len()); }
+
+public:
+    TRecMemCache(const int& Slots);
+
+    /// Get cached serialization of the record, NULL when not in the cache
+    const TMem* Get(const uint64& RecId);
+    /// Get slot for serialization of the record, evicting its previous content
+    TMem& Add(const uint64& RecId);
+    /// Forget the record, must be called when record changes
+    void Del(const uint64& RecId);
+    /// Forget all records
+    void Clr();
+
+    /// Number of reads served from the cache
+    uint64 GetHits() const { return Hits; }
+    /// Number of reads which had to go to storage
+    uint64 GetMisses() const { return Misses; }
+};
+
+///////////////////////////////
+/// Primary key index.
+/// Open-addressing hash map from primary field value to record ID. Slots are kept
+/// in one flat vector and collisions are resolved with linear probing, so most
+/// lookups touch a single cache line. Integer, float and time keys are stored inline
+/// in the slot. String keys are appended to a byte pool together with their hash,
+/// and the slot keeps the pool offset next to a few bits of the hash, which skips
+/// most string comparisons. Slots and pool are saved as contiguous blocks.
+class TPrimaryIndex {
+private:
+    /// Record ID marking an empty slot
+    static const uint64 EmptyRecId;
+    /// Number of slots allocated for the first key
+    static const int64 MnSlots;
+    /// Bits of the string hash kept in the slot next to the pool offset
+    static const int HashTagBits;
+
+    /// Are keys strings
+    TBool StrP;
+    /// Slots, each taking two values: key (or pool offset and hash tag) and record ID
+    TVec<TUInt64, int64> SlotV;
+    /// Number of keys in the index
+    TInt64 Keys;
+    /// String keys, each stored as [hash][length][characters]
+    TVec<char, int64> PoolV;
+    /// Bytes in the pool taken by deleted string keys
+    TInt64 PoolGarbage;
+
+    /// Mix bits of the key, so similar keys spread over the slots
+    static uint64 GetHash(uint64 Key);
+    /// Hash of a string key
+    static uint GetStrHash(const char* Bf, const int& BfL);
+
+    int64 GetSlots() const { return SlotV.Len() / 2; }
+    bool IsSlotEmpty(const int64& SlotN) const { return SlotV[2*SlotN + 1] == EmptyRecId; }
+    /// Slot where probing for the key in the given slot starts
+    int64 GetHomeSlotN(const int64& SlotN) const;
+    /// Hash stored with the string key at the given pool offset
+    uint GetPoolHash(const int64& Offset) const;
+    /// Find slot with the numeric key, -1 when not found
+    int64 FindSlotN(const uint64& Key) const;
+    /// Find slot with the string key, -1 when not found
+    int64 FindStrSlotN(const TStr& Str) const;
+    /// Put key into the first free slot starting from its home slot
+    void PutSlot(const uint64& Key, const uint64& RecId, const uint64& Hash);
+    /// Remove key from the slot and shift back the keys probed over it
+    void DelSlot(int64 SlotN);
+    /// Make room for another key
+    void Reserve();
+    /// Rebuild slots with a given size, dropping records before MnRecId.
+    /// Also removes deleted string keys from the pool.
+    void Rebuild(const int64& Slots, const uint64& MnRecId);
+
+public:
+    TPrimaryIndex(const bool& _StrP = false): StrP(_StrP), Keys(0), PoolGarbage(0) { }
+
+    void Load(TSIn& SIn);
+    void Save(TSOut& SOut) const;
+
+    /// Are keys strings
+    bool IsStr() const { return StrP; }
+    /// Key for an integer value
+    static uint64 GetIntKey(const int& Int) { return (uint64)(int64)Int; }
+    /// Key for a float value
+    static uint64 GetFltKey(const double& Flt);
+
+    /// Check if numeric key is in the index
+    bool IsKey(const uint64& Key) const { return FindSlotN(Key) != -1; }
+    /// Get record with numeric key, TUInt64::Mx when not found
+    uint64 GetRecId(const uint64& Key) const;
+    /// Set record for numeric key
+    void AddKey(const uint64& Key, const uint64& RecId);
+    /// Remove numeric key if present
+    void DelKey(const uint64& Key);
+
+    /// Check if string key is in the index
+    bool IsStrKey(const TStr& Str) const { return FindStrSlotN(Str) != -1; }
+    /// Get record with string key, TUInt64::Mx when not found
+    uint64 GetStrRecId(const TStr& Str) const;
+    /// Set record for string key
+    void AddStrKey(const TStr& Str, const uint64& RecId);
+    /// Remove string key if present
+    void DelStrKey(const TStr& Str);
+
+    /// Remove all keys pointing to records before RecId
+    void DelRecIdsBefore(const uint64& RecId);
+    /// Remove all keys
+    void Clr();
+
+    /// Number of keys
+    int64 Len() const { return Keys; }
+    /// Memory used by slots and string pool
+    uint64 GetMemUsed() const;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 /// API for storing large fields.
 class TToaster {
@@ -298,7 +509,7 @@ private:
         TBool FixedPartP;
         /// Offset in fixed or variable-index part
         TInt Offset;
-        /// Is this field actually a string that is encoded using codebook
+        /// Is this field a string or a string vector that is encoded using codebook
         TBool CodebookP;
         /// Is this field a short string?
         TBool SmallStringP;
@@ -330,6 +541,9 @@ private:
     static const char ToastNo;
     /// Flag if field is TOAST-ed
     static const char ToastYes;
+    /// Marks string vector stored as codebook ids. Never a valid start
+    /// of serialized TStrV, which starts with non-negative capacity.
+    static const int CodebookStrVMarker;
 private:
     /// Only store fields with this storage flag
     TStoreLoc TargetStorage;
@@ -482,6 +696,12 @@ private:
     /// parse variable-length field JSon value and serialize it accordingly to it's type
     void SetVarJsonVal(TMem& RecMem, TMOut& SOut, const TFieldSerialDesc& FieldSerialDesc,
         const TFieldDesc& FieldDesc, const PJsonVal& JsonVal);
+    /// Serialize fixed-length field value from record builder
+    void SetFixedRecVal(TMemBase& RecMem, const TFieldSerialDesc& FieldSerialDesc,
+        const TFieldDesc& FieldDesc, const TRecBuilder& Rec);
+    /// Serialize variable-length field value from record builder
+    void SetVarRecVal(TMem& RecMem, TMOut& SOut, const TFieldSerialDesc& FieldSerialDesc,
+        const TFieldDesc& FieldDesc, const TRecBuilder& Rec);
     /// copy variable-length field from InRecMem to FixedMem and SOut
     void CopyFieldVar(const TMemBase& InRecMem, TMem& FixedMem, TMOut& VarSOut, const TFieldSerialDesc& FieldSerialDesc);
 
@@ -504,9 +724,17 @@ public:
     void Load(TSIn& SIn);
     /// Save to output stream
     void Save(TSOut& SOut);
+    /// Save record layout without codebook, used to check compatibility of binary dumps
+    void SaveLayout(TSOut& SOut) const;
+    /// Save codebook to binary dump
+    void SaveCodebook(TSOut& SOut) const { CodebookH.Save(SOut); }
+    /// Load codebook from binary dump, current codebook must be its prefix
+    void LoadCodebook(TSIn& SIn);
 
     /// Serialize JSon object
     void Serialize(const PJsonVal& RecVal, TMem& RecMem, const TWPt<TStore>& Store);
+    /// Serialize record builder, without going through JSon
+    void Serialize(const TRecBuilder& Rec, TMem& RecMem, const TWPt<TStore>& Store);
     /// Update existing serialization with updated fields from JSon object
     void SerializeUpdate(const PJsonVal& RecVal, const TMemBase& InRecMem, TMem& OutRecMem,
         const TWPt<TStore>& Store, TIntSet& ChangedFieldIdSet);
@@ -545,6 +773,8 @@ public:
     TStr GetFieldStr(TThinMIn& min, const int& FieldId) const;
     /// Field getter
     void GetFieldStrV(TThinMIn& min, const int& FieldId, TStrV& StrV) const;
+    /// Load string vector, decoding codebook ids when needed
+    void LoadStrV(TThinMIn& min, const TFieldSerialDesc& FieldSerialDesc, TStrV& StrV) const;
     /// Field getter
     bool GetFieldBool(TThinMIn& min, const int& FieldId) const;
     /// Field getter
@@ -735,6 +965,8 @@ private:
         bool IsLocation() const { return (KeyType & oiktLocation) > 0; }
         /// Checks key type is on linearly  ordered value using b-tree
         bool IsLinear() const { return (KeyType & oiktLinear) > 0; }
+        /// Is indexed using inverted index
+        bool IsGix() const { return IsValue() || IsText() || IsTextPos(); }
         /// Get index type as string (value, text, location, linear)
         TStr GetKeyType() const;
     };
@@ -749,8 +981,9 @@ private:
     // map from field id to key position in FieldIndexKeyV
     TIntH FieldIdToKeyN;
 
-    /// Index a record using the given key
-    void IndexKey(const TFieldIndexKey& Key, const TMemBase& RecMem,
+    /// Index a record using the given key, either directly in TIndex or in TIndexBatch
+    template <class TTarget>
+    void IndexKey(TTarget& Target, const TFieldIndexKey& Key, const TMemBase& RecMem,
         const uint64& RecId, TRecSerializator& Serializator);
     /// Delete existing index of a record based on a given key
     void DeindexKey(const TFieldIndexKey& Key, const TMemBase& RecMem,
@@ -772,6 +1005,13 @@ public:
     void IndexRec(const TMemBase& RecMem, const uint64& RecId, TRecSerializator& Serializator);
     /// Deindex existing record
     void DeindexRec(const TMemBase& RecMem, const uint64& RecId, TRecSerializator& Serializator);
+    /// Index a batch of new records, one key at a time for all the records
+    void IndexRecV(const TVec<TMem>& RecMemV, const TUInt64V& RecIdV, TRecSerializator& Serializator);
+    /// Collect index additions for a batch of new records in IndexBatch, without touching the index
+    void IndexRecV(const TVec<TMem>& RecMemV, const TUInt64V& RecIdV,
+        TRecSerializator& Serializator, TIndexBatch& IndexBatch);
+    /// Deindex a batch of existing records, one key at a time for all the records
+    void DeindexRecV(const TVec<TMem>& RecMemV, const TUInt64V& RecIdV, TRecSerializator& Serializator);
     /// Update index for existing record
     void UpdateRec(const TMemBase& OldRecMem, const TMemBase& NewRecMem,
         const uint64& RecId, const int& ChangedFieldId, TRecSerializator& Serializator);
@@ -785,6 +1025,8 @@ public:
     void IndexRecField(const TMemBase& RecMem, const uint64& RecId, const int& FieldId, TRecSerializator& Serializator);
 
     bool HasIndexKey(const int& FieldId) { return FieldIdToKeyN.IsKey(FieldId); }
+    /// Check if any key does not use inverted index (e.g. linear or location keys)
+    bool HasNonGixKey() const;
 };
 
 ///////////////////////////////
@@ -891,16 +1133,8 @@ private:
     TInt PrimaryFieldId;
     /// Type of primary field
     TFieldType PrimaryFieldType;
-    /// Hash map from TStr primary field to record ID
-    THash<TStr, TUInt64> PrimaryStrIdH;
-    /// Hash map from TInt primary field to record ID
-    THash<TInt, TUInt64> PrimaryIntIdH;
-    /// Hash map from TUInt64 primary field to record ID
-    THash<TUInt64, TUInt64> PrimaryUInt64IdH;
-    /// Hash map from TFlt primary field to record ID
-    THash<TFlt, TUInt64> PrimaryFltIdH;
-    /// Hash map from TTm primary field to record ID
-    THash<TUInt64, TUInt64> PrimaryTmMSecsIdH;
+    /// Map from primary field value to record ID
+    TPrimaryIndex PrimaryIndex;
 
     /// Flag if we are using cache store
     TBool DataCacheP;
@@ -916,16 +1150,76 @@ private:
     TRecSerializator *SerializatorMem;
     /// Map from fields to storage location
     TVec<TStoreLoc> FieldLocV;
+    /// Number of records kept in the record buffer cache
+    static const int RecMemCacheSlots;
+    /// Recently read records from disk storage. In-memory records are read in place.
+    mutable TRecMemCache RecMemCache;
+    /// Number of records deleted from indexes in one batch
+    static const int DelBatchLen;
+    /// Number of records in the first batch of deletes with a time limit, before
+    /// the deletion rate is known
+    static const int DelTimedBatchLen;
+    /// Marks store parameter files with a format header, files written
+    /// before the header was introduced have no version
+    static const int GenericStoreMagic;
+    /// Version of store parameter file format
+    static const int GenericStoreVersion;
 
     // record indexer
     TRecIndexer RecIndexer;
 
+    /// Time segments, when time window is split into segments. Each segment is given by
+    /// its start time in milliseconds and the ID of its first record.
+    TVec<TUInt64Pr> SegmentV;
+    /// Inverted index keys touched by records of each time segment, parallel to SegmentV.
+    /// Dropping segments visits only these posting lists.
+    TVec<THashSet<TKeyWord> > SegmentKeySetV;
+
+    /// Part of in-memory storage kept in memory
+    THotWndDesc HotWndDesc;
+    /// Time field of the hot window (-1 when window is defined by records)
+    TInt HotTimeFieldId;
+    /// First record of the hot window, moves forward as records age
+    TUInt64 HotRecId;
+
     /// initialize field storage location map
     void InitFieldLocV();
+    /// Move start of the hot window forward and demote older in-memory blocks
+    void DemoteColdBlocks();
+    /// Assign newly added record to a time segment
+    void AddRecToSegment(const uint64& RecId);
+    /// Id of existing record referred to by id or primary field, TUInt64::Mx when there is none
+    uint64 GetExistingRecId(const PJsonVal& RecVal) const;
+    /// Index new records stored by AddRecs and clear the given vectors
+    void IndexNewRecs(TVec<TMem>& CacheRecMemV, TVec<TMem>& MemRecMemV, TUInt64V& RecIdV);
+    /// Remember inverted index keys touched by records from MnRecId to MxRecId in
+    /// all time segments holding these records
+    void AddSegmentKeys(const uint64& MnRecId, const uint64& MxRecId, const THashSet<TKeyWord>& KeySet);
+    /// Update index for changed field of a record, keeping track of its segment keys
+    void UpdateRecIndex(const TMemBase& OldRecMem, const TMemBase& NewRecMem,
+        const uint64& RecId, const int& ChangedFieldId, TRecSerializator& Serializator);
+    /// Update index for changed fields of a record, keeping track of its segment keys
+    void UpdateRecIndex(const TMemBase& OldRecMem, const TMemBase& NewRecMem,
+        const uint64& RecId, TIntSet& ChangedFieldIdSet, TRecSerializator& Serializator);
+    /// Remove time segments which have no more records
+    void DelEmptySegments();
+    /// Remove a batch of records about to be deleted from triggers, primary field map,
+    /// indexes and joins. Records stay in the storage.
+    void DeindexRecBatch(const TUInt64V& RecIdV);
+    /// Save fields and record layouts, which must match for binary dump to be restored
+    void SaveBinDumpSchema(TSOut& SOut) const;
     /// Get TMem serialization of record from specified storage
     void GetRecMem(const TStoreLoc& RecLoc, const uint64& RecId, TMem& Rec) const;
     /// Get TMem serialization of record from specified where field is stored
     void GetRecMem(const uint64& RecId, const int& FieldId, TMem& Rec) const;
+    /// Get TMem serialization of record from specified storage without copying it.
+    /// Valid until the store is modified or the next record is read. In concurrent
+    /// mode disk records are copied into RecMemBf, which must outlive the reference.
+    /// Caller must hold a flush scope for as long as it uses the reference, otherwise
+    /// background flusher can demote the block holding the record.
+    const TMem& GetRecMemRef(const TStoreLoc& RecLoc, const uint64& RecId, TMem& RecMemBf) const;
+    /// Get TMem serialization of record from storage where field is stored without copying it
+    const TMem& GetRecMemRef(const uint64& RecId, const int& FieldId, TMem& RecMemBf) const;
     /// Set TMem serialization of record to a specified storage
     void PutRecMem(const TStoreLoc& RecLoc, const uint64& RecId, const TMem& Rec);
     /// Set TMem serialization of record to storage where field is stored
@@ -970,6 +1264,10 @@ private:
     void DelPrimaryFieldFlt(const uint64& RecId, const double& Flt);
     /// Delete primary field map for a given TTm value
     void DelPrimaryFieldMSecs(const uint64& RecId, const uint64& MSecs);
+    /// Load primary field map saved by older versions as a hash table
+    void LoadPrimaryFieldH(TSIn& SIn);
+    /// Save store state which is kept in memory (parameters, primary field, segments)
+    void SaveStoreState() const;
     /// Transform Join name to it's corresponding field name
     TStr GetJoinFieldNm(const TStr& JoinNm) const { return JoinNm + "Id"; }
 
@@ -1018,6 +1316,12 @@ public:
 
     /// Add new record
     uint64 AddRec(const PJsonVal& RecVal, const bool& TriggerEvents = true);
+    /// Add new record from record builder, serialized directly without JSon
+    uint64 AddRec(const TRecBuilder& Rec, const bool& TriggerEvents = true);
+    /// Add new records, storing them one by one and indexing them together. Stores with
+    /// joins fall back to TStore::AddRecs, which adds records one at a time through AddRec,
+    /// since nested join records can refer back to records which are not indexed yet.
+    void AddRecs(const TVec<PJsonVal>& RecValV, TUInt64V& RecIdV, const bool& TriggerEvents = true);
     /// Update existing record
     void UpdateRec(const uint64& RecId, const PJsonVal& RecVal);
 
@@ -1027,8 +1331,19 @@ public:
     void DeleteAllRecs();
     /// Delete the first DelRecs records (the records that were inserted first)
     void DeleteFirstRecs(const int& Recs);
-    /// Delete specific record.
+    /// Delete specific records. Records are removed from indexes in batches. With a time
+    /// limit, each batch is sized by the time left and the deletion rate so far, so the
+    /// limit can be overrun by about the time needed to delete one record.
     void DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs = -1, const bool& AssertOK = true);
+    /// Delete all records before the given one, dropping whole time segments. Storage
+    /// blocks and inverted index posting lists are removed without reading the records,
+    /// unless the store has triggers. Linear and location keys would need the record
+    /// values, so time segments are supported only for stores without such keys.
+    void DropSegments(const uint64& FirstKeptRecId);
+    /// Number of time segments (0 when time window is not split into segments)
+    int GetSegments() const { return SegmentV.Len(); }
+    /// First record kept in memory by the hot window of a tiered store
+    uint64 GetHotRecId() const { return HotRecId; }
 
     /// Check if the value of given field for a given record is NULL
     bool IsFieldNull(const uint64& RecId, const int& FieldId) const;
@@ -1135,8 +1450,23 @@ public:
     /// Get codebook mappings for given string field
     int GetCodebookId(const int& FieldId, const TStr& Str) const;
 
+    /// Load all in-memory blocks, so readers do not modify the storage
+    void EnableConcurrency();
+
+    /// Binary dumps are supported
+    bool IsBinDump() const { return true; }
+    /// Save all records to binary dump
+    void SaveBinDump(TSOut& SOut) const;
+    /// Restore records from binary dump into empty store
+    void RestoreBinDump(TSIn& SIn, TCriticalSection& SharedSection,
+        uint64& DumpFirstRecId, uint64& FirstRecId);
+
     /// Save part of the data, given time-window
     int PartialFlush(int WndInMsec = 500);
+    /// Save all data and store state
+    void Flush();
+    /// Size of data changed since it was last saved
+    uint64 GetDirtyBytes();
     /// Retrieve performance statistics for this store
     PJsonVal GetStats();
     /// Run verification for whole store
@@ -1233,6 +1563,8 @@ private:
     void InitFromSchema(const TStoreSchema& StoreSchema);
     /// Initialize field location flags
     void InitDataFlags();
+    /// Save store state which is kept in memory (parameters, primary field, record locations)
+    void SaveStoreState() const;
 
     /// Do we have a primary field
     bool IsPrimaryField() const { return PrimaryFieldId != -1; }
@@ -1310,6 +1642,8 @@ public:
 
     /// Add new record
     uint64 AddRec(const PJsonVal& RecVal, const bool& TriggerEvents=true);
+    /// Add new record from record builder, serialized directly without JSon
+    uint64 AddRec(const TRecBuilder& Rec, const bool& TriggerEvents = true);
     /// Update existing record
     void UpdateRec(const uint64& RecId, const PJsonVal& RecVal);
 
@@ -1420,6 +1754,14 @@ public:
 
     /// Save part of the data, given time-window
     int PartialFlush(int WndInMsec = 500);
+    /// Save all data and store state
+    void Flush();
+    /// Keep paged files saved by the last Flush unchanged until the next checkpoint
+    void EnableCheckpoints(const uint64& CheckpointLsn);
+    /// Release pages kept for the previous checkpoint
+    void EndCheckpoint(const uint64& CheckpointLsn);
+    /// Size of data changed since it was last saved
+    uint64 GetDirtyBytes();
     /// Retrieve performance statistics for this store
     PJsonVal GetStats();
     /// Run verification for whole store
@@ -1547,6 +1889,250 @@ public:
     void RunVerificationForRecord(const uint64& RecId);
 };
 
+///////////////////////////////
+/// Columnar in-memory store.
+/// Each field is kept in its own contiguous array of fixed-width values,
+/// with a separate NULL bitmap for nullable fields. Reading one field of
+/// a record touches only that field's array and requires no decoding, so
+/// scans over a single field (filters, aggregates, feature extraction)
+/// run over contiguous memory. Supports only fixed-width numeric, boolean
+/// and datetime fields, and only linear index keys.
+class TStoreColumnar : public TStoreNotImpl {
+private:
+    ///////////////////////////////
+    /// Values of one field for all records in the store
+    class TColumn {
+    public:
+        /// Id of the field stored in this column
+        TInt FieldId;
+        /// Type of the field
+        TInt FieldType;
+        /// Width of one value in bytes
+        TInt ValLen;
+        /// True when the field can be NULL and we keep NULL bitmap
+        TBool NullableP;
+        /// Default value used when field is missing from the record JSon
+        PJsonVal DefaultVal;
+        /// Values packed one after another
+        TVec<char, int64> ValV;
+        /// NULL bitmap with one bit per value (empty for non-nullable fields)
+        TVec<TUInt64, int64> NullV;
+        /// Linear index keys defined over this field
+        TIntV KeyIdV;
+
+    public:
+        TColumn(): FieldType(oftUndef), ValLen(0) { }
+        TColumn(const int& _FieldId, const TFieldType& _FieldType,
+            const bool& _NullableP, const PJsonVal& _DefaultVal);
+        TColumn(TSIn& SIn);
+        void Save(TSOut& SOut) const;
+
+        /// Width in bytes of values of given field type (-1 when not fixed-width)
+        static int GetValLen(const TFieldType& FieldType);
+
+        /// Number of values in the column
+        int64 Len() const { return ValV.Len() / ValLen; }
+        /// Pointer to the value at given position
+        const char* GetValPt(const int64& ValN) const { return ValV.BegI() + ValN * ValLen; }
+        /// Pointer to the value at given position
+        char* GetValPt(const int64& ValN) { return ValV.BegI() + ValN * ValLen; }
+        /// Read value at given position
+        template <class TVal> TVal GetVal(const int64& ValN) const {
+            TVal Val; memcpy(&Val, GetValPt(ValN), sizeof(TVal)); return Val; }
+        /// Write value at given position
+        template <class TVal> void SetVal(const int64& ValN, const TVal& Val) {
+            memcpy(GetValPt(ValN), &Val, sizeof(TVal)); }
+
+        /// Read value at given position converted to double
+        double GetFlt(const int64& ValN) const;
+
+        /// Is value at given position NULL
+        bool IsNull(const int64& ValN) const {
+            return NullableP && ((NullV[ValN / 64].Val >> (ValN % 64)) & 1) != 0; }
+        /// Set or clear NULL flag for value at given position
+        void SetNull(const int64& ValN, const bool& NullP);
+
+        /// Append new zero value, marked as NULL when requested
+        void AddVal(const bool& NullP);
+        /// Remove first given number of values
+        void DelVals(const int64& Vals);
+        /// Keep only first given number of values
+        void Trunc(const int64& Vals);
+        /// Remove all values
+        void Clr() { ValV.Clr(); NullV.Clr(); }
+        /// Memory footprint of the values and the NULL bitmap
+        uint64 GetMemUsed() const { return (uint64)ValV.Len() + (uint64)NullV.Len() * sizeof(uint64); }
+    };
+
+private:
+    /// Store filename
+    TStr StoreFNm;
+    /// Open mode
+    TFAccess FAccess;
+    /// Columns, one for each field, indexed by field id
+    TVec<TColumn> ColumnV;
+    /// Record id of the value at position 0 in the columns
+    TUInt64 FirstValRecId;
+    /// Id of the first record in the store
+    TUInt64 FirstRecId;
+    /// Id to be assigned to the next added record
+    TUInt64 NextRecId;
+    /// Size of values changed since columns were last saved
+    TUInt64 DirtyBytes;
+
+    /// Get position of the record in the columns
+    int64 GetValN(const uint64& RecId) const;
+    /// Get column and assert its type matches the requested one
+    const TColumn& GetColumn(const int& FieldId, const TFieldType& FieldType, const TStr& TypeStr) const;
+    /// Get column and assert its type matches the requested one
+    TColumn& GetColumn(const int& FieldId, const TFieldType& FieldType, const TStr& TypeStr);
+    /// Parse value from JSon and write it to the column
+    void SetJsonVal(TColumn& Column, const int64& ValN, const PJsonVal& JsonVal);
+    /// Write value from record builder to the column
+    void SetRecVal(TColumn& Column, const int64& ValN, const TRecBuilder& Rec);
+    /// Add or remove value from a linear index key
+    template <class TVal> void IndexLinear(const int& KeyId, const TVal& Val,
+        const uint64& RecId, const bool& DeleteP);
+    /// Add or remove value from the linear index keys of the column
+    void IndexVal(const TColumn& Column, const int64& ValN, const uint64& RecId, const bool& DeleteP);
+    /// Read value from the column, NULL values are read as zero
+    template <class TVal> TVal GetFieldVal(const uint64& RecId, const int& FieldId,
+        const TFieldType& FieldType, const TStr& TypeStr) const;
+    /// Write value to the column and keep the indexes up to date
+    template <class TVal> void SetFieldVal(const uint64& RecId, const int& FieldId,
+        const TFieldType& FieldType, const TStr& TypeStr, const TVal& Val);
+    /// Remember linear index keys of each field
+    void InitKeys();
+    /// Size of values of one record in all columns
+    uint64 GetRecLen() const;
+    /// Remove given number of records from the start of the store
+    void DelFirstRecs(const uint64& DelRecs, const int& MxTimeMSecs);
+
+public:
+    TStoreColumnar(const TWPt<TBase>& _Base, const uint& StoreId,
+        const TStr& StoreName, const TStoreSchema& StoreSchema, const TStr& _StoreFNm);
+    TStoreColumnar(const TWPt<TBase>& _Base, const TStr& _StoreFNm);
+    // need to override destructor, to save the columns
+    ~TStoreColumnar();
+
+    bool IsRecId(const uint64& RecId) const { return FirstRecId <= RecId && RecId < NextRecId; }
+    bool IsRecNm(const TStr& RecNm) const { return false; }
+    TStr GetRecNm(const uint64& RecId) const { return TStr(); }
+    uint64 GetRecId(const TStr& RecNm) const { return TUInt64::Mx; }
+    uint64 GetRecs() const { return NextRecId - FirstRecId; }
+
+    PStoreIter GetIter() const;
+
+    /// Gets the first record in the store
+    uint64 GetFirstRecId() const { return Empty() ? TUInt64::Mx : FirstRecId.Val; }
+    /// Gets the last record in the store
+    uint64 GetLastRecId() const { return Empty() ? TUInt64::Mx : NextRecId - 1; }
+    /// Gets forward moving iterator
+    PStoreIter ForwardIter() const { return GetIter(); }
+    /// Gets backward moving iterator
+    PStoreIter BackwardIter() const;
+
+    /// Does the store implement GetAllRecs?
+    bool HasGetAllRecs() const { return true; }
+    /// Is the forward iterator implemented?
+    bool HasForwardIter() const { return true; }
+    /// Is the backward iterator implemented?
+    bool HasBackwardIter() const { return true; }
+    /// Is the first record  id getter implemented?
+    bool HasFirstRecId() const { return true; }
+    /// Is the last record id getter implemented?
+    bool HasLastRecId() const { return true; }
+    /// Fields are kept in columns
+    bool HasColumnScan() const { return true; }
+
+    /// Read numeric field values of given records directly from the field column
+    void GetFieldFltV(const TUInt64IntKdV& RecIdFqV, const int& FieldId, TFltV& FltV) const;
+    /// Keep only records with numeric field value within [MinVal, MaxVal]
+    void FilterByFieldFlt(const int& FieldId, const double& MinVal, const double& MaxVal,
+        TUInt64IntKdV& RecIdFqV) const;
+
+    /// Add new record
+    uint64 AddRec(const PJsonVal& RecVal, const bool& TriggerEvents = true);
+    /// Add new record from record builder, values are written to the columns directly
+    uint64 AddRec(const TRecBuilder& Rec, const bool& TriggerEvents = true);
+    /// Update existing record
+    void UpdateRec(const uint64& RecId, const PJsonVal& RecVal);
+
+    /// Purge records that fall out of store window (when it has one)
+    void GarbageCollect(const int& MxTimeMSecs = -1);
+    /// Deletes all records
+    void DeleteAllRecs();
+    /// Delete the first DelRecs records (the records that were inserted first)
+    void DeleteFirstRecs(const int& DelRecs);
+    /// Delete records; only a prefix of the store (first records) can be deleted
+    void DeleteRecs(const TUInt64V& DelRecIdV, const int& MxTimeMSecs = -1, const bool& AssertOK = true);
+
+    /// Check if the value of given field for a given record is NULL
+    bool IsFieldNull(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    uchar GetFieldByte(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    int GetFieldInt(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    int16 GetFieldInt16(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    int64 GetFieldInt64(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    uint GetFieldUInt(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    uint16 GetFieldUInt16(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    uint64 GetFieldUInt64(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    bool GetFieldBool(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    double GetFieldFlt(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    float GetFieldSFlt(const uint64& RecId, const int& FieldId) const;
+    /// Get field value using field id
+    void GetFieldTm(const uint64& RecId, const int& FieldId, TTm& Tm) const;
+    /// Get field value using field id
+    uint64 GetFieldTmMSecs(const uint64& RecId, const int& FieldId) const;
+
+    /// Set the value of given field to NULL
+    void SetFieldNull(const uint64& RecId, const int& FieldId);
+    /// Set field value using field id
+    void SetFieldByte(const uint64& RecId, const int& FieldId, const uchar& Byte);
+    /// Set field value using field id
+    void SetFieldInt(const uint64& RecId, const int& FieldId, const int& Int);
+    /// Set field value using field id
+    void SetFieldInt16(const uint64& RecId, const int& FieldId, const int16& Int16);
+    /// Set field value using field id
+    void SetFieldInt64(const uint64& RecId, const int& FieldId, const int64& Int64);
+    /// Set field value using field id
+    void SetFieldUInt(const uint64& RecId, const int& FieldId, const uint& UInt);
+    /// Set field value using field id
+    void SetFieldUInt16(const uint64& RecId, const int& FieldId, const uint16& UInt16);
+    /// Set field value using field id
+    void SetFieldUInt64(const uint64& RecId, const int& FieldId, const uint64& UInt64);
+    /// Set field value using field id
+    void SetFieldBool(const uint64& RecId, const int& FieldId, const bool& Bool);
+    /// Set field value using field id
+    void SetFieldFlt(const uint64& RecId, const int& FieldId, const double& Flt);
+    /// Set field value using field id
+    void SetFieldSFlt(const uint64& RecId, const int& FieldId, const float& SFlt);
+    /// Set field value using field id
+    void SetFieldTm(const uint64& RecId, const int& FieldId, const TTm& Tm);
+    /// Set field value using field id
+    void SetFieldTmMSecs(const uint64& RecId, const int& FieldId, const uint64& TmMSecs);
+
+    /// Helper function for returning JSon definition of store
+    PJsonVal GetStoreJson(const TWPt<TBase>& Base) const;
+    /// Columns are saved as a whole, so this saves them all when any value changed
+    int PartialFlush(int WndInMsec = 500);
+    /// Save columns
+    void Flush();
+    /// Size of values changed since columns were last saved
+    uint64 GetDirtyBytes() { return DirtyBytes; }
+    /// Retrieve memory statistics for this store
+    PJsonVal GetStats();
+};
+
 ///////////////////////////////
 /// Create new stores from a schema and add them to an existing base
 TVec<TWPt<TStore> > CreateStoresFromSchema(const TWPt<TBase>& Base, const PJsonVal& SchemaVal,
@@ -1561,11 +2147,18 @@ TWPt<TBase> NewBase(const TStr& FPath, const PJsonVal& SchemaVal, const uint64&
     const bool& InitP = true, const int& SplitLen = 1024, bool UsePaged = true);
 
 ///////////////////////////////
-/// Load base created from a schema definition
+/// Apply write-ahead log entries to a base restored from the last checkpoint.
+/// Throws exception when an entry can not be applied, base should not be used then.
+void ReplayWal(const TWPt<TBase>& Base);
+
+///////////////////////////////
+/// Load base created from a schema definition. When WalP is set and base is opened
+/// for update, changes are written to a write-ahead log (see TWal) and base is recovered
+/// from the last checkpoint and the log when it was not closed cleanly.
 TWPt<TBase> LoadBase(const TStr& FPath, const TFAccess& FAccess, const uint64& IndexCacheSize,
     const uint64& StoreCacheSize,
     const TStrUInt64H& StoreNmCacheSizeH = TStrUInt64H(), const TStrUInt64H& IndexTypeCacheSizeH = TStrUInt64H(),
-    const bool& InitP = true, const int& SplitLen = 1024);
+    const bool& InitP = true, const int& SplitLen = 1024, const bool& WalP = false);
 
 ///////////////////////////////
 /// Save base created from a schema definition
@@ -8,6 +8,7 @@
 
 #include <base.h>
 #include <qminer.h>
+#include <thread>
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -59,3 +60,849 @@ TEST(TMath, FloorLog2_uint64) {
     EXPECT_EQ(TMath::FloorLog2((uint64)TMath::Pow2<uint64>(63)), 63);
     EXPECT_EQ(TMath::FloorLog2((uint64)TMath::Pow2<uint64>(64) - 1), 63);
 }
+
+TEST(TLz, EmptyBlock) {
+    TMem Mem, Enc, Dec;
+    TLz::Compress(Mem, Enc);
+    TLz::Decompress(Enc, Dec);
+    EXPECT_EQ(Dec.Len(), 0);
+}
+
+TEST(TLz, RepetitiveBlock) {
+    TMOut MOut;
+    for (int ValN = 0; ValN < 1000; ValN++) {
+        MOut.Save((uint64)1451606400000 + ValN * 1000);
+        TStr("INFO GET /index.html 200").Save(MOut);
+    }
+    TMem Mem(MOut.GetBfAddr(), MOut.Len()), Enc, Dec;
+    TLz::Compress(Mem, Enc);
+    EXPECT_LT(Enc.Len() * 3, Mem.Len());
+    TLz::Decompress(Enc, Dec);
+    ASSERT_EQ(Dec.Len(), Mem.Len());
+    EXPECT_EQ(memcmp(Dec(), Mem(), Mem.Len()), 0);
+}
+
+TEST(TLz, RandomBlock) {
+    TRnd Rnd(1);
+    for (int TestN = 0; TestN < 100; TestN++) {
+        TMem Mem; Mem.Gen(Rnd.GetUniDevInt(10000));
+        // random bytes, with some copied from just before to get short matches
+        for (int ChN = 0; ChN < Mem.Len(); ChN++) {
+            Mem[ChN] = (ChN > 10 && Rnd.GetUniDevInt(3) == 0) ?
+                Mem[ChN - 1 - Rnd.GetUniDevInt(10)] : (char)Rnd.GetUniDevInt(256);
+        }
+        TMem Enc, Dec;
+        TLz::Compress(Mem, Enc);
+        // incompressible blocks are stored with a short header
+        EXPECT_LE(Enc.Len(), Mem.Len() + 6);
+        TLz::Decompress(Enc, Dec);
+        ASSERT_EQ(Dec.Len(), Mem.Len());
+        EXPECT_EQ(memcmp(Dec(), Mem(), Mem.Len()), 0);
+    }
+}
+
+TEST(TLz, TruncatedBlock) {
+    TMem Mem("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbbbbbbbbb"), Enc, Dec;
+    TLz::Compress(Mem, Enc);
+    Enc.Trunc(Enc.Len() - 2);
+    EXPECT_ANY_THROW(TLz::Decompress(Enc, Dec));
+}
+
+TEST(TPgBlob, ReadOnlyMMap) {
+    const TStr FPath = "./pgblob_mmap/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    const double Flt = 65.43; const int Int = 89;
+    TPgBlobPt FltPt, IntPt;
+    {
+        PPgBlob PgBlob = TPgBlob::Create(FPath + "blob");
+        FltPt = PgBlob->Put((const char*)&Flt, sizeof(double));
+        IntPt = PgBlob->Put((const char*)&Int, sizeof(int));
+    }
+    {
+        PPgBlob PgBlob = TPgBlob::OpenRdOnly(FPath + "blob");
+#ifdef GLib_UNIX
+        EXPECT_TRUE(PgBlob->IsMMap());
+#endif
+        TThinMIn FltMIn = PgBlob->Get(FltPt);
+        EXPECT_EQ(TFlt(FltMIn).Val, Flt);
+        TThinMIn IntMIn = PgBlob->Get(IntPt);
+        EXPECT_EQ(TInt(IntMIn).Val, Int);
+        // mapped pages are served in place, without copying
+        if (PgBlob->IsMMap()) {
+            EXPECT_EQ(PgBlob->GetMemBase(FltPt).GetBf(), PgBlob->Get(FltPt).GetBfAddrChar());
+        }
+    }
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TGix, AddItemV) {
+    const TStr FPath = "./gix_add_item_v/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    TGixDefItemHandler<TIntUInt64Pr, TUInt64> ItemHandler;
+    TPt<TGix<TIntUInt64Pr, TUInt64> > Gix = TGix<TIntUInt64Pr, TUInt64>::New(
+        "Test", FPath, faCreate, &ItemHandler, 10000000, 100);
+    const TIntUInt64Pr Key(122, 122);
+    // new key
+    TUInt64V ItemV;
+    for (int ItemN = 0; ItemN < 120; ItemN++) { ItemV.Add(ItemN); }
+    Gix->AddItemV(Key, ItemV);
+    EXPECT_EQ(Gix->GetKeys(), 1);
+    // existing key, items after the last one
+    ItemV.Clr();
+    for (int ItemN = 120; ItemN < 220; ItemN++) { ItemV.Add(ItemN); }
+    Gix->AddItemV(Key, ItemV);
+    // empty vector does nothing
+    Gix->AddItemV(TIntUInt64Pr(1, 1), TUInt64V());
+    EXPECT_EQ(Gix->GetKeys(), 1);
+    EXPECT_FALSE(Gix->IsKey(TIntUInt64Pr(1, 1)));
+    EXPECT_TRUE(Gix->GetItemSet(Key)->IsMerged());
+    Gix->GetItemV(Key, ItemV);
+    ASSERT_EQ(ItemV.Len(), 220);
+    for (int ItemN = 0; ItemN < 220; ItemN++) { EXPECT_EQ(ItemV[ItemN].Val, (uint64)ItemN); }
+    Gix.Clr();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TGix, DelItemsBefore) {
+    const TStr FPath = "./gix_del_items_before/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    TGixDefItemHandler<TIntUInt64Pr, TUInt64> ItemHandler;
+    TPt<TGix<TIntUInt64Pr, TUInt64> > Gix = TGix<TIntUInt64Pr, TUInt64>::New(
+        "Test", FPath, faCreate, &ItemHandler, 10000000, 100);
+    const TIntUInt64Pr Key(122, 122);
+    for (int ItemN = 0; ItemN < 22000; ItemN++) { Gix->AddItem(Key, ItemN); }
+    // drop the prefix in one call
+    Gix->DelItemsBefore(Key, 5050);
+    ASSERT_TRUE(Gix->IsKey(Key));
+    TUInt64V ItemV; Gix->GetItemV(Key, ItemV);
+    ASSERT_EQ(ItemV.Len(), 22000 - 5050);
+    for (int ItemN = 0; ItemN < ItemV.Len(); ItemN++) { EXPECT_EQ(ItemV[ItemN].Val, (uint64)(ItemN + 5050)); }
+    // dropping everything removes the key
+    Gix->DelItemsBefore(Key, 22000);
+    EXPECT_FALSE(Gix->IsKey(Key));
+    Gix.Clr();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TRWLock, Reentrant) {
+    TRWLock Lock;
+    EXPECT_FALSE(Lock.IsHeld());
+    Lock.EnterRead(); Lock.EnterRead();
+    EXPECT_TRUE(Lock.IsHeld());
+    EXPECT_FALSE(Lock.IsWriteHeld());
+    // cannot upgrade to write while reading
+    EXPECT_ANY_THROW(Lock.EnterWrite());
+    Lock.LeaveRead(); Lock.LeaveRead();
+    EXPECT_FALSE(Lock.IsHeld());
+    // writer can nest writes and reads
+    Lock.EnterWrite(); Lock.EnterRead(); Lock.EnterWrite();
+    EXPECT_TRUE(Lock.IsWriteHeld());
+    Lock.LeaveWrite(); Lock.LeaveRead();
+    EXPECT_TRUE(Lock.IsWriteHeld());
+    Lock.LeaveWrite();
+    EXPECT_FALSE(Lock.IsHeld());
+}
+
+TEST(TRWLock, ReadersAndWriter) {
+    TRWLock Lock;
+    // writer keeps both values equal, readers must never see them differ
+    volatile int Val1 = 0, Val2 = 0;
+    std::atomic<bool> DoneP(false);
+    std::atomic<int> Mismatches(0);
+    std::thread Writer([&]() {
+        for (int ValN = 0; ValN < 10000; ValN++) {
+            TWriteLock WriteLock(Lock);
+            Val1 = ValN; Val2 = ValN;
+        }
+        DoneP = true;
+    });
+    TVec<std::thread*> ReaderV;
+    for (int ReaderN = 0; ReaderN < 4; ReaderN++) {
+        ReaderV.Add(new std::thread([&]() {
+            while (!DoneP) {
+                TReadLock ReadLock(Lock);
+                if (Val1 != Val2) { Mismatches++; }
+            }
+        }));
+    }
+    Writer.join();
+    for (std::thread* Reader : ReaderV) { Reader->join(); delete Reader; }
+    EXPECT_EQ(Mismatches.load(), 0);
+    EXPECT_EQ(Val1, 9999);
+}
+
+TEST(TBase, ConcurrentReadersAndWriter) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_concurrent/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"tag\",\"type\":\"string\"},{\"name\":\"num\",\"type\":\"int\"}],"
+        "\"keys\":[{\"field\":\"tag\",\"type\":\"value\"},{\"field\":\"num\",\"type\":\"linear\"}]}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    Base->EnableConcurrency();
+    TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+    PJsonVal Tag0Val = TJsonVal::GetValFromStr("{\"$from\":\"Docs\",\"tag\":\"t0\"}");
+    PJsonVal Tag1Val = TJsonVal::GetValFromStr("{\"$from\":\"Docs\",\"tag\":\"t1\"}");
+    PJsonVal RangeVal = TJsonVal::GetValFromStr("{\"$from\":\"Docs\",\"num\":{\"$gt\":-1}}");
+    // each record is added to the store and both indexes under one write lock, so
+    // readers must always see the indexes agree with the store
+    std::atomic<bool> DoneP(false);
+    std::atomic<int> Reads(0), Mismatches(0);
+    std::thread Writer([&]() {
+        for (int RecN = 0; RecN < 2000; RecN++) {
+            PJsonVal RecVal = TJsonVal::NewObj();
+            RecVal->AddToObj("tag", "t" + TInt::GetStr(RecN % 2));
+            RecVal->AddToObj("num", RecN);
+            Store->AddRec(RecVal);
+        }
+        DoneP = true;
+    });
+    TVec<std::thread*> ReaderV;
+    for (int ReaderN = 0; ReaderN < 4; ReaderN++) {
+        ReaderV.Add(new std::thread([&]() {
+            while (!DoneP) {
+                TQm::TReadScope ReadScope(Base);
+                const int Recs = (int)Store->GetRecs();
+                const int TagRecs = Base->Search(Tag0Val)->GetRecs() + Base->Search(Tag1Val)->GetRecs();
+                const int RangeRecs = Base->Search(RangeVal)->GetRecs();
+                if (TagRecs != Recs || RangeRecs != Recs) { Mismatches++; }
+                Reads++;
+            }
+        }));
+    }
+    Writer.join();
+    for (std::thread* Reader : ReaderV) { Reader->join(); delete Reader; }
+    EXPECT_EQ(Mismatches.load(), 0);
+    EXPECT_GT(Reads.load(), 0);
+    EXPECT_EQ(Store->GetRecs(), 2000);
+    EXPECT_EQ(Base->Search(RangeVal)->GetRecs(), 2000);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TStore, AddRecs) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_add_recs/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"tag\",\"type\":\"string\"},{\"name\":\"kind\",\"type\":\"string\"},{\"name\":\"num\",\"type\":\"int\"}],"
+        "\"keys\":[{\"field\":\"tag\",\"type\":\"value\"},{\"field\":\"kind\",\"type\":\"value\",\"storage\":\"small\"},"
+        "{\"field\":\"num\",\"type\":\"linear\"}]}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+    auto Count = [&](const TStr& QueryStr) { return Base->Search(TJsonVal::GetValFromStr(QueryStr))->GetRecs(); };
+    TVec<PJsonVal> RecValV;
+    for (int RecN = 0; RecN < 3000; RecN++) {
+        PJsonVal RecVal = TJsonVal::NewObj();
+        RecVal->AddToObj("tag", "t" + TInt::GetStr(RecN % 3));
+        RecVal->AddToObj("kind", "k" + TInt::GetStr(RecN % 5));
+        RecVal->AddToObj("num", RecN);
+        RecValV.Add(RecVal);
+    }
+    TUInt64V RecIdV; Store->AddRecs(RecValV, RecIdV);
+    EXPECT_EQ(RecIdV.Len(), 3000);
+    EXPECT_EQ(RecIdV.Last().Val, 2999);
+    EXPECT_EQ(Store->GetRecs(), 3000);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"tag\":\"t1\"}"), 1000);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"kind\":\"k2\"}"), 600);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"tag\":\"t1\",\"kind\":\"k2\"}"), 200);
+    // searches during a batch read posting lists as they were before it
+    Base->GetIndex()->StartBatch();
+    Store->AddRec(TJsonVal::GetValFromStr("{\"tag\":\"t1\",\"kind\":\"k9\",\"num\":3000}"));
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"tag\":\"t1\"}"), 1000);
+    Store->AddRec(TJsonVal::GetValFromStr("{\"tag\":\"t1\",\"kind\":\"k9\",\"num\":3001}"));
+    Base->GetIndex()->EndBatch();
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"tag\":\"t1\"}"), 1002);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"kind\":\"k9\"}"), 2);
+    EXPECT_EQ(Base->SearchCount(TJsonVal::GetValFromStr("{\"$from\":\"Docs\",\"tag\":\"t1\",\"kind\":\"k9\"}")), 2);
+    // updates in a batch see the records added before them
+    RecValV.Clr();
+    RecValV.Add(TJsonVal::GetValFromStr("{\"tag\":\"t2\",\"kind\":\"k8\",\"num\":4000}"));
+    RecValV.Add(TJsonVal::GetValFromStr("{\"$id\":3002,\"kind\":\"k7\"}"));
+    Store->AddRecs(RecValV, RecIdV);
+    EXPECT_EQ(RecIdV[0].Val, 3002);
+    EXPECT_EQ(RecIdV[1].Val, 3002);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"kind\":\"k8\"}"), 0);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"kind\":\"k7\"}"), 1);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"num\":{\"$gt\":3500}}"), 1);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TStore, AddRecFromBuilder) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_rec_builder/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    // same fields in a store of each type
+    const TStr StoreSchemaStr = "\"fields\":[{\"name\":\"val\",\"type\":\"int\"},"
+        "{\"name\":\"flt\",\"type\":\"float\",\"null\":true},{\"name\":\"flag\",\"type\":\"bool\",\"default\":false},"
+        "{\"name\":\"time\",\"type\":\"datetime\"}],\"keys\":[{\"field\":\"val\",\"type\":\"linear\"}]";
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\"," + StoreSchemaStr + "},"
+        "{\"name\":\"Pages\"," + StoreSchemaStr + ",\"options\":{\"type\":\"paged\"}},"
+        "{\"name\":\"Points\"," + StoreSchemaStr + ",\"options\":{\"type\":\"columnar\"}}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    for (const TStr& StoreNm : TStrV::GetV("Docs", "Pages", "Points")) {
+        TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm(StoreNm);
+        const int ValFieldId = Store->GetFieldId("val"), FltFieldId = Store->GetFieldId("flt");
+        const int FlagFieldId = Store->GetFieldId("flag"), TimeFieldId = Store->GetFieldId("time");
+        // records from builder must match the ones added as JSon
+        TQm::TRecBuilder Rec(Store);
+        for (int RecN = 0; RecN < 10; RecN++) {
+            Rec.Clr();
+            Rec.SetFieldInt(ValFieldId, RecN);
+            if (RecN % 2 == 0) { Rec.SetFieldFlt(FltFieldId, RecN / 2.0); }
+            Rec.SetFieldTmMSecs(TimeFieldId, TTm::GetWinMSecsFromUnixMSecs(1000 * RecN));
+            EXPECT_EQ(Store->AddRec(Rec), (uint64)RecN);
+        }
+        for (int RecN = 0; RecN < 10; RecN++) {
+            PJsonVal RecVal = TJsonVal::NewObj();
+            RecVal->AddToObj("val", RecN);
+            if (RecN % 2 == 0) { RecVal->AddToObj("flt", RecN / 2.0); }
+            RecVal->AddToObj("time", 1000 * RecN);
+            Store->AddRec(RecVal);
+        }
+        for (int RecN = 0; RecN < 10; RecN++) {
+            const uint64 RecId = RecN, JsonRecId = RecN + 10;
+            EXPECT_EQ(Store->GetFieldInt(RecId, ValFieldId), Store->GetFieldInt(JsonRecId, ValFieldId));
+            EXPECT_EQ(Store->IsFieldNull(RecId, FltFieldId), Store->IsFieldNull(JsonRecId, FltFieldId));
+            EXPECT_EQ(Store->GetFieldFlt(RecId, FltFieldId), Store->GetFieldFlt(JsonRecId, FltFieldId));
+            EXPECT_EQ(Store->GetFieldBool(RecId, FlagFieldId), Store->GetFieldBool(JsonRecId, FlagFieldId));
+            EXPECT_EQ(Store->GetFieldTmMSecs(RecId, TimeFieldId), Store->GetFieldTmMSecs(JsonRecId, TimeFieldId));
+        }
+        // range bounds are inclusive
+        EXPECT_EQ(Base->Search(TJsonVal::GetValFromStr("{\"$from\":\"" + StoreNm +
+            "\",\"val\":{\"$gt\":7}}"))->GetRecs(), 6);
+        // record with missing value is not added
+        Rec.Clr();
+        Rec.SetFieldInt(ValFieldId, 1);
+        EXPECT_THROW(Store->AddRec(Rec), PExcept);
+        EXPECT_EQ(Store->GetRecs(), (uint64)20);
+    }
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TStore, DropSegmentsAfterDeleteAll) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_drop_segments/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Events\","
+        "\"fields\":[{\"name\":\"tag\",\"type\":\"string\"},{\"name\":\"time\",\"type\":\"datetime\"}],"
+        "\"keys\":[{\"field\":\"tag\",\"type\":\"value\"}],"
+        "\"timeWindow\":{\"duration\":2,\"unit\":\"day\",\"field\":\"time\","
+        "\"segment\":{\"duration\":1,\"unit\":\"day\"}}}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Events");
+    TQm::TStorage::TStoreImpl* StoreImpl = dynamic_cast<TQm::TStorage::TStoreImpl*>(Store());
+    ASSERT_TRUE(StoreImpl != NULL);
+    auto AddDays = [&](const TStr& EvenTag, const TStr& OddTag) {
+        for (int HourN = 0; HourN < 5 * 24; HourN++) {
+            PJsonVal RecVal = TJsonVal::NewObj();
+            RecVal->AddToObj("tag", (HourN % 2 == 0) ? EvenTag : OddTag);
+            RecVal->AddToObj("time", TStr::Fmt("2016-01-%02dT%02d:00:00", 1 + HourN / 24, HourN % 24));
+            Store->AddRec(RecVal);
+        }
+    };
+    auto Count = [&](const TStr& TagStr) {
+        return Base->Search(TJsonVal::GetValFromStr("{\"$from\":\"Events\",\"tag\":\"" + TagStr + "\"}"))->GetRecs();
+    };
+    AddDays("a", "b");
+    EXPECT_EQ(StoreImpl->GetSegments(), 5);
+    Store->DeleteAllRecs();
+    EXPECT_EQ(StoreImpl->GetSegments(), 0);
+    // segments of new records keep their own inverted index keys
+    AddDays("even", "odd");
+    EXPECT_EQ(StoreImpl->GetSegments(), 5);
+    Base->GarbageCollect();
+    EXPECT_EQ(StoreImpl->GetSegments(), 3);
+    EXPECT_EQ(Store->GetRecs(), 72);
+    EXPECT_EQ(Count("even"), 36);
+    EXPECT_EQ(Count("odd"), 36);
+    EXPECT_EQ(Count("a"), 0);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TStore, SegmentsWithLinearKey) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_segments_linear/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    // dropping segments does not read records, which linear keys would need
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Events\","
+        "\"fields\":[{\"name\":\"val\",\"type\":\"int\"},{\"name\":\"time\",\"type\":\"datetime\"}],"
+        "\"keys\":[{\"field\":\"val\",\"type\":\"linear\"}],"
+        "\"timeWindow\":{\"duration\":2,\"unit\":\"day\",\"field\":\"time\","
+        "\"segment\":{\"duration\":1,\"unit\":\"day\"}}}]");
+    EXPECT_THROW(TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true), PExcept);
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TBase, BinDump) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_bin_dump/", DumpPath = "./base_bin_dump_files/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    if (TDir::Exists(DumpPath)) { TDir::DelNonEmptyDir(DumpPath); }
+    TDir::GenDir(DumpPath);
+    // two stores, so they are restored in parallel
+    const TStr StoreSchemaStr = "\"fields\":[{\"name\":\"tag\",\"type\":\"string\"},"
+        "{\"name\":\"text\",\"type\":\"string\"},{\"name\":\"num\",\"type\":\"float\"},"
+        "{\"name\":\"loc\",\"type\":\"float_pair\"}],"
+        "\"keys\":[{\"field\":\"tag\",\"type\":\"value\"},{\"field\":\"text\",\"type\":\"text\","
+        "\"tokenizer\":{\"type\":\"simple\"}},"
+        "{\"field\":\"num\",\"type\":\"linear\"},{\"field\":\"loc\",\"type\":\"location\"}]";
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\"," + StoreSchemaStr +
+        "},{\"name\":\"Notes\"," + StoreSchemaStr + "}]");
+    TStrV QueryStrV;
+    for (const TStr& StoreNm : TStrV::GetV("Docs", "Notes")) {
+        const TStr FromStr = "{\"$from\":\"" + StoreNm + "\",";
+        QueryStrV.Add(FromStr + "\"tag\":\"t1\"}");
+        QueryStrV.Add(FromStr + "\"text\":\"red\"}");
+        QueryStrV.Add(FromStr + "\"text\":\"3\"}");
+        QueryStrV.Add(FromStr + "\"num\":{\"$gt\":449.95}}");
+        QueryStrV.Add(FromStr + "\"loc\":{\"$location\":[10,10],\"$limit\":3}}");
+    }
+    // restored base must answer the same as the original one
+    TUInt64V RecsV;
+    {
+        TDir::GenDir(FPath);
+        TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+        for (const TStr& StoreNm : TStrV::GetV("Docs", "Notes")) {
+            TVec<PJsonVal> RecValV;
+            for (int RecN = 0; RecN < 5000; RecN++) {
+                PJsonVal RecVal = TJsonVal::NewObj();
+                RecVal->AddToObj("tag", "t" + TInt::GetStr(RecN % 3));
+                RecVal->AddToObj("text", "red fox " + TInt::GetStr(RecN % 7) + (RecN % 2 == 0 ? " red" : ""));
+                RecVal->AddToObj("num", RecN / 10.0);
+                RecVal->AddToObj("loc", RecN % 90, RecN % 180);
+                RecValV.Add(RecVal);
+            }
+            TUInt64V RecIdV; Base->GetStoreByStoreNm(StoreNm)->AddRecs(RecValV, RecIdV);
+        }
+        for (const TStr& QueryStr : QueryStrV) {
+            RecsV.Add(Base->Search(TJsonVal::GetValFromStr(QueryStr))->GetRecs());
+        }
+        Base->SaveBinDump(DumpPath);
+        TQm::TStorage::SaveBase(Base); delete Base();
+        TDir::DelNonEmptyDir(FPath);
+    }
+    EXPECT_EQ(RecsV[0].Val, 1667);
+    EXPECT_EQ(RecsV[1].Val, 5000);
+    EXPECT_EQ(RecsV[3].Val, 500);
+    TDir::GenDir(FPath);
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    Base->RestoreBinDump(DumpPath);
+    EXPECT_EQ(Base->GetStoreByStoreNm("Docs")->GetRecs(), 5000);
+    EXPECT_EQ(Base->GetStoreByStoreNm("Notes")->GetRecs(), 5000);
+    for (int QueryN = 0; QueryN < QueryStrV.Len(); QueryN++) {
+        EXPECT_EQ(Base->Search(TJsonVal::GetValFromStr(QueryStrV[QueryN]))->GetRecs(), RecsV[QueryN].Val);
+    }
+    // words are counted once for each occurrence and each text
+    const TWPt<TQm::TIndexVoc> IndexVoc = Base->GetIndexVoc();
+    const int TextKeyId = IndexVoc->GetKeyId(Base->GetStoreByStoreNm("Docs")->GetStoreId(), "text");
+    EXPECT_EQ(IndexVoc->GetWordFq(TextKeyId, IndexVoc->GetWordId(TextKeyId, "RED")), 7500);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+    TDir::DelNonEmptyDir(DumpPath);
+}
+
+TEST(TStoreColumnar, ColumnScan) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_columnar/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Points\","
+        "\"fields\":[{\"name\":\"val\",\"type\":\"int\"},{\"name\":\"flt\",\"type\":\"float\",\"null\":true}],"
+        "\"options\":{\"type\":\"columnar\"}}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Points");
+    EXPECT_TRUE(Store->HasColumnScan());
+    for (int RecN = 0; RecN < 10; RecN++) {
+        PJsonVal RecVal = TJsonVal::NewObj();
+        RecVal->AddToObj("val", RecN);
+        if (RecN % 2 == 0) { RecVal->AddToObj("flt", RecN / 2); }
+        Store->AddRec(RecVal);
+    }
+    // NULL values are read as zero
+    const int FltFieldId = Store->GetFieldId("flt");
+    TQm::PRecSet RecSet = Store->GetAllRecs();
+    TFltV FltV; Store->GetFieldFltV(RecSet->GetRecIdFqV(), FltFieldId, FltV);
+    EXPECT_EQ(FltV.Len(), 10);
+    EXPECT_EQ(FltV[4].Val, 2.0);
+    EXPECT_EQ(FltV[5].Val, 0.0);
+    // histogram reads values from the column
+    PJsonVal HistVal = TQm::TAggrs::THistogram::New(Base, "Hist", RecSet,
+        TJsonVal::GetValFromStr("{\"field\":\"val\"}"))->SaveJson();
+    EXPECT_EQ(HistVal->GetObjInt("count"), 10);
+    EXPECT_EQ(HistVal->GetObjNum("sum"), 45.0);
+    EXPECT_EQ(HistVal->GetObjNum("max"), 9.0);
+    // filters skip NULL values
+    RecSet->FilterByFieldFlt(FltFieldId, 1.0, 3.0);
+    EXPECT_EQ(RecSet->GetRecs(), 3);
+    EXPECT_EQ(RecSet->GetRecId(0), 2);
+    RecSet = Store->GetAllRecs();
+    RecSet->FilterByFieldInt(Store->GetFieldId("val"), 2, 5);
+    EXPECT_EQ(RecSet->GetRecs(), 4);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TStoreColumnar, NullsAndPartialFlush) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_columnar_flush/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Points\","
+        "\"fields\":[{\"name\":\"val\",\"type\":\"int\",\"null\":true}],"
+        "\"options\":{\"type\":\"columnar\"}}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Points");
+    const int ValFieldId = Store->GetFieldId("val");
+    const uint64 RecId = Store->AddRec(TJsonVal::GetValFromStr("{\"val\":7}"));
+    // value set to NULL is read as zero
+    Store->SetFieldNull(RecId, ValFieldId);
+    EXPECT_TRUE(Store->IsFieldNull(RecId, ValFieldId));
+    EXPECT_EQ(Store->GetFieldInt(RecId, ValFieldId), 0);
+    Store->SetFieldInt(RecId, ValFieldId, 8);
+    EXPECT_EQ(Store->GetFieldInt(RecId, ValFieldId), 8);
+    // columns are saved once when changed
+    EXPECT_GT(Store->GetDirtyBytes(), (uint64)0);
+    EXPECT_EQ(Store->PartialFlush(), 1);
+    EXPECT_EQ(Store->GetDirtyBytes(), (uint64)0);
+    EXPECT_EQ(Store->PartialFlush(), 0);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    // saved columns are loaded back
+    Base = TQm::TStorage::LoadBase(FPath, faRdOnly, 16 * TInt::Mega, 16 * TInt::Mega,
+        TStrUInt64H(), TStrUInt64H(), true);
+    Store = Base->GetStoreByStoreNm("Points");
+    EXPECT_EQ(Store->GetFieldInt(RecId, ValFieldId), 8);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TIndex, ParallelLinearSearch) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_linear_parallel/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"num\",\"type\":\"int\"},{\"name\":\"val\",\"type\":\"float\"}],"
+        "\"keys\":[{\"field\":\"num\",\"type\":\"linear\"},{\"field\":\"val\",\"type\":\"linear\"}]}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TWPt<TQm::TIndex> Index = Base->GetIndex();
+    TWPt<TQm::TIndexVoc> IndexVoc = Base->GetIndexVoc();
+    const uint StoreId = Base->GetStoreByStoreNm("Docs")->GetStoreId();
+    const int NumKeyId = IndexVoc->GetKeyId(StoreId, "num");
+    const int ValKeyId = IndexVoc->GetKeyId(StoreId, "val");
+    for (int RecN = 0; RecN < 5000; RecN++) { Index->IndexLinear(ValKeyId, (double)RecN, (uint64)RecN); }
+    // one tree is updated while the other is searched from several threads
+    std::atomic<bool> DoneP(false);
+    std::atomic<int> Mismatches(0);
+    std::thread Writer([&]() {
+        for (int RecN = 0; RecN < 5000; RecN++) { Index->IndexLinear(NumKeyId, RecN, (uint64)RecN); }
+        DoneP = true;
+    });
+    TVec<std::thread*> ReaderV;
+    for (int ReaderN = 0; ReaderN < 4; ReaderN++) {
+        ReaderV.Add(new std::thread([&]() {
+            int LastNumRecs = 0;
+            while (!DoneP) {
+                const int ValRecs = Index->SearchLinear(Base, ValKeyId,
+                    TFltPr(1000.0, 2999.0), false, true, -1)->GetRecs();
+                const int NumRecs = Index->SearchLinear(Base, NumKeyId,
+                    TIntPr(0, TInt::Mx), false, true, -1)->GetRecs();
+                if (ValRecs != 2000 || NumRecs < LastNumRecs) { Mismatches++; }
+                LastNumRecs = NumRecs;
+            }
+        }));
+    }
+    Writer.join();
+    for (std::thread* Reader : ReaderV) { Reader->join(); delete Reader; }
+    EXPECT_EQ(Mismatches.load(), 0);
+    EXPECT_EQ(Index->SearchLinear(Base, NumKeyId, TIntPr(0, TInt::Mx), false, true, -1)->GetRecs(), 5000);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TBase, ParallelSearch) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_parallel_search/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"tag\",\"type\":\"string\"},{\"name\":\"kind\",\"type\":\"string\"},"
+        "{\"name\":\"num\",\"type\":\"int\"},{\"name\":\"val\",\"type\":\"float\"}],"
+        "\"keys\":[{\"field\":\"tag\",\"type\":\"value\"},{\"field\":\"kind\",\"type\":\"value\"},"
+        "{\"field\":\"num\",\"type\":\"linear\"},{\"field\":\"val\",\"type\":\"linear\"}]}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+    TVec<PJsonVal> RecValV;
+    for (int RecN = 0; RecN < 30000; RecN++) {
+        PJsonVal RecVal = TJsonVal::NewObj();
+        RecVal->AddToObj("tag", "t" + TInt::GetStr(RecN % 3));
+        RecVal->AddToObj("kind", "k" + TInt::GetStr(RecN % 7));
+        RecVal->AddToObj("num", RecN);
+        RecVal->AddToObj("val", (double)(RecN % 1000));
+        RecValV.Add(RecVal);
+    }
+    TUInt64V RecIdV; Store->AddRecs(RecValV, RecIdV);
+    auto GetRecIdSet = [&](const TStr& QueryStr, TUInt64Set& RecIdSet) {
+        TQm::PRecSet RecSet = Base->Search(TJsonVal::GetValFromStr(QueryStr));
+        for (int RecN = 0; RecN < RecSet->GetRecs(); RecN++) { RecIdSet.AddKey(RecSet->GetRecId(RecN)); }
+    };
+    // lookups in both inverted and both linear indexes, evaluated in parallel where they
+    // do not share a lock, must give the same records as when done one by one
+    TStrV SubQueryStrV = TStrV::GetV("\"tag\":\"t1\"", "\"kind\":\"k2\"",
+        "\"num\":{\"$gt\":20000}", "\"val\":{\"$lt\":300}");
+    TVec<TUInt64Set> SubRecIdSetV(SubQueryStrV.Len());
+    TUInt64Set OrRecIdSet;
+    for (int SubQueryN = 0; SubQueryN < SubQueryStrV.Len(); SubQueryN++) {
+        GetRecIdSet("{\"$from\":\"Docs\"," + SubQueryStrV[SubQueryN] + "}", SubRecIdSetV[SubQueryN]);
+        GetRecIdSet("{\"$from\":\"Docs\"," + SubQueryStrV[SubQueryN] + "}", OrRecIdSet);
+    }
+    TUInt64Set OrResRecIdSet;
+    GetRecIdSet("{\"$from\":\"Docs\",\"$or\":[{" + TStr::GetStr(SubQueryStrV, "},{") + "}]}", OrResRecIdSet);
+    EXPECT_EQ(OrResRecIdSet.Len(), OrRecIdSet.Len());
+    // the same for conjunction of a value and both linear keys
+    int AndRecs = 0;
+    int KeyId = SubRecIdSetV[0].FFirstKeyId();
+    while (SubRecIdSetV[0].FNextKeyId(KeyId)) {
+        const uint64 RecId = SubRecIdSetV[0].GetKey(KeyId);
+        if (SubRecIdSetV[2].IsKey(RecId) && SubRecIdSetV[3].IsKey(RecId)) { AndRecs++; }
+    }
+    TUInt64Set AndResRecIdSet;
+    GetRecIdSet("{\"$from\":\"Docs\"," + SubQueryStrV[0] + "," + SubQueryStrV[2] + "," + SubQueryStrV[3] + "}", AndResRecIdSet);
+    EXPECT_GT(AndRecs, 0);
+    EXPECT_EQ(AndResRecIdSet.Len(), AndRecs);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TBase, CheckpointDuringIngest) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_checkpoint/";
+    const TStr CrashFPath = "./base_checkpoint_crash/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    if (TDir::Exists(CrashFPath)) { TDir::DelNonEmptyDir(CrashFPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"tag\",\"type\":\"string\"},{\"name\":\"num\",\"type\":\"int\"}],"
+        "\"keys\":[{\"field\":\"tag\",\"type\":\"value\"},{\"field\":\"num\",\"type\":\"linear\"}]}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    // write-ahead log is opened together with an existing base
+    Base = TQm::TStorage::LoadBase(FPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+        TStrUInt64H(), TStrUInt64H(), true, 1024, true);
+    Base->EnableConcurrency();
+    TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+    // checkpoints are taken while records are added, records which made it into
+    // the saved files must not be replayed from the log again
+    std::atomic<bool> StopP(false);
+    std::atomic<int> Recs(0);
+    std::thread Writer([&]() {
+        while (!StopP) {
+            PJsonVal RecVal = TJsonVal::NewObj();
+            RecVal->AddToObj("tag", "t" + TInt::GetStr(Recs % 2));
+            RecVal->AddToObj("num", Recs.load());
+            Store->AddRec(RecVal);
+            Recs++;
+        }
+    });
+    for (int CheckpointN = 0; CheckpointN < 5; CheckpointN++) {
+        while (Recs < (CheckpointN + 1) * 200) { std::this_thread::yield(); }
+        Base->Checkpoint();
+    }
+    StopP = true;
+    Writer.join();
+    const int AddedRecs = Recs.load();
+    EXPECT_EQ(Store->GetRecs(), AddedRecs);
+    // copy of the files is what remains after a crash: base as of the last checkpoint and the log
+    Base->GetWal()->Commit();
+    TDir::CopyDir(FPath, CrashFPath);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TWPt<TQm::TBase> CrashBase = TQm::TStorage::LoadBase(CrashFPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+        TStrUInt64H(), TStrUInt64H(), true, 1024, true);
+    EXPECT_EQ(CrashBase->GetStoreByStoreNm("Docs")->GetRecs(), AddedRecs);
+    EXPECT_EQ(CrashBase->Search(TJsonVal::GetValFromStr("{\"$from\":\"Docs\",\"tag\":\"t1\"}"))->GetRecs(), AddedRecs / 2);
+    EXPECT_EQ(CrashBase->Search(TJsonVal::GetValFromStr("{\"$from\":\"Docs\",\"num\":{\"$gt\":-1}}"))->GetRecs(), AddedRecs);
+    TQm::TStorage::SaveBase(CrashBase); delete CrashBase();
+    // base closed cleanly opens without replay
+    Base = TQm::TStorage::LoadBase(FPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+        TStrUInt64H(), TStrUInt64H(), true, 1024, true);
+    EXPECT_EQ(Base->GetStoreByStoreNm("Docs")->GetRecs(), AddedRecs);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+    TDir::DelNonEmptyDir(CrashFPath);
+}
+
+TEST(TBase, RecoverAfterKill) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_recover/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    // same records in a store kept in blob bases and in a paged store
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"age\",\"type\":\"int\"},{\"name\":\"tags\",\"type\":\"string_v\"}],"
+        "\"keys\":[{\"field\":\"age\",\"type\":\"linear\"},{\"field\":\"tags\",\"type\":\"value\"}]},"
+        "{\"name\":\"Pages\",\"options\":{\"type\":\"paged\"},"
+        "\"fields\":[{\"name\":\"age\",\"type\":\"int\"},{\"name\":\"tags\",\"type\":\"string_v\"}]}]");
+    auto NewRec = [](const int& RecN) {
+        PJsonVal RecVal = TJsonVal::NewObj();
+        RecVal->AddToObj("age", RecN % 50);
+        PJsonVal TagsVal = TJsonVal::NewArr();
+        TagsVal->AddToArr("t" + TInt::GetStr(RecN % 4));
+        TagsVal->AddToArr("all");
+        RecVal->AddToObj("tags", TagsVal);
+        return RecVal;
+    };
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    for (int RecN = 0; RecN < 100; RecN++) {
+        Base->GetStoreByStoreNm("Docs")->AddRec(NewRec(RecN));
+        Base->GetStoreByStoreNm("Pages")->AddRec(NewRec(RecN));
+    }
+    TQm::TStorage::SaveBase(Base); delete Base();
+    // changes written to the base files after the checkpoint must not break recovery
+    // from it: added, updated and deleted records, flushed to disk and then killed
+    EXPECT_EXIT({
+        TWPt<TQm::TBase> WalBase = TQm::TStorage::LoadBase(FPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+            TStrUInt64H(), TStrUInt64H(), true, 1024, true);
+        for (const TStr StoreNm : TStrV::GetV("Docs", "Pages")) {
+            TWPt<TQm::TStore> Store = WalBase->GetStoreByStoreNm(StoreNm);
+            for (int RecN = 100; RecN < 3000; RecN++) { Store->AddRec(NewRec(RecN)); }
+            WalBase->PartialFlush(TInt::Mx);
+            for (int RecN = 0; RecN < 50; RecN++) {
+                Store->UpdateRec(RecN, TJsonVal::GetValFromStr("{\"age\":" +
+                    TInt::GetStr(1000 + RecN) + ",\"tags\":[\"updated\",\"with\",\"more\",\"tags\"]}"));
+            }
+            TUInt64V DelRecIdV; for (int RecN = 0; RecN < 20; RecN++) { DelRecIdV.Add(RecN); }
+            Store->DeleteRecs(DelRecIdV);
+            for (int RecN = 3000; RecN < 3050; RecN++) { Store->AddRec(NewRec(RecN)); }
+            WalBase->PartialFlush(TInt::Mx);
+        }
+        WalBase->GetWal()->Commit();
+        _exit(0);
+    }, ::testing::ExitedWithCode(0), "");
+    Base = TQm::TStorage::LoadBase(FPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+        TStrUInt64H(), TStrUInt64H(), true, 1024, true);
+    for (const TStr StoreNm : TStrV::GetV("Docs", "Pages")) {
+        TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm(StoreNm);
+        const int AgeFieldId = Store->GetFieldId("age"), TagsFieldId = Store->GetFieldId("tags");
+        EXPECT_EQ(Store->GetRecs(), 3030);
+        EXPECT_FALSE(Store->IsRecId(10));
+        EXPECT_EQ(Store->GetFieldInt(30, AgeFieldId), 1030);
+        TStrV TagV; Store->GetFieldStrV(30, TagsFieldId, TagV);
+        EXPECT_EQ(TagV.Len(), 4);
+        EXPECT_EQ(TagV[0], "updated");
+        EXPECT_EQ(Store->GetFieldInt(3020, AgeFieldId), 20);
+        Store->GetFieldStrV(3020, TagsFieldId, TagV);
+        EXPECT_EQ(TagV.Len(), 2);
+        EXPECT_EQ(TagV[0], "t0");
+    }
+    auto Count = [&](const TStr& QueryStr) { return Base->Search(TJsonVal::GetValFromStr(QueryStr))->GetRecs(); };
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"age\":{\"$gt\":999}}"), 30);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"age\":{\"$lt\":9}}"), 600);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"tags\":\"updated\"}"), 30);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"tags\":\"all\"}"), 3000);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"tags\":\"t1\"}"), 750);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TBase, RecoverFailedEntry) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_recover_failed/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"age\",\"type\":\"int\"}]}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    // log entry which can not be applied, e.g. addition to a store missing in the base
+    EXPECT_EXIT({
+        TWPt<TQm::TBase> WalBase = TQm::TStorage::LoadBase(FPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+            TStrUInt64H(), TStrUInt64H(), true, 1024, true);
+        TWPt<TQm::TStore> Store = WalBase->GetStoreByStoreNm("Docs");
+        Store->AddRec(TJsonVal::GetValFromStr("{\"age\":1}"));
+        WalBase->GetWal()->Log(TQm::wotAddRec, Store->GetStoreId() + 1,
+            TJsonVal::GetValFromStr("{\"age\":2}"));
+        WalBase->GetWal()->Commit();
+        _exit(0);
+    }, ::testing::ExitedWithCode(0), "");
+    // base does not match the log, so it must not open
+    EXPECT_THROW(TQm::TStorage::LoadBase(FPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+        TStrUInt64H(), TStrUInt64H(), true, 1024, true), PExcept);
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TBase, WalCommitTimer) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_wal_timer/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"age\",\"type\":\"int\"}]}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    // entry is committed once it waited long enough, without new entries or a flusher
+    EXPECT_EXIT({
+        TWPt<TQm::TBase> WalBase = TQm::TStorage::LoadBase(FPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+            TStrUInt64H(), TStrUInt64H(), true, 1024, true);
+        WalBase->GetWal()->SetGroupCommit(TInt::Mega, 50);
+        WalBase->GetStoreByStoreNm("Docs")->AddRec(TJsonVal::GetValFromStr("{\"age\":1}"));
+        TSysProc::Sleep(500);
+        _exit(0);
+    }, ::testing::ExitedWithCode(0), "");
+    Base = TQm::TStorage::LoadBase(FPath, faUpdate, 16 * TInt::Mega, 16 * TInt::Mega,
+        TStrUInt64H(), TStrUInt64H(), true, 1024, true);
+    EXPECT_EQ(Base->GetStoreByStoreNm("Docs")->GetRecs(), 1);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
+
+TEST(TIndexWordVoc, WildcharWithoutPrefix) {
+    TQm::PIndexWordVoc WordVoc = TQm::TIndexWordVoc::New();
+    for (int WordN = 0; WordN < 1000; WordN++) { WordVoc->AddWordStr("w" + TInt::GetStr(WordN)); }
+    TUInt64V WordIdV;
+    WordVoc->GetWcWordIdV("*99", WordIdV);
+    EXPECT_EQ(WordIdV.Len(), 10);
+    // large vocabulary is not scanned word by word
+    for (int WordN = 1000; WordN <= 100000; WordN++) { WordVoc->AddWordStr("w" + TInt::GetStr(WordN)); }
+    EXPECT_THROW(WordVoc->GetWcWordIdV("*99", WordIdV), PExcept);
+    EXPECT_THROW(WordVoc->GetWcWordIdV("?1", WordIdV), PExcept);
+    WordVoc->GetWcWordIdV("w99*", WordIdV);
+    EXPECT_EQ(WordIdV.Len(), 1111);
+}
+
+TEST(TIndex, NumberSortedMixedWords) {
+    if (!TQm::TEnv::IsInit()) { TQm::TEnv::Init(); }
+    const TStr FPath = "./base_number_sort/";
+    if (TDir::Exists(FPath)) { TDir::DelNonEmptyDir(FPath); }
+    TDir::GenDir(FPath);
+    PJsonVal SchemaVal = TJsonVal::GetValFromStr("[{\"name\":\"Docs\","
+        "\"fields\":[{\"name\":\"size\",\"type\":\"string\"}],"
+        "\"keys\":[{\"field\":\"size\",\"type\":\"value\",\"sort\":\"number\"}]}]");
+    TWPt<TQm::TBase> Base = TQm::TStorage::NewBase(FPath, SchemaVal, 16 * TInt::Mega, 16 * TInt::Mega, true);
+    TWPt<TQm::TStore> Store = Base->GetStoreByStoreNm("Docs");
+    auto AddSize = [&](const TStr& SizeStr) {
+        PJsonVal RecVal = TJsonVal::NewObj(); RecVal->AddToObj("size", SizeStr); Store->AddRec(RecVal); };
+    auto Count = [&](const TStr& QueryStr) { return Base->Search(TJsonVal::GetValFromStr(QueryStr))->GetRecs(); };
+    AddSize("1"); AddSize("5"); AddSize("small"); AddSize("12");
+    // first range query builds the numeric order, words which are not numbers are left out
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"size\":{\"$gt\":\"1\"}}"), 2);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"size\":{\"$lt\":\"12\"}}"), 2);
+    // new words are added to the numeric order only when they are numbers
+    AddSize("large"); AddSize("7.5"); AddSize("x3"); AddSize("-2");
+    EXPECT_EQ(Store->GetRecs(), 8);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"size\":{\"$gt\":\"1\"}}"), 3);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"size\":{\"$lt\":\"7.5\"}}"), 3);
+    EXPECT_EQ(Count("{\"$from\":\"Docs\",\"size\":\"large\"}"), 1);
+    TQm::TStorage::SaveBase(Base); delete Base();
+    TDir::DelNonEmptyDir(FPath);
+}
@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+var nodefs = require('fs');
+
+var dump_dir = './bin_dump/';
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "name", "type": "string", "primary": true },
+            { "name": "tags", "type": "string_v", "codebook": true },
+            { "name": "n", "type": "int" },
+            { "name": "note", "type": "string", "null": true, "store": "cache" }
+        ],
+        "joins": [
+            { "name": "owner", "type": "index", "store": "Users", "inverse": "docs" },
+            { "name": "author", "type": "field", "store": "Users" }
+        ],
+        "keys": [
+            { "field": "tags", "type": "value" },
+            { "field": "n", "type": "linear" }
+        ]
+    }, {
+        "name": "Users",
+        "fields": [
+            { "name": "name", "type": "string", "primary": true }
+        ],
+        "joins": [
+            { "name": "docs", "type": "index", "store": "Docs", "inverse": "owner" }
+        ]
+    }];
+}
+
+function AddDocs(store, count) {
+    for (var i = 0; i < count; i++) {
+        var rec = {
+            name: "doc" + i,
+            tags: ["all", "mod" + (i % 3)],
+            n: i,
+            owner: [{ name: "user" + (i % 10) }],
+            author: { name: "user" + (i % 7) }
+        };
+        if (i % 2 == 0) { rec.note = "even" + i; }
+        store.push(rec);
+    }
+}
+
+describe('Base binary dump tests', function () {
+    beforeEach(function () {
+        if (!nodefs.existsSync(dump_dir)) { nodefs.mkdirSync(dump_dir); }
+    });
+
+    it('should restore records, indexes and joins', function () {
+        this.timeout(60 * 1000);
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        AddDocs(base.store("Docs"), 5000);
+        // restored records get ids from the start of the new store
+        base.store("Docs").clear(1000);
+        base.saveBinDump(dump_dir);
+        base.close();
+
+        var base2 = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        base2.restoreBinDump(dump_dir);
+        var docs = base2.store("Docs");
+        assert.equal(docs.length, 4000);
+        var doc = docs.recordByName("doc1001");
+        assert.equal(doc.$id, 1);
+        assert.deepEqual(doc.tags.toArray(), ["all", "mod2"]);
+        assert.equal(doc.note, null);
+        assert.equal(docs.recordByName("doc1002").note, "even1002");
+        assert.equal(doc.author.name, "user0");
+        assert.equal(doc.owner[0].name, "user1");
+        assert.equal(base2.store("Users").recordByName("user3").docs.length, 400);
+        assert.equal(base2.search({ $from: "Docs", tags: "mod1" }).length, 1334);
+        assert.equal(base2.search({ $from: "Docs", n: { $lt: 1099 } }).length, 100);
+        // store keeps working after restore
+        docs.push({ name: "new", tags: ["all", "new"], n: 1, author: { name: "user1" } });
+        assert.equal(docs.recordByName("new").$id, 4000);
+        assert.equal(base2.search({ $from: "Docs", tags: "new" }).length, 1);
+        base2.close();
+    });
+    it('should only restore into empty stores', function () {
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        AddDocs(base.store("Docs"), 10);
+        base.saveBinDump(dump_dir);
+        assert.throws(function () { base.restoreBinDump(dump_dir); });
+        base.close();
+    });
+    it('should reject dump of a different schema', function () {
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        AddDocs(base.store("Docs"), 10);
+        base.saveBinDump(dump_dir);
+        base.close();
+
+        var schema = GetSchema();
+        schema[0].fields[2].type = "float";
+        var base2 = new qm.Base({ mode: 'createClean', schema: schema });
+        assert.throws(function () { base2.restoreBinDump(dump_dir); });
+        base2.close();
+    });
+    it('should not write anything when a store does not support dumps', function () {
+        var schema = GetSchema();
+        schema.push({ name: "Points", fields: [{ name: "x", type: "float" }], options: { type: "columnar" } });
+        var base = new qm.Base({ mode: 'createClean', schema: schema });
+        AddDocs(base.store("Docs"), 10);
+        var empty_dir = dump_dir + 'empty/';
+        if (!nodefs.existsSync(empty_dir)) { nodefs.mkdirSync(empty_dir); }
+        assert.throws(function () { base.saveBinDump(empty_dir); }, /Points/);
+        assert.equal(nodefs.readdirSync(empty_dir).length, 0);
+        base.close();
+    });
+});
@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Store creation
+
+var store_name = "test_store";
+function GetStoreTemplate(type) {
+    return {
+        "name": store_name,
+        "options": { "type": type },
+        "fields": [
+            { "name": "name", "type": "string", "primary": true },
+            { "name": "val", "type": "int" },
+            { "name": "text", "type": "string", "store": "cache" }
+        ],
+        "keys": [
+            { "field": "val", "type": "linear" },
+            { "field": "text", "type": "value" }
+        ]
+    };
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+describe('Base background flusher tests', function () {
+    ["default", "paged"].forEach(function (type) {
+        it('should keep data added while flushing (' + type + ')', function () {
+            var base = new qm.Base({ mode: 'createClean', dbPath: './db_flusher/',
+                flusher: { tick: 5, slice: 5, maxDirty: 1 } });
+            base.createStore(GetStoreTemplate(type));
+            var store = base.store(store_name);
+            for (var i = 0; i < 10000; i++) {
+                store.push({ name: "r" + i, val: i, text: "t" + (i % 10) });
+            }
+            var stats = base.getStats();
+            assert.ok(stats.flusher != undefined);
+            assert.equal(stats.flusher.maxDirtyBytes, 1024 * 1024);
+            base.close();
+
+            base = new qm.Base({ mode: 'openReadOnly', dbPath: './db_flusher/' });
+            store = base.store(store_name);
+            assert.equal(store.length, 10000);
+            assert.equal(store[9999].val, 9999);
+            assert.equal(base.search({ $from: store_name, text: "t3" }).length, 1000);
+            assert.ok(base.getStats().flusher == undefined);
+            base.close();
+        })
+    });
+    ["default", "paged"].forEach(function (type) {
+        it('should write dirty data in the background (' + type + ')', function (done) {
+            this.timeout(30 * 1000);
+            var base = new qm.Base({ mode: 'createClean', dbPath: './db_flusher/',
+                flusher: { tick: 5, slice: 5 } });
+            base.createStore(GetStoreTemplate(type));
+            var store = base.store(store_name);
+            for (var i = 0; i < 10000; i++) {
+                store.push({ name: "r" + i, val: i, text: "t" + (i % 10) });
+            }
+            var flushes = base.getStats().flusher.flushes;
+            // wait for the flusher to report clean data, without flushing from here
+            var timer = setInterval(function () {
+                var stats = base.getStats().flusher;
+                if (stats.flushes <= flushes || stats.dirtyBytes > 0) { return; }
+                clearInterval(timer);
+                try {
+                    assert.ok(stats.flushedBlocks > 0);
+                    // flusher already wrote everything, nothing left for an explicit flush
+                    assert.equal(base.partialFlush(1000), 0);
+                    base.close();
+
+                    base = new qm.Base({ mode: 'openReadOnly', dbPath: './db_flusher/' });
+                    store = base.store(store_name);
+                    assert.equal(store.length, 10000);
+                    assert.equal(store[5000].text, "t0");
+                    assert.equal(base.search({ $from: store_name, text: "t3" }).length, 1000);
+                    assert.equal(base.search({ $from: store_name, val: { $gt: 9000 } }).length, 1000);
+                    base.close();
+                    done();
+                } catch (e) {
+                    done(e);
+                }
+            }, 20);
+        })
+    });
+    it('should not start flusher on read-only base', function () {
+        var base = new qm.Base({ mode: 'createClean', dbPath: './db_flusher/' });
+        base.createStore(GetStoreTemplate("default"));
+        base.close();
+        assert.throws(function () {
+            new qm.Base({ mode: 'openReadOnly', dbPath: './db_flusher/', flusher: {} });
+        });
+    })
+});
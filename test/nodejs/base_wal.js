@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+var nodefs = require('fs');
+var path = require('path');
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Store creation
+
+var store_name = "test_store";
+function GetStoreTemplate() {
+    return {
+        "name": store_name,
+        "fields": [
+            { "name": "name", "type": "string", "primary": true },
+            { "name": "val", "type": "int" }
+        ],
+        "keys": [
+            { "field": "val", "type": "linear" }
+        ]
+    };
+}
+
+// copies all files in db folder, including sub-folders (used to simulate crash)
+function CopyDir(src, dst) {
+    if (!nodefs.existsSync(dst)) { nodefs.mkdirSync(dst); }
+    nodefs.readdirSync(src).forEach(function (name) {
+        var srcPath = path.join(src, name);
+        var dstPath = path.join(dst, name);
+        if (nodefs.statSync(srcPath).isDirectory()) {
+            CopyDir(srcPath, dstPath);
+        } else {
+            nodefs.writeFileSync(dstPath, nodefs.readFileSync(srcPath));
+        }
+    });
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+describe('Base write-ahead log tests', function () {
+    beforeEach(function () {
+        var base = new qm.Base({ mode: 'createClean', dbPath: './db_wal/' });
+        base.createStore(GetStoreTemplate());
+        base.close();
+        // crash copy is created by some of the tests
+        var crashBase = new qm.Base({ mode: 'createClean', dbPath: './db_wal_crash/' });
+        crashBase.close();
+    });
+
+    it('should report log statistics', function () {
+        var base = new qm.Base({ mode: 'open', dbPath: './db_wal/', wal: true });
+        base.store(store_name).push({ name: "a", val: 1 });
+        var stats = base.getStats();
+        assert.notEqual(stats.wal, undefined);
+        assert.equal(stats.wal.lsn, 1);
+        base.close();
+    })
+    it('should keep changes after clean close', function () {
+        var base = new qm.Base({ mode: 'open', dbPath: './db_wal/', wal: true });
+        var store = base.store(store_name);
+        for (var i = 0; i < 10; i++) {
+            store.push({ name: "r" + i, val: i });
+        }
+        store.push({ name: "r3", val: 33 });
+        base.close();
+        assert(!nodefs.existsSync('./db_wal/Wal.log'));
+
+        base = new qm.Base({ mode: 'open', dbPath: './db_wal/', wal: true });
+        store = base.store(store_name);
+        assert.equal(store.length, 10);
+        assert.equal(store.recordByName("r3").val, 33);
+        // range bounds are inclusive, updated value is found in the range
+        assert.equal(base.search({ $from: store_name, val: { $gt: 8 } }).length, 3);
+        base.close();
+    })
+    it('should recover changes after crash', function () {
+        var base = new qm.Base({ mode: 'open', dbPath: './db_wal/', wal: true });
+        var store = base.store(store_name);
+        for (var i = 0; i < 10; i++) {
+            store.push({ name: "r" + i, val: i });
+        }
+        base.partialFlush();
+        // copy of the db folder while base is still open looks like a crashed base
+        CopyDir('./db_wal/', './db_wal_crash/');
+        base.close();
+
+        var crashBase = new qm.Base({ mode: 'open', dbPath: './db_wal_crash/', wal: true });
+        var crashStore = crashBase.store(store_name);
+        assert.equal(crashStore.length, 10);
+        assert.equal(crashStore.recordByName("r7").val, 7);
+        assert.equal(crashBase.search({ $from: store_name, val: { $gt: 7 } }).length, 3);
+        crashBase.close();
+    })
+});
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+var nodefs = require('fs');
+
+var db_path = './db/';
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "text", "type": "string" },
+            { "name": "tag", "type": "string" },
+            { "name": "phrase", "type": "string" }
+        ],
+        "keys": [
+            { "field": "text", "type": "text" },
+            { "field": "tag", "type": "value", "storage": "tiny" },
+            { "field": "phrase", "type": "text_position" }
+        ]
+    }];
+}
+
+function AddDocs(store, from, to) {
+    for (var i = from; i < to; i++) {
+        store.push({
+            text: "hello w" + (i % 50) + " w" + (i % 7),
+            tag: "t" + (i % 13),
+            phrase: "big red dog " + (i % 2 == 1 ? "barks" : "sleeps")
+        });
+    }
+}
+
+function CountRange(from, to, filter) {
+    var count = 0;
+    for (var i = from; i < to; i++) {
+        if (filter(i)) { count++; }
+    }
+    return count;
+}
+
+function CheckSearch(base, from, to) {
+    assert.equal(base.search({ $from: "Docs", text: "hello" }).length, to - from);
+    assert.equal(base.search({ $from: "Docs", text: "w3" }).length,
+        CountRange(from, to, function (i) { return i % 50 == 3 || i % 7 == 3; }));
+    assert.equal(base.search({ $from: "Docs", tag: "t0" }).length,
+        CountRange(from, to, function (i) { return i % 13 == 0; }));
+    assert.equal(base.search({ $from: "Docs", phrase: "red dog barks" }).length,
+        CountRange(from, to, function (i) { return i % 2 == 1; }));
+}
+
+function GetIndexSize() {
+    var size = 0;
+    nodefs.readdirSync(db_path).forEach(function (file) {
+        if (file.indexOf("Index_Gix") == 0) { size += nodefs.statSync(db_path + file).size; }
+    });
+    return size;
+}
+
+function BuildIndex(compress, count) {
+    var base = new qm.Base({ mode: 'createClean', schema: GetSchema(), indexCompress: compress });
+    AddDocs(base.store("Docs"), 0, count);
+    CheckSearch(base, 0, count);
+    base.close();
+    return GetIndexSize();
+}
+
+describe('Inverted index compression tests', function () {
+    it('should store smaller index and keep search results', function () {
+        this.timeout(60 * 1000);
+        var raw_size = BuildIndex(false, 20000);
+        var compressed_size = BuildIndex(true, 20000);
+        assert.ok(compressed_size * 2 < raw_size);
+
+        // setting is remembered by the base
+        var base = new qm.Base({ mode: 'open' });
+        CheckSearch(base, 0, 20000);
+        AddDocs(base.store("Docs"), 20000, 21000);
+        base.store("Docs").clear(500);
+        CheckSearch(base, 500, 21000);
+        base.close();
+
+        var base2 = new qm.Base({ mode: 'openReadOnly' });
+        CheckSearch(base2, 500, 21000);
+        base2.close();
+    });
+    it('should read uncompressed index after enabling compression', function () {
+        this.timeout(60 * 1000);
+        BuildIndex(false, 5000);
+        var base = new qm.Base({ mode: 'open', indexCompress: true });
+        CheckSearch(base, 0, 5000);
+        AddDocs(base.store("Docs"), 5000, 6000);
+        base.store("Docs").clear(1000);
+        CheckSearch(base, 1000, 6000);
+        base.close();
+
+        var base2 = new qm.Base({ mode: 'openReadOnly' });
+        CheckSearch(base2, 1000, 6000);
+        base2.close();
+    });
+});
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+var nodefs = require('fs');
+
+var dump_dir = './bin_dump_linear/';
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "num", "type": "int" },
+            { "name": "val", "type": "float" }
+        ],
+        "keys": [
+            { "field": "num", "type": "linear" },
+            { "field": "val", "type": "linear" }
+        ]
+    }];
+}
+
+function AddDocs(store, from, to) {
+    for (var i = from; i < to; i++) {
+        store.push({ num: (i * 7919) % to, val: i % 100 });
+    }
+}
+
+function CheckSearch(base, from, to) {
+    var nums = 0, vals = 0;
+    for (var i = from; i < to; i++) {
+        var num = (i * 7919) % to;
+        if (num >= 1000 && num <= 20000) { nums++; }
+        if (i % 100 >= 10 && i % 100 <= 20) { vals++; }
+    }
+    assert.equal(base.search({ $from: "Docs", num: { $gt: 1000, $lt: 20000 } }).length, nums);
+    assert.equal(base.search({ $from: "Docs", val: { $gt: 10, $lt: 20 } }).length, vals);
+}
+
+describe('Bulk loaded linear index tests', function () {
+    beforeEach(function () {
+        if (!nodefs.existsSync(dump_dir)) { nodefs.mkdirSync(dump_dir); }
+    });
+
+    it('should build linear indexes when restoring binary dump', function () {
+        this.timeout(60 * 1000);
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        AddDocs(base.store("Docs"), 0, 50000);
+        base.saveBinDump(dump_dir);
+        base.close();
+
+        base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        base.restoreBinDump(dump_dir);
+        CheckSearch(base, 0, 50000);
+        // bulk built index keeps working with deletions and single additions
+        base.store("Docs").clear(10000);
+        CheckSearch(base, 10000, 50000);
+        base.close();
+
+        base = new qm.Base({ mode: 'open' });
+        CheckSearch(base, 10000, 50000);
+        base.close();
+    });
+});
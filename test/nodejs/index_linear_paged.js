@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+var nodefs = require('fs');
+
+var db_path = './db/';
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "num", "type": "int" },
+            { "name": "val", "type": "float" }
+        ],
+        "keys": [
+            { "field": "num", "type": "linear" },
+            { "field": "val", "type": "linear" }
+        ]
+    }];
+}
+
+function AddDocs(store, from, to) {
+    for (var i = from; i < to; i++) {
+        store.push({ num: i, val: i % 100 });
+    }
+}
+
+function CountRange(from, to, filter) {
+    var count = 0;
+    for (var i = from; i < to; i++) {
+        if (filter(i)) { count++; }
+    }
+    return count;
+}
+
+function CheckSearch(base, from, to) {
+    assert.equal(base.search({ $from: "Docs", num: { $gt: 1000, $lt: 20000 } }).length,
+        CountRange(from, to, function (i) { return i >= 1000 && i <= 20000; }));
+    assert.equal(base.search({ $from: "Docs", val: { $gt: 10, $lt: 20 } }).length,
+        CountRange(from, to, function (i) { return i % 100 >= 10 && i % 100 <= 20; }));
+}
+
+describe('Paged linear index tests', function () {
+    it('should keep range queries working after reopening the base', function () {
+        this.timeout(60 * 1000);
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        AddDocs(base.store("Docs"), 0, 30000);
+        CheckSearch(base, 0, 30000);
+        base.store("Docs").clear(5000);
+        CheckSearch(base, 5000, 30000);
+        base.close();
+        // nodes are kept in the paged file
+        assert.ok(nodefs.existsSync(db_path + "Index.BTreePaged"));
+        assert.ok(nodefs.existsSync(db_path + "Index.BTreePages.main"));
+
+        base = new qm.Base({ mode: 'open' });
+        CheckSearch(base, 5000, 30000);
+        AddDocs(base.store("Docs"), 30000, 40000);
+        CheckSearch(base, 5000, 40000);
+        base.close();
+
+        base = new qm.Base({ mode: 'openReadOnly' });
+        CheckSearch(base, 5000, 40000);
+        base.close();
+    });
+});
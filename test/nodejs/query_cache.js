@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+var nodefs = require('fs');
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "tag", "type": "string" },
+            { "name": "kind", "type": "string" },
+            { "name": "num", "type": "int" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value" },
+            { "field": "kind", "type": "value" },
+            { "field": "num", "type": "linear" }
+        ]
+    }, {
+        "name": "Other",
+        "fields": [
+            { "name": "tag", "type": "string" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value" }
+        ]
+    }];
+}
+
+describe('Query result cache tests', function () {
+    var base = undefined;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean', schema: GetSchema(), queryCache: 16 });
+        var store = base.store("Docs");
+        for (var i = 0; i < 1000; i++) {
+            store.push({ tag: "t" + (i % 4), kind: "k" + (i % 3), num: i });
+        }
+        base.store("Other").push({ tag: "t1" });
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should answer repeated queries from the cache', function () {
+        assert.equal(base.search({ $from: "Docs", tag: "t1", num: { $gt: 100 } }).length, 225);
+        // order of conditions does not matter
+        assert.equal(base.search({ $from: "Docs", num: { $gt: 100 }, tag: "t1" }).length, 225);
+        var stats = base.getStats().query_cache;
+        assert.equal(stats.hits, 1);
+        assert.equal(stats.misses, 1);
+        assert.equal(stats.results, 1);
+    });
+
+    it('should apply sort and limit to cached results', function () {
+        var query = { $from: "Docs", tag: "t2" };
+        assert.equal(base.search(query).length, 250);
+        var recs = base.search({ $from: "Docs", tag: "t2", $sort: { num: -1 }, $limit: 3 });
+        assert.equal(recs.length, 3);
+        assert.equal(recs[0].num, 998);
+        assert.equal(base.search(query).length, 250);
+        assert.equal(base.getStats().query_cache.hits, 2);
+    });
+
+    it('should drop results when records they depend on change', function () {
+        var store = base.store("Docs");
+        assert.equal(base.search({ $from: "Docs", tag: "t1" }).length, 250);
+        assert.equal(base.search({ $from: "Docs", kind: "k1" }).length, 333);
+        assert.equal(base.search({ $from: "Docs", tag: { $ne: "t1" } }).length, 750);
+        // adding to other store or other keys keeps the results
+        base.store("Other").push({ tag: "t1" });
+        assert.equal(base.search({ $from: "Docs", tag: "t1" }).length, 250);
+        assert.equal(base.getStats().query_cache.hits, 1);
+        // new record changes all three
+        store.push({ tag: "t1", kind: "k1", num: 1000 });
+        assert.equal(base.search({ $from: "Docs", tag: "t1" }).length, 251);
+        assert.equal(base.search({ $from: "Docs", kind: "k1" }).length, 334);
+        assert.equal(base.search({ $from: "Docs", tag: { $ne: "t1" } }).length, 750);
+        // update of one key keeps results on the other
+        store[1000].tag = "t2";
+        assert.equal(base.search({ $from: "Docs", tag: "t1" }).length, 250);
+        assert.equal(base.search({ $from: "Docs", kind: "k1" }).length, 334);
+        var stats = base.getStats().query_cache;
+        assert.equal(stats.hits, 2);
+        assert.equal(stats.invalidations, 4);
+    });
+
+    it('should drop results of stores restored from binary dump', function () {
+        var dump_dir = './query_cache_dump/';
+        if (!nodefs.existsSync(dump_dir)) { nodefs.mkdirSync(dump_dir); }
+        base.saveBinDump(dump_dir);
+        // dump is restored into empty stores
+        base.store("Docs").clear();
+        base.store("Other").clear();
+        assert.equal(base.search({ $from: "Docs" }).length, 0);
+        assert.equal(base.search({ $from: "Docs", $not: { tag: "t1" } }).length, 0);
+        base.restoreBinDump(dump_dir);
+        assert.equal(base.search({ $from: "Docs" }).length, 1000);
+        assert.equal(base.search({ $from: "Docs", $not: { tag: "t1" } }).length, 750);
+    });
+});
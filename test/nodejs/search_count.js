@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "tag", "type": "string" },
+            { "name": "lbl", "type": "string" },
+            { "name": "kind", "type": "string" },
+            { "name": "num", "type": "int" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value" },
+            { "field": "lbl", "type": "value" },
+            { "field": "kind", "type": "value", "storage": "small" },
+            { "field": "num", "type": "linear" }
+        ]
+    }];
+}
+
+describe('Count and existence query tests', function () {
+    var base = undefined;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        var store = base.store("Docs");
+        for (var i = 0; i < 10000; i++) {
+            store.push({ tag: "t" + (i % 3), lbl: "l" + (i % 4), kind: "k" + (i % 5), num: i });
+        }
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should count the same records as search returns', function () {
+        var queries = [
+            { $from: "Docs" },
+            { $from: "Docs", tag: "t1" },
+            { $from: "Docs", tag: "missing" },
+            { $from: "Docs", tag: { $ne: "t1" } },
+            { $from: "Docs", kind: "k2" },
+            { $from: "Docs", tag: "t1", lbl: "l2" },
+            { $from: "Docs", tag: "t1", kind: "k2" },
+            { $from: "Docs", num: { $gt: 1000, $lt: 5000 } },
+            { $from: "Docs", tag: "t1", num: { $gt: 1000, $lt: 5000 } },
+            { $from: "Docs", $or: [{ tag: "t1" }, { kind: "k1" }] },
+            { $from: "Docs", tag: "t1", $not: { lbl: "l1" } }
+        ];
+        for (var i = 0; i < queries.length; i++) {
+            var length = base.search(queries[i]).length;
+            assert.equal(base.searchCount(queries[i]), length);
+            assert.equal(base.searchExists(queries[i]), length > 0);
+        }
+    });
+
+    it('should apply limit and offset to the count', function () {
+        assert.equal(base.searchCount({ $from: "Docs", tag: "t1", $limit: 5 }), 5);
+        assert.equal(base.searchCount({ $from: "Docs", tag: "t1", $offset: 3000 }), 333);
+        assert.equal(base.searchCount({ $from: "Docs", tag: "t1", $offset: 5000 }), 0);
+        assert.equal(base.searchExists({ $from: "Docs", tag: "t1", $offset: 5000 }), false);
+        assert.equal(base.searchCount({ $from: "Docs", num: { $gt: 100 }, $offset: 10, $limit: 3 }), 3);
+    });
+
+    it('should not count deleted and changed records', function () {
+        var store = base.store("Docs");
+        store.clear(1000);
+        store[1002].tag = "t1";
+        assert.equal(base.searchCount({ $from: "Docs", tag: "t1" }),
+            base.search({ $from: "Docs", tag: "t1" }).length);
+        assert.equal(base.searchCount({ $from: "Docs", tag: "t1", lbl: "l0" }),
+            base.search({ $from: "Docs", tag: "t1", lbl: "l0" }).length);
+        assert.equal(base.searchCount({ $from: "Docs", num: { $lt: 1999 } }), 1000);
+        assert.equal(base.searchExists({ $from: "Docs", num: { $lt: 999 } }), false);
+    });
+});
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "tag", "type": "string" },
+            { "name": "labels", "type": "string_v" },
+            { "name": "text", "type": "string" },
+            { "name": "kind", "type": "string" },
+            { "name": "parity", "type": "string" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value" },
+            { "field": "labels", "type": "value" },
+            { "field": "text", "type": "text" },
+            { "field": "kind", "type": "value", "storage": "small" },
+            { "field": "parity", "type": "value", "storage": "tiny" }
+        ]
+    }];
+}
+
+function IsRare(i) { return i % 997 == 5; }
+
+function AddDocs(store, count) {
+    for (var i = 0; i < count; i++) {
+        store.push({
+            tag: IsRare(i) ? "rare" : "tag" + (i % 5),
+            labels: ["all", "mod" + (i % 3)],
+            text: "common w" + (i % 7) + (IsRare(i) ? " rare" : ""),
+            kind: IsRare(i) ? "rare" : "common",
+            parity: i % 2 == 0 ? "even" : "odd"
+        });
+    }
+}
+
+function CountRange(count, filter) {
+    var res = 0;
+    for (var i = 0; i < count; i++) {
+        if (filter(i)) { res++; }
+    }
+    return res;
+}
+
+function CheckSearch(base, count) {
+    assert.equal(base.search({ $from: "Docs", text: "rare common" }).length,
+        CountRange(count, IsRare));
+    assert.equal(base.search({ $from: "Docs", text: "common w3" }).length,
+        CountRange(count, function (i) { return i % 7 == 3; }));
+    assert.equal(base.search({ $from: "Docs", tag: "rare", labels: "all" }).length,
+        CountRange(count, IsRare));
+    assert.equal(base.search({ $from: "Docs", tag: "rare", labels: "mod1" }).length,
+        CountRange(count, function (i) { return IsRare(i) && i % 3 == 1; }));
+    assert.equal(base.search({ $from: "Docs", labels: "mod1", text: "w3" }).length,
+        CountRange(count, function (i) { return i % 3 == 1 && i % 7 == 3; }));
+    assert.equal(base.search({ $from: "Docs", tag: "rare", labels: { $ne: "mod1" } }).length,
+        CountRange(count, function (i) { return IsRare(i) && i % 3 != 1; }));
+    assert.equal(base.search({ $from: "Docs", tag: "rare", labels: "missing" }).length, 0);
+    assert.equal(base.search({ $from: "Docs", kind: "rare", parity: "odd" }).length,
+        CountRange(count, function (i) { return IsRare(i) && i % 2 == 1; }));
+    assert.equal(base.search({ $from: "Docs", kind: "rare", parity: "odd", tag: "rare" }).length,
+        CountRange(count, function (i) { return IsRare(i) && i % 2 == 1; }));
+}
+
+describe('Inverted index conjunction tests', function () {
+    it('should intersect short and long posting lists', function () {
+        this.timeout(60 * 1000);
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        AddDocs(base.store("Docs"), 50000);
+        CheckSearch(base, 50000);
+        base.close();
+
+        // posting lists are loaded from disk on demand
+        var base2 = new qm.Base({ mode: 'openReadOnly' });
+        CheckSearch(base2, 50000);
+        base2.close();
+    });
+});
@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "tag", "type": "string" },
+            { "name": "kind", "type": "string" },
+            { "name": "num", "type": "int" },
+            { "name": "val", "type": "float" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value" },
+            { "field": "kind", "type": "value", "storage": "small" },
+            { "field": "num", "type": "linear" },
+            { "field": "val", "type": "linear" }
+        ]
+    }];
+}
+
+function CountRange(count, filter) {
+    var res = 0;
+    for (var i = 0; i < count; i++) {
+        if (filter(i)) { res++; }
+    }
+    return res;
+}
+
+describe('Parallel query evaluation tests', function () {
+    it('should merge independent clauses evaluated in parallel', function () {
+        this.timeout(60 * 1000);
+        var count = 50000;
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        var store = base.store("Docs");
+        for (var i = 0; i < count; i++) {
+            store.push({ tag: "t" + (i % 3), kind: "k" + (i % 4), num: i, val: i % 100 });
+        }
+
+        assert.equal(base.search({ $from: "Docs", $or: [
+            { tag: "t1" }, { kind: "k2" },
+            { num: { $gt: 1000, $lt: 20000 } }, { val: { $gt: 10, $lt: 20 } }
+        ]}).length, CountRange(count, function (i) {
+            return i % 3 == 1 || i % 4 == 2 || (i >= 1000 && i <= 20000) || (i % 100 >= 10 && i % 100 <= 20);
+        }));
+        assert.equal(base.search({ $from: "Docs", tag: "t1",
+            $or: [{ kind: "k2" }, { val: { $gt: 10, $lt: 20 } }],
+            num: { $gt: 1000, $lt: 40000 }
+        }).length, CountRange(count, function (i) {
+            return i % 3 == 1 && (i % 4 == 2 || (i % 100 >= 10 && i % 100 <= 20)) && i >= 1000 && i <= 40000;
+        }));
+        assert.equal(base.search({ $from: "Docs", $or: [
+            { tag: "t1", kind: { $ne: "k2" } }, { num: { $gt: 1000, $lt: 20000 } }
+        ]}).length, CountRange(count, function (i) {
+            return (i % 3 == 1 && i % 4 != 2) || (i >= 1000 && i <= 20000);
+        }));
+        base.close();
+    });
+});
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "tag", "type": "string" },
+            { "name": "num", "type": "int" },
+            { "name": "val", "type": "float" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value" },
+            { "field": "num", "type": "linear" },
+            { "field": "val", "type": "linear" }
+        ]
+    }];
+}
+
+function IsRare(i) { return i % 500 == 3; }
+
+function AddDocs(store, count) {
+    for (var i = 0; i < count; i++) {
+        store.push({ tag: IsRare(i) ? "rare" : "tag" + (i % 5), num: i, val: i % 100 });
+    }
+}
+
+function CountRange(count, filter) {
+    var res = 0;
+    for (var i = 0; i < count; i++) {
+        if (filter(i)) { res++; }
+    }
+    return res;
+}
+
+describe('Query planner tests', function () {
+    var base = undefined;
+    var count = 20000;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        AddDocs(base.store("Docs"), count);
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should evaluate selective terms first and broad ranges as filters', function () {
+        var query = { $from: "Docs", num: { $gt: 100, $lt: 15000 }, tag: "rare" };
+        var plan = base.explain(query);
+        assert.equal(plan.type, "and");
+        assert.equal(plan.items.length, 2);
+        assert.equal(plan.items[0].type, "gix");
+        assert.equal(plan.items[0].key, "tag");
+        assert.equal(plan.items[0].estRecs, CountRange(count, IsRare));
+        assert.equal(plan.items[1].type, "filter");
+        assert.equal(plan.items[1].key, "num");
+        assert.equal(base.search(query).length,
+            CountRange(count, function (i) { return IsRare(i) && i >= 100 && i <= 15000; }));
+    });
+
+    it('should filter range with range', function () {
+        var query = { $from: "Docs", num: { $gt: 100, $lt: 15000 }, val: { $gt: 10, $lt: 12 } };
+        var plan = base.explain(query);
+        assert.equal(plan.items[0].key, "val");
+        assert.equal(plan.items[0].type, "range");
+        assert.equal(plan.items[1].type, "filter");
+        assert.equal(base.search(query).length, CountRange(count, function (i) {
+            return i >= 100 && i <= 15000 && i % 100 >= 10 && i % 100 <= 12;
+        }));
+    });
+
+    it('should keep negations correct', function () {
+        var query = { $from: "Docs", tag: "rare", $not: { num: { $gt: 0, $lt: 10000 } } };
+        var plan = base.explain(query);
+        assert.equal(plan.items[0].type, "gix");
+        assert.equal(plan.items[1].type, "not");
+        assert.equal(base.search(query).length,
+            CountRange(count, function (i) { return IsRare(i) && i > 10000; }));
+        assert.equal(base.search({ $from: "Docs", tag: "missing", num: { $gt: 0 } }).length, 0);
+    });
+});
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+function GetSchema() {
+    return [{
+        "name": "Events",
+        "fields": [
+            { "name": "num", "type": "int" },
+            { "name": "price", "type": "float" }
+        ],
+        "keys": [
+            { "field": "num", "type": "linear" },
+            { "field": "price", "type": "linear" }
+        ]
+    }];
+}
+
+describe('Sorted range query tests', function () {
+    var base = undefined;
+    var count = 10000;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        var store = base.store("Events");
+        for (var i = 0; i < count; i++) {
+            store.push({ num: (i * 7919) % count, price: i % 50 });
+        }
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should return top records of a range in value order', function () {
+        var recs = base.search({ $from: "Events", num: { $lt: 5000 }, $sort: { num: -1 }, $limit: 5 });
+        assert.equal(recs.length, 5);
+        for (var i = 0; i < 5; i++) { assert.equal(recs[i].num, 5000 - i); }
+        recs = base.search({ $from: "Events", num: { $gt: 100 }, $sort: { num: 1 }, $limit: 3, $offset: 2 });
+        assert.equal(recs.length, 3);
+        assert.equal(recs[0].num, 102);
+        assert.equal(recs[2].num, 104);
+    });
+
+    it('should keep values sorted when they repeat', function () {
+        var recs = base.search({ $from: "Events", price: { $gt: 10, $lt: 20 }, $sort: { price: -1 }, $limit: 500 });
+        assert.equal(recs.length, 500);
+        assert.equal(recs[0].price, 20);
+        for (var i = 1; i < recs.length; i++) { assert.ok(recs[i - 1].price >= recs[i].price); }
+        // without limit we get the whole range
+        assert.equal(base.search({ $from: "Events", price: { $gt: 10, $lt: 20 }, $sort: { price: 1 } }).length, 11 * count / 50);
+        assert.equal(base.search({ $from: "Events", num: { $gt: count }, $sort: { num: 1 }, $limit: 5 }).length, 0);
+    });
+
+    it('should sort ranges on other fields as before', function () {
+        var recs = base.search({ $from: "Events", num: { $lt: 10 }, $sort: { price: 1 }, $limit: 4 });
+        assert.equal(recs.length, 4);
+        for (var i = 1; i < recs.length; i++) { assert.ok(recs[i - 1].price <= recs[i].price); }
+    });
+});
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "tag", "type": "string" },
+            { "name": "code", "type": "string" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value", "sort": "string" },
+            { "field": "code", "type": "value", "sort": "number" }
+        ]
+    }];
+}
+
+function AddDocs(store, from, to) {
+    for (var i = from; i < to; i++) {
+        store.push({ tag: "w" + i, code: "" + (i % 300) });
+    }
+}
+
+function CountRange(from, to, filter) {
+    var count = 0;
+    for (var i = from; i < to; i++) {
+        if (filter(i)) { count++; }
+    }
+    return count;
+}
+
+describe('Wildcard and range value query tests', function () {
+    var base = undefined;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        AddDocs(base.store("Docs"), 0, 5000);
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should match words by prefix and wildcards', function () {
+        assert.equal(base.search({ $from: "Docs", tag: { $wc: "w12*" } }).length,
+            CountRange(0, 5000, function (i) { return ("w" + i).indexOf("w12") == 0; }));
+        assert.equal(base.search({ $from: "Docs", tag: { $wc: "w1?3" } }).length, 10);
+        assert.equal(base.search({ $from: "Docs", tag: { $wc: "*99" } }).length,
+            CountRange(0, 5000, function (i) { return i % 100 == 99; }));
+        assert.equal(base.search({ $from: "Docs", tag: { $wc: "x*" } }).length, 0);
+        // words added after the first lookup are found as well
+        AddDocs(base.store("Docs"), 5000, 6000);
+        assert.equal(base.search({ $from: "Docs", tag: { $wc: "w12*" } }).length,
+            CountRange(0, 6000, function (i) { return ("w" + i).indexOf("w12") == 0; }));
+    });
+
+    it('should match words lexicographically and numerically greater or less', function () {
+        assert.equal(base.search({ $from: "Docs", tag: { $gt: "w4" } }).length,
+            CountRange(0, 5000, function (i) { return "w" + i > "w4"; }));
+        assert.equal(base.search({ $from: "Docs", tag: { $lt: "w123" } }).length,
+            CountRange(0, 5000, function (i) { return "w" + i < "w123"; }));
+        assert.equal(base.search({ $from: "Docs", code: { $gt: "250" } }).length,
+            CountRange(0, 5000, function (i) { return i % 300 > 250; }));
+        AddDocs(base.store("Docs"), 5000, 5300);
+        assert.equal(base.search({ $from: "Docs", code: { $lt: "20" } }).length,
+            CountRange(0, 5300, function (i) { return i % 300 < 20; }));
+    });
+});
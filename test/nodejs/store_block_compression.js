@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+var store_name = "Log";
+function GetStoreTemplate() {
+    return {
+        "name": store_name,
+        "fields": [
+            { "name": "time", "type": "datetime" },
+            { "name": "level", "type": "string" },
+            { "name": "code", "type": "int" },
+            { "name": "msg", "type": "string", "store": "cache" }
+        ],
+        "keys": [
+            { "field": "code", "type": "linear" }
+        ],
+        "options": {
+            "block_compression": true,
+            "block_size_mem": 100
+        }
+    };
+}
+
+var start_time = new Date("2016-01-01T00:00:00Z").getTime();
+function GetRec(i) {
+    return {
+        time: start_time + i * 137,
+        level: i % 17 == 0 ? "WARN" : "INFO",
+        code: i % 7 == 0 ? 504 : 200,
+        msg: "GET /api/items/" + (i % 300) + " served by worker-" + (i % 4)
+    };
+}
+
+function GetStoreStats(base) {
+    return base.getStats().stores.filter(function (stats) {
+        return stats.name == store_name;
+    })[0];
+}
+
+describe('Store block compression tests', function () {
+    it('should compress blocks and read them back after reopen', function () {
+        this.timeout(60 * 1000);
+        var rec_cnt = 5000;
+
+        var base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate());
+        var store = base.store(store_name);
+        for (var i = 0; i < rec_cnt; i++) {
+            store.push(GetRec(i));
+        }
+        base.partialFlush(10000);
+        var compression = GetStoreStats(base).block_compression;
+        assert.ok(compression.memory_raw > 0);
+        assert.ok(compression.memory_stored * 3 < compression.memory_raw);
+        assert.ok(compression.cache_stored * 3 < compression.cache_raw);
+        base.close();
+
+        var base2 = new qm.Base({ mode: 'open' });
+        var store2 = base2.store(store_name);
+        assert.equal(store2.length, rec_cnt);
+        for (var i = 0; i < rec_cnt; i += 7) {
+            var rec = GetRec(i);
+            assert.equal(store2[i].time.getTime(), rec.time);
+            assert.equal(store2[i].level, rec.level);
+            assert.equal(store2[i].code, rec.code);
+            assert.equal(store2[i].msg, rec.msg);
+        }
+        assert.equal(base2.search({ $from: store_name, code: { $gt: 500 } }).length, Math.ceil(rec_cnt / 7));
+        // updates are compressed as well
+        store2[10].msg = "changed";
+        base2.close();
+
+        var base3 = new qm.Base({ mode: 'openReadOnly' });
+        assert.equal(base3.store(store_name)[10].msg, "changed");
+        assert.equal(base3.store(store_name)[11].msg, GetRec(11).msg);
+        base3.close();
+    });
+    it('should not report compression for stores without it', function () {
+        var base = new qm.Base({ mode: 'createClean' });
+        var template = GetStoreTemplate();
+        delete template.options.block_compression;
+        base.createStore(template);
+        base.store(store_name).push(GetRec(0));
+        base.partialFlush(10000);
+        assert.equal(GetStoreStats(base).block_compression, undefined);
+        base.close();
+    });
+});
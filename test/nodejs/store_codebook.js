@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+var store_name = "Events";
+function GetStoreTemplate() {
+    return {
+        "name": store_name,
+        "fields": [
+            { "name": "host", "type": "string", "codebook": true },
+            { "name": "tags", "type": "string_v", "codebook": true },
+            { "name": "labels", "type": "string_v", "codebook": true, "store": "cache" },
+            { "name": "n", "type": "int" }
+        ]
+    };
+}
+
+function AddEvents(store, count) {
+    for (var i = 0; i < count; i++) {
+        store.push({
+            host: "host" + (i % 5),
+            tags: ["web", "status" + (i % 3)],
+            labels: i % 2 == 0 ? [] : ["odd"],
+            n: i
+        });
+    }
+}
+
+describe('Codebook field tests', function () {
+    it('should encode string vectors with codebook', function () {
+        var base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate());
+        var store = base.store(store_name);
+        AddEvents(store, 100);
+        assert.deepEqual(store[7].tags.toArray(), ["web", "status1"]);
+        assert.deepEqual(store[7].labels.toArray(), ["odd"]);
+        assert.equal(store[8].labels.length, 0);
+        store[8].labels = ["new", "odd"];
+        assert.deepEqual(store[8].labels.toArray(), ["new", "odd"]);
+        base.close();
+
+        var base2 = new qm.Base({ mode: 'openReadOnly' });
+        var store2 = base2.store(store_name);
+        assert.deepEqual(store2[7].tags.toArray(), ["web", "status1"]);
+        assert.deepEqual(store2[8].labels.toArray(), ["new", "odd"]);
+        base2.close();
+    });
+    it('should filter codebook strings', function () {
+        var base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate());
+        var store = base.store(store_name);
+        AddEvents(store, 100);
+        assert.equal(store.allRecords.filterByField("host", "host2").length, 20);
+        assert.equal(store.allRecords.filterByField("host", "missing").length, 0);
+        assert.equal(store.allRecords.filterByField("host", "host0", "host1").length, 40);
+        base.close();
+    });
+});
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Store creation
+
+var store_name = "test_store";
+function GetStoreTemplate() {
+    return {
+        "name": store_name,
+        "fields": [
+            { "name": "val", "type": "int" },
+            { "name": "flt", "type": "float", "null": true },
+            { "name": "flag", "type": "bool", "default": false },
+            { "name": "time", "type": "datetime" }
+        ],
+        "keys": [
+            { "field": "val", "type": "linear" }
+        ],
+        "options": {
+            "type": "columnar"
+        }
+    };
+}
+
+function Fill(store, records) {
+    for (var i = 0; i < records; i++) {
+        var rec = { val: i, time: 1000 * i };
+        if (i % 2 == 0) { rec.flt = i / 2; }
+        store.push(rec);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+describe('Columnar store tests', function () {
+    var base = undefined;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate());
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should store and read fixed-width fields', function () {
+        var store = base.store(store_name);
+        Fill(store, 10);
+        assert.equal(store.length, 10);
+        assert.equal(store[3].val, 3);
+        assert.equal(store[4].flt, 2);
+        assert.equal(store[3].flt, null);
+        assert.equal(store[3].flag, false);
+        assert.equal(store[3].time.getTime(), 3000);
+    })
+    it('should update records and keep linear index in sync', function () {
+        var store = base.store(store_name);
+        Fill(store, 10);
+        store[2].val = 100;
+        store[3].flt = 1.5;
+        assert.equal(store[3].flt, 1.5);
+        var rs = base.search({ $from: store_name, val: { $gt: 50 } });
+        assert.equal(rs.length, 1);
+        assert.equal(rs[0].$id, 2);
+    })
+    it('should reject values of wrong type', function () {
+        var store = base.store(store_name);
+        assert.throws(function () {
+            store.push({ val: "abc", time: 0 });
+        });
+        assert.equal(store.length, 0);
+    })
+    it('should delete first records', function () {
+        var store = base.store(store_name);
+        Fill(store, 10);
+        store.clear(4);
+        assert.equal(store.length, 6);
+        assert.equal(store.first.val, 4);
+        var rs = base.search({ $from: store_name, val: { $lt: 3 } });
+        assert.equal(rs.length, 0);
+    })
+    it('should aggregate and filter over columns', function () {
+        var store = base.store(store_name);
+        Fill(store, 10);
+        var hist = store.allRecords.aggr({ name: "hist", type: "histogram", field: "val" });
+        assert.equal(hist.count, 10);
+        assert.equal(hist.sum, 45);
+        var rs = store.allRecords.filterByField("flt", 1, 3);
+        assert.equal(rs.length, 3);
+        assert.equal(rs[0].$id, 2);
+    })
+    it('should reject unsupported field types', function () {
+        assert.throws(function () {
+            base.createStore({
+                "name": "bad_store",
+                "fields": [{ "name": "name", "type": "string" }],
+                "options": { "type": "columnar" }
+            });
+        });
+    })
+});
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+function GetSchema() {
+    return [{
+        "name": "Docs",
+        "fields": [
+            { "name": "name", "type": "string", "primary": true },
+            { "name": "tag", "type": "string" },
+            { "name": "labels", "type": "string_v" },
+            { "name": "n", "type": "int" },
+            { "name": "score", "type": "float" }
+        ],
+        "joins": [
+            { "name": "owner", "type": "index", "store": "Users", "inverse": "docs" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value" },
+            { "field": "labels", "type": "value" },
+            { "field": "n", "type": "linear" },
+            { "field": "score", "type": "linear" }
+        ]
+    }, {
+        "name": "Users",
+        "fields": [
+            { "name": "name", "type": "string", "primary": true }
+        ],
+        "joins": [
+            { "name": "docs", "type": "index", "store": "Docs", "inverse": "owner" }
+        ]
+    }];
+}
+
+function AddDocs(store, count) {
+    for (var i = 0; i < count; i++) {
+        store.push({
+            name: "doc" + i,
+            tag: "tag" + (i % 13),
+            labels: ["all", "mod" + (i % 3)],
+            n: i,
+            score: i * 0.5,
+            owner: [{ name: "user" + (i % 10) }]
+        });
+    }
+}
+
+function CountRange(from, to, filter) {
+    var count = 0;
+    for (var i = from; i < to; i++) {
+        if (filter(i)) { count++; }
+    }
+    return count;
+}
+
+describe('Store batched delete tests', function () {
+    it('should remove deleted records from all indexes', function () {
+        this.timeout(60 * 1000);
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        var docs = base.store("Docs");
+        var deleted = 0;
+        docs.addTrigger({
+            onAdd: function (rec) { },
+            onUpdate: function (rec) { },
+            onDelete: function (rec) { deleted++; }
+        });
+        AddDocs(docs, 30000);
+        docs.clear(25000);
+        assert.equal(deleted, 25000);
+        assert.equal(docs.length, 5000);
+        assert.equal(docs.recordByName("doc100"), undefined);
+        assert.equal(docs.recordByName("doc29999").$id, 29999);
+        assert.equal(base.search({ $from: "Docs", tag: "tag0" }).length,
+            CountRange(25000, 30000, function (i) { return i % 13 == 0; }));
+        assert.equal(base.search({ $from: "Docs", labels: "all" }).length, 5000);
+        assert.equal(base.search({ $from: "Docs", labels: "mod1" }).length,
+            CountRange(25000, 30000, function (i) { return i % 3 == 1; }));
+        assert.equal(base.search({ $from: "Docs", n: { $lt: 25999 } }).length, 1000);
+        assert.equal(base.search({ $from: "Docs", score: { $gt: 0 } }).length, 5000);
+        assert.equal(base.store("Users").recordByName("user3").docs.length, 500);
+        base.close();
+    });
+    it('should remove all records from indexes', function () {
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        var docs = base.store("Docs");
+        AddDocs(docs, 1000);
+        docs.clear();
+        assert.equal(docs.length, 0);
+        assert.equal(base.search({ $from: "Docs", labels: "all" }).length, 0);
+        assert.equal(base.search({ $from: "Docs", n: { $gt: -1 } }).length, 0);
+        assert.equal(base.store("Users").recordByName("user3").docs.length, 0);
+        AddDocs(docs, 10);
+        assert.equal(base.search({ $from: "Docs", labels: "all" }).length, 10);
+        base.close();
+    });
+});
@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+var store_name = "Readings";
+function GetStoreTemplate(hotWindow) {
+    return {
+        "name": store_name,
+        "fields": [
+            { "name": "time", "type": "datetime" },
+            { "name": "sensor", "type": "string" },
+            { "name": "value", "type": "float" }
+        ],
+        "keys": [
+            { "field": "sensor", "type": "value" }
+        ],
+        "options": { "block_size_mem": 100 },
+        "hotWindow": hotWindow
+    };
+}
+
+var start_time = new Date("2016-01-01T00:00:00Z").getTime();
+var minute = 60 * 1000;
+function AddReadings(store, from, to) {
+    for (var i = from; i < to; i++) {
+        store.push({ time: start_time + i * minute, sensor: "s" + (i % 4), value: i / 2 });
+    }
+}
+
+function GetHotWindow(base) {
+    return base.getStats().stores.filter(function (stats) {
+        return stats.name == store_name;
+    })[0].hot_window;
+}
+
+describe('Store hot window tests', function () {
+    it('should demote records outside hot window by count', function () {
+        var base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate({ records: 1000 }));
+        var store = base.store(store_name);
+        AddReadings(store, 0, 5000);
+        base.partialFlush(10000);
+        var hot = GetHotWindow(base);
+        assert.equal(hot.first_record, 4000);
+        assert.equal(hot.demoted_blocks, 40);
+        // demoted records are loaded back when read
+        assert.equal(store[10].value, 5);
+        assert.equal(store[4999].sensor, "s3");
+        assert.equal(base.search({ $from: store_name, sensor: "s1" }).length, 1250);
+        assert.ok(GetHotWindow(base).cold_loads > 0);
+        base.close();
+
+        var base2 = new qm.Base({ mode: 'open' });
+        var store2 = base2.store(store_name);
+        assert.equal(GetHotWindow(base2).first_record, 4000);
+        assert.equal(store2[123].value, 61.5);
+        store2[123].value = 1;
+        AddReadings(store2, 5000, 6000);
+        base2.partialFlush(10000);
+        assert.equal(GetHotWindow(base2).first_record, 5000);
+        assert.equal(store2[123].value, 1);
+        base2.close();
+    });
+    it('should demote records outside hot window by time', function () {
+        var base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate({ duration: 2, unit: "hour", field: "time" }));
+        var store = base.store(store_name);
+        AddReadings(store, 0, 600);
+        base.partialFlush(10000);
+        assert.equal(GetHotWindow(base).first_record, 600 - 121);
+        assert.equal(store[0].time.getTime(), start_time);
+        base.close();
+    });
+    it('should require a datetime field for hot window by time', function () {
+        var base = new qm.Base({ mode: 'createClean' });
+        assert.throws(function () {
+            base.createStore(GetStoreTemplate({ duration: 2, unit: "hour", field: "sensor" }));
+        });
+        base.close();
+    });
+});
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+function GetSchema() {
+    return [{
+        "name": "People",
+        "fields": [
+            { "name": "name", "type": "string", "primary": true },
+            { "name": "age", "type": "int" }
+        ]
+    }, {
+        "name": "Codes",
+        "fields": [
+            { "name": "code", "type": "int", "primary": true },
+            { "name": "label", "type": "string" }
+        ]
+    }];
+}
+
+function GetStoreStats(base, store_name) {
+    return base.getStats().stores.filter(function (stats) {
+        return stats.name == store_name;
+    })[0];
+}
+
+describe('Store primary index tests', function () {
+    it('should find records by name and keep them unique', function () {
+        this.timeout(60 * 1000);
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        var people = base.store("People");
+        for (var i = 0; i < 10000; i++) {
+            people.push({ name: "person" + i, age: i % 100 });
+        }
+        // pushing existing name updates the record
+        assert.equal(people.push({ name: "person42", age: 1 }), 42);
+        assert.equal(people.length, 10000);
+        assert.equal(people.recordByName("person42").age, 1);
+        assert.equal(people.recordByName("nobody"), undefined);
+        // renaming moves the key
+        people[7].name = "renamed";
+        assert.equal(people.recordByName("person7"), undefined);
+        assert.equal(people.recordByName("renamed").$id, 7);
+        assert.throws(function () { people[8].name = "person9"; });
+        var stats = GetStoreStats(base, "People").primary_index;
+        assert.equal(stats.keys, 10000);
+        assert.ok(stats.bytes > 0);
+        base.close();
+
+        var base2 = new qm.Base({ mode: 'open' });
+        var people2 = base2.store("People");
+        assert.equal(people2.recordByName("renamed").$id, 7);
+        assert.equal(people2.recordByName("person9999").age, 99);
+        people2.clear(100);
+        assert.equal(people2.recordByName("person50"), undefined);
+        assert.equal(people2.recordByName("person100").$id, 100);
+        base2.close();
+    });
+    it('should keep integer primary keys unique', function () {
+        var base = new qm.Base({ mode: 'createClean', schema: GetSchema() });
+        var codes = base.store("Codes");
+        codes.push({ code: -1, label: "minus one" });
+        codes.push({ code: 1, label: "one" });
+        assert.equal(codes.push({ code: -1, label: "negative" }), 0);
+        assert.equal(codes.length, 2);
+        assert.equal(codes[0].label, "negative");
+        base.close();
+
+        var base2 = new qm.Base({ mode: 'open' });
+        assert.equal(base2.store("Codes").push({ code: 1, label: "uno" }), 1);
+        assert.equal(base2.store("Codes").length, 2);
+        base2.close();
+    });
+});
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Store creation
+
+var store_name = "test_store";
+function GetStoreTemplate() {
+    return {
+        "name": store_name,
+        "fields": [
+            { "name": "name", "type": "string", "primary": true },
+            { "name": "val", "type": "int" },
+            { "name": "flt", "type": "float", "null": true },
+            { "name": "flag", "type": "bool", "default": false },
+            { "name": "time", "type": "datetime" },
+            { "name": "tags", "type": "string_v", "null": true }
+        ],
+        "keys": [
+            { "field": "val", "type": "linear" },
+            { "field": "tags", "type": "value" }
+        ]
+    };
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+describe('Store pushValues tests', function () {
+    var base = undefined;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate());
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should add records given as field values', function () {
+        var store = base.store(store_name);
+        assert.equal(store.pushValues(["a", 1, 1.5, true, 1000, ["x", "y"]]), 0);
+        assert.equal(store.pushValues(["b", 2, null, undefined, new Date(2000), undefined]), 1);
+        assert.equal(store.length, 2);
+        assert.equal(store[0].name, "a");
+        assert.equal(store[0].val, 1);
+        assert.equal(store[0].flt, 1.5);
+        assert.equal(store[0].flag, true);
+        assert.equal(store[0].time.getTime(), 1000);
+        assert.deepEqual(store[0].tags, ["x", "y"]);
+        assert.equal(store[1].flt, null);
+        assert.equal(store[1].flag, false);
+        assert.equal(store[1].time.getTime(), 2000);
+        assert.equal(store[1].tags, null);
+    })
+    it('should match records added with push', function () {
+        var store = base.store(store_name);
+        store.push({ name: "a", val: 1, flt: 1.5, flag: true, time: 1000, tags: ["x", "y"] });
+        store.pushValues(["b", 1, 1.5, true, 1000, ["x", "y"]]);
+        var rec1 = store[0].toJSON(); delete rec1.$id; delete rec1.name;
+        var rec2 = store[1].toJSON(); delete rec2.$id; delete rec2.name;
+        assert.deepEqual(rec1, rec2);
+    })
+    it('should index added records', function () {
+        var store = base.store(store_name);
+        for (var i = 0; i < 10; i++) {
+            store.pushValues(["r" + i, i, null, false, 1000 * i, [i % 2 == 0 ? "even" : "odd"]]);
+        }
+        assert.equal(base.search({ $from: store_name, val: { $gt: 7 } }).length, 3);
+        assert.equal(base.search({ $from: store_name, tags: "even" }).length, 5);
+    })
+    it('should add an array of records as one batch', function () {
+        var store = base.store(store_name);
+        var recs = [];
+        for (var i = 0; i < 100; i++) {
+            recs.push({ name: "r" + i, val: i, time: 1000 * i, tags: [i % 2 == 0 ? "even" : "odd"] });
+        }
+        var ids = store.push(recs);
+        assert.equal(ids.length, 100);
+        assert.equal(ids[99], 99);
+        assert.equal(store.length, 100);
+        assert.equal(base.search({ $from: store_name, tags: "even" }).length, 50);
+        assert.equal(base.searchCount({ $from: store_name, tags: "odd", val: { $gt: 90 } }), 5);
+    })
+    it('should update record with existing primary key', function () {
+        var store = base.store(store_name);
+        store.pushValues(["a", 1, null, false, 0]);
+        assert.equal(store.pushValues(["a", 5]), 0);
+        assert.equal(store.length, 1);
+        assert.equal(store[0].val, 5);
+    })
+    it('should reject invalid values', function () {
+        var store = base.store(store_name);
+        assert.throws(function () {
+            store.pushValues(["a", "abc", null, false, 0]);
+        });
+        assert.throws(function () {
+            store.pushValues(["a", 1, null, null, 0]);
+        });
+        assert.throws(function () {
+            store.pushValues(["a", 1]);
+        });
+        assert.equal(store.length, 0);
+    })
+});
+
+describe('Load CSV tests', function () {
+    var base = undefined;
+    var fname = './push_values_test.csv';
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean' });
+    });
+    afterEach(function () {
+        base.close();
+        if (qm.fs.exists(fname)) { qm.fs.del(fname); }
+    });
+
+    function writeCsv(lines) {
+        var fout = new qm.fs.FOut(fname, false);
+        fout.write(lines.join('\n'));
+        fout.close();
+    }
+
+    it('should load typed values and empty cells', function () {
+        writeCsv(['A,B', 'x,1', 'y,', 'z,2.5']);
+        var result = undefined;
+        base.loadCSV({ file: fname, store: 'csv' }, function (err, store) {
+            assert.equal(err, undefined);
+            result = store;
+        });
+        assert.equal(result.length, 3);
+        assert.equal(result[0].B, 1);
+        assert.equal(result[1].B, null);
+        assert.equal(result[2].B, 2.5);
+    })
+    it('should report lines with non-numeric values in float fields', function () {
+        writeCsv(['A,B', 'x,1', 'y,abc', 'z,2', 'w,n/a']);
+        var error = undefined, result = undefined;
+        base.loadCSV({ file: fname, store: 'csv' }, function (err, store) {
+            error = err;
+            result = store;
+        });
+        assert(error instanceof Error);
+        assert(error.message.indexOf('Rejected 2 lines') >= 0);
+        assert(error.message.indexOf('abc') >= 0);
+        assert.equal(result.length, 2);
+        assert.equal(result[0].B, 1);
+        assert.equal(result[1].B, 2);
+    })
+});
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+var store_name = "Items";
+function GetStoreTemplate() {
+    return {
+        "name": store_name,
+        "fields": [
+            { "name": "name", "type": "string" },
+            { "name": "price", "type": "float", "store": "cache" },
+            { "name": "stock", "type": "int", "store": "cache" },
+            { "name": "descr", "type": "string", "store": "cache", "null": true }
+        ],
+        "keys": [
+            { "field": "stock", "type": "linear" }
+        ]
+    };
+}
+
+function GetRecordCache(base) {
+    return base.getStats().stores.filter(function (stats) {
+        return stats.name == store_name;
+    })[0].record_cache;
+}
+
+describe('Store record cache tests', function () {
+    var base = undefined;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate());
+        var store = base.store(store_name);
+        for (var i = 0; i < 200; i++) {
+            store.push({ name: "item" + i, price: i / 2, stock: i, descr: "descr" + i });
+        }
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should read several fields of a record from one read', function () {
+        var store = base.store(store_name);
+        var before = GetRecordCache(base);
+        var rec = store[42];
+        assert.equal(rec.price, 21);
+        assert.equal(rec.stock, 42);
+        assert.equal(rec.descr, "descr42");
+        var after = GetRecordCache(base);
+        assert.equal(after.misses - before.misses, 1);
+        assert.ok(after.hits - before.hits >= 2);
+        assert.deepEqual(rec.toJSON(), { $id: 42, name: "item42", price: 21, stock: 42, descr: "descr42" });
+    })
+    it('should see changes of cached records', function () {
+        var store = base.store(store_name);
+        assert.equal(store[10].stock, 10);
+        store[10].stock = 1000;
+        assert.equal(store[10].stock, 1000);
+        assert.equal(store[10].descr, "descr10");
+        store.push({ $id: 10, descr: "updated" });
+        assert.equal(store[10].descr, "updated");
+        assert.equal(store[10].stock, 1000);
+        assert.equal(base.search({ $from: store_name, stock: { $gt: 999 } }).length, 1);
+    })
+    it('should forget deleted records', function () {
+        var store = base.store(store_name);
+        assert.equal(store[150].name, "item150");
+        store.clear(100);
+        assert.equal(store.first.stock, 100);
+        assert.equal(store[150].descr, "descr150");
+        store.clear();
+        store.push({ name: "new", price: 1, stock: 1 });
+        assert.equal(store.last.name, "new");
+        assert.equal(store.last.descr, null);
+    })
+});
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2015, Jozef Stefan Institute, Quintelligence d.o.o. and contributors
+ * All rights reserved.
+ *
+ * This source code is licensed under the FreeBSD license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+var assert = require('../../src/nodejs/scripts/assert.js');     //adds assert.run function
+var qm = require('qminer');
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Store creation
+
+var store_name = "test_store";
+function GetStoreTemplate() {
+    return {
+        "name": store_name,
+        "fields": [
+            { "name": "name", "type": "string", "primary": true },
+            { "name": "val", "type": "int" },
+            { "name": "tag", "type": "string" },
+            { "name": "time", "type": "datetime" }
+        ],
+        "keys": [
+            { "field": "tag", "type": "value" }
+        ],
+        "timeWindow": {
+            "duration": 2,
+            "unit": "day",
+            "field": "time",
+            "segment": { "duration": 1, "unit": "day" }
+        }
+    };
+}
+
+var start_time = new Date("2016-01-01T00:00:00Z").getTime();
+var hour = 60 * 60 * 1000;
+
+function AddHours(store, from, to) {
+    for (var i = from; i < to; i++) {
+        store.push({ name: "r" + i, val: i, tag: i % 2 == 0 ? "even" : "odd", time: start_time + i * hour });
+    }
+}
+
+function GetSegments(base) {
+    return base.getStats().stores.filter(function (stats) {
+        return stats.name == store_name;
+    })[0].segments;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+describe('Store time segments tests', function () {
+    var base = undefined;
+    beforeEach(function () {
+        base = new qm.Base({ mode: 'createClean' });
+        base.createStore(GetStoreTemplate());
+    });
+    afterEach(function () {
+        base.close();
+    });
+
+    it('should group records by day', function () {
+        var store = base.store(store_name);
+        AddHours(store, 0, 5 * 24);
+        assert.equal(GetSegments(base), 5);
+        assert.equal(store.toJSON().window.segment, 24 * hour);
+    })
+    it('should drop whole segments outside the window', function () {
+        var store = base.store(store_name);
+        AddHours(store, 0, 5 * 24);
+        base.garbageCollect();
+        // window starts at the last hour of the third day, which is kept whole
+        assert.equal(GetSegments(base), 3);
+        assert.equal(store.length, 3 * 24);
+        assert.equal(store.first.name, "r48");
+        assert.equal(store.last.name, "r119");
+    })
+    it('should remove dropped records from indexes', function () {
+        var store = base.store(store_name);
+        AddHours(store, 0, 5 * 24);
+        base.garbageCollect();
+        assert.equal(base.search({ $from: store_name, tag: "even" }).length, 36);
+        assert.equal(base.search({ $from: store_name, tag: "odd" }).length, 36);
+        assert.equal(store.recordByName("r0"), undefined);
+        assert.equal(store.recordByName("r48").val, 48);
+    })
+    it('should keep adding records after dropping segments', function () {
+        var store = base.store(store_name);
+        AddHours(store, 0, 5 * 24);
+        base.garbageCollect();
+        AddHours(store, 5 * 24, 6 * 24);
+        base.garbageCollect();
+        assert.equal(GetSegments(base), 3);
+        assert.equal(store.length, 3 * 24);
+        assert.equal(store.first.name, "r72");
+        assert.equal(base.search({ $from: store_name, tag: "even" }).length, 36);
+        store.clear();
+        assert.equal(GetSegments(base), 0);
+    })
+    it('should not allow segments for stores with linear keys', function () {
+        var template = GetStoreTemplate();
+        template.name = "linear_store";
+        template.keys.push({ field: "val", type: "linear" });
+        assert.throws(function () {
+            base.createStore(template);
+        });
+    })
+    it('should not allow segments for paged stores', function () {
+        var template = GetStoreTemplate();
+        template.name = "paged_store";
+        template.options = { type: "paged" };
+        assert.throws(function () {
+            base.createStore(template);
+        });
+    })
+});